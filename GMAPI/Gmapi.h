@@ -40,3 +40,28 @@
 #include "GmapiPopups.h"
 #include "GmapiResources.h"
 #include "GmapiSounds.h"
+#include "GmapiUtilities.h"
+#include "GmapiParticleEngine.h"
+#include "GmapiMotionGrid.h"
+#include "GmapiDSCommon.h"
+#include "GmapiDSMap.h"
+#include "GmapiDSGrid.h"
+#include "GmapiDSPriority.h"
+#include "GmapiDSList.h"
+#include "GmapiPathFinder.h"
+#include "GmapiPathService.h"
+#include "GmapiFlowField.h"
+#include "GmapiPathCache.h"
+#include "GmapiPathHierarchy.h"
+#include "GmapiPathSampler.h"
+#include "GmapiPathFollower.h"
+#include "GmapiImageKernels.h"
+#include "GmapiPng.h"
+#include "GmapiTextureAtlas.h"
+#include "GmapiSpriteDedup.h"
+#include "GmapiMemoryReport.h"
+#include "GmapiBitmapStore.h"
+#include "GmapiCollisionMask.h"
+#include "GmapiMipmaps.h"
+#include "GmapiTextureTracker.h"
+#include "GmapiSurfacePool.h"
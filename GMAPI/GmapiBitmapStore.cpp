@@ -0,0 +1,553 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiBitmapStore.cpp                                                */
+/*   - Compressed storage of bitmaps of sprites and backgrounds         */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+// AddVectoredExceptionHandler is declared for Windows XP and later
+#if !defined( _WIN32_WINNT ) || _WIN32_WINNT < 0x0501
+  #undef _WIN32_WINNT
+  #define _WIN32_WINNT 0x0501
+#endif
+
+#include "GmapiBitmapStore.h"
+#include "GmapiDSCommon.h"
+#include "GmapiUtilities.h"
+#include "GmapiMacros.h"
+
+#include <vector>
+
+namespace gm {
+
+  CBitmapStore::BitmapMap CBitmapStore::m_bitmaps;
+  CBitmapStore::PageMap CBitmapStore::m_pages;
+  void* CBitmapStore::m_handler = NULL;
+  int CBitmapStore::m_loadCount = 0;
+
+  namespace {
+    // Size of memory pages of x86 Windows
+    static const ULONG_PTR MEMORY_PAGE_SIZE = 4096;
+    // Smallest number of bitmaps compressed by one thread
+    static const int PARALLEL_BITMAPS = 4;
+
+    // Guards the bitmaps against the exception handler running in other
+    // threads
+    CCriticalSection storeSection;
+
+    // Checks whether the pages are committed read-write memory of one
+    // allocation, which can be decommitted and committed again
+    bool CanDecommit( ULONG_PTR aBegin, unsigned long aSize ) {
+      MEMORY_BASIC_INFORMATION info;
+
+      if ( !VirtualQuery( (void*) aBegin, &info, sizeof( info ) ) )
+        return false;
+
+      return ( info.State == MEM_COMMIT && info.Protect == PAGE_READWRITE &&
+               (ULONG_PTR) info.BaseAddress + info.RegionSize >= aBegin + aSize );
+    }
+
+    // Checks whether none of the pages has been committed since they were
+    // decommitted; a bitmap freed and allocated again in their place
+    // commits them without touching the store
+    bool IsDecommitted( ULONG_PTR aBegin, unsigned long aSize ) {
+      MEMORY_BASIC_INFORMATION info;
+
+      if ( !VirtualQuery( (void*) aBegin, &info, sizeof( info ) ) )
+        return false;
+
+      return ( info.State == MEM_RESERVE && (ULONG_PTR) info.BaseAddress + info.RegionSize >= aBegin + aSize );
+    }
+
+    // FNV-1a hash of the bytes of the bitmap before and after its
+    // decommitted pages
+    unsigned long ChecksumEdges( const unsigned char* aBits, unsigned long aSize, ULONG_PTR aBegin,
+                                 unsigned long aReleased ) {
+      const unsigned char* end = aBits + aSize;
+      const unsigned char* hole = (const unsigned char*) aBegin;
+      unsigned long result = 2166136261UL;
+
+      for ( const unsigned char* byte = aBits; byte < end; byte++ ) {
+        if ( byte == hole )
+          byte += aReleased;
+
+        if ( byte < end )
+          result = ( result ^ *byte ) * 16777619UL;
+      }
+
+      return result;
+    }
+  }
+
+  /************************************************************************/
+  /* CBitmapStore class implementation                                    */
+  /************************************************************************/
+
+  int CBitmapStore::GetArraySize( ResourceKind aKind ) {
+    return ( aKind == RK_SPRITE ? CGMAPI::SpriteData()->arraySize : CGMAPI::BackgroundData()->arraySize );
+  }
+
+  int CBitmapStore::GetBitmapCount( ResourceKind aKind, int aId ) {
+    if ( aId < 0 || aId >= GetArraySize( aKind ) )
+      return 0;
+
+    if ( aKind == RK_BACKGROUND )
+      return ( CGMAPI::BackgroundData()->backgrounds && CGMAPI::BackgroundData()->backgrounds[aId] ? 1 : 0 );
+
+    if ( !CGMAPI::SpriteData()->sprites || !CGMAPI::SpriteData()->sprites[aId] )
+      return 0;
+
+    PGMSPRITE sprite = CGMAPI::SpriteData()->sprites[aId];
+
+    return ( CGlobals::UseNewStructs() ? sprite->structNew.subimageCount : sprite->structOld.subimageCount );
+  }
+
+  unsigned char* CBitmapStore::GetBits( ResourceKind aKind, int aId, int aSubimage, unsigned long& aSize ) {
+    GMBITMAP* bitmap = NULL;
+
+    if ( aSubimage < 0 || aSubimage >= GetBitmapCount( aKind, aId ) )
+      return NULL;
+
+    // Runner's structures are read directly; GetBitmap methods of the
+    // interfaces would make the bitmaps resident
+    if ( aKind == RK_SPRITE ) {
+      PGMSPRITE sprite = CGMAPI::SpriteData()->sprites[aId];
+      PGMBITMAP* bitmaps = ( CGlobals::UseNewStructs() ? sprite->structNew.bitmaps : sprite->structOld.bitmaps );
+
+      if ( bitmaps )
+        bitmap = bitmaps[aSubimage];
+    } else {
+      PGMBACKGROUND background = CGMAPI::BackgroundData()->backgrounds[aId];
+      bitmap = ( CGlobals::UseNewStructs() ? background->structNew.bitmap : background->structOld.bitmap );
+    }
+
+    if ( !bitmap )
+      return NULL;
+
+    aSize = CGMAPI::GetBitmapSize( bitmap );
+    return ( CGlobals::UseNewStructs() ? bitmap->structNew.bits : bitmap->structOld.bits );
+  }
+
+  bool CBitmapStore::HasTexture( ResourceKind aKind, int aId, int aSubimage ) {
+    int texture;
+
+    if ( aKind == RK_SPRITE ) {
+      PGMSPRITE sprite = CGMAPI::SpriteData()->sprites[aId];
+
+      if ( CGlobals::UseNewStructs() )
+        texture = ( sprite->structNew.textureIds ? sprite->structNew.textureIds[aSubimage] : -1 );
+      else
+        texture = ( sprite->structOld.textureIds ? (int) sprite->structOld.textureIds[aSubimage] : -1 );
+    } else {
+      PGMBACKGROUND background = CGMAPI::BackgroundData()->backgrounds[aId];
+      texture = ( CGlobals::UseNewStructs() ? background->structNew.textureId : background->structOld.textureId );
+    }
+
+    return ( texture >= 0 && CGMAPI::GetDirect3DTexture( texture ) != NULL );
+  }
+
+  void CBitmapStore::CompressProc( void* aContext, int aBegin, int aEnd ) {
+    COMPRESSJOB* job = (COMPRESSJOB*) aContext;
+
+    for ( int i = aBegin; i < aEnd; i++ ) {
+      COLDBITMAP& entry = job->entries[i];
+      CompressLZ4( entry.bits, (int) entry.size, entry.data );
+
+      // Drop the capacity reserved for incompressible data
+      std::string( entry.data ).swap( entry.data );
+    }
+  }
+
+  int CBitmapStore::Compress( ResourceKind aKind, int aId ) {
+    std::vector<BitmapKey> keys;
+    std::vector<COLDBITMAP> entries;
+    int first = ( aId < 0 ? 0 : aId );
+    int last = ( aId < 0 ? GetArraySize( aKind ) : aId + 1 );
+    CCriticalSectionLock lock( storeSection );
+
+    for ( int i = first; i < last; i++ ) {
+      int count = GetBitmapCount( aKind, i );
+
+      for ( int n = 0; n < count; n++ ) {
+        BitmapKey key( aKind, std::make_pair( i, n ) );
+        unsigned long size = 0;
+        unsigned char* bits = GetBits( aKind, i, n, size );
+
+        if ( !bits || m_bitmaps.find( key ) != m_bitmaps.end() || !HasTexture( aKind, i, n ) )
+          continue;
+
+        // Only whole pages inside the bitmap can be decommitted
+        ULONG_PTR begin = ( (ULONG_PTR) bits + MEMORY_PAGE_SIZE - 1 ) & ~( MEMORY_PAGE_SIZE - 1 );
+        ULONG_PTR end = ( (ULONG_PTR) bits + size ) & ~( MEMORY_PAGE_SIZE - 1 );
+
+        if ( end <= begin || !CanDecommit( begin, (unsigned long) ( end - begin ) ) )
+          continue;
+
+        keys.push_back( key );
+        entries.push_back( COLDBITMAP() );
+        entries.back().bits = bits;
+        entries.back().size = size;
+        entries.back().begin = begin;
+        entries.back().released = (unsigned long) ( end - begin );
+        entries.back().checksum = ChecksumEdges( bits, size, begin, (unsigned long) ( end - begin ) );
+      }
+    }
+
+    if ( entries.empty() )
+      return 0;
+
+    COMPRESSJOB job = { &entries[0] };
+    CParallel::For( (int) entries.size(), PARALLEL_BITMAPS, CompressProc, &job );
+
+    int result = 0;
+
+    for ( size_t i = 0; i < entries.size(); i++ ) {
+      COLDBITMAP& entry = entries[i];
+
+      if ( entry.data.size() >= entry.released )
+        continue;
+
+      // Stored before the pages are decommitted, so that the handler finds
+      // them when another thread touches them
+      COLDBITMAP& stored = m_bitmaps[keys[i]];
+      stored.bits = entry.bits;
+      stored.size = entry.size;
+      stored.begin = entry.begin;
+      stored.released = entry.released;
+      stored.checksum = entry.checksum;
+      stored.data.swap( entry.data );
+
+      m_pages[stored.begin + stored.released] = keys[i];
+      UpdateHandler();
+
+      if ( !VirtualFree( (void*) stored.begin, stored.released, MEM_DECOMMIT ) ) {
+        m_pages.erase( stored.begin + stored.released );
+        m_bitmaps.erase( keys[i] );
+        continue;
+      }
+
+      ++result;
+    }
+
+    UpdateHandler();
+    return result;
+  }
+
+  bool CBitmapStore::Decompress( BitmapMap::iterator aBitmap, bool aWrite ) {
+    const COLDBITMAP& entry = aBitmap->second;
+    const BitmapKey& key = aBitmap->first;
+    unsigned long size = 0;
+    bool result = false;
+
+    // The bitmap is written back only if it still belongs to the resource;
+    // the pages are checked before they are committed again
+    bool owned = ( aWrite && IsDecommitted( entry.begin, entry.released ) &&
+                   GetBits( key.first, key.second.first, key.second.second, size ) == entry.bits &&
+                   size == entry.size &&
+                   ChecksumEdges( entry.bits, size, entry.begin, entry.released ) == entry.checksum );
+
+    // Committed pages are zero filled
+    if ( VirtualAlloc( (void*) entry.begin, entry.released, MEM_COMMIT, PAGE_READWRITE ) && owned )
+      result = DecompressLZ4( entry.data.data(), (int) entry.data.size(), (char*) entry.bits, (int) size );
+
+    m_pages.erase( entry.begin + entry.released );
+    m_bitmaps.erase( aBitmap );
+    return result;
+  }
+
+  bool CBitmapStore::Load( ULONG_PTR aAddress, bool aCount ) {
+    CCriticalSectionLock lock( storeSection );
+
+    // A bitmap pointer is found by its first decommitted page
+    if ( aCount )
+      aAddress = ( aAddress + MEMORY_PAGE_SIZE - 1 ) & ~( MEMORY_PAGE_SIZE - 1 );
+
+    PageMap::iterator page = m_pages.upper_bound( aAddress );
+
+    if ( page == m_pages.end() )
+      return false;
+
+    BitmapMap::iterator bitmap = m_bitmaps.find( page->second );
+
+    if ( bitmap == m_bitmaps.end() || aAddress < bitmap->second.begin )
+      return false;
+
+    if ( aCount )
+      ++m_loadCount;
+
+    Decompress( bitmap, true );
+    UpdateHandler();
+
+    return true;
+  }
+
+  void CBitmapStore::UpdateHandler() {
+    if ( !m_handler && !m_bitmaps.empty() )
+      m_handler = AddVectoredExceptionHandler( 1, ExceptionHandler );
+    else if ( m_handler && m_bitmaps.empty() ) {
+      RemoveVectoredExceptionHandler( m_handler );
+      m_handler = NULL;
+    }
+  }
+
+  LONG WINAPI CBitmapStore::ExceptionHandler( EXCEPTION_POINTERS* aException ) {
+    const EXCEPTION_RECORD* record = aException->ExceptionRecord;
+
+    if ( record->ExceptionCode != EXCEPTION_ACCESS_VIOLATION || record->NumberParameters < 2 )
+      return EXCEPTION_CONTINUE_SEARCH;
+
+    // The faulting access is repeated after the bitmap is back
+    return ( Load( record->ExceptionInformation[1], false ) ? EXCEPTION_CONTINUE_EXECUTION :
+                                                              EXCEPTION_CONTINUE_SEARCH );
+  }
+
+  int CBitmapStore::Restore( ResourceKind aKind, int aId ) {
+    CCriticalSectionLock lock( storeSection );
+    int result = 0;
+
+    for ( BitmapMap::iterator it = m_bitmaps.begin(); it != m_bitmaps.end(); ) {
+      BitmapMap::iterator current = it++;
+
+      if ( current->first.first == aKind && ( aId < 0 || current->first.second.first == aId ) )
+        result += ( Decompress( current, true ) ? 1 : 0 );
+    }
+
+    UpdateHandler();
+    return result;
+  }
+
+  void CBitmapStore::Forget( ResourceKind aKind, int aId ) {
+    CCriticalSectionLock lock( storeSection );
+
+    for ( BitmapMap::iterator it = m_bitmaps.begin(); it != m_bitmaps.end(); ) {
+      BitmapMap::iterator current = it++;
+
+      if ( current->first.first == aKind && current->first.second.first == aId )
+        Decompress( current, false );
+    }
+
+    UpdateHandler();
+  }
+
+  bool CBitmapStore::IsCold( ResourceKind aKind, int aId ) {
+    CCriticalSectionLock lock( storeSection );
+    BitmapMap::const_iterator it = m_bitmaps.lower_bound( BitmapKey( aKind, std::make_pair( aId, 0 ) ) );
+    return ( it != m_bitmaps.end() && it->first.first == aKind && it->first.second.first == aId );
+  }
+
+  int CBitmapStore::GetColdCount() {
+    CCriticalSectionLock lock( storeSection );
+    return (int) m_bitmaps.size();
+  }
+
+  double CBitmapStore::GetColdSize() {
+    CCriticalSectionLock lock( storeSection );
+    double result = 0.0;
+
+    for ( BitmapMap::const_iterator it = m_bitmaps.begin(); it != m_bitmaps.end(); ++it )
+      result += it->second.size;
+
+    return result;
+  }
+
+  double CBitmapStore::GetStoredSize() {
+    CCriticalSectionLock lock( storeSection );
+    double result = 0.0;
+
+    for ( BitmapMap::const_iterator it = m_bitmaps.begin(); it != m_bitmaps.end(); ++it )
+      result += it->second.data.size();
+
+    return result;
+  }
+
+  double CBitmapStore::GetReleasedSize() {
+    CCriticalSectionLock lock( storeSection );
+    double result = 0.0;
+
+    for ( BitmapMap::const_iterator it = m_bitmaps.begin(); it != m_bitmaps.end(); ++it )
+      result += it->second.released;
+
+    return result;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    // What happens to bitmaps of a resource given as an argument
+    enum PrepareAction { PA_NONE, PA_RESTORE, PA_FORGET };
+
+    void Prepare( CBitmapStore::ResourceKind aKind, GMVALUE* aArgs, PrepareAction aFirst, PrepareAction aSecond ) {
+      // Restored first, the same resource may be passed twice
+      if ( aFirst == PA_RESTORE )
+        CBitmapStore::Restore( aKind, (int) aArgs[0].real );
+      if ( aSecond == PA_RESTORE )
+        CBitmapStore::Restore( aKind, (int) aArgs[1].real );
+      if ( aFirst == PA_FORGET )
+        CBitmapStore::Forget( aKind, (int) aArgs[0].real );
+    }
+
+  #define GMAPI_BITMAPSTORE_HANDLER( aFunction, aKind, aFirst, aSecond ) \
+    GMFUCTION runner##aFunction = NULL;\
+    \
+    void aFunction( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,\
+                    int aArgCount, PGMVALUE aResult ) {\
+      Prepare( CBitmapStore::aKind, aArgs, aFirst, aSecond );\
+      core::RunnerCallFunction( runner##aFunction, aArgs, aArgCount, aResult );\
+    }\
+    \
+    GMAPI_GMFUNCTION_GENERATEHANDLER( aFunction )
+
+    // Functions reading bitmaps of the sprite given by the first argument
+    GMAPI_BITMAPSTORE_HANDLER( SpriteDuplicate, RK_SPRITE, PA_RESTORE, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteMerge, RK_SPRITE, PA_RESTORE, PA_RESTORE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteAddFromScreen, RK_SPRITE, PA_RESTORE, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteAddFromSurface, RK_SPRITE, PA_RESTORE, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteSetAlphaFromSprite, RK_SPRITE, PA_RESTORE, PA_RESTORE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteCollisionMask, RK_SPRITE, PA_RESTORE, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteSetBbox, RK_SPRITE, PA_RESTORE, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteSetBboxMode, RK_SPRITE, PA_RESTORE, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteSetPrecise, RK_SPRITE, PA_RESTORE, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteSave, RK_SPRITE, PA_RESTORE, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteSaveStrip, RK_SPRITE, PA_RESTORE, PA_NONE )
+
+    // Functions freeing bitmaps of the sprite given by the first argument
+    GMAPI_BITMAPSTORE_HANDLER( SpriteDelete, RK_SPRITE, PA_FORGET, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteAssign, RK_SPRITE, PA_FORGET, PA_RESTORE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteReplace, RK_SPRITE, PA_FORGET, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteReplaceSprite, RK_SPRITE, PA_FORGET, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( SpriteReplaceAlpha, RK_SPRITE, PA_FORGET, PA_NONE )
+
+    GMAPI_BITMAPSTORE_HANDLER( BackgroundDuplicate, RK_BACKGROUND, PA_RESTORE, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( BackgroundSetAlphaFromBackground, RK_BACKGROUND, PA_RESTORE, PA_RESTORE )
+    GMAPI_BITMAPSTORE_HANDLER( BackgroundSave, RK_BACKGROUND, PA_RESTORE, PA_NONE )
+
+    GMAPI_BITMAPSTORE_HANDLER( BackgroundDelete, RK_BACKGROUND, PA_FORGET, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( BackgroundAssign, RK_BACKGROUND, PA_FORGET, PA_RESTORE )
+    GMAPI_BITMAPSTORE_HANDLER( BackgroundReplace, RK_BACKGROUND, PA_FORGET, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( BackgroundReplaceBackground, RK_BACKGROUND, PA_FORGET, PA_NONE )
+    GMAPI_BITMAPSTORE_HANDLER( BackgroundReplaceAlpha, RK_BACKGROUND, PA_FORGET, PA_NONE )
+
+    void BitmapStoreSprite( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CBitmapStore::Compress( CBitmapStore::RK_SPRITE, (int) aArgs[0].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( BitmapStoreSprite )
+
+    void BitmapStoreBackground( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CBitmapStore::Compress( CBitmapStore::RK_BACKGROUND, (int) aArgs[0].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( BitmapStoreBackground )
+
+    void BitmapStoreRestoreSprite( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                   int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CBitmapStore::Restore( CBitmapStore::RK_SPRITE, (int) aArgs[0].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( BitmapStoreRestoreSprite )
+
+    void BitmapStoreRestoreBackground( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                       int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CBitmapStore::Restore( CBitmapStore::RK_BACKGROUND, (int) aArgs[0].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( BitmapStoreRestoreBackground )
+
+    void BitmapStoreIsCold( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      CBitmapStore::ResourceKind kind = ( (int) aArgs[0].real == CBitmapStore::RK_BACKGROUND ?
+                                          CBitmapStore::RK_BACKGROUND : CBitmapStore::RK_SPRITE );
+
+      aResult->Set( CBitmapStore::IsCold( kind, (int) aArgs[1].real ) ? 1.0 : 0.0 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( BitmapStoreIsCold )
+
+    void BitmapStoreInfo( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      switch ( (int) aArgs[0].real ) {
+        case CBitmapStore::IF_COLD_COUNT: aResult->Set( (double) CBitmapStore::GetColdCount() ); break;
+        case CBitmapStore::IF_COLD_SIZE: aResult->Set( CBitmapStore::GetColdSize() ); break;
+        case CBitmapStore::IF_STORED_SIZE: aResult->Set( CBitmapStore::GetStoredSize() ); break;
+        case CBitmapStore::IF_RELEASED_SIZE: aResult->Set( CBitmapStore::GetReleasedSize() ); break;
+        case CBitmapStore::IF_LOAD_COUNT: aResult->Set( (double) CBitmapStore::GetLoadCount() ); break;
+        default: aResult->Set( -1.0 );
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( BitmapStoreInfo )
+  }
+
+  void CBitmapStore::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+
+    runnerSpriteDuplicate = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_duplicate, SpriteDuplicate );
+    runnerSpriteMerge = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_merge, SpriteMerge );
+    runnerSpriteAddFromScreen = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_add_from_screen, SpriteAddFromScreen );
+    runnerSpriteAddFromSurface = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_add_from_surface, SpriteAddFromSurface );
+    runnerSpriteSetAlphaFromSprite = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_set_alpha_from_sprite,
+                                                                SpriteSetAlphaFromSprite );
+    runnerSpriteCollisionMask = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_collision_mask, SpriteCollisionMask );
+    runnerSpriteSetBbox = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_set_bbox, SpriteSetBbox );
+    runnerSpriteSetBboxMode = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_set_bbox_mode, SpriteSetBboxMode );
+    runnerSpriteSetPrecise = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_set_precise, SpriteSetPrecise );
+    runnerSpriteSave = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_save, SpriteSave );
+    runnerSpriteSaveStrip = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_save_strip, SpriteSaveStrip );
+    runnerSpriteDelete = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_delete, SpriteDelete );
+    runnerSpriteAssign = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_assign, SpriteAssign );
+    runnerSpriteReplace = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_replace, SpriteReplace );
+    runnerSpriteReplaceSprite = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_replace_sprite, SpriteReplaceSprite );
+    runnerSpriteReplaceAlpha = GMAPI_GMFUNCTION_OVERRIDE( id_sprite_replace_alpha, SpriteReplaceAlpha );
+
+    runnerBackgroundDuplicate = GMAPI_GMFUNCTION_OVERRIDE( id_background_duplicate, BackgroundDuplicate );
+    runnerBackgroundSetAlphaFromBackground = GMAPI_GMFUNCTION_OVERRIDE( id_background_set_alpha_from_background,
+                                                                        BackgroundSetAlphaFromBackground );
+    runnerBackgroundSave = GMAPI_GMFUNCTION_OVERRIDE( id_background_save, BackgroundSave );
+    runnerBackgroundDelete = GMAPI_GMFUNCTION_OVERRIDE( id_background_delete, BackgroundDelete );
+    runnerBackgroundAssign = GMAPI_GMFUNCTION_OVERRIDE( id_background_assign, BackgroundAssign );
+    runnerBackgroundReplace = GMAPI_GMFUNCTION_OVERRIDE( id_background_replace, BackgroundReplace );
+    runnerBackgroundReplaceBackground = GMAPI_GMFUNCTION_OVERRIDE( id_background_replace_background,
+                                                                   BackgroundReplaceBackground );
+    runnerBackgroundReplaceAlpha = GMAPI_GMFUNCTION_OVERRIDE( id_background_replace_alpha, BackgroundReplaceAlpha );
+
+    GMAPI_GMFUNCTION_REGISTER( "bitmap_store_sprite", 1, BitmapStoreSprite );
+    GMAPI_GMFUNCTION_REGISTER( "bitmap_store_background", 1, BitmapStoreBackground );
+    GMAPI_GMFUNCTION_REGISTER( "bitmap_store_restore_sprite", 1, BitmapStoreRestoreSprite );
+    GMAPI_GMFUNCTION_REGISTER( "bitmap_store_restore_background", 1, BitmapStoreRestoreBackground );
+    GMAPI_GMFUNCTION_REGISTER( "bitmap_store_is_cold", 2, BitmapStoreIsCold );
+    GMAPI_GMFUNCTION_REGISTER( "bitmap_store_info", 1, BitmapStoreInfo );
+  }
+
+#endif
+
+}
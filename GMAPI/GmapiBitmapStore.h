@@ -0,0 +1,201 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiBitmapStore.h                                                  */
+/*   - Compressed storage of bitmaps of sprites and backgrounds         */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include <windows.h>
+
+#include <map>
+#include <string>
+#include <utility>
+
+namespace gm {
+
+  /// CBitmapStore
+  ///   Keeps bitmaps of sprites and backgrounds, whose textures have
+  ///   already been created, compressed in the LZ4 block format and gives
+  ///   their memory back to the system (a "cold" bitmap). Unlike the
+  ///   removed ReleaseBitmap methods the runner's bitmaps are not freed:
+  ///   whole memory pages inside them are decommitted (VirtualFree with
+  ///   MEM_DECOMMIT), so the pointers stay valid. Bitmaps are compressed
+  ///   on all processors.
+  ///
+  ///   A cold bitmap is decompressed back to its place when GMAPI needs
+  ///   its pixels (ISpriteSubimage::GetBitmap, IBackground::GetBitmap)
+  ///   and before GML or GMAPI functions read, change or delete the
+  ///   resource (sprite_save, sprite_merge, sprite_collision_mask,
+  ///   background_assign, ...). Any other access to the decommitted pages,
+  ///   like the runner recreating textures after the device was lost,
+  ///   raises an access violation; a vectored exception handler of the
+  ///   store then commits the pages, decompresses the bitmap and lets the
+  ///   access continue. The handler is installed only while some bitmap
+  ///   is cold. Bitmaps of deleted or replaced resources are forgotten
+  ///   without decompression; their pages are committed again before the
+  ///   runner frees them.
+  ///
+  ///   A cold bitmap is written back only if it still belongs to its
+  ///   resource: the resource must have the same bitmap pointer and size,
+  ///   the decommitted pages must still be decommitted, and the bytes of
+  ///   the bitmap outside them must have the checksum they had when it
+  ///   was compressed. A bitmap replaced by a runner function GMAPI does
+  ///   not intercept is dropped instead.
+  ///
+  class CBitmapStore {
+    public:
+      /// Kinds of resources
+      enum ResourceKind { RK_SPRITE, RK_BACKGROUND };
+
+      /// Fields of bitmap_store_info
+      enum InfoField { IF_COLD_COUNT, IF_COLD_SIZE, IF_STORED_SIZE, IF_RELEASED_SIZE, IF_LOAD_COUNT };
+
+      /// Compress( ResourceKind aKind, int aId )
+      ///   Compresses bitmaps of the sprite (all its subimages) or
+      ///   background, or of all of them if aId is -1. Bitmaps smaller
+      ///   than a memory page, bitmaps which do not compress and bitmaps
+      ///   without a texture are skipped.
+      ///
+      /// Returns:
+      ///   Number of bitmaps which became cold.
+      ///
+      static int Compress( ResourceKind aKind, int aId );
+
+      /// MakeResident( const unsigned char* aBitmap )
+      ///   Decompresses the bitmap if it is cold.
+      ///
+      /// Returns:
+      ///   True if the bitmap was cold.
+      ///
+      static bool MakeResident( const unsigned char* aBitmap ) {
+        return ( !m_bitmaps.empty() && Load( (ULONG_PTR) aBitmap, true ) );
+      }
+
+      /// Restore( ResourceKind aKind, int aId )
+      ///   Decompresses all cold bitmaps of the resource, or of all
+      ///   resources of the kind if aId is -1.
+      ///
+      /// Returns:
+      ///   Number of decompressed bitmaps.
+      ///
+      static int Restore( ResourceKind aKind, int aId );
+
+      /// Forget( ResourceKind aKind, int aId )
+      ///   Drops the compressed bitmaps of the resource without writing
+      ///   them back; used before the runner frees the bitmaps.
+      ///
+      static void Forget( ResourceKind aKind, int aId );
+
+      /// IsCold( ResourceKind aKind, int aId )
+      ///   Checks whether some bitmap of the resource is cold.
+      ///
+      static bool IsCold( ResourceKind aKind, int aId );
+
+      /// GetColdCount()
+      ///   Returns number of cold bitmaps.
+      ///
+      static int GetColdCount();
+
+      /// GetColdSize()
+      ///   Returns size in bytes of all cold bitmaps.
+      ///
+      static double GetColdSize();
+
+      /// GetStoredSize()
+      ///   Returns size in bytes of the compressed bitmaps.
+      ///
+      static double GetStoredSize();
+
+      /// GetReleasedSize()
+      ///   Returns size in bytes of the memory pages given back to the
+      ///   system.
+      ///
+      static double GetReleasedSize();
+
+      /// GetLoadCount()
+      ///   Returns number of bitmaps decompressed on demand since the
+      ///   start of the game.
+      ///
+      static int GetLoadCount() {
+        return m_loadCount;
+      }
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers the following GML functions:
+      ///     bitmap_store_sprite( spr ) - compresses bitmaps of the sprite,
+      ///       or of all sprites if spr is -1; returns number of cold
+      ///       bitmaps
+      ///     bitmap_store_background( back ) - the same for backgrounds
+      ///     bitmap_store_restore_sprite( spr ) - decompresses bitmaps of
+      ///       the sprite, or of all sprites if spr is -1
+      ///     bitmap_store_restore_background( back ) - the same for
+      ///       backgrounds
+      ///     bitmap_store_is_cold( kind, id ) - returns IsCold (kind is
+      ///       RK_* value)
+      ///     bitmap_store_info( field ) - returns value of the field
+      ///       (IF_* value)
+      ///   It also overrides the GML functions reading, changing or
+      ///   deleting bitmaps of sprites and backgrounds to restore or
+      ///   forget the bitmaps first.
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      struct COLDBITMAP {
+        unsigned char* bits;          // Runner's bitmap
+        unsigned long size;
+        ULONG_PTR begin;              // First decommitted page
+        unsigned long released;       // Bytes of the decommitted pages
+        unsigned long checksum;       // Bytes outside the decommitted pages
+        std::string data;             // Compressed bitmap
+      };
+
+      struct COMPRESSJOB {
+        COLDBITMAP* entries;
+      };
+
+      /// Kind, ID and subimage (0 for backgrounds) of a bitmap
+      typedef std::pair<ResourceKind, std::pair<int, int> > BitmapKey;
+      typedef std::map<BitmapKey, COLDBITMAP> BitmapMap;
+      /// Keys of cold bitmaps by the end of their decommitted pages
+      typedef std::map<ULONG_PTR, BitmapKey> PageMap;
+
+      static unsigned char* GetBits( ResourceKind aKind, int aId, int aSubimage, unsigned long& aSize );
+      static int GetBitmapCount( ResourceKind aKind, int aId );
+      static bool HasTexture( ResourceKind aKind, int aId, int aSubimage );
+      static int GetArraySize( ResourceKind aKind );
+      static void CompressProc( void* aContext, int aBegin, int aEnd );
+      static bool Load( ULONG_PTR aAddress, bool aCount );
+      static bool Decompress( BitmapMap::iterator aBitmap, bool aWrite );
+      static void UpdateHandler();
+      static LONG WINAPI ExceptionHandler( EXCEPTION_POINTERS* aException );
+
+      static BitmapMap m_bitmaps;       // Cold bitmaps
+      static PageMap m_pages;
+      static void* m_handler;           // Vectored exception handler
+      static int m_loadCount;
+  };
+
+}
@@ -0,0 +1,372 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiCollisionMask.cpp                                              */
+/*   - Bit-packed precise collision masks of sprites                    */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiCollisionMask.h"
+#include "GmapiUtilities.h"
+#include "GmapiMacros.h"
+
+#include <emmintrin.h>
+#include <math.h>
+#include <algorithm>
+
+namespace gm {
+
+  std::map<int, CCollisionMask> CCollisionMask::m_masks;
+
+  namespace {
+    // Smallest number of subimages processed by one thread
+    static const int PARALLEL_SUBIMAGES = 4;
+    static const unsigned long WORD_MASK = 0xFFFFFFFF;
+
+    int LowestBit( unsigned long aWord ) {
+      int result = 0;
+
+      while ( !( aWord & 1 ) ) {
+        aWord >>= 1;
+        ++result;
+      }
+
+      return result;
+    }
+
+    int HighestBit( unsigned long aWord ) {
+      int result = 31;
+
+      while ( !( aWord & 0x80000000 ) ) {
+        aWord <<= 1;
+        --result;
+      }
+
+      return result;
+    }
+
+    // Subimage index as used by draw_sprite, wrapped to the count
+    int WrapSubimage( double aSubimage, int aCount ) {
+      int subimage = (int) floor( aSubimage ) % aCount;
+      return ( subimage < 0 ? subimage + aCount : subimage );
+    }
+  }
+
+  /************************************************************************/
+  /* CCollisionMask class implementation                                  */
+  /************************************************************************/
+
+  void CCollisionMask::BuildSubimage( int aSubimage, const unsigned char* aBitmap, int aThreshold ) {
+    BOX& box = m_boxes[aSubimage];
+
+    box.left = m_width;
+    box.top = m_height;
+    box.right = -1;
+    box.bottom = -1;
+
+    if ( !aBitmap )
+      return;
+
+    bool useSSE2 = CCpuInfo::HasSSE2();
+    __m128i zero = _mm_setzero_si128();
+    __m128i threshold = _mm_set1_epi8( (char) aThreshold );
+
+    for ( int y = 0; y < m_height; y++ ) {
+      const DWORD* pixels = (const DWORD*) aBitmap + y * m_width;
+      unsigned long* row = &m_bits[( aSubimage * m_height + y ) * m_stride];
+      int x = 0;
+
+      if ( useSSE2 ) {
+        for ( ; x + 16 <= m_width; x += 16 ) {
+          __m128i alpha01 = _mm_packs_epi32( _mm_srli_epi32( _mm_loadu_si128( (const __m128i*) ( pixels + x ) ), 24 ),
+                                             _mm_srli_epi32( _mm_loadu_si128( (const __m128i*) ( pixels + x + 4 ) ), 24 ) );
+          __m128i alpha23 = _mm_packs_epi32( _mm_srli_epi32( _mm_loadu_si128( (const __m128i*) ( pixels + x + 8 ) ), 24 ),
+                                             _mm_srli_epi32( _mm_loadu_si128( (const __m128i*) ( pixels + x + 12 ) ), 24 ) );
+          __m128i alpha = _mm_packus_epi16( alpha01, alpha23 );
+
+          // Saturated subtraction leaves zero where alpha <= threshold
+          int transparent = _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_subs_epu8( alpha, threshold ), zero ) );
+          row[x >> 5] |= (unsigned long) ( ~transparent & 0xFFFF ) << ( x & 31 );
+        }
+      }
+
+      for ( ; x < m_width; x++ ) {
+        if ( (int) ( pixels[x] >> 24 ) > aThreshold )
+          row[x >> 5] |= 1UL << ( x & 31 );
+      }
+
+      int first = 0, last = m_stride - 1;
+
+      while ( first < m_stride && !row[first] )
+        ++first;
+
+      if ( first == m_stride )
+        continue;
+
+      while ( !row[last] )
+        --last;
+
+      box.left = std::min( box.left, first * 32 + LowestBit( row[first] ) );
+      box.right = std::max( box.right, last * 32 + HighestBit( row[last] ) );
+      box.top = std::min( box.top, y );
+      box.bottom = y;
+    }
+  }
+
+  void CCollisionMask::BuildProc( void* aContext, int aBegin, int aEnd ) {
+    BUILDJOB* job = (BUILDJOB*) aContext;
+
+    for ( int i = aBegin; i < aEnd; i++ )
+      job->mask->BuildSubimage( i, job->bitmaps[i], job->threshold );
+  }
+
+  int CCollisionMask::Build( int aSprite, int aThreshold, bool aApplyBoundingBox ) {
+    ISprite& sprite = CGMAPI::Ptr()->Sprites[aSprite];
+    int count = sprite.Subimages.GetCount();
+    CCollisionMask& mask = m_masks[aSprite];
+
+    mask.m_width = sprite.GetWidth();
+    mask.m_height = sprite.GetHeight();
+    mask.m_stride = ( mask.m_width + 31 ) / 32;
+    mask.m_originX = sprite.GetOffsetX();
+    mask.m_originY = sprite.GetOffsetY();
+    mask.m_bits.assign( count * mask.m_height * mask.m_stride, 0 );
+    mask.m_boxes.resize( count );
+
+    // Bitmaps are collected first, the runner's structures must not be
+    // read by the threads
+    std::vector<const unsigned char*> bitmaps( count, (const unsigned char*) NULL );
+
+    if ( mask.m_width > 0 && mask.m_height > 0 ) {
+      for ( int i = 0; i < count; i++ )
+        bitmaps[i] = sprite.Subimages[i].GetBitmap();
+    }
+
+    if ( count > 0 ) {
+      BUILDJOB job = { &mask, &bitmaps[0], std::min( std::max( aThreshold, 0 ), 255 ) };
+      CParallel::For( count, PARALLEL_SUBIMAGES, BuildProc, &job );
+    }
+
+    BOX& united = mask.m_union;
+    united.left = mask.m_width;
+    united.top = mask.m_height;
+    united.right = -1;
+    united.bottom = -1;
+
+    for ( int i = 0; i < count; i++ ) {
+      const BOX& box = mask.m_boxes[i];
+
+      if ( box.right < box.left )
+        continue;
+
+      united.left = std::min( united.left, box.left );
+      united.top = std::min( united.top, box.top );
+      united.right = std::max( united.right, box.right );
+      united.bottom = std::max( united.bottom, box.bottom );
+    }
+
+    if ( aApplyBoundingBox && united.right >= united.left ) {
+      if ( !CGlobals::UseNewStructs() )
+        sprite.SetBoundingBoxType( BBOX_MANUAL );
+
+      sprite.SetBoundingBox( united.left, united.right, united.top, united.bottom );
+    }
+
+    return count;
+  }
+
+  const CCollisionMask* CCollisionMask::Find( int aSprite ) {
+    std::map<int, CCollisionMask>::const_iterator mask = m_masks.find( aSprite );
+
+    return ( mask != m_masks.end() ? &mask->second : NULL );
+  }
+
+  void CCollisionMask::Clear( int aSprite ) {
+    if ( aSprite < 0 )
+      m_masks.clear();
+    else
+      m_masks.erase( aSprite );
+  }
+
+  bool CCollisionMask::GetPixel( int aSubimage, int aX, int aY ) const {
+    if ( aSubimage < 0 || aSubimage >= GetSubimageCount() ||
+         aX < 0 || aY < 0 || aX >= m_width || aY >= m_height )
+      return false;
+
+    return ( ( GetRow( aSubimage, aY )[aX >> 5] >> ( aX & 31 ) ) & 1 ) != 0;
+  }
+
+  unsigned long CCollisionMask::FetchBits( const unsigned long* aRow, int aStride, int aPosition ) {
+    int word = aPosition >> 5, shift = aPosition & 31;
+    unsigned long result = aRow[word] >> shift;
+
+    if ( shift && word + 1 < aStride )
+      result |= aRow[word + 1] << ( 32 - shift );
+
+    return result & WORD_MASK;
+  }
+
+  bool CCollisionMask::Overlap( const CCollisionMask& aFirst, int aFirstSubimage, int aFirstX, int aFirstY,
+                                const CCollisionMask& aSecond, int aSecondSubimage, int aSecondX, int aSecondY ) {
+    if ( aFirstSubimage < 0 || aFirstSubimage >= aFirst.GetSubimageCount() ||
+         aSecondSubimage < 0 || aSecondSubimage >= aSecond.GetSubimageCount() )
+      return false;
+
+    const BOX& first = aFirst.m_boxes[aFirstSubimage];
+    const BOX& second = aSecond.m_boxes[aSecondSubimage];
+
+    // Positions of the top left corners of the subimages
+    int firstX = aFirstX - aFirst.m_originX, firstY = aFirstY - aFirst.m_originY;
+    int secondX = aSecondX - aSecond.m_originX, secondY = aSecondY - aSecond.m_originY;
+
+    int left = std::max( firstX + first.left, secondX + second.left );
+    int right = std::min( firstX + first.right, secondX + second.right );
+    int top = std::max( firstY + first.top, secondY + second.top );
+    int bottom = std::min( firstY + first.bottom, secondY + second.bottom );
+
+    // Also true if either subimage has no solid pixels
+    if ( left > right || top > bottom )
+      return false;
+
+    for ( int y = top; y <= bottom; y++ ) {
+      const unsigned long* firstRow = aFirst.GetRow( aFirstSubimage, y - firstY );
+      const unsigned long* secondRow = aSecond.GetRow( aSecondSubimage, y - secondY );
+
+      for ( int x = left; x <= right; x += 32 ) {
+        unsigned long bits = FetchBits( firstRow, aFirst.m_stride, x - firstX ) &
+                             FetchBits( secondRow, aSecond.m_stride, x - secondX );
+
+        if ( right - x < 31 )
+          bits &= ( 1UL << ( right - x + 1 ) ) - 1;
+
+        if ( bits )
+          return true;
+      }
+    }
+
+    return false;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void CollisionMaskBuild( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( (double) CCollisionMask::Build( (int) aArgs[0].real, (int) aArgs[1].real,
+                                                      aArgs[2].real != 0.0 ) );
+      } catch ( const EGMAPIException& ) {
+        aResult->Set( -1.0 );
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( CollisionMaskBuild )
+
+    void CollisionMaskClear( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      CCollisionMask::Clear( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( CollisionMaskClear )
+
+    void CollisionMaskBbox( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      const CCollisionMask* mask = CCollisionMask::Find( (int) aArgs[0].real );
+      int subimage = (int) aArgs[1].real;
+
+      aResult->Set( -1.0 );
+
+      if ( !mask || subimage < -1 || subimage >= mask->GetSubimageCount() )
+        return;
+
+      const CCollisionMask::BOX& box = mask->GetBoundingBox( subimage );
+
+      switch ( (int) aArgs[2].real ) {
+        case CCollisionMask::BF_LEFT: aResult->Set( (double) box.left ); break;
+        case CCollisionMask::BF_TOP: aResult->Set( (double) box.top ); break;
+        case CCollisionMask::BF_RIGHT: aResult->Set( (double) box.right ); break;
+        case CCollisionMask::BF_BOTTOM: aResult->Set( (double) box.bottom ); break;
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( CollisionMaskBbox )
+
+    void CollisionMaskPoint( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      const CCollisionMask* mask = CCollisionMask::Find( (int) aArgs[0].real );
+
+      aResult->Set( 0.0 );
+
+      if ( !mask || !mask->GetSubimageCount() )
+        return;
+
+      int subimage = WrapSubimage( aArgs[1].real, mask->GetSubimageCount() );
+      int x = (int) floor( aArgs[4].real ) - (int) floor( aArgs[2].real ) + mask->GetOriginX();
+      int y = (int) floor( aArgs[5].real ) - (int) floor( aArgs[3].real ) + mask->GetOriginY();
+
+      aResult->Set( mask->GetPixel( subimage, x, y ) ? 1.0 : 0.0 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( CollisionMaskPoint )
+
+    void CollisionMaskOverlap( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                               int aArgCount, PGMVALUE aResult ) {
+      const CCollisionMask* first = CCollisionMask::Find( (int) aArgs[0].real );
+      const CCollisionMask* second = CCollisionMask::Find( (int) aArgs[4].real );
+
+      aResult->Set( 0.0 );
+
+      if ( !first || !second || !first->GetSubimageCount() || !second->GetSubimageCount() )
+        return;
+
+      bool overlap = CCollisionMask::Overlap( *first, WrapSubimage( aArgs[1].real, first->GetSubimageCount() ),
+                                              (int) floor( aArgs[2].real ), (int) floor( aArgs[3].real ),
+                                              *second, WrapSubimage( aArgs[5].real, second->GetSubimageCount() ),
+                                              (int) floor( aArgs[6].real ), (int) floor( aArgs[7].real ) );
+
+      aResult->Set( overlap ? 1.0 : 0.0 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( CollisionMaskOverlap )
+  }
+
+  void CCollisionMask::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+
+    GMAPI_GMFUNCTION_REGISTER( "collision_mask_build", 3, CollisionMaskBuild );
+    GMAPI_GMFUNCTION_REGISTER( "collision_mask_clear", 1, CollisionMaskClear );
+    GMAPI_GMFUNCTION_REGISTER( "collision_mask_bbox", 3, CollisionMaskBbox );
+    GMAPI_GMFUNCTION_REGISTER( "collision_mask_point", 6, CollisionMaskPoint );
+    GMAPI_GMFUNCTION_REGISTER( "collision_mask_overlap", 8, CollisionMaskOverlap );
+  }
+
+#endif
+
+}
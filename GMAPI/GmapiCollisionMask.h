@@ -0,0 +1,172 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiCollisionMask.h                                                */
+/*   - Bit-packed precise collision masks of sprites                    */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include <map>
+#include <vector>
+
+namespace gm {
+
+  /// CCollisionMask
+  ///   Precise collision masks of sprite subimages with one bit per pixel,
+  ///   built natively from alpha of the bitmaps. A pixel is solid if its
+  ///   alpha is greater than the threshold, like with the tolerance of
+  ///   sprite_collision_mask. Rows are packed into 32 bit words, the
+  ///   lowest bit being the leftmost pixel, and padded with zero bits.
+  ///
+  ///   Alpha is compared 16 pixels at a time with SSE2 when the processor
+  ///   supports it; subimages are processed on all processors. Each
+  ///   subimage gets the tight bounding box of its solid pixels, the
+  ///   sprite gets their union, which can be applied to the sprite as
+  ///   its bounding box.
+  ///
+  ///   Masks are kept by sprite and describe the bitmaps at the time of
+  ///   Build. They are not used by the runner's own collision checking;
+  ///   Overlap and GetPixel test them natively.
+  ///
+  class CCollisionMask {
+    public:
+      /// Bounding box; right < left if there are no solid pixels
+      struct BOX {
+        int left;
+        int top;
+        int right;
+        int bottom;
+      };
+
+      /// Fields of collision_mask_bbox
+      enum BoxField { BF_LEFT, BF_TOP, BF_RIGHT, BF_BOTTOM };
+
+      CCollisionMask(): m_width( 0 ), m_height( 0 ), m_stride( 0 ), m_originX( 0 ), m_originY( 0 ) {}
+
+      /************************************************************************/
+      /* Mask management                                                      */
+      /************************************************************************/
+
+      /// Build( int aSprite, int aThreshold, bool aApplyBoundingBox )
+      ///   Builds masks of all subimages of the sprite, replacing the ones
+      ///   built before. If aApplyBoundingBox is true and some pixel is
+      ///   solid, the union of the bounding boxes is set as the sprite's
+      ///   bounding box (in GM6 and GM7 its type is changed to manual).
+      ///
+      /// Returns:
+      ///   Number of subimages.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPISpriteNotExist if the sprite does not exist.
+      ///
+      static int Build( int aSprite, int aThreshold, bool aApplyBoundingBox );
+
+      /// Find( int aSprite )
+      ///   Returns masks of the sprite or NULL if they have not been built.
+      ///
+      static const CCollisionMask* Find( int aSprite );
+
+      /// Clear( int aSprite )
+      ///   Frees masks of the sprite, or of all sprites if aSprite is -1.
+      ///
+      static void Clear( int aSprite );
+
+      /************************************************************************/
+      /* Mask queries                                                         */
+      /************************************************************************/
+
+      int GetWidth() const { return m_width; }
+      int GetHeight() const { return m_height; }
+      int GetOriginX() const { return m_originX; }
+      int GetOriginY() const { return m_originY; }
+      int GetSubimageCount() const { return (int) m_boxes.size(); }
+
+      /// GetBoundingBox( int aSubimage )
+      ///   Returns bounding box of the subimage, or the union of all boxes
+      ///   if aSubimage is -1.
+      ///
+      const BOX& GetBoundingBox( int aSubimage ) const {
+        return ( aSubimage < 0 ? m_union : m_boxes[aSubimage] );
+      }
+
+      /// GetPixel( int aSubimage, int aX, int aY )
+      ///   Checks whether the pixel of the subimage is solid; pixels
+      ///   outside the subimage are not.
+      ///
+      bool GetPixel( int aSubimage, int aX, int aY ) const;
+
+      /// Overlap( const CCollisionMask& aFirst, int aFirstSubimage, int aFirstX, int aFirstY,
+      ///          const CCollisionMask& aSecond, int aSecondSubimage, int aSecondX, int aSecondY )
+      ///   Checks whether solid pixels of the subimages overlap, if their
+      ///   origins are placed at the given positions. Sprites are neither
+      ///   scaled nor rotated. Only the intersection of the bounding boxes
+      ///   is compared, 32 pixels at a time.
+      ///
+      static bool Overlap( const CCollisionMask& aFirst, int aFirstSubimage, int aFirstX, int aFirstY,
+                           const CCollisionMask& aSecond, int aSecondSubimage, int aSecondX, int aSecondY );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers the following GML functions:
+      ///     collision_mask_build( spr, threshold, setbbox ) - builds masks
+      ///       of the sprite; returns number of subimages or -1
+      ///     collision_mask_clear( spr ) - frees masks of the sprite
+      ///     collision_mask_bbox( spr, subimg, field ) - returns field
+      ///       (BF_* value) of the bounding box of the subimage, or of the
+      ///       union if subimg is -1
+      ///     collision_mask_point( spr, subimg, x, y, px, py ) - checks
+      ///       whether the point is in a solid pixel of the subimage drawn
+      ///       at (x, y)
+      ///     collision_mask_overlap( spr1, subimg1, x1, y1, spr2, subimg2,
+      ///       x2, y2 ) - returns Overlap
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      struct BUILDJOB {
+        CCollisionMask* mask;
+        const unsigned char* const* bitmaps;
+        int threshold;
+      };
+
+      const unsigned long* GetRow( int aSubimage, int aY ) const {
+        return &m_bits[( aSubimage * m_height + aY ) * m_stride];
+      }
+
+      static unsigned long FetchBits( const unsigned long* aRow, int aStride, int aPosition );
+      static void BuildProc( void* aContext, int aBegin, int aEnd );
+      void BuildSubimage( int aSubimage, const unsigned char* aBitmap, int aThreshold );
+
+      int m_width;
+      int m_height;
+      int m_stride;                       // 32 bit words per row
+      int m_originX;
+      int m_originY;
+      std::vector<unsigned long> m_bits;  // Rows of all subimages
+      std::vector<BOX> m_boxes;
+      BOX m_union;
+
+      static std::map<int, CCollisionMask> m_masks;
+  };
+
+}
@@ -230,6 +230,8 @@ namespace gm {
   const char* const STR_EXC_DESTROYERNOTEXISTS =      "Trying to access non existing particle destroyer.";
   const char* const STR_EXC_EMITTERNOTEXISTS =        "Trying to access non existing particle emitter.";
   const char* const STR_EXC_ATTRACTORNOTEXISTS =      "Trying to access non existing particle attractor.";
+  const char* const STR_EXC_MOTIONGRIDNOTEXISTS =     "Trying to access motion planning grid that does not exist or is not mirrored by GMAPI.";
+  const char* const STR_EXC_DATASTRUCTURENOTEXISTS =  "Trying to access non existing data structure.";
 
   const char* const GM_FUNCTION_NAMES[] = {
     "show_message",
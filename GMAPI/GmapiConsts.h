@@ -56,6 +56,8 @@ namespace gm {
   extern const char* const STR_EXC_DESTROYERNOTEXISTS;
   extern const char* const STR_EXC_EMITTERNOTEXISTS;
   extern const char* const STR_EXC_ATTRACTORNOTEXISTS;
+  extern const char* const STR_EXC_MOTIONGRIDNOTEXISTS;
+  extern const char* const STR_EXC_DATASTRUCTURENOTEXISTS;
 
   extern const char* const GM70_ADDRESS_PTR_SWAPTABLE;
   extern const char* const GM80_ADDRESS_PTR_SWAPTABLE;
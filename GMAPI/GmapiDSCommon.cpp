@@ -0,0 +1,554 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiDSCommon.cpp                                                   */
+/*   - Classes shared by the native data structures                     */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiDSCommon.h"
+
+#include <string.h>
+
+namespace gm {
+
+  /************************************************************************/
+  /* CDSValue class implementation                                        */
+  /************************************************************************/
+
+  const std::string CDSValue::m_emptyString;
+
+  unsigned long CDSValue::Hash() const {
+    if ( m_string ) {
+      unsigned long hash = 2166136261UL;
+
+      for ( size_t i = 0; i < m_string->size(); i++ )
+        hash = ( hash ^ (unsigned char) (*m_string)[i] ) * 16777619UL;
+
+      return hash;
+    }
+
+    // -0.0 == 0.0, so they must have the same hash
+    if ( m_real == 0.0 )
+      return 0;
+
+    // Both halves of the double are mixed (integer keys differ only in the
+    // high one) and the result is scrambled by MurmurHash3 finalizer
+    DWORD bits[2];
+    memcpy( bits, &m_real, sizeof( bits ) );
+
+    DWORD hash = bits[0] * 0x9E3779B1UL + bits[1];
+
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6BUL;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35UL;
+    hash ^= hash >> 16;
+
+    return hash;
+  }
+
+  /************************************************************************/
+  /* CDSWriter, CDSReader class implementation                            */
+  /************************************************************************/
+
+  void CDSWriter::WriteValue( const CDSValue& aValue ) {
+    WriteInt( aValue.IsString() ? 1 : 0 );
+
+    if ( aValue.IsString() ) {
+      WriteInt( (int) aValue.GetString().size() );
+      WriteBytes( aValue.GetString().data(), (int) aValue.GetString().size() );
+    } else
+      WriteReal( aValue.GetReal() );
+  }
+
+  bool CDSReader::ReadValue( CDSValue& aValue ) {
+    int type;
+
+    if ( !ReadInt( type ) )
+      return false;
+
+    if ( type == 1 ) {
+      int length;
+
+      // The data must contain all characters before the value is allocated
+      if ( !ReadInt( length ) || length < 0 || !IsAvailable( length ) )
+        return false;
+
+      std::string value( length, '\0' );
+
+      if ( length && !ReadBytes( &value[0], length ) )
+        return false;
+
+      aValue = CDSValue( value );
+      return true;
+    }
+
+    double real;
+
+    if ( !ReadReal( real ) )
+      return false;
+
+    aValue = CDSValue( real );
+    return true;
+  }
+
+  /************************************************************************/
+  /* CDSHexWriter, CDSHexReader class implementation                      */
+  /************************************************************************/
+
+  void CDSHexWriter::WriteBytes( const void* aData, int aSize ) {
+    static const char digits[] = "0123456789ABCDEF";
+    const unsigned char* data = (const unsigned char*) aData;
+
+    for ( int i = 0; i < aSize; i++ ) {
+      m_string += digits[data[i] >> 4];
+      m_string += digits[data[i] & 0x0F];
+    }
+  }
+
+  static inline int HexDigit( char aChar ) {
+    if ( aChar >= '0' && aChar <= '9' )
+      return aChar - '0';
+    else if ( aChar >= 'A' && aChar <= 'F' )
+      return aChar - 'A' + 10;
+    else if ( aChar >= 'a' && aChar <= 'f' )
+      return aChar - 'a' + 10;
+
+    return -1;
+  }
+
+  CDSHexReader::CDSHexReader( const char* aString ): m_position( aString ? aString : "" ) {
+    m_end = m_position + strlen( m_position );
+  }
+
+  bool CDSHexReader::IsAvailable( int aSize ) {
+    // Two digits per byte; the scan never goes past the terminator
+    return ( aSize >= 0 && (size_t) aSize <= (size_t) ( m_end - m_position ) / 2 );
+  }
+
+  bool CDSHexReader::ReadBytes( void* aData, int aSize ) {
+    unsigned char* data = (unsigned char*) aData;
+
+    for ( int i = 0; i < aSize; i++ ) {
+      if ( !m_position[0] || !m_position[1] )
+        return false;
+
+      int high = HexDigit( m_position[0] );
+      int low = HexDigit( m_position[1] );
+
+      if ( high < 0 || low < 0 )
+        return false;
+
+      data[i] = (unsigned char) ( ( high << 4 ) | low );
+      m_position += 2;
+    }
+
+    return true;
+  }
+
+  /************************************************************************/
+  /* LZ4 block compression                                                */
+  /************************************************************************/
+
+  namespace {
+    // Limits of the LZ4 block format
+    const int LZ4_MIN_MATCH = 4;
+    const int LZ4_LAST_LITERALS = 5;
+    const int LZ4_MATCH_FIND_LIMIT = 12;
+    const int LZ4_MAX_OFFSET = 0xFFFF;
+    const int LZ4_HASH_BITS = 12;
+
+    inline unsigned int Read32( const unsigned char* aData ) {
+      unsigned int value;
+      memcpy( &value, aData, sizeof( value ) );
+
+      return value;
+    }
+
+    inline void WriteLength( std::string& aOutput, int aLength ) {
+      for ( ; aLength >= 255; aLength -= 255 )
+        aOutput += (char) 255;
+
+      aOutput += (char) aLength;
+    }
+
+    // Appends one sequence - literals followed by a match (aMatchLength 0
+    // for the last sequence, which contains only literals)
+    void WriteSequence( std::string& aOutput, const unsigned char* aLiterals, int aLiteralCount,
+                        int aOffset, int aMatchLength ) {
+      int matchCode = ( aMatchLength ? aMatchLength - LZ4_MIN_MATCH : 0 );
+
+      aOutput += (char) ( ( ( aLiteralCount < 15 ? aLiteralCount : 15 ) << 4 ) |
+                          ( matchCode < 15 ? matchCode : 15 ) );
+
+      if ( aLiteralCount >= 15 )
+        WriteLength( aOutput, aLiteralCount - 15 );
+
+      aOutput.append( (const char*) aLiterals, aLiteralCount );
+
+      if ( !aMatchLength )
+        return;
+
+      aOutput += (char) ( aOffset & 0xFF );
+      aOutput += (char) ( aOffset >> 8 );
+
+      if ( matchCode >= 15 )
+        WriteLength( aOutput, matchCode - 15 );
+    }
+  }
+
+  // Greedy compressor producing the LZ4 block format
+  void CompressLZ4( const void* aData, int aSize, std::string& aOutput ) {
+    const unsigned char* data = (const unsigned char*) aData;
+    int table[1 << LZ4_HASH_BITS];
+    int position = 0, anchor = 0;
+    int searchLimit = aSize - LZ4_MATCH_FIND_LIMIT, matchLimit = aSize - LZ4_LAST_LITERALS;
+
+    aOutput.clear();
+    aOutput.reserve( aSize + aSize / 255 + 16 );
+
+    for ( int i = 0; i < ( 1 << LZ4_HASH_BITS ); i++ )
+      table[i] = -1;
+
+    while ( position < searchLimit ) {
+      unsigned int sequence = Read32( data + position );
+      unsigned int hash = ( sequence * 2654435761U ) >> ( 32 - LZ4_HASH_BITS );
+      int reference = table[hash];
+
+      table[hash] = position;
+
+      if ( reference < 0 || position - reference > LZ4_MAX_OFFSET ||
+           Read32( data + reference ) != sequence ) {
+        // Skip faster over data that do not compress
+        position += 1 + ( ( position - anchor ) >> 6 );
+        continue;
+      }
+
+      while ( position > anchor && reference > 0 && data[position - 1] == data[reference - 1] ) {
+        --position;
+        --reference;
+      }
+
+      int length = LZ4_MIN_MATCH;
+
+      while ( position + length < matchLimit && data[reference + length] == data[position + length] )
+        ++length;
+
+      WriteSequence( aOutput, data + anchor, position - anchor, position - reference, length );
+
+      position += length;
+      anchor = position;
+    }
+
+    WriteSequence( aOutput, data + anchor, aSize - anchor, 0, 0 );
+  }
+
+  // Decompresses the LZ4 block; the output must have exactly aOutputSize bytes
+  bool DecompressLZ4( const void* aData, int aSize, char* aOutput, int aOutputSize ) {
+    const unsigned char* data = (const unsigned char*) aData;
+    int position = 0, output = 0;
+
+    while ( position < aSize ) {
+      int token = data[position++];
+      int length = token >> 4;
+
+      if ( length == 15 ) {
+        int part;
+
+        do {
+          if ( position >= aSize )
+            return false;
+
+          part = data[position++];
+          length += part;
+        } while ( part == 255 );
+      }
+
+      if ( length > aSize - position || length > aOutputSize - output )
+        return false;
+
+      memcpy( aOutput + output, data + position, length );
+      position += length;
+      output += length;
+
+      // The last sequence contains only literals
+      if ( position == aSize )
+        break;
+
+      if ( position + 2 > aSize )
+        return false;
+
+      int offset = data[position] | ( data[position + 1] << 8 );
+      position += 2;
+
+      if ( !offset || offset > output )
+        return false;
+
+      length = token & 0x0F;
+
+      if ( length == 15 ) {
+        int part;
+
+        do {
+          if ( position >= aSize )
+            return false;
+
+          part = data[position++];
+          length += part;
+        } while ( part == 255 );
+      }
+
+      length += LZ4_MIN_MATCH;
+
+      if ( length > aOutputSize - output )
+        return false;
+
+      // Byte by byte, the match may overlap the output
+      for ( int i = 0; i < length; i++, output++ )
+        aOutput[output] = aOutput[output - offset];
+    }
+
+    return ( output == aOutputSize );
+  }
+
+  /************************************************************************/
+  /* CDSBinaryWriter, CDSBinaryReader class implementation                */
+  /************************************************************************/
+
+  // Signature and version of the binary format
+  static const char BINARY_SIGNATURE[4] = { 'G', 'M', 'D', 'S' };
+  static const int BINARY_VERSION = 1;
+
+  // Largest size of the blocks (before compression)
+  static const int BINARY_BLOCK_SIZE = 0x10000;
+
+  CDSBinaryWriter::CDSBinaryWriter( bool aCompress ): m_file( INVALID_HANDLE_VALUE ),
+    m_compress( aCompress ), m_started( false ), m_failed( false ), m_closed( false ) {}
+
+  CDSBinaryWriter::~CDSBinaryWriter() {
+    Close();
+  }
+
+  bool CDSBinaryWriter::Open( const char* aFileName ) {
+    if ( m_started || m_file != INVALID_HANDLE_VALUE )
+      return false;
+
+    m_file = CreateFileA( aFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+    return ( m_file != INVALID_HANDLE_VALUE );
+  }
+
+  bool CDSBinaryWriter::Close() {
+    if ( !m_closed ) {
+      FlushBlock();
+
+      // Empty block terminates the stream
+      int terminator[2] = { 0, 0 };
+      Output( terminator, sizeof( terminator ) );
+
+      if ( m_file != INVALID_HANDLE_VALUE ) {
+        CloseHandle( m_file );
+        m_file = INVALID_HANDLE_VALUE;
+      }
+
+      m_closed = true;
+    }
+
+    return !m_failed;
+  }
+
+  void CDSBinaryWriter::WriteBytes( const void* aData, int aSize ) {
+    const char* data = (const char*) aData;
+
+    while ( aSize > 0 ) {
+      int count = BINARY_BLOCK_SIZE - (int) m_block.size();
+
+      if ( count > aSize )
+        count = aSize;
+
+      m_block.append( data, count );
+      data += count;
+      aSize -= count;
+
+      if ( (int) m_block.size() == BINARY_BLOCK_SIZE )
+        FlushBlock();
+    }
+  }
+
+  void CDSBinaryWriter::FlushBlock() {
+    if ( m_block.empty() )
+      return;
+
+    int sizes[2] = { (int) m_block.size(), (int) m_block.size() };
+    const std::string* data = &m_block;
+
+    // The block is stored uncompressed if the compression does not help
+    if ( m_compress ) {
+      CompressLZ4( m_block.data(), (int) m_block.size(), m_compressed );
+
+      if ( m_compressed.size() < m_block.size() ) {
+        sizes[1] = (int) m_compressed.size();
+        data = &m_compressed;
+      }
+    }
+
+    Output( sizes, sizeof( sizes ) );
+    Output( data->data(), (int) data->size() );
+    m_block.clear();
+  }
+
+  void CDSBinaryWriter::Output( const void* aData, int aSize ) {
+    if ( !m_started ) {
+      m_started = true;
+
+      Output( BINARY_SIGNATURE, sizeof( BINARY_SIGNATURE ) );
+      Output( &BINARY_VERSION, sizeof( BINARY_VERSION ) );
+    }
+
+    if ( m_file == INVALID_HANDLE_VALUE )
+      m_buffer.append( (const char*) aData, aSize );
+    else if ( !m_failed ) {
+      DWORD written;
+
+      if ( !WriteFile( m_file, aData, aSize, &written, NULL ) || written != (DWORD) aSize )
+        m_failed = true;
+    }
+  }
+
+  CDSBinaryReader::CDSBinaryReader(): m_blockPosition( 0 ), m_file( INVALID_HANDLE_VALUE ),
+    m_data( NULL ), m_dataSize( 0 ), m_end( false ) {}
+
+  CDSBinaryReader::~CDSBinaryReader() {
+    if ( m_file != INVALID_HANDLE_VALUE )
+      CloseHandle( m_file );
+  }
+
+  bool CDSBinaryReader::Open( const char* aFileName ) {
+    if ( m_file != INVALID_HANDLE_VALUE || m_data )
+      return false;
+
+    m_file = CreateFileA( aFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                          FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+
+    return ( m_file != INVALID_HANDLE_VALUE && ReadHeader() );
+  }
+
+  bool CDSBinaryReader::Open( const void* aData, size_t aSize ) {
+    if ( m_file != INVALID_HANDLE_VALUE || m_data || !aData )
+      return false;
+
+    m_data = (const char*) aData;
+    m_dataSize = aSize;
+
+    return ReadHeader();
+  }
+
+  bool CDSBinaryReader::ReadHeader() {
+    char signature[sizeof( BINARY_SIGNATURE )];
+    int version;
+
+    return ( Input( signature, sizeof( signature ) ) && Input( &version, sizeof( version ) ) &&
+             !memcmp( signature, BINARY_SIGNATURE, sizeof( signature ) ) && version == BINARY_VERSION );
+  }
+
+  bool CDSBinaryReader::Input( void* aData, int aSize ) {
+    if ( m_file != INVALID_HANDLE_VALUE ) {
+      DWORD read;
+
+      return ( ReadFile( m_file, aData, aSize, &read, NULL ) && read == (DWORD) aSize );
+    }
+
+    if ( m_dataSize < (size_t) aSize )
+      return false;
+
+    memcpy( aData, m_data, aSize );
+    m_data += aSize;
+    m_dataSize -= aSize;
+
+    return true;
+  }
+
+  bool CDSBinaryReader::ReadBlock() {
+    int sizes[2];
+
+    if ( m_end )
+      return false;
+
+    if ( !Input( sizes, sizeof( sizes ) ) || !sizes[0] ) {
+      m_end = true;
+      return false;
+    }
+
+    if ( sizes[0] < 0 || sizes[0] > BINARY_BLOCK_SIZE || sizes[1] <= 0 || sizes[1] > sizes[0] ) {
+      m_end = true;
+      return false;
+    }
+
+    // Unread data are moved to the beginning of the block
+    m_block.erase( 0, m_blockPosition );
+    m_blockPosition = 0;
+
+    size_t start = m_block.size();
+    m_block.resize( start + sizes[0] );
+
+    bool valid;
+
+    if ( sizes[1] == sizes[0] )
+      valid = Input( &m_block[start], sizes[0] );
+    else {
+      m_compressed.resize( sizes[1] );
+
+      valid = ( Input( &m_compressed[0], sizes[1] ) &&
+                DecompressLZ4( m_compressed.data(), sizes[1], &m_block[start], sizes[0] ) );
+    }
+
+    // Damaged data end the stream
+    if ( !valid ) {
+      m_block.resize( start );
+      m_end = true;
+    }
+
+    return valid;
+  }
+
+  bool CDSBinaryReader::IsAvailable( int aSize ) {
+    if ( aSize < 0 )
+      return false;
+
+    while ( m_block.size() - m_blockPosition < (size_t) aSize ) {
+      if ( !ReadBlock() )
+        return false;
+    }
+
+    return true;
+  }
+
+  bool CDSBinaryReader::ReadBytes( void* aData, int aSize ) {
+    if ( !IsAvailable( aSize ) )
+      return false;
+
+    memcpy( aData, m_block.data() + m_blockPosition, aSize );
+    m_blockPosition += aSize;
+
+    return true;
+  }
+
+}
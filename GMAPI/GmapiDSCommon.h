@@ -0,0 +1,528 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiDSCommon.h                                                     */
+/*   - Classes shared by the native data structures                     */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiInternal.h"
+
+#include <string>
+#include <vector>
+
+namespace gm {
+
+  /************************************************************************/
+  /* CDSValue                                                             */
+  /************************************************************************/
+
+  /// CDSValue
+  ///   Value stored in the native data structures - either real or string.
+  ///   Unlike CGMVariable, strings are held in native memory, so the values
+  ///   can be created, copied and compared without calling the runner.
+  ///   Strings are allocated separately, so that the values stay small
+  ///   and can be swapped in constant time.
+  ///
+  class CDSValue {
+    public:
+      CDSValue(): m_real( 0 ), m_string( NULL ) {}
+      CDSValue( double aValue ): m_real( aValue ), m_string( NULL ) {}
+      CDSValue( int aValue ): m_real( aValue ), m_string( NULL ) {}
+      CDSValue( const char* aValue ): m_real( 0 ), m_string( new std::string( aValue ? aValue : "" ) ) {}
+      CDSValue( const std::string& aValue ): m_real( 0 ), m_string( new std::string( aValue ) ) {}
+
+      CDSValue( const CDSValue& aValue ): m_real( aValue.m_real ),
+        m_string( aValue.m_string ? new std::string( *aValue.m_string ) : NULL ) {}
+
+      /// Ctor( const GMVALUE& aValue )
+      ///   Copies the value passed by the runner (e.g. function argument).
+      ///
+      explicit CDSValue( const GMVALUE& aValue ) {
+        if ( aValue.type == VT_STRING ) {
+          m_real = 0;
+          m_string = new std::string( aValue.string ? aValue.string : "" );
+        } else {
+          m_real = aValue.real;
+          m_string = NULL;
+        }
+      }
+
+      ~CDSValue() {
+        delete m_string;
+      }
+
+      CDSValue& operator=( const CDSValue& aValue ) {
+        CDSValue copy( aValue );
+        Swap( copy );
+
+        return *this;
+      }
+
+      bool IsString() const {
+        return ( m_string != NULL );
+      }
+
+      GMValueType GetType() const {
+        return ( m_string ? VT_STRING : VT_REAL );
+      }
+
+      /// GetReal()
+      ///   Returns the real value, or 0 if the value is a string.
+      ///
+      double GetReal() const {
+        return m_real;
+      }
+
+      /// GetString()
+      ///   Returns the string value, or empty string if the value is real.
+      ///
+      const std::string& GetString() const {
+        return ( m_string ? *m_string : m_emptyString );
+      }
+
+      /// SetResult( PGMVALUE aResult )
+      ///   Stores the value in the result of GM function call. The
+      ///   structure must have been initialized by the runner.
+      ///
+      void SetResult( PGMVALUE aResult ) const {
+        if ( m_string )
+          aResult->Set( m_string->c_str() );
+        else
+          aResult->Set( m_real );
+      }
+
+      /// Compare( const CDSValue& aValue )
+      ///   Compares two values. Reals are ordered before strings.
+      ///
+      /// Returns:
+      ///   Negative number, 0 or positive number if this value is less,
+      ///   equal or greater than aValue.
+      ///
+      int Compare( const CDSValue& aValue ) const {
+        if ( !m_string != !aValue.m_string )
+          return ( m_string ? 1 : -1 );
+
+        if ( m_string )
+          return m_string->compare( *aValue.m_string );
+
+        return ( m_real < aValue.m_real ? -1 : ( m_real > aValue.m_real ? 1 : 0 ) );
+      }
+
+      bool operator==( const CDSValue& aValue ) const {
+        if ( !m_string != !aValue.m_string )
+          return false;
+
+        return ( m_string ? *m_string == *aValue.m_string : m_real == aValue.m_real );
+      }
+
+      bool operator!=( const CDSValue& aValue ) const {
+        return !( *this == aValue );
+      }
+
+      bool operator<( const CDSValue& aValue ) const {
+        return ( Compare( aValue ) < 0 );
+      }
+
+      /// Hash()
+      ///   Computes hash of the value (FNV-1a of the string or scrambled bits
+      ///   of the real value). Equal values have equal hashes.
+      ///
+      unsigned long Hash() const;
+
+      /// Swap( CDSValue& aValue )
+      ///   Exchanges the values without copying the strings.
+      ///
+      void Swap( CDSValue& aValue ) {
+        double real = m_real;
+        std::string* string = m_string;
+
+        m_real = aValue.m_real;
+        m_string = aValue.m_string;
+        aValue.m_real = real;
+        aValue.m_string = string;
+      }
+
+    private:
+      double m_real;
+      std::string* m_string;
+
+      static const std::string m_emptyString;
+  };
+
+  /************************************************************************/
+  /* CDSRegistry                                                          */
+  /************************************************************************/
+
+  /// CDSRegistry
+  ///   Maps IDs of the native data structures to the objects. IDs are
+  ///   assigned the same way as in the runner - the lowest free index
+  ///   is used, so IDs of destroyed structures are reused. The registry
+  ///   owns the objects.
+  ///
+  template<class T>
+  class CDSRegistry {
+    public:
+      ~CDSRegistry() {
+        Clear();
+      }
+
+      /// Add( T* aItem )
+      ///   Takes ownership of the object and returns its ID.
+      ///
+      int Add( T* aItem ) {
+        for ( size_t i = 0; i < m_items.size(); i++ ) {
+          if ( !m_items[i] ) {
+            m_items[i] = aItem;
+            return (int) i;
+          }
+        }
+
+        m_items.push_back( aItem );
+        return (int) m_items.size() - 1;
+      }
+
+      /// Find( int aId )
+      ///   Returns the object with specified ID or NULL if it does not exist.
+      ///
+      T* Find( int aId ) const {
+        if ( aId < 0 || aId >= (int) m_items.size() )
+          return NULL;
+
+        return m_items[aId];
+      }
+
+      /// Get( int aId )
+      ///   Returns the object with specified ID.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIDataStructureNotExist if the object does not exist.
+      ///
+      T& Get( int aId ) const {
+        T* item = Find( aId );
+
+        if ( !item )
+          throw EGMAPIDataStructureNotExist( aId );
+
+        return *item;
+      }
+
+      /// Remove( int aId )
+      ///   Destroys the object with specified ID.
+      ///
+      /// Returns:
+      ///   False if the object did not exist.
+      ///
+      bool Remove( int aId ) {
+        T* item = Find( aId );
+
+        if ( !item )
+          return false;
+
+        delete item;
+        m_items[aId] = NULL;
+
+        while ( !m_items.empty() && !m_items.back() )
+          m_items.pop_back();
+
+        return true;
+      }
+
+      /// Clear()
+      ///   Destroys all objects.
+      ///
+      void Clear() {
+        for ( size_t i = 0; i < m_items.size(); i++ )
+          delete m_items[i];
+
+        m_items.clear();
+      }
+
+      /// GetSize()
+      ///   Returns upper bound of the IDs in use (IDs below this number
+      ///   may refer to destroyed objects - check them with Find).
+      ///
+      int GetSize() const {
+        return (int) m_items.size();
+      }
+
+    private:
+      std::vector<T*> m_items;
+  };
+
+  /************************************************************************/
+  /* CDSWriter, CDSReader                                                 */
+  /************************************************************************/
+
+  /// CDSWriter
+  ///   Base class of the serializers of the native data structures. The
+  ///   structures are written as a stream of little endian integers,
+  ///   doubles and strings; derived classes decide how the bytes are
+  ///   stored (see CDSHexWriter and CDSBinaryWriter).
+  ///
+  class CDSWriter {
+    public:
+      virtual ~CDSWriter() {}
+
+      void WriteInt( int aValue ) {
+        WriteBytes( &aValue, sizeof( aValue ) );
+      }
+
+      void WriteReal( double aValue ) {
+        WriteBytes( &aValue, sizeof( aValue ) );
+      }
+
+      /// WriteValue( const CDSValue& aValue )
+      ///   Writes type of the value (0 - real, 1 - string) followed
+      ///   by the double, or by the string length and characters.
+      ///
+      void WriteValue( const CDSValue& aValue );
+
+    protected:
+      virtual void WriteBytes( const void* aData, int aSize ) = 0;
+  };
+
+  /// CDSReader
+  ///   Base class of the parsers of the streams produced by CDSWriter.
+  ///   All methods return false when the end of the data is reached
+  ///   or the data are invalid.
+  ///
+  class CDSReader {
+    public:
+      virtual ~CDSReader() {}
+
+      bool ReadInt( int& aValue ) {
+        return ReadBytes( &aValue, sizeof( aValue ) );
+      }
+
+      bool ReadReal( double& aValue ) {
+        return ReadBytes( &aValue, sizeof( aValue ) );
+      }
+
+      bool ReadValue( CDSValue& aValue );
+
+      /// IsAvailable( int aSize )
+      ///   Returns true if at least aSize more bytes can be read. Used to
+      ///   validate sizes read from the stream before memory is allocated.
+      ///
+      virtual bool IsAvailable( int aSize ) = 0;
+
+    protected:
+      virtual bool ReadBytes( void* aData, int aSize ) = 0;
+  };
+
+  /// CDSHexWriter
+  ///   Produces strings in the format of the ds_*_write functions: the
+  ///   stream is encoded as a sequence of upper case hexadecimal digits.
+  ///
+  class CDSHexWriter: public CDSWriter {
+    public:
+      /// GetString()
+      ///   Returns the hexadecimal string written so far.
+      ///
+      const std::string& GetString() const {
+        return m_string;
+      }
+
+    protected:
+      virtual void WriteBytes( const void* aData, int aSize );
+
+    private:
+      std::string m_string;
+  };
+
+  /// CDSHexReader
+  ///   Parses strings produced by CDSHexWriter or ds_*_write functions.
+  ///
+  class CDSHexReader: public CDSReader {
+    public:
+      explicit CDSHexReader( const char* aString );
+
+      virtual bool IsAvailable( int aSize );
+
+    protected:
+      virtual bool ReadBytes( void* aData, int aSize );
+
+    private:
+      const char* m_position;
+      const char* m_end;        // Terminator of the string
+  };
+
+  /************************************************************************/
+  /* LZ4 block compression                                                */
+  /************************************************************************/
+
+  /// CompressLZ4( const void* aData, int aSize, std::string& aOutput )
+  ///   Compresses the data into the LZ4 block format, replacing content
+  ///   of aOutput.
+  ///
+  void CompressLZ4( const void* aData, int aSize, std::string& aOutput );
+
+  /// DecompressLZ4( const void* aData, int aSize, char* aOutput, int aOutputSize )
+  ///   Decompresses the LZ4 block, which must expand to exactly
+  ///   aOutputSize bytes.
+  ///
+  /// Returns:
+  ///   False if the block is damaged.
+  ///
+  bool DecompressLZ4( const void* aData, int aSize, char* aOutput, int aOutputSize );
+
+  /************************************************************************/
+  /* CDSBinaryWriter, CDSBinaryReader                                     */
+  /************************************************************************/
+
+  /// CDSBinaryWriter
+  ///   Writes the stream in compact binary form, either to a file or to
+  ///   a native buffer. The data start with the "GMDS" signature and the
+  ///   format version, followed by blocks of at most 64 KB, each prefixed
+  ///   with its original and stored size (a block whose sizes are equal
+  ///   is stored uncompressed) and terminated by an empty block. Blocks
+  ///   are optionally compressed in the LZ4 block format.
+  ///
+  ///   Blocks are written to the file as soon as they are filled, so the
+  ///   whole stream never has to be held in memory.
+  ///
+  class CDSBinaryWriter: public CDSWriter {
+    public:
+      explicit CDSBinaryWriter( bool aCompress = false );
+      virtual ~CDSBinaryWriter();
+
+      /// Open( const char* aFileName )
+      ///   Creates the file and directs the output to it. Without calling
+      ///   this method the data are written to the buffer (GetBuffer).
+      ///
+      /// Returns:
+      ///   False if the file could not be created.
+      ///
+      bool Open( const char* aFileName );
+
+      /// Close()
+      ///   Writes the remaining data and the terminating block, and closes
+      ///   the file. Must be called after the whole stream has been written.
+      ///
+      /// Returns:
+      ///   False if writing to the file has failed.
+      ///
+      bool Close();
+
+      /// GetBuffer()
+      ///   Returns the data written to the buffer; complete after Close.
+      ///
+      const std::string& GetBuffer() const {
+        return m_buffer;
+      }
+
+    protected:
+      virtual void WriteBytes( const void* aData, int aSize );
+
+    private:
+      void FlushBlock();
+      void Output( const void* aData, int aSize );
+
+      std::string m_block;
+      std::string m_compressed;
+      std::string m_buffer;
+      HANDLE m_file;
+      bool m_compress;
+      bool m_started;
+      bool m_failed;
+      bool m_closed;
+  };
+
+  /// CDSBinaryReader
+  ///   Parses the data produced by CDSBinaryWriter from a file or from
+  ///   a native buffer.
+  ///
+  class CDSBinaryReader: public CDSReader {
+    public:
+      CDSBinaryReader();
+      virtual ~CDSBinaryReader();
+
+      /// Open( const char* aFileName )
+      ///   Opens the file and checks its signature.
+      ///
+      /// Returns:
+      ///   False if the file could not be opened or has invalid format.
+      ///
+      bool Open( const char* aFileName );
+
+      /// Open( const void* aData, size_t aSize )
+      ///   Reads the data from the buffer, which must remain valid while
+      ///   the reader is used.
+      ///
+      /// Returns:
+      ///   False if the buffer has invalid format.
+      ///
+      bool Open( const void* aData, size_t aSize );
+
+      virtual bool IsAvailable( int aSize );
+
+    protected:
+      virtual bool ReadBytes( void* aData, int aSize );
+
+    private:
+      bool ReadHeader();
+      bool Input( void* aData, int aSize );
+      bool ReadBlock();
+
+      std::string m_block;
+      std::string m_compressed;
+      size_t m_blockPosition;
+      HANDLE m_file;
+      const char* m_data;
+      size_t m_dataSize;
+      bool m_end;
+  };
+
+  /// SaveDSBinary( const T& aStructure, const char* aFileName, bool aCompress )
+  ///   Writes the native data structure (CDSList, CDSMap, ...) to the
+  ///   binary file.
+  ///
+  /// Returns:
+  ///   False if the file could not be written.
+  ///
+  template<class T>
+  bool SaveDSBinary( const T& aStructure, const char* aFileName, bool aCompress ) {
+    CDSBinaryWriter writer( aCompress );
+
+    if ( !writer.Open( aFileName ) )
+      return false;
+
+    aStructure.Write( writer );
+    return writer.Close();
+  }
+
+  /// LoadDSBinary( T& aStructure, const char* aFileName )
+  ///   Replaces content of the native data structure with the content
+  ///   of the binary file.
+  ///
+  /// Returns:
+  ///   False if the file could not be read or has invalid format.
+  ///
+  template<class T>
+  bool LoadDSBinary( T& aStructure, const char* aFileName ) {
+    CDSBinaryReader reader;
+
+    return ( reader.Open( aFileName ) && aStructure.Read( reader ) );
+  }
+
+}
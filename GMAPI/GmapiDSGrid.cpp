@@ -0,0 +1,1310 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiDSGrid.cpp                                                     */
+/*   - Native implementation of ds_grid                                 */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiDSGrid.h"
+#include "GmapiUtilities.h"
+#include "GmapiMacros.h"
+
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace gm {
+
+  CDSRegistry<CDSGrid>             CDSGrid::m_grids;
+
+  // Header of the ds_grid_write strings
+  static const int GRID_HEADER = 602;
+
+  /************************************************************************/
+  /* Row kernels                                                          */
+  /************************************************************************/
+
+  namespace {
+    CRandom random;
+
+    void AddRow( double* aData, int aCount, double aValue ) {
+      int i = 0;
+
+      if ( CCpuInfo::HasSSE2() ) {
+        __m128d value = _mm_set1_pd( aValue );
+
+        for ( ; i + 4 <= aCount; i += 4 ) {
+          _mm_storeu_pd( aData + i, _mm_add_pd( _mm_loadu_pd( aData + i ), value ) );
+          _mm_storeu_pd( aData + i + 2, _mm_add_pd( _mm_loadu_pd( aData + i + 2 ), value ) );
+        }
+      }
+
+      for ( ; i < aCount; i++ )
+        aData[i] += aValue;
+    }
+
+    void MultiplyRow( double* aData, int aCount, double aValue ) {
+      int i = 0;
+
+      if ( CCpuInfo::HasSSE2() ) {
+        __m128d value = _mm_set1_pd( aValue );
+
+        for ( ; i + 4 <= aCount; i += 4 ) {
+          _mm_storeu_pd( aData + i, _mm_mul_pd( _mm_loadu_pd( aData + i ), value ) );
+          _mm_storeu_pd( aData + i + 2, _mm_mul_pd( _mm_loadu_pd( aData + i + 2 ), value ) );
+        }
+      }
+
+      for ( ; i < aCount; i++ )
+        aData[i] *= aValue;
+    }
+
+    void AddRows( double* aData, const double* aSource, int aCount ) {
+      int i = 0;
+
+      if ( CCpuInfo::HasSSE2() ) {
+        for ( ; i + 2 <= aCount; i += 2 )
+          _mm_storeu_pd( aData + i, _mm_add_pd( _mm_loadu_pd( aData + i ), _mm_loadu_pd( aSource + i ) ) );
+      }
+
+      for ( ; i < aCount; i++ )
+        aData[i] += aSource[i];
+    }
+
+    void MultiplyRows( double* aData, const double* aSource, int aCount ) {
+      int i = 0;
+
+      if ( CCpuInfo::HasSSE2() ) {
+        for ( ; i + 2 <= aCount; i += 2 )
+          _mm_storeu_pd( aData + i, _mm_mul_pd( _mm_loadu_pd( aData + i ), _mm_loadu_pd( aSource + i ) ) );
+      }
+
+      for ( ; i < aCount; i++ )
+        aData[i] *= aSource[i];
+    }
+
+    // Computes sum, minimum and maximum of the row in a single pass (aCount > 0)
+    void RowStatistics( const double* aData, int aCount, double& aSum, double& aMin, double& aMax ) {
+      double sum = 0, min = aData[0], max = aData[0];
+      int i = 0;
+
+      if ( CCpuInfo::HasSSE2() && aCount >= 4 ) {
+        __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+        __m128d min0 = _mm_set1_pd( aData[0] ), max0 = min0;
+
+        for ( ; i + 4 <= aCount; i += 4 ) {
+          __m128d value0 = _mm_loadu_pd( aData + i );
+          __m128d value1 = _mm_loadu_pd( aData + i + 2 );
+
+          sum0 = _mm_add_pd( sum0, value0 );
+          sum1 = _mm_add_pd( sum1, value1 );
+          min0 = _mm_min_pd( min0, _mm_min_pd( value0, value1 ) );
+          max0 = _mm_max_pd( max0, _mm_max_pd( value0, value1 ) );
+        }
+
+        double lanes[2];
+
+        _mm_storeu_pd( lanes, _mm_add_pd( sum0, sum1 ) );
+        sum = lanes[0] + lanes[1];
+        _mm_storeu_pd( lanes, min0 );
+        min = ( lanes[0] < lanes[1] ? lanes[0] : lanes[1] );
+        _mm_storeu_pd( lanes, max0 );
+        max = ( lanes[0] > lanes[1] ? lanes[0] : lanes[1] );
+      }
+
+      for ( ; i < aCount; i++ ) {
+        sum += aData[i];
+        if ( aData[i] < min ) min = aData[i];
+        if ( aData[i] > max ) max = aData[i];
+      }
+
+      aSum = sum;
+      aMin = min;
+      aMax = max;
+    }
+
+    inline void Order( int& aValue1, int& aValue2 ) {
+      if ( aValue1 > aValue2 )
+        std::swap( aValue1, aValue2 );
+    }
+  }
+
+  /************************************************************************/
+  /* CDSGrid class implementation                                         */
+  /************************************************************************/
+
+  CDSGrid::CDSGrid( int aWidth, int aHeight ):
+    m_width( aWidth > 0 ? aWidth : 0 ), m_height( aHeight > 0 ? aHeight : 0 ),
+    m_reals( m_width * m_height, 0.0 ), m_tableEnabled( false ), m_tableValid( false ) {}
+
+  int CDSGrid::Create( int aWidth, int aHeight ) {
+    return m_grids.Add( new CDSGrid( aWidth, aHeight ) );
+  }
+
+  bool CDSGrid::Destroy( int aId ) {
+    return m_grids.Remove( aId );
+  }
+
+  bool CDSGrid::ClampDiskRows( int aYm, int aR, int& aY1, int& aY2 ) const {
+    // Computed in doubles, the disk may be far outside the grid
+    double y1 = (double) aYm - aR, y2 = (double) aYm + aR;
+
+    if ( aR < 0 || y2 < 0 || y1 >= m_height )
+      return false;
+
+    aY1 = ( y1 > 0 ? (int) y1 : 0 );
+    aY2 = ( y2 < m_height - 1 ? (int) y2 : m_height - 1 );
+
+    return true;
+  }
+
+  bool CDSGrid::ClampDiskRow( int aXm, int aR, double aDy, int& aX1, int& aX2 ) const {
+    // Half width of the row: cells with dx^2 + dy^2 <= r^2
+    double half = floor( sqrt( (double) aR * aR - aDy * aDy ) );
+    double x1 = aXm - half, x2 = aXm + half;
+
+    if ( x2 < 0 || x1 >= m_width )
+      return false;
+
+    aX1 = ( x1 > 0 ? (int) x1 : 0 );
+    aX2 = ( x2 < m_width - 1 ? (int) x2 : m_width - 1 );
+
+    return true;
+  }
+
+  bool CDSGrid::ClampRegion( int& aX1, int& aY1, int& aX2, int& aY2 ) const {
+    Order( aX1, aX2 );
+    Order( aY1, aY2 );
+
+    if ( aX2 < 0 || aY2 < 0 || aX1 >= m_width || aY1 >= m_height )
+      return false;
+
+    if ( aX1 < 0 ) aX1 = 0;
+    if ( aY1 < 0 ) aY1 = 0;
+    if ( aX2 >= m_width ) aX2 = m_width - 1;
+    if ( aY2 >= m_height ) aY2 = m_height - 1;
+
+    return true;
+  }
+
+  void CDSGrid::Resize( int aWidth, int aHeight ) {
+    if ( aWidth < 0 ) aWidth = 0;
+    if ( aHeight < 0 ) aHeight = 0;
+
+    std::vector<double> reals( aWidth * aHeight, 0.0 );
+    StringMap strings;
+    int width = std::min( aWidth, m_width );
+
+    for ( int y = 0; y < std::min( aHeight, m_height ) && width > 0; y++ )
+      memcpy( &reals[y * aWidth], &m_reals[y * m_width], width * sizeof( double ) );
+
+    for ( StringMap::iterator it = m_strings.begin(); it != m_strings.end(); ++it ) {
+      int x = it->first % m_width, y = it->first / m_width;
+
+      if ( x < aWidth && y < aHeight )
+        strings[y * aWidth + x].swap( it->second );
+    }
+
+    m_width = aWidth;
+    m_height = aHeight;
+    m_reals.swap( reals );
+    m_strings.swap( strings );
+    m_tableValid = false;
+  }
+
+  void CDSGrid::Clear( const CDSValue& aValue ) {
+    m_strings.clear();
+    std::fill( m_reals.begin(), m_reals.end(), ( aValue.IsString() ? 0.0 : aValue.GetReal() ) );
+
+    if ( aValue.IsString() ) {
+      for ( int i = 0; i < (int) m_reals.size(); i++ )
+        m_strings.insert( m_strings.end(), std::make_pair( i, aValue.GetString() ) );
+    }
+
+    m_tableValid = false;
+  }
+
+  CDSValue CDSGrid::GetValue( int aX, int aY ) const {
+    if ( aX < 0 || aY < 0 || aX >= m_width || aY >= m_height )
+      return CDSValue();
+
+    int index = aY * m_width + aX;
+
+    if ( !m_strings.empty() ) {
+      StringMap::const_iterator it = m_strings.find( index );
+
+      if ( it != m_strings.end() )
+        return CDSValue( it->second );
+    }
+
+    return CDSValue( m_reals[index] );
+  }
+
+  void CDSGrid::ApplyCell( int aIndex, Operation aOperation, const CDSValue& aValue ) {
+    StringMap::iterator it = ( m_strings.empty() ? m_strings.end() : m_strings.find( aIndex ) );
+    bool isString = ( it != m_strings.end() );
+
+    if ( aOperation == OP_SET ) {
+      if ( aValue.IsString() ) {
+        if ( isString )
+          it->second = aValue.GetString();
+        else
+          m_strings[aIndex] = aValue.GetString();
+
+        m_reals[aIndex] = 0;
+      } else {
+        if ( isString )
+          m_strings.erase( it );
+
+        m_reals[aIndex] = aValue.GetReal();
+      }
+    } else if ( isString == aValue.IsString() ) {
+      if ( isString ) {
+        if ( aOperation == OP_ADD )
+          it->second += aValue.GetString();
+      } else if ( aOperation == OP_ADD )
+        m_reals[aIndex] += aValue.GetReal();
+      else
+        m_reals[aIndex] *= aValue.GetReal();
+    }
+  }
+
+  void CDSGrid::ApplyRow( int aY, int aX1, int aX2, Operation aOperation, const CDSValue& aValue ) {
+    int first = aY * m_width + aX1, count = aX2 - aX1 + 1;
+
+    if ( aValue.IsString() ) {
+      for ( int i = first; i < first + count; i++ )
+        ApplyCell( i, aOperation, aValue );
+
+      return;
+    }
+
+    double* data = &m_reals[first];
+
+    if ( aOperation == OP_SET )
+      std::fill( data, data + count, aValue.GetReal() );
+    else if ( aOperation == OP_ADD )
+      AddRow( data, count, aValue.GetReal() );
+    else
+      MultiplyRow( data, count, aValue.GetReal() );
+
+    if ( m_strings.empty() )
+      return;
+
+    // Real values never change string cells, but the data under them must stay 0
+    StringMap::iterator it = m_strings.lower_bound( first );
+    StringMap::iterator end = m_strings.lower_bound( first + count );
+
+    if ( aOperation == OP_SET )
+      m_strings.erase( it, end );
+    else {
+      for ( ; it != end; ++it )
+        m_reals[it->first] = 0;
+    }
+  }
+
+  void CDSGrid::ApplyRegion( int aX1, int aY1, int aX2, int aY2, Operation aOperation, const CDSValue& aValue ) {
+    if ( !ClampRegion( aX1, aY1, aX2, aY2 ) )
+      return;
+
+    for ( int y = aY1; y <= aY2; y++ )
+      ApplyRow( y, aX1, aX2, aOperation, aValue );
+
+    m_tableValid = false;
+  }
+
+  void CDSGrid::ApplyDisk( int aXm, int aYm, int aR, Operation aOperation, const CDSValue& aValue ) {
+    int y1, y2, x1, x2;
+
+    if ( !ClampDiskRows( aYm, aR, y1, y2 ) )
+      return;
+
+    for ( int y = y1; y <= y2; y++ ) {
+      if ( ClampDiskRow( aXm, aR, (double) y - aYm, x1, x2 ) )
+        ApplyRow( y, x1, x2, aOperation, aValue );
+    }
+
+    m_tableValid = false;
+  }
+
+  void CDSGrid::ApplyGridRegion( const CDSGrid& aSource, int aX1, int aY1, int aX2, int aY2,
+                                 int aXPos, int aYPos, Operation aOperation ) {
+    if ( &aSource == this ) {
+      // Source and destination may overlap
+      CDSGrid source( *this );
+      ApplyGridRegion( source, aX1, aY1, aX2, aY2, aXPos, aYPos, aOperation );
+      return;
+    }
+
+    Order( aX1, aX2 );
+    Order( aY1, aY2 );
+
+    // Clip the source region to both grids, moving the destination accordingly
+    int left = std::max( std::max( aX1, 0 ), aX1 - aXPos );
+    int top = std::max( std::max( aY1, 0 ), aY1 - aYPos );
+    int right = std::min( std::min( aX2, aSource.m_width - 1 ), aX1 - aXPos + m_width - 1 );
+    int bottom = std::min( std::min( aY2, aSource.m_height - 1 ), aY1 - aYPos + m_height - 1 );
+
+    if ( left > right || top > bottom )
+      return;
+
+    int count = right - left + 1;
+    bool fast = ( m_strings.empty() && aSource.m_strings.empty() );
+
+    for ( int y = top; y <= bottom; y++ ) {
+      int destinationY = y - aY1 + aYPos, destinationX = left - aX1 + aXPos;
+      double* data = &m_reals[destinationY * m_width + destinationX];
+      const double* source = &aSource.m_reals[y * aSource.m_width + left];
+
+      if ( !fast ) {
+        for ( int x = 0; x < count; x++ )
+          ApplyCell( destinationY * m_width + destinationX + x, aOperation, aSource.GetValue( left + x, y ) );
+      } else if ( aOperation == OP_SET )
+        memcpy( data, source, count * sizeof( double ) );
+      else if ( aOperation == OP_ADD )
+        AddRows( data, source, count );
+      else
+        MultiplyRows( data, source, count );
+    }
+
+    m_tableValid = false;
+  }
+
+  void CDSGrid::Set( int aX, int aY, const CDSValue& aValue ) {
+    if ( aX >= 0 && aY >= 0 && aX < m_width && aY < m_height ) {
+      ApplyCell( aY * m_width + aX, OP_SET, aValue );
+      m_tableValid = false;
+    }
+  }
+
+  void CDSGrid::Add( int aX, int aY, const CDSValue& aValue ) {
+    if ( aX >= 0 && aY >= 0 && aX < m_width && aY < m_height ) {
+      ApplyCell( aY * m_width + aX, OP_ADD, aValue );
+      m_tableValid = false;
+    }
+  }
+
+  void CDSGrid::Multiply( int aX, int aY, const CDSValue& aValue ) {
+    if ( aX >= 0 && aY >= 0 && aX < m_width && aY < m_height ) {
+      ApplyCell( aY * m_width + aX, OP_MULTIPLY, aValue );
+      m_tableValid = false;
+    }
+  }
+
+  void CDSGrid::SetRegion( int aX1, int aY1, int aX2, int aY2, const CDSValue& aValue ) {
+    ApplyRegion( aX1, aY1, aX2, aY2, OP_SET, aValue );
+  }
+
+  void CDSGrid::AddRegion( int aX1, int aY1, int aX2, int aY2, const CDSValue& aValue ) {
+    ApplyRegion( aX1, aY1, aX2, aY2, OP_ADD, aValue );
+  }
+
+  void CDSGrid::MultiplyRegion( int aX1, int aY1, int aX2, int aY2, const CDSValue& aValue ) {
+    ApplyRegion( aX1, aY1, aX2, aY2, OP_MULTIPLY, aValue );
+  }
+
+  void CDSGrid::SetDisk( int aXm, int aYm, int aR, const CDSValue& aValue ) {
+    ApplyDisk( aXm, aYm, aR, OP_SET, aValue );
+  }
+
+  void CDSGrid::AddDisk( int aXm, int aYm, int aR, const CDSValue& aValue ) {
+    ApplyDisk( aXm, aYm, aR, OP_ADD, aValue );
+  }
+
+  void CDSGrid::MultiplyDisk( int aXm, int aYm, int aR, const CDSValue& aValue ) {
+    ApplyDisk( aXm, aYm, aR, OP_MULTIPLY, aValue );
+  }
+
+  void CDSGrid::SetGridRegion( const CDSGrid& aSource, int aX1, int aY1, int aX2, int aY2,
+                               int aXPos, int aYPos ) {
+    ApplyGridRegion( aSource, aX1, aY1, aX2, aY2, aXPos, aYPos, OP_SET );
+  }
+
+  void CDSGrid::AddGridRegion( const CDSGrid& aSource, int aX1, int aY1, int aX2, int aY2,
+                               int aXPos, int aYPos ) {
+    ApplyGridRegion( aSource, aX1, aY1, aX2, aY2, aXPos, aYPos, OP_ADD );
+  }
+
+  void CDSGrid::MultiplyGridRegion( const CDSGrid& aSource, int aX1, int aY1, int aX2, int aY2,
+                                    int aXPos, int aYPos ) {
+    ApplyGridRegion( aSource, aX1, aY1, aX2, aY2, aXPos, aYPos, OP_MULTIPLY );
+  }
+
+  void CDSGrid::RowStatistics( int aY, int aX1, int aX2, STATISTICS& aStatistics ) const {
+    int first = aY * m_width + aX1, last = aY * m_width + aX2;
+    double sum, min, max;
+
+    if ( m_strings.empty() ) {
+      gm::RowStatistics( &m_reals[first], last - first + 1, sum, min, max );
+
+      aStatistics.min = ( aStatistics.count && aStatistics.min < min ? aStatistics.min : min );
+      aStatistics.max = ( aStatistics.count && aStatistics.max > max ? aStatistics.max : max );
+      aStatistics.sum += sum;
+      aStatistics.count += last - first + 1;
+      return;
+    }
+
+    // String cells are skipped
+    StringMap::const_iterator it = m_strings.lower_bound( first );
+
+    for ( int i = first; i <= last; i++ ) {
+      if ( it != m_strings.end() && it->first == i ) {
+        ++it;
+        continue;
+      }
+
+      double value = m_reals[i];
+
+      if ( !aStatistics.count || value < aStatistics.min ) aStatistics.min = value;
+      if ( !aStatistics.count || value > aStatistics.max ) aStatistics.max = value;
+      aStatistics.sum += value;
+      ++aStatistics.count;
+    }
+  }
+
+  CDSGrid::STATISTICS CDSGrid::RegionStatistics( int aX1, int aY1, int aX2, int aY2 ) const {
+    STATISTICS statistics = { 0, 0, 0, 0 };
+
+    if ( ClampRegion( aX1, aY1, aX2, aY2 ) ) {
+      for ( int y = aY1; y <= aY2; y++ )
+        RowStatistics( y, aX1, aX2, statistics );
+    }
+
+    return statistics;
+  }
+
+  CDSGrid::STATISTICS CDSGrid::DiskStatistics( int aXm, int aYm, int aR ) const {
+    STATISTICS statistics = { 0, 0, 0, 0 };
+
+    int y1, y2, x1, x2;
+
+    if ( !ClampDiskRows( aYm, aR, y1, y2 ) )
+      return statistics;
+
+    for ( int y = y1; y <= y2; y++ ) {
+      if ( ClampDiskRow( aXm, aR, (double) y - aYm, x1, x2 ) )
+        RowStatistics( y, x1, x2, statistics );
+    }
+
+    return statistics;
+  }
+
+  bool CDSGrid::UseTable() const {
+    if ( !m_tableEnabled || !m_strings.empty() )
+      return false;
+
+    UpdateTable();
+    return true;
+  }
+
+  void CDSGrid::UpdateTable() const {
+    if ( m_tableValid )
+      return;
+
+    // table[(y + 1) * (width + 1) + x + 1] is the sum of cells [0..x] x [0..y]
+    int stride = m_width + 1;
+    m_table.assign( stride * ( m_height + 1 ), 0.0 );
+
+    for ( int y = 0; y < m_height; y++ ) {
+      const double* row = &m_reals[y * m_width];
+      double* previous = &m_table[y * stride];
+      double* current = &m_table[( y + 1 ) * stride];
+      double rowSum = 0;
+
+      for ( int x = 0; x < m_width; x++ ) {
+        rowSum += row[x];
+        current[x + 1] = previous[x + 1] + rowSum;
+      }
+    }
+
+    m_tableValid = true;
+  }
+
+  double CDSGrid::TableSum( int aX1, int aY1, int aX2, int aY2 ) const {
+    int stride = m_width + 1;
+
+    return m_table[( aY2 + 1 ) * stride + aX2 + 1] - m_table[aY1 * stride + aX2 + 1] -
+           m_table[( aY2 + 1 ) * stride + aX1] + m_table[aY1 * stride + aX1];
+  }
+
+  double CDSGrid::GetSum( int aX1, int aY1, int aX2, int aY2 ) const {
+    if ( UseTable() )
+      return ( ClampRegion( aX1, aY1, aX2, aY2 ) ? TableSum( aX1, aY1, aX2, aY2 ) : 0.0 );
+
+    return RegionStatistics( aX1, aY1, aX2, aY2 ).sum;
+  }
+
+  double CDSGrid::GetMax( int aX1, int aY1, int aX2, int aY2 ) const {
+    STATISTICS statistics = RegionStatistics( aX1, aY1, aX2, aY2 );
+
+    return ( statistics.count ? statistics.max : 0.0 );
+  }
+
+  double CDSGrid::GetMin( int aX1, int aY1, int aX2, int aY2 ) const {
+    STATISTICS statistics = RegionStatistics( aX1, aY1, aX2, aY2 );
+
+    return ( statistics.count ? statistics.min : 0.0 );
+  }
+
+  double CDSGrid::GetMean( int aX1, int aY1, int aX2, int aY2 ) const {
+    if ( UseTable() ) {
+      if ( !ClampRegion( aX1, aY1, aX2, aY2 ) )
+        return 0.0;
+
+      return TableSum( aX1, aY1, aX2, aY2 ) / ( ( aX2 - aX1 + 1 ) * ( aY2 - aY1 + 1 ) );
+    }
+
+    STATISTICS statistics = RegionStatistics( aX1, aY1, aX2, aY2 );
+
+    return ( statistics.count ? statistics.sum / statistics.count : 0.0 );
+  }
+
+  double CDSGrid::GetDiskSum( int aXm, int aYm, int aR ) const {
+    if ( aR < 0 || !UseTable() )
+      return DiskStatistics( aXm, aYm, aR ).sum;
+
+    // Sum of the disk rows, each in constant time
+    int y1, y2, x1, x2;
+    double sum = 0;
+
+    if ( !ClampDiskRows( aYm, aR, y1, y2 ) )
+      return sum;
+
+    for ( int y = y1; y <= y2; y++ ) {
+      if ( ClampDiskRow( aXm, aR, (double) y - aYm, x1, x2 ) )
+        sum += TableSum( x1, y, x2, y );
+    }
+
+    return sum;
+  }
+
+  double CDSGrid::GetDiskMax( int aXm, int aYm, int aR ) const {
+    STATISTICS statistics = DiskStatistics( aXm, aYm, aR );
+
+    return ( statistics.count ? statistics.max : 0.0 );
+  }
+
+  double CDSGrid::GetDiskMin( int aXm, int aYm, int aR ) const {
+    STATISTICS statistics = DiskStatistics( aXm, aYm, aR );
+
+    return ( statistics.count ? statistics.min : 0.0 );
+  }
+
+  double CDSGrid::GetDiskMean( int aXm, int aYm, int aR ) const {
+    STATISTICS statistics = DiskStatistics( aXm, aYm, aR );
+
+    return ( statistics.count ? statistics.sum / statistics.count : 0.0 );
+  }
+
+  bool CDSGrid::FindInRow( int aY, int aX1, int aX2, const CDSValue& aValue, int& aX ) const {
+    int first = aY * m_width + aX1, last = aY * m_width + aX2;
+
+    if ( aValue.IsString() ) {
+      StringMap::const_iterator it = m_strings.lower_bound( first );
+
+      for ( ; it != m_strings.end() && it->first <= last; ++it ) {
+        if ( it->second == aValue.GetString() ) {
+          aX = it->first - aY * m_width;
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    double value = aValue.GetReal();
+
+    for ( int i = first; i <= last; i++ ) {
+      if ( m_reals[i] == value && ( m_strings.empty() || !m_strings.count( i ) ) ) {
+        aX = i - aY * m_width;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool CDSGrid::FindValue( int aX1, int aY1, int aX2, int aY2, const CDSValue& aValue, int& aX, int& aY ) const {
+    if ( !ClampRegion( aX1, aY1, aX2, aY2 ) )
+      return false;
+
+    for ( int y = aY1; y <= aY2; y++ ) {
+      if ( FindInRow( y, aX1, aX2, aValue, aX ) ) {
+        aY = y;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool CDSGrid::FindDiskValue( int aXm, int aYm, int aR, const CDSValue& aValue, int& aX, int& aY ) const {
+    int y1, y2, x1, x2;
+
+    if ( !ClampDiskRows( aYm, aR, y1, y2 ) )
+      return false;
+
+    for ( int y = y1; y <= y2; y++ ) {
+      if ( ClampDiskRow( aXm, aR, (double) y - aYm, x1, x2 ) && FindInRow( y, x1, x2, aValue, aX ) ) {
+        aY = y;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void CDSGrid::SetSummedAreaTable( bool aEnabled ) {
+    m_tableEnabled = aEnabled;
+    m_tableValid = false;
+
+    if ( !aEnabled )
+      std::vector<double>().swap( m_table );
+  }
+
+  void CDSGrid::Shuffle() {
+    int count = (int) m_reals.size();
+
+    if ( m_strings.empty() ) {
+      for ( int i = count - 1; i > 0; i-- )
+        std::swap( m_reals[i], m_reals[(int) ( random.NextDouble() * ( i + 1 ) )] );
+    } else {
+      // Shuffle positions, then move both the reals and the strings
+      std::vector<int> positions( count );
+
+      for ( int i = 0; i < count; i++ )
+        positions[i] = i;
+
+      for ( int i = count - 1; i > 0; i-- )
+        std::swap( positions[i], positions[(int) ( random.NextDouble() * ( i + 1 ) )] );
+
+      std::vector<double> reals( count );
+      std::vector<int> destinations( count );
+      StringMap strings;
+
+      for ( int i = 0; i < count; i++ ) {
+        reals[i] = m_reals[positions[i]];
+        destinations[positions[i]] = i;
+      }
+
+      for ( StringMap::iterator it = m_strings.begin(); it != m_strings.end(); ++it )
+        strings[destinations[it->first]].swap( it->second );
+
+      m_reals.swap( reals );
+      m_strings.swap( strings );
+    }
+
+    m_tableValid = false;
+  }
+
+  std::string CDSGrid::Write() const {
+    CDSHexWriter writer;
+    Write( writer );
+
+    return writer.GetString();
+  }
+
+  void CDSGrid::Write( CDSWriter& aWriter ) const {
+    aWriter.WriteInt( GRID_HEADER );
+    aWriter.WriteInt( m_width );
+    aWriter.WriteInt( m_height );
+
+    // Column by column, like the runner stores the grids
+    for ( int x = 0; x < m_width; x++ )
+      for ( int y = 0; y < m_height; y++ )
+        aWriter.WriteValue( GetValue( x, y ) );
+  }
+
+  bool CDSGrid::Read( const char* aString ) {
+    CDSHexReader reader( aString );
+    return Read( reader );
+  }
+
+  bool CDSGrid::Read( CDSReader& aReader ) {
+    int header, width, height;
+
+    if ( !aReader.ReadInt( header ) || header != GRID_HEADER || !aReader.ReadInt( width ) ||
+         !aReader.ReadInt( height ) || width < 0 || height < 0 ||
+         ( height && width > 0x7FFFFFFF / height ) )
+      return false;
+
+    // Every value takes at least 8 bytes, so the size can be verified
+    // before anything is allocated
+    if ( width * height > 0x7FFFFFFF / 8 || !aReader.IsAvailable( width * height * 8 ) )
+      return false;
+
+    // Values are read into a temporary grid, so that this one is not
+    // changed when the string is not valid
+    CDSGrid grid( width, height );
+    CDSValue value;
+
+    for ( int x = 0; x < width; x++ ) {
+      for ( int y = 0; y < height; y++ ) {
+        if ( !aReader.ReadValue( value ) )
+          return false;
+
+        grid.ApplyCell( y * width + x, OP_SET, value );
+      }
+    }
+
+    m_width = width;
+    m_height = height;
+    m_reals.swap( grid.m_reals );
+    m_strings.swap( grid.m_strings );
+    m_tableValid = false;
+
+    return true;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    inline int IntArg( const GMVALUE* aArgs, int aIndex ) {
+      return (int) aArgs[aIndex].real;
+    }
+
+    inline CDSGrid& GridArg( const GMVALUE* aArgs ) {
+      return CDSGrid::Get( (int) aArgs[0].real );
+    }
+
+    void DsGridCreate( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CDSGrid::Create( IntArg( aArgs, 0 ), IntArg( aArgs, 1 ) ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridCreate )
+
+    void DsGridDestroy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      CDSGrid::Destroy( IntArg( aArgs, 0 ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridDestroy )
+
+    void DsGridCopy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                     int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSGrid& grid = GridArg( aArgs );
+        const CDSGrid& source = CDSGrid::Get( IntArg( aArgs, 1 ) );
+        bool table = grid.GetSummedAreaTable();
+
+        grid = source;
+        grid.SetSummedAreaTable( table );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridCopy )
+
+    void DsGridResize( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).Resize( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridResize )
+
+    void DsGridWidth( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                      int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( (double) GridArg( aArgs ).GetWidth() );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridWidth )
+
+    void DsGridHeight( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( (double) GridArg( aArgs ).GetHeight() );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridHeight )
+
+    void DsGridClear( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                      int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).Clear( CDSValue( aArgs[1] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridClear )
+
+    void DsGridSet( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                    int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).Set( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), CDSValue( aArgs[3] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridSet )
+
+    void DsGridAdd( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                    int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).Add( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), CDSValue( aArgs[3] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridAdd )
+
+    void DsGridMultiply( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).Multiply( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), CDSValue( aArgs[3] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridMultiply )
+
+    void DsGridSetRegion( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).SetRegion( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ),
+                                    IntArg( aArgs, 4 ), CDSValue( aArgs[5] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridSetRegion )
+
+    void DsGridAddRegion( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).AddRegion( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ),
+                                    IntArg( aArgs, 4 ), CDSValue( aArgs[5] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridAddRegion )
+
+    void DsGridMultiplyRegion( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                               int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).MultiplyRegion( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ),
+                                         IntArg( aArgs, 4 ), CDSValue( aArgs[5] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridMultiplyRegion )
+
+    void DsGridSetDisk( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).SetDisk( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ),
+                                  CDSValue( aArgs[4] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridSetDisk )
+
+    void DsGridAddDisk( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).AddDisk( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ),
+                                  CDSValue( aArgs[4] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridAddDisk )
+
+    void DsGridMultiplyDisk( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).MultiplyDisk( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ),
+                                       CDSValue( aArgs[4] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridMultiplyDisk )
+
+    void DsGridSetGridRegion( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).SetGridRegion( CDSGrid::Get( IntArg( aArgs, 1 ) ), IntArg( aArgs, 2 ),
+                                        IntArg( aArgs, 3 ), IntArg( aArgs, 4 ), IntArg( aArgs, 5 ),
+                                        IntArg( aArgs, 6 ), IntArg( aArgs, 7 ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridSetGridRegion )
+
+    void DsGridAddGridRegion( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).AddGridRegion( CDSGrid::Get( IntArg( aArgs, 1 ) ), IntArg( aArgs, 2 ),
+                                        IntArg( aArgs, 3 ), IntArg( aArgs, 4 ), IntArg( aArgs, 5 ),
+                                        IntArg( aArgs, 6 ), IntArg( aArgs, 7 ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridAddGridRegion )
+
+    void DsGridMultiplyGridRegion( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                   int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).MultiplyGridRegion( CDSGrid::Get( IntArg( aArgs, 1 ) ), IntArg( aArgs, 2 ),
+                                             IntArg( aArgs, 3 ), IntArg( aArgs, 4 ), IntArg( aArgs, 5 ),
+                                             IntArg( aArgs, 6 ), IntArg( aArgs, 7 ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridMultiplyGridRegion )
+
+    void DsGridGet( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                    int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).GetValue( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ) ).SetResult( aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridGet )
+
+    void DsGridGetSum( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( GridArg( aArgs ).GetSum( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ),
+                                               IntArg( aArgs, 3 ), IntArg( aArgs, 4 ) ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridGetSum )
+
+    void DsGridGetMax( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( GridArg( aArgs ).GetMax( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ),
+                                               IntArg( aArgs, 3 ), IntArg( aArgs, 4 ) ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridGetMax )
+
+    void DsGridGetMin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( GridArg( aArgs ).GetMin( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ),
+                                               IntArg( aArgs, 3 ), IntArg( aArgs, 4 ) ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridGetMin )
+
+    void DsGridGetMean( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( GridArg( aArgs ).GetMean( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ),
+                                                IntArg( aArgs, 3 ), IntArg( aArgs, 4 ) ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridGetMean )
+
+    void DsGridGetDiskSum( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( GridArg( aArgs ).GetDiskSum( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ) ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridGetDiskSum )
+
+    void DsGridGetDiskMin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( GridArg( aArgs ).GetDiskMin( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ) ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridGetDiskMin )
+
+    void DsGridGetDiskMax( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( GridArg( aArgs ).GetDiskMax( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ) ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridGetDiskMax )
+
+    void DsGridGetDiskMean( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( GridArg( aArgs ).GetDiskMean( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ) ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridGetDiskMean )
+
+    // value_exists, value_x and value_y share the search; aResultType
+    // selects the returned value (0 - exists, 1 - x, 2 - y)
+    void FindValueResult( bool aFound, int aX, int aY, int aResultType, PGMVALUE aResult ) {
+      if ( aResultType == 0 )
+        aResult->Set( aFound ? 1.0 : 0.0 );
+      else
+        aResult->Set( aFound ? (double) ( aResultType == 1 ? aX : aY ) : -1.0 );
+    }
+
+    void GridValue( GMVALUE* aArgs, int aResultType, PGMVALUE aResult ) {
+      try {
+        int x = -1, y = -1;
+        bool found = GridArg( aArgs ).FindValue( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ),
+                                                 IntArg( aArgs, 4 ), CDSValue( aArgs[5] ), x, y );
+
+        FindValueResult( found, x, y, aResultType, aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    void GridDiskValue( GMVALUE* aArgs, int aResultType, PGMVALUE aResult ) {
+      try {
+        int x = -1, y = -1;
+        bool found = GridArg( aArgs ).FindDiskValue( IntArg( aArgs, 1 ), IntArg( aArgs, 2 ), IntArg( aArgs, 3 ),
+                                                     CDSValue( aArgs[4] ), x, y );
+
+        FindValueResult( found, x, y, aResultType, aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    void DsGridValueExists( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      GridValue( aArgs, 0, aResult );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridValueExists )
+
+    void DsGridValueX( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      GridValue( aArgs, 1, aResult );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridValueX )
+
+    void DsGridValueY( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      GridValue( aArgs, 2, aResult );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridValueY )
+
+    void DsGridValueDiskExists( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                int aArgCount, PGMVALUE aResult ) {
+      GridDiskValue( aArgs, 0, aResult );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridValueDiskExists )
+
+    void DsGridValueDiskX( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      GridDiskValue( aArgs, 1, aResult );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridValueDiskX )
+
+    void DsGridValueDiskY( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      GridDiskValue( aArgs, 2, aResult );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridValueDiskY )
+
+    void DsGridShuffle( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).Shuffle();
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridShuffle )
+
+    void DsGridWrite( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                      int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( GridArg( aArgs ).Write().c_str() );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridWrite )
+
+    void DsGridRead( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                     int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).Read( aArgs[1].type == VT_STRING ? aArgs[1].string : "" );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridRead )
+
+    void DsGridSetSummedArea( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      try {
+        GridArg( aArgs ).SetSummedAreaTable( aArgs[1].real >= 0.5 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridSetSummedArea )
+
+    void DsGridSaveBin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+               int aArgCount, PGMVALUE aResult ) {
+      try {
+        bool saved = SaveDSBinary( CDSGrid::Get( (int) aArgs[0].real ),
+                                   ( aArgs[1].type == VT_STRING ? aArgs[1].string : "" ), aArgs[2].real >= 0.5 );
+
+        aResult->Set( saved ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridSaveBin )
+
+    void DsGridLoadBin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+               int aArgCount, PGMVALUE aResult ) {
+      try {
+        bool loaded = LoadDSBinary( CDSGrid::Get( (int) aArgs[0].real ),
+                                    ( aArgs[1].type == VT_STRING ? aArgs[1].string : "" ) );
+
+        aResult->Set( loaded ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsGridLoadBin )
+  }
+
+  void CDSGrid::RegisterGMFunctions() {
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_create, DsGridCreate );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_destroy, DsGridDestroy );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_delete, DsGridDestroy );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_copy, DsGridCopy );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_resize, DsGridResize );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_width, DsGridWidth );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_height, DsGridHeight );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_clear, DsGridClear );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_set, DsGridSet );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_add, DsGridAdd );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_multiply, DsGridMultiply );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_set_region, DsGridSetRegion );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_add_region, DsGridAddRegion );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_multiply_region, DsGridMultiplyRegion );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_set_disk, DsGridSetDisk );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_add_disk, DsGridAddDisk );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_multiply_disk, DsGridMultiplyDisk );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_set_grid_region, DsGridSetGridRegion );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_add_grid_region, DsGridAddGridRegion );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_multiply_grid_region, DsGridMultiplyGridRegion );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_get, DsGridGet );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_get_sum, DsGridGetSum );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_get_max, DsGridGetMax );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_get_min, DsGridGetMin );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_get_mean, DsGridGetMean );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_get_disk_sum, DsGridGetDiskSum );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_get_disk_min, DsGridGetDiskMin );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_get_disk_max, DsGridGetDiskMax );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_get_disk_mean, DsGridGetDiskMean );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_value_exists, DsGridValueExists );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_value_x, DsGridValueX );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_value_y, DsGridValueY );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_value_disk_exists, DsGridValueDiskExists );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_value_disk_x, DsGridValueDiskX );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_value_disk_y, DsGridValueDiskY );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_shuffle, DsGridShuffle );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_write, DsGridWrite );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_grid_read, DsGridRead );
+
+    GMAPI_GMFUNCTION_REGISTER( "ds_grid_set_summed_area", 2, DsGridSetSummedArea );
+    GMAPI_GMFUNCTION_REGISTER( "ds_grid_save_bin", 3, DsGridSaveBin );
+    GMAPI_GMFUNCTION_REGISTER( "ds_grid_load_bin", 2, DsGridLoadBin );
+  }
+
+#endif
+
+}
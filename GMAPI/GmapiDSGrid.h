@@ -0,0 +1,302 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiDSGrid.h                                                       */
+/*   - Native implementation of ds_grid                                 */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiDSCommon.h"
+
+#include <map>
+
+namespace gm {
+
+  /// CDSGrid
+  ///   Native two-dimensional grid compatible with ds_grid. Real values
+  ///   are stored in one contiguous array (row by row), so that the region
+  ///   and disk operations run over whole rows using SSE2 when available.
+  ///   Cells holding strings are kept separately; they are treated as 0
+  ///   by the arithmetic functions and skipped by the statistics.
+  ///
+  ///   Sums of regions can be answered in constant time from a summed-area
+  ///   table (see SetSummedAreaTable), which is rebuilt lazily after the
+  ///   grid has changed.
+  ///
+  ///   Regions are clamped to the grid and their corners may be passed in
+  ///   any order. After RegisterGMFunctions has been called, all ds_grid_*
+  ///   functions operate on native grids.
+  ///
+  class CDSGrid {
+    public:
+      CDSGrid( int aWidth, int aHeight );
+
+      /************************************************************************/
+      /* Grid management                                                      */
+      /************************************************************************/
+
+      /// Create( int aWidth, int aHeight )
+      ///   Creates new grid filled with zeros.
+      ///
+      /// Returns:
+      ///   ID of the grid.
+      ///
+      static int Create( int aWidth, int aHeight );
+
+      /// Destroy( int aId )
+      ///   Destroys the grid.
+      ///
+      /// Returns:
+      ///   False if the grid did not exist.
+      ///
+      static bool Destroy( int aId );
+
+      /// Find( int aId )
+      ///   Returns the grid with specified ID or NULL if it does not exist.
+      ///
+      static CDSGrid* Find( int aId ) {
+        return m_grids.Find( aId );
+      }
+
+      /// Get( int aId )
+      ///   Returns the grid with specified ID.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIDataStructureNotExist if the grid does not exist.
+      ///
+      static CDSGrid& Get( int aId ) {
+        return m_grids.Get( aId );
+      }
+
+      /// GetRegistry()
+      ///   Returns the registry of all native grids.
+      ///
+      static const CDSRegistry<CDSGrid>& GetRegistry() {
+        return m_grids;
+      }
+
+      /************************************************************************/
+      /* Cells                                                                */
+      /************************************************************************/
+
+      int GetWidth() const {
+        return m_width;
+      }
+
+      int GetHeight() const {
+        return m_height;
+      }
+
+      /// GetData()
+      ///   Returns pointer to the real values (GetWidth() * GetHeight()
+      ///   doubles, row by row). Cells holding strings contain 0. When the
+      ///   data are modified directly, Invalidate must be called afterwards.
+      ///
+      double* GetData() {
+        return ( m_reals.empty() ? NULL : &m_reals[0] );
+      }
+
+      /// Invalidate()
+      ///   Notifies the grid that its data have been modified via GetData.
+      ///
+      void Invalidate() {
+        m_tableValid = false;
+      }
+
+      /// Resize( int aWidth, int aHeight )
+      ///   Changes size of the grid. Values of the remaining cells are kept,
+      ///   new cells are set to 0.
+      ///
+      void Resize( int aWidth, int aHeight );
+
+      /// Clear( const CDSValue& aValue )
+      ///   Sets all cells to the value.
+      ///
+      void Clear( const CDSValue& aValue );
+
+      /// GetValue( int aX, int aY )
+      ///   Returns value of the cell, or 0 if the cell is outside the grid.
+      ///
+      CDSValue GetValue( int aX, int aY ) const;
+
+      /// Set( int aX, int aY, const CDSValue& aValue ), Add( ... ), Multiply( ... )
+      ///   Set, add to or multiply the cell. Adding string to a string cell
+      ///   concatenates the strings; other combinations with strings are
+      ///   ignored by Add and Multiply.
+      ///
+      void Set( int aX, int aY, const CDSValue& aValue );
+      void Add( int aX, int aY, const CDSValue& aValue );
+      void Multiply( int aX, int aY, const CDSValue& aValue );
+
+      /************************************************************************/
+      /* Regions                                                              */
+      /************************************************************************/
+
+      void SetRegion( int aX1, int aY1, int aX2, int aY2, const CDSValue& aValue );
+      void AddRegion( int aX1, int aY1, int aX2, int aY2, const CDSValue& aValue );
+      void MultiplyRegion( int aX1, int aY1, int aX2, int aY2, const CDSValue& aValue );
+
+      void SetDisk( int aXm, int aYm, int aR, const CDSValue& aValue );
+      void AddDisk( int aXm, int aYm, int aR, const CDSValue& aValue );
+      void MultiplyDisk( int aXm, int aYm, int aR, const CDSValue& aValue );
+
+      /// SetGridRegion( const CDSGrid& aSource, int aX1, int aY1, int aX2, int aY2,
+      ///                int aXPos, int aYPos )
+      ///   Copies region of the source grid (which may be this grid) to the
+      ///   position in this grid. AddGridRegion and MultiplyGridRegion add or
+      ///   multiply the values instead.
+      ///
+      void SetGridRegion( const CDSGrid& aSource, int aX1, int aY1, int aX2, int aY2,
+                          int aXPos, int aYPos );
+      void AddGridRegion( const CDSGrid& aSource, int aX1, int aY1, int aX2, int aY2,
+                          int aXPos, int aYPos );
+      void MultiplyGridRegion( const CDSGrid& aSource, int aX1, int aY1, int aX2, int aY2,
+                               int aXPos, int aYPos );
+
+      /************************************************************************/
+      /* Statistics and searching                                             */
+      /************************************************************************/
+
+      double GetSum( int aX1, int aY1, int aX2, int aY2 ) const;
+      double GetMax( int aX1, int aY1, int aX2, int aY2 ) const;
+      double GetMin( int aX1, int aY1, int aX2, int aY2 ) const;
+      double GetMean( int aX1, int aY1, int aX2, int aY2 ) const;
+
+      double GetDiskSum( int aXm, int aYm, int aR ) const;
+      double GetDiskMax( int aXm, int aYm, int aR ) const;
+      double GetDiskMin( int aXm, int aYm, int aR ) const;
+      double GetDiskMean( int aXm, int aYm, int aR ) const;
+
+      /// FindValue( int aX1, int aY1, int aX2, int aY2, const CDSValue& aValue, int& aX, int& aY )
+      ///   Searches the region (row by row) for the value.
+      ///
+      /// Returns:
+      ///   True if the value has been found; its position is stored in aX, aY.
+      ///
+      bool FindValue( int aX1, int aY1, int aX2, int aY2, const CDSValue& aValue, int& aX, int& aY ) const;
+
+      /// FindDiskValue( int aXm, int aYm, int aR, const CDSValue& aValue, int& aX, int& aY )
+      ///   Searches the disk for the value. See FindValue.
+      ///
+      bool FindDiskValue( int aXm, int aYm, int aR, const CDSValue& aValue, int& aX, int& aY ) const;
+
+      /************************************************************************/
+      /* Miscellaneous                                                        */
+      /************************************************************************/
+
+      /// SetSummedAreaTable( bool aEnabled )
+      ///   Enables or disables the summed-area table used by GetSum, GetMean
+      ///   and GetDiskSum. It pays off when sums are queried more often than
+      ///   the grid changes. The table is not used while the grid holds
+      ///   any strings.
+      ///
+      void SetSummedAreaTable( bool aEnabled );
+
+      bool GetSummedAreaTable() const {
+        return m_tableEnabled;
+      }
+
+      /// Shuffle()
+      ///   Randomly reorders the cells.
+      ///
+      void Shuffle();
+
+      /// Write()
+      ///   Native version of ds_grid_write.
+      ///
+      std::string Write() const;
+
+      /// Write( CDSWriter& aWriter )
+      ///   Writes the grid to the stream, e.g. CDSBinaryWriter.
+      ///
+      void Write( CDSWriter& aWriter ) const;
+
+      /// Read( const char* aString )
+      ///   Native version of ds_grid_read. Replaces size and content of the grid.
+      ///
+      /// Returns:
+      ///   False if the string is not a valid grid string; the grid is not
+      ///   changed then.
+      ///
+      bool Read( const char* aString );
+
+      /// Read( CDSReader& aReader )
+      ///   Reads the grid from the stream. See Read( const char* aString ).
+      ///
+      bool Read( CDSReader& aReader );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Replaces all ds_grid_* GML functions with the native versions and
+      ///   registers the following GML functions:
+      ///     ds_grid_set_summed_area( id, enabled )
+      ///     ds_grid_save_bin( id, fname, compress ) - returns true on success
+      ///     ds_grid_load_bin( id, fname ) - returns true on success
+      ///   Errors, e.g. a grid that does not exist, are reported with a
+      ///   message box (EGMAPIException::ShowError), like the runner does.
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      typedef std::map<int, std::string> StringMap;
+
+      enum Operation { OP_SET, OP_ADD, OP_MULTIPLY };
+
+      struct STATISTICS {
+        double sum, min, max;
+        int count;
+      };
+
+      bool ClampRegion( int& aX1, int& aY1, int& aX2, int& aY2 ) const;
+      void ApplyCell( int aIndex, Operation aOperation, const CDSValue& aValue );
+      void ApplyRow( int aY, int aX1, int aX2, Operation aOperation, const CDSValue& aValue );
+      void ApplyRegion( int aX1, int aY1, int aX2, int aY2, Operation aOperation, const CDSValue& aValue );
+      void ApplyDisk( int aXm, int aYm, int aR, Operation aOperation, const CDSValue& aValue );
+      void ApplyGridRegion( const CDSGrid& aSource, int aX1, int aY1, int aX2, int aY2,
+                            int aXPos, int aYPos, Operation aOperation );
+
+      void RowStatistics( int aY, int aX1, int aX2, STATISTICS& aStatistics ) const;
+      STATISTICS RegionStatistics( int aX1, int aY1, int aX2, int aY2 ) const;
+      STATISTICS DiskStatistics( int aXm, int aYm, int aR ) const;
+      bool FindInRow( int aY, int aX1, int aX2, const CDSValue& aValue, int& aX ) const;
+
+      bool UseTable() const;
+      void UpdateTable() const;
+      double TableSum( int aX1, int aY1, int aX2, int aY2 ) const;
+
+      bool ClampDiskRows( int aYm, int aR, int& aY1, int& aY2 ) const;
+      bool ClampDiskRow( int aXm, int aR, double aDy, int& aX1, int& aX2 ) const;
+
+      int m_width;
+      int m_height;
+      std::vector<double> m_reals;
+      StringMap m_strings;
+
+      bool m_tableEnabled;
+      mutable bool m_tableValid;
+      mutable std::vector<double> m_table;
+
+      static CDSRegistry<CDSGrid> m_grids;
+  };
+
+}
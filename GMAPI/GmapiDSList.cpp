@@ -0,0 +1,663 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiDSList.cpp                                                     */
+/*   - Native implementation of ds_list                                 */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiDSList.h"
+#include "GmapiUtilities.h"
+#include "GmapiMacros.h"
+
+#include <emmintrin.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+
+namespace gm {
+
+  CDSRegistry<CDSList> CDSList::m_lists;
+
+  // Header of the ds_list_write strings
+  static const int LIST_HEADER = 301;
+
+  // Lists shorter than this are sorted by std::sort instead of radix sort
+  static const int RADIX_SORT_THRESHOLD = 256;
+
+  /************************************************************************/
+  /* Searching and sorting of reals                                       */
+  /************************************************************************/
+
+  namespace {
+    CRandom random;
+
+    // Returns position of the first occurrence of aValue in the array, or -1
+    int FindReal( const double* aData, int aCount, double aValue ) {
+      int i = 0;
+
+      if ( CCpuInfo::HasSSE2() ) {
+        __m128d value = _mm_set1_pd( aValue );
+
+        for ( ; i + 4 <= aCount; i += 4 ) {
+          int mask = _mm_movemask_pd( _mm_cmpeq_pd( _mm_loadu_pd( aData + i ), value ) ) |
+                     ( _mm_movemask_pd( _mm_cmpeq_pd( _mm_loadu_pd( aData + i + 2 ), value ) ) << 2 );
+
+          if ( mask ) {
+            while ( !( mask & 1 ) ) {
+              mask >>= 1;
+              ++i;
+            }
+
+            return i;
+          }
+        }
+      }
+
+      for ( ; i < aCount; i++ ) {
+        if ( aData[i] == aValue )
+          return i;
+      }
+
+      return -1;
+    }
+
+    // Doubles converted to unsigned integers with the same order
+    struct RADIXKEY {
+      unsigned int low;
+      unsigned int high;
+    };
+
+    inline RADIXKEY ToKey( double aValue ) {
+      RADIXKEY key;
+      memcpy( &key, &aValue, sizeof( key ) );
+
+      if ( key.high & 0x80000000 ) {
+        key.high = ~key.high;
+        key.low = ~key.low;
+      } else
+        key.high ^= 0x80000000;
+
+      return key;
+    }
+
+    inline double FromKey( RADIXKEY aKey ) {
+      double value;
+
+      if ( aKey.high & 0x80000000 )
+        aKey.high ^= 0x80000000;
+      else {
+        aKey.high = ~aKey.high;
+        aKey.low = ~aKey.low;
+      }
+
+      memcpy( &value, &aKey, sizeof( value ) );
+      return value;
+    }
+
+    inline unsigned int Digit( const RADIXKEY& aKey, int aPass ) {
+      return ( ( aPass < 2 ? aKey.low : aKey.high ) >> ( ( aPass & 1 ) * 16 ) ) & 0xFFFF;
+    }
+
+    // LSD radix sort with 16-bit digits; passes in which all keys have
+    // the same digit are skipped. Descending order is written from the end
+    void RadixSort( double* aValues, int aCount, bool aAscending ) {
+      std::vector<RADIXKEY> keys( aCount ), buffer( aCount );
+      std::vector<int> counts( 0x10000 );
+
+      for ( int i = 0; i < aCount; i++ )
+        keys[i] = ToKey( aValues[i] );
+
+      for ( int pass = 0; pass < 4; pass++ ) {
+        std::fill( counts.begin(), counts.end(), 0 );
+
+        for ( int i = 0; i < aCount; i++ )
+          ++counts[Digit( keys[i], pass )];
+
+        if ( counts[Digit( keys[0], pass )] == aCount )
+          continue;
+
+        for ( int digit = 0, offset = 0; digit < 0x10000; digit++ ) {
+          int count = counts[digit];
+          counts[digit] = offset;
+          offset += count;
+        }
+
+        for ( int i = 0; i < aCount; i++ )
+          buffer[counts[Digit( keys[i], pass )]++] = keys[i];
+
+        keys.swap( buffer );
+      }
+
+      for ( int i = 0; i < aCount; i++ )
+        aValues[aAscending ? i : aCount - 1 - i] = FromKey( keys[i] );
+    }
+
+    void SortReals( double* aValues, int aCount, bool aAscending ) {
+      if ( aCount >= RADIX_SORT_THRESHOLD )
+        RadixSort( aValues, aCount, aAscending );
+      else if ( aAscending )
+        std::sort( aValues, aValues + aCount );
+      else
+        std::sort( aValues, aValues + aCount, std::greater<double>() );
+    }
+
+    bool LessString( const std::string* aString1, const std::string* aString2 ) {
+      return ( *aString1 < *aString2 );
+    }
+
+    bool GreaterString( const std::string* aString1, const std::string* aString2 ) {
+      return ( *aString2 < *aString1 );
+    }
+  }
+
+  /************************************************************************/
+  /* CDSList class implementation                                         */
+  /************************************************************************/
+
+  CDSList::CDSList(): m_stringCount( 0 ) {}
+
+  CDSList::CDSList( const CDSList& aList ): m_reals( aList.m_reals ),
+    m_strings( aList.m_strings.size(), (std::string*) NULL ), m_stringCount( aList.m_stringCount ) {
+
+    if ( m_stringCount ) {
+      for ( size_t i = 0; i < m_strings.size(); i++ ) {
+        if ( aList.m_strings[i] )
+          m_strings[i] = new std::string( *aList.m_strings[i] );
+      }
+    }
+  }
+
+  CDSList::~CDSList() {
+    Clear();
+  }
+
+  CDSList& CDSList::operator=( const CDSList& aList ) {
+    if ( &aList != this ) {
+      CDSList copy( aList );
+
+      m_reals.swap( copy.m_reals );
+      m_strings.swap( copy.m_strings );
+      std::swap( m_stringCount, copy.m_stringCount );
+    }
+
+    return *this;
+  }
+
+  int CDSList::Create() {
+    return m_lists.Add( new CDSList() );
+  }
+
+  bool CDSList::Destroy( int aId ) {
+    return m_lists.Remove( aId );
+  }
+
+  void CDSList::Clear() {
+    if ( m_stringCount ) {
+      for ( size_t i = 0; i < m_strings.size(); i++ )
+        delete m_strings[i];
+    }
+
+    m_reals.clear();
+    m_strings.clear();
+    m_stringCount = 0;
+  }
+
+  void CDSList::Add( const CDSValue& aValue ) {
+    Insert( GetSize(), aValue );
+  }
+
+  void CDSList::AppendRange( const double* aValues, int aCount ) {
+    if ( aCount <= 0 )
+      return;
+
+    m_reals.insert( m_reals.end(), aValues, aValues + aCount );
+    m_strings.resize( m_reals.size(), NULL );
+  }
+
+  void CDSList::AppendRange( const std::vector<CDSValue>& aValues ) {
+    m_reals.reserve( m_reals.size() + aValues.size() );
+    m_strings.reserve( m_strings.size() + aValues.size() );
+
+    for ( size_t i = 0; i < aValues.size(); i++ )
+      Add( aValues[i] );
+  }
+
+  void CDSList::CopyTo( std::vector<double>& aValues ) const {
+    aValues = m_reals;
+  }
+
+  void CDSList::CopyTo( std::vector<CDSValue>& aValues ) const {
+    aValues.resize( m_reals.size() );
+
+    for ( size_t i = 0; i < m_reals.size(); i++ ) {
+      if ( m_strings[i] )
+        aValues[i] = CDSValue( *m_strings[i] );
+      else
+        aValues[i] = CDSValue( m_reals[i] );
+    }
+  }
+
+  bool CDSList::Insert( int aPosition, const CDSValue& aValue ) {
+    if ( aPosition < 0 || aPosition > GetSize() )
+      return false;
+
+    std::string* string = ( aValue.IsString() ? new std::string( aValue.GetString() ) : NULL );
+
+    m_reals.insert( m_reals.begin() + aPosition, aValue.GetReal() );
+    m_strings.insert( m_strings.begin() + aPosition, string );
+
+    if ( string )
+      ++m_stringCount;
+
+    return true;
+  }
+
+  bool CDSList::Replace( int aPosition, const CDSValue& aValue ) {
+    if ( aPosition < 0 || aPosition >= GetSize() )
+      return false;
+
+    std::string*& string = m_strings[aPosition];
+
+    if ( aValue.IsString() ) {
+      if ( string )
+        *string = aValue.GetString();
+      else {
+        string = new std::string( aValue.GetString() );
+        ++m_stringCount;
+      }
+    } else if ( string ) {
+      delete string;
+      string = NULL;
+      --m_stringCount;
+    }
+
+    m_reals[aPosition] = aValue.GetReal();
+    return true;
+  }
+
+  bool CDSList::Delete( int aPosition ) {
+    if ( aPosition < 0 || aPosition >= GetSize() )
+      return false;
+
+    if ( m_strings[aPosition] ) {
+      delete m_strings[aPosition];
+      --m_stringCount;
+    }
+
+    m_reals.erase( m_reals.begin() + aPosition );
+    m_strings.erase( m_strings.begin() + aPosition );
+
+    return true;
+  }
+
+  CDSValue CDSList::GetValue( int aPosition ) const {
+    if ( aPosition < 0 || aPosition >= GetSize() )
+      return CDSValue();
+
+    if ( m_strings[aPosition] )
+      return CDSValue( *m_strings[aPosition] );
+
+    return CDSValue( m_reals[aPosition] );
+  }
+
+  int CDSList::FindIndex( const CDSValue& aValue ) const {
+    int count = GetSize();
+
+    if ( aValue.IsString() ) {
+      for ( int i = 0; i < count && m_stringCount; i++ ) {
+        if ( m_strings[i] && *m_strings[i] == aValue.GetString() )
+          return i;
+      }
+
+      return -1;
+    }
+
+    // String elements hold 0, so the matches have to be checked
+    for ( int i = 0; i < count; i++ ) {
+      int found = FindReal( &m_reals[i], count - i, aValue.GetReal() );
+
+      if ( found < 0 )
+        return -1;
+
+      i += found;
+
+      if ( !m_strings[i] )
+        return i;
+    }
+
+    return -1;
+  }
+
+  void CDSList::Sort( bool aAscending ) {
+    if ( m_reals.empty() )
+      return;
+
+    if ( !m_stringCount )
+      SortReals( &m_reals[0], GetSize(), aAscending );
+    else {
+      // Reals go first, strings after them, in both orders
+      int count = GetSize(), realCount = count - m_stringCount;
+      std::vector<std::string*> strings;
+
+      strings.reserve( m_stringCount );
+
+      for ( int i = 0, j = 0; i < count; i++ ) {
+        if ( m_strings[i] )
+          strings.push_back( m_strings[i] );
+        else
+          m_reals[j++] = m_reals[i];
+      }
+
+      std::fill( m_reals.begin() + realCount, m_reals.end(), 0.0 );
+      std::fill( m_strings.begin(), m_strings.begin() + realCount, (std::string*) NULL );
+      std::sort( strings.begin(), strings.end(), aAscending ? LessString : GreaterString );
+      std::copy( strings.begin(), strings.end(), m_strings.begin() + realCount );
+
+      if ( realCount )
+        SortReals( &m_reals[0], realCount, aAscending );
+    }
+  }
+
+  void CDSList::Shuffle() {
+    for ( int i = GetSize() - 1; i > 0; i-- ) {
+      int j = (int) ( random.NextDouble() * ( i + 1 ) );
+
+      std::swap( m_reals[i], m_reals[j] );
+      std::swap( m_strings[i], m_strings[j] );
+    }
+  }
+
+  std::string CDSList::Write() const {
+    CDSHexWriter writer;
+    Write( writer );
+
+    return writer.GetString();
+  }
+
+  void CDSList::Write( CDSWriter& aWriter ) const {
+    aWriter.WriteInt( LIST_HEADER );
+    aWriter.WriteInt( GetSize() );
+
+    for ( int i = 0; i < GetSize(); i++ )
+      aWriter.WriteValue( GetValue( i ) );
+  }
+
+  bool CDSList::Read( const char* aString ) {
+    CDSHexReader reader( aString );
+    return Read( reader );
+  }
+
+  bool CDSList::Read( CDSReader& aReader ) {
+    int header, count;
+
+    Clear();
+
+    if ( !aReader.ReadInt( header ) || header != LIST_HEADER ||
+         !aReader.ReadInt( count ) || count < 0 )
+      return false;
+
+    CDSValue value;
+
+    for ( int i = 0; i < count; i++ ) {
+      if ( !aReader.ReadValue( value ) ) {
+        Clear();
+        return false;
+      }
+
+      Add( value );
+    }
+
+    return true;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    void DsListCreate( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CDSList::Create() );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListCreate )
+
+    void DsListDestroy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      CDSList::Destroy( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListDestroy )
+
+    void DsListClear( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                      int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSList::Get( (int) aArgs[0].real ).Clear();
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListClear )
+
+    void DsListCopy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                     int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSList::Get( (int) aArgs[0].real ) = CDSList::Get( (int) aArgs[1].real );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListCopy )
+
+    void DsListSize( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                     int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( (double) CDSList::Get( (int) aArgs[0].real ).GetSize() );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListSize )
+
+    void DsListEmpty( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                      int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( CDSList::Get( (int) aArgs[0].real ).IsEmpty() ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListEmpty )
+
+    void DsListAdd( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                    int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSList& list = CDSList::Get( (int) aArgs[0].real );
+
+        for ( int i = 1; i < aArgCount; i++ )
+          list.Add( CDSValue( aArgs[i] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListAdd )
+
+    void DsListInsert( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSList::Get( (int) aArgs[0].real ).Insert( (int) aArgs[1].real, CDSValue( aArgs[2] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListInsert )
+
+    void DsListReplace( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSList::Get( (int) aArgs[0].real ).Replace( (int) aArgs[1].real, CDSValue( aArgs[2] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListReplace )
+
+    void DsListDelete( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSList::Get( (int) aArgs[0].real ).Delete( (int) aArgs[1].real );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListDelete )
+
+    void DsListFindIndex( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( (double) CDSList::Get( (int) aArgs[0].real ).FindIndex( CDSValue( aArgs[1] ) ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListFindIndex )
+
+    void DsListFindValue( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSList::Get( (int) aArgs[0].real ).GetValue( (int) aArgs[1].real ).SetResult( aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListFindValue )
+
+    void DsListSort( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                     int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSList::Get( (int) aArgs[0].real ).Sort( aArgs[1].real >= 0.5 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListSort )
+
+    void DsListShuffle( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSList::Get( (int) aArgs[0].real ).Shuffle();
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListShuffle )
+
+    void DsListWrite( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                      int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( CDSList::Get( (int) aArgs[0].real ).Write().c_str() );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListWrite )
+
+    void DsListRead( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                     int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSList::Get( (int) aArgs[0].real ).Read( aArgs[1].type == VT_STRING ? aArgs[1].string : "" );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListRead )
+
+    void DsListSaveBin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+               int aArgCount, PGMVALUE aResult ) {
+      try {
+        bool saved = SaveDSBinary( CDSList::Get( (int) aArgs[0].real ),
+                                   ( aArgs[1].type == VT_STRING ? aArgs[1].string : "" ), aArgs[2].real >= 0.5 );
+
+        aResult->Set( saved ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListSaveBin )
+
+    void DsListLoadBin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+               int aArgCount, PGMVALUE aResult ) {
+      try {
+        bool loaded = LoadDSBinary( CDSList::Get( (int) aArgs[0].real ),
+                                    ( aArgs[1].type == VT_STRING ? aArgs[1].string : "" ) );
+
+        aResult->Set( loaded ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsListLoadBin )
+  }
+
+  void CDSList::RegisterGMFunctions() {
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_create, DsListCreate );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_destroy, DsListDestroy );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_clear, DsListClear );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_copy, DsListCopy );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_size, DsListSize );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_empty, DsListEmpty );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_add, DsListAdd );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_insert, DsListInsert );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_replace, DsListReplace );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_delete, DsListDelete );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_find_index, DsListFindIndex );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_find_value, DsListFindValue );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_sort, DsListSort );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_shuffle, DsListShuffle );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_write, DsListWrite );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_list_read, DsListRead );
+
+    GMAPI_GMFUNCTION_REGISTER( "ds_list_save_bin", 3, DsListSaveBin );
+    GMAPI_GMFUNCTION_REGISTER( "ds_list_load_bin", 2, DsListLoadBin );
+  }
+
+#endif
+
+}
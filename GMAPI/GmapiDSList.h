@@ -0,0 +1,251 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiDSList.h                                                       */
+/*   - Native implementation of ds_list                                 */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiDSCommon.h"
+
+namespace gm {
+
+  /// CDSList
+  ///   Native list compatible with ds_list. Real values are stored in one
+  ///   contiguous array, so that whole lists can be filled or read by the
+  ///   DLL at once (AppendRange, CopyTo, GetData) and real values can be
+  ///   searched using SSE2. Strings are kept in a parallel array of
+  ///   pointers; the real value of string elements is 0.
+  ///
+  ///   Lists holding only reals are sorted by radix sort, other lists by
+  ///   sorting the reals and the strings separately (reals are ordered
+  ///   before strings).
+  ///
+  ///   After RegisterGMFunctions has been called, all ds_list_* functions
+  ///   operate on native lists.
+  ///
+  class CDSList {
+    public:
+      CDSList();
+      CDSList( const CDSList& aList );
+      ~CDSList();
+
+      CDSList& operator=( const CDSList& aList );
+
+      /************************************************************************/
+      /* List management                                                      */
+      /************************************************************************/
+
+      /// Create()
+      ///   Creates new list.
+      ///
+      /// Returns:
+      ///   ID of the list.
+      ///
+      static int Create();
+
+      /// Destroy( int aId )
+      ///   Destroys the list.
+      ///
+      /// Returns:
+      ///   False if the list did not exist.
+      ///
+      static bool Destroy( int aId );
+
+      /// Find( int aId )
+      ///   Returns the list with specified ID or NULL if it does not exist.
+      ///
+      static CDSList* Find( int aId ) {
+        return m_lists.Find( aId );
+      }
+
+      /// Get( int aId )
+      ///   Returns the list with specified ID.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIDataStructureNotExist if the list does not exist.
+      ///
+      static CDSList& Get( int aId ) {
+        return m_lists.Get( aId );
+      }
+
+      /// GetRegistry()
+      ///   Returns the registry of all native lists.
+      ///
+      static const CDSRegistry<CDSList>& GetRegistry() {
+        return m_lists;
+      }
+
+      /************************************************************************/
+      /* List content                                                         */
+      /************************************************************************/
+
+      int GetSize() const {
+        return (int) m_reals.size();
+      }
+
+      bool IsEmpty() const {
+        return m_reals.empty();
+      }
+
+      /// HasStrings()
+      ///   Returns true if any element of the list is a string.
+      ///
+      bool HasStrings() const {
+        return ( m_stringCount > 0 );
+      }
+
+      /// GetData()
+      ///   Returns pointer to the real values of the elements (GetSize()
+      ///   doubles), or NULL if the list is empty. String elements contain 0.
+      ///   The pointer is valid until the size of the list is changed.
+      ///
+      const double* GetData() const {
+        return ( m_reals.empty() ? NULL : &m_reals[0] );
+      }
+
+      /// Clear()
+      ///   Removes all elements.
+      ///
+      void Clear();
+
+      /// Add( const CDSValue& aValue )
+      ///   Appends the value to the end of the list.
+      ///
+      void Add( const CDSValue& aValue );
+
+      /// AppendRange( const double* aValues, int aCount )
+      ///   Appends aCount real values to the end of the list.
+      ///
+      void AppendRange( const double* aValues, int aCount );
+
+      /// AppendRange( const std::vector<CDSValue>& aValues )
+      ///   Appends the values to the end of the list.
+      ///
+      void AppendRange( const std::vector<CDSValue>& aValues );
+
+      /// CopyTo( std::vector<double>& aValues )
+      ///   Replaces content of the vector with the real values of the
+      ///   elements (string elements are copied as 0).
+      ///
+      void CopyTo( std::vector<double>& aValues ) const;
+
+      /// CopyTo( std::vector<CDSValue>& aValues )
+      ///   Replaces content of the vector with the elements.
+      ///
+      void CopyTo( std::vector<CDSValue>& aValues ) const;
+
+      /// Insert( int aPosition, const CDSValue& aValue )
+      ///   Inserts the value before the element at specified position
+      ///   (position equal to the size appends the value).
+      ///
+      /// Returns:
+      ///   False if the position is out of range.
+      ///
+      bool Insert( int aPosition, const CDSValue& aValue );
+
+      /// Replace( int aPosition, const CDSValue& aValue )
+      ///   Replaces the element at specified position.
+      ///
+      /// Returns:
+      ///   False if the position is out of range.
+      ///
+      bool Replace( int aPosition, const CDSValue& aValue );
+
+      /// Delete( int aPosition )
+      ///   Removes the element at specified position.
+      ///
+      /// Returns:
+      ///   False if the position is out of range.
+      ///
+      bool Delete( int aPosition );
+
+      /// GetValue( int aPosition )
+      ///   Returns the element at specified position, or 0 if the position
+      ///   is out of range.
+      ///
+      CDSValue GetValue( int aPosition ) const;
+
+      /// FindIndex( const CDSValue& aValue )
+      ///   Returns position of the first occurrence of the value, or -1
+      ///   if the list does not contain it.
+      ///
+      int FindIndex( const CDSValue& aValue ) const;
+
+      /// Sort( bool aAscending )
+      ///   Sorts the list. Reals are ordered before strings in both
+      ///   orders; when descending, reals and strings are each sorted
+      ///   from the highest.
+      ///
+      void Sort( bool aAscending );
+
+      /// Shuffle()
+      ///   Randomly reorders the elements.
+      ///
+      void Shuffle();
+
+      /// Write()
+      ///   Native version of ds_list_write.
+      ///
+      std::string Write() const;
+
+      /// Write( CDSWriter& aWriter )
+      ///   Writes the list to the stream, e.g. CDSBinaryWriter.
+      ///
+      void Write( CDSWriter& aWriter ) const;
+
+      /// Read( const char* aString )
+      ///   Native version of ds_list_read. Replaces content of the list.
+      ///
+      /// Returns:
+      ///   False if the string is not a valid list string; the list is
+      ///   then left empty.
+      ///
+      bool Read( const char* aString );
+
+      /// Read( CDSReader& aReader )
+      ///   Reads the list from the stream. See Read( const char* aString ).
+      ///
+      bool Read( CDSReader& aReader );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Replaces all ds_list_* GML functions with the native versions and
+      ///   registers the following GML functions:
+      ///     ds_list_save_bin( id, fname, compress ) - returns true on success
+      ///     ds_list_load_bin( id, fname ) - returns true on success
+      ///   ds_list_add accepts several values to append.
+      ///   Errors, e.g. a list that does not exist, are reported with a
+      ///   message box (EGMAPIException::ShowError), like the runner does.
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      std::vector<double> m_reals;
+      std::vector<std::string*> m_strings; // NULL for real elements
+      int m_stringCount;
+
+      static CDSRegistry<CDSList> m_lists;
+  };
+
+}
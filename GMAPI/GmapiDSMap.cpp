@@ -0,0 +1,589 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiDSMap.cpp                                                      */
+/*   - Native implementation of ds_map                                  */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiDSMap.h"
+#include "GmapiMacros.h"
+
+#include <algorithm>
+
+namespace gm {
+
+  CDSRegistry<CDSMap> CDSMap::m_maps;
+
+  // Header of the ds_map_write strings
+  static const int MAP_HEADER = 401;
+
+  // Smallest capacity of the hash table; the capacity is always power of 2
+  static const size_t MIN_CAPACITY = 8;
+
+  /************************************************************************/
+  /* Helper functions                                                     */
+  /************************************************************************/
+
+  namespace {
+    template<class T>
+    inline void SwapEntries( T& aEntry1, T& aEntry2 ) {
+      aEntry1.key.Swap( aEntry2.key );
+      aEntry1.value.Swap( aEntry2.value );
+      std::swap( aEntry1.hash, aEntry2.hash );
+      std::swap( aEntry1.distance, aEntry2.distance );
+    }
+
+    template<class T>
+    struct KEYORDER {
+      explicit KEYORDER( const std::vector<T>& aEntries ): entries( aEntries ) {}
+
+      bool operator()( int aIndex1, int aIndex2 ) const {
+        return ( entries[aIndex1].key < entries[aIndex2].key );
+      }
+
+      const std::vector<T>& entries;
+    };
+  }
+
+  /************************************************************************/
+  /* CDSMap class implementation                                          */
+  /************************************************************************/
+
+  CDSMap::CDSMap(): m_count( 0 ), m_orderValid( true ) {}
+
+  int CDSMap::Create() {
+    return m_maps.Add( new CDSMap() );
+  }
+
+  bool CDSMap::Destroy( int aId ) {
+    return m_maps.Remove( aId );
+  }
+
+  void CDSMap::Clear() {
+    m_entries.clear();
+    m_order.clear();
+    m_count = 0;
+    m_orderValid = true;
+  }
+
+  int CDSMap::FindEntry( const CDSValue& aKey ) const {
+    return FindEntry( aKey, aKey.Hash() );
+  }
+
+  int CDSMap::FindEntry( const CDSValue& aKey, unsigned long aHash ) const {
+    if ( m_entries.empty() )
+      return -1;
+
+    size_t mask = m_entries.size() - 1;
+    size_t index = aHash & mask;
+
+    for ( int distance = 1; ; distance++ ) {
+      const ENTRY& entry = m_entries[index];
+
+      // Robin Hood invariant - the key would have taken this slot
+      if ( entry.distance < distance )
+        return -1;
+
+      if ( entry.hash == aHash && entry.key == aKey )
+        return (int) index;
+
+      index = ( index + 1 ) & mask;
+    }
+  }
+
+  void CDSMap::Insert( const CDSValue& aKey, const CDSValue& aValue, unsigned long aHash ) {
+    if ( ( m_count + 1 ) * 5 > (int) m_entries.size() * 4 )
+      Rehash( m_entries.empty() ? MIN_CAPACITY : m_entries.size() * 2 );
+
+    ENTRY entry;
+    entry.key = aKey;
+    entry.value = aValue;
+    entry.hash = aHash;
+    entry.distance = 1;
+
+    size_t mask = m_entries.size() - 1;
+    size_t index = aHash & mask;
+
+    while ( m_entries[index].distance ) {
+      // Take the slot from entries that are closer to their home slot
+      if ( m_entries[index].distance < entry.distance )
+        SwapEntries( m_entries[index], entry );
+
+      ++entry.distance;
+      index = ( index + 1 ) & mask;
+    }
+
+    SwapEntries( m_entries[index], entry );
+
+    ++m_count;
+    m_orderValid = false;
+  }
+
+  void CDSMap::Rehash( size_t aCapacity ) {
+    std::vector<ENTRY> entries( aCapacity );
+    size_t mask = aCapacity - 1;
+
+    for ( size_t i = 0; i < aCapacity; i++ ) {
+      entries[i].hash = 0;
+      entries[i].distance = 0;
+    }
+
+    for ( size_t i = 0; i < m_entries.size(); i++ ) {
+      ENTRY& entry = m_entries[i];
+
+      if ( !entry.distance )
+        continue;
+
+      entry.distance = 1;
+      size_t index = entry.hash & mask;
+
+      while ( entries[index].distance ) {
+        if ( entries[index].distance < entry.distance )
+          SwapEntries( entries[index], entry );
+
+        ++entry.distance;
+        index = ( index + 1 ) & mask;
+      }
+
+      SwapEntries( entries[index], entry );
+    }
+
+    m_entries.swap( entries );
+    m_orderValid = false;
+  }
+
+  void CDSMap::Add( const CDSValue& aKey, const CDSValue& aValue ) {
+    Insert( aKey, aValue, aKey.Hash() );
+  }
+
+  bool CDSMap::Replace( const CDSValue& aKey, const CDSValue& aValue ) {
+    int index = FindEntry( aKey );
+
+    if ( index < 0 )
+      return false;
+
+    m_entries[index].value = aValue;
+    return true;
+  }
+
+  void CDSMap::Set( const CDSValue& aKey, const CDSValue& aValue ) {
+    unsigned long hash = aKey.Hash();
+    int index = FindEntry( aKey, hash );
+
+    if ( index >= 0 )
+      m_entries[index].value = aValue;
+    else
+      Insert( aKey, aValue, hash );
+  }
+
+  bool CDSMap::Delete( const CDSValue& aKey ) {
+    int found = FindEntry( aKey );
+
+    if ( found < 0 )
+      return false;
+
+    // Backward shift deletion - following entries of the cluster are moved
+    // one slot back, so no tombstones are needed
+    size_t mask = m_entries.size() - 1;
+    size_t index = found;
+    size_t next = ( index + 1 ) & mask;
+
+    while ( m_entries[next].distance > 1 ) {
+      SwapEntries( m_entries[index], m_entries[next] );
+      --m_entries[index].distance;
+
+      index = next;
+      next = ( next + 1 ) & mask;
+    }
+
+    m_entries[index].key = CDSValue();
+    m_entries[index].value = CDSValue();
+    m_entries[index].distance = 0;
+
+    --m_count;
+    m_orderValid = false;
+
+    return true;
+  }
+
+  const CDSValue* CDSMap::FindValue( const CDSValue& aKey ) const {
+    int index = FindEntry( aKey );
+
+    return ( index >= 0 ? &m_entries[index].value : NULL );
+  }
+
+  void CDSMap::UpdateOrder() const {
+    if ( m_orderValid )
+      return;
+
+    m_order.clear();
+    m_order.reserve( m_count );
+
+    for ( size_t i = 0; i < m_entries.size(); i++ ) {
+      if ( m_entries[i].distance )
+        m_order.push_back( (int) i );
+    }
+
+    std::sort( m_order.begin(), m_order.end(), KEYORDER<ENTRY>( m_entries ) );
+    m_orderValid = true;
+  }
+
+  size_t CDSMap::LowerBound( const CDSValue& aKey ) const {
+    size_t first = 0, count = m_order.size();
+
+    while ( count > 0 ) {
+      size_t step = count / 2;
+
+      if ( m_entries[m_order[first + step]].key < aKey ) {
+        first += step + 1;
+        count -= step + 1;
+      } else
+        count = step;
+    }
+
+    return first;
+  }
+
+  const CDSValue* CDSMap::FindFirst() const {
+    UpdateOrder();
+
+    return ( m_order.empty() ? NULL : &m_entries[m_order.front()].key );
+  }
+
+  const CDSValue* CDSMap::FindLast() const {
+    UpdateOrder();
+
+    return ( m_order.empty() ? NULL : &m_entries[m_order.back()].key );
+  }
+
+  const CDSValue* CDSMap::FindNext( const CDSValue& aKey ) const {
+    UpdateOrder();
+    size_t position = LowerBound( aKey );
+
+    // Skips all entries of the key, it may have been added more than once
+    while ( position < m_order.size() && m_entries[m_order[position]].key == aKey )
+      ++position;
+
+    return ( position < m_order.size() ? &m_entries[m_order[position]].key : NULL );
+  }
+
+  const CDSValue* CDSMap::FindPrevious( const CDSValue& aKey ) const {
+    UpdateOrder();
+    size_t position = LowerBound( aKey );
+
+    return ( position > 0 ? &m_entries[m_order[position - 1]].key : NULL );
+  }
+
+  std::string CDSMap::Write() const {
+    CDSHexWriter writer;
+    Write( writer );
+
+    return writer.GetString();
+  }
+
+  void CDSMap::Write( CDSWriter& aWriter ) const {
+    UpdateOrder();
+
+    aWriter.WriteInt( MAP_HEADER );
+    aWriter.WriteInt( m_count );
+
+    for ( size_t i = 0; i < m_order.size(); i++ ) {
+      aWriter.WriteValue( m_entries[m_order[i]].key );
+      aWriter.WriteValue( m_entries[m_order[i]].value );
+    }
+  }
+
+  bool CDSMap::Read( const char* aString ) {
+    CDSHexReader reader( aString );
+    return Read( reader );
+  }
+
+  bool CDSMap::Read( CDSReader& aReader ) {
+    int header, count;
+
+    Clear();
+
+    if ( !aReader.ReadInt( header ) || header != MAP_HEADER || !aReader.ReadInt( count ) || count < 0 )
+      return false;
+
+    CDSValue key, value;
+
+    for ( int i = 0; i < count; i++ ) {
+      if ( !aReader.ReadValue( key ) || !aReader.ReadValue( value ) ) {
+        Clear();
+        return false;
+      }
+
+      Add( key, value );
+    }
+
+    return true;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    void SetKeyResult( const CDSValue* aKey, PGMVALUE aResult ) {
+      if ( aKey )
+        aKey->SetResult( aResult );
+      else
+        aResult->Set( 0.0 );
+    }
+
+    void DsMapCreate( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                      int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CDSMap::Create() );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapCreate )
+
+    void DsMapDestroy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      CDSMap::Destroy( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapDestroy )
+
+    void DsMapClear( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                     int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSMap::Get( (int) aArgs[0].real ).Clear();
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapClear )
+
+    void DsMapCopy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                    int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSMap::Get( (int) aArgs[0].real ) = CDSMap::Get( (int) aArgs[1].real );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapCopy )
+
+    void DsMapSize( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                    int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( (double) CDSMap::Get( (int) aArgs[0].real ).GetSize() );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapSize )
+
+    void DsMapEmpty( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                     int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( CDSMap::Get( (int) aArgs[0].real ).IsEmpty() ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapEmpty )
+
+    void DsMapAdd( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                   int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSMap::Get( (int) aArgs[0].real ).Add( CDSValue( aArgs[1] ), CDSValue( aArgs[2] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapAdd )
+
+    void DsMapReplace( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSMap::Get( (int) aArgs[0].real ).Replace( CDSValue( aArgs[1] ), CDSValue( aArgs[2] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapReplace )
+
+    void DsMapDelete( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                      int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSMap::Get( (int) aArgs[0].real ).Delete( CDSValue( aArgs[1] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapDelete )
+
+    void DsMapExists( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                      int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( CDSMap::Get( (int) aArgs[0].real ).Exists( CDSValue( aArgs[1] ) ) ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapExists )
+
+    void DsMapFindValue( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      try {
+        SetKeyResult( CDSMap::Get( (int) aArgs[0].real ).FindValue( CDSValue( aArgs[1] ) ), aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapFindValue )
+
+    void DsMapFindPrevious( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      try {
+        SetKeyResult( CDSMap::Get( (int) aArgs[0].real ).FindPrevious( CDSValue( aArgs[1] ) ), aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapFindPrevious )
+
+    void DsMapFindNext( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      try {
+        SetKeyResult( CDSMap::Get( (int) aArgs[0].real ).FindNext( CDSValue( aArgs[1] ) ), aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapFindNext )
+
+    void DsMapFindFirst( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      try {
+        SetKeyResult( CDSMap::Get( (int) aArgs[0].real ).FindFirst(), aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapFindFirst )
+
+    void DsMapFindLast( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      try {
+        SetKeyResult( CDSMap::Get( (int) aArgs[0].real ).FindLast(), aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapFindLast )
+
+    void DsMapWrite( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                     int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( CDSMap::Get( (int) aArgs[0].real ).Write().c_str() );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapWrite )
+
+    void DsMapRead( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                    int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSMap::Get( (int) aArgs[0].real ).Read( aArgs[1].type == VT_STRING ? aArgs[1].string : "" );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapRead )
+
+    void DsMapSaveBin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+              int aArgCount, PGMVALUE aResult ) {
+      try {
+        bool saved = SaveDSBinary( CDSMap::Get( (int) aArgs[0].real ),
+                                   ( aArgs[1].type == VT_STRING ? aArgs[1].string : "" ), aArgs[2].real >= 0.5 );
+
+        aResult->Set( saved ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapSaveBin )
+
+    void DsMapLoadBin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+              int aArgCount, PGMVALUE aResult ) {
+      try {
+        bool loaded = LoadDSBinary( CDSMap::Get( (int) aArgs[0].real ),
+                                    ( aArgs[1].type == VT_STRING ? aArgs[1].string : "" ) );
+
+        aResult->Set( loaded ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsMapLoadBin )
+  }
+
+  void CDSMap::RegisterGMFunctions() {
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_create, DsMapCreate );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_destroy, DsMapDestroy );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_clear, DsMapClear );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_copy, DsMapCopy );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_size, DsMapSize );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_empty, DsMapEmpty );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_add, DsMapAdd );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_replace, DsMapReplace );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_delete, DsMapDelete );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_exists, DsMapExists );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_find_value, DsMapFindValue );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_find_previous, DsMapFindPrevious );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_find_next, DsMapFindNext );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_find_first, DsMapFindFirst );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_find_last, DsMapFindLast );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_write, DsMapWrite );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_map_read, DsMapRead );
+
+    GMAPI_GMFUNCTION_REGISTER( "ds_map_save_bin", 3, DsMapSaveBin );
+    GMAPI_GMFUNCTION_REGISTER( "ds_map_load_bin", 2, DsMapLoadBin );
+  }
+
+#endif
+
+}
@@ -0,0 +1,229 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiDSMap.h                                                        */
+/*   - Native implementation of ds_map                                  */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiDSCommon.h"
+
+namespace gm {
+
+  /// CDSMap
+  ///   Native map of real/string keys to real/string values, compatible
+  ///   with ds_map. Entries are stored in an open addressing hash table
+  ///   (Robin Hood hashing with backward shift deletion). Ordered
+  ///   traversal (FindFirst, FindNext, ...) uses a sorted index of the
+  ///   keys, which is rebuilt only when it is needed after a change.
+  ///
+  ///   Like in GM, a map can hold the same key more than once: Add (and
+  ///   ds_map_add) does not check whether the key exists. GetSize counts
+  ///   and Write writes every entry; FindValue, Replace and Delete act on
+  ///   one of the entries of the key, and ordered traversal returns each
+  ///   distinct key once (FindNext returns the next larger key). Set
+  ///   replaces the value of an existing key instead of adding another.
+  ///
+  ///   Maps are identified by IDs like in GM. After RegisterGMFunctions
+  ///   has been called, all ds_map_* functions operate on native maps.
+  ///
+  class CDSMap {
+    public:
+      CDSMap();
+
+      /************************************************************************/
+      /* Map management                                                       */
+      /************************************************************************/
+
+      /// Create()
+      ///   Creates new map.
+      ///
+      /// Returns:
+      ///   ID of the map.
+      ///
+      static int Create();
+
+      /// Destroy( int aId )
+      ///   Destroys the map.
+      ///
+      /// Returns:
+      ///   False if the map did not exist.
+      ///
+      static bool Destroy( int aId );
+
+      /// Find( int aId )
+      ///   Returns the map with specified ID or NULL if it does not exist.
+      ///
+      static CDSMap* Find( int aId ) {
+        return m_maps.Find( aId );
+      }
+
+      /// Get( int aId )
+      ///   Returns the map with specified ID.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIDataStructureNotExist if the map does not exist.
+      ///
+      static CDSMap& Get( int aId ) {
+        return m_maps.Get( aId );
+      }
+
+      /// GetRegistry()
+      ///   Returns the registry of all native maps.
+      ///
+      static const CDSRegistry<CDSMap>& GetRegistry() {
+        return m_maps;
+      }
+
+      /************************************************************************/
+      /* Map content                                                          */
+      /************************************************************************/
+
+      int GetSize() const {
+        return m_count;
+      }
+
+      bool IsEmpty() const {
+        return !m_count;
+      }
+
+      /// Clear()
+      ///   Removes all entries.
+      ///
+      void Clear();
+
+      /// Add( const CDSValue& aKey, const CDSValue& aValue )
+      ///   Adds the entry to the map. If the key already exists, the map
+      ///   then holds it more than once, like in ds_map_add.
+      ///
+      void Add( const CDSValue& aKey, const CDSValue& aValue );
+
+      /// Replace( const CDSValue& aKey, const CDSValue& aValue )
+      ///   Replaces the value of the key (of one of its entries if the
+      ///   key was added more than once). If the key does not exist, the
+      ///   map is not changed.
+      ///
+      /// Returns:
+      ///   False if the key did not exist.
+      ///
+      bool Replace( const CDSValue& aKey, const CDSValue& aValue );
+
+      /// Set( const CDSValue& aKey, const CDSValue& aValue )
+      ///   Adds the entry or replaces value of the existing key.
+      ///
+      void Set( const CDSValue& aKey, const CDSValue& aValue );
+
+      /// Delete( const CDSValue& aKey )
+      ///   Removes the key from the map; only one entry is removed if the
+      ///   key was added more than once.
+      ///
+      /// Returns:
+      ///   False if the key did not exist.
+      ///
+      bool Delete( const CDSValue& aKey );
+
+      bool Exists( const CDSValue& aKey ) const {
+        return ( FindEntry( aKey ) >= 0 );
+      }
+
+      /// FindValue( const CDSValue& aKey )
+      ///   Returns pointer to the value of the key or NULL if the key
+      ///   does not exist. The pointer is valid until the map is changed.
+      ///
+      const CDSValue* FindValue( const CDSValue& aKey ) const;
+
+      /// FindFirst(), FindLast()
+      ///   Return pointer to the smallest/largest key (reals are ordered
+      ///   before strings) or NULL if the map is empty.
+      ///
+      const CDSValue* FindFirst() const;
+      const CDSValue* FindLast() const;
+
+      /// FindNext( const CDSValue& aKey ), FindPrevious( const CDSValue& aKey )
+      ///   Return pointer to the smallest key larger/largest key smaller
+      ///   than specified key, or NULL if there is no such key. The key
+      ///   does not need to exist in the map.
+      ///
+      const CDSValue* FindNext( const CDSValue& aKey ) const;
+      const CDSValue* FindPrevious( const CDSValue& aKey ) const;
+
+      /// Write()
+      ///   Native version of ds_map_write.
+      ///
+      std::string Write() const;
+
+      /// Write( CDSWriter& aWriter )
+      ///   Writes the map to the stream, e.g. CDSBinaryWriter.
+      ///
+      void Write( CDSWriter& aWriter ) const;
+
+      /// Read( const char* aString )
+      ///   Native version of ds_map_read. Replaces content of the map.
+      ///
+      /// Returns:
+      ///   False if the string is not a valid map string; the map is
+      ///   then left empty.
+      ///
+      bool Read( const char* aString );
+
+      /// Read( CDSReader& aReader )
+      ///   Reads the map from the stream. See Read( const char* aString ).
+      ///
+      bool Read( CDSReader& aReader );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Replaces all ds_map_* GML functions with the native versions and
+      ///   registers the following GML functions:
+      ///     ds_map_save_bin( id, fname, compress ) - returns true on success
+      ///     ds_map_load_bin( id, fname ) - returns true on success
+      ///   Errors, e.g. a map that does not exist, are reported with a
+      ///   message box (EGMAPIException::ShowError), like the runner does.
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      struct ENTRY {
+        CDSValue key;
+        CDSValue value;
+        unsigned long hash;
+        int distance; // Probe distance + 1, 0 for empty slots
+      };
+
+      int FindEntry( const CDSValue& aKey ) const;
+      int FindEntry( const CDSValue& aKey, unsigned long aHash ) const;
+      void Insert( const CDSValue& aKey, const CDSValue& aValue, unsigned long aHash );
+      void Rehash( size_t aCapacity );
+      void UpdateOrder() const;
+      size_t LowerBound( const CDSValue& aKey ) const;
+
+      std::vector<ENTRY> m_entries;
+      int m_count;
+
+      mutable std::vector<int> m_order;
+      mutable bool m_orderValid;
+
+      static CDSRegistry<CDSMap> m_maps;
+  };
+
+}
@@ -0,0 +1,604 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiDSPriority.cpp                                                 */
+/*   - Native implementation of ds_priority                             */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiDSPriority.h"
+#include "GmapiMacros.h"
+
+namespace gm {
+
+  CDSRegistry<CDSPriority> CDSPriority::m_queues;
+
+  // Header of the ds_priority_write strings
+  static const int PRIORITY_HEADER = 501;
+
+  // Smallest number of hash buckets; the number is always power of 2
+  static const size_t MIN_BUCKETS = 16;
+
+  // Number of children of the heap nodes
+  static const int HEAP_ARITY = 4;
+
+  /************************************************************************/
+  /* CDSPriority class implementation                                     */
+  /************************************************************************/
+
+  CDSPriority::CDSPriority(): m_buckets( MIN_BUCKETS, -1 ), m_freeEntry( -1 ) {}
+
+  int CDSPriority::Create() {
+    return m_queues.Add( new CDSPriority() );
+  }
+
+  bool CDSPriority::Destroy( int aId ) {
+    return m_queues.Remove( aId );
+  }
+
+  void CDSPriority::Clear() {
+    m_entries.clear();
+    m_minHeap.clear();
+    m_maxHeap.clear();
+    m_buckets.assign( MIN_BUCKETS, -1 );
+    m_freeEntry = -1;
+  }
+
+  int CDSPriority::FindEntry( const CDSValue& aValue ) const {
+    unsigned long hash = aValue.Hash();
+    int result = -1;
+
+    // Equal values are chained from the newest to the oldest one; GM
+    // operates on the one inserted first, which is the last one found
+    for ( int i = m_buckets[hash & ( m_buckets.size() - 1 )]; i >= 0; i = m_entries[i].next ) {
+      if ( m_entries[i].hash == hash && m_entries[i].value == aValue )
+        result = i;
+    }
+
+    return result;
+  }
+
+  int CDSPriority::AllocateEntry() {
+    if ( m_freeEntry < 0 ) {
+      m_entries.push_back( ENTRY() );
+      return (int) m_entries.size() - 1;
+    }
+
+    int entry = m_freeEntry;
+    m_freeEntry = m_entries[entry].next;
+
+    return entry;
+  }
+
+  void CDSPriority::LinkEntry( int aEntry ) {
+    ENTRY& entry = m_entries[aEntry];
+    int& bucket = m_buckets[entry.hash & ( m_buckets.size() - 1 )];
+
+    entry.previous = -1;
+    entry.next = bucket;
+
+    if ( bucket >= 0 )
+      m_entries[bucket].previous = aEntry;
+
+    bucket = aEntry;
+  }
+
+  void CDSPriority::UnlinkEntry( int aEntry ) {
+    ENTRY& entry = m_entries[aEntry];
+
+    if ( entry.previous >= 0 )
+      m_entries[entry.previous].next = entry.next;
+    else
+      m_buckets[entry.hash & ( m_buckets.size() - 1 )] = entry.next;
+
+    if ( entry.next >= 0 )
+      m_entries[entry.next].previous = entry.previous;
+  }
+
+  void CDSPriority::Rehash( size_t aBucketCount ) {
+    std::vector<int> chains( aBucketCount, -1 );
+    chains.swap( m_buckets );
+
+    // Old chains are relinked from their ends, so equal values, which
+    // share a chain, keep their order from the newest to the oldest one
+    for ( size_t i = 0; i < chains.size(); i++ ) {
+      int entry = chains[i];
+
+      if ( entry < 0 )
+        continue;
+
+      while ( m_entries[entry].next >= 0 )
+        entry = m_entries[entry].next;
+
+      while ( entry >= 0 ) {
+        int previous = m_entries[entry].previous;
+
+        LinkEntry( entry );
+        entry = previous;
+      }
+    }
+  }
+
+  void CDSPriority::SiftUp( std::vector<int>& aHeap, int ENTRY::* aPosition, bool aMax, int aIndex ) {
+    int entry = aHeap[aIndex];
+    double priority = m_entries[entry].priority;
+
+    while ( aIndex > 0 ) {
+      int parent = ( aIndex - 1 ) / HEAP_ARITY;
+      double parentPriority = m_entries[aHeap[parent]].priority;
+
+      if ( aMax ? !( priority > parentPriority ) : !( priority < parentPriority ) )
+        break;
+
+      aHeap[aIndex] = aHeap[parent];
+      m_entries[aHeap[aIndex]].*aPosition = aIndex;
+      aIndex = parent;
+    }
+
+    aHeap[aIndex] = entry;
+    m_entries[entry].*aPosition = aIndex;
+  }
+
+  void CDSPriority::SiftDown( std::vector<int>& aHeap, int ENTRY::* aPosition, bool aMax, int aIndex ) {
+    int size = (int) aHeap.size();
+    int entry = aHeap[aIndex];
+    double priority = m_entries[entry].priority;
+
+    for ( ;; ) {
+      int first = aIndex * HEAP_ARITY + 1;
+
+      if ( first >= size )
+        break;
+
+      // Select the child with the lowest/highest priority
+      int last = ( first + HEAP_ARITY < size ? first + HEAP_ARITY : size );
+      int best = first;
+      double bestPriority = m_entries[aHeap[first]].priority;
+
+      for ( int child = first + 1; child < last; child++ ) {
+        double childPriority = m_entries[aHeap[child]].priority;
+
+        if ( aMax ? childPriority > bestPriority : childPriority < bestPriority ) {
+          best = child;
+          bestPriority = childPriority;
+        }
+      }
+
+      if ( aMax ? !( bestPriority > priority ) : !( bestPriority < priority ) )
+        break;
+
+      aHeap[aIndex] = aHeap[best];
+      m_entries[aHeap[aIndex]].*aPosition = aIndex;
+      aIndex = best;
+    }
+
+    aHeap[aIndex] = entry;
+    m_entries[entry].*aPosition = aIndex;
+  }
+
+  void CDSPriority::RemoveFromHeap( std::vector<int>& aHeap, int ENTRY::* aPosition, bool aMax, int aIndex ) {
+    int last = aHeap.back();
+    aHeap.pop_back();
+
+    if ( aIndex < (int) aHeap.size() ) {
+      aHeap[aIndex] = last;
+      m_entries[last].*aPosition = aIndex;
+
+      SiftUp( aHeap, aPosition, aMax, aIndex );
+      SiftDown( aHeap, aPosition, aMax, m_entries[last].*aPosition );
+    }
+  }
+
+  void CDSPriority::RemoveEntry( int aEntry ) {
+    UnlinkEntry( aEntry );
+    RemoveFromHeap( m_minHeap, &ENTRY::minPosition, false, m_entries[aEntry].minPosition );
+    RemoveFromHeap( m_maxHeap, &ENTRY::maxPosition, true, m_entries[aEntry].maxPosition );
+
+    ENTRY& entry = m_entries[aEntry];
+
+    // Release the string and put the entry on the free list
+    entry.value = CDSValue();
+    entry.next = m_freeEntry;
+    m_freeEntry = aEntry;
+  }
+
+  void CDSPriority::Add( const CDSValue& aValue, double aPriority ) {
+    if ( m_minHeap.size() >= m_buckets.size() )
+      Rehash( m_buckets.size() * 2 );
+
+    int index = AllocateEntry();
+    ENTRY& entry = m_entries[index];
+
+    entry.value = aValue;
+    entry.priority = aPriority;
+    entry.hash = aValue.Hash();
+    LinkEntry( index );
+
+    m_minHeap.push_back( index );
+    m_maxHeap.push_back( index );
+    SiftUp( m_minHeap, &ENTRY::minPosition, false, (int) m_minHeap.size() - 1 );
+    SiftUp( m_maxHeap, &ENTRY::maxPosition, true, (int) m_maxHeap.size() - 1 );
+  }
+
+  bool CDSPriority::ChangePriority( const CDSValue& aValue, double aPriority ) {
+    int index = FindEntry( aValue );
+
+    if ( index < 0 )
+      return false;
+
+    ENTRY& entry = m_entries[index];
+    double previous = entry.priority;
+    entry.priority = aPriority;
+
+    if ( aPriority < previous ) {
+      SiftUp( m_minHeap, &ENTRY::minPosition, false, entry.minPosition );
+      SiftDown( m_maxHeap, &ENTRY::maxPosition, true, entry.maxPosition );
+    } else if ( aPriority > previous ) {
+      SiftDown( m_minHeap, &ENTRY::minPosition, false, entry.minPosition );
+      SiftUp( m_maxHeap, &ENTRY::maxPosition, true, entry.maxPosition );
+    }
+
+    return true;
+  }
+
+  bool CDSPriority::FindPriority( const CDSValue& aValue, double& aPriority ) const {
+    int index = FindEntry( aValue );
+
+    if ( index < 0 )
+      return false;
+
+    aPriority = m_entries[index].priority;
+    return true;
+  }
+
+  bool CDSPriority::DeleteValue( const CDSValue& aValue ) {
+    int index = FindEntry( aValue );
+
+    if ( index < 0 )
+      return false;
+
+    RemoveEntry( index );
+    return true;
+  }
+
+  const CDSValue* CDSPriority::FindMin() const {
+    return ( m_minHeap.empty() ? NULL : &m_entries[m_minHeap[0]].value );
+  }
+
+  const CDSValue* CDSPriority::FindMax() const {
+    return ( m_maxHeap.empty() ? NULL : &m_entries[m_maxHeap[0]].value );
+  }
+
+  bool CDSPriority::DeleteMin( CDSValue& aValue ) {
+    if ( m_minHeap.empty() )
+      return false;
+
+    int index = m_minHeap[0];
+
+    aValue.Swap( m_entries[index].value );
+    RemoveEntry( index );
+
+    return true;
+  }
+
+  bool CDSPriority::DeleteMax( CDSValue& aValue ) {
+    if ( m_maxHeap.empty() )
+      return false;
+
+    int index = m_maxHeap[0];
+
+    aValue.Swap( m_entries[index].value );
+    RemoveEntry( index );
+
+    return true;
+  }
+
+  std::string CDSPriority::Write() const {
+    CDSHexWriter writer;
+    Write( writer );
+
+    return writer.GetString();
+  }
+
+  void CDSPriority::Write( CDSWriter& aWriter ) const {
+    aWriter.WriteInt( PRIORITY_HEADER );
+    aWriter.WriteInt( GetSize() );
+
+    for ( size_t i = 0; i < m_minHeap.size(); i++ ) {
+      const ENTRY& entry = m_entries[m_minHeap[i]];
+
+      aWriter.WriteValue( entry.value );
+      aWriter.WriteValue( entry.priority );
+    }
+  }
+
+  bool CDSPriority::Read( const char* aString ) {
+    CDSHexReader reader( aString );
+    return Read( reader );
+  }
+
+  bool CDSPriority::Read( CDSReader& aReader ) {
+    int header, count;
+
+    Clear();
+
+    if ( !aReader.ReadInt( header ) || header != PRIORITY_HEADER ||
+         !aReader.ReadInt( count ) || count < 0 )
+      return false;
+
+    CDSValue value, priority;
+
+    for ( int i = 0; i < count; i++ ) {
+      if ( !aReader.ReadValue( value ) || !aReader.ReadValue( priority ) || priority.IsString() ) {
+        Clear();
+        return false;
+      }
+
+      Add( value, priority.GetReal() );
+    }
+
+    return true;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    void DsPriorityCreate( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CDSPriority::Create() );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityCreate )
+
+    void DsPriorityDestroy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      CDSPriority::Destroy( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityDestroy )
+
+    void DsPriorityClear( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSPriority::Get( (int) aArgs[0].real ).Clear();
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityClear )
+
+    void DsPriorityCopy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSPriority::Get( (int) aArgs[0].real ) = CDSPriority::Get( (int) aArgs[1].real );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityCopy )
+
+    void DsPrioritySize( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( (double) CDSPriority::Get( (int) aArgs[0].real ).GetSize() );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPrioritySize )
+
+    void DsPriorityEmpty( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( CDSPriority::Get( (int) aArgs[0].real ).IsEmpty() ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityEmpty )
+
+    void DsPriorityAdd( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSPriority::Get( (int) aArgs[0].real ).Add( CDSValue( aArgs[1] ), aArgs[2].real );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityAdd )
+
+    void DsPriorityChangePriority( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                   int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSPriority::Get( (int) aArgs[0].real ).ChangePriority( CDSValue( aArgs[1] ), aArgs[2].real );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityChangePriority )
+
+    void DsPriorityFindPriority( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                 int aArgCount, PGMVALUE aResult ) {
+      try {
+        double priority = 0;
+
+        CDSPriority::Get( (int) aArgs[0].real ).FindPriority( CDSValue( aArgs[1] ), priority );
+        aResult->Set( priority );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityFindPriority )
+
+    void DsPriorityDeleteValue( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSPriority::Get( (int) aArgs[0].real ).DeleteValue( CDSValue( aArgs[1] ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityDeleteValue )
+
+    void DsPriorityDeleteMin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSValue value;
+
+        if ( CDSPriority::Get( (int) aArgs[0].real ).DeleteMin( value ) )
+          value.SetResult( aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityDeleteMin )
+
+    void DsPriorityFindMin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      try {
+        const CDSValue* value = CDSPriority::Get( (int) aArgs[0].real ).FindMin();
+
+        if ( value )
+          value->SetResult( aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityFindMin )
+
+    void DsPriorityDeleteMax( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSValue value;
+
+        if ( CDSPriority::Get( (int) aArgs[0].real ).DeleteMax( value ) )
+          value.SetResult( aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityDeleteMax )
+
+    void DsPriorityFindMax( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      try {
+        const CDSValue* value = CDSPriority::Get( (int) aArgs[0].real ).FindMax();
+
+        if ( value )
+          value->SetResult( aResult );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityFindMax )
+
+    void DsPriorityWrite( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( CDSPriority::Get( (int) aArgs[0].real ).Write().c_str() );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityWrite )
+
+    void DsPriorityRead( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      try {
+        CDSPriority::Get( (int) aArgs[0].real ).Read( aArgs[1].type == VT_STRING ? aArgs[1].string : "" );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityRead )
+
+    void DsPrioritySaveBin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                   int aArgCount, PGMVALUE aResult ) {
+      try {
+        bool saved = SaveDSBinary( CDSPriority::Get( (int) aArgs[0].real ),
+                                   ( aArgs[1].type == VT_STRING ? aArgs[1].string : "" ), aArgs[2].real >= 0.5 );
+
+        aResult->Set( saved ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPrioritySaveBin )
+
+    void DsPriorityLoadBin( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                   int aArgCount, PGMVALUE aResult ) {
+      try {
+        bool loaded = LoadDSBinary( CDSPriority::Get( (int) aArgs[0].real ),
+                                    ( aArgs[1].type == VT_STRING ? aArgs[1].string : "" ) );
+
+        aResult->Set( loaded ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DsPriorityLoadBin )
+  }
+
+  void CDSPriority::RegisterGMFunctions() {
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_create, DsPriorityCreate );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_destroy, DsPriorityDestroy );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_clear, DsPriorityClear );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_copy, DsPriorityCopy );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_size, DsPrioritySize );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_empty, DsPriorityEmpty );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_add, DsPriorityAdd );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_change_priority, DsPriorityChangePriority );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_find_priority, DsPriorityFindPriority );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_delete_value, DsPriorityDeleteValue );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_delete_min, DsPriorityDeleteMin );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_find_min, DsPriorityFindMin );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_delete_max, DsPriorityDeleteMax );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_find_max, DsPriorityFindMax );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_write, DsPriorityWrite );
+    GMAPI_GMFUNCTION_OVERRIDE( id_ds_priority_read, DsPriorityRead );
+
+    GMAPI_GMFUNCTION_REGISTER( "ds_priority_save_bin", 3, DsPrioritySaveBin );
+    GMAPI_GMFUNCTION_REGISTER( "ds_priority_load_bin", 2, DsPriorityLoadBin );
+  }
+
+#endif
+
+}
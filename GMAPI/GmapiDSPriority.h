@@ -0,0 +1,228 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiDSPriority.h                                                   */
+/*   - Native implementation of ds_priority                             */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiDSCommon.h"
+
+namespace gm {
+
+  /// CDSPriority
+  ///   Native priority queue compatible with ds_priority. Entries are kept
+  ///   in two indexed 4-ary heaps (one ordered by the lowest, the other by
+  ///   the highest priority), and a hash table maps the values to the
+  ///   entries. Adding, deleting the minimum/maximum, changing priority and
+  ///   deleting a value therefore take O(log n) time, and finding the
+  ///   minimum/maximum takes constant time.
+  ///
+  ///   The queue may hold the same value several times; ChangePriority,
+  ///   FindPriority and DeleteValue then operate on the one added first,
+  ///   like in GM. Write stores the entries in the order of the heap, so
+  ///   after Read it is the first one written.
+  ///
+  ///   After RegisterGMFunctions has been called, all ds_priority_*
+  ///   functions operate on native queues.
+  ///
+  class CDSPriority {
+    public:
+      CDSPriority();
+
+      /************************************************************************/
+      /* Queue management                                                     */
+      /************************************************************************/
+
+      /// Create()
+      ///   Creates new priority queue.
+      ///
+      /// Returns:
+      ///   ID of the queue.
+      ///
+      static int Create();
+
+      /// Destroy( int aId )
+      ///   Destroys the queue.
+      ///
+      /// Returns:
+      ///   False if the queue did not exist.
+      ///
+      static bool Destroy( int aId );
+
+      /// Find( int aId )
+      ///   Returns the queue with specified ID or NULL if it does not exist.
+      ///
+      static CDSPriority* Find( int aId ) {
+        return m_queues.Find( aId );
+      }
+
+      /// Get( int aId )
+      ///   Returns the queue with specified ID.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIDataStructureNotExist if the queue does not exist.
+      ///
+      static CDSPriority& Get( int aId ) {
+        return m_queues.Get( aId );
+      }
+
+      /// GetRegistry()
+      ///   Returns the registry of all native priority queues.
+      ///
+      static const CDSRegistry<CDSPriority>& GetRegistry() {
+        return m_queues;
+      }
+
+      /************************************************************************/
+      /* Queue content                                                        */
+      /************************************************************************/
+
+      int GetSize() const {
+        return (int) m_minHeap.size();
+      }
+
+      bool IsEmpty() const {
+        return m_minHeap.empty();
+      }
+
+      /// Clear()
+      ///   Removes all entries.
+      ///
+      void Clear();
+
+      /// Add( const CDSValue& aValue, double aPriority )
+      ///   Adds the value with specified priority to the queue.
+      ///
+      void Add( const CDSValue& aValue, double aPriority );
+
+      /// ChangePriority( const CDSValue& aValue, double aPriority )
+      ///   Changes priority of the value.
+      ///
+      /// Returns:
+      ///   False if the value is not in the queue.
+      ///
+      bool ChangePriority( const CDSValue& aValue, double aPriority );
+
+      /// FindPriority( const CDSValue& aValue, double& aPriority )
+      ///   Stores priority of the value in aPriority.
+      ///
+      /// Returns:
+      ///   False if the value is not in the queue.
+      ///
+      bool FindPriority( const CDSValue& aValue, double& aPriority ) const;
+
+      /// DeleteValue( const CDSValue& aValue )
+      ///   Removes the value from the queue.
+      ///
+      /// Returns:
+      ///   False if the value is not in the queue.
+      ///
+      bool DeleteValue( const CDSValue& aValue );
+
+      /// FindMin(), FindMax()
+      ///   Return pointer to the value with the lowest/highest priority,
+      ///   or NULL if the queue is empty.
+      ///
+      const CDSValue* FindMin() const;
+      const CDSValue* FindMax() const;
+
+      /// DeleteMin( CDSValue& aValue ), DeleteMax( CDSValue& aValue )
+      ///   Remove the value with the lowest/highest priority and store it
+      ///   in aValue.
+      ///
+      /// Returns:
+      ///   False if the queue is empty.
+      ///
+      bool DeleteMin( CDSValue& aValue );
+      bool DeleteMax( CDSValue& aValue );
+
+      /// Write()
+      ///   Native version of ds_priority_write.
+      ///
+      std::string Write() const;
+
+      /// Write( CDSWriter& aWriter )
+      ///   Writes the priority queue to the stream, e.g. CDSBinaryWriter.
+      ///
+      void Write( CDSWriter& aWriter ) const;
+
+      /// Read( const char* aString )
+      ///   Native version of ds_priority_read. Replaces content of the queue.
+      ///
+      /// Returns:
+      ///   False if the string is not a valid priority queue string; the
+      ///   queue is then left empty.
+      ///
+      bool Read( const char* aString );
+
+      /// Read( CDSReader& aReader )
+      ///   Reads the priority queue from the stream. See Read( const char* aString ).
+      ///
+      bool Read( CDSReader& aReader );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Replaces all ds_priority_* GML functions with the native versions and
+      ///   registers the following GML functions:
+      ///     ds_priority_save_bin( id, fname, compress ) - returns true on success
+      ///     ds_priority_load_bin( id, fname ) - returns true on success
+      ///   Errors, e.g. a priority that does not exist, are reported with a
+      ///   message box (EGMAPIException::ShowError), like the runner does.
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      struct ENTRY {
+        CDSValue value;
+        double priority;
+        unsigned long hash;
+        int minPosition; // Position in the heaps
+        int maxPosition;
+        int previous;    // Neighbours in the hash bucket; the next
+        int next;        // field also links the free entries
+      };
+
+      int FindEntry( const CDSValue& aValue ) const;
+      int AllocateEntry();
+      void LinkEntry( int aEntry );
+      void UnlinkEntry( int aEntry );
+      void RemoveEntry( int aEntry );
+      void Rehash( size_t aBucketCount );
+
+      // The heap operations are shared by both heaps; aPosition selects
+      // the position field of the entries and aMax the order
+      void SiftUp( std::vector<int>& aHeap, int ENTRY::* aPosition, bool aMax, int aIndex );
+      void SiftDown( std::vector<int>& aHeap, int ENTRY::* aPosition, bool aMax, int aIndex );
+      void RemoveFromHeap( std::vector<int>& aHeap, int ENTRY::* aPosition, bool aMax, int aIndex );
+
+      std::vector<ENTRY> m_entries;
+      std::vector<int> m_minHeap;
+      std::vector<int> m_maxHeap;
+      std::vector<int> m_buckets;
+      int m_freeEntry;
+
+      static CDSRegistry<CDSPriority> m_queues;
+  };
+
+}
@@ -0,0 +1,519 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiFlowField.cpp                                                  */
+/*   - Flow fields leading to a common goal on mp_grids                 */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiFlowField.h"
+#include "GmapiUtilities.h"
+#include "GmapiMacros.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace gm {
+
+  CDSRegistry<CFlowField> CFlowField::m_fields;
+
+  namespace {
+    // Cell offsets of the direction codes, counter-clockwise from the right
+    static const int DIRECTION_H[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+    static const int DIRECTION_V[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+    // Unit vectors of the direction codes (y axis pointing down)
+    static const double DIRECTION_X[8] = { 1.0, 0.70710678, 0.0, -0.70710678, -1.0, -0.70710678, 0.0, 0.70710678 };
+    static const double DIRECTION_Y[8] = { 0.0, -0.70710678, -1.0, -0.70710678, 0.0, 0.70710678, 1.0, 0.70710678 };
+
+    static const float DIAGONAL_COST = 1.41421356f;
+    static const float UNREACHABLE_COST = 3.0e38f;
+
+    // Changes larger than this part of the grid rebuild the whole field
+    static const int REBUILD_FRACTION = 4;
+
+    struct OpenCellGreater {
+      template <class T>
+      bool operator()( const T& aFirst, const T& aSecond ) const {
+        return ( aFirst.cost > aSecond.cost );
+      }
+    };
+  }
+
+  /************************************************************************/
+  /* CFlowField::CGridListener class implementation                       */
+  /************************************************************************/
+
+  class CFlowField::CGridListener: public CMotionGridListener {
+    public:
+      virtual void OnCellsChanged( const CMotionGrid& aGrid, int aLeft, int aTop, int aRight, int aBottom ) {
+        for ( int i = 0; i < m_fields.GetSize(); i++ ) {
+          CFlowField* field = m_fields.Find( i );
+
+          if ( field && field->m_grid == &aGrid )
+            field->CellsChanged( aLeft, aTop, aRight, aBottom );
+        }
+      }
+
+      virtual void OnGridDestroyed( const CMotionGrid& aGrid ) {
+        for ( int i = 0; i < m_fields.GetSize(); i++ ) {
+          CFlowField* field = m_fields.Find( i );
+
+          if ( field && field->m_grid == &aGrid ) {
+            field->Update();
+            field->m_grid = NULL;
+          }
+        }
+      }
+  };
+
+  /************************************************************************/
+  /* CFlowField class implementation                                      */
+  /************************************************************************/
+
+  CFlowField::CFlowField( const CMotionGrid& aGrid, bool aDiagonal ):
+    m_gridId( aGrid.GetID() ), m_grid( &aGrid ),
+    m_width( aGrid.GetHorizontalCells() ), m_height( aGrid.GetVerticalCells() ),
+    m_left( aGrid.GetLeft() ), m_top( aGrid.GetTop() ),
+    m_cellWidth( aGrid.GetCellWidth() ), m_cellHeight( aGrid.GetCellHeight() ),
+    m_diagonal( aDiagonal ), m_goal( -1 ),
+    m_cost( m_width * m_height, UNREACHABLE_COST ),
+    m_direction( m_width * m_height, FD_UNREACHABLE ),
+    m_changed( true ), m_rebuild( true ),
+    m_changedLeft( 0 ), m_changedTop( 0 ), m_changedRight( 0 ), m_changedBottom( 0 ) {}
+
+  int CFlowField::Create( int aGridId, bool aDiagonal ) {
+    // One listener serves all fields; it is never removed, so it does not
+    // depend on the order of destruction of static objects
+    static CGridListener listener;
+    CMotionGrid::AddListener( &listener );
+
+    return m_fields.Add( new CFlowField( CMotionGrid::Get( aGridId ), aDiagonal ) );
+  }
+
+  bool CFlowField::Destroy( int aId ) {
+    return m_fields.Remove( aId );
+  }
+
+  bool CFlowField::SetGoal( double aX, double aY ) {
+    int h = (int) floor( ( aX - m_left ) / m_cellWidth );
+    int v = (int) floor( ( aY - m_top ) / m_cellHeight );
+    bool inside = ( h >= 0 && v >= 0 && h < m_width && v < m_height );
+
+    m_goal = ( inside ? v * m_width + h : -1 );
+    m_changed = m_rebuild = true;
+
+    return inside;
+  }
+
+  void CFlowField::CellsChanged( int aLeft, int aTop, int aRight, int aBottom ) {
+    if ( !m_changed ) {
+      m_changedLeft = aLeft;
+      m_changedTop = aTop;
+      m_changedRight = aRight;
+      m_changedBottom = aBottom;
+      m_changed = true;
+    } else {
+      m_changedLeft = std::min( m_changedLeft, aLeft );
+      m_changedTop = std::min( m_changedTop, aTop );
+      m_changedRight = std::max( m_changedRight, aRight );
+      m_changedBottom = std::max( m_changedBottom, aBottom );
+    }
+  }
+
+  bool CFlowField::CanMove( int aH, int aV, int aDirection ) const {
+    int h = aH + DIRECTION_H[aDirection], v = aV + DIRECTION_V[aDirection];
+
+    if ( !IsOpen( h, v ) )
+      return false;
+    if ( !( aDirection & 1 ) )
+      return true;
+
+    return ( m_diagonal && IsOpen( h, aV ) && IsOpen( aH, v ) );
+  }
+
+  void CFlowField::Update() {
+    if ( !m_changed )
+      return;
+
+    m_changed = false;
+
+    int width = m_changedRight - m_changedLeft + 1, height = m_changedBottom - m_changedTop + 1;
+    if ( m_rebuild || width * height * REBUILD_FRACTION > m_width * m_height || !m_grid ) {
+      Rebuild();
+      return;
+    }
+
+    // Apply the new state of the changed cells
+    for ( int v = m_changedTop; v <= m_changedBottom; v++ ) {
+      for ( int h = m_changedLeft; h <= m_changedRight; h++ ) {
+        int cell = v * m_width + h;
+        bool forbidden = m_grid->IsCellForbidden( h, v );
+
+        if ( forbidden == ( m_direction[cell] == FD_FORBIDDEN ) )
+          continue;
+
+        if ( cell == m_goal ) {
+          Rebuild();
+          return;
+        }
+
+        m_direction[cell] = ( forbidden ? FD_FORBIDDEN : FD_UNREACHABLE );
+        m_cost[cell] = UNREACHABLE_COST;
+      }
+    }
+
+    // Paths through cells that became forbidden and diagonal moves around
+    // them are no longer valid; invalidate all cells leading to such moves
+    int left = std::max( m_changedLeft - 1, 0 ), top = std::max( m_changedTop - 1, 0 );
+    int right = std::min( m_changedRight + 1, m_width - 1 ), bottom = std::min( m_changedBottom + 1, m_height - 1 );
+    std::vector<int> invalidated;
+
+    for ( int v = top; v <= bottom; v++ ) {
+      for ( int h = left; h <= right; h++ ) {
+        int cell = v * m_width + h;
+
+        if ( m_direction[cell] < 8 && !CanMove( h, v, m_direction[cell] ) )
+          Invalidate( cell, invalidated );
+      }
+    }
+
+    // Search again from the valid cells around the invalidated ones and
+    // from the changed area, where new moves may have become possible
+    m_open.clear();
+
+    for ( size_t i = 0; i < invalidated.size(); i++ ) {
+      int h = invalidated[i] % m_width, v = invalidated[i] / m_width;
+
+      for ( int d = 0; d < 8; d++ ) {
+        int nh = h + DIRECTION_H[d], nv = v + DIRECTION_V[d];
+
+        if ( IsOpen( nh, nv ) && m_cost[nv * m_width + nh] < UNREACHABLE_COST )
+          Push( nv * m_width + nh );
+      }
+    }
+
+    for ( int v = top; v <= bottom; v++ ) {
+      for ( int h = left; h <= right; h++ ) {
+        if ( m_cost[v * m_width + h] < UNREACHABLE_COST )
+          Push( v * m_width + h );
+      }
+    }
+
+    Propagate();
+  }
+
+  void CFlowField::Rebuild() {
+    m_rebuild = false;
+    m_open.clear();
+
+    for ( int v = 0; v < m_height; v++ ) {
+      for ( int h = 0; h < m_width; h++ ) {
+        int cell = v * m_width + h;
+        bool forbidden = ( m_grid ? m_grid->IsCellForbidden( h, v ) : m_direction[cell] == FD_FORBIDDEN );
+
+        m_direction[cell] = ( forbidden ? FD_FORBIDDEN : FD_UNREACHABLE );
+        m_cost[cell] = UNREACHABLE_COST;
+      }
+    }
+
+    if ( m_goal < 0 || m_direction[m_goal] == FD_FORBIDDEN )
+      return;
+
+    m_direction[m_goal] = FD_GOAL;
+    m_cost[m_goal] = 0.0f;
+    Push( m_goal );
+    Propagate();
+  }
+
+  void CFlowField::Invalidate( int aCell, std::vector<int>& aInvalidated ) {
+    size_t first = aInvalidated.size();
+
+    m_direction[aCell] = FD_UNREACHABLE;
+    m_cost[aCell] = UNREACHABLE_COST;
+    aInvalidated.push_back( aCell );
+
+    // Cells whose direction points to an invalidated cell are invalid too
+    for ( size_t i = first; i < aInvalidated.size(); i++ ) {
+      int h = aInvalidated[i] % m_width, v = aInvalidated[i] / m_width;
+
+      for ( int d = 0; d < 8; d++ ) {
+        int nh = h + DIRECTION_H[d], nv = v + DIRECTION_V[d];
+
+        if ( nh < 0 || nv < 0 || nh >= m_width || nv >= m_height )
+          continue;
+
+        int neighbour = nv * m_width + nh;
+        if ( m_direction[neighbour] == ( ( d + 4 ) & 7 ) ) {
+          m_direction[neighbour] = FD_UNREACHABLE;
+          m_cost[neighbour] = UNREACHABLE_COST;
+          aInvalidated.push_back( neighbour );
+        }
+      }
+    }
+  }
+
+  void CFlowField::Push( int aCell ) {
+    OPENCELL open;
+    open.cost = m_cost[aCell];
+    open.cell = aCell;
+
+    m_open.push_back( open );
+    std::push_heap( m_open.begin(), m_open.end(), OpenCellGreater() );
+  }
+
+  void CFlowField::Propagate() {
+    int step = ( m_diagonal ? 1 : 2 );
+
+    while ( !m_open.empty() ) {
+      std::pop_heap( m_open.begin(), m_open.end(), OpenCellGreater() );
+      OPENCELL open = m_open.back();
+      m_open.pop_back();
+
+      if ( open.cost > m_cost[open.cell] )
+        continue;
+
+      int h = open.cell % m_width, v = open.cell / m_width;
+
+      for ( int d = 0; d < 8; d += step ) {
+        int nh = h + DIRECTION_H[d], nv = v + DIRECTION_V[d];
+        int back = ( d + 4 ) & 7;
+
+        if ( !IsOpen( nh, nv ) || !CanMove( nh, nv, back ) )
+          continue;
+
+        int neighbour = nv * m_width + nh;
+        float cost = open.cost + ( ( d & 1 ) ? DIAGONAL_COST : 1.0f );
+
+        if ( cost < m_cost[neighbour] ) {
+          m_cost[neighbour] = cost;
+          m_direction[neighbour] = (unsigned char) back;
+          Push( neighbour );
+        }
+      }
+    }
+  }
+
+  int CFlowField::GetCellDirection( int aH, int aV ) {
+    Update();
+
+    if ( aH < 0 || aV < 0 || aH >= m_width || aV >= m_height )
+      return FD_FORBIDDEN;
+
+    return m_direction[aV * m_width + aH];
+  }
+
+  double CFlowField::GetCellDistance( int aH, int aV ) {
+    Update();
+
+    if ( aH < 0 || aV < 0 || aH >= m_width || aV >= m_height )
+      return -1.0;
+
+    float cost = m_cost[aV * m_width + aH];
+    return ( cost < UNREACHABLE_COST ? cost : -1.0 );
+  }
+
+  double CFlowField::GetDirection( double aX, double aY ) {
+    int direction = GetCellDirection( (int) floor( ( aX - m_left ) / m_cellWidth ),
+                                      (int) floor( ( aY - m_top ) / m_cellHeight ) );
+
+    return ( direction < 8 ? direction * 45.0 : -1.0 );
+  }
+
+  double CFlowField::GetDistance( double aX, double aY ) {
+    return GetCellDistance( (int) floor( ( aX - m_left ) / m_cellWidth ),
+                            (int) floor( ( aY - m_top ) / m_cellHeight ) );
+  }
+
+  int CFlowField::Steer( int aObject, double aSpeed, bool aSmooth ) {
+    Update();
+
+    CInstanceFilter filter( aObject );
+    int count = 0;
+    PGMINSTANCE* instances = CRoomInstances::GetArray( count );
+
+    if ( !instances )
+      return 0;
+
+    // Positions are gathered first, so that the field is sampled in one
+    // pass over plain arrays
+    std::vector<PGMINSTANCE> steered;
+    std::vector<double> x, y;
+
+    for ( int i = 0; i < count; i++ ) {
+      if ( !filter.Matches( instances[i] ) )
+        continue;
+
+      double ix, iy;
+      CRoomInstances::GetPosition( instances[i], ix, iy );
+
+      steered.push_back( instances[i] );
+      x.push_back( ( ix - m_left ) / m_cellWidth );
+      y.push_back( ( iy - m_top ) / m_cellHeight );
+    }
+
+    std::vector<double> direction( steered.size() );
+
+    for ( size_t i = 0; i < steered.size(); i++ ) {
+      int h = (int) floor( x[i] ), v = (int) floor( y[i] );
+      int code = ( h >= 0 && v >= 0 && h < m_width && v < m_height ? m_direction[v * m_width + h] : (int) FD_FORBIDDEN );
+
+      if ( code >= 8 ) {
+        direction[i] = ( code == FD_GOAL ? -1.0 : -2.0 );
+        continue;
+      }
+
+      double dx = DIRECTION_X[code], dy = DIRECTION_Y[code];
+
+      if ( aSmooth ) {
+        // Bilinear blend of the directions at the centers of the nearest cells
+        double fx = x[i] - 0.5, fy = y[i] - 0.5;
+        int h0 = (int) floor( fx ), v0 = (int) floor( fy );
+        double tx = fx - h0, ty = fy - v0;
+        double sx = 0.0, sy = 0.0;
+
+        for ( int j = 0; j < 4; j++ ) {
+          int ch = h0 + ( j & 1 ), cv = v0 + ( j >> 1 );
+          if ( ch < 0 || cv < 0 || ch >= m_width || cv >= m_height )
+            continue;
+
+          int neighbourCode = m_direction[cv * m_width + ch];
+          if ( neighbourCode >= 8 )
+            continue;
+
+          double weight = ( ( j & 1 ) ? tx : 1.0 - tx ) * ( ( j >> 1 ) ? ty : 1.0 - ty );
+          sx += weight * DIRECTION_X[neighbourCode];
+          sy += weight * DIRECTION_Y[neighbourCode];
+        }
+
+        if ( sx * sx + sy * sy > 1e-6 ) {
+          dx = sx;
+          dy = sy;
+        }
+      }
+
+      double degrees = atan2( -dy, dx ) * ( 180.0 / 3.14159265358979323846 );
+      direction[i] = ( degrees < 0.0 ? degrees + 360.0 : degrees );
+    }
+
+    int changed = 0;
+
+    for ( size_t i = 0; i < steered.size(); i++ ) {
+      if ( direction[i] == -2.0 )
+        continue;
+
+      if ( direction[i] < 0.0 )
+        CRoomInstances::SetMotion( steered[i], 0.0, 0.0 );
+      else
+        CRoomInstances::SetMotion( steered[i], direction[i], aSpeed );
+
+      changed++;
+    }
+
+    return changed;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void FlowFieldCreate( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( -1.0 );
+
+      try {
+        aResult->Set( (double) CFlowField::Create( (int) aArgs[0].real, aArgs[1].real >= 0.5 ) );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( FlowFieldCreate )
+
+    void FlowFieldDestroy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      CFlowField::Destroy( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( FlowFieldDestroy )
+
+    void FlowFieldSetGoal( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( CFlowField::Get( (int) aArgs[0].real ).SetGoal( aArgs[1].real, aArgs[2].real ) ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( FlowFieldSetGoal )
+
+    void FlowFieldDirection( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( -1.0 );
+
+      try {
+        aResult->Set( CFlowField::Get( (int) aArgs[0].real ).GetDirection( aArgs[1].real, aArgs[2].real ) );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( FlowFieldDirection )
+
+    void FlowFieldDistance( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( -1.0 );
+
+      try {
+        aResult->Set( CFlowField::Get( (int) aArgs[0].real ).GetDistance( aArgs[1].real, aArgs[2].real ) );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( FlowFieldDistance )
+
+    void FlowFieldSteer( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( (double) CFlowField::Get( (int) aArgs[0].real ).Steer( (int) aArgs[1].real, aArgs[2].real,
+                                                                             aArgs[3].real >= 0.5 ) );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( FlowFieldSteer )
+  }
+
+  void CFlowField::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+    CMotionGrid::RegisterGMFunctions();
+
+    GMAPI_GMFUNCTION_REGISTER( "flow_field_create", 2, FlowFieldCreate );
+    GMAPI_GMFUNCTION_REGISTER( "flow_field_destroy", 1, FlowFieldDestroy );
+    GMAPI_GMFUNCTION_REGISTER( "flow_field_set_goal", 3, FlowFieldSetGoal );
+    GMAPI_GMFUNCTION_REGISTER( "flow_field_direction", 3, FlowFieldDirection );
+    GMAPI_GMFUNCTION_REGISTER( "flow_field_distance", 3, FlowFieldDistance );
+    GMAPI_GMFUNCTION_REGISTER( "flow_field_steer", 4, FlowFieldSteer );
+  }
+
+#endif
+
+}
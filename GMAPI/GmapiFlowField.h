@@ -0,0 +1,214 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiFlowField.h                                                    */
+/*   - Flow fields leading to a common goal on mp_grids                 */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiMotionGrid.h"
+#include "GmapiDSCommon.h"
+
+#include <vector>
+
+namespace gm {
+
+  /// CFlowField
+  ///   Distance to a goal cell (integration field) and direction of the
+  ///   shortest path to the goal (direction field) for every cell of a
+  ///   mirrored grid. Moves follow the rules of mp_grid_path.
+  ///
+  ///   Changes of the grid are collected and applied by Update, which is
+  ///   called by all methods reading the field. Only cells whose shortest
+  ///   path crosses a changed cell are recomputed; large changes rebuild
+  ///   the whole field. When the grid is destroyed, the field keeps its
+  ///   last state.
+  ///
+  class CFlowField {
+    public:
+      /// Direction codes; codes 0-7 point to the next cell of the path,
+      /// direction in degrees is code * 45
+      enum FieldDirection { FD_GOAL = 8, FD_UNREACHABLE = 9, FD_FORBIDDEN = 10 };
+
+      /// Ctor( const CMotionGrid& aGrid, bool aDiagonal )
+      ///   Creates field over the grid, without a goal.
+      ///
+      CFlowField( const CMotionGrid& aGrid, bool aDiagonal );
+
+      /************************************************************************/
+      /* Field management                                                     */
+      /************************************************************************/
+
+      /// Create( int aGridId, bool aDiagonal )
+      ///   Creates new field over the grid.
+      ///
+      /// Returns:
+      ///   ID of the field.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIMotionGridNotExist if the grid is not mirrored.
+      ///
+      static int Create( int aGridId, bool aDiagonal );
+
+      /// Destroy( int aId )
+      ///   Destroys the field.
+      ///
+      /// Returns:
+      ///   False if the field did not exist.
+      ///
+      static bool Destroy( int aId );
+
+      static CFlowField* Find( int aId ) {
+        return m_fields.Find( aId );
+      }
+
+      /// Get( int aId )
+      ///   Returns the field with specified ID.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIDataStructureNotExist if the field does not exist.
+      ///
+      static CFlowField& Get( int aId ) {
+        return m_fields.Get( aId );
+      }
+
+      /************************************************************************/
+      /* Field content                                                        */
+      /************************************************************************/
+
+      int GetGridID() const { return m_gridId; }
+      int GetWidth() const { return m_width; }
+      int GetHeight() const { return m_height; }
+
+      /// SetGoal( double aX, double aY )
+      ///   Sets the goal to the cell containing the point in the room.
+      ///
+      /// Returns:
+      ///   False if the point lies outside the grid; the field then has
+      ///   no goal and all cells are unreachable.
+      ///
+      bool SetGoal( double aX, double aY );
+
+      /// Update()
+      ///   Applies changes of the grid made since the last update.
+      ///
+      void Update();
+
+      /// GetCellDirection( int aH, int aV )
+      ///   Returns direction code of the cell; cells outside the grid are
+      ///   forbidden.
+      ///
+      int GetCellDirection( int aH, int aV );
+
+      /// GetCellDistance( int aH, int aV )
+      ///   Returns length of the shortest path from the cell to the goal
+      ///   in cells, or -1 if the goal is unreachable.
+      ///
+      double GetCellDistance( int aH, int aV );
+
+      /// GetDirection( double aX, double aY )
+      ///   Returns direction (in degrees) of the path from the cell
+      ///   containing the point, or -1 if there is no path.
+      ///
+      double GetDirection( double aX, double aY );
+
+      /// GetDistance( double aX, double aY )
+      ///   Returns GetCellDistance of the cell containing the point.
+      ///
+      double GetDistance( double aX, double aY );
+
+      /// Steer( int aObject, double aSpeed, bool aSmooth )
+      ///   Sets direction and speed of all instances matching aObject
+      ///   (object, instance or all) to follow the field. Instances in the
+      ///   goal cell are stopped, instances without a path are not changed.
+      ///   If aSmooth is true, the direction is interpolated between the
+      ///   directions of the four nearest cells.
+      ///
+      /// Returns:
+      ///   Number of instances changed.
+      ///
+      int Steer( int aObject, double aSpeed, bool aSmooth );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers CMotionGrid functions and the following GML functions:
+      ///     flow_field_create( grid, allowdiag ) - returns ID of the field or
+      ///       -1 if the grid is not mirrored
+      ///     flow_field_destroy( id )
+      ///     flow_field_set_goal( id, x, y ) - returns true if the point lies
+      ///       inside the grid
+      ///     flow_field_direction( id, x, y ) - returns direction or -1
+      ///     flow_field_distance( id, x, y ) - returns distance in cells or -1
+      ///     flow_field_steer( id, obj, speed, smooth ) - returns number of
+      ///       changed instances
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      class CGridListener;
+      friend class CGridListener;
+
+      struct OPENCELL {
+        float cost;
+        int cell;
+      };
+
+      bool IsOpen( int aH, int aV ) const {
+        return ( aH >= 0 && aV >= 0 && aH < m_width && aV < m_height &&
+                 m_direction[aV * m_width + aH] != FD_FORBIDDEN );
+      }
+
+      bool CanMove( int aH, int aV, int aDirection ) const;
+      void CellsChanged( int aLeft, int aTop, int aRight, int aBottom );
+      void Rebuild();
+      void Invalidate( int aCell, std::vector<int>& aInvalidated );
+      void Push( int aCell );
+      void Propagate();
+
+      int m_gridId;
+      const CMotionGrid* m_grid;   // NULL after the grid has been destroyed
+      int m_width;
+      int m_height;
+      double m_left;
+      double m_top;
+      double m_cellWidth;
+      double m_cellHeight;
+      bool m_diagonal;
+      int m_goal;                  // -1 if there is no goal
+
+      std::vector<float> m_cost;   // Distance to the goal, infinite for unreachable cells
+      std::vector<unsigned char> m_direction;
+      std::vector<OPENCELL> m_open;
+
+      // Range of the cells changed since the last update
+      bool m_changed;
+      bool m_rebuild;
+      int m_changedLeft;
+      int m_changedTop;
+      int m_changedRight;
+      int m_changedBottom;
+
+      static CDSRegistry<CFlowField> m_fields;
+  };
+
+}
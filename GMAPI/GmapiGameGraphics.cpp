@@ -27,6 +27,8 @@
 #include "GmapiGameGraphics.h"
 #include "GmapiMacros.h"
 #include "GmapiConsts.h"
+#include "GmapiTextureTracker.h"
+#include "GmapiSurfacePool.h"
 
 namespace gm {
 
@@ -34,6 +36,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ sprite, subimg, x, y };
 
+    CTextureTracker::MarkSprite( sprite, subimg );
     GM_NORMAL_CALL( id_draw_sprite );
   }
 
@@ -42,6 +45,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ sprite, subimg, x, y, w, h };
 
+    CTextureTracker::MarkSprite( sprite, subimg );
     GM_NORMAL_CALL( id_draw_sprite_stretched );
   }
 
@@ -49,6 +53,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ sprite, subimg, x, y };
 
+    CTextureTracker::MarkSprite( sprite, subimg );
     GM_NORMAL_CALL( id_draw_sprite_tiled );
   }
 
@@ -57,6 +62,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ sprite, subimg, left, top, width, height, x, y };
 
+    CTextureTracker::MarkSprite( sprite, subimg );
     GM_NORMAL_CALL( id_draw_sprite_part );
   }
 
@@ -64,6 +70,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ back, x, y };
 
+    CTextureTracker::MarkBackground( back );
     GM_NORMAL_CALL( id_draw_background );
   }
 
@@ -72,6 +79,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ back, x, y, w, h };
 
+    CTextureTracker::MarkBackground( back );
     GM_NORMAL_CALL( id_draw_background_stretched );
   }
 
@@ -79,6 +87,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ back, x, y };
 
+    CTextureTracker::MarkBackground( back );
     GM_NORMAL_CALL( id_draw_background_tiled );
   }
 
@@ -87,6 +96,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ back, left, top, width, height, x, y };
 
+    CTextureTracker::MarkBackground( back );
     GM_NORMAL_CALL( id_draw_background_part );
   }
 
@@ -96,6 +106,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ sprite, subimg, x, y, xscale, yscale, rot, color, alpha };
 
+    CTextureTracker::MarkSprite( sprite, subimg );
     GM_NORMAL_CALL( id_draw_sprite_ext );
   }
 
@@ -105,6 +116,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ sprite, subimg, x, y, w, h, color, alpha };
 
+    CTextureTracker::MarkSprite( sprite, subimg );
     GM_NORMAL_CALL( id_draw_sprite_stretched_ext );
   }
 
@@ -114,6 +126,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ sprite, subimg, x, y, xscale, yscale, color, alpha };
 
+    CTextureTracker::MarkSprite( sprite, subimg );
     GM_NORMAL_CALL( id_draw_sprite_tiled_ext );
   }
 
@@ -124,6 +137,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ sprite, subimg, left, top, width, height, x, y, xscale, yscale, color, alpha };
 
+    CTextureTracker::MarkSprite( sprite, subimg );
     GM_NORMAL_CALL( id_draw_sprite_part_ext );
   }
 
@@ -136,6 +150,7 @@ namespace gm {
     GM_ARGS{ sprite, subimg, left, top, width, height, x, y, xscale, yscale, rot, c1, c2, c3,
                 c4, alpha };
 
+    CTextureTracker::MarkSprite( sprite, subimg );
     GM_NORMAL_CALL( id_draw_sprite_general );
   }
 
@@ -145,6 +160,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ back, x, y, xscale, yscale, rot, color, alpha };
 
+    CTextureTracker::MarkBackground( back );
     GM_NORMAL_CALL( id_draw_background_ext );
   }
 
@@ -154,6 +170,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ back, x, y, w, h, color, alpha };
 
+    CTextureTracker::MarkBackground( back );
     GM_NORMAL_CALL( id_draw_background_stretched_ext );
   }
 
@@ -163,6 +180,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ back, x, y, xscale, yscale, color, alpha };
 
+    CTextureTracker::MarkBackground( back );
     GM_NORMAL_CALL( id_draw_background_tiled_ext );
   }
 
@@ -173,6 +191,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ back, left, top, width, height, x, y, xscale, yscale, color, alpha };
 
+    CTextureTracker::MarkBackground( back );
     GM_NORMAL_CALL( id_draw_background_part_ext );
   }
 
@@ -185,6 +204,7 @@ namespace gm {
     GM_ARGS{ back, left, top, width, height, x, y, xscale, yscale, rot, c1, c2, c3, c4,
                 alpha };
 
+    CTextureTracker::MarkBackground( back );
     GM_NORMAL_CALL( id_draw_background_general );
   }
 
@@ -760,6 +780,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ id };
 
+    CSurfacePool::Forget( id );
     GM_NORMAL_CALL( id_surface_free );
   }
 
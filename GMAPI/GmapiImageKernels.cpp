@@ -0,0 +1,613 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiImageKernels.cpp                                               */
+/*   - In-place processing of sprite and background bitmaps             */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiImageKernels.h"
+#include "GmapiUtilities.h"
+#include "GmapiMacros.h"
+
+#include <emmintrin.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+namespace gm {
+
+  /************************************************************************/
+  /* Pixel kernels                                                        */
+  /************************************************************************/
+
+  namespace {
+    // Pixels per thread when a bitmap is split between processors
+    static const int PARALLEL_PIXELS = 65536;
+    // Largest radius of BoxBlur
+    static const int MAX_BLUR_RADIUS = 255;
+    static const DWORD ALPHA_MASK = 0xFF000000;
+
+    // Parameters of a pixel kernel, shared by the threads processing
+    // parts of the bitmap
+    struct PIXELJOB {
+      void (*kernel)( DWORD* aPixels, int aCount, const PIXELJOB& aJob );
+      DWORD* pixels;
+      int width;
+      DWORD color;       // 0x00RRGGBB
+      int weight;        // 0-255
+      int hue;
+      int saturation;
+      int value;
+    };
+
+    // Line blurs of a box blur pass; lines are rows or columns
+    struct BLURJOB {
+      const DWORD* source;
+      DWORD* target;
+      int length;        // Pixels in a line
+      int step;          // Distance of pixels in a line
+      int stride;        // Distance of lines
+      int radius;
+    };
+
+    inline DWORD ToPixelColor( int aColor ) {
+      return ( ( aColor & 0xFF ) << 16 ) | ( aColor & 0xFF00 ) | ( ( aColor >> 16 ) & 0xFF );
+    }
+
+    inline int ToWeight( double aAmount ) {
+      return (int) floor( std::min( std::max( aAmount, 0.0 ), 1.0 ) * 255.0 + 0.5 );
+    }
+
+    // Exact rounded division by 255 of values up to 255 * 255
+    inline int Div255( int aValue ) {
+      aValue += 128;
+      return ( aValue + ( aValue >> 8 ) ) >> 8;
+    }
+
+    inline __m128i Div255( __m128i aValue ) {
+      __m128i value = _mm_add_epi16( aValue, _mm_set1_epi16( 128 ) );
+      return _mm_srli_epi16( _mm_add_epi16( value, _mm_srli_epi16( value, 8 ) ), 8 );
+    }
+
+    // Spreads alpha of both pixels in the register to all their channels
+    inline __m128i SpreadAlpha( __m128i aPixels ) {
+      return _mm_shufflehi_epi16( _mm_shufflelo_epi16( aPixels, 0xFF ), 0xFF );
+    }
+
+    void PremultiplyPixels( DWORD* aPixels, int aCount, const PIXELJOB& aJob ) {
+      int i = 0;
+
+      if ( CCpuInfo::HasSSE2() ) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i alphaMask = _mm_set1_epi32( (int) ALPHA_MASK );
+
+        for ( ; i + 4 <= aCount; i += 4 ) {
+          __m128i pixels = _mm_loadu_si128( (__m128i*) ( aPixels + i ) );
+          __m128i low = _mm_unpacklo_epi8( pixels, zero );
+          __m128i high = _mm_unpackhi_epi8( pixels, zero );
+
+          low = Div255( _mm_mullo_epi16( low, SpreadAlpha( low ) ) );
+          high = Div255( _mm_mullo_epi16( high, SpreadAlpha( high ) ) );
+
+          __m128i result = _mm_packus_epi16( low, high );
+          result = _mm_or_si128( _mm_andnot_si128( alphaMask, result ), _mm_and_si128( alphaMask, pixels ) );
+          _mm_storeu_si128( (__m128i*) ( aPixels + i ), result );
+        }
+      }
+
+      for ( ; i < aCount; i++ ) {
+        DWORD pixel = aPixels[i];
+        int alpha = pixel >> 24;
+
+        aPixels[i] = ( pixel & ALPHA_MASK ) | ( Div255( ( ( pixel >> 16 ) & 0xFF ) * alpha ) << 16 ) |
+                     ( Div255( ( ( pixel >> 8 ) & 0xFF ) * alpha ) << 8 ) | Div255( ( pixel & 0xFF ) * alpha );
+      }
+    }
+
+    // Divisions need a gather of the reciprocals, so only the opaque and
+    // the transparent pixels are skipped
+    void UnpremultiplyPixels( DWORD* aPixels, int aCount, const PIXELJOB& aJob ) {
+      for ( int i = 0; i < aCount; i++ ) {
+        DWORD pixel = aPixels[i];
+        int alpha = pixel >> 24;
+
+        if ( alpha == 255 || alpha == 0 )
+          continue;
+
+        int r = std::min( ( (int) ( ( pixel >> 16 ) & 0xFF ) * 255 + alpha / 2 ) / alpha, 255 );
+        int g = std::min( ( (int) ( ( pixel >> 8 ) & 0xFF ) * 255 + alpha / 2 ) / alpha, 255 );
+        int b = std::min( ( (int) ( pixel & 0xFF ) * 255 + alpha / 2 ) / alpha, 255 );
+
+        aPixels[i] = ( pixel & ALPHA_MASK ) | ( r << 16 ) | ( g << 8 ) | b;
+      }
+    }
+
+    void ColorKeyPixels( DWORD* aPixels, int aCount, const PIXELJOB& aJob ) {
+      int i = 0;
+      int tolerance = aJob.weight;
+
+      if ( CCpuInfo::HasSSE2() ) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i alphaMask = _mm_set1_epi32( (int) ALPHA_MASK );
+        __m128i key = _mm_set1_epi32( (int) aJob.color );
+        __m128i limit = _mm_set1_epi8( (char) tolerance );
+
+        for ( ; i + 4 <= aCount; i += 4 ) {
+          __m128i pixels = _mm_loadu_si128( (__m128i*) ( aPixels + i ) );
+          // Channels further from the key than the tolerance stay non-zero
+          __m128i difference = _mm_or_si128( _mm_subs_epu8( pixels, key ), _mm_subs_epu8( key, pixels ) );
+          __m128i excess = _mm_andnot_si128( alphaMask, _mm_subs_epu8( difference, limit ) );
+          __m128i keyed = _mm_and_si128( _mm_cmpeq_epi32( excess, zero ), alphaMask );
+
+          _mm_storeu_si128( (__m128i*) ( aPixels + i ), _mm_andnot_si128( keyed, pixels ) );
+        }
+      }
+
+      for ( ; i < aCount; i++ ) {
+        DWORD pixel = aPixels[i];
+
+        if ( abs( (int) ( ( pixel >> 16 ) & 0xFF ) - (int) ( ( aJob.color >> 16 ) & 0xFF ) ) <= tolerance &&
+             abs( (int) ( ( pixel >> 8 ) & 0xFF ) - (int) ( ( aJob.color >> 8 ) & 0xFF ) ) <= tolerance &&
+             abs( (int) ( pixel & 0xFF ) - (int) ( aJob.color & 0xFF ) ) <= tolerance )
+          aPixels[i] = pixel & ~ALPHA_MASK;
+      }
+    }
+
+    void TintPixels( DWORD* aPixels, int aCount, const PIXELJOB& aJob ) {
+      int i = 0;
+      int r = ( aJob.color >> 16 ) & 0xFF, g = ( aJob.color >> 8 ) & 0xFF, b = aJob.color & 0xFF;
+
+      if ( CCpuInfo::HasSSE2() ) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i factor = _mm_setr_epi16( (short) b, (short) g, (short) r, 255, (short) b, (short) g, (short) r, 255 );
+
+        for ( ; i + 4 <= aCount; i += 4 ) {
+          __m128i pixels = _mm_loadu_si128( (__m128i*) ( aPixels + i ) );
+          __m128i low = Div255( _mm_mullo_epi16( _mm_unpacklo_epi8( pixels, zero ), factor ) );
+          __m128i high = Div255( _mm_mullo_epi16( _mm_unpackhi_epi8( pixels, zero ), factor ) );
+
+          _mm_storeu_si128( (__m128i*) ( aPixels + i ), _mm_packus_epi16( low, high ) );
+        }
+      }
+
+      for ( ; i < aCount; i++ ) {
+        DWORD pixel = aPixels[i];
+
+        aPixels[i] = ( pixel & ALPHA_MASK ) | ( Div255( (int) ( ( pixel >> 16 ) & 0xFF ) * r ) << 16 ) |
+                     ( Div255( (int) ( ( pixel >> 8 ) & 0xFF ) * g ) << 8 ) | Div255( (int) ( pixel & 0xFF ) * b );
+      }
+    }
+
+    void BlendPixels( DWORD* aPixels, int aCount, const PIXELJOB& aJob ) {
+      int i = 0;
+      int weight = aJob.weight, inverse = 255 - aJob.weight;
+      int r = ( ( aJob.color >> 16 ) & 0xFF ) * weight, g = ( ( aJob.color >> 8 ) & 0xFF ) * weight,
+          b = ( aJob.color & 0xFF ) * weight;
+
+      if ( CCpuInfo::HasSSE2() ) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i factor = _mm_setr_epi16( (short) inverse, (short) inverse, (short) inverse, 255,
+                                         (short) inverse, (short) inverse, (short) inverse, 255 );
+        __m128i color = _mm_setr_epi16( (short) b, (short) g, (short) r, 0, (short) b, (short) g, (short) r, 0 );
+
+        for ( ; i + 4 <= aCount; i += 4 ) {
+          __m128i pixels = _mm_loadu_si128( (__m128i*) ( aPixels + i ) );
+          __m128i low = _mm_mullo_epi16( _mm_unpacklo_epi8( pixels, zero ), factor );
+          __m128i high = _mm_mullo_epi16( _mm_unpackhi_epi8( pixels, zero ), factor );
+
+          low = Div255( _mm_add_epi16( low, color ) );
+          high = Div255( _mm_add_epi16( high, color ) );
+          _mm_storeu_si128( (__m128i*) ( aPixels + i ), _mm_packus_epi16( low, high ) );
+        }
+      }
+
+      for ( ; i < aCount; i++ ) {
+        DWORD pixel = aPixels[i];
+
+        aPixels[i] = ( pixel & ALPHA_MASK ) | ( Div255( (int) ( ( pixel >> 16 ) & 0xFF ) * inverse + r ) << 16 ) |
+                     ( Div255( (int) ( ( pixel >> 8 ) & 0xFF ) * inverse + g ) << 8 ) |
+                     Div255( (int) ( pixel & 0xFF ) * inverse + b );
+      }
+    }
+
+    void GrayscalePixels( DWORD* aPixels, int aCount, const PIXELJOB& aJob ) {
+      int i = 0;
+      int weight = aJob.weight, inverse = 255 - aJob.weight;
+
+      if ( CCpuInfo::HasSSE2() ) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i luma = _mm_setr_epi16( 29, 150, 77, 0, 29, 150, 77, 0 );
+        __m128i rounding = _mm_set1_epi32( 128 );
+        __m128i factor = _mm_setr_epi16( (short) inverse, (short) inverse, (short) inverse, 255,
+                                         (short) inverse, (short) inverse, (short) inverse, 255 );
+        __m128i grayFactor = _mm_setr_epi16( (short) weight, (short) weight, (short) weight, 0,
+                                             (short) weight, (short) weight, (short) weight, 0 );
+
+        for ( ; i + 4 <= aCount; i += 4 ) {
+          __m128i pixels = _mm_loadu_si128( (__m128i*) ( aPixels + i ) );
+          __m128i halves[2] = { _mm_unpacklo_epi8( pixels, zero ), _mm_unpackhi_epi8( pixels, zero ) };
+
+          for ( int j = 0; j < 2; j++ ) {
+            // (b * 29 + g * 150) and r * 77 of both pixels, summed in the
+            // lower halves of the 64bit lanes
+            __m128i sums = _mm_madd_epi16( halves[j], luma );
+            sums = _mm_add_epi32( sums, _mm_srli_epi64( sums, 32 ) );
+            __m128i gray = _mm_srli_epi32( _mm_add_epi32( sums, rounding ), 8 );
+            gray = _mm_shufflehi_epi16( _mm_shufflelo_epi16( gray, 0 ), 0 );
+
+            halves[j] = Div255( _mm_add_epi16( _mm_mullo_epi16( halves[j], factor ),
+                                               _mm_mullo_epi16( gray, grayFactor ) ) );
+          }
+
+          _mm_storeu_si128( (__m128i*) ( aPixels + i ), _mm_packus_epi16( halves[0], halves[1] ) );
+        }
+      }
+
+      for ( ; i < aCount; i++ ) {
+        DWORD pixel = aPixels[i];
+        int r = ( pixel >> 16 ) & 0xFF, g = ( pixel >> 8 ) & 0xFF, b = pixel & 0xFF;
+        int gray = ( ( b * 29 + g * 150 + r * 77 + 128 ) >> 8 ) * weight;
+
+        aPixels[i] = ( pixel & ALPHA_MASK ) | ( Div255( r * inverse + gray ) << 16 ) |
+                     ( Div255( g * inverse + gray ) << 8 ) | Div255( b * inverse + gray );
+      }
+    }
+
+    // Hue conversions branch per pixel, so they are not vectorized
+    void ShiftHSVPixels( DWORD* aPixels, int aCount, const PIXELJOB& aJob ) {
+      for ( int i = 0; i < aCount; i++ ) {
+        DWORD pixel = aPixels[i];
+        int r = ( pixel >> 16 ) & 0xFF, g = ( pixel >> 8 ) & 0xFF, b = pixel & 0xFF;
+        int maximum = std::max( r, std::max( g, b ) ), minimum = std::min( r, std::min( g, b ) );
+        int range = maximum - minimum;
+        double hue = 0.0;
+
+        if ( range > 0 ) {
+          if ( maximum == r )
+            hue = (double) ( g - b ) / range;
+          else if ( maximum == g )
+            hue = 2.0 + (double) ( b - r ) / range;
+          else
+            hue = 4.0 + (double) ( r - g ) / range;
+        }
+
+        // Hue in range <0; 6), saturation and value in range <0; 255>
+        hue += aJob.hue * ( 6.0 / 256.0 );
+        hue -= 6.0 * floor( hue / 6.0 );
+
+        double saturation = ( maximum > 0 ? range * 255.0 / maximum : 0.0 );
+        saturation = std::min( std::max( saturation + aJob.saturation, 0.0 ), 255.0 ) / 255.0;
+        double value = std::min( std::max( maximum + aJob.value, 0 ), 255 );
+
+        int sector = std::min( (int) hue, 5 );
+        double fraction = hue - sector;
+        int p = (int) ( value * ( 1.0 - saturation ) + 0.5 );
+        int q = (int) ( value * ( 1.0 - saturation * fraction ) + 0.5 );
+        int t = (int) ( value * ( 1.0 - saturation * ( 1.0 - fraction ) ) + 0.5 );
+        int v = (int) value;
+
+        switch ( sector ) {
+          case 0: r = v; g = t; b = p; break;
+          case 1: r = q; g = v; b = p; break;
+          case 2: r = p; g = v; b = t; break;
+          case 3: r = p; g = q; b = v; break;
+          case 4: r = t; g = p; b = v; break;
+          default: r = v; g = p; b = q; break;
+        }
+
+        aPixels[i] = ( pixel & ALPHA_MASK ) | ( r << 16 ) | ( g << 8 ) | b;
+      }
+    }
+
+    void PixelJobProc( void* aContext, int aBegin, int aEnd ) {
+      const PIXELJOB& job = *(const PIXELJOB*) aContext;
+      job.kernel( job.pixels + aBegin * job.width, ( aEnd - aBegin ) * job.width, job );
+    }
+
+    void RunPixelJob( PIXELJOB& aJob, unsigned char* aBitmap, int aWidth, int aHeight ) {
+      if ( !aBitmap || aWidth <= 0 || aHeight <= 0 )
+        return;
+
+      aJob.pixels = (DWORD*) aBitmap;
+      aJob.width = aWidth;
+      CParallel::For( aHeight, std::max( PARALLEL_PIXELS / aWidth, 1 ), PixelJobProc, &aJob );
+    }
+
+    /************************************************************************/
+    /* Blur                                                                 */
+    /************************************************************************/
+
+    // Running sum of a line; pixels beyond the ends repeat the end pixels
+    void BlurLine( const DWORD* aSource, DWORD* aTarget, int aLength, int aStep, int aRadius ) {
+      float scale = 1.0f / ( 2 * aRadius + 1 );
+      int last = aLength - 1;
+
+      if ( CCpuInfo::HasSSE2() ) {
+        __m128i zero = _mm_setzero_si128();
+        __m128 factor = _mm_set1_ps( scale );
+        __m128 half = _mm_set1_ps( 0.5f );
+
+        #define GMAPI_LOADPIXEL( aIndex ) \
+          _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( (int) aSource[( aIndex ) * aStep] ), zero ), zero )
+
+        __m128i sum = _mm_mullo_epi16( GMAPI_LOADPIXEL( 0 ), _mm_set1_epi32( aRadius + 1 ) );
+
+        for ( int i = 1; i <= aRadius; i++ )
+          sum = _mm_add_epi32( sum, GMAPI_LOADPIXEL( std::min( i, last ) ) );
+
+        for ( int i = 0; i < aLength; i++ ) {
+          __m128i average = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps( sum ), factor ), half ) );
+          average = _mm_packs_epi32( average, average );
+          aTarget[i * aStep] = (DWORD) _mm_cvtsi128_si32( _mm_packus_epi16( average, average ) );
+
+          sum = _mm_add_epi32( sum, GMAPI_LOADPIXEL( std::min( i + aRadius + 1, last ) ) );
+          sum = _mm_sub_epi32( sum, GMAPI_LOADPIXEL( std::max( i - aRadius, 0 ) ) );
+        }
+
+        #undef GMAPI_LOADPIXEL
+        return;
+      }
+
+      int sum[4];
+
+      for ( int c = 0; c < 4; c++ )
+        sum[c] = (int) ( ( aSource[0] >> ( c * 8 ) ) & 0xFF ) * ( aRadius + 1 );
+
+      for ( int i = 1; i <= aRadius; i++ ) {
+        DWORD pixel = aSource[std::min( i, last ) * aStep];
+
+        for ( int c = 0; c < 4; c++ )
+          sum[c] += ( pixel >> ( c * 8 ) ) & 0xFF;
+      }
+
+      for ( int i = 0; i < aLength; i++ ) {
+        DWORD average = 0;
+
+        for ( int c = 0; c < 4; c++ )
+          average |= (DWORD) (int) ( sum[c] * scale + 0.5f ) << ( c * 8 );
+
+        aTarget[i * aStep] = average;
+
+        DWORD added = aSource[std::min( i + aRadius + 1, last ) * aStep];
+        DWORD removed = aSource[std::max( i - aRadius, 0 ) * aStep];
+
+        for ( int c = 0; c < 4; c++ )
+          sum[c] += (int) ( ( added >> ( c * 8 ) ) & 0xFF ) - (int) ( ( removed >> ( c * 8 ) ) & 0xFF );
+      }
+    }
+
+    void BlurJobProc( void* aContext, int aBegin, int aEnd ) {
+      const BLURJOB& job = *(const BLURJOB*) aContext;
+
+      for ( int i = aBegin; i < aEnd; i++ )
+        BlurLine( job.source + i * job.stride, job.target + i * job.stride, job.length, job.step, job.radius );
+    }
+
+    void BoxBlurPixels( DWORD* aPixels, int aWidth, int aHeight, int aRadius, std::vector<DWORD>& aBuffer ) {
+      aRadius = std::min( aRadius, MAX_BLUR_RADIUS );
+
+      if ( !aPixels || aWidth <= 0 || aHeight <= 0 || aRadius <= 0 )
+        return;
+
+      aBuffer.resize( aWidth * aHeight );
+
+      // Rows are blurred into the buffer, then columns back to the bitmap
+      BLURJOB rows = { aPixels, &aBuffer[0], aWidth, 1, aWidth, aRadius };
+      CParallel::For( aHeight, std::max( PARALLEL_PIXELS / aWidth, 1 ), BlurJobProc, &rows );
+
+      BLURJOB columns = { &aBuffer[0], aPixels, aHeight, aWidth, 1, aRadius };
+      CParallel::For( aWidth, std::max( PARALLEL_PIXELS / aHeight, 1 ), BlurJobProc, &columns );
+    }
+  }
+
+  /************************************************************************/
+  /* CImageKernels class implementation                                   */
+  /************************************************************************/
+
+  void CImageKernels::Premultiply( unsigned char* aBitmap, int aWidth, int aHeight ) {
+    PIXELJOB job = PIXELJOB();
+
+    job.kernel = PremultiplyPixels;
+    RunPixelJob( job, aBitmap, aWidth, aHeight );
+  }
+
+  void CImageKernels::Unpremultiply( unsigned char* aBitmap, int aWidth, int aHeight ) {
+    PIXELJOB job = PIXELJOB();
+
+    job.kernel = UnpremultiplyPixels;
+    RunPixelJob( job, aBitmap, aWidth, aHeight );
+  }
+
+  void CImageKernels::ColorKey( unsigned char* aBitmap, int aWidth, int aHeight, int aColor, int aTolerance ) {
+    PIXELJOB job = PIXELJOB();
+
+    job.kernel = ColorKeyPixels;
+    job.color = ToPixelColor( aColor );
+    job.weight = std::min( std::max( aTolerance, 0 ), 255 );
+    RunPixelJob( job, aBitmap, aWidth, aHeight );
+  }
+
+  void CImageKernels::Tint( unsigned char* aBitmap, int aWidth, int aHeight, int aColor ) {
+    PIXELJOB job = PIXELJOB();
+
+    job.kernel = TintPixels;
+    job.color = ToPixelColor( aColor );
+    RunPixelJob( job, aBitmap, aWidth, aHeight );
+  }
+
+  void CImageKernels::Blend( unsigned char* aBitmap, int aWidth, int aHeight, int aColor, double aAmount ) {
+    PIXELJOB job = PIXELJOB();
+
+    job.kernel = BlendPixels;
+    job.color = ToPixelColor( aColor );
+    job.weight = ToWeight( aAmount );
+    RunPixelJob( job, aBitmap, aWidth, aHeight );
+  }
+
+  void CImageKernels::Grayscale( unsigned char* aBitmap, int aWidth, int aHeight, double aAmount ) {
+    PIXELJOB job = PIXELJOB();
+
+    job.kernel = GrayscalePixels;
+    job.weight = ToWeight( aAmount );
+    RunPixelJob( job, aBitmap, aWidth, aHeight );
+  }
+
+  void CImageKernels::ShiftHSV( unsigned char* aBitmap, int aWidth, int aHeight, int aHue, int aSaturation, int aValue ) {
+    PIXELJOB job = PIXELJOB();
+
+    job.kernel = ShiftHSVPixels;
+    job.hue = aHue;
+    job.saturation = aSaturation;
+    job.value = aValue;
+    RunPixelJob( job, aBitmap, aWidth, aHeight );
+  }
+
+  void CImageKernels::BoxBlur( unsigned char* aBitmap, int aWidth, int aHeight, int aRadius ) {
+    std::vector<DWORD> buffer;
+    BoxBlurPixels( (DWORD*) aBitmap, aWidth, aHeight, aRadius, buffer );
+  }
+
+  void CImageKernels::GaussianBlur( unsigned char* aBitmap, int aWidth, int aHeight, double aSigma ) {
+    if ( aSigma <= 0.0 )
+      return;
+
+    // Widths of the boxes whose variances sum up to the Gaussian's one;
+    // the first 'smaller' boxes are two pixels narrower than the rest
+    double variance = 12.0 * aSigma * aSigma;
+    int width = (int) floor( sqrt( variance / 3.0 + 1.0 ) );
+
+    if ( width % 2 == 0 )
+      width--;
+
+    int smaller = (int) floor( ( variance - 3 * width * width - 12 * width - 9 ) / ( -4.0 * width - 4.0 ) + 0.5 );
+    std::vector<DWORD> buffer;
+
+    for ( int i = 0; i < 3; i++ )
+      BoxBlurPixels( (DWORD*) aBitmap, aWidth, aHeight, ( ( i < smaller ? width : width + 2 ) - 1 ) / 2, buffer );
+  }
+
+  bool CImageKernels::Apply( unsigned char* aBitmap, int aWidth, int aHeight, int aFilter,
+                             double aArg0, double aArg1, double aArg2 ) {
+    switch ( aFilter ) {
+      case IF_PREMULTIPLY:
+        Premultiply( aBitmap, aWidth, aHeight );
+        break;
+
+      case IF_UNPREMULTIPLY:
+        Unpremultiply( aBitmap, aWidth, aHeight );
+        break;
+
+      case IF_COLORKEY:
+        ColorKey( aBitmap, aWidth, aHeight, (int) aArg0, (int) aArg1 );
+        break;
+
+      case IF_TINT:
+        Tint( aBitmap, aWidth, aHeight, (int) aArg0 );
+        break;
+
+      case IF_BLEND:
+        Blend( aBitmap, aWidth, aHeight, (int) aArg0, aArg1 );
+        break;
+
+      case IF_GRAYSCALE:
+        Grayscale( aBitmap, aWidth, aHeight, aArg0 );
+        break;
+
+      case IF_HSV:
+        ShiftHSV( aBitmap, aWidth, aHeight, (int) aArg0, (int) aArg1, (int) aArg2 );
+        break;
+
+      case IF_BOXBLUR:
+        BoxBlur( aBitmap, aWidth, aHeight, (int) aArg0 );
+        break;
+
+      case IF_GAUSSIANBLUR:
+        GaussianBlur( aBitmap, aWidth, aHeight, aArg0 );
+        break;
+
+      default:
+        return false;
+    }
+
+    return true;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void SpriteFilter( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( 0.0 );
+
+      try {
+        ISprite& sprite = CGMAPI::Ptr()->Sprites[(int) aArgs[0].real];
+        int subimage = (int) aArgs[1].real;
+        int first = ( subimage < 0 ? 0 : subimage );
+        int last = ( subimage < 0 ? sprite.Subimages.GetCount() - 1 : subimage );
+        bool applied = true;
+
+        for ( int i = first; i <= last && applied; i++ )
+          applied = CImageKernels::Apply( sprite.Subimages[i].GetBitmap(), sprite.GetWidth(), sprite.GetHeight(),
+                                          (int) aArgs[2].real, aArgs[3].real, aArgs[4].real, aArgs[5].real );
+
+        aResult->Set( applied ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SpriteFilter )
+
+    void BackgroundFilter( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( 0.0 );
+
+      try {
+        IBackground& background = CGMAPI::Ptr()->Backgrounds[(int) aArgs[0].real];
+
+        if ( background.GetBitmap() )
+          aResult->Set( CImageKernels::Apply( background.GetBitmap(), background.GetWidth(), background.GetHeight(),
+                                              (int) aArgs[1].real, aArgs[2].real, aArgs[3].real,
+                                              aArgs[4].real ) ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( BackgroundFilter )
+  }
+
+  void CImageKernels::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+
+    GMAPI_GMFUNCTION_REGISTER( "sprite_filter", 6, SpriteFilter );
+    GMAPI_GMFUNCTION_REGISTER( "background_filter", 5, BackgroundFilter );
+  }
+
+#endif
+
+}
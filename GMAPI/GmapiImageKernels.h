@@ -0,0 +1,132 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiImageKernels.h                                                 */
+/*   - In-place processing of sprite and background bitmaps             */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+
+namespace gm {
+
+  /// CImageKernels
+  ///   Image operations working in place on 32bit ARGB bitmaps, as
+  ///   returned by ISpriteSubimage::GetBitmap and IBackground::GetBitmap.
+  ///   Pixels are stored row by row without padding; each one is a DWORD
+  ///   0xAARRGGBB. Colors passed to the kernels are GM colors (0xBBGGRR).
+  ///
+  ///   The kernels use SSE2 when the processor supports it and split
+  ///   large bitmaps by rows between all processors. Both code paths give
+  ///   the same results, except for the blurs, whose rounding may differ
+  ///   by one.
+  ///
+  ///   Only the bitmaps are changed; textures the runner has already
+  ///   created from them are not updated.
+  ///
+  class CImageKernels {
+    public:
+      /// Filters of Apply and the GML functions
+      enum ImageFilter { IF_PREMULTIPLY, IF_UNPREMULTIPLY, IF_COLORKEY, IF_TINT, IF_BLEND,
+                         IF_GRAYSCALE, IF_HSV, IF_BOXBLUR, IF_GAUSSIANBLUR };
+
+      /// Premultiply( unsigned char* aBitmap, int aWidth, int aHeight )
+      ///   Multiplies color channels by alpha.
+      ///
+      static void Premultiply( unsigned char* aBitmap, int aWidth, int aHeight );
+
+      /// Unpremultiply( unsigned char* aBitmap, int aWidth, int aHeight )
+      ///   Divides color channels by alpha; reverts Premultiply, except
+      ///   for the precision lost on translucent pixels.
+      ///
+      static void Unpremultiply( unsigned char* aBitmap, int aWidth, int aHeight );
+
+      /// ColorKey( unsigned char* aBitmap, int aWidth, int aHeight, int aColor, int aTolerance )
+      ///   Makes transparent all pixels whose channels differ from aColor
+      ///   by at most aTolerance (0-255).
+      ///
+      static void ColorKey( unsigned char* aBitmap, int aWidth, int aHeight, int aColor, int aTolerance );
+
+      /// Tint( unsigned char* aBitmap, int aWidth, int aHeight, int aColor )
+      ///   Multiplies color channels by aColor, like image_blend does when
+      ///   drawing.
+      ///
+      static void Tint( unsigned char* aBitmap, int aWidth, int aHeight, int aColor );
+
+      /// Blend( unsigned char* aBitmap, int aWidth, int aHeight, int aColor, double aAmount )
+      ///   Mixes color channels with aColor; aAmount is the weight of aColor
+      ///   (0-1), like in merge_color.
+      ///
+      static void Blend( unsigned char* aBitmap, int aWidth, int aHeight, int aColor, double aAmount );
+
+      /// Grayscale( unsigned char* aBitmap, int aWidth, int aHeight, double aAmount )
+      ///   Mixes color channels with the luma of the pixel; aAmount 1
+      ///   gives fully gray image.
+      ///
+      static void Grayscale( unsigned char* aBitmap, int aWidth, int aHeight, double aAmount );
+
+      /// ShiftHSV( unsigned char* aBitmap, int aWidth, int aHeight, int aHue,
+      ///           int aSaturation, int aValue )
+      ///   Adds the values to hue (wrapped), saturation and value (clamped)
+      ///   of the pixels. Uses the ranges of make_color_hsv (0-255).
+      ///
+      static void ShiftHSV( unsigned char* aBitmap, int aWidth, int aHeight, int aHue, int aSaturation, int aValue );
+
+      /// BoxBlur( unsigned char* aBitmap, int aWidth, int aHeight, int aRadius )
+      ///   Averages all channels over square of (2 * aRadius + 1) pixels;
+      ///   pixels beyond the edges repeat the edge pixels. aRadius is
+      ///   clamped to range <0; 255>. Translucent bitmaps should be
+      ///   premultiplied first, otherwise colors of transparent pixels
+      ///   leak into the result.
+      ///
+      static void BoxBlur( unsigned char* aBitmap, int aWidth, int aHeight, int aRadius );
+
+      /// GaussianBlur( unsigned char* aBitmap, int aWidth, int aHeight, double aSigma )
+      ///   Approximates Gaussian blur with standard deviation aSigma by
+      ///   three box blurs.
+      ///
+      static void GaussianBlur( unsigned char* aBitmap, int aWidth, int aHeight, double aSigma );
+
+      /// Apply( unsigned char* aBitmap, int aWidth, int aHeight, int aFilter,
+      ///        double aArg0, double aArg1, double aArg2 )
+      ///   Calls the kernel of the filter with its arguments in their
+      ///   order; unused arguments are ignored.
+      ///
+      /// Returns:
+      ///   False if the filter is not known.
+      ///
+      static bool Apply( unsigned char* aBitmap, int aWidth, int aHeight, int aFilter,
+                         double aArg0, double aArg1, double aArg2 );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers the following GML functions:
+      ///     sprite_filter( ind, subimg, filter, arg0, arg1, arg2 ) -
+      ///       applies filter (IF_* value) to the subimage or to all
+      ///       subimages if subimg is -1; returns true on success
+      ///     background_filter( ind, filter, arg0, arg1, arg2 ) - applies
+      ///       filter to the background; returns true on success
+      ///
+      static void RegisterGMFunctions();
+    #endif
+  };
+
+}
@@ -29,6 +29,7 @@
 
 #include "GmapiResources.h"
 #include "GmapiGameGraphics.h"
+#include "GmapiBitmapStore.h"
 
 using namespace gm::core;
 
@@ -125,8 +126,14 @@ namespace gm {
   }
 
   CGMAPI::~CGMAPI() {
-    if ( m_gmVersion != GM_VERSION_INCOMPATIBLE )
+    if ( m_gmVersion != GM_VERSION_INCOMPATIBLE ) {
+      // Cold bitmaps are written back, the exception handler of the store
+      // must not outlive the library
+      CBitmapStore::Restore( CBitmapStore::RK_SPRITE, -1 );
+      CBitmapStore::Restore( CBitmapStore::RK_BACKGROUND, -1 );
+
       GMAPIHookUninstall();
+    }
   }
 
   void CGMAPI::RetrieveDataPointers() {
@@ -463,6 +470,15 @@ namespace gm {
     }
   }
 
+  GMFUCTION CGMAPI::GMFunctionOverride( int aFunctionId, GMFUCTION aFunction ) {
+    GMFUCTION previousFunction = (GMFUCTION) m_gmFunctions[aFunctionId];
+
+    GMFunctionRegister( GM_FUNCTION_NAMES[aFunctionId], -2, aFunction );
+    m_gmFunctions[aFunctionId] = (void*) aFunction;
+
+    return previousFunction;
+  }
+
   PFUNCTIONDATA CGMAPI::PreserveFunctionData() {
     PFUNCTIONDATA functionData = new FUNCTIONDATA;
     GMFUNCTIONINFO* functions = new GMFUNCTIONINFO[m_pFunctionData->functionCount];
@@ -730,6 +746,28 @@ namespace gm {
     MessageBoxA( hwnd, buffer, 0, MB_SYSTEMMODAL | MB_ICONERROR );
   }
 
+  void EGMAPIMotionGridNotExist::ShowError() const {
+    HWND hwnd = ( CGMAPI::Ptr() ? CGMAPI::Ptr()->GetMainWindowHandle() : NULL );
+    char buffer[0x200];
+
+    sprintf_s( buffer, sizeof( buffer ),
+               "%s:\n%s\n\n%s:\nGrid ID: %d",
+               STR_GMAPI_ERROR, STR_EXC_MOTIONGRIDNOTEXISTS, STR_GMAPI_DEBUG, m_resourceId );
+
+    MessageBoxA( hwnd, buffer, 0, MB_SYSTEMMODAL | MB_ICONERROR );
+  }
+
+  void EGMAPIDataStructureNotExist::ShowError() const {
+    HWND hwnd = ( CGMAPI::Ptr() ? CGMAPI::Ptr()->GetMainWindowHandle() : NULL );
+    char buffer[0x200];
+
+    sprintf_s( buffer, sizeof( buffer ),
+               "%s:\n%s\n\n%s:\nData structure ID: %d",
+               STR_GMAPI_ERROR, STR_EXC_DATASTRUCTURENOTEXISTS, STR_GMAPI_DEBUG, m_resourceId );
+
+    MessageBoxA( hwnd, buffer, 0, MB_SYSTEMMODAL | MB_ICONERROR );
+  }
+
   /************************************************************************/
   /* Operator overloading                                                 */
   /************************************************************************/
@@ -914,6 +952,22 @@ namespace gm {
     }
   }
 
+  /************************************************************************/
+  /* ISpriteSubimage interface implementation                             */
+  /************************************************************************/
+
+  unsigned char* ISpriteSubimage::GetBitmap() {
+    unsigned char* bitmap;
+
+    if ( CGlobals::UseNewStructs() )
+      bitmap = ISprite::GetPtr()->structNew.bitmaps[m_subimage]->structNew.bits;
+    else
+      bitmap = ISprite::GetPtr()->structOld.bitmaps[m_subimage]->structOld.bits;
+
+    CBitmapStore::MakeResident( bitmap );
+    return bitmap;
+  }
+
   /************************************************************************/
   /* IBackgrounds interface implementation                                */
   /************************************************************************/
@@ -967,8 +1021,11 @@ namespace gm {
   }
 
   unsigned char* IBackground::GetBitmap() {
-    return ( CGlobals::UseNewStructs() ? m_background->structNew.bitmap->structNew.bits :
-                                         m_background->structOld.bitmap->structOld.bits );
+    unsigned char* bitmap = ( CGlobals::UseNewStructs() ? m_background->structNew.bitmap->structNew.bits :
+                                                          m_background->structOld.bitmap->structOld.bits );
+
+    CBitmapStore::MakeResident( bitmap );
+    return bitmap;
   }
 
   int IBackground::GetTextureID() {
@@ -1211,6 +1211,30 @@ namespace gm {
       virtual void ShowError() const;
   };
 
+  class EGMAPIMotionGridNotExist: public EGMAPIResourceException {
+    public:
+      explicit EGMAPIMotionGridNotExist( int aGrid ) {
+        m_resourceId = aGrid;
+      }
+
+      /// ShowError()
+      ///   Shows message box with error message
+      ///
+      virtual void ShowError() const;
+  };
+
+  class EGMAPIDataStructureNotExist: public EGMAPIResourceException {
+    public:
+      explicit EGMAPIDataStructureNotExist( int aDataStructure ) {
+        m_resourceId = aDataStructure;
+      }
+
+      /// ShowError()
+      ///   Shows message box with error message
+      ///
+      virtual void ShowError() const;
+  };
+
   /************************************************************************/
   /* GM resources accessors interfaces                                    */
   /************************************************************************/
@@ -1225,12 +1249,13 @@ namespace gm {
     public:
       /// GetBitmap()
       ///   Returns pointer to the sprite's subimage bitmap. The color
-      ///   format is 32bit ARGB.
+      ///   format is 32bit ARGB. A bitmap compressed by CBitmapStore
+      ///   is decompressed first.
       ///
       /// Returns:
       ///   Pointer to the bitmap.
       ///
-      inline unsigned char* GetBitmap();
+      unsigned char* GetBitmap();
 
       /// GetBitmapSize()
       ///   Returns the size of sprite's subimage bitmap in bytes.
@@ -1603,7 +1628,8 @@ namespace gm {
 
       /// GetBitmap()
       ///   Returns pointer to the background's bitmap. The color
-      ///   format is 32bit ARGB.
+      ///   format is 32bit ARGB. A bitmap compressed by CBitmapStore
+      ///   is decompressed first.
       ///
       /// Returns:
       ///   Pointer to the bitmap or NULL if the bitmap has not been
@@ -5088,6 +5114,23 @@ namespace gm {
       ///
       static void GMFunctionRegister( const char* aName, int aNumberOfArguments, GMFUCTION aFunction );
 
+      /// GMFunctionOverride( int aFunctionId, GMFUCTION aFunction )
+      ///   Replaces one of the GM functions wrapped by GMAPI. Unlike GMFunctionRegister,
+      ///   the change affects also GMAPI's wrapped GM functions, so both the game's
+      ///   GML code and your DLL will call the new function. That method should not
+      ///   be used explicitly, it should be called via GMAPI_GMFUNCTION_OVERRIDE macro.
+      ///
+      /// Parameters:
+      ///   aFunctionId: ID of the wrapped GM function (one of the gm::id_* constants).
+      ///   aFunction: New address of the GM function. The function must use the
+      ///              GM runner's calling convention (see GMFunctionRegister).
+      ///
+      /// Returns:
+      ///   Address of the replaced function. It can be passed to core::RunnerCallFunction
+      ///   to call the original function from within the new one.
+      ///
+      static GMFUCTION GMFunctionOverride( int aFunctionId, GMFUCTION aFunction );
+
       /// PatchIdentifierTypeCheckOrder()
       ///   Patches the GM7/GM8 runner in a way that the scripts with the same name as GM functions
       ///   will be ignored when compiling game's GML code (useful when registering new GML functions).
@@ -5662,11 +5705,6 @@ namespace gm {
   /* ISpriteSubimage inlined methods                                      */
   /************************************************************************/
 
-  unsigned char* ISpriteSubimage::GetBitmap() {
-    return ( CGlobals::UseNewStructs() ? ISprite::GetPtr()->structNew.bitmaps[m_subimage]->structNew.bits :
-                                         ISprite::GetPtr()->structOld.bitmaps[m_subimage]->structOld.bits );
-  }
-
   unsigned long ISpriteSubimage::GetBitmapSize() {
     return CGMAPI::GetBitmapSize( ( CGlobals::UseNewStructs() ? ISprite::GetPtr()->structNew.bitmaps[m_subimage] :
                                                                 ISprite::GetPtr()->structOld.bitmaps[m_subimage] ) );
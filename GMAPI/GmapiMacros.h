@@ -80,3 +80,6 @@
 
 #define GMAPI_GMFUNCTION_REGISTER( aName, aNumberOfArguments, aFunction ) \
   gm::CGMAPI::GMFunctionRegister( aName, aNumberOfArguments, aFunction##_gmapi_handler )
+
+#define GMAPI_GMFUNCTION_OVERRIDE( aFunctionID, aFunction ) \
+  gm::CGMAPI::GMFunctionOverride( gm:: aFunctionID, aFunction##_gmapi_handler )
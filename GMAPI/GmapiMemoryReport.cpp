@@ -0,0 +1,552 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiMemoryReport.cpp                                               */
+/*   - Accounting of memory used by resources of the runner             */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiMemoryReport.h"
+#include "GmapiInternal.h"
+#include "GmapiMacros.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+
+namespace gm {
+
+  std::vector<CMemoryReport::ENTRY> CMemoryReport::m_current;
+  std::vector<CMemoryReport::ENTRY> CMemoryReport::m_previous;
+
+  namespace {
+    // Names of the categories in reports
+    static const char* const CATEGORY_NAMES[CMemoryReport::MC_COUNT] = {
+      "sprite", "background", "font", "sound", "surface", "texture", "particle", "instance"
+    };
+    // Bytes per texel of the runner's textures
+    static const int TEXEL_SIZE = 4;
+
+    int NextPowerOfTwo( int aValue ) {
+      int result = 1;
+
+      while ( result < aValue )
+        result <<= 1;
+
+      return result;
+    }
+
+    // Size of the texture with padding to power of two dimensions
+    double TextureSize( const GMTEXTURE& aTexture ) {
+      int width = ( aTexture.textureWidth > 0 ? aTexture.textureWidth : NextPowerOfTwo( aTexture.imageWidth ) );
+      int height = ( aTexture.textureHeight > 0 ? aTexture.textureHeight : NextPowerOfTwo( aTexture.imageHeight ) );
+
+      return (double) width * height * TEXEL_SIZE;
+    }
+
+    bool IsTextureValid( int aTextureId ) {
+      return ( aTextureId >= 0 && CGMAPI::GetTextureArray() && CGMAPI::GetTextureArray()[aTextureId].isValid );
+    }
+
+    // Size of a Delphi string: length prefix, characters and terminator
+    double StringSize( const char* aString ) {
+      return ( aString ? (double) ( ((const DWORD*) aString)[-1] + sizeof( DWORD ) * 2 + 1 ) : 0.0 );
+    }
+
+    double ValueSize( const GMVALUE& aValue ) {
+      return ( aValue.type == VT_STRING ? StringSize( aValue.string ) : 0.0 );
+    }
+
+    double VariableListSize( const GMVARIABLELIST* aList ) {
+      if ( !aList || !aList->variables )
+        return 0.0;
+
+      double size = (double) aList->count * sizeof( GMVARIABLE );
+
+      for ( int i = 0; i < aList->count; i++ ) {
+        GMVARIABLE& variable = aList->variables[i];
+        size += ValueSize( variable );
+
+        if ( !variable.values )
+          continue;
+
+        unsigned long rows = variable.GetFirstDimensionSize();
+        size += (double) rows * sizeof( GMVALUE* );
+
+        for ( unsigned long row = 0; row < rows; row++ ) {
+          unsigned long columns = variable.GetSecondDimensionSize( row );
+          size += (double) columns * sizeof( GMVALUE );
+
+          for ( unsigned long column = 0; column < columns; column++ )
+            size += ValueSize( variable.values[row][column] );
+        }
+      }
+
+      return size;
+    }
+
+    bool InstanceEnumProc( GMINSTANCE& aInstance, void* aParam ) {
+      std::vector<CMemoryReport::ENTRY>& entries = *(std::vector<CMemoryReport::ENTRY>*) aParam;
+      CMemoryReport::ENTRY entry;
+
+      entry.category = CMemoryReport::MC_INSTANCE;
+
+      if ( CGlobals::UseNewStructs() ) {
+        entry.id = aInstance.structNew.id;
+        entry.bytes = sizeof( GMINSTANCE_NEW ) + VariableListSize( aInstance.structNew.variableListPtr );
+        entry.detail = aInstance.structNew.object_index;
+      } else {
+        entry.id = aInstance.structOld.id;
+        entry.bytes = sizeof( GMINSTANCE_OLD ) + VariableListSize( aInstance.structOld.variableListPtr );
+        entry.detail = aInstance.structOld.object_index;
+      }
+
+      entries.push_back( entry );
+      return true;
+    }
+
+    void AppendNumber( std::string& aOutput, double aValue ) {
+      char buffer[32];
+      sprintf_s( buffer, sizeof( buffer ), "%.0f", aValue );
+      aOutput += buffer;
+    }
+
+    void AppendCsvString( std::string& aOutput, const std::string& aValue ) {
+      aOutput += '"';
+
+      for ( size_t i = 0; i < aValue.size(); i++ ) {
+        if ( aValue[i] == '"' )
+          aOutput += '"';
+
+        aOutput += aValue[i];
+      }
+
+      aOutput += '"';
+    }
+
+    void AppendJsonString( std::string& aOutput, const std::string& aValue ) {
+      aOutput += '"';
+
+      for ( size_t i = 0; i < aValue.size(); i++ ) {
+        unsigned char c = (unsigned char) aValue[i];
+
+        if ( c == '"' || c == '\\' ) {
+          aOutput += '\\';
+          aOutput += (char) c;
+        } else if ( c < 0x20 ) {
+          char buffer[8];
+          sprintf_s( buffer, sizeof( buffer ), "\\u%04x", c );
+          aOutput += buffer;
+        } else
+          aOutput += (char) c;
+      }
+
+      aOutput += '"';
+    }
+  }
+
+  /************************************************************************/
+  /* CMemoryReport class implementation                                   */
+  /************************************************************************/
+
+  const char* CMemoryReport::GetCategoryName( Category aCategory ) {
+    return ( aCategory >= 0 && aCategory < MC_COUNT ? CATEGORY_NAMES[aCategory] : "" );
+  }
+
+  double CMemoryReport::GetTextureSize( int aTexture ) {
+    return ( IsTextureValid( aTexture ) ? TextureSize( CGMAPI::GetTextureArray()[aTexture] ) : 0.0 );
+  }
+
+  void CMemoryReport::AddEntry( Category aCategory, int aId, const char* aName, double aBytes, double aDetail ) {
+    ENTRY entry;
+
+    entry.category = aCategory;
+    entry.id = aId;
+    entry.name = ( aName ? aName : "" );
+    entry.bytes = aBytes;
+    entry.detail = aDetail;
+
+    m_current.push_back( entry );
+  }
+
+  void CMemoryReport::AddSprites( int& aMaxTexture ) {
+    PGMSPRITESTORAGE storage = CGMAPI::SpriteData();
+
+    if ( !storage->sprites )
+      return;
+
+    for ( int i = 0; i < storage->arraySize; i++ ) {
+      PGMSPRITE sprite = storage->sprites[i];
+
+      if ( !sprite )
+        continue;
+
+      int count = ( CGlobals::UseNewStructs() ? sprite->structNew.subimageCount : sprite->structOld.subimageCount );
+      PGMBITMAP* bitmaps = ( CGlobals::UseNewStructs() ? sprite->structNew.bitmaps : sprite->structOld.bitmaps );
+      const int* textures = ( CGlobals::UseNewStructs() ? sprite->structNew.textureIds :
+                                                          (const int*) sprite->structOld.textureIds );
+      double bytes = 0.0;
+
+      for ( int n = 0; n < count; n++ ) {
+        if ( bitmaps && bitmaps[n] )
+          bytes += CGMAPI::GetBitmapSize( bitmaps[n] );
+
+        if ( textures )
+          aMaxTexture = std::max( aMaxTexture, textures[n] );
+      }
+
+      AddEntry( MC_SPRITE, i, storage->names[i], bytes, count );
+    }
+  }
+
+  void CMemoryReport::AddBackgrounds( int& aMaxTexture ) {
+    PGMBACKGROUNDSTORAGE storage = CGMAPI::BackgroundData();
+
+    if ( !storage->backgrounds )
+      return;
+
+    for ( int i = 0; i < storage->arraySize; i++ ) {
+      PGMBACKGROUND background = storage->backgrounds[i];
+
+      if ( !background )
+        continue;
+
+      GMBITMAP* bitmap = ( CGlobals::UseNewStructs() ? background->structNew.bitmap : background->structOld.bitmap );
+      int texture = ( CGlobals::UseNewStructs() ? background->structNew.textureId : background->structOld.textureId );
+
+      aMaxTexture = std::max( aMaxTexture, texture );
+      AddEntry( MC_BACKGROUND, i, storage->names[i], ( bitmap ? CGMAPI::GetBitmapSize( bitmap ) : 0.0 ), 0.0 );
+    }
+  }
+
+  void CMemoryReport::AddFonts( int& aMaxTexture ) {
+    PGMFONTSTORAGE storage = CGMAPI::FontData();
+
+    if ( !storage->fonts )
+      return;
+
+    for ( int i = 0; i < storage->arraySize; i++ ) {
+      PGMFONT font = storage->fonts[i];
+
+      if ( !font )
+        continue;
+
+      aMaxTexture = std::max( aMaxTexture, font->textureId );
+      AddEntry( MC_FONT, i, storage->names[i], ( font->bitmap ? (double) ((DWORD*) font->bitmap)[-1] : 0.0 ),
+                font->size );
+    }
+  }
+
+  void CMemoryReport::AddSounds() {
+    PGMSOUNDSTORAGE storage = CGMAPI::SoundData();
+
+    if ( !storage->sounds )
+      return;
+
+    for ( int i = 0; i < storage->arraySize; i++ ) {
+      PGMSOUND sound = storage->sounds[i];
+
+      if ( sound )
+        AddEntry( MC_SOUND, i, storage->names[i], ( sound->sndData ? (double) sound->sndData->fileSize : 0.0 ),
+                  sound->type );
+    }
+  }
+
+  void CMemoryReport::AddSurfaces( std::vector<bool>& aSurfaceTextures, int& aMaxTexture ) {
+    GMSURFACE* surfaces = CGMAPI::GetSurfaceArray();
+
+    if ( !surfaces )
+      return;
+
+    for ( int i = 0; i < *CGMAPI::SurfaceArraySizePtr(); i++ ) {
+      if ( !surfaces[i].exists )
+        continue;
+
+      int texture = surfaces[i].textureId;
+      double bytes = GetTextureSize( texture );
+
+      if ( texture >= 0 ) {
+        if ( texture >= (int) aSurfaceTextures.size() )
+          aSurfaceTextures.resize( texture + 1, false );
+
+        aSurfaceTextures[texture] = true;
+        aMaxTexture = std::max( aMaxTexture, texture );
+      }
+
+      AddEntry( MC_SURFACE, i, NULL, bytes, texture );
+    }
+  }
+
+  void CMemoryReport::AddTextures( const std::vector<bool>& aSurfaceTextures, int aMaxTexture ) {
+    for ( int i = 0; i <= aMaxTexture; i++ ) {
+      if ( !IsTextureValid( i ) || ( i < (int) aSurfaceTextures.size() && aSurfaceTextures[i] ) )
+        continue;
+
+      const GMTEXTURE& texture = CGMAPI::GetTextureArray()[i];
+      double bytes = TextureSize( texture );
+
+      AddEntry( MC_TEXTURE, i, NULL, bytes, bytes - (double) texture.imageWidth * texture.imageHeight * TEXEL_SIZE );
+    }
+  }
+
+  void CMemoryReport::AddParticles() {
+    PGMPARTICLESTORAGE storage = CGMAPI::ParticleData();
+
+    if ( !storage )
+      return;
+
+    AddEntry( MC_PARTICLE, -1, "types", (double) storage->particleTypeCount * sizeof( GMPARTICLETYPE ),
+              storage->particleTypeCount );
+
+    if ( !storage->particleSystems )
+      return;
+
+    for ( int i = 0; i < storage->particleSystemCount; i++ ) {
+      const GMPARTICLESYSTEM& system = storage->particleSystems[i];
+
+      if ( !system.isValid )
+        continue;
+
+      double bytes = sizeof( GMPARTICLESYSTEM ) +
+                     (double) system.particleCount * sizeof( GMPARTICLE ) +
+                     (double) system.emitterCount * sizeof( GMPARTICLEEMITTER ) +
+                     (double) system.attractorCount * sizeof( GMPARTICLEATTRACTOR ) +
+                     (double) system.destroyerCount * sizeof( GMPARTICLEDESTROYER ) +
+                     (double) system.deflectorCount * sizeof( GMPARTICLEDEFLECTOR ) +
+                     (double) system.changerCount * sizeof( GMPARTICLECHANGER );
+
+      AddEntry( MC_PARTICLE, i, NULL, bytes, system.particleCount );
+    }
+  }
+
+  void CMemoryReport::AddInstances() {
+    CGMAPI::Ptr()->EnumerateInstances( InstanceEnumProc, &m_current );
+  }
+
+  double CMemoryReport::TakeSnapshot() {
+    std::vector<bool> surfaceTextures;
+    int maxTexture = -1;
+
+    m_previous.swap( m_current );
+    m_current.clear();
+
+    AddSprites( maxTexture );
+    AddBackgrounds( maxTexture );
+    AddFonts( maxTexture );
+    AddSounds();
+    AddSurfaces( surfaceTextures, maxTexture );
+    AddTextures( surfaceTextures, maxTexture );
+    AddParticles();
+    AddInstances();
+
+    return GetTotal( -1, false );
+  }
+
+  void CMemoryReport::ClearSnapshots() {
+    m_current.clear();
+    m_previous.clear();
+  }
+
+  double CMemoryReport::GetTotal( int aCategory, bool aDelta ) {
+    double total = 0.0;
+
+    for ( size_t i = 0; i < m_current.size(); i++ ) {
+      if ( aCategory < 0 || m_current[i].category == aCategory )
+        total += m_current[i].bytes;
+    }
+
+    if ( aDelta ) {
+      for ( size_t i = 0; i < m_previous.size(); i++ ) {
+        if ( aCategory < 0 || m_previous[i].category == aCategory )
+          total -= m_previous[i].bytes;
+      }
+    }
+
+    return total;
+  }
+
+  void CMemoryReport::CollectRows( std::vector<ROW>& aRows, bool aDelta ) {
+    typedef std::map<std::pair<int, int>, size_t> EntryMap;
+    EntryMap previous;
+
+    for ( size_t i = 0; i < m_previous.size(); i++ )
+      previous[std::make_pair( (int) m_previous[i].category, m_previous[i].id )] = i;
+
+    for ( size_t i = 0; i < m_current.size(); i++ ) {
+      ROW row = { &m_current[i], m_current[i].bytes, 0.0 };
+      EntryMap::iterator match = previous.find( std::make_pair( (int) m_current[i].category, m_current[i].id ) );
+
+      if ( match != previous.end() ) {
+        row.previous = m_previous[match->second].bytes;
+        previous.erase( match );
+      }
+
+      if ( !aDelta || row.bytes != row.previous )
+        aRows.push_back( row );
+    }
+
+    // Entries which do not exist anymore
+    for ( EntryMap::iterator it = previous.begin(); it != previous.end(); ++it ) {
+      ROW row = { &m_previous[it->second], 0.0, m_previous[it->second].bytes };
+
+      if ( !aDelta || row.previous != 0.0 )
+        aRows.push_back( row );
+    }
+  }
+
+  void CMemoryReport::Write( std::string& aOutput, Format aFormat, bool aDelta ) {
+    std::vector<ROW> rows;
+    CollectRows( rows, aDelta );
+
+    aOutput.clear();
+
+    if ( aFormat == RF_CSV ) {
+      aOutput += "category,id,name,bytes,delta,detail\r\n";
+
+      for ( size_t i = 0; i < rows.size(); i++ ) {
+        aOutput += GetCategoryName( rows[i].entry->category );
+        aOutput += ',';
+        AppendNumber( aOutput, rows[i].entry->id );
+        aOutput += ',';
+        AppendCsvString( aOutput, rows[i].entry->name );
+        aOutput += ',';
+        AppendNumber( aOutput, rows[i].bytes );
+        aOutput += ',';
+        AppendNumber( aOutput, rows[i].bytes - rows[i].previous );
+        aOutput += ',';
+        AppendNumber( aOutput, rows[i].entry->detail );
+        aOutput += "\r\n";
+      }
+
+      return;
+    }
+
+    aOutput += "{\"total\":";
+    AppendNumber( aOutput, GetTotal( -1, false ) );
+    aOutput += ",\"delta\":";
+    AppendNumber( aOutput, GetTotal( -1, true ) );
+    aOutput += ",\"categories\":{";
+
+    for ( int i = 0; i < MC_COUNT; i++ ) {
+      if ( i > 0 )
+        aOutput += ',';
+
+      AppendJsonString( aOutput, CATEGORY_NAMES[i] );
+      aOutput += ":{\"bytes\":";
+      AppendNumber( aOutput, GetTotal( i, false ) );
+      aOutput += ",\"delta\":";
+      AppendNumber( aOutput, GetTotal( i, true ) );
+      aOutput += '}';
+    }
+
+    aOutput += "},\"entries\":[";
+
+    for ( size_t i = 0; i < rows.size(); i++ ) {
+      aOutput += ( i > 0 ? ",\r\n{\"category\":" : "\r\n{\"category\":" );
+      AppendJsonString( aOutput, GetCategoryName( rows[i].entry->category ) );
+      aOutput += ",\"id\":";
+      AppendNumber( aOutput, rows[i].entry->id );
+      aOutput += ",\"name\":";
+      AppendJsonString( aOutput, rows[i].entry->name );
+      aOutput += ",\"bytes\":";
+      AppendNumber( aOutput, rows[i].bytes );
+      aOutput += ",\"delta\":";
+      AppendNumber( aOutput, rows[i].bytes - rows[i].previous );
+      aOutput += ",\"detail\":";
+      AppendNumber( aOutput, rows[i].entry->detail );
+      aOutput += '}';
+    }
+
+    aOutput += "]}\r\n";
+  }
+
+  bool CMemoryReport::Save( const char* aFileName, Format aFormat, bool aDelta ) {
+    std::string data;
+    Write( data, aFormat, aDelta );
+
+    HANDLE file = CreateFileA( aFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+
+    if ( file == INVALID_HANDLE_VALUE )
+      return false;
+
+    DWORD written;
+    bool result = ( WriteFile( file, data.data(), (DWORD) data.size(), &written, NULL ) && written == data.size() );
+    CloseHandle( file );
+
+    return result;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void MemoryReportSnapshot( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                               int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( CMemoryReport::TakeSnapshot() );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MemoryReportSnapshot )
+
+    void MemoryReportTotal( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( CMemoryReport::GetTotal( (int) aArgs[0].real, aArgs[1].real != 0.0 ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MemoryReportTotal )
+
+    void MemoryReportSave( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      CMemoryReport::Format format = ( (int) aArgs[1].real == CMemoryReport::RF_JSON ? CMemoryReport::RF_JSON :
+                                                                                      CMemoryReport::RF_CSV );
+
+      aResult->Set( CMemoryReport::Save( aArgs[0].string, format, aArgs[2].real != 0.0 ) ? 1.0 : 0.0 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MemoryReportSave )
+
+    void MemoryReportClear( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      CMemoryReport::ClearSnapshots();
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MemoryReportClear )
+  }
+
+  void CMemoryReport::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+
+    GMAPI_GMFUNCTION_REGISTER( "memory_report_snapshot", 0, MemoryReportSnapshot );
+    GMAPI_GMFUNCTION_REGISTER( "memory_report_total", 2, MemoryReportTotal );
+    GMAPI_GMFUNCTION_REGISTER( "memory_report_save", 3, MemoryReportSave );
+    GMAPI_GMFUNCTION_REGISTER( "memory_report_clear", 0, MemoryReportClear );
+  }
+
+#endif
+
+}
@@ -0,0 +1,161 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiMemoryReport.h                                                 */
+/*   - Accounting of memory used by resources of the runner             */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include <string>
+#include <vector>
+
+namespace gm {
+
+  /// CMemoryReport
+  ///   Takes snapshots of memory used by the runner's resources and writes
+  ///   them as CSV or JSON reports. Each snapshot has one entry for every
+  ///   existing resource:
+  ///     sprites and backgrounds - sizes of their bitmaps
+  ///     fonts - size of the glyph bitmap
+  ///     sounds - size of the sound file held in memory
+  ///     surfaces - size of the surface's texture
+  ///     textures - size of textures not owned by surfaces, including
+  ///       the padding to power of two dimensions
+  ///     particles - capacity of the arrays of each particle system and
+  ///       of the array of particle types (entry with ID -1)
+  ///     instances - size of the variable list of each instance of the
+  ///       current room, with its arrays and strings
+  ///
+  ///   Textures are found by scanning the texture array up to the largest
+  ///   texture ID used by a resource; textures above it which no resource
+  ///   refers to are not counted.
+  ///
+  ///   The previous snapshot is kept, so reports can show how much each
+  ///   entry grew or shrank since then - taking a snapshot in every room
+  ///   start event shows resources leaked between rooms.
+  ///
+  class CMemoryReport {
+    public:
+      /// Kinds of entries
+      enum Category { MC_SPRITE, MC_BACKGROUND, MC_FONT, MC_SOUND, MC_SURFACE, MC_TEXTURE,
+                      MC_PARTICLE, MC_INSTANCE, MC_COUNT };
+
+      /// Formats of reports
+      enum Format { RF_CSV, RF_JSON };
+
+      /// Memory used by one resource
+      struct ENTRY {
+        Category category;
+        int id;
+        std::string name;
+        double bytes;
+        double detail;            // Subimages, padding bytes, object etc.
+      };
+
+      /// TakeSnapshot()
+      ///   Walks all resources and replaces the current snapshot, which
+      ///   becomes the previous one.
+      ///
+      /// Returns:
+      ///   Total number of bytes of the new snapshot.
+      ///
+      static double TakeSnapshot();
+
+      /// ClearSnapshots()
+      ///   Forgets both snapshots.
+      ///
+      static void ClearSnapshots();
+
+      static const std::vector<ENTRY>& GetEntries() {
+        return m_current;
+      }
+
+      /// GetTotal( int aCategory, bool aDelta )
+      ///   Returns number of bytes of the category in the current snapshot
+      ///   or, if aDelta is true, its difference from the previous one. If
+      ///   aCategory is -1, all categories are summed.
+      ///
+      static double GetTotal( int aCategory, bool aDelta );
+
+      /// Write( std::string& aOutput, Format aFormat, bool aDelta )
+      ///   Writes the current snapshot as a report. CSV reports have the
+      ///   columns category, id, name, bytes, delta and detail; JSON reports
+      ///   are objects holding totals of the categories and an array of the
+      ///   entries with the same fields. If aDelta is true, only entries
+      ///   whose size differs from the previous snapshot are written,
+      ///   including the ones which do not exist anymore.
+      ///
+      static void Write( std::string& aOutput, Format aFormat, bool aDelta );
+
+      /// Save( const char* aFileName, Format aFormat, bool aDelta )
+      ///   Writes the report into the file.
+      ///
+      /// Returns:
+      ///   False if the file could not be written.
+      ///
+      static bool Save( const char* aFileName, Format aFormat, bool aDelta );
+
+      static const char* GetCategoryName( Category aCategory );
+
+      /// GetTextureSize( int aTexture )
+      ///   Returns size in bytes of the texture, including the padding to
+      ///   power of two dimensions, or 0 if the texture is not valid.
+      ///
+      static double GetTextureSize( int aTexture );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers the following GML functions:
+      ///     memory_report_snapshot() - takes a snapshot; returns total
+      ///       number of bytes
+      ///     memory_report_total( category, delta ) - returns GetTotal
+      ///     memory_report_save( fname, format, delta ) - writes the report
+      ///       (format is RF_* value); returns 1 on success
+      ///     memory_report_clear() - forgets the snapshots
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      /// Sizes of an entry in both snapshots
+      struct ROW {
+        const ENTRY* entry;
+        double bytes;
+        double previous;
+      };
+
+      static void AddEntry( Category aCategory, int aId, const char* aName, double aBytes, double aDetail );
+      static void AddSprites( int& aMaxTexture );
+      static void AddBackgrounds( int& aMaxTexture );
+      static void AddFonts( int& aMaxTexture );
+      static void AddSounds();
+      static void AddSurfaces( std::vector<bool>& aSurfaceTextures, int& aMaxTexture );
+      static void AddTextures( const std::vector<bool>& aSurfaceTextures, int aMaxTexture );
+      static void AddParticles();
+      static void AddInstances();
+      static void CollectRows( std::vector<ROW>& aRows, bool aDelta );
+
+      static std::vector<ENTRY> m_current;
+      static std::vector<ENTRY> m_previous;
+  };
+
+}
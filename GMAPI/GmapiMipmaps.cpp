@@ -0,0 +1,609 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiMipmaps.cpp                                                    */
+/*   - Downscaled levels of sprites and backgrounds                     */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiMipmaps.h"
+#include "GmapiPng.h"
+#include "GmapiResources.h"
+#include "GmapiGameGraphics.h"
+#include "GmapiUtilities.h"
+#include "GmapiMacros.h"
+
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace gm {
+
+  CMipmaps::ChainMap CMipmaps::m_sprites;
+  CMipmaps::ChainMap CMipmaps::m_backgrounds;
+
+  namespace {
+    // Target rows resampled together; source rows they need are filtered
+    // horizontally once per block
+    static const int BLOCK_ROWS = 16;
+    // Smallest number of row blocks processed by one thread
+    static const int PARALLEL_BLOCKS = 2;
+    // Lobes of the Lanczos filter
+    static const double LANCZOS_LOBES = 3.0;
+    // Steps of the table converting linear light to sRGB
+    static const int LINEAR_STEPS = 8192;
+    static const double PI = 3.14159265358979323846;
+
+    float linearTable[256];
+    unsigned char srgbTable[LINEAR_STEPS + 1];
+    bool tablesReady = false;
+
+    // Number of temporary files created by this process
+    int tempFileCounter = 0;
+
+    void InitTables() {
+      if ( tablesReady )
+        return;
+
+      for ( int i = 0; i < 256; i++ ) {
+        double value = i / 255.0;
+        linearTable[i] = (float) ( value <= 0.04045 ? value / 12.92 : pow( ( value + 0.055 ) / 1.055, 2.4 ) );
+      }
+
+      for ( int i = 0; i <= LINEAR_STEPS; i++ ) {
+        double value = (double) i / LINEAR_STEPS;
+        value = ( value <= 0.0031308 ? value * 12.92 : 1.055 * pow( value, 1.0 / 2.4 ) - 0.055 );
+        srgbTable[i] = (unsigned char) std::min( (int) ( value * 255.0 + 0.5 ), 255 );
+      }
+
+      tablesReady = true;
+    }
+
+    double Lanczos( double aX ) {
+      if ( aX == 0.0 )
+        return 1.0;
+
+      if ( fabs( aX ) >= LANCZOS_LOBES )
+        return 0.0;
+
+      return LANCZOS_LOBES * sin( PI * aX ) * sin( PI * aX / LANCZOS_LOBES ) / ( PI * PI * aX * aX );
+    }
+
+    // Converts row of pixels to premultiplied linear light (B, G, R, A)
+    void DecodeRow( const DWORD* aPixels, int aCount, float* aTarget ) {
+      for ( int x = 0; x < aCount; x++, aTarget += 4 ) {
+        DWORD pixel = aPixels[x];
+        float alpha = (float) ( pixel >> 24 ) * ( 1.0f / 255.0f );
+
+        aTarget[0] = linearTable[pixel & 0xFF] * alpha;
+        aTarget[1] = linearTable[( pixel >> 8 ) & 0xFF] * alpha;
+        aTarget[2] = linearTable[( pixel >> 16 ) & 0xFF] * alpha;
+        aTarget[3] = alpha;
+      }
+    }
+
+    unsigned char EncodeChannel( float aValue, float aAlpha ) {
+      if ( aValue <= 0.0f )
+        return 0;
+
+      return srgbTable[(int) ( std::min( aValue / aAlpha, 1.0f ) * LINEAR_STEPS + 0.5f )];
+    }
+
+    void EncodeRow( const float* aSource, int aCount, DWORD* aPixels ) {
+      for ( int x = 0; x < aCount; x++, aSource += 4 ) {
+        float alpha = std::min( aSource[3], 1.0f );
+        int alphaByte = (int) ( alpha * 255.0f + 0.5f );
+
+        if ( alphaByte <= 0 ) {
+          aPixels[x] = 0;
+          continue;
+        }
+
+        aPixels[x] = ( (DWORD) alphaByte << 24 ) |
+                     ( (DWORD) EncodeChannel( aSource[2], alpha ) << 16 ) |
+                     ( (DWORD) EncodeChannel( aSource[1], alpha ) << 8 ) |
+                     EncodeChannel( aSource[0], alpha );
+      }
+    }
+  }
+
+  /************************************************************************/
+  /* CMipmaps class implementation                                        */
+  /************************************************************************/
+
+  void CMipmaps::ComputeWeights( int aSize, int aTargetSize, ResampleFilter aFilter, WEIGHTS& aWeights ) {
+    double scale = (double) aSize / aTargetSize;
+    double radius = LANCZOS_LOBES * std::max( scale, 1.0 );
+    std::vector<int> first( aTargetSize ), last( aTargetSize );
+
+    // Source pixels covered by each target pixel, clamped to the edges
+    aWeights.taps = 1;
+
+    for ( int x = 0; x < aTargetSize; x++ ) {
+      if ( aFilter == RF_LANCZOS ) {
+        double center = ( x + 0.5 ) * scale - 0.5;
+        first[x] = (int) ceil( center - radius );
+        last[x] = (int) floor( center + radius );
+      } else {
+        first[x] = (int) floor( x * scale );
+        last[x] = (int) ceil( ( x + 1 ) * scale ) - 1;
+      }
+
+      aWeights.taps = std::max( aWeights.taps, std::min( last[x], aSize - 1 ) - std::max( first[x], 0 ) + 1 );
+    }
+
+    aWeights.taps = std::min( aWeights.taps, aSize );
+    aWeights.start.resize( aTargetSize );
+    aWeights.weights.assign( aTargetSize * aWeights.taps, 0.0f );
+
+    // Pixels beyond the edges repeat the edge pixels; every target pixel
+    // gets the same number of taps, unused ones have zero weight
+    for ( int x = 0; x < aTargetSize; x++ ) {
+      int start = std::min( std::max( first[x], 0 ), aSize - aWeights.taps );
+      float* weights = &aWeights.weights[x * aWeights.taps];
+      double sum = 0.0;
+
+      aWeights.start[x] = start;
+
+      for ( int i = first[x]; i <= last[x]; i++ ) {
+        double weight;
+
+        if ( aFilter == RF_LANCZOS )
+          weight = Lanczos( ( i - ( ( x + 0.5 ) * scale - 0.5 ) ) / std::max( scale, 1.0 ) );
+        else
+          weight = std::max( std::min( i + 1.0, ( x + 1 ) * scale ) - std::max( (double) i, x * scale ), 0.0 );
+
+        weights[std::min( std::max( i, 0 ), aSize - 1 ) - start] += (float) weight;
+        sum += weight;
+      }
+
+      for ( int k = 0; k < aWeights.taps && sum != 0.0; k++ )
+        weights[k] = (float) ( weights[k] / sum );
+    }
+  }
+
+  void CMipmaps::ResampleProc( void* aContext, int aBegin, int aEnd ) {
+    const RESAMPLEJOB* job = (const RESAMPLEJOB*) aContext;
+    const WEIGHTS& horizontal = *job->horizontal;
+    const WEIGHTS& vertical = *job->vertical;
+    bool useSSE2 = CCpuInfo::HasSSE2();
+    int rowSize = job->targetWidth * 4;
+
+    std::vector<float> line( job->width * 4 ), accumulator( rowSize ), rows;
+
+    for ( int block = aBegin; block < aEnd; block++ ) {
+      int top = block * BLOCK_ROWS;
+      int bottom = std::min( top + BLOCK_ROWS, job->targetHeight );
+      int firstRow = vertical.start[top];
+      int lastRow = vertical.start[bottom - 1] + vertical.taps;
+
+      rows.resize( ( lastRow - firstRow ) * rowSize );
+
+      // Horizontal pass over the source rows of the block
+      for ( int y = firstRow; y < lastRow; y++ ) {
+        float* target = &rows[( y - firstRow ) * rowSize];
+
+        DecodeRow( (const DWORD*) job->source + y * job->width, job->width, &line[0] );
+
+        for ( int x = 0; x < job->targetWidth; x++, target += 4 ) {
+          const float* weights = &horizontal.weights[x * horizontal.taps];
+          const float* source = &line[horizontal.start[x] * 4];
+
+          if ( useSSE2 ) {
+            __m128 sum = _mm_setzero_ps();
+
+            for ( int k = 0; k < horizontal.taps; k++ )
+              sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( weights[k] ), _mm_loadu_ps( source + k * 4 ) ) );
+
+            _mm_storeu_ps( target, sum );
+          } else {
+            float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            for ( int k = 0; k < horizontal.taps; k++ ) {
+              for ( int c = 0; c < 4; c++ )
+                sum[c] += weights[k] * source[k * 4 + c];
+            }
+
+            memcpy( target, sum, sizeof( sum ) );
+          }
+        }
+      }
+
+      // Vertical pass
+      for ( int y = top; y < bottom; y++ ) {
+        const float* weights = &vertical.weights[y * vertical.taps];
+        float* sum = &accumulator[0];
+
+        std::fill( accumulator.begin(), accumulator.end(), 0.0f );
+
+        for ( int k = 0; k < vertical.taps; k++ ) {
+          const float* source = &rows[( vertical.start[y] + k - firstRow ) * rowSize];
+          int i = 0;
+
+          if ( weights[k] == 0.0f )
+            continue;
+
+          if ( useSSE2 ) {
+            __m128 weight = _mm_set1_ps( weights[k] );
+
+            for ( ; i < rowSize; i += 4 )
+              _mm_storeu_ps( sum + i, _mm_add_ps( _mm_loadu_ps( sum + i ),
+                                                  _mm_mul_ps( weight, _mm_loadu_ps( source + i ) ) ) );
+          }
+
+          for ( ; i < rowSize; i++ )
+            sum[i] += weights[k] * source[i];
+        }
+
+        EncodeRow( sum, job->targetWidth, (DWORD*) job->target + y * job->targetWidth );
+      }
+    }
+  }
+
+  void CMipmaps::Downscale( const unsigned char* aSource, int aWidth, int aHeight, unsigned char* aTarget,
+                            int aTargetWidth, int aTargetHeight, ResampleFilter aFilter ) {
+    if ( aWidth <= 0 || aHeight <= 0 || aTargetWidth <= 0 || aTargetHeight <= 0 )
+      return;
+
+    InitTables();
+
+    WEIGHTS horizontal, vertical;
+    ComputeWeights( aWidth, aTargetWidth, aFilter, horizontal );
+    ComputeWeights( aHeight, aTargetHeight, aFilter, vertical );
+
+    RESAMPLEJOB job = { aSource, aWidth, aHeight, aTarget, aTargetWidth, aTargetHeight, &horizontal, &vertical };
+    CParallel::For( ( aTargetHeight + BLOCK_ROWS - 1 ) / BLOCK_ROWS, PARALLEL_BLOCKS, ResampleProc, &job );
+  }
+
+  int CMipmaps::BuildChain( const unsigned char* aBitmap, int aWidth, int aHeight, ResampleFilter aFilter,
+                            int aLevels, std::vector<LEVEL>& aChain ) {
+    aChain.clear();
+
+    if ( !aBitmap || aWidth <= 0 || aHeight <= 0 )
+      return 0;
+
+    int width = aWidth, height = aHeight;
+
+    while ( ( width > 1 || height > 1 ) && ( aLevels <= 0 || (int) aChain.size() < aLevels ) ) {
+      aChain.push_back( LEVEL() );
+
+      LEVEL& level = aChain.back();
+      const unsigned char* source = ( aChain.size() > 1 ? &aChain[aChain.size() - 2].bitmap[0] : aBitmap );
+
+      level.width = std::max( width / 2, 1 );
+      level.height = std::max( height / 2, 1 );
+      level.bitmap.resize( level.width * level.height * 4 );
+
+      Downscale( source, width, height, &level.bitmap[0], level.width, level.height, aFilter );
+
+      width = level.width;
+      height = level.height;
+    }
+
+    return (int) aChain.size();
+  }
+
+  int CMipmaps::AddResource( bool aSprite, const unsigned char* aBitmap, int aWidth, int aHeight,
+                             int aSubimages, int aOriginX, int aOriginY ) {
+    char directory[MAX_PATH];
+    char fileName[MAX_PATH + 32];
+    int result = -1;
+
+    if ( !GetTempPathA( MAX_PATH, directory ) )
+      return -1;
+
+    sprintf_s( fileName, sizeof( fileName ), "%sgmapimip%08lX_%d.png", directory,
+               (unsigned long) GetCurrentProcessId(), tempFileCounter++ );
+
+    if ( !CPngFile::Save( fileName, aBitmap, aWidth * aSubimages, aHeight ) )
+      return -1;
+
+    if ( aSprite ) {
+      if ( CGlobals::UseNewStructs() )
+        result = sprite_add( fileName, aSubimages, false, false, aOriginX, aOriginY );
+      else
+        result = sprite_add_alpha( fileName, aSubimages, false, true, aOriginX, aOriginY );
+    } else {
+      if ( CGlobals::UseNewStructs() )
+        result = background_add( fileName, false, false );
+      else
+        result = background_add_alpha( fileName, true );
+    }
+
+    DeleteFileA( fileName );
+    return result;
+  }
+
+  int CMipmaps::CreateSpriteLevels( int aSprite, ResampleFilter aFilter, int aLevels ) {
+    // Deleting sprites may rebind the sprite object, so levels are
+    // deleted before it is taken
+    DeleteSpriteLevels( aSprite );
+
+    ISprite& sprite = CGMAPI::Ptr()->Sprites[aSprite];
+    int count = sprite.Subimages.GetCount();
+    int width = sprite.GetWidth(), height = sprite.GetHeight();
+    int originX = sprite.GetOffsetX(), originY = sprite.GetOffsetY();
+
+    if ( count <= 0 || width <= 0 || height <= 0 )
+      return 0;
+
+    std::vector<const unsigned char*> bitmaps( count );
+
+    for ( int i = 0; i < count; i++ ) {
+      bitmaps[i] = sprite.Subimages[i].GetBitmap();
+
+      if ( !bitmaps[i] )
+        return 0;
+    }
+
+    std::vector< std::vector<LEVEL> > chains( count );
+
+    for ( int i = 0; i < count; i++ )
+      BuildChain( bitmaps[i], width, height, aFilter, aLevels, chains[i] );
+
+    CHAIN& chain = m_sprites[aSprite];
+    chain.width = width;
+    chain.height = height;
+
+    for ( size_t n = 0; n < chains[0].size(); n++ ) {
+      int levelWidth = chains[0][n].width, levelHeight = chains[0][n].height;
+      int rowSize = levelWidth * 4;
+      std::vector<unsigned char> strip( rowSize * count * levelHeight );
+
+      // Horizontal strip of the subimages, as expected by sprite_add
+      for ( int i = 0; i < count; i++ ) {
+        for ( int y = 0; y < levelHeight; y++ )
+          memcpy( &strip[( y * count + i ) * rowSize], &chains[i][n].bitmap[y * rowSize], rowSize );
+      }
+
+      int level = AddResource( true, &strip[0], levelWidth, levelHeight, count,
+                               (int) floor( (double) originX * levelWidth / width + 0.5 ),
+                               (int) floor( (double) originY * levelHeight / height + 0.5 ) );
+
+      if ( level < 0 )
+        break;
+
+      chain.levels.push_back( level );
+    }
+
+    if ( chain.levels.empty() )
+      m_sprites.erase( aSprite );
+
+    return GetSpriteLevelCount( aSprite );
+  }
+
+  int CMipmaps::CreateBackgroundLevels( int aBackground, ResampleFilter aFilter, int aLevels ) {
+    DeleteBackgroundLevels( aBackground );
+
+    IBackground& background = CGMAPI::Ptr()->Backgrounds[aBackground];
+    int width = background.GetWidth(), height = background.GetHeight();
+    std::vector<LEVEL> levels;
+
+    if ( !BuildChain( background.GetBitmap(), width, height, aFilter, aLevels, levels ) )
+      return 0;
+
+    CHAIN& chain = m_backgrounds[aBackground];
+    chain.width = width;
+    chain.height = height;
+
+    for ( size_t n = 0; n < levels.size(); n++ ) {
+      int level = AddResource( false, &levels[n].bitmap[0], levels[n].width, levels[n].height, 1, 0, 0 );
+
+      if ( level < 0 )
+        break;
+
+      chain.levels.push_back( level );
+    }
+
+    if ( chain.levels.empty() )
+      m_backgrounds.erase( aBackground );
+
+    return GetBackgroundLevelCount( aBackground );
+  }
+
+  void CMipmaps::DeleteLevels( ChainMap& aChains, int aId, bool aSprites ) {
+    ChainMap::iterator it = ( aId < 0 ? aChains.begin() : aChains.find( aId ) );
+
+    while ( it != aChains.end() && ( aId < 0 || it->first == aId ) ) {
+      const std::vector<int>& levels = it->second.levels;
+
+      for ( size_t i = 0; i < levels.size(); i++ ) {
+        if ( aSprites )
+          sprite_delete( levels[i] );
+        else
+          background_delete( levels[i] );
+      }
+
+      aChains.erase( it++ );
+    }
+  }
+
+  void CMipmaps::DeleteSpriteLevels( int aSprite ) {
+    DeleteLevels( m_sprites, aSprite, true );
+  }
+
+  void CMipmaps::DeleteBackgroundLevels( int aBackground ) {
+    DeleteLevels( m_backgrounds, aBackground, false );
+  }
+
+  int CMipmaps::GetLevel( const ChainMap& aChains, int aId, int aLevel ) {
+    if ( aLevel == 0 )
+      return aId;
+
+    ChainMap::const_iterator it = aChains.find( aId );
+
+    if ( it == aChains.end() || aLevel < 0 || aLevel > (int) it->second.levels.size() )
+      return -1;
+
+    return it->second.levels[aLevel - 1];
+  }
+
+  int CMipmaps::GetLevelCount( const ChainMap& aChains, int aId ) {
+    ChainMap::const_iterator it = aChains.find( aId );
+    return ( it != aChains.end() ? (int) it->second.levels.size() : 0 );
+  }
+
+  int CMipmaps::SelectLevel( int aLevelCount, double aXScale, double aYScale ) {
+    double scale = std::max( fabs( aXScale ), fabs( aYScale ) );
+
+    if ( aLevelCount <= 0 || scale >= 1.0 )
+      return 0;
+
+    if ( scale <= 0.0 )
+      return aLevelCount;
+
+    return std::min( (int) floor( log( 1.0 / scale ) / log( 2.0 ) ), aLevelCount );
+  }
+
+  int CMipmaps::FindDrawLevel( const ChainMap& aChains, int aId, double& aXScale, double& aYScale ) {
+    ChainMap::const_iterator it = aChains.find( aId );
+
+    if ( it == aChains.end() )
+      return aId;
+
+    const CHAIN& chain = it->second;
+    int level = SelectLevel( (int) chain.levels.size(), aXScale, aYScale );
+
+    if ( !level )
+      return aId;
+
+    // Levels are smaller by the rounded sizes, not exactly by powers of two
+    aXScale *= (double) chain.width / std::max( chain.width >> level, 1 );
+    aYScale *= (double) chain.height / std::max( chain.height >> level, 1 );
+
+    return chain.levels[level - 1];
+  }
+
+  void CMipmaps::DrawSprite( int aSprite, int aSubimage, double aX, double aY, double aXScale,
+                             double aYScale, double aRotation, int aColor, double aAlpha ) {
+    int sprite = FindDrawLevel( m_sprites, aSprite, aXScale, aYScale );
+    draw_sprite_ext( sprite, aSubimage, aX, aY, aXScale, aYScale, aRotation, aColor, aAlpha );
+  }
+
+  void CMipmaps::DrawBackground( int aBackground, double aX, double aY, double aXScale,
+                                 double aYScale, double aRotation, int aColor, double aAlpha ) {
+    int background = FindDrawLevel( m_backgrounds, aBackground, aXScale, aYScale );
+    draw_background_ext( background, aX, aY, aXScale, aYScale, aRotation, aColor, aAlpha );
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    CMipmaps::ResampleFilter FilterArg( const GMVALUE& aValue ) {
+      return ( (int) aValue.real == CMipmaps::RF_LANCZOS ? CMipmaps::RF_LANCZOS : CMipmaps::RF_BOX );
+    }
+
+    void MipmapSprite( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( (double) CMipmaps::CreateSpriteLevels( (int) aArgs[0].real, FilterArg( aArgs[1] ),
+                                                             (int) aArgs[2].real ) );
+      } catch ( const EGMAPIException& ) {
+        aResult->Set( -1.0 );
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MipmapSprite )
+
+    void MipmapBackground( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( (double) CMipmaps::CreateBackgroundLevels( (int) aArgs[0].real, FilterArg( aArgs[1] ),
+                                                                 (int) aArgs[2].real ) );
+      } catch ( const EGMAPIException& ) {
+        aResult->Set( -1.0 );
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MipmapBackground )
+
+    void MipmapSpriteGet( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CMipmaps::GetSpriteLevel( (int) aArgs[0].real, (int) aArgs[1].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MipmapSpriteGet )
+
+    void MipmapBackgroundGet( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CMipmaps::GetBackgroundLevel( (int) aArgs[0].real, (int) aArgs[1].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MipmapBackgroundGet )
+
+    void MipmapSpriteDelete( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      CMipmaps::DeleteSpriteLevels( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MipmapSpriteDelete )
+
+    void MipmapBackgroundDelete( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                 int aArgCount, PGMVALUE aResult ) {
+      CMipmaps::DeleteBackgroundLevels( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MipmapBackgroundDelete )
+
+    void DrawSpriteMipmap( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      CMipmaps::DrawSprite( (int) aArgs[0].real, (int) aArgs[1].real, aArgs[2].real, aArgs[3].real,
+                            aArgs[4].real, aArgs[5].real, aArgs[6].real, (int) aArgs[7].real, aArgs[8].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DrawSpriteMipmap )
+
+    void DrawBackgroundMipmap( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                               int aArgCount, PGMVALUE aResult ) {
+      CMipmaps::DrawBackground( (int) aArgs[0].real, aArgs[1].real, aArgs[2].real, aArgs[3].real,
+                                aArgs[4].real, aArgs[5].real, (int) aArgs[6].real, aArgs[7].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( DrawBackgroundMipmap )
+  }
+
+  void CMipmaps::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+
+    GMAPI_GMFUNCTION_REGISTER( "mipmap_sprite", 3, MipmapSprite );
+    GMAPI_GMFUNCTION_REGISTER( "mipmap_background", 3, MipmapBackground );
+    GMAPI_GMFUNCTION_REGISTER( "mipmap_sprite_get", 2, MipmapSpriteGet );
+    GMAPI_GMFUNCTION_REGISTER( "mipmap_background_get", 2, MipmapBackgroundGet );
+    GMAPI_GMFUNCTION_REGISTER( "mipmap_sprite_delete", 1, MipmapSpriteDelete );
+    GMAPI_GMFUNCTION_REGISTER( "mipmap_background_delete", 1, MipmapBackgroundDelete );
+    GMAPI_GMFUNCTION_REGISTER( "draw_sprite_mipmap", 9, DrawSpriteMipmap );
+    GMAPI_GMFUNCTION_REGISTER( "draw_background_mipmap", 8, DrawBackgroundMipmap );
+  }
+
+#endif
+
+}
@@ -0,0 +1,244 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiMipmaps.h                                                      */
+/*   - Downscaled levels of sprites and backgrounds                     */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include <map>
+#include <vector>
+
+namespace gm {
+
+  /// CMipmaps
+  ///   Downscales bitmaps in the format of ISpriteSubimage::GetBitmap and
+  ///   creates chains of half sized levels of sprites and backgrounds,
+  ///   which can be drawn instead of the original when it is scaled down.
+  ///
+  ///   Resampling is gamma-correct: pixels are converted from sRGB to
+  ///   linear light and premultiplied by alpha before filtering, so
+  ///   transparent pixels do not darken the edges. The box filter
+  ///   averages the covered area, the Lanczos filter uses three lobes
+  ///   and keeps more detail. Rows are filtered with SSE2 when the
+  ///   processor supports it and split between all processors; both
+  ///   code paths may differ by one in rounding.
+  ///
+  ///   Levels are created as new sprites and backgrounds through
+  ///   temporary PNG files. Level 0 is the resource itself; each next
+  ///   level has half the size of the previous one (rounded down, at
+  ///   least 1 pixel). Levels are not updated when the resource changes.
+  ///
+  class CMipmaps {
+    public:
+      /// Filters of Downscale
+      enum ResampleFilter { RF_BOX, RF_LANCZOS };
+
+      /// Level of BuildChain
+      struct LEVEL {
+        int width;
+        int height;
+        std::vector<unsigned char> bitmap;
+      };
+
+      /************************************************************************/
+      /* Resampling                                                           */
+      /************************************************************************/
+
+      /// Downscale( const unsigned char* aSource, int aWidth, int aHeight, unsigned char* aTarget,
+      ///            int aTargetWidth, int aTargetHeight, ResampleFilter aFilter )
+      ///   Resamples the bitmap to aTarget, which must have room for
+      ///   aTargetWidth * aTargetHeight pixels. The target should not be
+      ///   larger than the source.
+      ///
+      static void Downscale( const unsigned char* aSource, int aWidth, int aHeight, unsigned char* aTarget,
+                             int aTargetWidth, int aTargetHeight, ResampleFilter aFilter );
+
+      /// BuildChain( const unsigned char* aBitmap, int aWidth, int aHeight, ResampleFilter aFilter,
+      ///             int aLevels, std::vector<LEVEL>& aChain )
+      ///   Stores levels 1 and above of the bitmap to aChain, each one
+      ///   downscaled from the previous level. The chain ends with 1x1
+      ///   level or after aLevels levels, if aLevels is positive.
+      ///
+      /// Returns:
+      ///   Number of levels in aChain.
+      ///
+      static int BuildChain( const unsigned char* aBitmap, int aWidth, int aHeight, ResampleFilter aFilter,
+                             int aLevels, std::vector<LEVEL>& aChain );
+
+      /************************************************************************/
+      /* Levels of resources                                                  */
+      /************************************************************************/
+
+      /// CreateSpriteLevels( int aSprite, ResampleFilter aFilter, int aLevels )
+      ///   Creates sprites of the levels of all subimages, replacing the
+      ///   ones created before. Origins are scaled with the levels.
+      ///
+      /// Returns:
+      ///   Number of created levels.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPISpriteNotExist if the sprite does not exist.
+      ///
+      static int CreateSpriteLevels( int aSprite, ResampleFilter aFilter, int aLevels );
+
+      /// CreateBackgroundLevels( int aBackground, ResampleFilter aFilter, int aLevels )
+      ///   Creates backgrounds of the levels, replacing the ones created
+      ///   before.
+      ///
+      /// Returns:
+      ///   Number of created levels.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIBackgroundNotExist if the background does not
+      ///   exist.
+      ///
+      static int CreateBackgroundLevels( int aBackground, ResampleFilter aFilter, int aLevels );
+
+      /// DeleteSpriteLevels( int aSprite )
+      ///   Deletes sprites of the levels of the sprite, or of all sprites
+      ///   if aSprite is -1.
+      ///
+      static void DeleteSpriteLevels( int aSprite );
+
+      /// DeleteBackgroundLevels( int aBackground )
+      ///   Deletes backgrounds of the levels of the background, or of all
+      ///   backgrounds if aBackground is -1.
+      ///
+      static void DeleteBackgroundLevels( int aBackground );
+
+      /// GetSpriteLevel( int aSprite, int aLevel )
+      ///   Returns sprite of the level (aSprite for level 0) or -1 if the
+      ///   level has not been created.
+      ///
+      static int GetSpriteLevel( int aSprite, int aLevel ) {
+        return GetLevel( m_sprites, aSprite, aLevel );
+      }
+
+      /// GetSpriteLevelCount( int aSprite )
+      ///   Returns number of created levels of the sprite.
+      ///
+      static int GetSpriteLevelCount( int aSprite ) {
+        return GetLevelCount( m_sprites, aSprite );
+      }
+
+      /// GetBackgroundLevel( int aBackground, int aLevel )
+      ///   Returns background of the level (aBackground for level 0) or -1
+      ///   if the level has not been created.
+      ///
+      static int GetBackgroundLevel( int aBackground, int aLevel ) {
+        return GetLevel( m_backgrounds, aBackground, aLevel );
+      }
+
+      /// GetBackgroundLevelCount( int aBackground )
+      ///   Returns number of created levels of the background.
+      ///
+      static int GetBackgroundLevelCount( int aBackground ) {
+        return GetLevelCount( m_backgrounds, aBackground );
+      }
+
+      /// SelectLevel( int aLevelCount, double aXScale, double aYScale )
+      ///   Returns the smallest level, which is not scaled up when drawn
+      ///   with the scales; aLevelCount is the number of created levels.
+      ///
+      static int SelectLevel( int aLevelCount, double aXScale, double aYScale );
+
+      /// DrawSprite( int aSprite, int aSubimage, double aX, double aY, double aXScale,
+      ///             double aYScale, double aRotation, int aColor, double aAlpha )
+      ///   Draws the sprite like draw_sprite_ext, using the level chosen by
+      ///   SelectLevel.
+      ///
+      static void DrawSprite( int aSprite, int aSubimage, double aX, double aY, double aXScale,
+                              double aYScale, double aRotation, int aColor, double aAlpha );
+
+      /// DrawBackground( int aBackground, double aX, double aY, double aXScale,
+      ///                 double aYScale, double aRotation, int aColor, double aAlpha )
+      ///   Draws the background like draw_background_ext, using the level
+      ///   chosen by SelectLevel.
+      ///
+      static void DrawBackground( int aBackground, double aX, double aY, double aXScale,
+                                  double aYScale, double aRotation, int aColor, double aAlpha );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers the following GML functions:
+      ///     mipmap_sprite( spr, filter, levels ) - creates levels of the
+      ///       sprite (filter is RF_* value, levels 0 for the full chain);
+      ///       returns number of levels or -1
+      ///     mipmap_background( back, filter, levels ) - the same for
+      ///       backgrounds
+      ///     mipmap_sprite_get( spr, level ) - returns GetSpriteLevel
+      ///     mipmap_background_get( back, level ) - returns
+      ///       GetBackgroundLevel
+      ///     mipmap_sprite_delete( spr ) - deletes levels of the sprite
+      ///     mipmap_background_delete( back ) - deletes levels of the
+      ///       background
+      ///     draw_sprite_mipmap( spr, subimg, x, y, xscale, yscale, rot,
+      ///       color, alpha ) - calls DrawSprite
+      ///     draw_background_mipmap( back, x, y, xscale, yscale, rot,
+      ///       color, alpha ) - calls DrawBackground
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      /// Filter taps of the target pixels along one axis
+      struct WEIGHTS {
+        int taps;                     // Taps of every pixel
+        std::vector<int> start;       // First source pixel
+        std::vector<float> weights;   // taps weights per pixel
+      };
+
+      struct RESAMPLEJOB {
+        const unsigned char* source;
+        int width;
+        int height;
+        unsigned char* target;
+        int targetWidth;
+        int targetHeight;
+        const WEIGHTS* horizontal;
+        const WEIGHTS* vertical;
+      };
+
+      /// Created levels of a resource
+      struct CHAIN {
+        int width;                    // Size of level 0
+        int height;
+        std::vector<int> levels;      // Resources of levels 1 and above
+      };
+
+      typedef std::map<int, CHAIN> ChainMap;
+
+      static void ComputeWeights( int aSize, int aTargetSize, ResampleFilter aFilter, WEIGHTS& aWeights );
+      static void ResampleProc( void* aContext, int aBegin, int aEnd );
+      static int GetLevel( const ChainMap& aChains, int aId, int aLevel );
+      static int GetLevelCount( const ChainMap& aChains, int aId );
+      static int FindDrawLevel( const ChainMap& aChains, int aId, double& aXScale, double& aYScale );
+      static void DeleteLevels( ChainMap& aChains, int aId, bool aSprites );
+      static int AddResource( bool aSprite, const unsigned char* aBitmap, int aWidth, int aHeight,
+                              int aSubimages, int aOriginX, int aOriginY );
+
+      static ChainMap m_sprites;
+      static ChainMap m_backgrounds;
+  };
+
+}
@@ -0,0 +1,568 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiMotionGrid.cpp                                                 */
+/*   - Native mirror of the runner's mp_grid data structures            */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiMotionGrid.h"
+#include "GmapiUtilities.h"
+#include "GmapiGameplay.h"
+#include "GmapiMacros.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace gm {
+
+  CMotionGrid::GridMap CMotionGrid::m_grids;
+  int CMotionGrid::m_changes = 0;
+  std::vector<CMotionGridListener*> CMotionGrid::m_listeners;
+
+  namespace {
+    // Cell marked by the mp_grid_add_* functions
+    static const unsigned char CELL_ADDED = 1;
+    // Cell covered by instances tracked by UpdateInstances
+    static const unsigned char CELL_TRACKED = 2;
+  }
+
+  /************************************************************************/
+  /* CMotionGrid class implementation                                     */
+  /************************************************************************/
+
+  CMotionGrid::CMotionGrid( int aGridId, double aLeft, double aTop, int aHorizontalCells,
+                            int aVerticalCells, double aCellWidth, double aCellHeight ):
+    m_id( aGridId ), m_left( aLeft ), m_top( aTop ),
+    m_horizontalCells( aHorizontalCells > 0 ? aHorizontalCells : 1 ),
+    m_verticalCells( aVerticalCells > 0 ? aVerticalCells : 1 ),
+    m_cellWidth( aCellWidth > 0 ? aCellWidth : 1 ),
+    m_cellHeight( aCellHeight > 0 ? aCellHeight : 1 ),
+    m_cells( m_horizontalCells * m_verticalCells, 0 ), m_version( ++m_changes ) {}
+
+  CMotionGrid* CMotionGrid::Find( int aGridId ) {
+    GridMap::iterator it = m_grids.find( aGridId );
+
+    return ( it != m_grids.end() ? it->second : NULL );
+  }
+
+  CMotionGrid& CMotionGrid::Get( int aGridId ) {
+    CMotionGrid* grid = Find( aGridId );
+
+    if ( !grid )
+      throw EGMAPIMotionGridNotExist( aGridId );
+
+    return *grid;
+  }
+
+  CMotionGrid& CMotionGrid::Create( int aGridId, double aLeft, double aTop, int aHorizontalCells,
+                                    int aVerticalCells, double aCellWidth, double aCellHeight ) {
+    Destroy( aGridId );
+
+    CMotionGrid* grid = new CMotionGrid( aGridId, aLeft, aTop, aHorizontalCells,
+                                         aVerticalCells, aCellWidth, aCellHeight );
+    m_grids[aGridId] = grid;
+
+    return *grid;
+  }
+
+  void CMotionGrid::Destroy( int aGridId ) {
+    GridMap::iterator it = m_grids.find( aGridId );
+
+    if ( it != m_grids.end() ) {
+      for ( size_t i = 0; i < m_listeners.size(); i++ )
+        m_listeners[i]->OnGridDestroyed( *it->second );
+
+      delete it->second;
+      m_grids.erase( it );
+    }
+  }
+
+  void CMotionGrid::AddListener( CMotionGridListener* aListener ) {
+    if ( std::find( m_listeners.begin(), m_listeners.end(), aListener ) == m_listeners.end() )
+      m_listeners.push_back( aListener );
+  }
+
+  void CMotionGrid::RemoveListener( CMotionGridListener* aListener ) {
+    m_listeners.erase( std::remove( m_listeners.begin(), m_listeners.end(), aListener ), m_listeners.end() );
+  }
+
+  void CMotionGrid::Changed( int aLeft, int aTop, int aRight, int aBottom ) {
+    m_version = ++m_changes;
+
+    for ( size_t i = 0; i < m_listeners.size(); i++ )
+      m_listeners[i]->OnCellsChanged( *this, aLeft, aTop, aRight, aBottom );
+  }
+
+  void CMotionGrid::CellFromPoint( double aX, double aY, int& aH, int& aV ) const {
+    aH = (int) floor( ( aX - m_left ) / m_cellWidth );
+    aV = (int) floor( ( aY - m_top ) / m_cellHeight );
+  }
+
+  bool CMotionGrid::IsPointForbidden( double aX, double aY ) const {
+    int h, v;
+    CellFromPoint( aX, aY, h, v );
+
+    if ( h < 0 || v < 0 || h >= m_horizontalCells || v >= m_verticalCells )
+      return false;
+
+    return ( m_cells[v * m_horizontalCells + h] != 0 );
+  }
+
+  void CMotionGrid::SetCell( int aH, int aV, bool aForbidden ) {
+    if ( aH < 0 || aV < 0 || aH >= m_horizontalCells || aV >= m_verticalCells )
+      return;
+
+    m_cells[aV * m_horizontalCells + aH] = ( aForbidden ? CELL_ADDED : 0 );
+    Changed( aH, aV, aH, aV );
+  }
+
+  void CMotionGrid::SetRectangle( double aLeft, double aTop, double aRight, double aBottom, bool aForbidden ) {
+    int h1, v1, h2, v2;
+
+    CellFromPoint( ( aLeft < aRight ? aLeft : aRight ), ( aTop < aBottom ? aTop : aBottom ), h1, v1 );
+    CellFromPoint( ( aLeft < aRight ? aRight : aLeft ), ( aTop < aBottom ? aBottom : aTop ), h2, v2 );
+
+    if ( h1 < 0 ) h1 = 0;
+    if ( v1 < 0 ) v1 = 0;
+    if ( h2 >= m_horizontalCells ) h2 = m_horizontalCells - 1;
+    if ( v2 >= m_verticalCells ) v2 = m_verticalCells - 1;
+
+    if ( h1 > h2 || v1 > v2 )
+      return;
+
+    for ( int v = v1; v <= v2; v++ )
+      memset( &m_cells[v * m_horizontalCells + h1], ( aForbidden ? CELL_ADDED : 0 ), h2 - h1 + 1 );
+
+    Changed( h1, v1, h2, v2 );
+  }
+
+  void CMotionGrid::SetAll( bool aForbidden ) {
+    memset( &m_cells[0], ( aForbidden ? CELL_ADDED : 0 ), m_cells.size() );
+    Changed( 0, 0, m_horizontalCells - 1, m_verticalCells - 1 );
+  }
+
+  void CMotionGrid::AddInstances( int aObject, bool aPrecise ) {
+    CInstanceFilter filter( aObject );
+    int count = 0;
+    PGMINSTANCE* instances = CRoomInstances::GetArray( count );
+    std::vector<int> cells;
+
+    if ( !instances )
+      return;
+
+    for ( int i = 0; i < count; i++ ) {
+      if ( !filter.Matches( instances[i] ) )
+        continue;
+
+      if ( !aPrecise ) {
+        int left, top, right, bottom;
+        CRoomInstances::GetBoundingBox( instances[i], left, top, right, bottom );
+
+        if ( left <= right && top <= bottom )
+          SetRectangle( left, top, right, bottom, true );
+
+        continue;
+      }
+
+      GetInstanceCells( instances[i], true, cells );
+
+      if ( cells.empty() )
+        continue;
+
+      int left = m_horizontalCells, top = m_verticalCells, right = -1, bottom = -1;
+
+      for ( size_t j = 0; j < cells.size(); j++ ) {
+        int h = cells[j] % m_horizontalCells, v = cells[j] / m_horizontalCells;
+
+        m_cells[cells[j]] = CELL_ADDED;
+        left = std::min( left, h );
+        top = std::min( top, v );
+        right = std::max( right, h );
+        bottom = std::max( bottom, v );
+      }
+
+      Changed( left, top, right, bottom );
+    }
+  }
+
+  int CMotionGrid::UpdateInstances( int aObject, bool aPrecise ) {
+    CInstanceFilter filter( aObject );
+    TrackedInstanceMap& tracked = m_tracked[aObject];
+    int count = 0, updated = 0;
+    PGMINSTANCE* instances = CRoomInstances::GetArray( count );
+
+    if ( m_coverage.empty() )
+      m_coverage.resize( m_cells.size(), 0 );
+
+    for ( TrackedInstanceMap::iterator it = tracked.begin(); it != tracked.end(); ++it )
+      it->second.seen = false;
+
+    for ( int i = 0; i < count; i++ ) {
+      if ( !filter.Matches( instances[i] ) )
+        continue;
+
+      int id = CRoomInstances::GetID( instances[i] );
+      int left, top, right, bottom;
+      double x, y;
+
+      CRoomInstances::GetBoundingBox( instances[i], left, top, right, bottom );
+      CRoomInstances::GetPosition( instances[i], x, y );
+
+      int changedLeft = m_horizontalCells, changedTop = m_verticalCells, changedRight = -1, changedBottom = -1;
+      TrackedInstanceMap::iterator it = tracked.find( id );
+
+      if ( it != tracked.end() ) {
+        TRACKEDINSTANCE& instance = it->second;
+        instance.seen = true;
+
+        if ( instance.left == left && instance.top == top && instance.right == right &&
+             instance.bottom == bottom && instance.x == x && instance.y == y )
+          continue;
+
+        TrackCells( instance.cells, false, changedLeft, changedTop, changedRight, changedBottom );
+      } else
+        it = tracked.insert( std::make_pair( id, TRACKEDINSTANCE() ) ).first;
+
+      TRACKEDINSTANCE& instance = it->second;
+      instance.left = left;
+      instance.top = top;
+      instance.right = right;
+      instance.bottom = bottom;
+      instance.x = x;
+      instance.y = y;
+      instance.seen = true;
+
+      GetInstanceCells( instances[i], aPrecise, instance.cells );
+      TrackCells( instance.cells, true, changedLeft, changedTop, changedRight, changedBottom );
+      updated++;
+
+      if ( changedLeft <= changedRight )
+        Changed( changedLeft, changedTop, changedRight, changedBottom );
+    }
+
+    // Release the instances that no longer exist or match
+    for ( TrackedInstanceMap::iterator it = tracked.begin(); it != tracked.end(); ) {
+      if ( it->second.seen ) {
+        ++it;
+        continue;
+      }
+
+      int changedLeft = m_horizontalCells, changedTop = m_verticalCells, changedRight = -1, changedBottom = -1;
+      TrackCells( it->second.cells, false, changedLeft, changedTop, changedRight, changedBottom );
+
+      if ( changedLeft <= changedRight )
+        Changed( changedLeft, changedTop, changedRight, changedBottom );
+
+      tracked.erase( it++ );
+      updated++;
+    }
+
+    return updated;
+  }
+
+  void CMotionGrid::ReleaseInstances( int aObject ) {
+    TrackedObjectMap::iterator tracked = m_tracked.find( aObject );
+
+    if ( tracked == m_tracked.end() )
+      return;
+
+    for ( TrackedInstanceMap::iterator it = tracked->second.begin(); it != tracked->second.end(); ++it ) {
+      int changedLeft = m_horizontalCells, changedTop = m_verticalCells, changedRight = -1, changedBottom = -1;
+      TrackCells( it->second.cells, false, changedLeft, changedTop, changedRight, changedBottom );
+
+      if ( changedLeft <= changedRight )
+        Changed( changedLeft, changedTop, changedRight, changedBottom );
+    }
+
+    m_tracked.erase( tracked );
+  }
+
+  void CMotionGrid::GetInstanceCells( PGMINSTANCE aInstance, bool aPrecise, std::vector<int>& aCells ) const {
+    int left, top, right, bottom;
+    int h1, v1, h2, v2;
+
+    aCells.clear();
+    CRoomInstances::GetBoundingBox( aInstance, left, top, right, bottom );
+
+    if ( left > right || top > bottom )
+      return;
+
+    CellFromPoint( left, top, h1, v1 );
+    CellFromPoint( right, bottom, h2, v2 );
+
+    h1 = std::max( h1, 0 );
+    v1 = std::max( v1, 0 );
+    h2 = std::min( h2, m_horizontalCells - 1 );
+    v2 = std::min( v2, m_verticalCells - 1 );
+
+    int id = CRoomInstances::GetID( aInstance );
+
+    for ( int v = v1; v <= v2; v++ ) {
+      for ( int h = h1; h <= h2; h++ ) {
+        if ( aPrecise ) {
+          double x = m_left + h * m_cellWidth, y = m_top + v * m_cellHeight;
+
+          if ( !collision_rectangle( x, y, x + m_cellWidth - 1, y + m_cellHeight - 1, id, true, false ) )
+            continue;
+        }
+
+        aCells.push_back( v * m_horizontalCells + h );
+      }
+    }
+  }
+
+  void CMotionGrid::TrackCells( const std::vector<int>& aCells, bool aMark, int& aLeft, int& aTop,
+                                int& aRight, int& aBottom ) {
+    for ( size_t i = 0; i < aCells.size(); i++ ) {
+      int cell = aCells[i];
+      bool changed = false;
+
+      if ( aMark ) {
+        if ( m_coverage[cell] < 0xFFFF )
+          m_coverage[cell]++;
+
+        changed = ( m_cells[cell] == 0 );
+        m_cells[cell] |= CELL_TRACKED;
+      } else {
+        // Cells cleared by the other functions meanwhile stay free
+        if ( m_coverage[cell] > 0 && --m_coverage[cell] == 0 && ( m_cells[cell] & CELL_TRACKED ) ) {
+          m_cells[cell] &= ~CELL_TRACKED;
+          changed = ( m_cells[cell] == 0 );
+        }
+      }
+
+      if ( changed ) {
+        int h = cell % m_horizontalCells, v = cell / m_horizontalCells;
+
+        aLeft = std::min( aLeft, h );
+        aTop = std::min( aTop, v );
+        aRight = std::max( aRight, h );
+        aBottom = std::max( aBottom, v );
+      }
+    }
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    GMFUCTION runnerMpGridCreate = NULL;
+    GMFUCTION runnerMpGridDestroy = NULL;
+    GMFUCTION runnerMpGridClearAll = NULL;
+    GMFUCTION runnerMpGridClearCell = NULL;
+    GMFUCTION runnerMpGridClearRectangle = NULL;
+    GMFUCTION runnerMpGridAddCell = NULL;
+    GMFUCTION runnerMpGridAddRectangle = NULL;
+    GMFUCTION runnerMpGridAddInstances = NULL;
+
+    // Copies the changes of a mirrored grid made natively to the runner's
+    // grid, while the grid is set
+    class CRunnerGridSync: public CMotionGridListener {
+      public:
+        CRunnerGridSync(): m_grid( NULL ) {}
+
+        void SetGrid( const CMotionGrid* aGrid ) {
+          m_grid = aGrid;
+        }
+
+        virtual void OnCellsChanged( const CMotionGrid& aGrid, int aLeft, int aTop, int aRight, int aBottom ) {
+          if ( &aGrid != m_grid )
+            return;
+
+          bool forbidden = aGrid.IsCellForbidden( aLeft, aTop );
+          bool uniform = true;
+          GMVALUE result;
+
+          for ( int v = aTop; v <= aBottom && uniform; v++ ) {
+            for ( int h = aLeft; h <= aRight && uniform; h++ )
+              uniform = ( aGrid.IsCellForbidden( h, v ) == forbidden );
+          }
+
+          if ( uniform ) {
+            // Rectangle between the centers of the corner cells covers
+            // exactly the range
+            GMVALUE args[5] = { (double) aGrid.GetID(),
+                                aGrid.GetLeft() + ( aLeft + 0.5 ) * aGrid.GetCellWidth(),
+                                aGrid.GetTop() + ( aTop + 0.5 ) * aGrid.GetCellHeight(),
+                                aGrid.GetLeft() + ( aRight + 0.5 ) * aGrid.GetCellWidth(),
+                                aGrid.GetTop() + ( aBottom + 0.5 ) * aGrid.GetCellHeight() };
+
+            core::RunnerCallFunction( forbidden ? runnerMpGridAddRectangle : runnerMpGridClearRectangle,
+                                      args, 5, &result );
+            return;
+          }
+
+          for ( int v = aTop; v <= aBottom; v++ ) {
+            for ( int h = aLeft; h <= aRight; h++ ) {
+              GMVALUE args[3] = { (double) aGrid.GetID(), (double) h, (double) v };
+
+              core::RunnerCallFunction( aGrid.IsCellForbidden( h, v ) ? runnerMpGridAddCell : runnerMpGridClearCell,
+                                        args, 3, &result );
+            }
+          }
+        }
+
+        virtual void OnGridDestroyed( const CMotionGrid& aGrid ) {}
+
+      private:
+        const CMotionGrid* m_grid;
+    };
+
+    CRunnerGridSync runnerGridSync;
+
+    void MpGridCreate( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      core::RunnerCallFunction( runnerMpGridCreate, aArgs, aArgCount, aResult );
+
+      CMotionGrid::Create( (int) aResult->real, aArgs[0].real, aArgs[1].real, (int) aArgs[2].real,
+                           (int) aArgs[3].real, aArgs[4].real, aArgs[5].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridCreate )
+
+    void MpGridDestroy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      core::RunnerCallFunction( runnerMpGridDestroy, aArgs, aArgCount, aResult );
+      CMotionGrid::Destroy( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridDestroy )
+
+    void MpGridClearAll( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      core::RunnerCallFunction( runnerMpGridClearAll, aArgs, aArgCount, aResult );
+
+      if ( CMotionGrid* grid = CMotionGrid::Find( (int) aArgs[0].real ) )
+        grid->SetAll( false );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridClearAll )
+
+    void MpGridClearCell( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      core::RunnerCallFunction( runnerMpGridClearCell, aArgs, aArgCount, aResult );
+
+      if ( CMotionGrid* grid = CMotionGrid::Find( (int) aArgs[0].real ) )
+        grid->SetCell( (int) aArgs[1].real, (int) aArgs[2].real, false );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridClearCell )
+
+    void MpGridClearRectangle( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                               int aArgCount, PGMVALUE aResult ) {
+      core::RunnerCallFunction( runnerMpGridClearRectangle, aArgs, aArgCount, aResult );
+
+      if ( CMotionGrid* grid = CMotionGrid::Find( (int) aArgs[0].real ) )
+        grid->SetRectangle( aArgs[1].real, aArgs[2].real, aArgs[3].real, aArgs[4].real, false );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridClearRectangle )
+
+    void MpGridAddCell( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      core::RunnerCallFunction( runnerMpGridAddCell, aArgs, aArgCount, aResult );
+
+      if ( CMotionGrid* grid = CMotionGrid::Find( (int) aArgs[0].real ) )
+        grid->SetCell( (int) aArgs[1].real, (int) aArgs[2].real, true );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridAddCell )
+
+    void MpGridAddRectangle( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      core::RunnerCallFunction( runnerMpGridAddRectangle, aArgs, aArgCount, aResult );
+
+      if ( CMotionGrid* grid = CMotionGrid::Find( (int) aArgs[0].real ) )
+        grid->SetRectangle( aArgs[1].real, aArgs[2].real, aArgs[3].real, aArgs[4].real, true );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridAddRectangle )
+
+    void MpGridAddInstances( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      CMotionGrid* grid = CMotionGrid::Find( (int) aArgs[0].real );
+
+      // Mirrored grids are rasterized natively; only the changed cells
+      // are passed to the runner
+      if ( !grid ) {
+        core::RunnerCallFunction( runnerMpGridAddInstances, aArgs, aArgCount, aResult );
+        return;
+      }
+
+      runnerGridSync.SetGrid( grid );
+      grid->AddInstances( (int) aArgs[1].real, aArgs[2].real >= 0.5 );
+      runnerGridSync.SetGrid( NULL );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridAddInstances )
+
+    void MpGridUpdateInstances( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( -1.0 );
+
+      if ( CMotionGrid* grid = CMotionGrid::Find( (int) aArgs[0].real ) ) {
+        runnerGridSync.SetGrid( grid );
+        aResult->Set( (double) grid->UpdateInstances( (int) aArgs[1].real, aArgs[2].real >= 0.5 ) );
+        runnerGridSync.SetGrid( NULL );
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridUpdateInstances )
+
+    void MpGridReleaseInstances( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                 int aArgCount, PGMVALUE aResult ) {
+      if ( CMotionGrid* grid = CMotionGrid::Find( (int) aArgs[0].real ) ) {
+        runnerGridSync.SetGrid( grid );
+        grid->ReleaseInstances( (int) aArgs[1].real );
+        runnerGridSync.SetGrid( NULL );
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridReleaseInstances )
+  }
+
+  void CMotionGrid::RegisterGMFunctions() {
+    if ( runnerMpGridCreate )
+      return;
+
+    runnerMpGridCreate = GMAPI_GMFUNCTION_OVERRIDE( id_mp_grid_create, MpGridCreate );
+    runnerMpGridDestroy = GMAPI_GMFUNCTION_OVERRIDE( id_mp_grid_destroy, MpGridDestroy );
+    runnerMpGridClearAll = GMAPI_GMFUNCTION_OVERRIDE( id_mp_grid_clear_all, MpGridClearAll );
+    runnerMpGridClearCell = GMAPI_GMFUNCTION_OVERRIDE( id_mp_grid_clear_cell, MpGridClearCell );
+    runnerMpGridClearRectangle = GMAPI_GMFUNCTION_OVERRIDE( id_mp_grid_clear_rectangle, MpGridClearRectangle );
+    runnerMpGridAddCell = GMAPI_GMFUNCTION_OVERRIDE( id_mp_grid_add_cell, MpGridAddCell );
+    runnerMpGridAddRectangle = GMAPI_GMFUNCTION_OVERRIDE( id_mp_grid_add_rectangle, MpGridAddRectangle );
+    runnerMpGridAddInstances = GMAPI_GMFUNCTION_OVERRIDE( id_mp_grid_add_instances, MpGridAddInstances );
+
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_update_instances", 3, MpGridUpdateInstances );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_release_instances", 2, MpGridReleaseInstances );
+
+    CMotionGrid::AddListener( &runnerGridSync );
+  }
+
+#endif
+
+}
@@ -0,0 +1,260 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiMotionGrid.h                                                   */
+/*   - Native mirror of the runner's mp_grid data structures            */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiInternal.h"
+
+#include <map>
+#include <vector>
+
+namespace gm {
+
+  class CMotionGrid;
+
+  /// CMotionGridListener
+  ///   Base of the classes that keep data derived from the mirrored grids
+  ///   and need to update it when the grids change. See
+  ///   CMotionGrid::AddListener.
+  ///
+  class CMotionGridListener {
+    public:
+      virtual ~CMotionGridListener() {}
+
+      /// OnCellsChanged( const CMotionGrid& aGrid, int aLeft, int aTop, int aRight, int aBottom )
+      ///   Called after the cells in the range (inclusive, lying inside the
+      ///   grid) have been set. Cells in the range may keep their state.
+      ///
+      virtual void OnCellsChanged( const CMotionGrid& aGrid, int aLeft, int aTop, int aRight, int aBottom ) = 0;
+
+      /// OnGridDestroyed( const CMotionGrid& aGrid )
+      ///   Called before the grid is destroyed or replaced by a new grid
+      ///   with the same ID.
+      ///
+      virtual void OnGridDestroyed( const CMotionGrid& aGrid ) = 0;
+  };
+
+  /// CMotionGrid
+  ///   Native copy of a single mp_grid. The runner does not expose its grids,
+  ///   so after RegisterGMFunctions has been called, the mp_grid_* functions
+  ///   are intercepted: the runner's version is called first and the same
+  ///   change is then applied to the native copy. Grids created before the
+  ///   registration are not mirrored.
+  ///
+  ///   Cells are stored as one byte per cell (row by row), non-zero value
+  ///   means the cell is forbidden. Bit 0 is set by the mp_grid_add_*
+  ///   functions, bit 1 by the instances tracked by UpdateInstances.
+  ///
+  class CMotionGrid {
+    public:
+      /// Find( int aGridId )
+      ///   Returns the native copy of the specified grid.
+      ///
+      /// Returns:
+      ///   Pointer to the grid or NULL if the grid is not mirrored.
+      ///
+      static CMotionGrid* Find( int aGridId );
+
+      /// Get( int aGridId )
+      ///   Returns the native copy of the specified grid.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIMotionGridNotExist if the grid is not mirrored.
+      ///
+      static CMotionGrid& Get( int aGridId );
+
+      /// Create( int aGridId, double aLeft, double aTop, int aHorizontalCells,
+      ///         int aVerticalCells, double aCellWidth, double aCellHeight )
+      ///   Creates native copy of a grid, that has just been created by the
+      ///   runner. Existing copy with the same ID is replaced.
+      ///
+      static CMotionGrid& Create( int aGridId, double aLeft, double aTop, int aHorizontalCells,
+                                  int aVerticalCells, double aCellWidth, double aCellHeight );
+
+      /// Destroy( int aGridId )
+      ///   Destroys native copy of the grid.
+      ///
+      static void Destroy( int aGridId );
+
+      /// AddListener( CMotionGridListener* aListener )
+      ///   Registers object to be notified about changes of all grids.
+      ///
+      static void AddListener( CMotionGridListener* aListener );
+
+      /// RemoveListener( CMotionGridListener* aListener )
+      ///   Unregisters the object.
+      ///
+      static void RemoveListener( CMotionGridListener* aListener );
+
+      int GetID() const { return m_id; }
+      double GetLeft() const { return m_left; }
+      double GetTop() const { return m_top; }
+      int GetHorizontalCells() const { return m_horizontalCells; }
+      int GetVerticalCells() const { return m_verticalCells; }
+      double GetCellWidth() const { return m_cellWidth; }
+      double GetCellHeight() const { return m_cellHeight; }
+
+      /// GetCells()
+      ///   Returns pointer to the cell array (GetHorizontalCells() *
+      ///   GetVerticalCells() bytes, row by row).
+      ///
+      const unsigned char* GetCells() const {
+        return &m_cells[0];
+      }
+
+      /// GetVersion()
+      ///   Returns value that changes with every change of the grid and is
+      ///   never shared by two grids, even if one replaced the other. Can be
+      ///   used to detect that copies of the cells are out of date.
+      ///
+      int GetVersion() const {
+        return m_version;
+      }
+
+      /// IsCellForbidden( int aH, int aV )
+      ///   Checks whether the cell is forbidden. Cells outside the grid are
+      ///   treated as forbidden, like in mp_grid_path.
+      ///
+      bool IsCellForbidden( int aH, int aV ) const {
+        if ( aH < 0 || aV < 0 || aH >= m_horizontalCells || aV >= m_verticalCells )
+          return true;
+
+        return ( m_cells[aV * m_horizontalCells + aH] != 0 );
+      }
+
+      /// IsPointForbidden( double aX, double aY )
+      ///   Checks whether the point in the room lies in a forbidden cell.
+      ///   Points outside the grid are treated as free.
+      ///
+      bool IsPointForbidden( double aX, double aY ) const;
+
+      /// CellFromPoint( double aX, double aY, int& aH, int& aV )
+      ///   Computes the cell containing the point in the room. The result
+      ///   may lie outside the grid.
+      ///
+      void CellFromPoint( double aX, double aY, int& aH, int& aV ) const;
+
+      /// SetCell( int aH, int aV, bool aForbidden )
+      ///   Native counterpart of mp_grid_add_cell/mp_grid_clear_cell.
+      ///
+      void SetCell( int aH, int aV, bool aForbidden );
+
+      /// SetRectangle( double aLeft, double aTop, double aRight, double aBottom, bool aForbidden )
+      ///   Native counterpart of mp_grid_add_rectangle/mp_grid_clear_rectangle.
+      ///   Changes all cells intersecting the rectangle.
+      ///
+      void SetRectangle( double aLeft, double aTop, double aRight, double aBottom, bool aForbidden );
+
+      /// SetAll( bool aForbidden )
+      ///   Native counterpart of mp_grid_clear_all.
+      ///
+      void SetAll( bool aForbidden );
+
+      /// AddInstances( int aObject, bool aPrecise )
+      ///   Native counterpart of mp_grid_add_instances. Marks all cells
+      ///   intersecting the bounding boxes of matching instances. If
+      ///   aPrecise is true, only the cells colliding with the instance's
+      ///   mask are marked (one collision_rectangle test per cell of the
+      ///   bounding box).
+      ///
+      void AddInstances( int aObject, bool aPrecise = false );
+
+      /// UpdateInstances( int aObject, bool aPrecise )
+      ///   Incremental version of AddInstances. Instances matching aObject
+      ///   are tracked between the calls with the same aObject: only the
+      ///   instances whose position or bounding box has changed, new
+      ///   instances and instances that no longer exist are rasterized
+      ///   again. Cells released by the tracked instances become free,
+      ///   unless another tracked instance covers them or they have been
+      ///   marked by the other functions. Changes of the mask that do not
+      ///   change the bounding box are not detected.
+      ///
+      /// Returns:
+      ///   Number of instances whose cells have changed.
+      ///
+      int UpdateInstances( int aObject, bool aPrecise );
+
+      /// ReleaseInstances( int aObject )
+      ///   Releases the cells of all instances tracked by UpdateInstances
+      ///   with the same aObject and stops tracking them.
+      ///
+      void ReleaseInstances( int aObject );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Intercepts the mp_grid_* functions that create, destroy or modify
+      ///   grids, so that the native copies are kept in sync with the runner.
+      ///   mp_grid_add_instances rasterizes mirrored grids natively and
+      ///   passes only the changed cells to the runner. Registers the
+      ///   following GML functions:
+      ///     mp_grid_update_instances( id, obj, prec ) - see UpdateInstances;
+      ///       returns number of updated instances or -1 if the grid is not
+      ///       mirrored
+      ///     mp_grid_release_instances( id, obj )
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      struct TRACKEDINSTANCE {
+        int left, top, right, bottom;   // Bounding box in the room
+        double x, y;
+        bool seen;                      // Matched by the current update
+        std::vector<int> cells;
+      };
+
+      typedef std::map<int, CMotionGrid*> GridMap;
+      typedef std::map<int, TRACKEDINSTANCE> TrackedInstanceMap;   // Instance ID -> instance
+      typedef std::map<int, TrackedInstanceMap> TrackedObjectMap;  // aObject -> instances
+
+      CMotionGrid( int aGridId, double aLeft, double aTop, int aHorizontalCells,
+                   int aVerticalCells, double aCellWidth, double aCellHeight );
+
+      void Changed( int aLeft, int aTop, int aRight, int aBottom );
+      void GetInstanceCells( PGMINSTANCE aInstance, bool aPrecise, std::vector<int>& aCells ) const;
+      void TrackCells( const std::vector<int>& aCells, bool aMark, int& aLeft, int& aTop,
+                       int& aRight, int& aBottom );
+
+      int m_id;
+      double m_left;
+      double m_top;
+      int m_horizontalCells;
+      int m_verticalCells;
+      double m_cellWidth;
+      double m_cellHeight;
+      std::vector<unsigned char> m_cells;
+      int m_version;
+
+      // Tracked instances and number of tracked instances covering each
+      // cell (allocated by the first UpdateInstances)
+      TrackedObjectMap m_tracked;
+      std::vector<unsigned short> m_coverage;
+
+      static GridMap m_grids;
+      static int m_changes;
+      static std::vector<CMotionGridListener*> m_listeners;
+  };
+
+}
@@ -0,0 +1,736 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiParticleEngine.cpp                                             */
+/*   - Native particle emission that writes directly into the           */
+/*     runner's particle arrays                                         */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiParticleEngine.h"
+#include "GmapiParticles.h"
+#include "GmapiResources.h"
+#include "GmapiMotionGrid.h"
+#include "GmapiMacros.h"
+#include "GmapiConsts.h"
+
+#include <math.h>
+#include <string.h>
+#include <string>
+
+namespace gm {
+
+  CRandom                       CParticleEngine::m_random;
+  std::vector<double>           CParticleEngine::m_randomBuffer;
+  CParticleEngine::StreamMap    CParticleEngine::m_streams;
+
+  static const double PI = 3.14159265358979323846;
+
+  /************************************************************************/
+  /* Helper functions                                                     */
+  /************************************************************************/
+
+  static inline double RandomRange( double aMin, double aMax, double aRandom ) {
+    return aMin + ( aMax - aMin ) * aRandom;
+  }
+
+  static inline int MakeColor( int aRed, int aGreen, int aBlue ) {
+    return aRed | ( aGreen << 8 ) | ( aBlue << 16 );
+  }
+
+  // Shapes a uniform random value according to the emitter's distribution.
+  // Gaussian distribution is approximated with a mean of three uniform values,
+  // so the result never leaves the [0, 1) range (and the emitter's region).
+  static double Distribute( int aDistribution, const double* aRandom ) {
+    if ( aDistribution != ps_distr_gaussian && aDistribution != ps_distr_invgaussian )
+      return aRandom[0];
+
+    double value = ( aRandom[0] + aRandom[1] + aRandom[2] ) / 3.0;
+
+    if ( aDistribution == ps_distr_invgaussian )
+      value += ( value < 0.5 ? 0.5 : -0.5 );
+
+    return value;
+  }
+
+  static int HsvToColor( double aHue, double aSaturation, double aValue ) {
+    double sector = aHue * 6.0 / 256.0;
+    int index = (int) sector;
+    double fraction = sector - index;
+    double s = aSaturation / 255.0;
+
+    int v = (int) aValue;
+    int p = (int) ( aValue * ( 1.0 - s ) );
+    int q = (int) ( aValue * ( 1.0 - s * fraction ) );
+    int t = (int) ( aValue * ( 1.0 - s * ( 1.0 - fraction ) ) );
+
+    switch ( index ) {
+      case 0:  return MakeColor( v, t, p );
+      case 1:  return MakeColor( q, v, p );
+      case 2:  return MakeColor( p, v, t );
+      case 3:  return MakeColor( p, q, v );
+      case 4:  return MakeColor( t, p, v );
+      default: return MakeColor( v, p, q );
+    }
+  }
+
+  static int ParticleColor( const GMPARTICLETYPE& aType, const double* aRandom ) {
+    switch ( aType.colorType ) {
+      case PCT_MIX: {
+        int color1 = (int) aType.colorComponent1;
+        int color2 = (int) aType.colorComponent2;
+
+        return MakeColor( (int) RandomRange( color1 & 0xFF, color2 & 0xFF, aRandom[0] ),
+                          (int) RandomRange( ( color1 >> 8 ) & 0xFF, ( color2 >> 8 ) & 0xFF, aRandom[0] ),
+                          (int) RandomRange( ( color1 >> 16 ) & 0xFF, ( color2 >> 16 ) & 0xFF, aRandom[0] ) );
+      }
+
+      case PCT_RGB:
+        return MakeColor( (int) RandomRange( aType.colorComponent1, aType.colorComponent2, aRandom[0] ),
+                          (int) RandomRange( aType.colorComponent3, aType.colorComponent4, aRandom[1] ),
+                          (int) RandomRange( aType.colorComponent5, aType.colorComponent6, aRandom[2] ) );
+
+      case PCT_HSV:
+        return HsvToColor( RandomRange( aType.colorComponent1, aType.colorComponent2, aRandom[0] ),
+                           RandomRange( aType.colorComponent3, aType.colorComponent4, aRandom[1] ),
+                           RandomRange( aType.colorComponent5, aType.colorComponent6, aRandom[2] ) );
+
+      default:
+        return (int) aType.colorComponent1;
+    }
+  }
+
+  /************************************************************************/
+  /* Instance index used by the collision tests                           */
+  /************************************************************************/
+
+  namespace {
+    struct INSTANCEBOX {
+      double left, top, right, bottom; // Right and bottom edges are exclusive
+      int id;
+    };
+
+    // Uniform grid of instance bounding boxes. Boxes are stored in one array
+    // sorted by cells (cellStart[i] .. cellStart[i + 1] are boxes of cell i),
+    // the index is built in two linear passes.
+    class CInstanceIndex {
+      public:
+        void Build( int aObject );
+        const INSTANCEBOX* Find( double aX, double aY ) const;
+
+      private:
+        void CellRange( const INSTANCEBOX& aBox, int& aH1, int& aV1, int& aH2, int& aV2 ) const;
+
+        std::vector<INSTANCEBOX> m_boxes;
+        std::vector<int> m_cellStart;
+        std::vector<int> m_items;
+        double m_left, m_top, m_right, m_bottom;
+        double m_cellSize;
+        int m_columns, m_rows;
+    };
+
+    void CInstanceIndex::CellRange( const INSTANCEBOX& aBox, int& aH1, int& aV1, int& aH2, int& aV2 ) const {
+      aH1 = (int) ( ( aBox.left - m_left ) / m_cellSize );
+      aV1 = (int) ( ( aBox.top - m_top ) / m_cellSize );
+      aH2 = (int) ( ( aBox.right - m_left ) / m_cellSize );
+      aV2 = (int) ( ( aBox.bottom - m_top ) / m_cellSize );
+
+      if ( aH2 >= m_columns ) aH2 = m_columns - 1;
+      if ( aV2 >= m_rows ) aV2 = m_rows - 1;
+    }
+
+    void CInstanceIndex::Build( int aObject ) {
+      CInstanceFilter filter( aObject );
+      int count = 0;
+      PGMINSTANCE* instances = CRoomInstances::GetArray( count );
+      double sizeSum = 0;
+
+      m_boxes.clear();
+
+      for ( int i = 0; instances && i < count; i++ ) {
+        if ( !instances[i] || !CRoomInstances::IsSolid( instances[i] ) || !filter.Matches( instances[i] ) )
+          continue;
+
+        int left, top, right, bottom;
+        CRoomInstances::GetBoundingBox( instances[i], left, top, right, bottom );
+
+        if ( left > right || top > bottom )
+          continue;
+
+        INSTANCEBOX box;
+        box.left = left;
+        box.top = top;
+        box.right = right + 1.0;
+        box.bottom = bottom + 1.0;
+        box.id = CRoomInstances::GetID( instances[i] );
+
+        if ( m_boxes.empty() ) {
+          m_left = box.left; m_top = box.top;
+          m_right = box.right; m_bottom = box.bottom;
+        } else {
+          if ( box.left < m_left ) m_left = box.left;
+          if ( box.top < m_top ) m_top = box.top;
+          if ( box.right > m_right ) m_right = box.right;
+          if ( box.bottom > m_bottom ) m_bottom = box.bottom;
+        }
+
+        sizeSum += ( box.right - box.left ) + ( box.bottom - box.top );
+        m_boxes.push_back( box );
+      }
+
+      if ( m_boxes.empty() )
+        return;
+
+      // Cells of the average instance size, but no more than 4 cells per instance
+      int boxCount = (int) m_boxes.size();
+
+      m_cellSize = sizeSum / ( 2 * boxCount );
+      if ( m_cellSize < 8 )
+        m_cellSize = 8;
+
+      double maxCells = 4.0 * boxCount + 64;
+      double cells = ( ( m_right - m_left ) / m_cellSize + 1 ) * ( ( m_bottom - m_top ) / m_cellSize + 1 );
+
+      if ( cells > maxCells )
+        m_cellSize *= sqrt( cells / maxCells );
+
+      m_columns = (int) ( ( m_right - m_left ) / m_cellSize ) + 1;
+      m_rows = (int) ( ( m_bottom - m_top ) / m_cellSize ) + 1;
+
+      m_cellStart.assign( m_columns * m_rows + 1, 0 );
+
+      int h1, v1, h2, v2;
+
+      for ( int i = 0; i < boxCount; i++ ) {
+        CellRange( m_boxes[i], h1, v1, h2, v2 );
+
+        for ( int v = v1; v <= v2; v++ )
+          for ( int h = h1; h <= h2; h++ )
+            ++m_cellStart[v * m_columns + h + 1];
+      }
+
+      for ( int i = 1; i <= m_columns * m_rows; i++ )
+        m_cellStart[i] += m_cellStart[i - 1];
+
+      m_items.resize( m_cellStart[m_columns * m_rows] );
+      std::vector<int> fill( m_cellStart.begin(), m_cellStart.end() - 1 );
+
+      for ( int i = 0; i < boxCount; i++ ) {
+        CellRange( m_boxes[i], h1, v1, h2, v2 );
+
+        for ( int v = v1; v <= v2; v++ )
+          for ( int h = h1; h <= h2; h++ )
+            m_items[fill[v * m_columns + h]++] = i;
+      }
+    }
+
+    const INSTANCEBOX* CInstanceIndex::Find( double aX, double aY ) const {
+      if ( m_boxes.empty() || aX < m_left || aY < m_top || aX >= m_right || aY >= m_bottom )
+        return NULL;
+
+      int cell = (int) ( ( aY - m_top ) / m_cellSize ) * m_columns + (int) ( ( aX - m_left ) / m_cellSize );
+
+      for ( int i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++ ) {
+        const INSTANCEBOX& box = m_boxes[m_items[i]];
+
+        if ( aX >= box.left && aX < box.right && aY >= box.top && aY < box.bottom )
+          return &box;
+      }
+
+      return NULL;
+    }
+  }
+
+  /************************************************************************/
+  /* CParticleEngine class implementation                                 */
+  /************************************************************************/
+
+  PGMPARTICLESYSTEM CParticleEngine::FindParticleSystem( int aParticleSystemId ) {
+    PGMPARTICLESTORAGE storage = CGMAPI::ParticleData();
+
+    if ( aParticleSystemId < 0 || aParticleSystemId >= storage->particleSystemCount ||
+         !storage->particleSystems || !storage->particleSystems[aParticleSystemId].isValid )
+      return NULL;
+
+    return storage->particleSystems + aParticleSystemId;
+  }
+
+  PGMPARTICLESYSTEM CParticleEngine::GetParticleSystem( int aParticleSystemId ) {
+    PGMPARTICLESYSTEM system = FindParticleSystem( aParticleSystemId );
+
+    if ( !system )
+      throw EGMAPIParticleSystemNotExist( aParticleSystemId );
+
+    return system;
+  }
+
+  PGMPARTICLEEMITTER CParticleEngine::GetEmitter( PGMPARTICLESYSTEM aSystem, int aParticleSystemId,
+                                                  int aEmitterId ) {
+    if ( aEmitterId < 0 || aEmitterId >= aSystem->emitterCount ||
+         !aSystem->emitters || !aSystem->emitters[aEmitterId].isValid )
+      throw EGMAPIEmitterNotExist( aEmitterId );
+
+    return aSystem->emitters + aEmitterId;
+  }
+
+  PGMPARTICLETYPE CParticleEngine::GetParticleType( int aParticleTypeId ) {
+    PGMPARTICLESTORAGE storage = CGMAPI::ParticleData();
+
+    if ( aParticleTypeId < 0 || aParticleTypeId >= storage->particleTypeCount ||
+         !storage->particleTypes || !storage->particleTypes[aParticleTypeId].isValid )
+      throw EGMAPIParticleTypeNotExist( aParticleTypeId );
+
+    return storage->particleTypes + aParticleTypeId;
+  }
+
+  void CParticleEngine::InitializeParticle( GMPARTICLE& aParticle, const GMPARTICLEEMITTER& aEmitter,
+                                            const GMPARTICLETYPE& aType, int aParticleTypeId,
+                                            const double* aRandom ) {
+    // aRandom[0..6] - position, [8..12] - particle properties, [13..15] - color
+    double u = Distribute( aEmitter.ditribution, aRandom );
+    double v = Distribute( aEmitter.ditribution, aRandom + 3 );
+    double x, y;
+
+    double halfWidth = ( aEmitter.xMax - aEmitter.xMin ) * 0.5;
+    double halfHeight = ( aEmitter.yMax - aEmitter.yMin ) * 0.5;
+    double centerX = aEmitter.xMin + halfWidth;
+    double centerY = aEmitter.yMin + halfHeight;
+
+    if ( aEmitter.shape == ps_shape_ellipse ) {
+      double radius = ( aEmitter.ditribution == ps_distr_linear ? sqrt( aRandom[0] ) : fabs( 2.0 * u - 1.0 ) );
+      double angle = aRandom[6] * 2.0 * PI;
+
+      x = centerX + cos( angle ) * radius * halfWidth;
+      y = centerY + sin( angle ) * radius * halfHeight;
+    } else if ( aEmitter.shape == ps_shape_diamond ) {
+      // Linear mapping of the unit square onto the diamond
+      x = centerX + ( u - v ) * halfWidth;
+      y = centerY + ( u + v - 1.0 ) * halfHeight;
+    } else if ( aEmitter.shape == ps_shape_line ) {
+      x = RandomRange( aEmitter.xMin, aEmitter.xMax, u );
+      y = RandomRange( aEmitter.yMin, aEmitter.yMax, u );
+    } else {
+      x = RandomRange( aEmitter.xMin, aEmitter.xMax, u );
+      y = RandomRange( aEmitter.yMin, aEmitter.yMax, v );
+    }
+
+    int life = aType.lifeMin + (int) ( aRandom[8] * ( aType.lifeMax - aType.lifeMin + 1 ) );
+
+    aParticle.particleTypeID = aParticleTypeId;
+    aParticle.lifeTimeElapsed = 0;
+    aParticle.lifeTimeTotal = ( life > aType.lifeMax ? aType.lifeMax : life );
+    aParticle.x = aParticle.xPrevious = x;
+    aParticle.y = aParticle.yPrevious = y;
+    aParticle.speed = RandomRange( aType.speedMin, aType.speedMax, aRandom[9] );
+    aParticle.direction = RandomRange( aType.directionMin, aType.directionMax, aRandom[10] );
+    aParticle.angle = RandomRange( aType.angleMin, aType.angleMax, aRandom[11] );
+    aParticle.size = RandomRange( aType.sizeMin, aType.sizeMax, aRandom[12] );
+    aParticle.color = ParticleColor( aType, aRandom + 13 );
+    aParticle.alpha = aType.alpha1;
+    aParticle.isValid = true;
+  }
+
+  void CParticleEngine::FillRandom( int aParticles, const double*& aBegin, const double*& aEnd ) {
+    int count = ( aParticles < RANDOM_BATCH ? aParticles : RANDOM_BATCH ) * RANDOM_VALUES_PER_PARTICLE;
+
+    if ( m_randomBuffer.empty() )
+      m_randomBuffer.resize( RANDOM_BATCH * RANDOM_VALUES_PER_PARTICLE );
+
+    m_random.Fill( &m_randomBuffer[0], count );
+
+    aBegin = &m_randomBuffer[0];
+    aEnd = aBegin + count;
+  }
+
+  GMPARTICLE* CParticleEngine::AllocateParticles( PGMPARTICLESYSTEM aSystem, int aCount ) {
+    // GMAPI can allocate memory of the runner's memory manager only as
+    // Delphi strings. Their blocks have the layout of dynamic arrays
+    // (reference count and length before the data), so the new array is
+    // allocated as a string of its size and the length is then set to
+    // the number of particles.
+    size_t size = aCount * sizeof( GMPARTICLE );
+    std::string filler( size, ' ' );
+    const char* block = NULL;
+
+    core::DelphiStringSetFromPChar( filler.c_str(), &block );
+
+    if ( !block )
+      return NULL;
+
+    ((DWORD*) block)[-1] = aCount;
+    memset( (void*) block, 0, size );
+
+    if ( aSystem->particleCount > 0 )
+      memcpy( (void*) block, aSystem->particles, aSystem->particleCount * sizeof( GMPARTICLE ) );
+
+    // The old array is freed by the runner's memory manager as well
+    const char* previous = (const char*) aSystem->particles;
+
+    aSystem->particles = (GMPARTICLE*) block;
+    aSystem->particleCount = aCount;
+
+    if ( previous )
+      core::DelphiStringClear( &previous );
+
+    return aSystem->particles;
+  }
+
+  int CParticleEngine::Burst( int aParticleSystemId, int aEmitterId, int aParticleTypeId, int aNumber ) {
+    PGMPARTICLESYSTEM system = GetParticleSystem( aParticleSystemId );
+    GMPARTICLEEMITTER emitter = *GetEmitter( system, aParticleSystemId, aEmitterId );
+    GMPARTICLETYPE particleType = *GetParticleType( aParticleTypeId );
+
+    if ( aNumber < 0 ) {
+      if ( m_random.NextDouble() * -aNumber >= 1.0 )
+        return 0;
+
+      aNumber = 1;
+    }
+
+    if ( !aNumber )
+      return 0;
+
+    // The random values are generated in batches, so the buffer does not
+    // grow with the number passed by the script
+    const double* random = NULL;
+    const double* randomEnd = NULL;
+    GMPARTICLE* particles = system->particles;
+    int created = 0;
+
+    // Reuse the slots of dead particles first
+    for ( int i = 0; i < system->particleCount && created < aNumber; i++ ) {
+      if ( !particles[i].isValid ) {
+        if ( random == randomEnd )
+          FillRandom( aNumber - created, random, randomEnd );
+
+        InitializeParticle( particles[i], emitter, particleType, aParticleTypeId, random );
+        random += RANDOM_VALUES_PER_PARTICLE;
+        ++created;
+      }
+    }
+
+    if ( created < aNumber ) {
+      int previousCount = system->particleCount;
+
+      particles = AllocateParticles( system, previousCount + aNumber - created );
+
+      for ( int i = previousCount; particles && i < system->particleCount; i++ ) {
+        if ( random == randomEnd )
+          FillRandom( aNumber - created, random, randomEnd );
+
+        InitializeParticle( particles[i], emitter, particleType, aParticleTypeId, random );
+        random += RANDOM_VALUES_PER_PARTICLE;
+        ++created;
+      }
+    }
+
+    return created;
+  }
+
+  void CParticleEngine::Stream( int aParticleSystemId, int aEmitterId, int aParticleTypeId, int aNumber ) {
+    PGMPARTICLEEMITTER emitter = GetEmitter( GetParticleSystem( aParticleSystemId ),
+                                             aParticleSystemId, aEmitterId );
+    GetParticleType( aParticleTypeId );
+
+    // Kept in the runner's emitter as well, so that automatic updates of
+    // the system emit the stream
+    emitter->particleType = aParticleTypeId;
+    emitter->streamNumber = aNumber;
+
+    std::pair<int, int> key( aParticleSystemId, aEmitterId );
+
+    if ( !aNumber ) {
+      m_streams.erase( key );
+      return;
+    }
+
+    STREAMINFO& stream = m_streams[key];
+    stream.particleTypeId = aParticleTypeId;
+    stream.number = aNumber;
+    stream.paused = false;
+  }
+
+  int CParticleEngine::BeginUpdate( int aParticleSystemId ) {
+    PGMPARTICLESYSTEM system = FindParticleSystem( aParticleSystemId );
+    StreamMap::iterator it = m_streams.lower_bound( std::make_pair( aParticleSystemId, 0 ) );
+    int count = 0;
+
+    while ( it != m_streams.end() && it->first.first == aParticleSystemId ) {
+      StreamMap::iterator current = it++;
+      int emitterId = current->first.second;
+      STREAMINFO& stream = current->second;
+      PGMPARTICLEEMITTER emitter = NULL;
+
+      if ( system && emitterId < system->emitterCount && system->emitters[emitterId].isValid )
+        emitter = system->emitters + emitterId;
+
+      // The emitter has been destroyed or its stream changed by the runner
+      if ( !emitter || emitter->streamNumber != stream.number || emitter->particleType != stream.particleTypeId ) {
+        m_streams.erase( current );
+        continue;
+      }
+
+      emitter->streamNumber = 0;
+      stream.paused = true;
+      ++count;
+    }
+
+    return count;
+  }
+
+  int CParticleEngine::EndUpdate( int aParticleSystemId ) {
+    StreamMap::iterator it = m_streams.lower_bound( std::make_pair( aParticleSystemId, 0 ) );
+    int created = 0;
+
+    while ( it != m_streams.end() && it->first.first == aParticleSystemId ) {
+      StreamMap::iterator current = it++;
+      STREAMINFO& stream = current->second;
+
+      if ( !stream.paused )
+        continue;
+
+      stream.paused = false;
+
+      try {
+        PGMPARTICLEEMITTER emitter = GetEmitter( GetParticleSystem( aParticleSystemId ), aParticleSystemId,
+                                                 current->first.second );
+
+        emitter->streamNumber = stream.number;
+        created += Burst( aParticleSystemId, current->first.second, stream.particleTypeId, stream.number );
+      } catch ( const EGMAPIResourceException& ) {
+        // The particle system, emitter or particle type has been destroyed
+        // during the update
+        m_streams.erase( current );
+      }
+    }
+
+    return created;
+  }
+
+  void CParticleEngine::Deflect( GMPARTICLE& aParticle, bool aHorizontal, bool aVertical ) {
+    if ( aHorizontal )
+      aParticle.direction = 180.0 - aParticle.direction;
+
+    if ( aVertical )
+      aParticle.direction = -aParticle.direction;
+
+    aParticle.direction = fmod( aParticle.direction, 360.0 );
+    if ( aParticle.direction < 0 )
+      aParticle.direction += 360.0;
+
+    // Move the particle back out of the obstacle
+    aParticle.x = aParticle.xPrevious;
+    aParticle.y = aParticle.yPrevious;
+  }
+
+  int CParticleEngine::CollideInstances( int aParticleSystemId, int aObject, ParticleCollisionResponse aResponse,
+                                         PARTICLECOLLISIONPROC aProc, void* aParam ) {
+    PGMPARTICLESYSTEM system = GetParticleSystem( aParticleSystemId );
+    CInstanceIndex index;
+    bool called = false;
+    int collided = 0;
+
+    index.Build( aObject );
+
+    for ( int i = 0; i < system->particleCount; i++ ) {
+      GMPARTICLE& particle = system->particles[i];
+
+      if ( !particle.isValid )
+        continue;
+
+      const INSTANCEBOX* box = index.Find( particle.x, particle.y );
+
+      // Instances destroyed by previous callbacks are skipped
+      if ( !box || ( called && !CRoomInstances::Find( box->id ) ) )
+        continue;
+
+      ++collided;
+
+      if ( aResponse == PCR_DEFLECT ) {
+        bool insideX = ( particle.xPrevious >= box->left && particle.xPrevious < box->right );
+        bool insideY = ( particle.yPrevious >= box->top && particle.yPrevious < box->bottom );
+
+        // Particles that were already inside the box can not be deflected
+        if ( !insideX || !insideY )
+          Deflect( particle, !insideX, !insideY );
+      } else if ( aResponse == PCR_DESTROY ) {
+        particle.isValid = false;
+      } else if ( aProc ) {
+        bool destroy = aProc( particle, box->id, aParam );
+        called = true;
+
+        // The callback could have created new particles or destroyed
+        // the particle system
+        system = FindParticleSystem( aParticleSystemId );
+
+        if ( !system )
+          break;
+
+        if ( destroy && i < system->particleCount )
+          system->particles[i].isValid = false;
+      }
+    }
+
+    return collided;
+  }
+
+  int CParticleEngine::CollideGrid( int aParticleSystemId, int aGridId, ParticleCollisionResponse aResponse,
+                                    PARTICLECOLLISIONPROC aProc, void* aParam ) {
+    PGMPARTICLESYSTEM system = GetParticleSystem( aParticleSystemId );
+    const CMotionGrid* grid = &CMotionGrid::Get( aGridId );
+    int collided = 0;
+
+    for ( int i = 0; i < system->particleCount; i++ ) {
+      GMPARTICLE& particle = system->particles[i];
+
+      if ( !particle.isValid || !grid->IsPointForbidden( particle.x, particle.y ) )
+        continue;
+
+      ++collided;
+
+      if ( aResponse == PCR_DEFLECT ) {
+        bool horizontal = grid->IsPointForbidden( particle.x, particle.yPrevious );
+        bool vertical = grid->IsPointForbidden( particle.xPrevious, particle.y );
+
+        if ( !horizontal && !vertical )
+          horizontal = vertical = true;
+
+        if ( !grid->IsPointForbidden( particle.xPrevious, particle.yPrevious ) )
+          Deflect( particle, horizontal, vertical );
+      } else if ( aResponse == PCR_DESTROY ) {
+        particle.isValid = false;
+      } else if ( aProc ) {
+        bool destroy = aProc( particle, (int) noone, aParam );
+
+        system = FindParticleSystem( aParticleSystemId );
+
+        if ( !system )
+          break;
+
+        if ( destroy && i < system->particleCount )
+          system->particles[i].isValid = false;
+
+        grid = CMotionGrid::Find( aGridId );
+
+        if ( !grid )
+          break;
+      }
+    }
+
+    return collided;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    GMFUCTION runnerPartEmitterBurst = NULL;
+    GMFUCTION runnerPartEmitterStream = NULL;
+    GMFUCTION runnerPartSystemUpdate = NULL;
+
+    void PartEmitterBurst( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      try {
+        CParticleEngine::Burst( (int) aArgs[0].real, (int) aArgs[1].real,
+                                (int) aArgs[2].real, (int) aArgs[3].real );
+      } catch ( const EGMAPIException& ) {
+        core::RunnerCallFunction( runnerPartEmitterBurst, aArgs, aArgCount, aResult );
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PartEmitterBurst )
+
+    void PartEmitterStream( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      try {
+        CParticleEngine::Stream( (int) aArgs[0].real, (int) aArgs[1].real,
+                                 (int) aArgs[2].real, (int) aArgs[3].real );
+      } catch ( const EGMAPIException& ) {
+        core::RunnerCallFunction( runnerPartEmitterStream, aArgs, aArgCount, aResult );
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PartEmitterStream )
+
+    void PartSystemUpdate( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      int system = (int) aArgs[0].real;
+      bool streams = ( CParticleEngine::BeginUpdate( system ) > 0 );
+
+      core::RunnerCallFunction( runnerPartSystemUpdate, aArgs, aArgCount, aResult );
+
+      if ( streams )
+        CParticleEngine::EndUpdate( system );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PartSystemUpdate )
+
+    bool ParticleCollisionScript( const GMPARTICLE& aParticle, int aInstance, void* aParam ) {
+      CGMVariable args[3] = { aParticle.x, aParticle.y, aInstance };
+
+      return ( script_execute( *(int*) aParam, args, 3 ).real() > 0.5 );
+    }
+
+    void PartSystemCollideInstances( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                     int aArgCount, PGMVALUE aResult ) {
+      int script = (int) aArgs[3].real;
+
+      try {
+        aResult->Set( (double) CParticleEngine::CollideInstances( (int) aArgs[0].real, (int) aArgs[1].real,
+                                                                  (ParticleCollisionResponse) (int) aArgs[2].real,
+                                                                  ParticleCollisionScript, &script ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PartSystemCollideInstances )
+
+    void PartSystemCollideGrid( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                int aArgCount, PGMVALUE aResult ) {
+      int script = (int) aArgs[3].real;
+
+      try {
+        aResult->Set( (double) CParticleEngine::CollideGrid( (int) aArgs[0].real, (int) aArgs[1].real,
+                                                             (ParticleCollisionResponse) (int) aArgs[2].real,
+                                                             ParticleCollisionScript, &script ) );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PartSystemCollideGrid )
+  }
+
+  void CParticleEngine::RegisterGMFunctions() {
+    runnerPartEmitterBurst = GMAPI_GMFUNCTION_OVERRIDE( id_part_emitter_burst, PartEmitterBurst );
+    runnerPartEmitterStream = GMAPI_GMFUNCTION_OVERRIDE( id_part_emitter_stream, PartEmitterStream );
+    runnerPartSystemUpdate = GMAPI_GMFUNCTION_OVERRIDE( id_part_system_update, PartSystemUpdate );
+    GMAPI_GMFUNCTION_REGISTER( "part_system_collide_instances", 4, PartSystemCollideInstances );
+    GMAPI_GMFUNCTION_REGISTER( "part_system_collide_grid", 4, PartSystemCollideGrid );
+  }
+
+#endif
+
+}
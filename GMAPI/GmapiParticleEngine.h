@@ -0,0 +1,243 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiParticleEngine.h                                               */
+/*   - Native particle emission that writes directly into the           */
+/*     runner's particle arrays                                         */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiInternal.h"
+#include "GmapiUtilities.h"
+
+#include <map>
+#include <vector>
+
+namespace gm {
+
+  /// Response of particles colliding with instances or grid cells
+  enum ParticleCollisionResponse {
+    PCR_DEFLECT,  // Particle bounces off the obstacle
+    PCR_DESTROY,  // Particle is destroyed
+    PCR_CALLBACK  // PARTICLECOLLISIONPROC callback function is called
+  };
+
+  /// PARTICLECOLLISIONPROC callback function should be defined like following:
+  ///   bool CollisionProc( const GMPARTICLE& aParticle, int aInstance, void* aParam );
+  ///
+  ///   aParticle is a copy of the colliding particle and aInstance is ID of
+  ///   the instance it collided with, or noone when the particle has entered
+  ///   forbidden grid cell. The particle is destroyed if the function returns
+  ///   true. The callback may change the room and the particle system (e.g.
+  ///   run a script), the engine looks them up again after every call.
+  ///
+  typedef bool (*PARTICLECOLLISIONPROC)( const GMPARTICLE&, int, void* );
+
+  /// CParticleEngine
+  ///   Native replacement of the emitter functions. Particles are
+  ///   initialized directly in the particle system's GMPARTICLE array,
+  ///   so a burst of thousands of particles costs at most one runner call.
+  ///
+  ///   New particles are placed in free slots (isValid == false) first.
+  ///   Only when there is not enough of them, the array is replaced by a
+  ///   larger one. Particle arrays are Delphi dynamic arrays owned by the
+  ///   runner; the larger array is allocated by the runner's memory
+  ///   manager (see AllocateParticles), so the runner grows and frees it
+  ///   like its own.
+  ///
+  ///   Native streams are emitted by part_system_update: BeginUpdate
+  ///   hides them from the runner and EndUpdate creates their particles.
+  ///   Streams of systems updated automatically by the runner are emitted
+  ///   by the runner itself, as the stream number of the emitter is kept.
+  ///
+  class CParticleEngine {
+    public:
+      /// Burst( int aParticleSystemId, int aEmitterId, int aParticleTypeId, int aNumber )
+      ///   Native version of part_emitter_burst. Creates particles in the region
+      ///   of the emitter, using its shape and distribution.
+      ///
+      /// Parameters:
+      ///   aParticleSystemId: ID of the particle system.
+      ///   aEmitterId: ID of the emitter in the particle system.
+      ///   aParticleTypeId: ID of the particle type.
+      ///   aNumber: Number of particles to create. If the value is negative,
+      ///            one particle is created with a chance of 1/-aNumber.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIParticleSystemNotExist, EGMAPIEmitterNotExist or
+      ///   EGMAPIParticleTypeNotExist when any of the specified resources
+      ///   does not exist.
+      ///
+      /// Returns:
+      ///   Number of particles that have been created.
+      ///
+      static int Burst( int aParticleSystemId, int aEmitterId, int aParticleTypeId, int aNumber );
+
+      /// Stream( int aParticleSystemId, int aEmitterId, int aParticleTypeId, int aNumber )
+      ///   Native version of part_emitter_stream. Sets the emitter's particle
+      ///   type and stream number like the runner and remembers the stream,
+      ///   so that its particles are created natively between BeginUpdate
+      ///   and EndUpdate.
+      ///
+      /// Parameters:
+      ///   aParticleSystemId: ID of the particle system.
+      ///   aEmitterId: ID of the emitter in the particle system.
+      ///   aParticleTypeId: ID of the particle type.
+      ///   aNumber: Number of particles created per step (see Burst). Pass 0
+      ///            to stop the stream.
+      ///
+      /// Exceptions:
+      ///   See Burst method.
+      ///
+      static void Stream( int aParticleSystemId, int aEmitterId, int aParticleTypeId, int aNumber );
+
+      /// BeginUpdate( int aParticleSystemId )
+      ///   Sets stream numbers of the native streams of the particle system
+      ///   to 0, so that part_system_update called next does not create
+      ///   their particles. Streams whose emitter has been destroyed or
+      ///   changed by the runner are forgotten.
+      ///
+      /// Returns:
+      ///   Number of native streams of the particle system.
+      ///
+      static int BeginUpdate( int aParticleSystemId );
+
+      /// EndUpdate( int aParticleSystemId )
+      ///   Restores stream numbers set to 0 by BeginUpdate and creates the
+      ///   particles of the streams.
+      ///
+      /// Returns:
+      ///   Number of particles that have been created.
+      ///
+      static int EndUpdate( int aParticleSystemId );
+
+      /// CollideInstances( int aParticleSystemId, int aObject, ParticleCollisionResponse aResponse,
+      ///                   PARTICLECOLLISIONPROC aProc, void* aParam )
+      ///   Tests live particles of the particle system against bounding boxes
+      ///   of solid instances and applies the response to colliding ones.
+      ///   Instances are put into a uniform grid first, so each particle is
+      ///   tested only against the instances in its cell. The method should
+      ///   be called once per step, after the particle system has been updated.
+      ///   Instances destroyed by the callback are not reported any more;
+      ///   the callback stops being called if it destroys the particle system.
+      ///
+      /// Parameters:
+      ///   aParticleSystemId: ID of the particle system.
+      ///   aObject: Object (including its children), instance ID or all.
+      ///   aResponse: Response to collision.
+      ///   aProc: [optional] Callback function, used with PCR_CALLBACK response.
+      ///   aParam: [optional] Parameter passed to the callback function.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIParticleSystemNotExist if the particle system does not exist.
+      ///
+      /// Returns:
+      ///   Number of particles that have collided.
+      ///
+      static int CollideInstances( int aParticleSystemId, int aObject, ParticleCollisionResponse aResponse,
+                                   PARTICLECOLLISIONPROC aProc = NULL, void* aParam = NULL );
+
+      /// CollideGrid( int aParticleSystemId, int aGridId, ParticleCollisionResponse aResponse,
+      ///              PARTICLECOLLISIONPROC aProc, void* aParam )
+      ///   Tests live particles of the particle system against forbidden cells
+      ///   of the motion planning grid (see CMotionGrid) and applies the response
+      ///   to particles lying in them. The test stops if the callback destroys
+      ///   the particle system or the grid.
+      ///
+      /// Parameters:
+      ///   aParticleSystemId: ID of the particle system.
+      ///   aGridId: ID of the mp_grid.
+      ///   aResponse: Response to collision.
+      ///   aProc: [optional] Callback function, used with PCR_CALLBACK response.
+      ///   aParam: [optional] Parameter passed to the callback function.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIParticleSystemNotExist or EGMAPIMotionGridNotExist when
+      ///   the particle system or the grid does not exist.
+      ///
+      /// Returns:
+      ///   Number of particles that have collided.
+      ///
+      static int CollideGrid( int aParticleSystemId, int aGridId, ParticleCollisionResponse aResponse,
+                              PARTICLECOLLISIONPROC aProc = NULL, void* aParam = NULL );
+
+      /// GetRandom()
+      ///   Returns reference to the random number generator used by
+      ///   the engine. It can be used to seed the generator.
+      ///
+      static CRandom& GetRandom() {
+        return m_random;
+      }
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Overrides part_emitter_burst and part_emitter_stream with the
+      ///   native versions and part_system_update to emit the native
+      ///   streams (calls for resources which do not exist are passed to
+      ///   the runner, which reports the error). It also registers the
+      ///   following GML functions:
+      ///     part_system_collide_instances( ps, obj, response, script )
+      ///     part_system_collide_grid( ps, grid, response, script )
+      ///
+      ///   Response is 0 (deflect), 1 (destroy) or 2 (script). The script is
+      ///   executed with arguments x, y and id of the instance (or noone for
+      ///   the grid); the particle is destroyed when the script returns true.
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      struct STREAMINFO {
+        int particleTypeId;
+        int number;
+        bool paused;      // Stream number set to 0 by BeginUpdate
+      };
+
+      typedef std::map<std::pair<int, int>, STREAMINFO> StreamMap;
+
+      // Number of random values used to initialize a single particle
+      static const int RANDOM_VALUES_PER_PARTICLE = 16;
+
+      // Largest number of particles whose random values are generated at once
+      static const int RANDOM_BATCH = 1024;
+
+      static PGMPARTICLESYSTEM FindParticleSystem( int aParticleSystemId );
+      static PGMPARTICLESYSTEM GetParticleSystem( int aParticleSystemId );
+      static PGMPARTICLEEMITTER GetEmitter( PGMPARTICLESYSTEM aSystem, int aParticleSystemId,
+                                            int aEmitterId );
+      static PGMPARTICLETYPE GetParticleType( int aParticleTypeId );
+
+      static void InitializeParticle( GMPARTICLE& aParticle, const GMPARTICLEEMITTER& aEmitter,
+                                      const GMPARTICLETYPE& aType, int aParticleTypeId,
+                                      const double* aRandom );
+
+      static void FillRandom( int aParticles, const double*& aBegin, const double*& aEnd );
+      static GMPARTICLE* AllocateParticles( PGMPARTICLESYSTEM aSystem, int aCount );
+
+      static void Deflect( GMPARTICLE& aParticle, bool aHorizontal, bool aVertical );
+
+      static CRandom m_random;
+      static std::vector<double> m_randomBuffer;
+      static StreamMap m_streams;
+  };
+
+}
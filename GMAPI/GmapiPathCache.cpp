@@ -0,0 +1,267 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathCache.cpp                                                  */
+/*   - Cache of paths found on mirrored mp_grids                        */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiPathCache.h"
+#include "GmapiMacros.h"
+
+#include <string.h>
+
+namespace gm {
+
+  CPathCache::EntryList CPathCache::m_entries;
+  CPathCache::EntryMap CPathCache::m_index;
+  int CPathCache::m_capacity = 0;
+  bool CPathCache::m_strict = false;
+  PATHCACHESTATS CPathCache::m_statistics = { 0, 0, 0, 0 };
+
+  namespace {
+    inline bool IsInRange( int aH, int aV, int aLeft, int aTop, int aRight, int aBottom ) {
+      return ( aH >= aLeft && aH <= aRight && aV >= aTop && aV <= aBottom );
+    }
+
+    // Checks whether the path depends on a cell of the range: a cell along
+    // the path or one of the two cells next to the corner of a diagonal
+    // step, which must stay free as well
+    bool UsesRange( const std::vector<GRIDCELL>& aCells, int aLeft, int aTop, int aRight, int aBottom ) {
+      for ( size_t i = 0; i < aCells.size(); i++ ) {
+        const GRIDCELL& cell = aCells[i];
+
+        if ( IsInRange( cell.h, cell.v, aLeft, aTop, aRight, aBottom ) )
+          return true;
+
+        if ( i > 0 && cell.h != aCells[i - 1].h && cell.v != aCells[i - 1].v &&
+             ( IsInRange( cell.h, aCells[i - 1].v, aLeft, aTop, aRight, aBottom ) ||
+               IsInRange( aCells[i - 1].h, cell.v, aLeft, aTop, aRight, aBottom ) ) )
+          return true;
+      }
+
+      return false;
+    }
+  }
+
+  /************************************************************************/
+  /* CPathCache::CGridListener class implementation                       */
+  /************************************************************************/
+
+  class CPathCache::CGridListener: public CMotionGridListener {
+    public:
+      virtual void OnCellsChanged( const CMotionGrid& aGrid, int aLeft, int aTop, int aRight, int aBottom ) {
+        // Cells of the range may have been both added and cleared
+        bool cleared = false;
+
+        for ( int v = aTop; v <= aBottom && !cleared; v++ ) {
+          for ( int h = aLeft; h <= aRight && !cleared; h++ )
+            cleared = !aGrid.IsCellForbidden( h, v );
+        }
+
+        for ( EntryList::iterator it = m_entries.begin(); it != m_entries.end(); ) {
+          EntryList::iterator entry = it++;
+
+          if ( entry->key.gridId != aGrid.GetID() )
+            continue;
+
+          if ( !entry->found || ( cleared && m_strict ) ) {
+            if ( cleared ) {
+              Remove( entry );
+              m_statistics.invalidations++;
+            }
+
+            continue;
+          }
+
+          // Corner cells of diagonal steps lie inside the bounding box too
+          if ( entry->right < aLeft || entry->left > aRight || entry->bottom < aTop || entry->top > aBottom )
+            continue;
+
+          if ( UsesRange( entry->cells, aLeft, aTop, aRight, aBottom ) ) {
+            Remove( entry );
+            m_statistics.invalidations++;
+          }
+        }
+      }
+
+      virtual void OnGridDestroyed( const CMotionGrid& aGrid ) {
+        for ( EntryList::iterator it = m_entries.begin(); it != m_entries.end(); ) {
+          EntryList::iterator entry = it++;
+
+          if ( entry->key.gridId == aGrid.GetID() )
+            Remove( entry );
+        }
+      }
+  };
+
+  /************************************************************************/
+  /* CPathCache class implementation                                      */
+  /************************************************************************/
+
+  bool CPathCache::KEY::operator<( const KEY& aKey ) const {
+    if ( gridId != aKey.gridId ) return ( gridId < aKey.gridId );
+    if ( startH != aKey.startH ) return ( startH < aKey.startH );
+    if ( startV != aKey.startV ) return ( startV < aKey.startV );
+    if ( goalH != aKey.goalH ) return ( goalH < aKey.goalH );
+    if ( goalV != aKey.goalV ) return ( goalV < aKey.goalV );
+
+    return ( diagonal < aKey.diagonal );
+  }
+
+  void CPathCache::SetCapacity( int aCapacity ) {
+    // One listener serves the whole cache; it is never removed, so it does
+    // not depend on the order of destruction of static objects
+    static CGridListener listener;
+    CMotionGrid::AddListener( &listener );
+
+    m_capacity = ( aCapacity > 0 ? aCapacity : 0 );
+
+    while ( (int) m_index.size() > m_capacity ) {
+      Remove( --m_entries.end() );
+      m_statistics.evictions++;
+    }
+  }
+
+  bool CPathCache::Find( int aGridId, int aStartH, int aStartV, int aGoalH, int aGoalV,
+                         bool aDiagonal, std::vector<GRIDCELL>& aCells, bool& aFound ) {
+    if ( !m_capacity )
+      return false;
+
+    KEY key = { aGridId, aStartH, aStartV, aGoalH, aGoalV, aDiagonal };
+    EntryMap::iterator it = m_index.find( key );
+
+    if ( it == m_index.end() ) {
+      m_statistics.misses++;
+      return false;
+    }
+
+    m_entries.splice( m_entries.begin(), m_entries, it->second );
+    m_statistics.hits++;
+
+    aFound = it->second->found;
+    aCells = it->second->cells;
+    return true;
+  }
+
+  void CPathCache::Store( int aGridId, int aStartH, int aStartV, int aGoalH, int aGoalV,
+                          bool aDiagonal, const std::vector<GRIDCELL>& aCells, bool aFound ) {
+    if ( !m_capacity )
+      return;
+
+    KEY key = { aGridId, aStartH, aStartV, aGoalH, aGoalV, aDiagonal };
+    EntryMap::iterator it = m_index.find( key );
+
+    if ( it != m_index.end() )
+      Remove( it->second );
+    else if ( (int) m_index.size() >= m_capacity ) {
+      Remove( --m_entries.end() );
+      m_statistics.evictions++;
+    }
+
+    m_entries.push_front( ENTRY() );
+    ENTRY& entry = m_entries.front();
+
+    entry.key = key;
+    entry.found = aFound;
+    entry.cells = aCells;
+    entry.left = entry.right = aStartH;
+    entry.top = entry.bottom = aStartV;
+
+    for ( size_t i = 0; i < aCells.size(); i++ ) {
+      if ( aCells[i].h < entry.left ) entry.left = aCells[i].h;
+      if ( aCells[i].h > entry.right ) entry.right = aCells[i].h;
+      if ( aCells[i].v < entry.top ) entry.top = aCells[i].v;
+      if ( aCells[i].v > entry.bottom ) entry.bottom = aCells[i].v;
+    }
+
+    m_index[key] = m_entries.begin();
+  }
+
+  void CPathCache::Clear() {
+    m_index.clear();
+    m_entries.clear();
+  }
+
+  void CPathCache::ResetStatistics() {
+    memset( &m_statistics, 0, sizeof( m_statistics ) );
+  }
+
+  void CPathCache::Remove( EntryList::iterator aEntry ) {
+    m_index.erase( aEntry->key );
+    m_entries.erase( aEntry );
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void MpGridPathCache( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      CPathCache::SetCapacity( (int) aArgs[0].real );
+      CPathCache::SetStrict( aArgs[1].real >= 0.5 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridPathCache )
+
+    void MpGridPathCacheClear( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                               int aArgCount, PGMVALUE aResult ) {
+      CPathCache::Clear();
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridPathCacheClear )
+
+    void MpGridPathCacheStats( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                               int aArgCount, PGMVALUE aResult ) {
+      const PATHCACHESTATS& statistics = CPathCache::GetStatistics();
+
+      switch ( (int) aArgs[0].real ) {
+        case 0: aResult->Set( (double) statistics.hits ); break;
+        case 1: aResult->Set( (double) statistics.misses ); break;
+        case 2: aResult->Set( (double) statistics.invalidations ); break;
+        case 3: aResult->Set( (double) statistics.evictions ); break;
+        case 4: aResult->Set( (double) CPathCache::GetSize() ); break;
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridPathCacheStats )
+  }
+
+  void CPathCache::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+    CPathFinder::RegisterGMFunctions();
+
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_path_cache", 2, MpGridPathCache );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_path_cache_clear", 0, MpGridPathCacheClear );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_path_cache_stats", 1, MpGridPathCacheStats );
+  }
+
+#endif
+
+}
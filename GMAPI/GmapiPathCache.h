@@ -0,0 +1,156 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathCache.h                                                    */
+/*   - Cache of paths found on mirrored mp_grids                        */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiPathFinder.h"
+
+#include <list>
+#include <map>
+#include <vector>
+
+namespace gm {
+
+  struct PATHCACHESTATS {
+    int hits;
+    int misses;
+    int invalidations;  // Entries removed because the grid has changed
+    int evictions;      // Least recently used entries removed to make room
+  };
+
+  /// CPathCache
+  ///   Least recently used cache of search results, keyed by grid, start
+  ///   cell, goal cell and the diagonal flag. It is used by the native
+  ///   mp_grid_path, mp_grid_path_batch and CPathService when its capacity
+  ///   is not 0 (the cache is disabled by default).
+  ///
+  ///   A found path is removed from the cache when a cell it crosses or a
+  ///   cell next to the corner of one of its diagonal steps is changed.
+  ///   Clearing cells elsewhere may open a shorter path than the cached
+  ///   one; use SetStrict to remove all paths of a grid when any of its
+  ///   cells is cleared. Results without a path are removed whenever cells
+  ///   of the grid are cleared.
+  ///
+  ///   The cache must be used from the main thread only.
+  ///
+  class CPathCache {
+    public:
+      /// SetCapacity( int aCapacity )
+      ///   Sets maximal number of cached results; 0 disables the cache and
+      ///   removes all entries.
+      ///
+      static void SetCapacity( int aCapacity );
+
+      static int GetCapacity() {
+        return m_capacity;
+      }
+
+      static int GetSize() {
+        return (int) m_index.size();
+      }
+
+      /// SetStrict( bool aStrict )
+      ///   If true, clearing a cell of a grid removes all cached paths of
+      ///   the grid, so the cache returns only the shortest paths.
+      ///
+      static void SetStrict( bool aStrict ) {
+        m_strict = aStrict;
+      }
+
+      /// Find( int aGridId, int aStartH, int aStartV, int aGoalH, int aGoalV,
+      ///       bool aDiagonal, std::vector<GRIDCELL>& aCells, bool& aFound )
+      ///   Looks up cached result of the search. On success, aFound tells
+      ///   whether a path exists and aCells receives its cells.
+      ///
+      /// Returns:
+      ///   False if the result is not cached or the cache is disabled.
+      ///
+      static bool Find( int aGridId, int aStartH, int aStartV, int aGoalH, int aGoalV,
+                        bool aDiagonal, std::vector<GRIDCELL>& aCells, bool& aFound );
+
+      /// Store( int aGridId, int aStartH, int aStartV, int aGoalH, int aGoalV,
+      ///        bool aDiagonal, const std::vector<GRIDCELL>& aCells, bool aFound )
+      ///   Adds result of a search on the current state of the grid.
+      ///
+      static void Store( int aGridId, int aStartH, int aStartV, int aGoalH, int aGoalV,
+                         bool aDiagonal, const std::vector<GRIDCELL>& aCells, bool aFound );
+
+      /// Clear()
+      ///   Removes all entries.
+      ///
+      static void Clear();
+
+      static const PATHCACHESTATS& GetStatistics() {
+        return m_statistics;
+      }
+
+      static void ResetStatistics();
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers CPathFinder functions and the following GML functions:
+      ///     mp_grid_path_cache( capacity, strict ) - sets capacity of the cache
+      ///       (0 disables it)
+      ///     mp_grid_path_cache_clear()
+      ///     mp_grid_path_cache_stats( kind ) - returns number of hits (0),
+      ///       misses (1), invalidations (2), evictions (3) or cached
+      ///       results (4)
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      class CGridListener;
+      friend class CGridListener;
+
+      struct KEY {
+        int gridId;
+        int startH, startV;
+        int goalH, goalV;
+        bool diagonal;
+
+        bool operator<( const KEY& aKey ) const;
+      };
+
+      struct ENTRY {
+        KEY key;
+        bool found;
+        std::vector<GRIDCELL> cells;
+        int left, top, right, bottom;   // Bounding box of the cells
+      };
+
+      typedef std::list<ENTRY> EntryList;
+      typedef std::map<KEY, EntryList::iterator> EntryMap;
+
+      static void Remove( EntryList::iterator aEntry );
+
+      static EntryList m_entries;   // Most recently used first
+      static EntryMap m_index;
+      static int m_capacity;
+      static bool m_strict;
+      static PATHCACHESTATS m_statistics;
+  };
+
+}
@@ -0,0 +1,580 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathFinder.cpp                                                 */
+/*   - Native path finding on mp_grids                                  */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiPathFinder.h"
+#include "GmapiPathCache.h"
+#include "GmapiDSList.h"
+#include "GmapiResources.h"
+#include "GmapiMacros.h"
+
+#include <math.h>
+#include <algorithm>
+#include <map>
+
+#ifdef _MSC_VER
+  #include <intrin.h>
+#endif
+
+namespace gm {
+
+  namespace {
+    // Cost of a diagonal move
+    static const double DIAGONAL_COST = 1.4142135623730951;
+    // Speed of the points added to paths, same as used by mp_grid_path
+    static const double PATH_POINT_SPEED = 100.0;
+
+    typedef std::map<int, CPathGrid*> SnapshotMap;
+    SnapshotMap snapshots;
+
+    inline int LowestBit( unsigned int aValue ) {
+    #ifdef _MSC_VER
+      unsigned long index;
+      _BitScanForward( &index, aValue );
+      return (int) index;
+    #else
+      return __builtin_ctz( aValue );
+    #endif
+    }
+
+    inline int HighestBit( unsigned int aValue ) {
+    #ifdef _MSC_VER
+      unsigned long index;
+      _BitScanReverse( &index, aValue );
+      return (int) index;
+    #else
+      return 31 - __builtin_clz( aValue );
+    #endif
+    }
+
+    inline int Sign( int aValue ) {
+      return ( aValue > 0 ? 1 : ( aValue < 0 ? -1 : 0 ) );
+    }
+
+    // Length of a path made of straight and diagonal moves
+    inline double OctileDistance( int aDH, int aDV ) {
+      int dh = abs( aDH ), dv = abs( aDV );
+      return ( dh > dv ? ( dh - dv ) + dv * DIAGONAL_COST : ( dv - dh ) + dh * DIAGONAL_COST );
+    }
+
+    // Orders the open list by the estimated length, preferring the nodes
+    // further from the start when the estimates are equal
+    struct OpenNodeGreater {
+      template <class T>
+      bool operator()( const T& aFirst, const T& aSecond ) const {
+        return ( aFirst.f > aSecond.f || ( aFirst.f == aSecond.f && aFirst.g < aSecond.g ) );
+      }
+    };
+  }
+
+  /************************************************************************/
+  /* CPathGrid class implementation                                       */
+  /************************************************************************/
+
+  CPathGrid::CPathGrid( const CMotionGrid& aGrid ):
+    m_gridId( aGrid.GetID() ), m_version( aGrid.GetVersion() ),
+    m_width( aGrid.GetHorizontalCells() ), m_height( aGrid.GetVerticalCells() ),
+    m_stride( ( aGrid.GetHorizontalCells() + 95 ) / 32 + 1 ),
+    m_left( aGrid.GetLeft() ), m_top( aGrid.GetTop() ),
+    m_cellWidth( aGrid.GetCellWidth() ), m_cellHeight( aGrid.GetCellHeight() ),
+    m_bits( m_stride * ( m_height + 2 ), 0xFFFFFFFF ) {
+    const unsigned char* cells = aGrid.GetCells();
+
+    for ( int v = 0; v < m_height; v++ ) {
+      unsigned int* row = &m_bits[( v + 1 ) * m_stride];
+      const unsigned char* source = cells + v * m_width;
+
+      // Clear the bits of the cells, the padding stays forbidden
+      for ( int h = 0; h < m_width; h++ )
+        row[( h + 32 ) >> 5] &= ~( 1u << ( h & 31 ) );
+
+      for ( int h = 0; h < m_width; h++ ) {
+        if ( source[h] )
+          row[( h + 32 ) >> 5] |= 1u << ( h & 31 );
+      }
+    }
+  }
+
+  const CPathGrid& CPathGrid::GetSnapshot( const CMotionGrid& aGrid ) {
+    SnapshotMap::iterator it = snapshots.find( aGrid.GetID() );
+
+    if ( it != snapshots.end() ) {
+      if ( it->second->m_version == aGrid.GetVersion() )
+        return *it->second;
+
+      delete it->second;
+      snapshots.erase( it );
+    }
+
+    // Drop copies of the grids that have been destroyed meanwhile
+    for ( it = snapshots.begin(); it != snapshots.end(); ) {
+      if ( !CMotionGrid::Find( it->first ) ) {
+        delete it->second;
+        snapshots.erase( it++ );
+      } else
+        ++it;
+    }
+
+    CPathGrid* snapshot = new CPathGrid( aGrid );
+    snapshots[aGrid.GetID()] = snapshot;
+
+    return *snapshot;
+  }
+
+  void CPathGrid::CellFromPoint( double aX, double aY, int& aH, int& aV ) const {
+    aH = (int) floor( ( aX - m_left ) / m_cellWidth );
+    aV = (int) floor( ( aY - m_top ) / m_cellHeight );
+  }
+
+  /************************************************************************/
+  /* CPathFinder class implementation                                     */
+  /************************************************************************/
+
+  CPathFinder::CPathFinder():
+    m_search( 0 ), m_width( 0 ), m_goalH( 0 ), m_goalV( 0 ),
+    m_diagonal( false ), m_expanded( 0 ) {}
+
+  bool CPathFinder::FindPath( const CPathGrid& aGrid, int aStartH, int aStartV, int aGoalH, int aGoalV,
+                              bool aDiagonal, std::vector<GRIDCELL>& aCells, PathAlgorithm aAlgorithm ) {
+    aCells.clear();
+    m_expanded = 0;
+
+    if ( !aGrid.IsInside( aStartH, aStartV ) || !aGrid.IsFree( aStartH, aStartV ) ||
+         !aGrid.IsInside( aGoalH, aGoalV ) || !aGrid.IsFree( aGoalH, aGoalV ) )
+      return false;
+
+    Prepare( aGrid, aGoalH, aGoalV, aDiagonal );
+
+    bool found;
+    if ( aDiagonal && aAlgorithm != PA_ASTAR )
+      found = SearchJPS( aGrid, aStartH, aStartV );
+    else
+      found = SearchAStar( aGrid, aStartH, aStartV );
+
+    if ( found )
+      BuildPath( aCells );
+
+    return found;
+  }
+
+  int CPathFinder::FindPaths( const CPathGrid& aGrid, const std::vector<PATHQUERY>& aQueries,
+                              std::vector< std::vector<GRIDCELL> >& aPaths ) {
+    int found = 0;
+    aPaths.resize( aQueries.size() );
+
+    for ( size_t i = 0; i < aQueries.size(); i++ ) {
+      const PATHQUERY& query = aQueries[i];
+
+      if ( FindPath( aGrid, query.startH, query.startV, query.goalH, query.goalV,
+                     query.diagonal, aPaths[i] ) )
+        found++;
+    }
+
+    return found;
+  }
+
+  void CPathFinder::Prepare( const CPathGrid& aGrid, int aGoalH, int aGoalV, bool aDiagonal ) {
+    size_t cellCount = (size_t) aGrid.GetWidth() * aGrid.GetHeight();
+
+    if ( m_state.size() < cellCount ) {
+      m_cost.resize( cellCount );
+      m_parent.resize( cellCount );
+      m_state.resize( cellCount, 0 );
+    }
+
+    m_search += 2;
+    if ( m_search < 2 ) {
+      std::fill( m_state.begin(), m_state.end(), 0 );
+      m_search = 2;
+    }
+
+    m_open.clear();
+    m_width = aGrid.GetWidth();
+    m_goalH = aGoalH;
+    m_goalV = aGoalV;
+    m_diagonal = aDiagonal;
+  }
+
+  double CPathFinder::Estimate( int aH, int aV ) const {
+    if ( m_diagonal )
+      return OctileDistance( aH - m_goalH, aV - m_goalV );
+
+    return abs( aH - m_goalH ) + abs( aV - m_goalV );
+  }
+
+  void CPathFinder::Relax( int aH, int aV, int aParent, double aG ) {
+    int cell = aV * m_width + aH;
+
+    if ( m_state[cell] == m_search + 1 )
+      return;
+    if ( m_state[cell] == m_search && m_cost[cell] <= aG )
+      return;
+
+    m_state[cell] = m_search;
+    m_cost[cell] = aG;
+    m_parent[cell] = aParent;
+
+    OPENNODE node;
+    node.f = aG + Estimate( aH, aV );
+    node.g = aG;
+    node.cell = cell;
+
+    m_open.push_back( node );
+    std::push_heap( m_open.begin(), m_open.end(), OpenNodeGreater() );
+  }
+
+  bool CPathFinder::Pop( int& aCell, double& aG ) {
+    while ( !m_open.empty() ) {
+      std::pop_heap( m_open.begin(), m_open.end(), OpenNodeGreater() );
+      OPENNODE node = m_open.back();
+      m_open.pop_back();
+
+      // Skip nodes that have been expanded or reached by a shorter path
+      // after they were pushed
+      if ( m_state[node.cell] != m_search || node.g > m_cost[node.cell] )
+        continue;
+
+      m_state[node.cell] = m_search + 1;
+      aCell = node.cell;
+      aG = node.g;
+      return true;
+    }
+
+    return false;
+  }
+
+  bool CPathFinder::SearchAStar( const CPathGrid& aGrid, int aStartH, int aStartV ) {
+    static const int STRAIGHT_MOVES[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+    static const int DIAGONAL_MOVES[4][2] = { { 1, 1 }, { -1, 1 }, { -1, -1 }, { 1, -1 } };
+
+    int cell;
+    double g;
+
+    Relax( aStartH, aStartV, -1, 0.0 );
+
+    while ( Pop( cell, g ) ) {
+      int h = cell % m_width, v = cell / m_width;
+
+      if ( h == m_goalH && v == m_goalV )
+        return true;
+
+      m_expanded++;
+
+      for ( int i = 0; i < 4; i++ ) {
+        int nh = h + STRAIGHT_MOVES[i][0], nv = v + STRAIGHT_MOVES[i][1];
+
+        if ( aGrid.IsFree( nh, nv ) )
+          Relax( nh, nv, cell, g + 1.0 );
+      }
+
+      if ( !m_diagonal )
+        continue;
+
+      for ( int i = 0; i < 4; i++ ) {
+        int dh = DIAGONAL_MOVES[i][0], dv = DIAGONAL_MOVES[i][1];
+
+        if ( aGrid.IsFree( h + dh, v ) && aGrid.IsFree( h, v + dv ) && aGrid.IsFree( h + dh, v + dv ) )
+          Relax( h + dh, v + dv, cell, g + DIAGONAL_COST );
+      }
+    }
+
+    return false;
+  }
+
+  bool CPathFinder::SearchJPS( const CPathGrid& aGrid, int aStartH, int aStartV ) {
+    int cell;
+    double g;
+
+    Relax( aStartH, aStartV, -1, 0.0 );
+
+    while ( Pop( cell, g ) ) {
+      int h = cell % m_width, v = cell / m_width;
+
+      if ( h == m_goalH && v == m_goalV )
+        return true;
+
+      m_expanded++;
+
+      // Directions to search from the node. The start node is searched in
+      // all directions, other nodes only in the directions that can not be
+      // reached from the parent at least as cheaply without the node
+      int directions[8][2];
+      int directionCount = 0;
+
+      if ( m_parent[cell] < 0 ) {
+        for ( int dv = -1; dv <= 1; dv++ ) {
+          for ( int dh = -1; dh <= 1; dh++ ) {
+            if ( dh || dv ) {
+              directions[directionCount][0] = dh;
+              directions[directionCount++][1] = dv;
+            }
+          }
+        }
+      } else {
+        int dh = Sign( h - m_parent[cell] % m_width );
+        int dv = Sign( v - m_parent[cell] / m_width );
+
+        if ( dh && dv ) {
+          directions[0][0] = 0;  directions[0][1] = dv;
+          directions[1][0] = dh; directions[1][1] = 0;
+          directions[2][0] = dh; directions[2][1] = dv;
+          directionCount = 3;
+        } else if ( dh ) {
+          directions[0][0] = dh; directions[0][1] = 0;
+          directions[1][0] = dh; directions[1][1] = 1;
+          directions[2][0] = dh; directions[2][1] = -1;
+          directions[3][0] = 0;  directions[3][1] = 1;
+          directions[4][0] = 0;  directions[4][1] = -1;
+          directionCount = 5;
+        } else {
+          directions[0][0] = 0;  directions[0][1] = dv;
+          directions[1][0] = 1;  directions[1][1] = dv;
+          directions[2][0] = -1; directions[2][1] = dv;
+          directions[3][0] = 1;  directions[3][1] = 0;
+          directions[4][0] = -1; directions[4][1] = 0;
+          directionCount = 5;
+        }
+      }
+
+      for ( int i = 0; i < directionCount; i++ ) {
+        int dh = directions[i][0], dv = directions[i][1];
+
+        if ( dh && dv && ( !aGrid.IsFree( h + dh, v ) || !aGrid.IsFree( h, v + dv ) ) )
+          continue;
+
+        int jh = h + dh, jv = v + dv;
+        if ( Jump( aGrid, jh, jv, dh, dv ) )
+          Relax( jh, jv, cell, g + OctileDistance( jh - h, jv - v ) );
+      }
+    }
+
+    return false;
+  }
+
+  bool CPathFinder::JumpHorizontal( const CPathGrid& aGrid, int& aH, int aV, int aDH ) const {
+    // A cell is a jump point if a cell above or below it is free, while
+    // the cell before that one is forbidden. 32 cells are tested at once
+    if ( aDH > 0 ) {
+      for ( ;; ) {
+        unsigned int blocked = aGrid.GetRowBits( aH, aV );
+        unsigned int stop = blocked |
+                            ( ~aGrid.GetRowBits( aH, aV - 1 ) & aGrid.GetRowBits( aH - 1, aV - 1 ) ) |
+                            ( ~aGrid.GetRowBits( aH, aV + 1 ) & aGrid.GetRowBits( aH - 1, aV + 1 ) );
+
+        if ( aV == m_goalV && m_goalH >= aH && m_goalH - aH < 32 )
+          stop |= 1u << ( m_goalH - aH );
+
+        if ( stop ) {
+          int n = LowestBit( stop );
+          aH += n;
+          return ( ( blocked >> n ) & 1 ) == 0;
+        }
+
+        aH += 32;
+      }
+    } else {
+      for ( ;; ) {
+        int first = aH - 31;
+        unsigned int blocked = aGrid.GetRowBits( first, aV );
+        unsigned int stop = blocked |
+                            ( ~aGrid.GetRowBits( first, aV - 1 ) & aGrid.GetRowBits( first + 1, aV - 1 ) ) |
+                            ( ~aGrid.GetRowBits( first, aV + 1 ) & aGrid.GetRowBits( first + 1, aV + 1 ) );
+
+        if ( aV == m_goalV && m_goalH <= aH && aH - m_goalH < 32 )
+          stop |= 1u << ( m_goalH - first );
+
+        if ( stop ) {
+          int n = HighestBit( stop );
+          aH = first + n;
+          return ( ( blocked >> n ) & 1 ) == 0;
+        }
+
+        aH -= 32;
+      }
+    }
+  }
+
+  bool CPathFinder::JumpVertical( const CPathGrid& aGrid, int aH, int& aV, int aDV ) const {
+    for ( ;; aV += aDV ) {
+      if ( !aGrid.IsFree( aH, aV ) )
+        return false;
+
+      if ( aH == m_goalH && aV == m_goalV )
+        return true;
+
+      if ( ( aGrid.IsFree( aH - 1, aV ) && !aGrid.IsFree( aH - 1, aV - aDV ) ) ||
+           ( aGrid.IsFree( aH + 1, aV ) && !aGrid.IsFree( aH + 1, aV - aDV ) ) )
+        return true;
+    }
+  }
+
+  bool CPathFinder::Jump( const CPathGrid& aGrid, int& aH, int& aV, int aDH, int aDV ) const {
+    if ( !aDV )
+      return JumpHorizontal( aGrid, aH, aV, aDH );
+    if ( !aDH )
+      return JumpVertical( aGrid, aH, aV, aDV );
+
+    // Diagonal move stops where a straight jump from the cell finds a jump
+    // point, or where the next diagonal move would cut a corner
+    for ( ;; aH += aDH, aV += aDV ) {
+      if ( !aGrid.IsFree( aH, aV ) )
+        return false;
+
+      if ( aH == m_goalH && aV == m_goalV )
+        return true;
+
+      int h = aH + aDH, v = aV + aDV;
+      if ( JumpHorizontal( aGrid, h, aV, aDH ) || JumpVertical( aGrid, aH, v, aDV ) )
+        return true;
+
+      if ( !aGrid.IsFree( aH + aDH, aV ) || !aGrid.IsFree( aH, aV + aDV ) )
+        return false;
+    }
+  }
+
+  void CPathFinder::BuildPath( std::vector<GRIDCELL>& aCells ) const {
+    int cell = m_goalV * m_width + m_goalH;
+    GRIDCELL current = { m_goalH, m_goalV };
+
+    aCells.push_back( current );
+
+    // Jump points are connected by straight or diagonal lines; add all
+    // cells along them
+    while ( m_parent[cell] >= 0 ) {
+      cell = m_parent[cell];
+      int h = cell % m_width, v = cell / m_width;
+      int dh = Sign( h - current.h ), dv = Sign( v - current.v );
+
+      while ( current.h != h || current.v != v ) {
+        current.h += dh;
+        current.v += dv;
+        aCells.push_back( current );
+      }
+    }
+
+    std::reverse( aCells.begin(), aCells.end() );
+  }
+
+  void CPathFinder::WritePath( int aPathIndex, const CPathGrid& aGrid, const std::vector<GRIDCELL>& aCells,
+                               double aStartX, double aStartY, double aGoalX, double aGoalY ) {
+    WritePath( aPathIndex, aGrid.GetLeft(), aGrid.GetTop(), aGrid.GetCellWidth(), aGrid.GetCellHeight(),
+               aCells, aStartX, aStartY, aGoalX, aGoalY );
+  }
+
+  void CPathFinder::WritePath( int aPathIndex, double aLeft, double aTop, double aCellWidth, double aCellHeight,
+                               const std::vector<GRIDCELL>& aCells, double aStartX, double aStartY,
+                               double aGoalX, double aGoalY ) {
+    path_clear_points( aPathIndex );
+    path_add_point( aPathIndex, aStartX, aStartY, PATH_POINT_SPEED );
+
+    for ( size_t i = 1; i + 1 < aCells.size(); i++ )
+      path_add_point( aPathIndex, aLeft + ( aCells[i].h + 0.5 ) * aCellWidth,
+                      aTop + ( aCells[i].v + 0.5 ) * aCellHeight, PATH_POINT_SPEED );
+
+    path_add_point( aPathIndex, aGoalX, aGoalY, PATH_POINT_SPEED );
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    GMFUCTION runnerMpGridPath = NULL;
+    CPathFinder pathFinder;
+    std::vector<GRIDCELL> pathCells;
+
+    bool FindGridPath( const CMotionGrid& aGrid, int aPathIndex, double aStartX, double aStartY,
+                       double aGoalX, double aGoalY, bool aDiagonal ) {
+      const CPathGrid& grid = CPathGrid::GetSnapshot( aGrid );
+      int startH, startV, goalH, goalV;
+
+      grid.CellFromPoint( aStartX, aStartY, startH, startV );
+      grid.CellFromPoint( aGoalX, aGoalY, goalH, goalV );
+
+      bool found;
+
+      if ( !CPathCache::Find( grid.GetGridID(), startH, startV, goalH, goalV, aDiagonal, pathCells, found ) ) {
+        found = pathFinder.FindPath( grid, startH, startV, goalH, goalV, aDiagonal, pathCells );
+        CPathCache::Store( grid.GetGridID(), startH, startV, goalH, goalV, aDiagonal, pathCells, found );
+      }
+
+      if ( !found )
+        return false;
+
+      CPathFinder::WritePath( aPathIndex, grid, pathCells, aStartX, aStartY, aGoalX, aGoalY );
+      return true;
+    }
+
+    void MpGridPath( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                     int aArgCount, PGMVALUE aResult ) {
+      CMotionGrid* grid = CMotionGrid::Find( (int) aArgs[0].real );
+
+      if ( !grid ) {
+        core::RunnerCallFunction( runnerMpGridPath, aArgs, aArgCount, aResult );
+        return;
+      }
+
+      aResult->Set( FindGridPath( *grid, (int) aArgs[1].real, aArgs[2].real, aArgs[3].real,
+                                  aArgs[4].real, aArgs[5].real, aArgs[6].real >= 0.5 ) ? 1.0 : 0.0 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridPath )
+
+    void MpGridPathBatch( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      try {
+        CMotionGrid& grid = CMotionGrid::Get( (int) aArgs[0].real );
+        const CDSList& list = CDSList::Get( (int) aArgs[1].real );
+        const double* values = list.GetData();
+        int found = 0;
+
+        for ( int i = 0; i + 5 <= list.GetSize(); i += 5 ) {
+          if ( FindGridPath( grid, (int) values[i], values[i + 1], values[i + 2],
+                             values[i + 3], values[i + 4], aArgs[2].real >= 0.5 ) )
+            found++;
+        }
+
+        aResult->Set( (double) found );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridPathBatch )
+  }
+
+  void CPathFinder::RegisterGMFunctions() {
+    if ( runnerMpGridPath )
+      return;
+
+    CMotionGrid::RegisterGMFunctions();
+
+    runnerMpGridPath = GMAPI_GMFUNCTION_OVERRIDE( id_mp_grid_path, MpGridPath );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_path_batch", 3, MpGridPathBatch );
+  }
+
+#endif
+
+}
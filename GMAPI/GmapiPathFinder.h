@@ -0,0 +1,242 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathFinder.h                                                   */
+/*   - Native path finding on mp_grids                                  */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiMotionGrid.h"
+
+#include <vector>
+
+namespace gm {
+
+  struct GRIDCELL {
+    int h;
+    int v;
+  };
+
+  /// CPathGrid
+  ///   Immutable bit-packed copy of a CMotionGrid (one bit per cell, set
+  ///   bit means the cell is forbidden). Each row is padded by 32 forbidden
+  ///   cells on both sides and the grid by one forbidden row at the top and
+  ///   the bottom, so cells just outside the grid can be tested without
+  ///   range checks.
+  ///
+  class CPathGrid {
+    public:
+      CPathGrid( const CMotionGrid& aGrid );
+
+      /// GetSnapshot( const CMotionGrid& aGrid )
+      ///   Returns bit-packed copy of the grid. Copies are cached per grid
+      ///   and rebuilt when the grid has changed since the last call.
+      ///
+      static const CPathGrid& GetSnapshot( const CMotionGrid& aGrid );
+
+      int GetGridID() const { return m_gridId; }
+      int GetVersion() const { return m_version; }
+      int GetWidth() const { return m_width; }
+      int GetHeight() const { return m_height; }
+      double GetLeft() const { return m_left; }
+      double GetTop() const { return m_top; }
+      double GetCellWidth() const { return m_cellWidth; }
+      double GetCellHeight() const { return m_cellHeight; }
+
+      /// IsFree( int aH, int aV )
+      ///   Checks whether the cell is free. aH and aV must lie in range
+      ///   <-1; width> and <-1; height>; use IsInside for other cells.
+      ///
+      bool IsFree( int aH, int aV ) const {
+        unsigned int bit = (unsigned int) ( aH + 32 );
+        return ( ( m_bits[( aV + 1 ) * m_stride + ( bit >> 5 )] >> ( bit & 31 ) ) & 1 ) == 0;
+      }
+
+      /// GetRowBits( int aH, int aV )
+      ///   Returns state of 32 cells starting at the cell: bit n is set if
+      ///   cell aH + n is forbidden. aH must lie in range <-32; width> and
+      ///   aV in range <-1; height>.
+      ///
+      unsigned int GetRowBits( int aH, int aV ) const {
+        unsigned int bit = (unsigned int) ( aH + 32 );
+        const unsigned int* word = &m_bits[( aV + 1 ) * m_stride + ( bit >> 5 )];
+
+        if ( ( bit & 31 ) == 0 )
+          return word[0];
+
+        return ( word[0] >> ( bit & 31 ) ) | ( word[1] << ( 32 - ( bit & 31 ) ) );
+      }
+
+      /// IsInside( int aH, int aV )
+      ///   Checks whether the cell lies inside the grid.
+      ///
+      bool IsInside( int aH, int aV ) const {
+        return ( aH >= 0 && aV >= 0 && aH < m_width && aV < m_height );
+      }
+
+      /// CellFromPoint( double aX, double aY, int& aH, int& aV )
+      ///   Computes the cell containing the point in the room.
+      ///
+      void CellFromPoint( double aX, double aY, int& aH, int& aV ) const;
+
+    private:
+      int m_gridId;
+      int m_version;
+      int m_width;
+      int m_height;
+      int m_stride;    // 32-bit words per row, including the padding
+      double m_left;
+      double m_top;
+      double m_cellWidth;
+      double m_cellHeight;
+      std::vector<unsigned int> m_bits;
+  };
+
+  /// CPathFinder
+  ///   Finds shortest paths between cells of a CPathGrid. Moves between
+  ///   horizontally and vertically adjacent cells cost 1; when diagonal moves
+  ///   are allowed, they cost sqrt(2) and are only possible when both cells
+  ///   next to the corner are free, like in mp_grid_path.
+  ///
+  ///   Paths with diagonal moves are searched by Jump Point Search, other
+  ///   paths by A*. Both algorithms find paths of the same length, although
+  ///   not always the same path.
+  ///
+  ///   The finder keeps its working memory between searches, so reusing one
+  ///   finder for many queries avoids allocations. Finders do not share any
+  ///   state, so different threads may use different finders at once.
+  ///
+  ///   After RegisterGMFunctions has been called, mp_grid_path searches
+  ///   the mirrored grids natively.
+  ///
+  class CPathFinder {
+    public:
+      enum PathAlgorithm { PA_AUTO, PA_ASTAR, PA_JPS };
+
+      struct PATHQUERY {
+        int startH;
+        int startV;
+        int goalH;
+        int goalV;
+        bool diagonal;
+      };
+
+      CPathFinder();
+
+      /// FindPath( const CPathGrid& aGrid, int aStartH, int aStartV, int aGoalH, int aGoalV,
+      ///           bool aDiagonal, std::vector<GRIDCELL>& aCells, PathAlgorithm aAlgorithm )
+      ///   Finds the shortest path between the cells and stores all cells
+      ///   along the path in aCells, including the start and the goal.
+      ///   PA_AUTO and PA_JPS use JPS for diagonal paths, paths without
+      ///   diagonal moves are always searched by A*.
+      ///
+      /// Returns:
+      ///   False if the start or the goal cell is forbidden or no path exists;
+      ///   aCells is then empty.
+      ///
+      bool FindPath( const CPathGrid& aGrid, int aStartH, int aStartV, int aGoalH, int aGoalV,
+                     bool aDiagonal, std::vector<GRIDCELL>& aCells, PathAlgorithm aAlgorithm = PA_AUTO );
+
+      /// FindPaths( const CPathGrid& aGrid, const std::vector<PATHQUERY>& aQueries,
+      ///            std::vector< std::vector<GRIDCELL> >& aPaths )
+      ///   Runs all queries on the grid, aPaths[i] receives the result of
+      ///   aQueries[i] (empty if no path has been found).
+      ///
+      /// Returns:
+      ///   Number of paths found.
+      ///
+      int FindPaths( const CPathGrid& aGrid, const std::vector<PATHQUERY>& aQueries,
+                     std::vector< std::vector<GRIDCELL> >& aPaths );
+
+      /// GetExpandedNodes()
+      ///   Returns number of cells expanded by the last search.
+      ///
+      int GetExpandedNodes() const {
+        return m_expanded;
+      }
+
+      /// WritePath( int aPathIndex, const CPathGrid& aGrid, const std::vector<GRIDCELL>& aCells,
+      ///            double aStartX, double aStartY, double aGoalX, double aGoalY )
+      ///   Replaces points of the path resource like mp_grid_path: the path
+      ///   starts at the start point, passes through the centers of the
+      ///   cells between the start and the goal cell and ends at the goal
+      ///   point. Must be called from the main thread.
+      ///
+      static void WritePath( int aPathIndex, const CPathGrid& aGrid, const std::vector<GRIDCELL>& aCells,
+                             double aStartX, double aStartY, double aGoalX, double aGoalY );
+
+      /// WritePath( int aPathIndex, double aLeft, double aTop, double aCellWidth, double aCellHeight,
+      ///            const std::vector<GRIDCELL>& aCells, double aStartX, double aStartY,
+      ///            double aGoalX, double aGoalY )
+      ///   Same as above, for cells of a grid with the specified position
+      ///   and cell size.
+      ///
+      static void WritePath( int aPathIndex, double aLeft, double aTop, double aCellWidth, double aCellHeight,
+                             const std::vector<GRIDCELL>& aCells, double aStartX, double aStartY,
+                             double aGoalX, double aGoalY );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers CMotionGrid functions, replaces mp_grid_path with the
+      ///   native version (grids that are not mirrored are still searched by
+      ///   the runner) and registers the following GML function:
+      ///     mp_grid_path_batch( id, list, allowdiag ) - list is a ds_list
+      ///       of groups of five values: path, xstart, ystart, xgoal, ygoal;
+      ///       returns number of paths found
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      struct OPENNODE {
+        double f;
+        double g;
+        int cell;
+      };
+
+      void Prepare( const CPathGrid& aGrid, int aGoalH, int aGoalV, bool aDiagonal );
+      double Estimate( int aH, int aV ) const;
+      void Relax( int aH, int aV, int aParent, double aG );
+      bool Pop( int& aCell, double& aG );
+      bool SearchAStar( const CPathGrid& aGrid, int aStartH, int aStartV );
+      bool SearchJPS( const CPathGrid& aGrid, int aStartH, int aStartV );
+      bool JumpHorizontal( const CPathGrid& aGrid, int& aH, int aV, int aDH ) const;
+      bool JumpVertical( const CPathGrid& aGrid, int aH, int& aV, int aDV ) const;
+      bool Jump( const CPathGrid& aGrid, int& aH, int& aV, int aDH, int aDV ) const;
+      void BuildPath( std::vector<GRIDCELL>& aCells ) const;
+
+      // Cells are identified by index v * width + h. m_state holds m_search
+      // for cells reached by the current search and m_search + 1 for cells
+      // already expanded, so the arrays need not be cleared between searches
+      std::vector<double> m_cost;
+      std::vector<int> m_parent;
+      std::vector<unsigned int> m_state;
+      std::vector<OPENNODE> m_open;
+      unsigned int m_search;
+      int m_width;
+      int m_goalH;
+      int m_goalV;
+      bool m_diagonal;
+      int m_expanded;
+  };
+
+}
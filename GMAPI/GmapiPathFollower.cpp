@@ -0,0 +1,399 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathFollower.cpp                                               */
+/*   - Native movement of instances along paths                         */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiPathFollower.h"
+#include "GmapiUtilities.h"
+#include "GmapiMacros.h"
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+namespace gm {
+
+  CPathFollower::FollowerMap CPathFollower::m_followers;
+
+  namespace {
+    // Conversion of GM angles, which are in degrees
+    static const double DEGREES_TO_RADIANS = 3.14159265358979323846 / 180.0;
+  }
+
+  /************************************************************************/
+  /* CPathFollower class implementation                                   */
+  /************************************************************************/
+
+  const CPathFollower::PATHINFO& CPathFollower::GetPathInfo( std::map<int, PATHINFO>& aPaths, int aPath ) {
+    std::map<int, PATHINFO>::iterator it = aPaths.find( aPath );
+
+    if ( it != aPaths.end() )
+      return it->second;
+
+    PATHINFO& info = aPaths[aPath];
+    double speed;
+
+    info.sampler = &CPathSampler::Get( aPath );
+    info.sampler->Sample( 0.0, info.startX, info.startY, speed );
+    info.sampler->Sample( 1.0, info.endX, info.endY, speed );
+
+    return info;
+  }
+
+  template <class T>
+  void CPathFollower::Place( T& aInstance, const FOLLOWER& aFollower, const PATHINFO& aPath ) {
+    double x, y, speed;
+    aPath.sampler->Sample( aInstance.path_position, x, y, speed );
+
+    // The path is scaled and rotated (counterclockwise) around its first
+    // point, which lies at the origin
+    double angle = aInstance.path_orientation * DEGREES_TO_RADIANS;
+    double c = cos( angle ), s = sin( angle );
+    double dx = ( x - aPath.startX ) * aInstance.path_scale;
+    double dy = ( y - aPath.startY ) * aInstance.path_scale;
+
+    x = aFollower.originX + dx * c + dy * s;
+    y = aFollower.originY - dx * s + dy * c;
+
+    if ( x != aInstance.x || y != aInstance.y ) {
+      double direction = atan2( aInstance.y - y, x - aInstance.x ) / DEGREES_TO_RADIANS;
+      aInstance.direction = ( direction < 0.0 ? direction + 360.0 : direction );
+    }
+
+    aInstance.xprevious = aInstance.x;
+    aInstance.yprevious = aInstance.y;
+    aInstance.x = x;
+    aInstance.y = y;
+    UpdateBoundingBox( aInstance );
+  }
+
+  template <class T>
+  void CPathFollower::UpdateBoundingBox( T& aInstance ) {
+    ISprites& sprites = CGMAPI::Ptr()->Sprites;
+    int mask = ( aInstance.mask_index >= 0 ? aInstance.mask_index : aInstance.sprite_index );
+
+    // Instances without a mask have a box of a single point
+    if ( mask < 0 || !sprites.Exists( mask ) || !sprites[mask].Subimages.GetCount() ) {
+      aInstance.bbox_left = aInstance.bbox_right = (int) floor( aInstance.x + 0.5 );
+      aInstance.bbox_top = aInstance.bbox_bottom = (int) floor( aInstance.y + 0.5 );
+      return;
+    }
+
+    ISprite& sprite = sprites[mask];
+
+    // Edges of the sprite's box relative to its origin, scaled and rotated
+    // around it; the box covers whole pixels, hence + 1
+    double left = ( sprite.GetBoundingBoxLeft() - sprite.GetOffsetX() ) * aInstance.image_xscale;
+    double right = ( sprite.GetBoundingBoxRight() + 1 - sprite.GetOffsetX() ) * aInstance.image_xscale;
+    double top = ( sprite.GetBoundingBoxTop() - sprite.GetOffsetY() ) * aInstance.image_yscale;
+    double bottom = ( sprite.GetBoundingBoxBottom() + 1 - sprite.GetOffsetY() ) * aInstance.image_yscale;
+    double cornersX[4] = { left, right, right, left };
+    double cornersY[4] = { top, top, bottom, bottom };
+    double angle = aInstance.image_angle * DEGREES_TO_RADIANS;
+    double c = cos( angle ), s = sin( angle );
+    double minX = 0.0, minY = 0.0, maxX = 0.0, maxY = 0.0;
+
+    for ( int i = 0; i < 4; i++ ) {
+      double x = cornersX[i] * c + cornersY[i] * s;
+      double y = -cornersX[i] * s + cornersY[i] * c;
+
+      minX = ( i == 0 || x < minX ? x : minX );
+      maxX = ( i == 0 || x > maxX ? x : maxX );
+      minY = ( i == 0 || y < minY ? y : minY );
+      maxY = ( i == 0 || y > maxY ? y : maxY );
+    }
+
+    aInstance.bbox_left = (int) floor( aInstance.x + minX + 0.5 );
+    aInstance.bbox_top = (int) floor( aInstance.y + minY + 0.5 );
+    aInstance.bbox_right = std::max( (int) floor( aInstance.x + maxX + 0.5 ) - 1, aInstance.bbox_left );
+    aInstance.bbox_bottom = std::max( (int) floor( aInstance.y + maxY + 0.5 ) - 1, aInstance.bbox_top );
+  }
+
+  template <class T>
+  bool CPathFollower::Advance( T& aInstance, FOLLOWER& aFollower, const PATHINFO& aPath ) {
+    double x, y, speed;
+    double position = aInstance.path_position;
+    double length = aPath.sampler->GetLength() * fabs( aInstance.path_scale );
+
+    aPath.sampler->Sample( position, x, y, speed );
+    aInstance.path_positionprevious = position;
+
+    // Point speeds are percentages of path_speed
+    if ( length > 0.0 )
+      position += aInstance.path_speed * speed / 100.0 / length;
+
+    bool following = true;
+
+    if ( position > 1.0 || position < 0.0 ) {
+      double end = ( position > 1.0 ? 1.0 : 0.0 );
+
+      switch ( aInstance.path_endaction ) {
+        case EA_RESTART:
+          position -= end * 2.0 - 1.0;
+          break;
+
+        case EA_CONTINUE: {
+          // The next round starts where this one has ended
+          double angle = aInstance.path_orientation * DEGREES_TO_RADIANS;
+          double c = cos( angle ), s = sin( angle );
+          double dx = ( aPath.endX - aPath.startX ) * aInstance.path_scale * ( end * 2.0 - 1.0 );
+          double dy = ( aPath.endY - aPath.startY ) * aInstance.path_scale * ( end * 2.0 - 1.0 );
+
+          aFollower.originX += dx * c + dy * s;
+          aFollower.originY += -dx * s + dy * c;
+          position -= end * 2.0 - 1.0;
+          break;
+        }
+
+        case EA_REVERSE:
+          position = end * 2.0 - position;
+          aInstance.path_speed = -aInstance.path_speed;
+          break;
+
+        default:
+          position = end;
+          following = false;
+          break;
+      }
+
+      // Steps longer than the path do not make more than one round
+      position = std::min( std::max( position, 0.0 ), 1.0 );
+    }
+
+    aInstance.path_position = position;
+    Place( aInstance, aFollower, aPath );
+
+    return following;
+  }
+
+  int CPathFollower::Start( int aObject, int aPath, double aSpeed, int aEndAction, bool aAbsolute ) {
+    CInstanceFilter filter( aObject );
+    std::map<int, PATHINFO> paths;
+    int count = 0, started = 0;
+    PGMINSTANCE* instances = CRoomInstances::GetArray( count );
+
+    if ( !instances || !CPathSampler::Get( aPath ).GetPointCount() )
+      return 0;
+
+    const PATHINFO& path = GetPathInfo( paths, aPath );
+    double position = ( aSpeed < 0.0 ? 1.0 : 0.0 );
+
+    for ( int i = 0; i < count; i++ ) {
+      if ( !filter.Matches( instances[i] ) )
+        continue;
+
+      FOLLOWER& follower = m_followers[CRoomInstances::GetID( instances[i] )];
+      follower.path = aPath;
+
+      if ( aAbsolute ) {
+        follower.originX = path.startX;
+        follower.originY = path.startY;
+      } else {
+        // The starting point of the path lies at the instance's position
+        double x, y;
+        CRoomInstances::GetPosition( instances[i], x, y );
+
+        follower.originX = x - ( aSpeed < 0.0 ? path.endX - path.startX : 0.0 );
+        follower.originY = y - ( aSpeed < 0.0 ? path.endY - path.startY : 0.0 );
+      }
+
+      if ( CGlobals::UseNewStructs() ) {
+        GMINSTANCE_NEW& instance = instances[i]->structNew;
+
+        instance.path_index = -1;
+        instance.path_position = instance.path_positionprevious = position;
+        instance.path_speed = aSpeed;
+        instance.path_scale = 1.0;
+        instance.path_orientation = 0.0;
+        instance.path_endaction = aEndAction;
+        Place( instance, follower, path );
+      } else {
+        GMINSTANCE_OLD& instance = instances[i]->structOld;
+
+        instance.path_index = -1;
+        instance.path_position = instance.path_positionprevious = position;
+        instance.path_speed = aSpeed;
+        instance.path_scale = 1.0;
+        instance.path_orientation = 0.0;
+        instance.path_endaction = aEndAction;
+        Place( instance, follower, path );
+      }
+
+      started++;
+    }
+
+    return started;
+  }
+
+  int CPathFollower::Step( int aObject ) {
+    CInstanceFilter filter( aObject );
+    std::map<int, PATHINFO> paths;
+    int count = 0, present = 0, ended = 0, moved = 0;
+    PGMINSTANCE* instances = CRoomInstances::GetArray( count );
+
+    if ( !instances || m_followers.empty() )
+      return 0;
+
+    for ( int i = 0; i < count; i++ ) {
+      if ( !instances[i] )
+        continue;
+
+      FollowerMap::iterator it = m_followers.find( CRoomInstances::GetID( instances[i] ) );
+
+      if ( it == m_followers.end() )
+        continue;
+
+      present++;
+
+      if ( !filter.Matches( instances[i] ) )
+        continue;
+
+      const PATHINFO& path = GetPathInfo( paths, it->second.path );
+
+      // Deleted paths stop their followers, like in the runner
+      if ( !path.sampler->GetPointCount() ) {
+        m_followers.erase( it );
+        ended++;
+        continue;
+      }
+
+      bool following;
+
+      if ( CGlobals::UseNewStructs() )
+        following = Advance( instances[i]->structNew, it->second, path );
+      else
+        following = Advance( instances[i]->structOld, it->second, path );
+
+      if ( !following ) {
+        m_followers.erase( it );
+        ended++;
+      }
+
+      moved++;
+    }
+
+    // Followers of destroyed instances are dropped; deactivated instances
+    // are still in the array, so they keep following their paths
+    if ( present - ended < (int) m_followers.size() )
+      RemoveMissing( instances, count );
+
+    return moved;
+  }
+
+  int CPathFollower::Stop( int aObject ) {
+    CInstanceFilter filter( aObject );
+    int count = 0, stopped = 0;
+    PGMINSTANCE* instances = CRoomInstances::GetArray( count );
+
+    if ( !instances )
+      return 0;
+
+    for ( int i = 0; i < count && !m_followers.empty(); i++ ) {
+      if ( filter.Matches( instances[i] ) && m_followers.erase( CRoomInstances::GetID( instances[i] ) ) )
+        stopped++;
+    }
+
+    return stopped;
+  }
+
+  int CPathFollower::GetPath( int aInstanceId ) {
+    FollowerMap::iterator it = m_followers.find( aInstanceId );
+
+    return ( it != m_followers.end() ? it->second.path : -1 );
+  }
+
+  void CPathFollower::RemoveMissing( PGMINSTANCE* aInstances, int aCount ) {
+    std::vector<int> ids;
+    ids.reserve( aCount );
+
+    for ( int i = 0; i < aCount; i++ ) {
+      if ( aInstances[i] )
+        ids.push_back( CRoomInstances::GetID( aInstances[i] ) );
+    }
+
+    std::sort( ids.begin(), ids.end() );
+
+    for ( FollowerMap::iterator it = m_followers.begin(); it != m_followers.end(); ) {
+      if ( !std::binary_search( ids.begin(), ids.end(), it->first ) )
+        m_followers.erase( it++ );
+      else
+        ++it;
+    }
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void PathFollowStart( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CPathFollower::Start( (int) aArgs[0].real, (int) aArgs[1].real, aArgs[2].real,
+                                                   (int) aArgs[3].real, aArgs[4].real >= 0.5 ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PathFollowStart )
+
+    void PathFollowStep( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CPathFollower::Step( (int) aArgs[0].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PathFollowStep )
+
+    void PathFollowEnd( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CPathFollower::Stop( (int) aArgs[0].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PathFollowEnd )
+
+    void PathFollowIndex( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CPathFollower::GetPath( (int) aArgs[0].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PathFollowIndex )
+  }
+
+  void CPathFollower::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+    CPathSampler::RegisterGMFunctions();
+
+    GMAPI_GMFUNCTION_REGISTER( "path_follow_start", 5, PathFollowStart );
+    GMAPI_GMFUNCTION_REGISTER( "path_follow_step", 1, PathFollowStep );
+    GMAPI_GMFUNCTION_REGISTER( "path_follow_end", 1, PathFollowEnd );
+    GMAPI_GMFUNCTION_REGISTER( "path_follow_index", 1, PathFollowIndex );
+  }
+
+#endif
+
+}
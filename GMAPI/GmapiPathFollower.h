@@ -0,0 +1,150 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathFollower.h                                                 */
+/*   - Native movement of instances along paths                         */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiDefs.h"
+#include "GmapiPathSampler.h"
+
+#include <map>
+
+namespace gm {
+
+  /// CPathFollower
+  ///   Moves instances along paths natively, in one pass over the room's
+  ///   instances, instead of the runner's per-instance path handling.
+  ///   Positions are sampled from CPathSampler.
+  ///
+  ///   The state of a follower is kept in the instance's path_position,
+  ///   path_positionprevious, path_speed, path_scale, path_orientation and
+  ///   path_endaction variables, so it can be read and changed from GML
+  ///   as usual. The followed path and the origin are kept natively; the
+  ///   instance's path_index stays -1, otherwise the runner would move the
+  ///   instance as well.
+  ///
+  ///   Moving an instance stores its old position in xprevious and
+  ///   yprevious and computes its bbox_* variables from the mask (or the
+  ///   sprite), scale and angle, so collision functions called later in
+  ///   the step see the new position.
+  ///
+  ///   Must be used from the main thread only.
+  ///
+  class CPathFollower {
+    public:
+      /// Values of path_endaction, like the path_action_* constants
+      enum EndAction { EA_STOP, EA_RESTART, EA_CONTINUE, EA_REVERSE };
+
+      /// Start( int aObject, int aPath, double aSpeed, int aEndAction, bool aAbsolute )
+      ///   Starts following the path by all instances matching aObject
+      ///   (object, instance or all), like path_start does for a single
+      ///   instance. Instances already following a path switch to the new
+      ///   one.
+      ///
+      /// Returns:
+      ///   Number of instances that started following the path.
+      ///
+      static int Start( int aObject, int aPath, double aSpeed, int aEndAction, bool aAbsolute );
+
+      /// Step( int aObject )
+      ///   Advances all following instances matching aObject by their
+      ///   path_speed and updates their x, y and direction. Instances
+      ///   reaching the end of the path with the stop action stop
+      ///   following it. Should be called once per step, e.g. in the
+      ///   begin step event of a controller object.
+      ///
+      /// Returns:
+      ///   Number of instances moved.
+      ///
+      static int Step( int aObject );
+
+      /// Stop( int aObject )
+      ///   Stops following by all instances matching aObject; they keep
+      ///   their current position.
+      ///
+      /// Returns:
+      ///   Number of instances stopped.
+      ///
+      static int Stop( int aObject );
+
+      /// GetPath( int aInstanceId )
+      ///   Returns the path followed by the instance, or -1.
+      ///
+      static int GetPath( int aInstanceId );
+
+      static int GetCount() {
+        return (int) m_followers.size();
+      }
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers CPathSampler functions and the following GML
+      ///   functions:
+      ///     path_follow_start( obj, path, speed, endaction, absolute ) -
+      ///       returns number of instances started
+      ///     path_follow_step( obj ) - returns number of instances moved
+      ///     path_follow_end( obj ) - returns number of instances stopped
+      ///     path_follow_index( id ) - returns the followed path or -1
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      struct FOLLOWER {
+        int path;
+        double originX;   // Room position of the path's first point
+        double originY;
+      };
+
+      // Sampled path with its end points, shared by the instances
+      // following it during a step
+      struct PATHINFO {
+        const CPathSampler* sampler;
+        double startX;
+        double startY;
+        double endX;
+        double endY;
+      };
+
+      typedef std::map<int, FOLLOWER> FollowerMap;
+
+      static const PATHINFO& GetPathInfo( std::map<int, PATHINFO>& aPaths, int aPath );
+
+      // Instance structures of GM6.1/7 and GM8 have the same members, so
+      // the functions are written once for both
+      template <class T>
+      static void Place( T& aInstance, const FOLLOWER& aFollower, const PATHINFO& aPath );
+
+      template <class T>
+      static bool Advance( T& aInstance, FOLLOWER& aFollower, const PATHINFO& aPath );
+
+      template <class T>
+      static void UpdateBoundingBox( T& aInstance );
+
+      static void RemoveMissing( PGMINSTANCE* aInstances, int aCount );
+
+      static FollowerMap m_followers;
+  };
+
+}
@@ -0,0 +1,689 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathHierarchy.cpp                                              */
+/*   - Hierarchical path finding (HPA*) on mp_grids                     */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiPathHierarchy.h"
+#include "GmapiMacros.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+namespace gm {
+
+  CDSRegistry<CPathHierarchy> CPathHierarchy::m_hierarchies;
+
+  namespace {
+    static const int MIN_CLUSTER_SIZE = 4;
+    static const int MAX_CLUSTER_SIZE = 128;
+    // Entrances at least this long get a node at each end instead of one
+    // node in the middle
+    static const int LONG_ENTRANCE = 6;
+
+    static const float DIAGONAL_COST = 1.41421356f;
+    static const float UNREACHABLE_COST = 3.0e38f;
+
+    static const int MOVES[8][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 },
+                                     { 1, 1 }, { -1, 1 }, { -1, -1 }, { 1, -1 } };
+
+    struct OpenNodeGreater {
+      template <class T>
+      bool operator()( const T& aFirst, const T& aSecond ) const {
+        return ( aFirst.f > aSecond.f );
+      }
+    };
+  }
+
+  /************************************************************************/
+  /* CPathHierarchy::CGridListener class implementation                   */
+  /************************************************************************/
+
+  class CPathHierarchy::CGridListener: public CMotionGridListener {
+    public:
+      virtual void OnCellsChanged( const CMotionGrid& aGrid, int aLeft, int aTop, int aRight, int aBottom ) {
+        for ( int i = 0; i < m_hierarchies.GetSize(); i++ ) {
+          CPathHierarchy* hierarchy = m_hierarchies.Find( i );
+
+          if ( hierarchy && hierarchy->m_grid == &aGrid )
+            hierarchy->CellsChanged( aLeft, aTop, aRight, aBottom );
+        }
+      }
+
+      virtual void OnGridDestroyed( const CMotionGrid& aGrid ) {
+        for ( int i = 0; i < m_hierarchies.GetSize(); i++ ) {
+          CPathHierarchy* hierarchy = m_hierarchies.Find( i );
+
+          if ( hierarchy && hierarchy->m_grid == &aGrid ) {
+            hierarchy->Update();
+            hierarchy->m_grid = NULL;
+          }
+        }
+      }
+  };
+
+  /************************************************************************/
+  /* CPathHierarchy class implementation                                  */
+  /************************************************************************/
+
+  CPathHierarchy::CPathHierarchy( const CMotionGrid& aGrid, int aClusterSize, bool aDiagonal ):
+    m_gridId( aGrid.GetID() ), m_grid( &aGrid ),
+    m_width( aGrid.GetHorizontalCells() ), m_height( aGrid.GetVerticalCells() ),
+    m_left( aGrid.GetLeft() ), m_top( aGrid.GetTop() ),
+    m_cellWidth( aGrid.GetCellWidth() ), m_cellHeight( aGrid.GetCellHeight() ),
+    m_diagonal( aDiagonal ),
+    m_clusterSize( std::min( std::max( aClusterSize, MIN_CLUSTER_SIZE ), MAX_CLUSTER_SIZE ) ),
+    m_changed( true ), m_searchLeft( 0 ), m_searchTop( 0 ), m_searchRight( 0 ), m_searchBottom( 0 ),
+    m_searchGoal( -1 ), m_search( 0 ) {
+    m_clustersH = ( m_width + m_clusterSize - 1 ) / m_clusterSize;
+    m_clustersV = ( m_height + m_clusterSize - 1 ) / m_clusterSize;
+
+    m_free.resize( m_width * m_height, 0 );
+    m_nodeIndex.resize( m_width * m_height, -1 );
+    m_borders.resize( m_clustersH * m_clustersV * 2 );
+    m_clusterNodes.resize( m_clustersH * m_clustersV );
+    m_dirty.resize( m_clustersH * m_clustersV, 1 );
+
+    Update();
+  }
+
+  int CPathHierarchy::Create( int aGridId, int aClusterSize, bool aDiagonal ) {
+    // One listener serves all hierarchies; it is never removed, so it does
+    // not depend on the order of destruction of static objects
+    static CGridListener listener;
+    CMotionGrid::AddListener( &listener );
+
+    return m_hierarchies.Add( new CPathHierarchy( CMotionGrid::Get( aGridId ), aClusterSize, aDiagonal ) );
+  }
+
+  bool CPathHierarchy::Destroy( int aId ) {
+    return m_hierarchies.Remove( aId );
+  }
+
+  void CPathHierarchy::CellsChanged( int aLeft, int aTop, int aRight, int aBottom ) {
+    for ( int cv = aTop / m_clusterSize; cv <= aBottom / m_clusterSize; cv++ ) {
+      for ( int ch = aLeft / m_clusterSize; ch <= aRight / m_clusterSize; ch++ )
+        m_dirty[cv * m_clustersH + ch] = 1;
+    }
+
+    m_changed = true;
+  }
+
+  void CPathHierarchy::Update() {
+    if ( !m_changed )
+      return;
+
+    m_changed = false;
+
+    int clusterCount = m_clustersH * m_clustersV;
+    std::vector<unsigned char> rebuild( clusterCount, 0 );
+
+    for ( int c = 0; c < clusterCount; c++ ) {
+      if ( !m_dirty[c] || !m_grid )
+        continue;
+
+      int left, top, right, bottom;
+      GetClusterBounds( c, left, top, right, bottom );
+
+      for ( int v = top; v <= bottom; v++ ) {
+        for ( int h = left; h <= right; h++ )
+          m_free[v * m_width + h] = ( m_grid->IsCellForbidden( h, v ) ? 0 : 1 );
+      }
+    }
+
+    // Borders of the changed clusters change the nodes of the clusters on
+    // both sides
+    for ( int c = 0; c < clusterCount; c++ ) {
+      if ( !m_dirty[c] )
+        continue;
+
+      int ch = c % m_clustersH, cv = c / m_clustersH;
+
+      BuildBorder( c, false );
+      BuildBorder( c, true );
+      rebuild[c] = 1;
+
+      if ( ch > 0 ) {
+        if ( !m_dirty[c - 1] )
+          BuildBorder( c - 1, false );
+        rebuild[c - 1] = 1;
+      }
+
+      if ( cv > 0 ) {
+        if ( !m_dirty[c - m_clustersH] )
+          BuildBorder( c - m_clustersH, true );
+        rebuild[c - m_clustersH] = 1;
+      }
+
+      if ( ch + 1 < m_clustersH )
+        rebuild[c + 1] = 1;
+      if ( cv + 1 < m_clustersV )
+        rebuild[c + m_clustersH] = 1;
+    }
+
+    for ( int c = 0; c < clusterCount; c++ ) {
+      if ( rebuild[c] )
+        BuildCluster( c );
+
+      m_dirty[c] = 0;
+    }
+  }
+
+  bool CPathHierarchy::FindPath( int aStartH, int aStartV, int aGoalH, int aGoalV, std::vector<GRIDCELL>& aCells ) {
+    aCells.clear();
+    Update();
+
+    if ( aStartH < 0 || aStartV < 0 || aStartH >= m_width || aStartV >= m_height ||
+         aGoalH < 0 || aGoalV < 0 || aGoalH >= m_width || aGoalV >= m_height )
+      return false;
+
+    int start = aStartV * m_width + aStartH;
+    int goal = aGoalV * m_width + aGoalH;
+
+    if ( !m_free[start] || !m_free[goal] )
+      return false;
+
+    GRIDCELL startCell = { aStartH, aStartV };
+    int startCluster = GetCluster( start ), goalCluster = GetCluster( goal );
+    float directCost = UNREACHABLE_COST;
+
+    // The abstract graph crosses borders only at the entrances, so cells
+    // of the same or adjacent clusters are first searched directly inside
+    // the bounds of both clusters
+    if ( abs( startCluster % m_clustersH - goalCluster % m_clustersH ) <= 1 &&
+         abs( startCluster / m_clustersH - goalCluster / m_clustersH ) <= 1 ) {
+      int left1, top1, right1, bottom1, left2, top2, right2, bottom2;
+
+      GetClusterBounds( startCluster, left1, top1, right1, bottom1 );
+      GetClusterBounds( goalCluster, left2, top2, right2, bottom2 );
+      SearchRegion( std::min( left1, left2 ), std::min( top1, top2 ),
+                    std::max( right1, right2 ), std::max( bottom1, bottom2 ), start, goal );
+
+      directCost = GetClusterCost( goal );
+
+      if ( directCost < UNREACHABLE_COST ) {
+        aCells.push_back( startCell );
+        AddClusterPath( goal, aCells );
+
+        // No path can be shorter than the estimate
+        if ( directCost <= Estimate( start ) + 1e-3f )
+          return true;
+      }
+    }
+
+    std::vector<LINK> startLinks, goalLinks;
+    LinkCell( start, startLinks );
+    LinkCell( goal, goalLinks );
+
+    // Search the abstract graph; index m_nodes.size() stands for the goal
+    int goalIndex = (int) m_nodes.size();
+    int index;
+    float g;
+
+    Prepare( m_nodes.size() + 1 );
+    m_searchGoal = goal;
+
+    for ( size_t i = 0; i < startLinks.size(); i++ )
+      Relax( startLinks[i].node, -1, startLinks[i].cost, Estimate( m_nodes[startLinks[i].node].cell ) );
+
+    bool found = false;
+
+    while ( Pop( index, g ) ) {
+      // Only paths shorter than the direct one are of interest
+      if ( g >= directCost )
+        break;
+
+      if ( index == goalIndex ) {
+        found = true;
+        break;
+      }
+
+      const NODE& node = m_nodes[index];
+
+      for ( size_t i = 0; i < node.edges.size(); i++ ) {
+        int target = m_nodeIndex[node.edges[i].cell];
+
+        if ( target >= 0 )
+          Relax( target, index, g + node.edges[i].cost, Estimate( node.edges[i].cell ) );
+      }
+
+      for ( size_t i = 0; i < goalLinks.size(); i++ ) {
+        if ( goalLinks[i].node == index )
+          Relax( goalIndex, index, g + goalLinks[i].cost, 0.0f );
+      }
+    }
+
+    if ( !found )
+      return ( directCost < UNREACHABLE_COST );
+
+    std::vector<int> route;
+    route.push_back( goal );
+
+    for ( index = m_parent[goalIndex]; index >= 0; index = m_parent[index] )
+      route.push_back( m_nodes[index].cell );
+
+    route.push_back( start );
+    std::reverse( route.begin(), route.end() );
+
+    // Refine the route; consecutive nodes either lie on both sides of
+    // a border or are connected inside their cluster
+    aCells.assign( 1, startCell );
+
+    for ( size_t i = 1; i < route.size(); i++ ) {
+      int from = route[i - 1], to = route[i];
+
+      if ( from == to )
+        continue;
+
+      if ( GetCluster( from ) != GetCluster( to ) ) {
+        GRIDCELL cell = { to % m_width, to / m_width };
+        aCells.push_back( cell );
+      } else {
+        SearchCluster( GetCluster( from ), from, to );
+        AddClusterPath( to, aCells );
+      }
+    }
+
+    return true;
+  }
+
+  bool CPathHierarchy::FindPath( int aPathIndex, double aStartX, double aStartY, double aGoalX, double aGoalY ) {
+    std::vector<GRIDCELL> cells;
+
+    if ( !FindPath( (int) floor( ( aStartX - m_left ) / m_cellWidth ), (int) floor( ( aStartY - m_top ) / m_cellHeight ),
+                    (int) floor( ( aGoalX - m_left ) / m_cellWidth ), (int) floor( ( aGoalY - m_top ) / m_cellHeight ),
+                    cells ) )
+      return false;
+
+    CPathFinder::WritePath( aPathIndex, m_left, m_top, m_cellWidth, m_cellHeight, cells,
+                            aStartX, aStartY, aGoalX, aGoalY );
+    return true;
+  }
+
+  void CPathHierarchy::GetClusterBounds( int aCluster, int& aLeft, int& aTop, int& aRight, int& aBottom ) const {
+    aLeft = ( aCluster % m_clustersH ) * m_clusterSize;
+    aTop = ( aCluster / m_clustersH ) * m_clusterSize;
+    aRight = std::min( aLeft + m_clusterSize, m_width ) - 1;
+    aBottom = std::min( aTop + m_clusterSize, m_height ) - 1;
+  }
+
+  void CPathHierarchy::BuildBorder( int aCluster, bool aBottom ) {
+    std::vector<TRANSITION>& border = m_borders[aCluster * 2 + ( aBottom ? 1 : 0 )];
+    int left, top, right, bottom;
+    int first, step, length, across;
+
+    border.clear();
+    GetClusterBounds( aCluster, left, top, right, bottom );
+
+    if ( aBottom ) {
+      if ( bottom + 1 >= m_height )
+        return;
+
+      first = bottom * m_width + left;
+      step = 1;
+      length = right - left + 1;
+      across = m_width;
+    } else {
+      if ( right + 1 >= m_width )
+        return;
+
+      first = top * m_width + right;
+      step = m_width;
+      length = bottom - top + 1;
+      across = 1;
+    }
+
+    // Each run of cells free on both sides is one entrance
+    int runStart = -1;
+
+    for ( int i = 0; i <= length; i++ ) {
+      int cell = first + i * step;
+      bool open = ( i < length && m_free[cell] && m_free[cell + across] );
+
+      if ( open && runStart < 0 )
+        runStart = i;
+      else if ( !open && runStart >= 0 ) {
+        int runEnd = i - 1;
+        TRANSITION transition;
+
+        if ( runEnd - runStart + 1 < LONG_ENTRANCE ) {
+          transition.first = first + ( runStart + runEnd ) / 2 * step;
+          transition.second = transition.first + across;
+          border.push_back( transition );
+        } else {
+          transition.first = first + runStart * step;
+          transition.second = transition.first + across;
+          border.push_back( transition );
+
+          transition.first = first + runEnd * step;
+          transition.second = transition.first + across;
+          border.push_back( transition );
+        }
+
+        runStart = -1;
+      }
+    }
+  }
+
+  void CPathHierarchy::BuildCluster( int aCluster ) {
+    std::vector<int>& nodes = m_clusterNodes[aCluster];
+
+    for ( size_t i = 0; i < nodes.size(); i++ ) {
+      m_nodeIndex[m_nodes[nodes[i]].cell] = -1;
+      m_nodes[nodes[i]].edges.clear();
+      m_freeNodes.push_back( nodes[i] );
+    }
+
+    nodes.clear();
+
+    // Nodes and edges across the borders; edges point to cells, so they
+    // stay valid while the neighbouring clusters are rebuilt
+    int ch = aCluster % m_clustersH, cv = aCluster / m_clustersH;
+    EDGE edge;
+    edge.cost = 1.0f;
+
+    for ( int side = 0; side < 4; side++ ) {
+      const std::vector<TRANSITION>* border;
+      bool own;
+
+      switch ( side ) {
+        case 0: border = &m_borders[aCluster * 2]; own = true; break;
+        case 1: border = &m_borders[aCluster * 2 + 1]; own = true; break;
+        case 2: border = ( ch > 0 ? &m_borders[( aCluster - 1 ) * 2] : NULL ); own = false; break;
+        default: border = ( cv > 0 ? &m_borders[( aCluster - m_clustersH ) * 2 + 1] : NULL ); own = false; break;
+      }
+
+      if ( !border )
+        continue;
+
+      for ( size_t i = 0; i < border->size(); i++ ) {
+        const TRANSITION& transition = (*border)[i];
+
+        edge.cell = ( own ? transition.second : transition.first );
+        m_nodes[AddNode( aCluster, own ? transition.first : transition.second )].edges.push_back( edge );
+      }
+    }
+
+    // Edges inside the cluster; distances are symmetric, so each pair of
+    // nodes is searched once
+    for ( size_t i = 0; i + 1 < nodes.size(); i++ ) {
+      SearchCluster( aCluster, m_nodes[nodes[i]].cell, -1 );
+
+      for ( size_t j = i + 1; j < nodes.size(); j++ ) {
+        float cost = GetClusterCost( m_nodes[nodes[j]].cell );
+
+        if ( cost < UNREACHABLE_COST ) {
+          edge.cost = cost;
+          edge.cell = m_nodes[nodes[j]].cell;
+          m_nodes[nodes[i]].edges.push_back( edge );
+
+          edge.cell = m_nodes[nodes[i]].cell;
+          m_nodes[nodes[j]].edges.push_back( edge );
+        }
+      }
+    }
+  }
+
+  int CPathHierarchy::AddNode( int aCluster, int aCell ) {
+    if ( m_nodeIndex[aCell] >= 0 )
+      return m_nodeIndex[aCell];
+
+    int index;
+
+    if ( !m_freeNodes.empty() ) {
+      index = m_freeNodes.back();
+      m_freeNodes.pop_back();
+    } else {
+      index = (int) m_nodes.size();
+      m_nodes.push_back( NODE() );
+    }
+
+    m_nodes[index].cell = aCell;
+    m_nodeIndex[aCell] = index;
+    m_clusterNodes[aCluster].push_back( index );
+
+    return index;
+  }
+
+  void CPathHierarchy::SearchCluster( int aCluster, int aStart, int aGoal ) {
+    int left, top, right, bottom;
+
+    GetClusterBounds( aCluster, left, top, right, bottom );
+    SearchRegion( left, top, right, bottom, aStart, aGoal );
+  }
+
+  void CPathHierarchy::SearchRegion( int aLeft, int aTop, int aRight, int aBottom, int aStart, int aGoal ) {
+    m_searchLeft = aLeft;
+    m_searchTop = aTop;
+    m_searchRight = aRight;
+    m_searchBottom = aBottom;
+    m_searchGoal = aGoal;
+
+    int rowLength = m_searchRight - m_searchLeft + 1;
+    int moveCount = ( m_diagonal ? 8 : 4 );
+    int index;
+    float g;
+
+    Prepare( rowLength * ( m_searchBottom - m_searchTop + 1 ) );
+
+    int startH = aStart % m_width, startV = aStart / m_width;
+    Relax( ( startV - m_searchTop ) * rowLength + ( startH - m_searchLeft ), -1, 0.0f, Estimate( aStart ) );
+
+    while ( Pop( index, g ) ) {
+      int h = m_searchLeft + index % rowLength, v = m_searchTop + index / rowLength;
+
+      if ( v * m_width + h == aGoal )
+        return;
+
+      for ( int i = 0; i < moveCount; i++ ) {
+        int dh = MOVES[i][0], dv = MOVES[i][1];
+        int nh = h + dh, nv = v + dv;
+
+        if ( nh < m_searchLeft || nv < m_searchTop || nh > m_searchRight || nv > m_searchBottom ||
+             !m_free[nv * m_width + nh] )
+          continue;
+
+        // Diagonal moves must not cut corners
+        if ( dh && dv && ( !m_free[v * m_width + nh] || !m_free[nv * m_width + h] ) )
+          continue;
+
+        Relax( index + dv * rowLength + dh, index, g + ( dh && dv ? DIAGONAL_COST : 1.0f ),
+               Estimate( nv * m_width + nh ) );
+      }
+    }
+  }
+
+  float CPathHierarchy::GetClusterCost( int aCell ) const {
+    int index = ( aCell / m_width - m_searchTop ) * ( m_searchRight - m_searchLeft + 1 ) +
+                ( aCell % m_width - m_searchLeft );
+
+    return ( m_state[index] == m_search + 1 ? m_cost[index] : UNREACHABLE_COST );
+  }
+
+  void CPathHierarchy::AddClusterPath( int aGoal, std::vector<GRIDCELL>& aCells ) const {
+    int rowLength = m_searchRight - m_searchLeft + 1;
+    int index = ( aGoal / m_width - m_searchTop ) * rowLength + ( aGoal % m_width - m_searchLeft );
+    size_t first = aCells.size();
+
+    // The start cell is already in aCells
+    for ( ; m_parent[index] >= 0; index = m_parent[index] ) {
+      GRIDCELL cell = { m_searchLeft + index % rowLength, m_searchTop + index / rowLength };
+      aCells.push_back( cell );
+    }
+
+    std::reverse( aCells.begin() + first, aCells.end() );
+  }
+
+  void CPathHierarchy::LinkCell( int aCell, std::vector<LINK>& aLinks ) {
+    int cluster = GetCluster( aCell );
+    const std::vector<int>& nodes = m_clusterNodes[cluster];
+
+    SearchCluster( cluster, aCell, -1 );
+
+    for ( size_t i = 0; i < nodes.size(); i++ ) {
+      LINK link;
+      link.node = nodes[i];
+      link.cost = GetClusterCost( m_nodes[nodes[i]].cell );
+
+      if ( link.cost < UNREACHABLE_COST )
+        aLinks.push_back( link );
+    }
+  }
+
+  float CPathHierarchy::Estimate( int aCell ) const {
+    if ( m_searchGoal < 0 )
+      return 0.0f;
+
+    int dh = abs( aCell % m_width - m_searchGoal % m_width );
+    int dv = abs( aCell / m_width - m_searchGoal / m_width );
+
+    if ( !m_diagonal )
+      return (float) ( dh + dv );
+
+    return ( dh > dv ? ( dh - dv ) + dv * DIAGONAL_COST : ( dv - dh ) + dh * DIAGONAL_COST );
+  }
+
+  void CPathHierarchy::Prepare( size_t aSize ) {
+    if ( m_state.size() < aSize ) {
+      m_cost.resize( aSize );
+      m_parent.resize( aSize );
+      m_state.resize( aSize, 0 );
+    }
+
+    m_search += 2;
+    if ( m_search < 2 ) {
+      std::fill( m_state.begin(), m_state.end(), 0 );
+      m_search = 2;
+    }
+
+    m_open.clear();
+  }
+
+  void CPathHierarchy::Relax( int aIndex, int aParent, float aG, float aEstimate ) {
+    if ( m_state[aIndex] == m_search + 1 )
+      return;
+    if ( m_state[aIndex] == m_search && m_cost[aIndex] <= aG )
+      return;
+
+    m_state[aIndex] = m_search;
+    m_cost[aIndex] = aG;
+    m_parent[aIndex] = aParent;
+
+    OPENNODE node;
+    node.f = aG + aEstimate;
+    node.g = aG;
+    node.index = aIndex;
+
+    m_open.push_back( node );
+    std::push_heap( m_open.begin(), m_open.end(), OpenNodeGreater() );
+  }
+
+  bool CPathHierarchy::Pop( int& aIndex, float& aG ) {
+    while ( !m_open.empty() ) {
+      std::pop_heap( m_open.begin(), m_open.end(), OpenNodeGreater() );
+      OPENNODE node = m_open.back();
+      m_open.pop_back();
+
+      // Skip nodes that have been expanded or reached by a shorter path
+      // after they were pushed
+      if ( m_state[node.index] != m_search || node.g > m_cost[node.index] )
+        continue;
+
+      m_state[node.index] = m_search + 1;
+      aIndex = node.index;
+      aG = node.g;
+      return true;
+    }
+
+    return false;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void MpGridHpaCreate( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( -1.0 );
+
+      try {
+        aResult->Set( (double) CPathHierarchy::Create( (int) aArgs[0].real, (int) aArgs[1].real,
+                                                       aArgs[2].real >= 0.5 ) );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridHpaCreate )
+
+    void MpGridHpaDestroy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      CPathHierarchy::Destroy( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridHpaDestroy )
+
+    void MpGridHpaPath( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      try {
+        aResult->Set( CPathHierarchy::Get( (int) aArgs[0].real ).FindPath( (int) aArgs[1].real, aArgs[2].real,
+                                                                         aArgs[3].real, aArgs[4].real,
+                                                                         aArgs[5].real ) ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridHpaPath )
+
+    void MpGridHpaNodes( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      try {
+        CPathHierarchy& hierarchy = CPathHierarchy::Get( (int) aArgs[0].real );
+
+        hierarchy.Update();
+        aResult->Set( (double) hierarchy.GetNodeCount() );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridHpaNodes )
+  }
+
+  void CPathHierarchy::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+    CMotionGrid::RegisterGMFunctions();
+
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_hpa_create", 3, MpGridHpaCreate );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_hpa_destroy", 1, MpGridHpaDestroy );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_hpa_path", 6, MpGridHpaPath );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_hpa_nodes", 1, MpGridHpaNodes );
+  }
+
+#endif
+
+}
@@ -0,0 +1,248 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathHierarchy.h                                                */
+/*   - Hierarchical path finding (HPA*) on mp_grids                     */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiPathFinder.h"
+#include "GmapiDSCommon.h"
+
+#include <vector>
+
+namespace gm {
+
+  /// CPathHierarchy
+  ///   Abstraction of a mirrored grid for hierarchical path finding. The
+  ///   grid is divided into square clusters; free cells on both sides of
+  ///   a cluster border form entrances, which are the nodes of an abstract
+  ///   graph. The graph connects nodes across the borders and nodes of
+  ///   the same cluster by their distance inside the cluster.
+  ///
+  ///   A query connects the start and the goal to the nodes of their
+  ///   clusters, searches the abstract graph and refines the result by
+  ///   searches limited to single clusters. When the start and the goal
+  ///   lie in the same or adjacent clusters, the cells of these clusters
+  ///   are searched directly first, and the abstract graph is used only
+  ///   if it gives a shorter path. Paths follow the rules of mp_grid_path,
+  ///   but are not always the shortest ones; between distant clusters they
+  ///   cross cluster borders only by straight moves.
+  ///
+  ///   Changes of the grid are collected and applied by Update, which is
+  ///   called by FindPath. Only the changed clusters and their neighbours
+  ///   are rebuilt. When the grid is destroyed, the hierarchy keeps its
+  ///   last state.
+  ///
+  class CPathHierarchy {
+    public:
+      /// Ctor( const CMotionGrid& aGrid, int aClusterSize, bool aDiagonal )
+      ///   Builds the hierarchy of the grid; aClusterSize is clamped to
+      ///   range <4; 128>.
+      ///
+      CPathHierarchy( const CMotionGrid& aGrid, int aClusterSize, bool aDiagonal );
+
+      /************************************************************************/
+      /* Hierarchy management                                                 */
+      /************************************************************************/
+
+      /// Create( int aGridId, int aClusterSize, bool aDiagonal )
+      ///   Creates new hierarchy of the grid.
+      ///
+      /// Returns:
+      ///   ID of the hierarchy.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIMotionGridNotExist if the grid is not mirrored.
+      ///
+      static int Create( int aGridId, int aClusterSize, bool aDiagonal );
+
+      /// Destroy( int aId )
+      ///   Destroys the hierarchy.
+      ///
+      /// Returns:
+      ///   False if the hierarchy did not exist.
+      ///
+      static bool Destroy( int aId );
+
+      static CPathHierarchy* Find( int aId ) {
+        return m_hierarchies.Find( aId );
+      }
+
+      /// Get( int aId )
+      ///   Returns the hierarchy with specified ID.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIDataStructureNotExist if the hierarchy does not
+      ///   exist.
+      ///
+      static CPathHierarchy& Get( int aId ) {
+        return m_hierarchies.Get( aId );
+      }
+
+      /************************************************************************/
+      /* Path finding                                                         */
+      /************************************************************************/
+
+      int GetGridID() const { return m_gridId; }
+      int GetClusterSize() const { return m_clusterSize; }
+
+      /// GetNodeCount()
+      ///   Returns number of nodes of the abstract graph.
+      ///
+      int GetNodeCount() const {
+        return (int) ( m_nodes.size() - m_freeNodes.size() );
+      }
+
+      /// Update()
+      ///   Applies changes of the grid made since the last update.
+      ///
+      void Update();
+
+      /// FindPath( int aStartH, int aStartV, int aGoalH, int aGoalV,
+      ///           std::vector<GRIDCELL>& aCells )
+      ///   Finds path between the cells and stores all cells along the
+      ///   path in aCells, including the start and the goal.
+      ///
+      /// Returns:
+      ///   False if the start or the goal cell is forbidden or no path
+      ///   exists; aCells is then empty.
+      ///
+      bool FindPath( int aStartH, int aStartV, int aGoalH, int aGoalV, std::vector<GRIDCELL>& aCells );
+
+      /// FindPath( int aPathIndex, double aStartX, double aStartY, double aGoalX, double aGoalY )
+      ///   Finds path between the points in the room and writes it to the
+      ///   path resource like mp_grid_path.
+      ///
+      /// Returns:
+      ///   False if no path has been found; the path is then not changed.
+      ///
+      bool FindPath( int aPathIndex, double aStartX, double aStartY, double aGoalX, double aGoalY );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers CMotionGrid functions and the following GML functions:
+      ///     mp_grid_hpa_create( grid, clustersize, allowdiag ) - returns ID
+      ///       of the hierarchy or -1 if the grid is not mirrored
+      ///     mp_grid_hpa_destroy( id )
+      ///     mp_grid_hpa_path( id, path, xstart, ystart, xgoal, ygoal ) -
+      ///       returns true if a path has been found
+      ///     mp_grid_hpa_nodes( id ) - returns number of abstract nodes
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      class CGridListener;
+      friend class CGridListener;
+
+      struct EDGE {
+        int cell;     // Cell of the target node
+        float cost;
+      };
+
+      struct NODE {
+        int cell;
+        std::vector<EDGE> edges;
+      };
+
+      // Pair of adjacent free cells on a cluster border
+      struct TRANSITION {
+        int first;    // Cell in the left or upper cluster
+        int second;   // Cell in the right or lower cluster
+      };
+
+      struct OPENNODE {
+        float f;
+        float g;
+        int index;
+      };
+
+      // Link of the start or the goal cell to a node of its cluster
+      struct LINK {
+        int node;
+        float cost;
+      };
+
+      int GetCluster( int aCell ) const {
+        return ( aCell / m_width / m_clusterSize ) * m_clustersH + ( aCell % m_width / m_clusterSize );
+      }
+
+      void GetClusterBounds( int aCluster, int& aLeft, int& aTop, int& aRight, int& aBottom ) const;
+      void CellsChanged( int aLeft, int aTop, int aRight, int aBottom );
+      void BuildBorder( int aCluster, bool aBottom );
+      void BuildCluster( int aCluster );
+      int AddNode( int aCluster, int aCell );
+      void SearchCluster( int aCluster, int aStart, int aGoal );
+      void SearchRegion( int aLeft, int aTop, int aRight, int aBottom, int aStart, int aGoal );
+      float GetClusterCost( int aCell ) const;
+      void AddClusterPath( int aGoal, std::vector<GRIDCELL>& aCells ) const;
+      void LinkCell( int aCell, std::vector<LINK>& aLinks );
+      float Estimate( int aCell ) const;
+      void Prepare( size_t aSize );
+      void Relax( int aIndex, int aParent, float aG, float aEstimate );
+      bool Pop( int& aIndex, float& aG );
+
+      int m_gridId;
+      const CMotionGrid* m_grid;   // NULL after the grid has been destroyed
+      int m_width;
+      int m_height;
+      double m_left;
+      double m_top;
+      double m_cellWidth;
+      double m_cellHeight;
+      bool m_diagonal;
+      int m_clusterSize;
+      int m_clustersH;
+      int m_clustersV;
+
+      std::vector<unsigned char> m_free;   // 1 for free cells
+      // Transitions of the right (2 * cluster) and the bottom border
+      // (2 * cluster + 1) of each cluster
+      std::vector< std::vector<TRANSITION> > m_borders;
+      std::vector< std::vector<int> > m_clusterNodes;
+      std::vector<NODE> m_nodes;
+      std::vector<int> m_freeNodes;
+      std::vector<int> m_nodeIndex;        // Node of each cell or -1
+
+      // Clusters changed since the last update
+      std::vector<unsigned char> m_dirty;
+      bool m_changed;
+
+      // Working memory of the searches; cells of a cluster are indexed
+      // relative to the cluster bounds. States hold the search stamp for
+      // reached and the stamp + 1 for expanded cells or nodes
+      int m_searchLeft;
+      int m_searchTop;
+      int m_searchRight;
+      int m_searchBottom;
+      int m_searchGoal;
+      std::vector<float> m_cost;
+      std::vector<int> m_parent;
+      std::vector<unsigned int> m_state;
+      std::vector<OPENNODE> m_open;
+      unsigned int m_search;
+
+      static CDSRegistry<CPathHierarchy> m_hierarchies;
+  };
+
+}
@@ -0,0 +1,363 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathSampler.cpp                                                */
+/*   - Cached arc-length sampling of path resources                     */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiPathSampler.h"
+#include "GmapiResources.h"
+#include "GmapiDSList.h"
+#include "GmapiMacros.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace gm {
+
+  CPathSampler::SamplerMap CPathSampler::m_samplers;
+
+  namespace {
+    // Range of path_set_precision
+    static const int MIN_PRECISION = 1;
+    static const int MAX_PRECISION = 8;
+
+    struct PATHPOINT {
+      double x;
+      double y;
+      double speed;
+    };
+  }
+
+  /************************************************************************/
+  /* CPathSampler class implementation                                    */
+  /************************************************************************/
+
+  CPathSampler::CPathSampler( int aPath ) {
+    if ( !path_exists( aPath ) )
+      return;
+
+    int count = path_get_number( aPath );
+    std::vector<PATHPOINT> points( count );
+
+    for ( int i = 0; i < count; i++ ) {
+      points[i].x = path_get_point_x( aPath, i );
+      points[i].y = path_get_point_y( aPath, i );
+      points[i].speed = path_get_point_speed( aPath, i );
+    }
+
+    if ( !count )
+      return;
+
+    bool closed = path_get_closed( aPath );
+
+    if ( path_get_kind( aPath ) != 1 || count < 3 ) {
+      for ( int i = 0; i < count; i++ )
+        AddPoint( points[i].x, points[i].y, points[i].speed );
+
+      if ( closed && count > 1 )
+        AddPoint( points[0].x, points[0].y, points[0].speed );
+
+      return;
+    }
+
+    int precision = std::min( std::max( path_get_precision( aPath ), MIN_PRECISION ), MAX_PRECISION );
+    int steps = 1 << precision;
+    int curves = ( closed ? count : count - 2 );
+
+    if ( !closed )
+      AddPoint( points[0].x, points[0].y, points[0].speed );
+
+    for ( int i = 0; i < curves; i++ ) {
+      const PATHPOINT& first = points[i];
+      const PATHPOINT& control = points[( i + 1 ) % count];
+      const PATHPOINT& last = points[( i + 2 ) % count];
+
+      // Curves share their end points, so only the first one adds its start
+      for ( int step = ( i == 0 ? 0 : 1 ); step <= steps; step++ ) {
+        double t = (double) step / steps;
+        // Weights of the curve start, control point and end
+        double a = 0.5 * ( 1.0 - t ) * ( 1.0 - t );
+        double b = 0.5 + t * ( 1.0 - t );
+        double c = 0.5 * t * t;
+
+        AddPoint( a * first.x + b * control.x + c * last.x,
+                  a * first.y + b * control.y + c * last.y,
+                  a * first.speed + b * control.speed + c * last.speed );
+      }
+    }
+
+    if ( !closed )
+      AddPoint( points[count - 1].x, points[count - 1].y, points[count - 1].speed );
+  }
+
+  const CPathSampler& CPathSampler::Get( int aPath ) {
+    SamplerMap::iterator it = m_samplers.find( aPath );
+
+    if ( it != m_samplers.end() )
+      return *it->second;
+
+    // Paths that do not exist are not cached, so the index can be taken by
+    // a new path without any stale copy left behind
+    if ( !path_exists( aPath ) ) {
+      static const CPathSampler empty( -1 );
+      return empty;
+    }
+
+    CPathSampler* sampler = new CPathSampler( aPath );
+    m_samplers[aPath] = sampler;
+
+    return *sampler;
+  }
+
+  void CPathSampler::Invalidate( int aPath ) {
+    SamplerMap::iterator it = m_samplers.find( aPath );
+
+    if ( it != m_samplers.end() ) {
+      delete it->second;
+      m_samplers.erase( it );
+    }
+  }
+
+  void CPathSampler::InvalidateAll() {
+    for ( SamplerMap::iterator it = m_samplers.begin(); it != m_samplers.end(); ++it )
+      delete it->second;
+
+    m_samplers.clear();
+  }
+
+  void CPathSampler::AddPoint( double aX, double aY, double aSpeed ) {
+    double distance = 0.0;
+
+    if ( !m_x.empty() )
+      distance = m_distance.back() + sqrt( ( aX - m_x.back() ) * ( aX - m_x.back() ) +
+                                           ( aY - m_y.back() ) * ( aY - m_y.back() ) );
+
+    m_x.push_back( aX );
+    m_y.push_back( aY );
+    m_speed.push_back( aSpeed );
+    m_distance.push_back( distance );
+  }
+
+  void CPathSampler::Sample( double aPosition, double& aX, double& aY, double& aSpeed ) const {
+    if ( m_x.empty() ) {
+      aX = aY = aSpeed = 0.0;
+      return;
+    }
+
+    double length = m_distance.back();
+
+    if ( m_x.size() == 1 || length <= 0.0 || aPosition <= 0.0 ) {
+      aX = m_x[0];
+      aY = m_y[0];
+      aSpeed = m_speed[0];
+      return;
+    }
+
+    if ( aPosition >= 1.0 ) {
+      aX = m_x.back();
+      aY = m_y.back();
+      aSpeed = m_speed.back();
+      return;
+    }
+
+    // Segment containing the position: the last point not further than it
+    double distance = aPosition * length;
+    size_t i = std::upper_bound( m_distance.begin(), m_distance.end(), distance ) - m_distance.begin() - 1;
+    double segment = m_distance[i + 1] - m_distance[i];
+    double t = ( segment > 0.0 ? ( distance - m_distance[i] ) / segment : 0.0 );
+
+    aX = m_x[i] + ( m_x[i + 1] - m_x[i] ) * t;
+    aY = m_y[i] + ( m_y[i + 1] - m_y[i] ) * t;
+    aSpeed = m_speed[i] + ( m_speed[i + 1] - m_speed[i] ) * t;
+  }
+
+  void CPathSampler::SampleMany( const double* aQueries, int aCount, double* aResults ) {
+    const CPathSampler* sampler = NULL;
+    int path = 0;
+
+    for ( int i = 0; i < aCount; i++ ) {
+      // Followers of the same path are usually grouped, so the lookup is
+      // skipped while the path does not change
+      if ( !sampler || (int) aQueries[i * 2] != path ) {
+        path = (int) aQueries[i * 2];
+        sampler = &Get( path );
+      }
+
+      sampler->Sample( aQueries[i * 2 + 1], aResults[i * 3], aResults[i * 3 + 1], aResults[i * 3 + 2] );
+    }
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  // Generates a handler that calls the intercepted function and drops the
+  // copy of the path passed as argument aPathArgument
+  #define GMAPI_PATHSAMPLER_EDIT_HANDLER( aFunction, aPathArgument ) \
+    GMFUCTION runner##aFunction = NULL;\
+    \
+    void aFunction( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,\
+                    int aArgCount, PGMVALUE aResult ) {\
+      core::RunnerCallFunction( runner##aFunction, aArgs, aArgCount, aResult );\
+      CPathSampler::Invalidate( (int) aArgs[aPathArgument].real );\
+    }\
+    \
+    GMAPI_GMFUNCTION_GENERATEHANDLER( aFunction )
+
+  // Generates a handler that calls the intercepted function and drops the
+  // copy of the path whose index it returns
+  #define GMAPI_PATHSAMPLER_CREATE_HANDLER( aFunction ) \
+    GMFUCTION runner##aFunction = NULL;\
+    \
+    void aFunction( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,\
+                    int aArgCount, PGMVALUE aResult ) {\
+      core::RunnerCallFunction( runner##aFunction, aArgs, aArgCount, aResult );\
+      CPathSampler::Invalidate( (int) aResult->real );\
+    }\
+    \
+    GMAPI_GMFUNCTION_GENERATEHANDLER( aFunction )
+
+  namespace {
+    bool functionsRegistered = false;
+
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathSetKind, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathSetClosed, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathSetPrecision, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathDelete, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathAssign, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathAppend, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathAddPoint, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathInsertPoint, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathChangePoint, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathDeletePoint, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathClearPoints, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathReverse, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathMirror, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathFlip, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathRotate, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathScale, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( PathShift, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( MpLinearPath, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( MpLinearPathObject, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( MpPotentialPath, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( MpPotentialPathObject, 0 )
+    GMAPI_PATHSAMPLER_EDIT_HANDLER( MpGridPath, 1 )
+
+    GMAPI_PATHSAMPLER_CREATE_HANDLER( PathAdd )
+    GMAPI_PATHSAMPLER_CREATE_HANDLER( PathDuplicate )
+
+    void PathGetX( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                   int aArgCount, PGMVALUE aResult ) {
+      double x, y, speed;
+
+      CPathSampler::Get( (int) aArgs[0].real ).Sample( aArgs[1].real, x, y, speed );
+      aResult->Set( x );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PathGetX )
+
+    void PathGetY( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                   int aArgCount, PGMVALUE aResult ) {
+      double x, y, speed;
+
+      CPathSampler::Get( (int) aArgs[0].real ).Sample( aArgs[1].real, x, y, speed );
+      aResult->Set( y );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PathGetY )
+
+    void PathGetSpeed( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      double x, y, speed;
+
+      CPathSampler::Get( (int) aArgs[0].real ).Sample( aArgs[1].real, x, y, speed );
+      aResult->Set( speed );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PathGetSpeed )
+
+    void PathSampleBatch( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      try {
+        const CDSList& queries = CDSList::Get( (int) aArgs[0].real );
+        CDSList& results = CDSList::Get( (int) aArgs[1].real );
+        int count = queries.GetSize() / 2;
+
+        if ( !count )
+          return;
+
+        std::vector<double> values( count * 3 );
+        CPathSampler::SampleMany( queries.GetData(), count, &values[0] );
+        results.AppendRange( &values[0], count * 3 );
+      } catch ( const EGMAPIException& e ) {
+        e.ShowError();
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( PathSampleBatch )
+  }
+
+  void CPathSampler::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+
+    runnerPathSetKind = GMAPI_GMFUNCTION_OVERRIDE( id_path_set_kind, PathSetKind );
+    runnerPathSetClosed = GMAPI_GMFUNCTION_OVERRIDE( id_path_set_closed, PathSetClosed );
+    runnerPathSetPrecision = GMAPI_GMFUNCTION_OVERRIDE( id_path_set_precision, PathSetPrecision );
+    runnerPathDelete = GMAPI_GMFUNCTION_OVERRIDE( id_path_delete, PathDelete );
+    runnerPathAssign = GMAPI_GMFUNCTION_OVERRIDE( id_path_assign, PathAssign );
+    runnerPathAppend = GMAPI_GMFUNCTION_OVERRIDE( id_path_append, PathAppend );
+    runnerPathAddPoint = GMAPI_GMFUNCTION_OVERRIDE( id_path_add_point, PathAddPoint );
+    runnerPathInsertPoint = GMAPI_GMFUNCTION_OVERRIDE( id_path_insert_point, PathInsertPoint );
+    runnerPathChangePoint = GMAPI_GMFUNCTION_OVERRIDE( id_path_change_point, PathChangePoint );
+    runnerPathDeletePoint = GMAPI_GMFUNCTION_OVERRIDE( id_path_delete_point, PathDeletePoint );
+    runnerPathClearPoints = GMAPI_GMFUNCTION_OVERRIDE( id_path_clear_points, PathClearPoints );
+    runnerPathReverse = GMAPI_GMFUNCTION_OVERRIDE( id_path_reverse, PathReverse );
+    runnerPathMirror = GMAPI_GMFUNCTION_OVERRIDE( id_path_mirror, PathMirror );
+    runnerPathFlip = GMAPI_GMFUNCTION_OVERRIDE( id_path_flip, PathFlip );
+    runnerPathRotate = GMAPI_GMFUNCTION_OVERRIDE( id_path_rotate, PathRotate );
+    runnerPathScale = GMAPI_GMFUNCTION_OVERRIDE( id_path_scale, PathScale );
+    runnerPathShift = GMAPI_GMFUNCTION_OVERRIDE( id_path_shift, PathShift );
+    runnerMpLinearPath = GMAPI_GMFUNCTION_OVERRIDE( id_mp_linear_path, MpLinearPath );
+    runnerMpLinearPathObject = GMAPI_GMFUNCTION_OVERRIDE( id_mp_linear_path_object, MpLinearPathObject );
+    runnerMpPotentialPath = GMAPI_GMFUNCTION_OVERRIDE( id_mp_potential_path, MpPotentialPath );
+    runnerMpPotentialPathObject = GMAPI_GMFUNCTION_OVERRIDE( id_mp_potential_path_object, MpPotentialPathObject );
+    // Chains to the native mp_grid_path if it has been registered before
+    runnerMpGridPath = GMAPI_GMFUNCTION_OVERRIDE( id_mp_grid_path, MpGridPath );
+    runnerPathAdd = GMAPI_GMFUNCTION_OVERRIDE( id_path_add, PathAdd );
+    runnerPathDuplicate = GMAPI_GMFUNCTION_OVERRIDE( id_path_duplicate, PathDuplicate );
+
+    GMAPI_GMFUNCTION_OVERRIDE( id_path_get_x, PathGetX );
+    GMAPI_GMFUNCTION_OVERRIDE( id_path_get_y, PathGetY );
+    GMAPI_GMFUNCTION_OVERRIDE( id_path_get_speed, PathGetSpeed );
+
+    GMAPI_GMFUNCTION_REGISTER( "path_sample_batch", 2, PathSampleBatch );
+  }
+
+#endif
+
+}
@@ -0,0 +1,115 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathSampler.h                                                  */
+/*   - Cached arc-length sampling of path resources                     */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include <map>
+#include <vector>
+
+namespace gm {
+
+  /// CPathSampler
+  ///   Native copy of a path resource as a polyline with cumulative arc
+  ///   lengths, so positions on the path can be sampled without calling
+  ///   the runner. Smooth paths (kind 1) are tessellated like the runner
+  ///   does it: each point between two others controls a quadratic curve
+  ///   between the middles of its segments, divided into 2^precision
+  ///   parts.
+  ///
+  ///   Copies are built on the first use and dropped by Invalidate, which
+  ///   is called by the path editing wrappers in GmapiResources.cpp and,
+  ///   after RegisterGMFunctions, by the GML functions that change paths.
+  ///   Must be used from the main thread only.
+  ///
+  class CPathSampler {
+    public:
+      /// Get( int aPath )
+      ///   Returns cached copy of the path, building it if needed. Paths
+      ///   that do not exist have no points and are not cached.
+      ///
+      static const CPathSampler& Get( int aPath );
+
+      /// Invalidate( int aPath )
+      ///   Drops cached copy of the path.
+      ///
+      static void Invalidate( int aPath );
+
+      /// InvalidateAll()
+      ///   Drops cached copies of all paths.
+      ///
+      static void InvalidateAll();
+
+      /// GetLength()
+      ///   Returns length of the path in pixels.
+      ///
+      double GetLength() const {
+        return ( m_distance.empty() ? 0.0 : m_distance.back() );
+      }
+
+      int GetPointCount() const {
+        return (int) m_x.size();
+      }
+
+      /// Sample( double aPosition, double& aX, double& aY, double& aSpeed )
+      ///   Computes point and speed at the relative position on the path
+      ///   (0 - start, 1 - end), like path_get_x, path_get_y and
+      ///   path_get_speed. Takes O(log n) time.
+      ///
+      void Sample( double aPosition, double& aX, double& aY, double& aSpeed ) const;
+
+      /// SampleMany( const double* aQueries, int aCount, double* aResults )
+      ///   Samples aCount pairs (path, position) from aQueries and stores
+      ///   triples (x, y, speed) to aResults.
+      ///
+      static void SampleMany( const double* aQueries, int aCount, double* aResults );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Replaces path_get_x, path_get_y and path_get_speed with the
+      ///   native versions, intercepts the GML functions that change or
+      ///   create paths and registers the following GML function:
+      ///     path_sample_batch( queries, results ) - queries is a ds_list of
+      ///       pairs path, position; triples x, y, speed are added to the
+      ///       ds_list results
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      typedef std::map<int, CPathSampler*> SamplerMap;
+
+      CPathSampler( int aPath );
+
+      void AddPoint( double aX, double aY, double aSpeed );
+
+      std::vector<double> m_x;
+      std::vector<double> m_y;
+      std::vector<double> m_speed;
+      std::vector<double> m_distance;   // Arc length from the start to the point
+
+      static SamplerMap m_samplers;
+  };
+
+}
@@ -0,0 +1,498 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathService.cpp                                                */
+/*   - Background path finding with results applied at sync points      */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiPathService.h"
+#include "GmapiPathCache.h"
+#include "GmapiMacros.h"
+
+#include <algorithm>
+
+namespace gm {
+
+  CPathService::RequestMap CPathService::m_requests;
+  CPathService::FinishedMap CPathService::m_finished;
+  std::deque<int> CPathService::m_finishedOrder;
+  CPathService::GridReferenceMap CPathService::m_gridReferences;
+  CPathService::GridMap CPathService::m_currentGrids;
+  std::vector<HANDLE> CPathService::m_threads;
+  int CPathService::m_nextId = 0;
+  unsigned int CPathService::m_sequence = 0;
+  int CPathService::m_pathBudget = 0;
+
+  CCriticalSection CPathService::m_section;
+  HANDLE CPathService::m_workEvent = NULL;
+  std::vector<CPathService::REQUEST*> CPathService::m_queue;
+  std::vector<CPathService::REQUEST*> CPathService::m_done;
+  int CPathService::m_searchBudget = 0;
+  int CPathService::m_searchesStarted = 0;
+  bool CPathService::m_stopping = false;
+
+  namespace {
+    // Finder used by Sync when there are no worker threads
+    CPathFinder mainThreadFinder;
+  }
+
+  /************************************************************************/
+  /* CPathService::CGridListener class implementation                     */
+  /************************************************************************/
+
+  class CPathService::CGridListener: public CMotionGridListener {
+    public:
+      virtual void OnCellsChanged( const CMotionGrid& aGrid, int aLeft, int aTop, int aRight, int aBottom ) {}
+
+      virtual void OnGridDestroyed( const CMotionGrid& aGrid ) {
+        GridMap::iterator it = m_currentGrids.find( aGrid.GetID() );
+
+        if ( it == m_currentGrids.end() )
+          return;
+
+        // Copies still used by requests are freed by ReleaseGrid
+        const CPathGrid* grid = it->second;
+        m_currentGrids.erase( it );
+
+        if ( m_gridReferences[grid] == 0 ) {
+          m_gridReferences.erase( grid );
+          delete grid;
+        }
+      }
+  };
+
+  /************************************************************************/
+  /* CPathService class implementation                                    */
+  /************************************************************************/
+
+  bool CPathService::RequestOrder::operator()( const REQUEST* aFirst, const REQUEST* aSecond ) const {
+    if ( aFirst->priority != aSecond->priority )
+      return ( aFirst->priority < aSecond->priority );
+
+    return ( aFirst->sequence > aSecond->sequence );
+  }
+
+  int CPathService::Start( int aThreadCount ) {
+    Stop();
+
+    if ( aThreadCount <= 0 )
+      aThreadCount = std::max( CCpuInfo::GetProcessorCount() - 1, 1 );
+
+    if ( !m_workEvent )
+      m_workEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+
+    for ( int i = 0; i < aThreadCount; i++ ) {
+      HANDLE thread = CreateThread( NULL, 0, WorkerProc, NULL, 0, NULL );
+
+      if ( thread )
+        m_threads.push_back( thread );
+    }
+
+    CCriticalSectionLock lock( m_section );
+    if ( !m_queue.empty() )
+      SetEvent( m_workEvent );
+
+    return (int) m_threads.size();
+  }
+
+  void CPathService::Stop() {
+    if ( m_threads.empty() )
+      return;
+
+    {
+      CCriticalSectionLock lock( m_section );
+      m_stopping = true;
+      SetEvent( m_workEvent );
+    }
+
+    for ( size_t i = 0; i < m_threads.size(); i++ ) {
+      WaitForSingleObject( m_threads[i], INFINITE );
+      CloseHandle( m_threads[i] );
+    }
+
+    m_threads.clear();
+
+    CCriticalSectionLock lock( m_section );
+    m_stopping = false;
+    ResetEvent( m_workEvent );
+  }
+
+  int CPathService::Submit( int aGridId, int aPathIndex, double aStartX, double aStartY,
+                            double aGoalX, double aGoalY, bool aDiagonal, int aPriority ) {
+    const CPathGrid* grid = AcquireGrid( CMotionGrid::Get( aGridId ) );
+
+    REQUEST* request = new REQUEST();
+    request->id = m_nextId++;
+    request->priority = aPriority;
+    request->sequence = m_sequence++;
+    request->grid = grid;
+    request->pathIndex = aPathIndex;
+    request->startX = aStartX;
+    request->startY = aStartY;
+    request->goalX = aGoalX;
+    request->goalY = aGoalY;
+    request->diagonal = aDiagonal;
+    request->state = RQ_QUEUED;
+    request->found = false;
+
+    grid->CellFromPoint( aStartX, aStartY, request->startH, request->startV );
+    grid->CellFromPoint( aGoalX, aGoalY, request->goalH, request->goalV );
+
+    request->cached = CPathCache::Find( aGridId, request->startH, request->startV, request->goalH,
+                                        request->goalV, aDiagonal, request->cells, request->found );
+
+    m_requests[request->id] = request;
+
+    CCriticalSectionLock lock( m_section );
+
+    // Cached results skip the queue and are delivered by the next Sync
+    if ( request->cached ) {
+      request->state = RQ_DONE;
+      m_done.push_back( request );
+      return request->id;
+    }
+
+    m_queue.push_back( request );
+    std::push_heap( m_queue.begin(), m_queue.end(), RequestOrder() );
+
+    if ( m_workEvent )
+      SetEvent( m_workEvent );
+
+    return request->id;
+  }
+
+  bool CPathService::Cancel( int aRequestId ) {
+    RequestMap::iterator it = m_requests.find( aRequestId );
+    if ( it == m_requests.end() )
+      return false;
+
+    // Cancelled requests are skipped by the workers or discarded when
+    // their search finishes; Sync frees them
+    CCriticalSectionLock lock( m_section );
+    if ( it->second->state != RQ_QUEUED && it->second->state != RQ_SEARCHING )
+      return false;
+
+    it->second->state = RQ_CANCELLED;
+    return true;
+  }
+
+  int CPathService::Sync() {
+    std::vector<REQUEST*> done;
+
+    {
+      CCriticalSectionLock lock( m_section );
+      m_searchesStarted = 0;
+
+      if ( m_threads.empty() ) {
+        while ( REQUEST* request = TakeRequest() ) {
+          Search( mainThreadFinder, request );
+          request->state = ( request->state == RQ_CANCELLED ? RQ_CANCELLED : RQ_DONE );
+          m_done.push_back( request );
+        }
+      } else if ( !m_queue.empty() )
+        SetEvent( m_workEvent );
+
+      // Take the finished requests up to the budget; cancelled requests
+      // do not count
+      size_t taken = 0;
+      int counted = 0;
+
+      for ( ; taken < m_done.size(); taken++ ) {
+        if ( m_done[taken]->state != RQ_CANCELLED ) {
+          if ( m_pathBudget > 0 && counted >= m_pathBudget )
+            break;
+
+          counted++;
+        }
+      }
+
+      done.assign( m_done.begin(), m_done.begin() + taken );
+      m_done.erase( m_done.begin(), m_done.begin() + taken );
+    }
+
+    int finished = 0;
+
+    for ( size_t i = 0; i < done.size(); i++ ) {
+      REQUEST* request = done[i];
+
+      if ( request->state == RQ_CANCELLED ) {
+        Finish( request, RS_UNKNOWN );
+        continue;
+      }
+
+      // Results found on an older copy of the grid are not cached
+      const CMotionGrid* grid = CMotionGrid::Find( request->grid->GetGridID() );
+
+      if ( !request->cached && grid && grid->GetVersion() == request->grid->GetVersion() )
+        CPathCache::Store( grid->GetID(), request->startH, request->startV, request->goalH,
+                           request->goalV, request->diagonal, request->cells, request->found );
+
+      if ( request->found && request->pathIndex >= 0 )
+        CPathFinder::WritePath( request->pathIndex, *request->grid, request->cells,
+                                request->startX, request->startY, request->goalX, request->goalY );
+
+      Finish( request, request->found ? RS_FOUND : RS_NOT_FOUND );
+      finished++;
+    }
+
+    return finished;
+  }
+
+  void CPathService::SetBudget( int aSearchesPerSync, int aPathsPerSync ) {
+    m_pathBudget = std::max( aPathsPerSync, 0 );
+
+    CCriticalSectionLock lock( m_section );
+    m_searchBudget = std::max( aSearchesPerSync, 0 );
+
+    if ( m_workEvent && !m_queue.empty() )
+      SetEvent( m_workEvent );
+  }
+
+  CPathService::RequestStatus CPathService::GetStatus( int aRequestId ) {
+    RequestMap::iterator it = m_requests.find( aRequestId );
+
+    if ( it != m_requests.end() ) {
+      CCriticalSectionLock lock( m_section );
+      return ( it->second->state == RQ_CANCELLED ? RS_UNKNOWN : RS_PENDING );
+    }
+
+    FinishedMap::iterator finished = m_finished.find( aRequestId );
+    return ( finished != m_finished.end() ? finished->second.status : RS_UNKNOWN );
+  }
+
+  bool CPathService::GetCells( int aRequestId, std::vector<GRIDCELL>& aCells ) {
+    FinishedMap::iterator it = m_finished.find( aRequestId );
+
+    if ( it == m_finished.end() || it->second.cells.empty() )
+      return false;
+
+    aCells = it->second.cells;
+    return true;
+  }
+
+  DWORD WINAPI CPathService::WorkerProc( LPVOID aParameter ) {
+    CPathFinder finder;
+
+    for ( ;; ) {
+      WaitForSingleObject( m_workEvent, INFINITE );
+      REQUEST* request;
+
+      {
+        CCriticalSectionLock lock( m_section );
+        if ( m_stopping )
+          break;
+
+        request = TakeRequest();
+        if ( !request ) {
+          ResetEvent( m_workEvent );
+          continue;
+        }
+      }
+
+      Search( finder, request );
+
+      CCriticalSectionLock lock( m_section );
+      if ( request->state != RQ_CANCELLED )
+        request->state = RQ_DONE;
+
+      m_done.push_back( request );
+    }
+
+    return 0;
+  }
+
+  CPathService::REQUEST* CPathService::TakeRequest() {
+    while ( !m_queue.empty() ) {
+      REQUEST* request = m_queue.front();
+
+      if ( request->state != RQ_CANCELLED && m_searchBudget > 0 && m_searchesStarted >= m_searchBudget )
+        return NULL;
+
+      std::pop_heap( m_queue.begin(), m_queue.end(), RequestOrder() );
+      m_queue.pop_back();
+
+      if ( request->state == RQ_CANCELLED ) {
+        m_done.push_back( request );
+        continue;
+      }
+
+      request->state = RQ_SEARCHING;
+      m_searchesStarted++;
+      return request;
+    }
+
+    return NULL;
+  }
+
+  void CPathService::Search( CPathFinder& aFinder, REQUEST* aRequest ) {
+    aRequest->found = aFinder.FindPath( *aRequest->grid, aRequest->startH, aRequest->startV,
+                                        aRequest->goalH, aRequest->goalV, aRequest->diagonal,
+                                        aRequest->cells );
+  }
+
+  const CPathGrid* CPathService::AcquireGrid( const CMotionGrid& aGrid ) {
+    // The listener is never removed, like the one of CPathCache
+    static CGridListener listener;
+    CMotionGrid::AddListener( &listener );
+
+    GridMap::iterator it = m_currentGrids.find( aGrid.GetID() );
+    const CPathGrid* grid;
+
+    if ( it != m_currentGrids.end() && it->second->GetVersion() == aGrid.GetVersion() )
+      grid = it->second;
+    else {
+      if ( it != m_currentGrids.end() ) {
+        // The old copy is freed when the last request using it finishes
+        const CPathGrid* old = it->second;
+        m_currentGrids.erase( it );
+
+        if ( m_gridReferences[old] == 0 ) {
+          m_gridReferences.erase( old );
+          delete old;
+        }
+      }
+
+      grid = new CPathGrid( aGrid );
+      m_currentGrids[aGrid.GetID()] = grid;
+    }
+
+    m_gridReferences[grid]++;
+    return grid;
+  }
+
+  void CPathService::ReleaseGrid( const CPathGrid* aGrid ) {
+    if ( --m_gridReferences[aGrid] > 0 )
+      return;
+
+    GridMap::iterator it = m_currentGrids.find( aGrid->GetGridID() );
+    bool current = ( it != m_currentGrids.end() && it->second == aGrid );
+
+    // Keep the current copy for next requests; copies of destroyed grids
+    // have been removed from m_currentGrids by the listener
+    if ( current )
+      return;
+
+    m_gridReferences.erase( aGrid );
+    delete aGrid;
+  }
+
+  void CPathService::Finish( REQUEST* aRequest, RequestStatus aStatus ) {
+    if ( aStatus != RS_UNKNOWN ) {
+      FINISHED& finished = m_finished[aRequest->id];
+      finished.status = aStatus;
+
+      if ( aRequest->pathIndex < 0 )
+        finished.cells.swap( aRequest->cells );
+
+      m_finishedOrder.push_back( aRequest->id );
+
+      if ( (int) m_finishedOrder.size() > MAX_FINISHED_REQUESTS ) {
+        m_finished.erase( m_finishedOrder.front() );
+        m_finishedOrder.pop_front();
+      }
+    }
+
+    ReleaseGrid( aRequest->grid );
+    m_requests.erase( aRequest->id );
+    delete aRequest;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void MpGridPathRequest( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( -1.0 );
+
+      try {
+        aResult->Set( (double) CPathService::Submit( (int) aArgs[0].real, (int) aArgs[1].real,
+                                                     aArgs[2].real, aArgs[3].real, aArgs[4].real,
+                                                     aArgs[5].real, aArgs[6].real >= 0.5, (int) aArgs[7].real ) );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridPathRequest )
+
+    void MpGridPathCancel( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( CPathService::Cancel( (int) aArgs[0].real ) ? 1.0 : 0.0 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridPathCancel )
+
+    void MpGridPathStatus( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CPathService::GetStatus( (int) aArgs[0].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridPathStatus )
+
+    void MpGridPathSync( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CPathService::Sync() );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridPathSync )
+
+    void MpGridPathSetBudget( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      CPathService::SetBudget( (int) aArgs[0].real, (int) aArgs[1].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridPathSetBudget )
+
+    void MpGridPathThreads( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      if ( aArgs[0].real < 0 ) {
+        CPathService::Stop();
+        aResult->Set( 0.0 );
+      } else
+        aResult->Set( (double) CPathService::Start( (int) aArgs[0].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( MpGridPathThreads )
+  }
+
+  void CPathService::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+    CPathFinder::RegisterGMFunctions();
+
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_path_request", 8, MpGridPathRequest );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_path_cancel", 1, MpGridPathCancel );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_path_status", 1, MpGridPathStatus );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_path_sync", 0, MpGridPathSync );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_path_set_budget", 2, MpGridPathSetBudget );
+    GMAPI_GMFUNCTION_REGISTER( "mp_grid_path_threads", 1, MpGridPathThreads );
+  }
+
+#endif
+
+}
@@ -0,0 +1,232 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPathService.h                                                  */
+/*   - Background path finding with results applied at sync points      */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiPathFinder.h"
+#include "GmapiUtilities.h"
+
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace gm {
+
+  /// CPathService
+  ///   Queue of path requests solved by worker threads. Each request is
+  ///   searched on the copy of the grid taken when the request was
+  ///   submitted, so later changes of the grid do not affect it. Found
+  ///   paths are written to the path resources only by Sync, which must
+  ///   be called from the main thread (typically once per step).
+  ///
+  ///   Pending requests are started in the order of their priority (higher
+  ///   first), requests with the same priority in the order of submission.
+  ///   Number of searches started and paths written between two Sync calls
+  ///   can be limited, see SetBudget.
+  ///
+  ///   Without worker threads (before Start or after Stop), the requests
+  ///   are searched by Sync on the main thread.
+  ///
+  ///   Requests found in CPathCache are not searched; results of searches
+  ///   on the current state of the grid are added to the cache by Sync.
+  ///
+  ///   The copy of the current state of each grid is shared by the
+  ///   requests submitted until the grid changes. It is dropped when the
+  ///   grid is destroyed and freed once no request refers to it.
+  ///
+  class CPathService {
+    public:
+      enum RequestStatus { RS_UNKNOWN = -1, RS_PENDING = 0, RS_FOUND = 1, RS_NOT_FOUND = 2 };
+
+      /// Start( int aThreadCount )
+      ///   Starts the worker threads. Running threads are stopped first.
+      ///
+      /// Parameters:
+      ///   aThreadCount: Number of threads; 0 starts one thread less than
+      ///                 the number of processors (at least one).
+      ///
+      /// Returns:
+      ///   Number of started threads.
+      ///
+      static int Start( int aThreadCount = 0 );
+
+      /// Stop()
+      ///   Waits until the running searches finish and stops the worker
+      ///   threads. Pending requests stay in the queue. Must be called
+      ///   before the DLL is unloaded if the threads have been started.
+      ///
+      static void Stop();
+
+      static int GetThreadCount() {
+        return (int) m_threads.size();
+      }
+
+      /// Submit( int aGridId, int aPathIndex, double aStartX, double aStartY,
+      ///         double aGoalX, double aGoalY, bool aDiagonal, int aPriority )
+      ///   Adds path request to the queue. Arguments have the same meaning
+      ///   as in mp_grid_path. If aPathIndex is negative, no path resource
+      ///   is written and the cells can be read by GetCells.
+      ///
+      /// Returns:
+      ///   ID of the request.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIMotionGridNotExist if the grid is not mirrored.
+      ///
+      static int Submit( int aGridId, int aPathIndex, double aStartX, double aStartY,
+                         double aGoalX, double aGoalY, bool aDiagonal, int aPriority = 0 );
+
+      /// Cancel( int aRequestId )
+      ///   Removes the request from the queue. If it is being searched, the
+      ///   result is discarded.
+      ///
+      /// Returns:
+      ///   False if the request is not pending.
+      ///
+      static bool Cancel( int aRequestId );
+
+      /// Sync()
+      ///   Writes found paths to the path resources and updates status of
+      ///   the finished requests. Without worker threads, the pending
+      ///   requests are searched first. Must be called from the main thread.
+      ///
+      /// Returns:
+      ///   Number of requests finished by the call.
+      ///
+      static int Sync();
+
+      /// SetBudget( int aSearchesPerSync, int aPathsPerSync )
+      ///   Limits number of searches started and number of requests finished
+      ///   between two Sync calls. 0 means no limit (default).
+      ///
+      static void SetBudget( int aSearchesPerSync, int aPathsPerSync );
+
+      /// GetStatus( int aRequestId )
+      ///   Returns status of the request. Status of finished requests is
+      ///   kept until MAX_FINISHED_REQUESTS newer requests finish.
+      ///
+      static RequestStatus GetStatus( int aRequestId );
+
+      /// GetCells( int aRequestId, std::vector<GRIDCELL>& aCells )
+      ///   Copies cells of the path found for a finished request submitted
+      ///   with negative path index.
+      ///
+      /// Returns:
+      ///   False if there is no such path.
+      ///
+      static bool GetCells( int aRequestId, std::vector<GRIDCELL>& aCells );
+
+      /// GetPendingCount()
+      ///   Returns number of requests that have not been finished by Sync.
+      ///
+      static int GetPendingCount() {
+        return (int) m_requests.size();
+      }
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers CPathFinder functions and the following GML functions:
+      ///     mp_grid_path_request( id, path, xstart, ystart, xgoal, ygoal, allowdiag, priority )
+      ///       - returns ID of the request or -1 if the grid is not mirrored
+      ///     mp_grid_path_cancel( request ) - returns true if the request was pending
+      ///     mp_grid_path_status( request ) - returns 0 (pending), 1 (path found),
+      ///       2 (no path) or -1 (unknown or cancelled request)
+      ///     mp_grid_path_sync() - writes found paths, returns number of
+      ///       finished requests
+      ///     mp_grid_path_set_budget( searches, paths )
+      ///     mp_grid_path_threads( count ) - starts worker threads (0 means
+      ///       default count, -1 stops the threads); returns number of threads
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+      // Number of finished requests whose status is kept
+      static const int MAX_FINISHED_REQUESTS = 4096;
+
+    private:
+      class CGridListener;
+      friend class CGridListener;
+
+      enum RequestState { RQ_QUEUED, RQ_SEARCHING, RQ_DONE, RQ_CANCELLED };
+
+      struct REQUEST {
+        int id;
+        int priority;
+        unsigned int sequence;
+        const CPathGrid* grid;
+        int pathIndex;
+        double startX, startY, goalX, goalY;
+        int startH, startV, goalH, goalV;
+        bool diagonal;
+        RequestState state;   // Guarded by m_section
+        bool found;
+        bool cached;          // Result has been taken from CPathCache
+        std::vector<GRIDCELL> cells;
+      };
+
+      struct FINISHED {
+        RequestStatus status;
+        std::vector<GRIDCELL> cells;
+      };
+
+      struct RequestOrder {
+        bool operator()( const REQUEST* aFirst, const REQUEST* aSecond ) const;
+      };
+
+      typedef std::map<int, REQUEST*> RequestMap;
+      typedef std::map<int, FINISHED> FinishedMap;
+      typedef std::map<const CPathGrid*, int> GridReferenceMap;
+      typedef std::map<int, const CPathGrid*> GridMap;
+
+      static DWORD WINAPI WorkerProc( LPVOID aParameter );
+      static REQUEST* TakeRequest();
+      static void Search( CPathFinder& aFinder, REQUEST* aRequest );
+      static const CPathGrid* AcquireGrid( const CMotionGrid& aGrid );
+      static void ReleaseGrid( const CPathGrid* aGrid );
+      static void Finish( REQUEST* aRequest, RequestStatus aStatus );
+
+      // All fields are used by the main thread only, except those
+      // guarded by m_section
+      static RequestMap m_requests;
+      static FinishedMap m_finished;
+      static std::deque<int> m_finishedOrder;
+      static GridReferenceMap m_gridReferences;
+      static GridMap m_currentGrids;
+      static std::vector<HANDLE> m_threads;
+      static int m_nextId;
+      static unsigned int m_sequence;
+      static int m_pathBudget;
+
+      // Guarded by m_section
+      static CCriticalSection m_section;
+      static HANDLE m_workEvent;      // Set while workers may take requests
+      static std::vector<REQUEST*> m_queue;
+      static std::vector<REQUEST*> m_done;
+      static int m_searchBudget;
+      static int m_searchesStarted;
+      static bool m_stopping;
+  };
+
+}
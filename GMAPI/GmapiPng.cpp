@@ -0,0 +1,1333 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPng.cpp                                                        */
+/*   - PNG files of 32bit ARGB bitmaps                                  */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiPng.h"
+#include "GmapiUtilities.h"
+#include "GmapiMacros.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+namespace gm {
+
+  namespace {
+    // Signature starting all PNG files
+    static const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    // Largest image accepted by Decode (in both directions)
+    static const int MAX_IMAGE_SIZE = 16384;
+
+    // Size of the deflate window and of the hash table of its positions
+    static const int WINDOW_SIZE = 32768;
+    static const int HASH_BITS = 15;
+    // Number of earlier positions tried when looking for a match
+    static const int MAX_CHAIN = 48;
+    // Matches of this length are taken without looking for longer ones
+    static const int GOOD_MATCH = 64;
+    static const int MIN_MATCH = 3;
+    static const int MAX_MATCH = 258;
+    // Number of symbols in one deflate block
+    static const size_t BLOCK_SYMBOLS = 65536;
+    // Bits of the lookup table of the Huffman decoder
+    static const int FAST_BITS = 9;
+
+    static const unsigned short LENGTH_BASE[29] = {
+      3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const unsigned char LENGTH_EXTRA[29] = {
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const unsigned short DISTANCE_BASE[30] = {
+      1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+      257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const unsigned char DISTANCE_EXTRA[30] = {
+      0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    // Order in which lengths of the code length code are stored
+    static const unsigned char CODE_LENGTH_ORDER[19] = {
+      16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    DWORD crcTable[256];
+    bool crcTableReady = false;
+
+    DWORD UpdateCrc( DWORD aCrc, const unsigned char* aData, size_t aSize ) {
+      if ( !crcTableReady ) {
+        for ( DWORD n = 0; n < 256; n++ ) {
+          DWORD c = n;
+
+          for ( int k = 0; k < 8; k++ )
+            c = ( c & 1 ? 0xEDB88320 ^ ( c >> 1 ) : c >> 1 );
+
+          crcTable[n] = c;
+        }
+
+        crcTableReady = true;
+      }
+
+      for ( size_t i = 0; i < aSize; i++ )
+        aCrc = crcTable[( aCrc ^ aData[i] ) & 0xFF] ^ ( aCrc >> 8 );
+
+      return aCrc;
+    }
+
+    DWORD Adler32( const unsigned char* aData, size_t aSize ) {
+      DWORD a = 1, b = 0;
+
+      while ( aSize > 0 ) {
+        // Largest run before the sums have to be reduced
+        size_t count = ( aSize < 5552 ? aSize : 5552 );
+        aSize -= count;
+
+        for ( ; count > 0; count--, aData++ ) {
+          a += *aData;
+          b += a;
+        }
+
+        a %= 65521;
+        b %= 65521;
+      }
+
+      return ( b << 16 ) | a;
+    }
+
+    void AppendBigEndian( std::string& aData, DWORD aValue ) {
+      aData += (char) ( aValue >> 24 );
+      aData += (char) ( aValue >> 16 );
+      aData += (char) ( aValue >> 8 );
+      aData += (char) aValue;
+    }
+
+    DWORD ReadBigEndian( const unsigned char* aData ) {
+      return ( (DWORD) aData[0] << 24 ) | ( (DWORD) aData[1] << 16 ) | ( (DWORD) aData[2] << 8 ) | aData[3];
+    }
+
+    int PaethPredictor( int aLeft, int aAbove, int aAboveLeft ) {
+      int p = aLeft + aAbove - aAboveLeft;
+      int pa = abs( p - aLeft ), pb = abs( p - aAbove ), pc = abs( p - aAboveLeft );
+
+      if ( pa <= pb && pa <= pc )
+        return aLeft;
+
+      return ( pb <= pc ? aAbove : aAboveLeft );
+    }
+
+    /************************************************************************/
+    /* Deflate                                                              */
+    /************************************************************************/
+
+    class CBitWriter {
+      public:
+        CBitWriter( std::string& aData ): m_data( aData ), m_bits( 0 ), m_count( 0 ) {}
+
+        void Put( DWORD aValue, int aCount ) {
+          m_bits |= aValue << m_count;
+          m_count += aCount;
+
+          while ( m_count >= 8 ) {
+            m_data += (char) m_bits;
+            m_bits >>= 8;
+            m_count -= 8;
+          }
+        }
+
+        void Flush() {
+          if ( m_count > 0 )
+            m_data += (char) m_bits;
+
+          m_bits = 0;
+          m_count = 0;
+        }
+
+      private:
+        std::string& m_data;
+        DWORD m_bits;
+        int m_count;
+    };
+
+    // Literal or length (3-258) with distance (1-32768); distance 0 marks
+    // a literal
+    struct SYMBOL {
+      unsigned short value;
+      unsigned short distance;
+    };
+
+    int LengthCode( int aLength ) {
+      return (int) ( std::upper_bound( LENGTH_BASE, LENGTH_BASE + 29, aLength ) - LENGTH_BASE ) - 1;
+    }
+
+    int DistanceCode( int aDistance ) {
+      return (int) ( std::upper_bound( DISTANCE_BASE, DISTANCE_BASE + 30, aDistance ) - DISTANCE_BASE ) - 1;
+    }
+
+    // Computes lengths of Huffman codes of the symbols, not longer than
+    // aMaxBits; frequencies are halved until the limit is met
+    void BuildCodeLengths( const DWORD* aFrequencies, int aCount, int aMaxBits, unsigned char* aLengths ) {
+      std::vector<DWORD> frequencies( aFrequencies, aFrequencies + aCount );
+
+      for ( ;; ) {
+        typedef std::pair<DWORD, int> NODE;
+        std::priority_queue<NODE, std::vector<NODE>, std::greater<NODE> > queue;
+        std::vector<int> symbols, parents;
+
+        memset( aLengths, 0, aCount );
+
+        for ( int i = 0; i < aCount; i++ ) {
+          if ( frequencies[i] > 0 ) {
+            queue.push( NODE( frequencies[i], (int) symbols.size() ) );
+            symbols.push_back( i );
+          }
+        }
+
+        if ( symbols.size() == 1 )
+          aLengths[symbols[0]] = 1;
+
+        if ( symbols.size() <= 1 )
+          return;
+
+        // Leaves are nodes 0 to n - 1; each internal node gets a higher
+        // index than its children
+        parents.resize( symbols.size() * 2 - 1, -1 );
+
+        for ( int node = (int) symbols.size(); queue.size() > 1; node++ ) {
+          NODE first = queue.top();
+          queue.pop();
+          NODE second = queue.top();
+          queue.pop();
+
+          parents[first.second] = node;
+          parents[second.second] = node;
+          queue.push( NODE( first.first + second.first, node ) );
+        }
+
+        std::vector<int> depths( parents.size(), 0 );
+        int maxDepth = 0;
+
+        for ( int node = (int) parents.size() - 2; node >= 0; node-- ) {
+          depths[node] = depths[parents[node]] + 1;
+          maxDepth = std::max( maxDepth, depths[node] );
+        }
+
+        if ( maxDepth <= aMaxBits ) {
+          for ( size_t i = 0; i < symbols.size(); i++ )
+            aLengths[symbols[i]] = (unsigned char) depths[i];
+
+          return;
+        }
+
+        for ( int i = 0; i < aCount; i++ ) {
+          if ( frequencies[i] > 0 )
+            frequencies[i] = ( frequencies[i] >> 1 ) | 1;
+        }
+      }
+    }
+
+    // Computes canonical codes of the lengths, bit reversed for writing
+    void BuildCodes( const unsigned char* aLengths, int aCount, unsigned short* aCodes ) {
+      int counts[16] = { 0 }, next[16] = { 0 };
+
+      for ( int i = 0; i < aCount; i++ )
+        counts[aLengths[i]]++;
+
+      counts[0] = 0;
+
+      for ( int bits = 1; bits < 16; bits++ )
+        next[bits] = ( next[bits - 1] + counts[bits - 1] ) << 1;
+
+      for ( int i = 0; i < aCount; i++ ) {
+        int length = aLengths[i];
+        int code = ( length ? next[length]++ : 0 ), reversed = 0;
+
+        for ( int bit = 0; bit < length; bit++ )
+          reversed |= ( ( code >> bit ) & 1 ) << ( length - 1 - bit );
+
+        aCodes[i] = (unsigned short) reversed;
+      }
+    }
+
+    void WriteBlock( CBitWriter& aWriter, const SYMBOL* aSymbols, size_t aCount, bool aLast ) {
+      DWORD literalFrequencies[286] = { 0 }, distanceFrequencies[30] = { 0 };
+
+      for ( size_t i = 0; i < aCount; i++ ) {
+        if ( aSymbols[i].distance ) {
+          literalFrequencies[257 + LengthCode( aSymbols[i].value )]++;
+          distanceFrequencies[DistanceCode( aSymbols[i].distance )]++;
+        } else
+          literalFrequencies[aSymbols[i].value]++;
+      }
+
+      literalFrequencies[256] = 1;
+
+      // Some decoders reject codes with less than two symbols
+      if ( std::count( literalFrequencies, literalFrequencies + 286, (DWORD) 0 ) > 284 )
+        literalFrequencies[literalFrequencies[0] ? 1 : 0]++;
+
+      for ( int i = 0; i < 2; i++ ) {
+        if ( std::count( distanceFrequencies, distanceFrequencies + 30, (DWORD) 0 ) > 28 && !distanceFrequencies[i] )
+          distanceFrequencies[i] = 1;
+      }
+
+      unsigned char lengths[286 + 30];
+      unsigned short literalCodes[286], distanceCodes[30];
+
+      BuildCodeLengths( literalFrequencies, 286, 15, lengths );
+      BuildCodeLengths( distanceFrequencies, 30, 15, lengths + 286 );
+      BuildCodes( lengths, 286, literalCodes );
+      BuildCodes( lengths + 286, 30, distanceCodes );
+
+      int literalCount = 286, distanceCount = 30;
+
+      while ( literalCount > 257 && !lengths[literalCount - 1] )
+        literalCount--;
+
+      while ( distanceCount > 1 && !lengths[286 + distanceCount - 1] )
+        distanceCount--;
+
+      // Code lengths of both codes are stored together, with runs
+      // shortened by codes 16 (repeat previous), 17 and 18 (zeros)
+      unsigned char all[286 + 30];
+      int allCount = literalCount + distanceCount;
+      std::vector<unsigned char> runs;
+      DWORD runFrequencies[19] = { 0 };
+
+      memcpy( all, lengths, literalCount );
+      memcpy( all + literalCount, lengths + 286, distanceCount );
+
+      for ( int i = 0; i < allCount; ) {
+        int length = all[i], run = 1;
+
+        while ( i + run < allCount && all[i + run] == length )
+          run++;
+
+        if ( length == 0 && run >= 3 ) {
+          int code = ( run <= 10 ? 17 : 18 );
+
+          run = std::min( run, 138 );
+          runs.push_back( (unsigned char) code );
+          runs.push_back( (unsigned char) ( code == 17 ? run - 3 : run - 11 ) );
+          runFrequencies[code]++;
+        } else if ( length != 0 && run >= 4 ) {
+          // The first length is stored, the rest repeats it
+          run = std::min( run, 7 );
+          runs.push_back( (unsigned char) length );
+          runs.push_back( 16 );
+          runs.push_back( (unsigned char) ( run - 4 ) );
+          runFrequencies[length]++;
+          runFrequencies[16]++;
+        } else {
+          run = 1;
+          runs.push_back( (unsigned char) length );
+          runFrequencies[length]++;
+        }
+
+        i += run;
+      }
+
+      unsigned char runLengths[19];
+      unsigned short runCodes[19];
+      int runLengthCount = 19;
+
+      BuildCodeLengths( runFrequencies, 19, 7, runLengths );
+      BuildCodes( runLengths, 19, runCodes );
+
+      while ( runLengthCount > 4 && !runLengths[CODE_LENGTH_ORDER[runLengthCount - 1]] )
+        runLengthCount--;
+
+      aWriter.Put( aLast ? 1 : 0, 1 );
+      aWriter.Put( 2, 2 );
+      aWriter.Put( literalCount - 257, 5 );
+      aWriter.Put( distanceCount - 1, 5 );
+      aWriter.Put( runLengthCount - 4, 4 );
+
+      for ( int i = 0; i < runLengthCount; i++ )
+        aWriter.Put( runLengths[CODE_LENGTH_ORDER[i]], 3 );
+
+      for ( size_t i = 0; i < runs.size(); i++ ) {
+        int code = runs[i];
+        aWriter.Put( runCodes[code], runLengths[code] );
+
+        if ( code == 16 )
+          aWriter.Put( runs[++i], 2 );
+        else if ( code == 17 )
+          aWriter.Put( runs[++i], 3 );
+        else if ( code == 18 )
+          aWriter.Put( runs[++i], 7 );
+      }
+
+      for ( size_t i = 0; i < aCount; i++ ) {
+        const SYMBOL& symbol = aSymbols[i];
+
+        if ( !symbol.distance ) {
+          aWriter.Put( literalCodes[symbol.value], lengths[symbol.value] );
+          continue;
+        }
+
+        int lengthCode = LengthCode( symbol.value );
+        int distanceCode = DistanceCode( symbol.distance );
+
+        aWriter.Put( literalCodes[257 + lengthCode], lengths[257 + lengthCode] );
+        aWriter.Put( symbol.value - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode] );
+        aWriter.Put( distanceCodes[distanceCode], lengths[286 + distanceCode] );
+        aWriter.Put( symbol.distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode] );
+      }
+
+      aWriter.Put( literalCodes[256], lengths[256] );
+    }
+
+    // Appends zlib stream of the data to aStream
+    void Compress( const unsigned char* aData, size_t aSize, std::string& aStream ) {
+      std::vector<int> heads( 1 << HASH_BITS, -1 ), previous( WINDOW_SIZE, -1 );
+      std::vector<SYMBOL> symbols;
+      CBitWriter writer( aStream );
+
+      // 32K window, deflate, default compression
+      aStream += (char) 0x78;
+      aStream += (char) 0x9C;
+
+      symbols.reserve( BLOCK_SYMBOLS );
+
+      for ( size_t position = 0; position < aSize; ) {
+        int bestLength = 0, bestDistance = 0;
+
+        if ( position + MIN_MATCH <= aSize ) {
+          const unsigned char* current = aData + position;
+          int hash = ( ( current[0] << 10 ) ^ ( current[1] << 5 ) ^ current[2] ) & ( ( 1 << HASH_BITS ) - 1 );
+          int maxLength = (int) std::min( aSize - position, (size_t) MAX_MATCH );
+          int candidate = heads[hash];
+
+          for ( int chain = 0; chain < MAX_CHAIN && candidate >= 0; chain++ ) {
+            int distance = (int) position - candidate;
+
+            if ( distance > WINDOW_SIZE )
+              break;
+
+            const unsigned char* match = aData + candidate;
+
+            if ( match[bestLength] == current[bestLength] ) {
+              int length = 0;
+
+              while ( length < maxLength && match[length] == current[length] )
+                length++;
+
+              if ( length > bestLength ) {
+                bestLength = length;
+                bestDistance = distance;
+
+                if ( length >= GOOD_MATCH || length == maxLength )
+                  break;
+              }
+            }
+
+            int next = previous[candidate & ( WINDOW_SIZE - 1 )];
+
+            if ( next >= candidate )
+              break;
+
+            candidate = next;
+          }
+        }
+
+        SYMBOL symbol;
+        int step = 1;
+
+        if ( bestLength >= MIN_MATCH ) {
+          symbol.value = (unsigned short) bestLength;
+          symbol.distance = (unsigned short) bestDistance;
+          step = bestLength;
+        } else {
+          symbol.value = aData[position];
+          symbol.distance = 0;
+        }
+
+        symbols.push_back( symbol );
+
+        for ( int i = 0; i < step; i++, position++ ) {
+          if ( position + MIN_MATCH <= aSize ) {
+            const unsigned char* current = aData + position;
+            int hash = ( ( current[0] << 10 ) ^ ( current[1] << 5 ) ^ current[2] ) & ( ( 1 << HASH_BITS ) - 1 );
+
+            previous[position & ( WINDOW_SIZE - 1 )] = heads[hash];
+            heads[hash] = (int) position;
+          }
+        }
+
+        if ( symbols.size() == BLOCK_SYMBOLS && position < aSize ) {
+          WriteBlock( writer, &symbols[0], symbols.size(), false );
+          symbols.clear();
+        }
+      }
+
+      WriteBlock( writer, symbols.empty() ? NULL : &symbols[0], symbols.size(), true );
+      writer.Flush();
+
+      AppendBigEndian( aStream, Adler32( aData, aSize ) );
+    }
+
+    /************************************************************************/
+    /* Inflate                                                              */
+    /************************************************************************/
+
+    // Canonical Huffman code; codes up to FAST_BITS long are found by the
+    // lookup table (symbol << 4 | length), longer ones by their lengths
+    struct HUFFMAN {
+      short counts[16];
+      short symbols[288];
+      unsigned short fast[1 << FAST_BITS];
+    };
+
+    void BuildHuffman( HUFFMAN& aCode, const unsigned char* aLengths, int aCount ) {
+      short offsets[16];
+
+      memset( aCode.counts, 0, sizeof( aCode.counts ) );
+      memset( aCode.fast, 0, sizeof( aCode.fast ) );
+
+      for ( int i = 0; i < aCount; i++ )
+        aCode.counts[aLengths[i]]++;
+
+      aCode.counts[0] = 0;
+      offsets[1] = 0;
+
+      for ( int bits = 1; bits < 15; bits++ )
+        offsets[bits + 1] = offsets[bits] + aCode.counts[bits];
+
+      for ( int i = 0; i < aCount; i++ ) {
+        if ( aLengths[i] )
+          aCode.symbols[offsets[aLengths[i]]++] = (short) i;
+      }
+
+      unsigned short codes[288];
+      BuildCodes( aLengths, aCount, codes );
+
+      for ( int i = 0; i < aCount; i++ ) {
+        int length = aLengths[i];
+
+        if ( length == 0 || length > FAST_BITS )
+          continue;
+
+        for ( int index = codes[i]; index < ( 1 << FAST_BITS ); index += 1 << length )
+          aCode.fast[index] = (unsigned short) ( ( i << 4 ) | length );
+      }
+    }
+
+    class CInflater {
+      public:
+        // Output longer than aLimit bytes is an error
+        CInflater( const unsigned char* aData, size_t aSize, size_t aLimit ):
+          m_data( aData ), m_size( aSize ), m_limit( aLimit ), m_position( 0 ), m_bits( 0 ), m_count( 0 ),
+          m_error( false ) {}
+
+        bool Inflate( std::vector<unsigned char>& aOutput );
+
+      private:
+        void Fill() {
+          while ( m_count <= 24 && m_position < m_size ) {
+            m_bits |= (DWORD) m_data[m_position++] << m_count;
+            m_count += 8;
+          }
+        }
+
+        int Get( int aCount ) {
+          if ( m_count < aCount ) {
+            Fill();
+
+            if ( m_count < aCount ) {
+              m_error = true;
+              return 0;
+            }
+          }
+
+          int value = (int) ( m_bits & ( ( 1UL << aCount ) - 1 ) );
+          m_bits >>= aCount;
+          m_count -= aCount;
+
+          return value;
+        }
+
+        int Decode( const HUFFMAN& aCode );
+        bool Stored( std::vector<unsigned char>& aOutput );
+        bool Codes( std::vector<unsigned char>& aOutput, const HUFFMAN& aLiterals, const HUFFMAN& aDistances );
+        bool Dynamic( HUFFMAN& aLiterals, HUFFMAN& aDistances );
+
+        const unsigned char* m_data;
+        size_t m_size;
+        size_t m_limit;
+        size_t m_position;
+        DWORD m_bits;
+        int m_count;
+        bool m_error;
+    };
+
+    int CInflater::Decode( const HUFFMAN& aCode ) {
+      if ( m_count < 16 )
+        Fill();
+
+      int entry = aCode.fast[m_bits & ( ( 1 << FAST_BITS ) - 1 )];
+
+      if ( entry && ( entry & 15 ) <= m_count ) {
+        m_bits >>= entry & 15;
+        m_count -= entry & 15;
+        return entry >> 4;
+      }
+
+      int code = 0, first = 0, index = 0;
+
+      for ( int bits = 1; bits < 16; bits++ ) {
+        code |= Get( 1 );
+
+        if ( m_error )
+          return -1;
+
+        int count = aCode.counts[bits];
+
+        if ( code - count < first )
+          return aCode.symbols[index + ( code - first )];
+
+        index += count;
+        first = ( first + count ) << 1;
+        code <<= 1;
+      }
+
+      return -1;
+    }
+
+    bool CInflater::Stored( std::vector<unsigned char>& aOutput ) {
+      // Skip to the byte boundary; whole bytes still in the buffer are
+      // returned to the input
+      m_bits >>= m_count & 7;
+      m_count -= m_count & 7;
+      m_position -= m_count / 8;
+      m_bits = 0;
+      m_count = 0;
+
+      if ( m_position + 4 > m_size )
+        return false;
+
+      size_t length = m_data[m_position] | ( m_data[m_position + 1] << 8 );
+      size_t complement = m_data[m_position + 2] | ( m_data[m_position + 3] << 8 );
+      m_position += 4;
+
+      if ( length != ( ~complement & 0xFFFF ) || m_position + length > m_size ||
+           length > m_limit - aOutput.size() )
+        return false;
+
+      aOutput.insert( aOutput.end(), m_data + m_position, m_data + m_position + length );
+      m_position += length;
+
+      return true;
+    }
+
+    bool CInflater::Codes( std::vector<unsigned char>& aOutput, const HUFFMAN& aLiterals, const HUFFMAN& aDistances ) {
+      for ( ;; ) {
+        int symbol = Decode( aLiterals );
+
+        if ( symbol < 0 || m_error )
+          return false;
+
+        if ( symbol < 256 ) {
+          if ( aOutput.size() >= m_limit )
+            return false;
+
+          aOutput.push_back( (unsigned char) symbol );
+          continue;
+        }
+
+        if ( symbol == 256 )
+          return true;
+
+        symbol -= 257;
+
+        if ( symbol >= 29 )
+          return false;
+
+        size_t length = LENGTH_BASE[symbol] + Get( LENGTH_EXTRA[symbol] );
+        int distanceCode = Decode( aDistances );
+
+        if ( distanceCode < 0 || distanceCode >= 30 )
+          return false;
+
+        size_t distance = DISTANCE_BASE[distanceCode] + Get( DISTANCE_EXTRA[distanceCode] );
+
+        if ( m_error || distance > aOutput.size() || length > m_limit - aOutput.size() )
+          return false;
+
+        // Copied byte by byte, as the ranges may overlap
+        size_t from = aOutput.size() - distance;
+        aOutput.resize( aOutput.size() + length );
+        unsigned char* output = &aOutput[0];
+
+        for ( size_t i = 0; i < length; i++ )
+          output[aOutput.size() - length + i] = output[from + i];
+      }
+    }
+
+    bool CInflater::Dynamic( HUFFMAN& aLiterals, HUFFMAN& aDistances ) {
+      int literalCount = Get( 5 ) + 257;
+      int distanceCount = Get( 5 ) + 1;
+      int runLengthCount = Get( 4 ) + 4;
+      unsigned char lengths[286 + 30];
+      unsigned char runLengths[19] = { 0 };
+      HUFFMAN runCode;
+
+      if ( literalCount > 286 || distanceCount > 30 )
+        return false;
+
+      for ( int i = 0; i < runLengthCount; i++ )
+        runLengths[CODE_LENGTH_ORDER[i]] = (unsigned char) Get( 3 );
+
+      BuildHuffman( runCode, runLengths, 19 );
+
+      for ( int i = 0; i < literalCount + distanceCount; ) {
+        int symbol = Decode( runCode );
+        int value = 0, repeat = 1;
+
+        if ( symbol < 0 || m_error )
+          return false;
+
+        if ( symbol < 16 )
+          value = symbol;
+        else if ( symbol == 16 ) {
+          if ( i == 0 )
+            return false;
+
+          value = lengths[i - 1];
+          repeat = 3 + Get( 2 );
+        } else if ( symbol == 17 )
+          repeat = 3 + Get( 3 );
+        else
+          repeat = 11 + Get( 7 );
+
+        if ( i + repeat > literalCount + distanceCount )
+          return false;
+
+        memset( lengths + i, value, repeat );
+        i += repeat;
+      }
+
+      BuildHuffman( aLiterals, lengths, literalCount );
+      BuildHuffman( aDistances, lengths + literalCount, distanceCount );
+
+      return !m_error;
+    }
+
+    bool CInflater::Inflate( std::vector<unsigned char>& aOutput ) {
+      if ( m_size < 2 || ( m_data[0] & 0x0F ) != 8 || ( ( m_data[0] << 8 ) | m_data[1] ) % 31 != 0 ||
+           ( m_data[1] & 0x20 ) )
+        return false;
+
+      m_position = 2;
+
+      HUFFMAN literals, distances;
+      bool last = false;
+
+      while ( !last ) {
+        last = ( Get( 1 ) != 0 );
+        int type = Get( 2 );
+        bool result = false;
+
+        if ( m_error )
+          return false;
+
+        if ( type == 0 )
+          result = Stored( aOutput );
+        else if ( type == 1 ) {
+          unsigned char lengths[288 + 30];
+
+          memset( lengths, 8, 144 );
+          memset( lengths + 144, 9, 112 );
+          memset( lengths + 256, 7, 24 );
+          memset( lengths + 280, 8, 8 );
+          memset( lengths + 288, 5, 30 );
+
+          BuildHuffman( literals, lengths, 288 );
+          BuildHuffman( distances, lengths + 288, 30 );
+          result = Codes( aOutput, literals, distances );
+        } else if ( type == 2 )
+          result = Dynamic( literals, distances ) && Codes( aOutput, literals, distances );
+
+        if ( !result )
+          return false;
+      }
+
+      return true;
+    }
+
+    /************************************************************************/
+    /* Parallel jobs                                                        */
+    /************************************************************************/
+
+    template <class T>
+    struct JOBLIST {
+      std::vector<T>* jobs;
+      volatile LONG next;
+    };
+
+    bool ReadWholeFile( const char* aFileName, std::vector<unsigned char>& aData ) {
+      HANDLE file = CreateFileA( aFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL, NULL );
+
+      if ( file == INVALID_HANDLE_VALUE )
+        return false;
+
+      DWORD size = GetFileSize( file, NULL ), read = 0;
+      bool result = ( size != INVALID_FILE_SIZE );
+
+      if ( result ) {
+        aData.resize( size );
+        result = ( size == 0 || ( ReadFile( file, &aData[0], size, &read, NULL ) && read == size ) );
+      }
+
+      CloseHandle( file );
+      return result;
+    }
+  }
+
+  /************************************************************************/
+  /* CPngFile class implementation                                        */
+  /************************************************************************/
+
+  void CPngFile::AppendChunk( std::string& aData, const char* aType, const std::string& aContent ) {
+    AppendBigEndian( aData, (DWORD) aContent.size() );
+    aData.append( aType, 4 );
+    aData += aContent;
+
+    DWORD crc = UpdateCrc( 0xFFFFFFFF, (const unsigned char*) aType, 4 );
+    crc = UpdateCrc( crc, (const unsigned char*) aContent.data(), aContent.size() );
+    AppendBigEndian( aData, crc ^ 0xFFFFFFFF );
+  }
+
+  void CPngFile::FilterRows( const unsigned char* aBitmap, int aWidth, int aHeight, std::string& aRaw ) {
+    int stride = aWidth * 4;
+    std::vector<unsigned char> row( stride ), previous( stride, 0 ), filtered( 5 * stride );
+
+    aRaw.resize( (size_t) aHeight * ( stride + 1 ) );
+
+    for ( int y = 0; y < aHeight; y++ ) {
+      const unsigned char* source = aBitmap + (size_t) y * stride;
+
+      // Channels are reordered from BGRA to RGBA
+      for ( int x = 0; x < stride; x += 4 ) {
+        row[x] = source[x + 2];
+        row[x + 1] = source[x + 1];
+        row[x + 2] = source[x];
+        row[x + 3] = source[x + 3];
+      }
+
+      // Each filter type is tried; the one with the smallest sum of
+      // absolute differences is usually compressed best
+      int bestType = 0;
+      long bestSum = LONG_MAX;
+
+      for ( int type = 0; type < 5; type++ ) {
+        unsigned char* output = &filtered[type * stride];
+        long sum = 0;
+
+        for ( int i = 0; i < stride; i++ ) {
+          int left = ( i >= 4 ? row[i - 4] : 0 );
+          int above = previous[i];
+          int aboveLeft = ( i >= 4 ? previous[i - 4] : 0 );
+          int predicted = 0;
+
+          switch ( type ) {
+            case 1: predicted = left; break;
+            case 2: predicted = above; break;
+            case 3: predicted = ( left + above ) >> 1; break;
+            case 4: predicted = PaethPredictor( left, above, aboveLeft ); break;
+          }
+
+          output[i] = (unsigned char) ( row[i] - predicted );
+          sum += abs( (signed char) output[i] );
+        }
+
+        if ( sum < bestSum ) {
+          bestSum = sum;
+          bestType = type;
+        }
+      }
+
+      aRaw[(size_t) y * ( stride + 1 )] = (char) bestType;
+
+      if ( stride > 0 )
+        memcpy( &aRaw[(size_t) y * ( stride + 1 ) + 1], &filtered[bestType * stride], stride );
+
+      row.swap( previous );
+    }
+  }
+
+  bool CPngFile::UnfilterRows( unsigned char* aRaw, int aHeight, int aStride, int aPixelSize ) {
+    const unsigned char* previous = NULL;
+
+    for ( int y = 0; y < aHeight; y++ ) {
+      unsigned char* row = aRaw + (size_t) y * ( aStride + 1 ) + 1;
+      int type = row[-1];
+
+      if ( type > 4 )
+        return false;
+
+      for ( int i = 0; i < aStride; i++ ) {
+        int left = ( i >= aPixelSize ? row[i - aPixelSize] : 0 );
+        int above = ( previous ? previous[i] : 0 );
+        int aboveLeft = ( previous && i >= aPixelSize ? previous[i - aPixelSize] : 0 );
+
+        switch ( type ) {
+          case 1: row[i] = (unsigned char) ( row[i] + left ); break;
+          case 2: row[i] = (unsigned char) ( row[i] + above ); break;
+          case 3: row[i] = (unsigned char) ( row[i] + ( ( left + above ) >> 1 ) ); break;
+          case 4: row[i] = (unsigned char) ( row[i] + PaethPredictor( left, above, aboveLeft ) ); break;
+        }
+      }
+
+      previous = row;
+    }
+
+    return true;
+  }
+
+  void CPngFile::Encode( const unsigned char* aBitmap, int aWidth, int aHeight, std::string& aData ) {
+    std::string header, raw, stream;
+
+    AppendBigEndian( header, aWidth );
+    AppendBigEndian( header, aHeight );
+    // 8 bits per channel, RGBA, default compression, filtering and no
+    // interlacing
+    header += (char) 8;
+    header += (char) 6;
+    header.append( 3, (char) 0 );
+
+    FilterRows( aBitmap, aWidth, aHeight, raw );
+    Compress( (const unsigned char*) raw.data(), raw.size(), stream );
+
+    aData.assign( (const char*) PNG_SIGNATURE, sizeof( PNG_SIGNATURE ) );
+    AppendChunk( aData, "IHDR", header );
+    AppendChunk( aData, "IDAT", stream );
+    AppendChunk( aData, "IEND", std::string() );
+  }
+
+  bool CPngFile::Decode( const unsigned char* aData, size_t aSize, std::vector<unsigned char>& aBitmap,
+                         int& aWidth, int& aHeight ) {
+    if ( aSize < sizeof( PNG_SIGNATURE ) || memcmp( aData, PNG_SIGNATURE, sizeof( PNG_SIGNATURE ) ) )
+      return false;
+
+    std::vector<unsigned char> stream, palette, transparency;
+    int width = 0, height = 0, depth = 0, colorType = -1;
+    size_t position = sizeof( PNG_SIGNATURE );
+
+    while ( position + 12 <= aSize ) {
+      size_t length = ReadBigEndian( aData + position );
+      const unsigned char* type = aData + position + 4;
+      const unsigned char* content = type + 4;
+
+      if ( length > aSize - position - 12 )
+        return false;
+
+      position += length + 12;
+
+      if ( !memcmp( type, "IHDR", 4 ) ) {
+        if ( length < 13 )
+          return false;
+
+        width = (int) std::min( ReadBigEndian( content ), (DWORD) MAX_IMAGE_SIZE + 1 );
+        height = (int) std::min( ReadBigEndian( content + 4 ), (DWORD) MAX_IMAGE_SIZE + 1 );
+        depth = content[8];
+        colorType = content[9];
+
+        // Only deflate, adaptive filtering and no interlacing are supported
+        if ( content[10] || content[11] || content[12] )
+          return false;
+      } else if ( !memcmp( type, "PLTE", 4 ) )
+        palette.assign( content, content + length );
+      else if ( !memcmp( type, "tRNS", 4 ) )
+        transparency.assign( content, content + length );
+      else if ( !memcmp( type, "IDAT", 4 ) )
+        stream.insert( stream.end(), content, content + length );
+      else if ( !memcmp( type, "IEND", 4 ) )
+        break;
+    }
+
+    if ( width <= 0 || height <= 0 || width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE )
+      return false;
+
+    int channels;
+
+    switch ( colorType ) {
+      case 0: channels = 1; break;
+      case 2: channels = 3; break;
+      case 3: channels = 1; break;
+      case 4: channels = 2; break;
+      case 6: channels = 4; break;
+      default: return false;
+    }
+
+    bool validDepth = ( depth == 8 || ( depth == 16 && colorType != 3 ) ||
+                        ( ( depth == 1 || depth == 2 || depth == 4 ) && ( colorType == 0 || colorType == 3 ) ) );
+
+    if ( !validDepth || ( colorType == 3 && palette.size() < 3 ) || stream.empty() )
+      return false;
+
+    int pixelBits = channels * depth;
+    size_t stride = ( (size_t) width * pixelBits + 7 ) / 8;
+    size_t rawSize = (size_t) height * ( stride + 1 );
+    std::vector<unsigned char> raw;
+
+    // The stream may not inflate to more than the rows, so a corrupt or
+    // hostile file cannot exhaust memory
+    raw.reserve( rawSize );
+
+    if ( !CInflater( &stream[0], stream.size(), rawSize ).Inflate( raw ) || raw.size() != rawSize )
+      return false;
+
+    if ( !UnfilterRows( &raw[0], height, (int) stride, std::max( pixelBits / 8, 1 ) ) )
+      return false;
+
+    // Transparent color of gray and RGB images, in the sample depth
+    int maxSample = ( 1 << depth ) - 1;
+    bool hasKey = ( ( colorType == 0 && transparency.size() >= 2 ) || ( colorType == 2 && transparency.size() >= 6 ) );
+    int key[3] = { 0, 0, 0 };
+
+    for ( int c = 0; hasKey && c < channels; c++ )
+      key[c] = ( transparency[c * 2] << 8 ) | transparency[c * 2 + 1];
+
+    aBitmap.resize( (size_t) width * height * 4 );
+
+    for ( int y = 0; y < height; y++ ) {
+      const unsigned char* row = &raw[y * ( stride + 1 ) + 1];
+      unsigned char* output = &aBitmap[(size_t) y * width * 4];
+
+      for ( int x = 0; x < width; x++, output += 4 ) {
+        int samples[4] = { 0, 0, 0, 0 }, full[4] = { 0, 0, 0, 0 };
+
+        // Samples reduced to 8 bits and at their full depth
+        for ( int c = 0; c < channels; c++ ) {
+          if ( depth == 16 ) {
+            const unsigned char* sample = row + ( x * channels + c ) * 2;
+            full[c] = ( sample[0] << 8 ) | sample[1];
+            samples[c] = sample[0];
+          } else if ( depth == 8 )
+            full[c] = samples[c] = row[x * channels + c];
+          else {
+            int bit = x * depth;
+            full[c] = ( row[bit >> 3] >> ( 8 - depth - ( bit & 7 ) ) ) & maxSample;
+            samples[c] = ( colorType == 3 ? full[c] : full[c] * 255 / maxSample );
+          }
+        }
+
+        int red, green, blue, alpha = 255;
+
+        switch ( colorType ) {
+          case 0:
+            red = green = blue = samples[0];
+            alpha = ( hasKey && full[0] == key[0] ? 0 : 255 );
+            break;
+
+          case 2:
+            red = samples[0];
+            green = samples[1];
+            blue = samples[2];
+            alpha = ( hasKey && full[0] == key[0] && full[1] == key[1] && full[2] == key[2] ? 0 : 255 );
+            break;
+
+          case 3:
+            if ( samples[0] * 3 + 2 >= (int) palette.size() )
+              return false;
+
+            red = palette[samples[0] * 3];
+            green = palette[samples[0] * 3 + 1];
+            blue = palette[samples[0] * 3 + 2];
+            alpha = ( samples[0] < (int) transparency.size() ? transparency[samples[0]] : 255 );
+            break;
+
+          case 4:
+            red = green = blue = samples[0];
+            alpha = samples[1];
+            break;
+
+          default:
+            red = samples[0];
+            green = samples[1];
+            blue = samples[2];
+            alpha = samples[3];
+            break;
+        }
+
+        output[0] = (unsigned char) blue;
+        output[1] = (unsigned char) green;
+        output[2] = (unsigned char) red;
+        output[3] = (unsigned char) alpha;
+      }
+    }
+
+    aWidth = width;
+    aHeight = height;
+
+    return true;
+  }
+
+  bool CPngFile::Save( const char* aFileName, const unsigned char* aBitmap, int aWidth, int aHeight ) {
+    std::string data;
+    Encode( aBitmap, aWidth, aHeight, data );
+
+    HANDLE file = CreateFileA( aFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+
+    if ( file == INVALID_HANDLE_VALUE )
+      return false;
+
+    DWORD written;
+    bool result = ( WriteFile( file, data.data(), (DWORD) data.size(), &written, NULL ) && written == data.size() );
+    CloseHandle( file );
+
+    return result;
+  }
+
+  bool CPngFile::Load( const char* aFileName, std::vector<unsigned char>& aBitmap, int& aWidth, int& aHeight ) {
+    std::vector<unsigned char> data;
+
+    return ( ReadWholeFile( aFileName, data ) && !data.empty() &&
+             Decode( &data[0], data.size(), aBitmap, aWidth, aHeight ) );
+  }
+
+  void CPngFile::SaveProc( void* aContext, int aBegin, int aEnd ) {
+    JOBLIST<SAVEJOB>* list = (JOBLIST<SAVEJOB>*) aContext;
+    int count = (int) list->jobs->size();
+
+    // Files are taken one by one rather than by the given range, as
+    // their sizes may differ a lot
+    for ( int i = InterlockedIncrement( &list->next ) - 1; i < count; i = InterlockedIncrement( &list->next ) - 1 ) {
+      SAVEJOB& job = (*list->jobs)[i];
+      job.result = ( job.bitmap && Save( job.fileName.c_str(), job.bitmap, job.width, job.height ) );
+    }
+  }
+
+  void CPngFile::LoadProc( void* aContext, int aBegin, int aEnd ) {
+    JOBLIST<LOADJOB>* list = (JOBLIST<LOADJOB>*) aContext;
+    int count = (int) list->jobs->size();
+
+    for ( int i = InterlockedIncrement( &list->next ) - 1; i < count; i = InterlockedIncrement( &list->next ) - 1 ) {
+      LOADJOB& job = (*list->jobs)[i];
+
+      job.width = 0;
+      job.height = 0;
+      job.result = Load( job.fileName.c_str(), job.bitmap, job.width, job.height );
+
+      if ( !job.result )
+        std::vector<unsigned char>().swap( job.bitmap );
+    }
+  }
+
+  int CPngFile::SaveMany( std::vector<SAVEJOB>& aJobs ) {
+    JOBLIST<SAVEJOB> list = { &aJobs, 0 };
+    int result = 0;
+
+    // The CRC table is filled before the threads start
+    UpdateCrc( 0, NULL, 0 );
+    CParallel::For( (int) aJobs.size(), 1, SaveProc, &list );
+
+    for ( size_t i = 0; i < aJobs.size(); i++ )
+      result += ( aJobs[i].result ? 1 : 0 );
+
+    return result;
+  }
+
+  int CPngFile::LoadMany( std::vector<LOADJOB>& aJobs ) {
+    JOBLIST<LOADJOB> list = { &aJobs, 0 };
+    int result = 0;
+
+    CParallel::For( (int) aJobs.size(), 1, LoadProc, &list );
+
+    for ( size_t i = 0; i < aJobs.size(); i++ )
+      result += ( aJobs[i].result ? 1 : 0 );
+
+    return result;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void SpriteSavePng( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( 0.0 );
+
+      try {
+        ISprite& sprite = CGMAPI::Ptr()->Sprites[(int) aArgs[0].real];
+        int subimage = (int) aArgs[1].real;
+        int width = sprite.GetWidth(), height = sprite.GetHeight();
+
+        if ( subimage >= 0 ) {
+          if ( subimage < sprite.Subimages.GetCount() && sprite.Subimages[subimage].GetBitmap() )
+            aResult->Set( CPngFile::Save( aArgs[2].string, sprite.Subimages[subimage].GetBitmap(), width,
+                                          height ) ? 1.0 : 0.0 );
+          return;
+        }
+
+        // Strip of all subimages, like sprite_save_strip
+        int count = sprite.Subimages.GetCount();
+        std::vector<unsigned char> strip( width * count * height * 4 );
+
+        for ( int i = 0; i < count; i++ ) {
+          const unsigned char* bitmap = sprite.Subimages[i].GetBitmap();
+
+          if ( !bitmap )
+            return;
+
+          for ( int y = 0; y < height; y++ )
+            memcpy( &strip[( y * width * count + i * width ) * 4], bitmap + y * width * 4, width * 4 );
+        }
+
+        if ( count > 0 )
+          aResult->Set( CPngFile::Save( aArgs[2].string, &strip[0], width * count, height ) ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SpriteSavePng )
+
+    void BackgroundSavePng( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( 0.0 );
+
+      try {
+        IBackground& background = CGMAPI::Ptr()->Backgrounds[(int) aArgs[0].real];
+
+        if ( background.GetBitmap() )
+          aResult->Set( CPngFile::Save( aArgs[1].string, background.GetBitmap(), background.GetWidth(),
+                                        background.GetHeight() ) ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( BackgroundSavePng )
+
+    void ResourcesSavePng( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      std::string directory( aArgs[0].string );
+      std::vector<CPngFile::SAVEJOB> jobs;
+      char number[16];
+
+      if ( !directory.empty() && directory[directory.size() - 1] != '\\' && directory[directory.size() - 1] != '/' )
+        directory += '\\';
+
+      // Bitmaps are collected here, as the resource interfaces must not be
+      // used by the worker threads
+      for ( int i = 0; i < CGMAPI::Ptr()->Sprites.GetArraySize(); i++ ) {
+        if ( !CGMAPI::Ptr()->Sprites.Exists( i ) )
+          continue;
+
+        ISprite& sprite = CGMAPI::Ptr()->Sprites[i];
+
+        for ( int n = 0; n < sprite.Subimages.GetCount(); n++ ) {
+          CPngFile::SAVEJOB job;
+
+          sprintf_s( number, sizeof( number ), "_%d.png", n );
+          job.fileName = directory + sprite.GetName() + number;
+          job.bitmap = sprite.Subimages[n].GetBitmap();
+          job.width = sprite.GetWidth();
+          job.height = sprite.GetHeight();
+          job.result = false;
+          jobs.push_back( job );
+        }
+      }
+
+      for ( int i = 0; i < CGMAPI::Ptr()->Backgrounds.GetArraySize(); i++ ) {
+        if ( !CGMAPI::Ptr()->Backgrounds.Exists( i ) )
+          continue;
+
+        IBackground& background = CGMAPI::Ptr()->Backgrounds[i];
+        CPngFile::SAVEJOB job;
+
+        job.fileName = directory + background.GetName() + ".png";
+        job.bitmap = background.GetBitmap();
+        job.width = background.GetWidth();
+        job.height = background.GetHeight();
+        job.result = false;
+        jobs.push_back( job );
+      }
+
+      aResult->Set( (double) CPngFile::SaveMany( jobs ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( ResourcesSavePng )
+
+    // Copies the image to the bitmap if their sizes are equal
+    bool ReplaceBitmap( unsigned char* aBitmap, int aWidth, int aHeight, const char* aFileName ) {
+      std::vector<unsigned char> image;
+      int width, height;
+
+      if ( !aBitmap || !CPngFile::Load( aFileName, image, width, height ) || width != aWidth || height != aHeight )
+        return false;
+
+      memcpy( aBitmap, &image[0], image.size() );
+      return true;
+    }
+
+    void SpriteLoadPng( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                        int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( 0.0 );
+
+      try {
+        ISprite& sprite = CGMAPI::Ptr()->Sprites[(int) aArgs[0].real];
+        int subimage = (int) aArgs[1].real;
+
+        if ( subimage >= 0 && subimage < sprite.Subimages.GetCount() )
+          aResult->Set( ReplaceBitmap( sprite.Subimages[subimage].GetBitmap(), sprite.GetWidth(), sprite.GetHeight(),
+                                       aArgs[2].string ) ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SpriteLoadPng )
+
+    void BackgroundLoadPng( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( 0.0 );
+
+      try {
+        IBackground& background = CGMAPI::Ptr()->Backgrounds[(int) aArgs[0].real];
+
+        aResult->Set( ReplaceBitmap( background.GetBitmap(), background.GetWidth(), background.GetHeight(),
+                                     aArgs[1].string ) ? 1.0 : 0.0 );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( BackgroundLoadPng )
+  }
+
+  void CPngFile::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+
+    GMAPI_GMFUNCTION_REGISTER( "sprite_save_png", 3, SpriteSavePng );
+    GMAPI_GMFUNCTION_REGISTER( "background_save_png", 2, BackgroundSavePng );
+    GMAPI_GMFUNCTION_REGISTER( "resources_save_png", 1, ResourcesSavePng );
+    GMAPI_GMFUNCTION_REGISTER( "sprite_load_png", 3, SpriteLoadPng );
+    GMAPI_GMFUNCTION_REGISTER( "background_load_png", 2, BackgroundLoadPng );
+  }
+
+#endif
+
+}
@@ -0,0 +1,140 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiPng.h                                                          */
+/*   - PNG files of 32bit ARGB bitmaps                                  */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include <string>
+#include <vector>
+
+namespace gm {
+
+  /// CPngFile
+  ///   Native PNG codec for bitmaps in the format of
+  ///   ISpriteSubimage::GetBitmap (rows of 0xAARRGGBB pixels). Written
+  ///   files are 8-bit RGBA images compressed by deflate with dynamic
+  ///   Huffman codes; rows are filtered by the type giving the smallest
+  ///   sum of differences. Decoding accepts all non-interlaced images
+  ///   (any color type and bit depth, with tRNS transparency).
+  ///
+  ///   The codec does not call the runner, so it may be used from worker
+  ///   threads; SaveMany and LoadMany process lists of files on all
+  ///   processors.
+  ///
+  class CPngFile {
+    public:
+      /// File of SaveMany
+      struct SAVEJOB {
+        std::string fileName;
+        const unsigned char* bitmap;
+        int width;
+        int height;
+        bool result;         // Set by SaveMany
+      };
+
+      /// File of LoadMany; all fields except fileName are set by LoadMany
+      struct LOADJOB {
+        std::string fileName;
+        std::vector<unsigned char> bitmap;
+        int width;
+        int height;
+        bool result;
+      };
+
+      /// Encode( const unsigned char* aBitmap, int aWidth, int aHeight, std::string& aData )
+      ///   Stores PNG image of the bitmap to aData.
+      ///
+      static void Encode( const unsigned char* aBitmap, int aWidth, int aHeight, std::string& aData );
+
+      /// Decode( const unsigned char* aData, size_t aSize, std::vector<unsigned char>& aBitmap,
+      ///         int& aWidth, int& aHeight )
+      ///   Decodes PNG image to 32bit ARGB bitmap.
+      ///
+      /// Returns:
+      ///   False if the data are not a valid or supported PNG image.
+      ///
+      static bool Decode( const unsigned char* aData, size_t aSize, std::vector<unsigned char>& aBitmap,
+                          int& aWidth, int& aHeight );
+
+      /// Save( const char* aFileName, const unsigned char* aBitmap, int aWidth, int aHeight )
+      ///   Writes PNG image of the bitmap to the file.
+      ///
+      /// Returns:
+      ///   False if the file could not be written.
+      ///
+      static bool Save( const char* aFileName, const unsigned char* aBitmap, int aWidth, int aHeight );
+
+      /// Load( const char* aFileName, std::vector<unsigned char>& aBitmap, int& aWidth, int& aHeight )
+      ///   Reads PNG image from the file.
+      ///
+      /// Returns:
+      ///   False if the file could not be read or decoded.
+      ///
+      static bool Load( const char* aFileName, std::vector<unsigned char>& aBitmap, int& aWidth, int& aHeight );
+
+      /// SaveMany( std::vector<SAVEJOB>& aJobs )
+      ///   Saves the files in parallel; the bitmaps must not change until
+      ///   the function returns.
+      ///
+      /// Returns:
+      ///   Number of written files.
+      ///
+      static int SaveMany( std::vector<SAVEJOB>& aJobs );
+
+      /// LoadMany( std::vector<LOADJOB>& aJobs )
+      ///   Loads the files in parallel.
+      ///
+      /// Returns:
+      ///   Number of decoded files.
+      ///
+      static int LoadMany( std::vector<LOADJOB>& aJobs );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers the following GML functions:
+      ///     sprite_save_png( ind, subimg, fname ) - saves the subimage or,
+      ///       if subimg is -1, horizontal strip of all subimages
+      ///     background_save_png( ind, fname ) - saves the background
+      ///     resources_save_png( dir ) - saves every subimage of every
+      ///       sprite (as name_subimg.png) and every background (as
+      ///       name.png) to the directory; returns number of saved files
+      ///     sprite_load_png( ind, subimg, fname ) - replaces bitmap of the
+      ///       subimage by the image, which must be of the same size
+      ///     background_load_png( ind, fname ) - replaces bitmap of the
+      ///       background by the image, which must be of the same size
+      ///   All of them return true on success. Loaded bitmaps do not
+      ///   change textures the runner has already created.
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      static void AppendChunk( std::string& aData, const char* aType, const std::string& aContent );
+      static void FilterRows( const unsigned char* aBitmap, int aWidth, int aHeight, std::string& aRaw );
+      static bool UnfilterRows( unsigned char* aRaw, int aHeight, int aStride, int aPixelSize );
+      static void SaveProc( void* aContext, int aBegin, int aEnd );
+      static void LoadProc( void* aContext, int aBegin, int aEnd );
+  };
+
+}
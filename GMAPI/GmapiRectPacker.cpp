@@ -0,0 +1,231 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiRectPacker.cpp                                                 */
+/*   - Packing of rectangles into texture pages                         */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiRectPacker.h"
+
+#include <limits.h>
+#include <algorithm>
+
+namespace gm {
+
+  namespace {
+    struct RectOrder {
+      const std::vector<CRectPacker::RECTANGLE>* rects;
+
+      bool operator()( int aFirst, int aSecond ) const {
+        const CRectPacker::RECTANGLE& first = (*rects)[aFirst];
+        const CRectPacker::RECTANGLE& second = (*rects)[aSecond];
+
+        if ( first.height != second.height )
+          return ( first.height > second.height );
+
+        return ( first.width > second.width );
+      }
+    };
+
+    int RoundUpPowerOfTwo( int aValue ) {
+      int result = 1;
+
+      while ( result < aValue )
+        result <<= 1;
+
+      return result;
+    }
+  }
+
+  /************************************************************************/
+  /* CRectPacker class implementation                                     */
+  /************************************************************************/
+
+  bool CRectPacker::Place( PAGE& aPage, int aWidth, int aHeight, int& aLeft, int& aTop ) {
+    int bestShort = INT_MAX, bestLong = INT_MAX;
+
+    for ( size_t i = 0; i < aPage.free.size(); i++ ) {
+      const AREA& rect = aPage.free[i];
+
+      if ( rect.width < aWidth || rect.height < aHeight )
+        continue;
+
+      int leftoverX = rect.width - aWidth;
+      int leftoverY = rect.height - aHeight;
+      int shortSide = std::min( leftoverX, leftoverY );
+      int longSide = std::max( leftoverX, leftoverY );
+
+      if ( shortSide < bestShort || ( shortSide == bestShort && longSide < bestLong ) ) {
+        aLeft = rect.left;
+        aTop = rect.top;
+        bestShort = shortSide;
+        bestLong = longSide;
+      }
+    }
+
+    if ( bestShort == INT_MAX )
+      return false;
+
+    AREA used = { aLeft, aTop, aWidth, aHeight };
+    SplitFreeRects( aPage, used );
+
+    return true;
+  }
+
+  void CRectPacker::SplitFreeRects( PAGE& aPage, const AREA& aUsed ) {
+    std::vector<AREA> parts;
+    size_t kept = 0;
+
+    // Free rectangles overlapping the used one are replaced by up to four
+    // maximal rectangles around it
+    for ( size_t i = 0; i < aPage.free.size(); i++ ) {
+      const AREA& rect = aPage.free[i];
+
+      if ( aUsed.left >= rect.left + rect.width || aUsed.left + aUsed.width <= rect.left ||
+           aUsed.top >= rect.top + rect.height || aUsed.top + aUsed.height <= rect.top ) {
+        aPage.free[kept++] = rect;
+        continue;
+      }
+
+      if ( aUsed.left > rect.left ) {
+        AREA part = { rect.left, rect.top, aUsed.left - rect.left, rect.height };
+        parts.push_back( part );
+      }
+
+      if ( aUsed.left + aUsed.width < rect.left + rect.width ) {
+        AREA part = { aUsed.left + aUsed.width, rect.top,
+                      rect.left + rect.width - aUsed.left - aUsed.width, rect.height };
+        parts.push_back( part );
+      }
+
+      if ( aUsed.top > rect.top ) {
+        AREA part = { rect.left, rect.top, rect.width, aUsed.top - rect.top };
+        parts.push_back( part );
+      }
+
+      if ( aUsed.top + aUsed.height < rect.top + rect.height ) {
+        AREA part = { rect.left, aUsed.top + aUsed.height, rect.width,
+                      rect.top + rect.height - aUsed.top - aUsed.height };
+        parts.push_back( part );
+      }
+    }
+
+    // The kept rectangles do not contain each other and cannot be
+    // contained in the new parts, which lie inside the rectangles they
+    // come from; only the new parts have to be checked
+    aPage.free.resize( kept );
+
+    for ( size_t i = 0; i < parts.size(); i++ ) {
+      const AREA& rect = parts[i];
+      bool contained = false;
+
+      for ( size_t j = 0; j < kept && !contained; j++ )
+        contained = Contains( aPage.free[j], rect );
+
+      // Of two equal parts the first one is kept
+      for ( size_t j = 0; j < parts.size() && !contained; j++ )
+        contained = ( i != j && Contains( parts[j], rect ) && ( j < i || !Contains( rect, parts[j] ) ) );
+
+      if ( !contained )
+        aPage.free.push_back( rect );
+    }
+  }
+
+  bool CRectPacker::Pack( std::vector<RECTANGLE>& aRects, int aPageSize, int aPadding, int aExtrude,
+                          std::vector< std::pair<int, int> >& aPageSizes ) {
+    bool result = true;
+    std::vector<PAGE> pages;
+    std::vector<int> order;
+
+    order.reserve( aRects.size() );
+
+    for ( size_t i = 0; i < aRects.size(); i++ ) {
+      aRects[i].page = -1;
+
+      if ( aRects[i].width > 0 && aRects[i].height > 0 )
+        order.push_back( (int) i );
+    }
+
+    RectOrder compare = { &aRects };
+    std::sort( order.begin(), order.end(), compare );
+
+    for ( size_t i = 0; i < order.size(); i++ ) {
+      RECTANGLE& rect = aRects[order[i]];
+      int width = rect.width + 2 * aExtrude + aPadding;
+      int height = rect.height + 2 * aExtrude + aPadding;
+      int left = 0, top = 0;
+
+      if ( width > aPageSize || height > aPageSize ) {
+        result = false;
+        continue;
+      }
+
+      for ( size_t page = 0; page < pages.size() && rect.page < 0; page++ ) {
+        if ( Place( pages[page], width, height, left, top ) )
+          rect.page = (int) page;
+      }
+
+      if ( rect.page < 0 ) {
+        PAGE page;
+        AREA all = { 0, 0, aPageSize, aPageSize };
+
+        page.width = 0;
+        page.height = 0;
+        page.free.push_back( all );
+        pages.push_back( page );
+
+        Place( pages.back(), width, height, left, top );
+        rect.page = (int) pages.size() - 1;
+      }
+
+      rect.left = left + aExtrude;
+      rect.top = top + aExtrude;
+
+      // Padding at the right and bottom edges of the page is not needed
+      PAGE& page = pages[rect.page];
+      page.width = std::max( page.width, left + width - aPadding );
+      page.height = std::max( page.height, top + height - aPadding );
+    }
+
+    aPageSizes.clear();
+
+    for ( size_t i = 0; i < pages.size(); i++ )
+      aPageSizes.push_back( std::make_pair( RoundUpPowerOfTwo( pages[i].width ), RoundUpPowerOfTwo( pages[i].height ) ) );
+
+    for ( size_t i = 0; i < aRects.size(); i++ ) {
+      RECTANGLE& rect = aRects[i];
+
+      if ( rect.page < 0 )
+        continue;
+
+      double width = aPageSizes[rect.page].first, height = aPageSizes[rect.page].second;
+
+      rect.u0 = rect.left / width;
+      rect.v0 = rect.top / height;
+      rect.u1 = ( rect.left + rect.width ) / width;
+      rect.v1 = ( rect.top + rect.height ) / height;
+    }
+
+    return result;
+  }
+
+}
@@ -0,0 +1,96 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiRectPacker.h                                                   */
+/*   - Packing of rectangles into texture pages                         */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include <utility>
+#include <vector>
+
+namespace gm {
+
+  /// CRectPacker
+  ///   Packs rectangles into square pages by the MaxRects algorithm with
+  ///   the best short side fit, placing the highest rectangles first. A
+  ///   new page is started when a rectangle does not fit into any of the
+  ///   previous ones. It does not depend on the runner; CTextureAtlas
+  ///   uses it to lay out subimages.
+  ///
+  ///   Every rectangle is surrounded by aExtrude pixels and separated from
+  ///   the others by aPadding pixels. After packing, pages are shrunk to
+  ///   the smallest power of two sizes holding their rectangles.
+  ///
+  class CRectPacker {
+    public:
+      /// Rectangle of Pack
+      struct RECTANGLE {
+        int width;         // Size, set by the caller
+        int height;
+        int page;          // -1 if the rectangle did not fit
+        int left;          // Position without extrusion
+        int top;
+        double u0;         // Texture coordinates in the page
+        double v0;
+        double u1;
+        double v1;
+      };
+
+      /// Pack( std::vector<RECTANGLE>& aRects, int aPageSize, int aPadding, int aExtrude,
+      ///       std::vector< std::pair<int, int> >& aPageSizes )
+      ///   Places the rectangles into pages of aPageSize and sets their
+      ///   page, position and texture coordinates. Rectangles without an
+      ///   area are skipped. aPageSizes receives widths and heights of the
+      ///   pages.
+      ///
+      /// Returns:
+      ///   False if some rectangles are larger than a page.
+      ///
+      static bool Pack( std::vector<RECTANGLE>& aRects, int aPageSize, int aPadding, int aExtrude,
+                        std::vector< std::pair<int, int> >& aPageSizes );
+
+    private:
+      struct AREA {
+        int left;
+        int top;
+        int width;
+        int height;
+      };
+
+      struct PAGE {
+        int width;                          // Used part of the page
+        int height;
+        std::vector<AREA> free;             // Free rectangles of MaxRects
+      };
+
+      static bool Contains( const AREA& aOuter, const AREA& aInner ) {
+        return ( aInner.left >= aOuter.left && aInner.top >= aOuter.top &&
+                 aInner.left + aInner.width <= aOuter.left + aOuter.width &&
+                 aInner.top + aInner.height <= aOuter.top + aOuter.height );
+      }
+
+      static bool Place( PAGE& aPage, int aWidth, int aHeight, int& aLeft, int& aTop );
+      static void SplitFreeRects( PAGE& aPage, const AREA& aUsed );
+  };
+
+}
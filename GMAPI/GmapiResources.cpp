@@ -25,6 +25,8 @@
 /************************************************************************/
 
 #include "GmapiResources.h"
+#include "GmapiPathSampler.h"
+#include "GmapiBitmapStore.h"
 #include "GmapiMacros.h"
 #include "GmapiConsts.h"
 
@@ -155,6 +157,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, mode };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_set_bbox_mode );
   }
 
@@ -163,6 +166,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, left, top, right, bottom };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_set_bbox );
   }
 
@@ -170,6 +174,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, mode };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_set_precise );
   }
 
@@ -177,6 +182,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_duplicate );
     GM_RETURN_INT;
   }
@@ -185,6 +191,8 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, spr };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, spr );
+    CBitmapStore::Forget( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_assign );
   }
 
@@ -192,6 +200,8 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind1, ind2 };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind1 );
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind2 );
     GM_NORMAL_CALL( id_sprite_merge );
   }
 
@@ -237,6 +247,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, fname, imgnumb, precise, transparent, smooth, preload, xorig, yorig };
 
+    CBitmapStore::Forget( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_replace );
   }
 
@@ -246,6 +257,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, fname, imgnumb, removeback, smooth, xorig, yorig };
 
+    CBitmapStore::Forget( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_replace );
   }
 
@@ -253,6 +265,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, fname };
 
+    CBitmapStore::Forget( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_replace_sprite );
   }
 
@@ -262,6 +275,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, fname, imgnumb, precise, preload, xorig, yorig };
 
+    CBitmapStore::Forget( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_replace_alpha );
   }
 
@@ -289,6 +303,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, x, y, w, h };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_add_from_screen );
   }
 
@@ -297,6 +312,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, x, y, w, h, removeback, smooth };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_add_from_screen );
   }
 
@@ -326,6 +342,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, id, x, y, w, h };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_add_from_surface );
   }
 
@@ -334,6 +351,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, id, x, y, w, h, removeback, smooth };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_add_from_surface );
   }
 
@@ -341,6 +359,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind };
 
+    CBitmapStore::Forget( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_delete );
   }
 
@@ -348,6 +367,8 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, spr };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, spr );
     GM_NORMAL_CALL( id_sprite_set_alpha_from_sprite );
   }
 
@@ -357,6 +378,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, sepmasks, bboxmode, bbleft, bbright, bbtop, bbbottom, kind, tolerance };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_collision_mask );
   }
 
@@ -387,6 +409,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind };
 
+    CBitmapStore::Restore( CBitmapStore::RK_BACKGROUND, ind );
     GM_NORMAL_CALL( id_background_duplicate );
     GM_RETURN_INT;
   }
@@ -395,6 +418,8 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, back };
 
+    CBitmapStore::Restore( CBitmapStore::RK_BACKGROUND, back );
+    CBitmapStore::Forget( CBitmapStore::RK_BACKGROUND, ind );
     GM_NORMAL_CALL( id_background_assign );
   }
 
@@ -436,6 +461,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, fname, transparent, smooth, preload };
 
+    CBitmapStore::Forget( CBitmapStore::RK_BACKGROUND, ind );
     GM_NORMAL_CALL( id_background_replace );
   }
 
@@ -444,6 +470,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, fname, removeback, smooth };
 
+    CBitmapStore::Forget( CBitmapStore::RK_BACKGROUND, ind );
     GM_NORMAL_CALL( id_background_replace );
   }
 
@@ -451,6 +478,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, fname };
 
+    CBitmapStore::Forget( CBitmapStore::RK_BACKGROUND, ind );
     GM_NORMAL_CALL( id_background_replace_background );
   }
 
@@ -458,6 +486,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, fname, preload };
 
+    CBitmapStore::Forget( CBitmapStore::RK_BACKGROUND, ind );
     GM_NORMAL_CALL( id_background_replace_alpha );
   }
 
@@ -537,6 +566,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind };
 
+    CBitmapStore::Forget( CBitmapStore::RK_BACKGROUND, ind );
     GM_NORMAL_CALL( id_background_delete );
   }
 
@@ -544,6 +574,8 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, back };
 
+    CBitmapStore::Restore( CBitmapStore::RK_BACKGROUND, ind );
+    CBitmapStore::Restore( CBitmapStore::RK_BACKGROUND, back );
     GM_NORMAL_CALL( id_background_set_alpha_from_background );
   }
 
@@ -592,6 +624,7 @@ namespace gm {
     GM_ARGS{ ind, val };
 
     GM_NORMAL_CALL( id_path_set_kind );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_set_closed( int ind, bool closed ) {
@@ -599,6 +632,7 @@ namespace gm {
     GM_ARGS{ ind, closed };
 
     GM_NORMAL_CALL( id_path_set_closed );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_set_precision( int ind, int prec ) {
@@ -606,12 +640,14 @@ namespace gm {
     GM_ARGS{ ind, prec };
 
     GM_NORMAL_CALL( id_path_set_precision );
+    CPathSampler::Invalidate( ind );
   }
 
   int path_add() {
     GM_NORMAL_RESULT;
 
     GM_VOID_CALL( id_path_add );
+    CPathSampler::Invalidate( (int) result.real );
     GM_RETURN_INT;
   }
 
@@ -620,6 +656,7 @@ namespace gm {
     GM_ARGS{ ind };
 
     GM_NORMAL_CALL( id_path_delete );
+    CPathSampler::Invalidate( ind );
   }
 
   int path_duplicate( int ind ) {
@@ -627,6 +664,7 @@ namespace gm {
     GM_ARGS{ ind };
 
     GM_NORMAL_CALL( id_path_duplicate );
+    CPathSampler::Invalidate( (int) result.real );
     GM_RETURN_INT;
   }
 
@@ -635,6 +673,7 @@ namespace gm {
     GM_ARGS{ ind, path };
 
     GM_NORMAL_CALL( id_path_assign );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_append( int ind, int path ) {
@@ -642,6 +681,7 @@ namespace gm {
     GM_ARGS{ ind, path };
 
     GM_NORMAL_CALL( id_path_append );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_add_point( int ind, double x, double y, double speed ) {
@@ -649,6 +689,7 @@ namespace gm {
     GM_ARGS{ ind, x, y, speed };
 
     GM_NORMAL_CALL( id_path_add_point );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_insert_point( int ind, int n, double x, double y,
@@ -657,6 +698,7 @@ namespace gm {
     GM_ARGS{ ind, n, x, y, speed };
 
     GM_NORMAL_CALL( id_path_insert_point );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_change_point( int ind, int n, double x, double y,
@@ -665,6 +707,7 @@ namespace gm {
     GM_ARGS{ ind, n, x, y, speed };
 
     GM_NORMAL_CALL( id_path_change_point );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_delete_point( int ind, int n ) {
@@ -672,6 +715,7 @@ namespace gm {
     GM_ARGS{ ind, n };
 
     GM_NORMAL_CALL( id_path_delete_point );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_clear_points( int ind ) {
@@ -679,6 +723,7 @@ namespace gm {
     GM_ARGS{ ind };
 
     GM_NORMAL_CALL( id_path_clear_points );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_reverse( int ind ) {
@@ -686,6 +731,7 @@ namespace gm {
     GM_ARGS{ ind };
 
     GM_NORMAL_CALL( id_path_reverse );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_mirror( int ind ) {
@@ -693,6 +739,7 @@ namespace gm {
     GM_ARGS{ ind };
 
     GM_NORMAL_CALL( id_path_mirror );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_flip( int ind ) {
@@ -700,6 +747,7 @@ namespace gm {
     GM_ARGS{ ind };
 
     GM_NORMAL_CALL( id_path_flip );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_rotate( int ind, double angle ) {
@@ -707,6 +755,7 @@ namespace gm {
     GM_ARGS{ ind, angle };
 
     GM_NORMAL_CALL( id_path_rotate );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_scale( int ind, double xscale, double yscale ) {
@@ -714,6 +763,7 @@ namespace gm {
     GM_ARGS{ ind, xscale, yscale };
 
     GM_NORMAL_CALL( id_path_scale );
+    CPathSampler::Invalidate( ind );
   }
 
   void path_shift( int ind, double xshift, double yshift ) {
@@ -721,6 +771,7 @@ namespace gm {
     GM_ARGS{ ind, xshift, yshift };
 
     GM_NORMAL_CALL( id_path_shift );
+    CPathSampler::Invalidate( ind );
   }
 
   int timeline_add() {
@@ -1103,6 +1154,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, subimg, fname };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_save );
   }
 
@@ -1110,6 +1162,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, fname };
 
+    CBitmapStore::Restore( CBitmapStore::RK_SPRITE, ind );
     GM_NORMAL_CALL( id_sprite_save_strip );
   }
 
@@ -1219,6 +1272,7 @@ namespace gm {
     GM_NORMAL_RESULT;
     GM_ARGS{ ind, fname };
 
+    CBitmapStore::Restore( CBitmapStore::RK_BACKGROUND, ind );
     GM_NORMAL_CALL( id_background_save );
   }
 
@@ -0,0 +1,371 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiSpriteDedup.cpp                                                */
+/*   - Detection of duplicate sprite subimages                          */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiSpriteDedup.h"
+#include "GmapiUtilities.h"
+#include "GmapiMacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+namespace gm {
+
+  std::vector<CSpriteDedup::SUBIMAGE> CSpriteDedup::m_subimages;
+  CSpriteDedup::SubimageMap CSpriteDedup::m_index;
+
+  namespace {
+    // Size of the grid of the perceptual hash; each row gives 8 bits
+    static const int GRID_WIDTH = 9;
+    static const int GRID_HEIGHT = 8;
+    // Largest difference of channels of average colors of near duplicates
+    static const int MAX_AVERAGE_DIFFERENCE = 12;
+    // Smallest number of subimages hashed by one thread
+    static const int PARALLEL_SUBIMAGES = 16;
+
+    int CountBits( unsigned long aValue ) {
+      aValue = aValue - ( ( aValue >> 1 ) & 0x55555555 );
+      aValue = ( aValue & 0x33333333 ) + ( ( aValue >> 2 ) & 0x33333333 );
+      aValue = ( aValue + ( aValue >> 4 ) ) & 0x0F0F0F0F;
+
+      return (int) ( ( aValue * 0x01010101 ) >> 24 ) & 0xFF;
+    }
+
+    bool AveragesClose( unsigned long aFirst, unsigned long aSecond ) {
+      for ( int shift = 0; shift < 32; shift += 8 ) {
+        if ( abs( (int) ( ( aFirst >> shift ) & 0xFF ) - (int) ( ( aSecond >> shift ) & 0xFF ) ) > MAX_AVERAGE_DIFFERENCE )
+          return false;
+      }
+
+      return true;
+    }
+
+    struct ExactOrder {
+      const std::vector<CSpriteDedup::SUBIMAGE>* subimages;
+
+      bool operator()( int aFirst, int aSecond ) const {
+        const CSpriteDedup::SUBIMAGE& first = (*subimages)[aFirst];
+        const CSpriteDedup::SUBIMAGE& second = (*subimages)[aSecond];
+
+        if ( first.width != second.width )
+          return ( first.width < second.width );
+
+        if ( first.height != second.height )
+          return ( first.height < second.height );
+
+        if ( first.hash[0] != second.hash[0] )
+          return ( first.hash[0] < second.hash[0] );
+
+        if ( first.hash[1] != second.hash[1] )
+          return ( first.hash[1] < second.hash[1] );
+
+        return ( aFirst < aSecond );
+      }
+    };
+  }
+
+  /************************************************************************/
+  /* CSpriteDedup class implementation                                    */
+  /************************************************************************/
+
+  void CSpriteDedup::HashProc( void* aContext, int aBegin, int aEnd ) {
+    HASHJOB* job = (HASHJOB*) aContext;
+
+    for ( int i = aBegin; i < aEnd; i++ ) {
+      SUBIMAGE& subimage = job->subimages[i];
+      const DWORD* pixels = (const DWORD*) job->bitmaps[i];
+      int count = subimage.width * subimage.height;
+
+      // Two independent 32-bit hashes of the pixels and sums of their
+      // channels
+      DWORD first = 2166136261UL, second = 0x9E3779B9UL;
+      double sums[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+      for ( int p = 0; p < count; p++ ) {
+        DWORD pixel = pixels[p];
+
+        first = ( first ^ pixel ) * 16777619UL;
+        second = ( ( second << 5 ) | ( second >> 27 ) ) ^ pixel;
+        second *= 0x85EBCA6BUL;
+
+        sums[0] += pixel & 0xFF;
+        sums[1] += ( pixel >> 8 ) & 0xFF;
+        sums[2] += ( pixel >> 16 ) & 0xFF;
+        sums[3] += pixel >> 24;
+      }
+
+      subimage.hash[0] = first;
+      subimage.hash[1] = second;
+
+      // Brightness of the grid cells, weighted by alpha
+      double cells[GRID_HEIGHT][GRID_WIDTH];
+
+      for ( int gy = 0; gy < GRID_HEIGHT; gy++ ) {
+        int top = gy * subimage.height / GRID_HEIGHT;
+        int bottom = std::max( ( gy + 1 ) * subimage.height / GRID_HEIGHT, top + 1 );
+
+        for ( int gx = 0; gx < GRID_WIDTH; gx++ ) {
+          int left = gx * subimage.width / GRID_WIDTH;
+          int right = std::max( ( gx + 1 ) * subimage.width / GRID_WIDTH, left + 1 );
+          double sum = 0.0;
+
+          for ( int y = top; y < bottom; y++ ) {
+            const unsigned char* pixel = job->bitmaps[i] + ( y * subimage.width + left ) * 4;
+
+            for ( int x = left; x < right; x++, pixel += 4 )
+              sum += ( pixel[0] * 29 + pixel[1] * 150 + pixel[2] * 77 ) * pixel[3];
+          }
+
+          cells[gy][gx] = sum / ( ( bottom - top ) * ( right - left ) );
+        }
+      }
+
+      subimage.visual[0] = 0;
+      subimage.visual[1] = 0;
+      subimage.average = 0;
+
+      for ( int gy = 0; gy < GRID_HEIGHT; gy++ ) {
+        for ( int gx = 0; gx < GRID_WIDTH - 1; gx++ ) {
+          if ( cells[gy][gx] < cells[gy][gx + 1] )
+            subimage.visual[gy / 4] |= 1UL << ( ( gy % 4 ) * 8 + gx );
+        }
+      }
+
+      for ( int c = 0; c < 4; c++ )
+        subimage.average |= (unsigned long) ( sums[c] / std::max( count, 1 ) + 0.5 ) << ( c * 8 );
+    }
+  }
+
+  void CSpriteDedup::FindExact( const std::vector<const unsigned char*>& aBitmaps ) {
+    std::vector<int> order( m_subimages.size() );
+
+    for ( size_t i = 0; i < order.size(); i++ )
+      order[i] = (int) i;
+
+    ExactOrder compare = { &m_subimages };
+    std::sort( order.begin(), order.end(), compare );
+
+    // Runs of equal size and hash are split into groups of equal bitmaps;
+    // within a run the lowest index comes first and becomes the original
+    for ( size_t begin = 0, end; begin < order.size(); begin = end ) {
+      const SUBIMAGE& first = m_subimages[order[begin]];
+
+      for ( end = begin + 1; end < order.size(); end++ ) {
+        const SUBIMAGE& next = m_subimages[order[end]];
+
+        if ( next.width != first.width || next.height != first.height ||
+             next.hash[0] != first.hash[0] || next.hash[1] != first.hash[1] )
+          break;
+      }
+
+      for ( size_t i = begin + 1; i < end; i++ ) {
+        SUBIMAGE& subimage = m_subimages[order[i]];
+
+        for ( size_t j = begin; j < i; j++ ) {
+          int candidate = order[j];
+
+          if ( m_subimages[candidate].original < 0 &&
+               !memcmp( aBitmaps[order[i]], aBitmaps[candidate], subimage.width * subimage.height * 4 ) ) {
+            subimage.kind = MK_EXACT;
+            subimage.original = candidate;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  void CSpriteDedup::FindNear( int aMaxDistance ) {
+    std::map<std::pair<int, int>, std::vector<int> > sizes;
+
+    // Only subimages of the same size can share a texture
+    for ( size_t i = 0; i < m_subimages.size(); i++ ) {
+      if ( m_subimages[i].original < 0 )
+        sizes[std::make_pair( m_subimages[i].width, m_subimages[i].height )].push_back( (int) i );
+    }
+
+    for ( std::map<std::pair<int, int>, std::vector<int> >::iterator it = sizes.begin(); it != sizes.end(); ++it ) {
+      const std::vector<int>& group = it->second;
+
+      for ( size_t i = 1; i < group.size(); i++ ) {
+        SUBIMAGE& subimage = m_subimages[group[i]];
+
+        for ( size_t j = 0; j < i; j++ ) {
+          const SUBIMAGE& candidate = m_subimages[group[j]];
+
+          if ( candidate.original >= 0 || !AveragesClose( subimage.average, candidate.average ) )
+            continue;
+
+          int distance = CountBits( subimage.visual[0] ^ candidate.visual[0] ) +
+                         CountBits( subimage.visual[1] ^ candidate.visual[1] );
+
+          if ( distance <= aMaxDistance ) {
+            subimage.kind = MK_NEAR;
+            subimage.original = group[j];
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  int CSpriteDedup::Analyze( int aMaxDistance ) {
+    std::vector<const unsigned char*> bitmaps;
+
+    m_subimages.clear();
+    m_index.clear();
+
+    // Bitmaps are collected first, as the sprite interfaces must not be
+    // used by the worker threads
+    for ( int i = 0; i < CGMAPI::Ptr()->Sprites.GetArraySize(); i++ ) {
+      if ( !CGMAPI::Ptr()->Sprites.Exists( i ) )
+        continue;
+
+      ISprite& sprite = CGMAPI::Ptr()->Sprites[i];
+      int count = sprite.Subimages.GetCount();
+
+      for ( int n = 0; n < count; n++ ) {
+        const unsigned char* bitmap = sprite.Subimages[n].GetBitmap();
+
+        if ( !bitmap )
+          continue;
+
+        SUBIMAGE subimage = SUBIMAGE();
+        subimage.sprite = i;
+        subimage.subimage = n;
+        subimage.width = sprite.GetWidth();
+        subimage.height = sprite.GetHeight();
+        subimage.size = sprite.Subimages[n].GetBitmapSize();
+        subimage.kind = MK_UNIQUE;
+        subimage.original = -1;
+
+        m_index[std::make_pair( i, n )] = (int) m_subimages.size();
+        m_subimages.push_back( subimage );
+        bitmaps.push_back( bitmap );
+      }
+    }
+
+    if ( m_subimages.empty() )
+      return 0;
+
+    HASHJOB job = { &m_subimages[0], &bitmaps[0] };
+    CParallel::For( (int) m_subimages.size(), PARALLEL_SUBIMAGES, HashProc, &job );
+
+    FindExact( bitmaps );
+
+    if ( aMaxDistance >= 0 )
+      FindNear( aMaxDistance );
+
+    return GetDuplicateCount( true );
+  }
+
+  const CSpriteDedup::SUBIMAGE* CSpriteDedup::Find( int aSprite, int aSubimage ) {
+    SubimageMap::const_iterator it = m_index.find( std::make_pair( aSprite, aSubimage ) );
+    return ( it != m_index.end() ? &m_subimages[it->second] : NULL );
+  }
+
+  int CSpriteDedup::GetDuplicateCount( bool aIncludeNear ) {
+    int result = 0;
+
+    for ( size_t i = 0; i < m_subimages.size(); i++ ) {
+      if ( m_subimages[i].kind == MK_EXACT || ( aIncludeNear && m_subimages[i].kind == MK_NEAR ) )
+        result++;
+    }
+
+    return result;
+  }
+
+  double CSpriteDedup::GetDuplicateSize( bool aIncludeNear ) {
+    double result = 0.0;
+
+    for ( size_t i = 0; i < m_subimages.size(); i++ ) {
+      if ( m_subimages[i].kind == MK_EXACT || ( aIncludeNear && m_subimages[i].kind == MK_NEAR ) )
+        result += m_subimages[i].size;
+    }
+
+    return result;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void SpriteDedupAnalyze( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CSpriteDedup::Analyze( (int) aArgs[0].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SpriteDedupAnalyze )
+
+    void SpriteDedupSize( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( CSpriteDedup::GetDuplicateSize( aArgs[0].real != 0.0 ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SpriteDedupSize )
+
+    void SpriteDedupGet( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      const CSpriteDedup::SUBIMAGE* subimage = CSpriteDedup::Find( (int) aArgs[0].real, (int) aArgs[1].real );
+      const CSpriteDedup::SUBIMAGE* original = NULL;
+
+      aResult->Set( -1.0 );
+
+      if ( !subimage )
+        return;
+
+      if ( subimage->original >= 0 )
+        original = &CSpriteDedup::GetSubimages()[subimage->original];
+
+      switch ( (int) aArgs[2].real ) {
+        case 0: aResult->Set( (double) subimage->kind ); break;
+        case 1: aResult->Set( original ? (double) original->sprite : -1.0 ); break;
+        case 2: aResult->Set( original ? (double) original->subimage : -1.0 ); break;
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SpriteDedupGet )
+  }
+
+  void CSpriteDedup::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+
+    GMAPI_GMFUNCTION_REGISTER( "sprite_dedup_analyze", 1, SpriteDedupAnalyze );
+    GMAPI_GMFUNCTION_REGISTER( "sprite_dedup_size", 1, SpriteDedupSize );
+    GMAPI_GMFUNCTION_REGISTER( "sprite_dedup_get", 3, SpriteDedupGet );
+  }
+
+#endif
+
+}
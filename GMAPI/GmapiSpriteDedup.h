@@ -0,0 +1,130 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiSpriteDedup.h                                                  */
+/*   - Detection of duplicate sprite subimages                          */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include <map>
+#include <vector>
+
+namespace gm {
+
+  /// CSpriteDedup
+  ///   Finds subimages of all sprites whose bitmaps are equal (exact
+  ///   duplicates) or look alike (near duplicates). Exact duplicates are
+  ///   found by a hash of the whole bitmap, confirmed by comparing the
+  ///   bitmaps. Near duplicates are subimages of the same size whose
+  ///   perceptual hashes (differences of brightness between neighbouring
+  ///   parts of a 9x8 grid, weighted by alpha) differ in at most the
+  ///   given number of bits and whose average colors are close. Bitmaps
+  ///   are hashed on all processors.
+  ///
+  ///   Each duplicate refers to the first subimage (by sprite and
+  ///   subimage index) of its group, the original. The class only
+  ///   reports the duplicates; their textures are created and freed by
+  ///   the runner, which GMAPI cannot ask to recreate a texture from its
+  ///   bitmap, so they are left as they are.
+  ///
+  ///   Results describe the bitmaps at the time of Analyze.
+  ///
+  class CSpriteDedup {
+    public:
+      /// Kinds of subimages
+      enum MatchKind { MK_UNIQUE, MK_EXACT, MK_NEAR };
+
+      /// Hashes of a subimage and its original
+      struct SUBIMAGE {
+        int sprite;
+        int subimage;
+        int width;
+        int height;
+        unsigned long size;       // Size of the bitmap in bytes
+        unsigned long hash[2];    // Hash of the whole bitmap
+        unsigned long visual[2];  // Perceptual hash (64 bits)
+        unsigned long average;    // Average color, 0xAARRGGBB
+        MatchKind kind;
+        int original;             // Index of the original or -1
+      };
+
+      /// Analyze( int aMaxDistance )
+      ///   Hashes all subimages of all sprites and finds their duplicates.
+      ///   Near duplicates are searched only if aMaxDistance is not
+      ///   negative.
+      ///
+      /// Returns:
+      ///   Number of duplicate subimages.
+      ///
+      static int Analyze( int aMaxDistance );
+
+      /// Find( int aSprite, int aSubimage )
+      ///   Returns the analyzed subimage or NULL.
+      ///
+      static const SUBIMAGE* Find( int aSprite, int aSubimage );
+
+      static const std::vector<SUBIMAGE>& GetSubimages() {
+        return m_subimages;
+      }
+
+      /// GetDuplicateCount( bool aIncludeNear )
+      ///   Returns number of exact duplicates, or of all duplicates.
+      ///
+      static int GetDuplicateCount( bool aIncludeNear );
+
+      /// GetDuplicateSize( bool aIncludeNear )
+      ///   Returns size in bytes of bitmaps of exact duplicates, or of all
+      ///   duplicates.
+      ///
+      static double GetDuplicateSize( bool aIncludeNear );
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers the following GML functions:
+      ///     sprite_dedup_analyze( maxdistance ) - returns number of
+      ///       duplicates
+      ///     sprite_dedup_size( near ) - returns size of bitmaps of the
+      ///       duplicates
+      ///     sprite_dedup_get( spr, subimg, field ) - returns kind (field
+      ///       0; MK_* value), original sprite (1) or original subimage (2)
+      ///       of the subimage, or -1
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      struct HASHJOB {
+        SUBIMAGE* subimages;
+        const unsigned char* const* bitmaps;
+      };
+
+      typedef std::map<std::pair<int, int>, int> SubimageMap;
+
+      static void HashProc( void* aContext, int aBegin, int aEnd );
+      static void FindExact( const std::vector<const unsigned char*>& aBitmaps );
+      static void FindNear( int aMaxDistance );
+
+      static std::vector<SUBIMAGE> m_subimages;
+      static SubimageMap m_index;
+  };
+
+}
@@ -0,0 +1,341 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiSurfacePool.cpp                                                */
+/*   - Reuse of surfaces of the same size                               */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiSurfacePool.h"
+#include "GmapiMemoryReport.h"
+#include "GmapiGameGraphics.h"
+#include "GmapiMacros.h"
+
+namespace gm {
+
+  CSurfacePool::IdleMap CSurfacePool::m_idle;
+  std::set<int> CSurfacePool::m_acquired;
+  int CSurfacePool::m_frame = 0;
+  int CSurfacePool::m_target = -1;
+  int CSurfacePool::m_idleFrames = 60;
+  int CSurfacePool::m_hits = 0;
+  int CSurfacePool::m_misses = 0;
+  int CSurfacePool::m_freed = 0;
+
+  /************************************************************************/
+  /* CSurfacePool class implementation                                    */
+  /************************************************************************/
+
+  bool CSurfacePool::IsValid( int aSurface, int aWidth, int aHeight ) {
+    GMSURFACE* surfaces = CGMAPI::GetSurfaceArray();
+
+    if ( !surfaces || aSurface < 0 || aSurface >= *CGMAPI::SurfaceArraySizePtr() || !surfaces[aSurface].exists )
+      return false;
+
+    return ( aWidth < 0 || ( surfaces[aSurface].width == aWidth && surfaces[aSurface].height == aHeight ) );
+  }
+
+  bool CSurfacePool::IsIdle( int aSurface ) {
+    for ( IdleMap::const_iterator it = m_idle.begin(); it != m_idle.end(); ++it ) {
+      for ( size_t i = 0; i < it->second.size(); i++ ) {
+        if ( it->second[i].id == aSurface )
+          return true;
+      }
+    }
+
+    return false;
+  }
+
+  int CSurfacePool::Acquire( int aWidth, int aHeight, bool aClear ) {
+    IdleMap::iterator it = m_idle.find( std::make_pair( aWidth, aHeight ) );
+    int surface = -1;
+
+    if ( aWidth <= 0 || aHeight <= 0 )
+      return -1;
+
+    if ( it != m_idle.end() ) {
+      std::vector<IDLESURFACE>& idle = it->second;
+
+      // The most recently released one first, its texture is the most
+      // likely to be still in video memory
+      while ( surface < 0 && !idle.empty() ) {
+        if ( IsValid( idle.back().id, aWidth, aHeight ) )
+          surface = idle.back().id;
+
+        idle.pop_back();
+      }
+
+      if ( idle.empty() )
+        m_idle.erase( it );
+    }
+
+    if ( surface >= 0 )
+      ++m_hits;
+    else {
+      ++m_misses;
+      surface = surface_create( aWidth, aHeight );
+
+      if ( surface < 0 )
+        return -1;
+    }
+
+    // New surfaces are cleared as well, their content is undefined
+    if ( aClear ) {
+      int target = m_target;
+
+      surface_set_target( surface );
+      draw_clear_alpha( 0, 0.0 );
+
+      // The caller may be drawing to another surface
+      if ( target >= 0 && target != surface && IsValid( target, -1, -1 ) )
+        surface_set_target( target );
+      else
+        surface_reset_target();
+    }
+
+    m_acquired.insert( surface );
+    return surface;
+  }
+
+  bool CSurfacePool::Release( int aSurface ) {
+    if ( !IsValid( aSurface, -1, -1 ) || IsIdle( aSurface ) )
+      return false;
+
+    const GMSURFACE& surface = CGMAPI::GetSurfaceArray()[aSurface];
+    IDLESURFACE idle = { aSurface, m_frame };
+
+    m_acquired.erase( aSurface );
+    m_idle[std::make_pair( surface.width, surface.height )].push_back( idle );
+
+    return true;
+  }
+
+  void CSurfacePool::Forget( int aSurface ) {
+    if ( aSurface == m_target )
+      m_target = -1;
+
+    if ( m_acquired.empty() && m_idle.empty() )
+      return;
+
+    m_acquired.erase( aSurface );
+
+    for ( IdleMap::iterator it = m_idle.begin(); it != m_idle.end(); ) {
+      std::vector<IDLESURFACE>& idle = it->second;
+
+      for ( size_t i = 0; i < idle.size(); ) {
+        if ( idle[i].id == aSurface )
+          idle.erase( idle.begin() + i );
+        else
+          ++i;
+      }
+
+      if ( idle.empty() )
+        m_idle.erase( it++ );
+      else
+        ++it;
+    }
+  }
+
+  void CSurfacePool::SetTarget( int aSurface ) {
+    if ( aSurface < 0 || IsValid( aSurface, -1, -1 ) )
+      m_target = ( aSurface < 0 ? -1 : aSurface );
+  }
+
+  int CSurfacePool::FreeIdle( int aMinimumAge ) {
+    std::vector<int> expired;
+
+    for ( IdleMap::iterator it = m_idle.begin(); it != m_idle.end(); ) {
+      std::vector<IDLESURFACE>& idle = it->second;
+      size_t count = 0;
+
+      // Surfaces are ordered by release, so the expired ones come first
+      while ( count < idle.size() && m_frame - idle[count].releaseFrame >= aMinimumAge ) {
+        if ( IsValid( idle[count].id, it->first.first, it->first.second ) )
+          expired.push_back( idle[count].id );
+
+        ++count;
+      }
+
+      idle.erase( idle.begin(), idle.begin() + count );
+
+      if ( idle.empty() )
+        m_idle.erase( it++ );
+      else
+        ++it;
+    }
+
+    // Freed after the pool is updated, surface_free calls Forget
+    for ( size_t i = 0; i < expired.size(); i++ )
+      surface_free( expired[i] );
+
+    m_freed += (int) expired.size();
+    return (int) expired.size();
+  }
+
+  int CSurfacePool::Frame() {
+    ++m_frame;
+    return FreeIdle( m_idleFrames + 1 );
+  }
+
+  int CSurfacePool::Trim() {
+    return FreeIdle( 0 );
+  }
+
+  int CSurfacePool::GetIdleCount() {
+    int result = 0;
+
+    for ( IdleMap::const_iterator it = m_idle.begin(); it != m_idle.end(); ++it )
+      result += (int) it->second.size();
+
+    return result;
+  }
+
+  double CSurfacePool::GetIdleSize() {
+    double result = 0.0;
+
+    for ( IdleMap::const_iterator it = m_idle.begin(); it != m_idle.end(); ++it ) {
+      for ( size_t i = 0; i < it->second.size(); i++ ) {
+        if ( IsValid( it->second[i].id, -1, -1 ) )
+          result += CMemoryReport::GetTextureSize( CGMAPI::GetSurfaceArray()[it->second[i].id].textureId );
+      }
+    }
+
+    return result;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+    GMFUCTION runnerSurfaceFree = NULL;
+    GMFUCTION runnerSurfaceSetTarget = NULL;
+    GMFUCTION runnerSurfaceResetTarget = NULL;
+
+    void SurfaceFree( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                      int aArgCount, PGMVALUE aResult ) {
+      CSurfacePool::Forget( (int) aArgs[0].real );
+      core::RunnerCallFunction( runnerSurfaceFree, aArgs, aArgCount, aResult );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SurfaceFree )
+
+    void SurfaceSetTarget( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      core::RunnerCallFunction( runnerSurfaceSetTarget, aArgs, aArgCount, aResult );
+      CSurfacePool::SetTarget( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SurfaceSetTarget )
+
+    void SurfaceResetTarget( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      core::RunnerCallFunction( runnerSurfaceResetTarget, aArgs, aArgCount, aResult );
+      CSurfacePool::SetTarget( -1 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SurfaceResetTarget )
+
+    void SurfaceAcquire( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CSurfacePool::Acquire( (int) aArgs[0].real, (int) aArgs[1].real,
+                                                    aArgs[2].real != 0.0 ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SurfaceAcquire )
+
+    void SurfaceRelease( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( CSurfacePool::Release( (int) aArgs[0].real ) ? 1.0 : 0.0 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SurfaceRelease )
+
+    void SurfacePoolFrame( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                           int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CSurfacePool::Frame() );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SurfacePoolFrame )
+
+    void SurfacePoolTrim( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CSurfacePool::Trim() );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SurfacePoolTrim )
+
+    void SurfacePoolSetIdleFrames( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                   int aArgCount, PGMVALUE aResult ) {
+      CSurfacePool::SetIdleFrames( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SurfacePoolSetIdleFrames )
+
+    void SurfacePoolInfo( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      switch ( (int) aArgs[0].real ) {
+        case CSurfacePool::IF_HITS: aResult->Set( (double) CSurfacePool::GetHits() ); break;
+        case CSurfacePool::IF_MISSES: aResult->Set( (double) CSurfacePool::GetMisses() ); break;
+        case CSurfacePool::IF_HIT_RATE: aResult->Set( CSurfacePool::GetHitRate() ); break;
+        case CSurfacePool::IF_IN_USE: aResult->Set( (double) CSurfacePool::GetInUseCount() ); break;
+        case CSurfacePool::IF_IDLE: aResult->Set( (double) CSurfacePool::GetIdleCount() ); break;
+        case CSurfacePool::IF_IDLE_BYTES: aResult->Set( CSurfacePool::GetIdleSize() ); break;
+        case CSurfacePool::IF_FREED: aResult->Set( (double) CSurfacePool::GetFreedCount() ); break;
+        default: aResult->Set( -1.0 );
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SurfacePoolInfo )
+
+    void SurfacePoolResetStats( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                int aArgCount, PGMVALUE aResult ) {
+      CSurfacePool::ResetStatistics();
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( SurfacePoolResetStats )
+  }
+
+  void CSurfacePool::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+
+    GMAPI_GMFUNCTION_REGISTER( "surface_acquire", 3, SurfaceAcquire );
+    GMAPI_GMFUNCTION_REGISTER( "surface_release", 1, SurfaceRelease );
+    GMAPI_GMFUNCTION_REGISTER( "surface_pool_frame", 0, SurfacePoolFrame );
+    GMAPI_GMFUNCTION_REGISTER( "surface_pool_trim", 0, SurfacePoolTrim );
+    GMAPI_GMFUNCTION_REGISTER( "surface_pool_set_idle_frames", 1, SurfacePoolSetIdleFrames );
+    GMAPI_GMFUNCTION_REGISTER( "surface_pool_info", 1, SurfacePoolInfo );
+    GMAPI_GMFUNCTION_REGISTER( "surface_pool_reset_stats", 0, SurfacePoolResetStats );
+
+    runnerSurfaceFree = GMAPI_GMFUNCTION_OVERRIDE( id_surface_free, SurfaceFree );
+    runnerSurfaceSetTarget = GMAPI_GMFUNCTION_OVERRIDE( id_surface_set_target, SurfaceSetTarget );
+    runnerSurfaceResetTarget = GMAPI_GMFUNCTION_OVERRIDE( id_surface_reset_target, SurfaceResetTarget );
+  }
+
+#endif
+
+}
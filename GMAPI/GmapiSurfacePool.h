@@ -0,0 +1,189 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiSurfacePool.h                                                  */
+/*   - Reuse of surfaces of the same size                               */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include <map>
+#include <set>
+#include <vector>
+
+namespace gm {
+
+  /// CSurfacePool
+  ///   Keeps released surfaces and hands them out again instead of
+  ///   creating new ones of the same size, which avoids allocating video
+  ///   memory every frame. Idle surfaces are freed after they have not
+  ///   been acquired for a number of frames; Frame should be called once
+  ///   per step.
+  ///
+  ///   Surfaces are checked in the runner's surface array before they are
+  ///   handed out, and surface_free forgets them, so surfaces freed by
+  ///   the game are never reused. Clearing a surface sets it as the
+  ///   drawing target for a moment; the target set by surface_set_target
+  ///   is set again afterwards, so surfaces may be acquired in the middle
+  ///   of drawing to another one.
+  ///
+  class CSurfacePool {
+    public:
+      /// Fields of surface_pool_info
+      enum InfoField { IF_HITS, IF_MISSES, IF_HIT_RATE, IF_IN_USE, IF_IDLE, IF_IDLE_BYTES, IF_FREED };
+
+      /// Acquire( int aWidth, int aHeight, bool aClear )
+      ///   Returns an idle surface of the size, cleared to transparent
+      ///   black if aClear is true, or creates a new one.
+      ///
+      /// Returns:
+      ///   ID of the surface or -1 if it could not be created.
+      ///
+      static int Acquire( int aWidth, int aHeight, bool aClear );
+
+      /// Release( int aSurface )
+      ///   Gives the surface back to the pool. Surfaces created by
+      ///   surface_create may be released as well.
+      ///
+      /// Returns:
+      ///   False if the surface does not exist or is already idle.
+      ///
+      static bool Release( int aSurface );
+
+      /// Forget( int aSurface )
+      ///   Removes the surface from the pool without freeing it; used
+      ///   before the surface is freed.
+      ///
+      static void Forget( int aSurface );
+
+      /// SetTarget( int aSurface )
+      ///   Remembers the surface set by surface_set_target, or -1 after
+      ///   surface_reset_target; Acquire sets it again after clearing.
+      ///   Surfaces which do not exist are ignored, like by the runner.
+      ///
+      static void SetTarget( int aSurface );
+
+      static int GetTarget() {
+        return m_target;
+      }
+
+      /// Frame()
+      ///   Starts a new frame and frees surfaces idle for more frames
+      ///   than the limit.
+      ///
+      /// Returns:
+      ///   Number of freed surfaces.
+      ///
+      static int Frame();
+
+      /// Trim()
+      ///   Frees all idle surfaces.
+      ///
+      /// Returns:
+      ///   Number of freed surfaces.
+      ///
+      static int Trim();
+
+      /// SetIdleFrames( int aFrames )
+      ///   Sets number of frames after which idle surfaces are freed
+      ///   (60 by default).
+      ///
+      static void SetIdleFrames( int aFrames ) {
+        m_idleFrames = ( aFrames > 0 ? aFrames : 0 );
+      }
+
+      static int GetIdleFrames() {
+        return m_idleFrames;
+      }
+
+      static int GetHits() { return m_hits; }
+      static int GetMisses() { return m_misses; }
+      static int GetFreedCount() { return m_freed; }
+      static int GetInUseCount() { return (int) m_acquired.size(); }
+
+      /// GetHitRate()
+      ///   Returns ratio of acquisitions served by idle surfaces, 0 if
+      ///   there were none.
+      ///
+      static double GetHitRate() {
+        return ( m_hits + m_misses > 0 ? (double) m_hits / ( m_hits + m_misses ) : 0.0 );
+      }
+
+      /// GetIdleCount()
+      ///   Returns number of idle surfaces.
+      ///
+      static int GetIdleCount();
+
+      /// GetIdleSize()
+      ///   Returns size in bytes of textures of the idle surfaces.
+      ///
+      static double GetIdleSize();
+
+      /// ResetStatistics()
+      ///   Sets hits, misses and freed surfaces to zero.
+      ///
+      static void ResetStatistics() {
+        m_hits = m_misses = m_freed = 0;
+      }
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers the following GML functions:
+      ///     surface_acquire( w, h, clear ) - returns Acquire
+      ///     surface_release( id ) - returns Release
+      ///     surface_pool_frame() - calls Frame; returns number of freed
+      ///       surfaces
+      ///     surface_pool_trim() - returns Trim
+      ///     surface_pool_set_idle_frames( frames ) - calls SetIdleFrames
+      ///     surface_pool_info( field ) - returns value of the field
+      ///       (IF_* value)
+      ///     surface_pool_reset_stats() - calls ResetStatistics
+      ///   It also overrides surface_free to forget the surface first and
+      ///   surface_set_target and surface_reset_target to remember the
+      ///   drawing target.
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      struct IDLESURFACE {
+        int id;
+        int releaseFrame;
+      };
+
+      /// Idle surfaces by their sizes, the least recently released first
+      typedef std::map<std::pair<int, int>, std::vector<IDLESURFACE> > IdleMap;
+
+      static bool IsValid( int aSurface, int aWidth, int aHeight );
+      static bool IsIdle( int aSurface );
+      static int FreeIdle( int aMinimumAge );
+
+      static IdleMap m_idle;
+      static std::set<int> m_acquired;
+      static int m_frame;
+      static int m_target;
+      static int m_idleFrames;
+      static int m_hits;
+      static int m_misses;
+      static int m_freed;
+  };
+
+}
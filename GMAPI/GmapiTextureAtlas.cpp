@@ -0,0 +1,398 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiTextureAtlas.cpp                                               */
+/*   - Packing of sprite subimages into atlas backgrounds               */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiTextureAtlas.h"
+#include "GmapiPng.h"
+#include "GmapiRectPacker.h"
+#include "GmapiResources.h"
+#include "GmapiGameGraphics.h"
+#include "GmapiMacros.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace gm {
+
+  CDSRegistry<CTextureAtlas> CTextureAtlas::m_atlases;
+
+  namespace {
+    // Limits of the page size
+    static const int MIN_PAGE_SIZE = 64;
+    static const int MAX_PAGE_SIZE = 4096;
+
+    // Number of temporary files created by this process
+    int tempFileCounter = 0;
+  }
+
+  /************************************************************************/
+  /* CTextureAtlas class implementation                                   */
+  /************************************************************************/
+
+  CTextureAtlas::CTextureAtlas( int aPageSize, int aPadding, int aExtrude ):
+    m_pageSize( std::min( std::max( aPageSize, MIN_PAGE_SIZE ), MAX_PAGE_SIZE ) ),
+    m_padding( std::max( aPadding, 0 ) ),
+    m_extrude( std::max( aExtrude, 0 ) ) {
+  }
+
+  bool CTextureAtlas::Destroy( int aId ) {
+    CTextureAtlas* atlas = m_atlases.Find( aId );
+
+    if ( !atlas )
+      return false;
+
+    // Not done in the destructor, which may run after the runner has
+    // been released
+    atlas->DeleteBackgrounds();
+    return m_atlases.Remove( aId );
+  }
+
+  void CTextureAtlas::AddSubimage( int aSprite, int aSubimage ) {
+    ISprite& sprite = CGMAPI::Ptr()->Sprites[aSprite];
+
+    if ( aSubimage < 0 || aSubimage >= sprite.Subimages.GetCount() )
+      throw EGMAPIInvalidSubimage( aSprite, aSubimage );
+
+    std::pair<int, int> key( aSprite, aSubimage );
+
+    if ( m_entryIndex.find( key ) != m_entryIndex.end() )
+      return;
+
+    ENTRY entry = ENTRY();
+    entry.sprite = aSprite;
+    entry.subimage = aSubimage;
+    entry.page = -1;
+
+    m_entryIndex[key] = (int) m_entries.size();
+    m_entries.push_back( entry );
+  }
+
+  void CTextureAtlas::AddSprite( int aSprite ) {
+    int count = CGMAPI::Ptr()->Sprites[aSprite].Subimages.GetCount();
+
+    for ( int i = 0; i < count; i++ )
+      AddSubimage( aSprite, i );
+  }
+
+  bool CTextureAtlas::Build() {
+    bool result = true;
+    std::vector<CRectPacker::RECTANGLE> rects( m_entries.size() );
+    std::vector< std::pair<int, int> > pageSizes;
+
+    // Sizes and origins are read again, as the sprites may have been
+    // replaced since they were added
+    for ( size_t i = 0; i < m_entries.size(); i++ ) {
+      ENTRY& entry = m_entries[i];
+      entry.width = entry.height = 0;
+
+      ISprite* sprite = NULL;
+
+      try {
+        sprite = &CGMAPI::Ptr()->Sprites[entry.sprite];
+
+        if ( !sprite->Subimages[entry.subimage].GetBitmap() )
+          sprite = NULL;
+      } catch ( const EGMAPIException& ) {
+        sprite = NULL;
+      }
+
+      if ( !sprite ) {
+        result = false;
+        continue;
+      }
+
+      entry.width = sprite->GetWidth();
+      entry.height = sprite->GetHeight();
+      entry.originX = sprite->GetOffsetX();
+      entry.originY = sprite->GetOffsetY();
+      rects[i].width = entry.width;
+      rects[i].height = entry.height;
+    }
+
+    if ( !CRectPacker::Pack( rects, m_pageSize, m_padding, m_extrude, pageSizes ) )
+      result = false;
+
+    for ( size_t i = 0; i < m_entries.size(); i++ ) {
+      ENTRY& entry = m_entries[i];
+      const CRectPacker::RECTANGLE& rect = rects[i];
+
+      entry.page = rect.page;
+      entry.left = rect.left;
+      entry.top = rect.top;
+      entry.u0 = rect.u0;
+      entry.v0 = rect.v0;
+      entry.u1 = rect.u1;
+      entry.v1 = rect.v1;
+    }
+
+    m_pages.assign( pageSizes.size(), PAGE() );
+
+    for ( size_t i = 0; i < m_pages.size(); i++ ) {
+      PAGE& page = m_pages[i];
+
+      page.width = pageSizes[i].first;
+      page.height = pageSizes[i].second;
+      page.bitmap.assign( page.width * page.height * 4, 0 );
+    }
+
+    for ( size_t i = 0; i < m_entries.size(); i++ ) {
+      if ( m_entries[i].page >= 0 )
+        CopySubimage( m_entries[i] );
+    }
+
+    return result;
+  }
+
+  void CTextureAtlas::CopySubimage( const ENTRY& aEntry ) {
+    const unsigned char* source = CGMAPI::Ptr()->Sprites[aEntry.sprite].Subimages[aEntry.subimage].GetBitmap();
+    PAGE& page = m_pages[aEntry.page];
+    int rowSize = aEntry.width * 4;
+
+    // Rows of the subimage, with the edge rows repeated above and below
+    for ( int y = -m_extrude; y < aEntry.height + m_extrude; y++ ) {
+      int sourceY = std::min( std::max( y, 0 ), aEntry.height - 1 );
+      const unsigned char* sourceRow = source + sourceY * rowSize;
+      unsigned char* row = &page.bitmap[( ( aEntry.top + y ) * page.width + aEntry.left ) * 4];
+
+      memcpy( row, sourceRow, rowSize );
+
+      for ( int x = 1; x <= m_extrude; x++ ) {
+        memcpy( row - x * 4, sourceRow, 4 );
+        memcpy( row + rowSize + ( x - 1 ) * 4, sourceRow + rowSize - 4, 4 );
+      }
+    }
+  }
+
+  void CTextureAtlas::DeleteBackgrounds() {
+    for ( size_t i = 0; i < m_backgrounds.size(); i++ ) {
+      if ( m_backgrounds[i] >= 0 )
+        background_delete( m_backgrounds[i] );
+    }
+
+    m_backgrounds.clear();
+  }
+
+  bool CTextureAtlas::CreateBackgrounds() {
+    bool result = true;
+    char directory[MAX_PATH];
+    char fileName[MAX_PATH + 32];
+
+    DeleteBackgrounds();
+
+    if ( !GetTempPathA( MAX_PATH, directory ) )
+      return m_pages.empty();
+
+    for ( size_t i = 0; i < m_pages.size(); i++ ) {
+      const PAGE& page = m_pages[i];
+      int background = -1;
+
+      sprintf_s( fileName, sizeof( fileName ), "%sgmapi%08lX_%d.png", directory,
+                 (unsigned long) GetCurrentProcessId(), tempFileCounter++ );
+
+      if ( CPngFile::Save( fileName, &page.bitmap[0], page.width, page.height ) ) {
+        if ( CGlobals::UseNewStructs() )
+          background = background_add( fileName, false, false );
+        else
+          background = background_add_alpha( fileName, true );
+
+        DeleteFileA( fileName );
+      }
+
+      if ( background < 0 )
+        result = false;
+
+      m_backgrounds.push_back( background );
+    }
+
+    return result;
+  }
+
+  const CTextureAtlas::ENTRY* CTextureAtlas::FindEntry( int aSprite, int aSubimage ) const {
+    EntryMap::const_iterator it = m_entryIndex.find( std::make_pair( aSprite, aSubimage ) );
+    return ( it != m_entryIndex.end() ? &m_entries[it->second] : NULL );
+  }
+
+  double CTextureAtlas::GetEfficiency() const {
+    double used = 0.0, total = 0.0;
+
+    for ( size_t i = 0; i < m_pages.size(); i++ )
+      total += (double) m_pages[i].width * m_pages[i].height;
+
+    for ( size_t i = 0; i < m_entries.size(); i++ ) {
+      const ENTRY& entry = m_entries[i];
+
+      if ( entry.page >= 0 )
+        used += (double) ( entry.width + 2 * m_extrude + m_padding ) *
+                ( entry.height + 2 * m_extrude + m_padding );
+    }
+
+    return ( total > 0.0 ? std::min( used / total, 1.0 ) : 0.0 );
+  }
+
+  bool CTextureAtlas::Draw( int aSprite, int aSubimage, double aX, double aY ) const {
+    const ENTRY* entry = FindEntry( aSprite, aSubimage );
+
+    if ( !entry || GetBackground( entry->page ) < 0 )
+      return false;
+
+    draw_background_part( m_backgrounds[entry->page], entry->left, entry->top, entry->width,
+                          entry->height, aX - entry->originX, aY - entry->originY );
+    return true;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void AtlasCreate( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                      int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CTextureAtlas::Create( (int) aArgs[0].real, (int) aArgs[1].real,
+                                                    (int) aArgs[2].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( AtlasCreate )
+
+    void AtlasDestroy( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                       int aArgCount, PGMVALUE aResult ) {
+      CTextureAtlas::Destroy( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( AtlasDestroy )
+
+    void AtlasAddSprite( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                         int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( 0.0 );
+
+      try {
+        CTextureAtlas& atlas = CTextureAtlas::Get( (int) aArgs[0].real );
+        int subimage = (int) aArgs[2].real;
+
+        if ( subimage < 0 )
+          atlas.AddSprite( (int) aArgs[1].real );
+        else
+          atlas.AddSubimage( (int) aArgs[1].real, subimage );
+
+        aResult->Set( 1.0 );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( AtlasAddSprite )
+
+    void AtlasBuild( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                     int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( -1.0 );
+
+      try {
+        CTextureAtlas& atlas = CTextureAtlas::Get( (int) aArgs[0].real );
+        bool packed = atlas.Build();
+
+        if ( atlas.CreateBackgrounds() && packed )
+          aResult->Set( (double) atlas.GetPageCount() );
+      } catch ( const EGMAPIException& ) {}
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( AtlasBuild )
+
+    void AtlasBackground( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      CTextureAtlas* atlas = CTextureAtlas::Find( (int) aArgs[0].real );
+      aResult->Set( atlas ? (double) atlas->GetBackground( (int) aArgs[1].real ) : -1.0 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( AtlasBackground )
+
+    void AtlasGet( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                   int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( -1.0 );
+
+      CTextureAtlas* atlas = CTextureAtlas::Find( (int) aArgs[0].real );
+
+      if ( !atlas )
+        return;
+
+      const CTextureAtlas::ENTRY* entry = atlas->FindEntry( (int) aArgs[1].real, (int) aArgs[2].real );
+
+      if ( !entry )
+        return;
+
+      switch ( (int) aArgs[3].real ) {
+        case CTextureAtlas::EF_PAGE:   aResult->Set( (double) entry->page ); break;
+        case CTextureAtlas::EF_LEFT:   aResult->Set( (double) entry->left ); break;
+        case CTextureAtlas::EF_TOP:    aResult->Set( (double) entry->top ); break;
+        case CTextureAtlas::EF_WIDTH:  aResult->Set( (double) entry->width ); break;
+        case CTextureAtlas::EF_HEIGHT: aResult->Set( (double) entry->height ); break;
+        case CTextureAtlas::EF_U0:     aResult->Set( entry->u0 ); break;
+        case CTextureAtlas::EF_V0:     aResult->Set( entry->v0 ); break;
+        case CTextureAtlas::EF_U1:     aResult->Set( entry->u1 ); break;
+        case CTextureAtlas::EF_V1:     aResult->Set( entry->v1 ); break;
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( AtlasGet )
+
+    void AtlasDraw( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                    int aArgCount, PGMVALUE aResult ) {
+      CTextureAtlas* atlas = CTextureAtlas::Find( (int) aArgs[0].real );
+
+      aResult->Set( atlas && atlas->Draw( (int) aArgs[1].real, (int) aArgs[2].real,
+                                          aArgs[3].real, aArgs[4].real ) ? 1.0 : 0.0 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( AtlasDraw )
+
+    void AtlasEfficiency( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                          int aArgCount, PGMVALUE aResult ) {
+      CTextureAtlas* atlas = CTextureAtlas::Find( (int) aArgs[0].real );
+      aResult->Set( atlas ? atlas->GetEfficiency() : 0.0 );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( AtlasEfficiency )
+  }
+
+  void CTextureAtlas::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+
+    GMAPI_GMFUNCTION_REGISTER( "atlas_create", 3, AtlasCreate );
+    GMAPI_GMFUNCTION_REGISTER( "atlas_destroy", 1, AtlasDestroy );
+    GMAPI_GMFUNCTION_REGISTER( "atlas_add_sprite", 3, AtlasAddSprite );
+    GMAPI_GMFUNCTION_REGISTER( "atlas_build", 1, AtlasBuild );
+    GMAPI_GMFUNCTION_REGISTER( "atlas_background", 2, AtlasBackground );
+    GMAPI_GMFUNCTION_REGISTER( "atlas_get", 4, AtlasGet );
+    GMAPI_GMFUNCTION_REGISTER( "atlas_draw", 5, AtlasDraw );
+    GMAPI_GMFUNCTION_REGISTER( "atlas_efficiency", 1, AtlasEfficiency );
+  }
+
+#endif
+
+}
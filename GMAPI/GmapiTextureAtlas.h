@@ -0,0 +1,240 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiTextureAtlas.h                                                 */
+/*   - Packing of sprite subimages into atlas backgrounds               */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiDSCommon.h"
+
+#include <map>
+#include <vector>
+
+namespace gm {
+
+  /// CTextureAtlas
+  ///   Packs subimages of sprites into few large bitmaps (pages), so that
+  ///   they can be drawn from the same texture. Rectangles are placed by
+  ///   CRectPacker (MaxRects, best short side fit), largest first. Each
+  ///   subimage is surrounded by aExtrude copies of its edge pixels, which
+  ///   keeps filtering from mixing in its neighbours, and separated from
+  ///   the others by aPadding transparent pixels.
+  ///
+  ///   Pages are square bitmaps of the size given to the constructor;
+  ///   after packing they are shrunk to the smallest power of two sizes
+  ///   holding all placed subimages. CreateBackgrounds makes GM
+  ///   backgrounds of the pages, which can be drawn by draw_background_part
+  ///   with the rectangles of the entries.
+  ///
+  class CTextureAtlas {
+    public:
+      /// Location of a subimage in the atlas
+      struct ENTRY {
+        int sprite;
+        int subimage;
+        int page;          // -1 if the subimage did not fit
+        int left;          // Rectangle of the subimage without extrusion
+        int top;
+        int width;
+        int height;
+        int originX;       // Origin of the sprite
+        int originY;
+        double u0;         // Texture coordinates of the rectangle
+        double v0;
+        double u1;
+        double v1;
+      };
+
+      /// Fields of atlas_get
+      enum EntryField { EF_PAGE, EF_LEFT, EF_TOP, EF_WIDTH, EF_HEIGHT, EF_U0, EF_V0, EF_U1, EF_V1 };
+
+      /// Ctor( int aPageSize, int aPadding, int aExtrude )
+      ///   Creates empty atlas. aPageSize is clamped to range <64; 4096>.
+      ///
+      CTextureAtlas( int aPageSize, int aPadding, int aExtrude );
+
+      /************************************************************************/
+      /* Atlas management                                                     */
+      /************************************************************************/
+
+      static int Create( int aPageSize, int aPadding, int aExtrude ) {
+        return m_atlases.Add( new CTextureAtlas( aPageSize, aPadding, aExtrude ) );
+      }
+
+      /// Destroy( int aId )
+      ///   Deletes backgrounds of the atlas and destroys it.
+      ///
+      /// Returns:
+      ///   False if the atlas did not exist.
+      ///
+      static bool Destroy( int aId );
+
+      static CTextureAtlas* Find( int aId ) {
+        return m_atlases.Find( aId );
+      }
+
+      /// Get( int aId )
+      ///   Returns the atlas with specified ID.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPIDataStructureNotExist if the atlas does not exist.
+      ///
+      static CTextureAtlas& Get( int aId ) {
+        return m_atlases.Get( aId );
+      }
+
+      /************************************************************************/
+      /* Building                                                             */
+      /************************************************************************/
+
+      /// AddSubimage( int aSprite, int aSubimage )
+      ///   Adds the subimage to the atlas; subimages added before are
+      ///   ignored. Takes effect by the next Build.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPISpriteNotExist if the sprite does not exist and
+      ///   EGMAPIInvalidSubimage if the subimage does not exist.
+      ///
+      void AddSubimage( int aSprite, int aSubimage );
+
+      /// AddSprite( int aSprite )
+      ///   Adds all subimages of the sprite to the atlas.
+      ///
+      /// Exceptions:
+      ///   Throws EGMAPISpriteNotExist if the sprite does not exist.
+      ///
+      void AddSprite( int aSprite );
+
+      /// Build()
+      ///   Packs all added subimages and copies their bitmaps into the
+      ///   pages. Backgrounds created before are not changed.
+      ///
+      /// Returns:
+      ///   False if some subimages are larger than a page; they are not
+      ///   placed.
+      ///
+      bool Build();
+
+      /// CreateBackgrounds()
+      ///   Creates backgrounds of the pages, replacing the ones created
+      ///   before. The pages are passed to the runner through temporary
+      ///   PNG files.
+      ///
+      /// Returns:
+      ///   False if some backgrounds could not be created.
+      ///
+      bool CreateBackgrounds();
+
+      /************************************************************************/
+      /* Results                                                              */
+      /************************************************************************/
+
+      int GetPageCount() const { return (int) m_pages.size(); }
+      int GetPageWidth( int aPage ) const { return m_pages[aPage].width; }
+      int GetPageHeight( int aPage ) const { return m_pages[aPage].height; }
+
+      /// GetPageBitmap( int aPage )
+      ///   Returns bitmap of the page, in the format of
+      ///   ISpriteSubimage::GetBitmap.
+      ///
+      const unsigned char* GetPageBitmap( int aPage ) const {
+        return ( m_pages[aPage].bitmap.empty() ? NULL : &m_pages[aPage].bitmap[0] );
+      }
+
+      /// GetBackground( int aPage )
+      ///   Returns background of the page or -1 if it has not been
+      ///   created.
+      ///
+      int GetBackground( int aPage ) const {
+        return ( aPage >= 0 && aPage < (int) m_backgrounds.size() ? m_backgrounds[aPage] : -1 );
+      }
+
+      /// FindEntry( int aSprite, int aSubimage )
+      ///   Returns location of the subimage or NULL if it has not been
+      ///   added.
+      ///
+      const ENTRY* FindEntry( int aSprite, int aSubimage ) const;
+
+      const std::vector<ENTRY>& GetEntries() const {
+        return m_entries;
+      }
+
+      /// GetEfficiency()
+      ///   Returns ratio of the area of placed subimages (with extrusion
+      ///   and padding) to the area of all pages.
+      ///
+      double GetEfficiency() const;
+
+      /// Draw( int aSprite, int aSubimage, double aX, double aY )
+      ///   Draws the subimage from its page background like draw_sprite.
+      ///
+      /// Returns:
+      ///   False if the subimage is not in a created background.
+      ///
+      bool Draw( int aSprite, int aSubimage, double aX, double aY ) const;
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers the following GML functions:
+      ///     atlas_create( pagesize, padding, extrude ) - returns ID of the
+      ///       atlas
+      ///     atlas_destroy( id ) - destroys the atlas and its backgrounds
+      ///     atlas_add_sprite( id, spr, subimg ) - adds the subimage or all
+      ///       subimages if subimg is -1
+      ///     atlas_build( id ) - packs the atlas and creates backgrounds of
+      ///       its pages; returns number of pages or -1 on failure
+      ///     atlas_background( id, page ) - returns background of the page
+      ///     atlas_get( id, spr, subimg, field ) - returns field (EF_*
+      ///       value) of the subimage's entry, or -1
+      ///     atlas_draw( id, spr, subimg, x, y ) - draws the subimage from
+      ///       the atlas
+      ///     atlas_efficiency( id ) - returns GetEfficiency
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      struct PAGE {
+        int width;
+        int height;
+        std::vector<unsigned char> bitmap;
+      };
+
+      typedef std::map<std::pair<int, int>, int> EntryMap;
+
+      void CopySubimage( const ENTRY& aEntry );
+      void DeleteBackgrounds();
+
+      int m_pageSize;
+      int m_padding;
+      int m_extrude;
+
+      std::vector<ENTRY> m_entries;
+      EntryMap m_entryIndex;                // (sprite, subimage) -> entry
+      std::vector<PAGE> m_pages;
+      std::vector<int> m_backgrounds;
+
+      static CDSRegistry<CTextureAtlas> m_atlases;
+  };
+
+}
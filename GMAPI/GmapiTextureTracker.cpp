@@ -0,0 +1,489 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiTextureTracker.cpp                                             */
+/*   - Usage of textures and hints for their eviction                   */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiTextureTracker.h"
+#include "GmapiMemoryReport.h"
+#include "GmapiGameGraphics.h"
+#include "GmapiMacros.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace gm {
+
+  std::vector<CTextureTracker::TEXTURE> CTextureTracker::m_textures;
+  std::vector<int> CTextureTracker::m_lastFrames;
+  std::vector<int> CTextureTracker::m_appliedPriorities;
+  int CTextureTracker::m_frame = 1;
+
+  namespace {
+    bool FrameEnumProc( GMINSTANCE& aInstance, void* aParam ) {
+      if ( CGlobals::UseNewStructs() ) {
+        if ( aInstance.structNew.visible )
+          CTextureTracker::MarkSprite( aInstance.structNew.sprite_index, (int) floor( aInstance.structNew.image_index ) );
+      } else {
+        if ( aInstance.structOld.visible )
+          CTextureTracker::MarkSprite( aInstance.structOld.sprite_index, (int) floor( aInstance.structOld.image_index ) );
+      }
+
+      return true;
+    }
+
+    // Marks sprites of all instances in the room, visible or not
+    bool PresentEnumProc( GMINSTANCE& aInstance, void* aParam ) {
+      std::vector<bool>& sprites = *(std::vector<bool>*) aParam;
+      int sprite = ( CGlobals::UseNewStructs() ? aInstance.structNew.sprite_index : aInstance.structOld.sprite_index );
+
+      if ( sprite >= 0 ) {
+        if ( sprite >= (int) sprites.size() )
+          sprites.resize( sprite + 1, false );
+
+        sprites[sprite] = true;
+      }
+
+      return true;
+    }
+
+    // Textures most recently used first
+    struct RecentOrder {
+      const std::vector<CTextureTracker::TEXTURE>* textures;
+
+      bool operator()( int aFirst, int aSecond ) const {
+        return ( (*textures)[aFirst].lastFrame > (*textures)[aSecond].lastFrame );
+      }
+    };
+  }
+
+  /************************************************************************/
+  /* CTextureTracker class implementation                                 */
+  /************************************************************************/
+
+  void CTextureTracker::Frame() {
+    ++m_frame;
+    CGMAPI::Ptr()->EnumerateInstances( FrameEnumProc, NULL );
+  }
+
+  void CTextureTracker::MarkSprite( int aSprite, int aSubimage ) {
+    PGMSPRITESTORAGE storage = CGMAPI::SpriteData();
+
+    if ( !storage->sprites || aSprite < 0 || aSprite >= storage->arraySize || !storage->sprites[aSprite] )
+      return;
+
+    PGMSPRITE sprite = storage->sprites[aSprite];
+    int count = ( CGlobals::UseNewStructs() ? sprite->structNew.subimageCount : sprite->structOld.subimageCount );
+    const int* textures = ( CGlobals::UseNewStructs() ? sprite->structNew.textureIds :
+                                                        (const int*) sprite->structOld.textureIds );
+
+    if ( !textures || count <= 0 )
+      return;
+
+    if ( aSubimage >= 0 )
+      MarkTexture( textures[aSubimage % count] );
+    else {
+      for ( int i = 0; i < count; i++ )
+        MarkTexture( textures[i] );
+    }
+  }
+
+  void CTextureTracker::MarkBackground( int aBackground ) {
+    PGMBACKGROUNDSTORAGE storage = CGMAPI::BackgroundData();
+
+    if ( !storage->backgrounds || aBackground < 0 || aBackground >= storage->arraySize ||
+         !storage->backgrounds[aBackground] )
+      return;
+
+    PGMBACKGROUND background = storage->backgrounds[aBackground];
+    MarkTexture( CGlobals::UseNewStructs() ? background->structNew.textureId : background->structOld.textureId );
+  }
+
+  void CTextureTracker::Reset() {
+    m_lastFrames.clear();
+    m_appliedPriorities.clear();
+    m_textures.clear();
+  }
+
+  void CTextureTracker::SetOwner( std::vector<TEXTURE>& aTextures, int aTexture, OwnerKind aOwner,
+                                  int aOwnerId, int aSubimage ) {
+    if ( aTexture < 0 )
+      return;
+
+    if ( aTexture >= (int) aTextures.size() ) {
+      TEXTURE texture = { 0, TO_NONE, -1, 0, 0.0, 0, -1, false };
+      aTextures.resize( aTexture + 1, texture );
+    }
+
+    aTextures[aTexture].owner = aOwner;
+    aTextures[aTexture].ownerId = aOwnerId;
+    aTextures[aTexture].subimage = aSubimage;
+  }
+
+  double CTextureTracker::Scan() {
+    std::vector<TEXTURE> textures;
+    double result = 0.0;
+
+    PGMSPRITESTORAGE sprites = CGMAPI::SpriteData();
+
+    for ( int i = 0; sprites->sprites && i < sprites->arraySize; i++ ) {
+      PGMSPRITE sprite = sprites->sprites[i];
+
+      if ( !sprite )
+        continue;
+
+      int count = ( CGlobals::UseNewStructs() ? sprite->structNew.subimageCount : sprite->structOld.subimageCount );
+      const int* ids = ( CGlobals::UseNewStructs() ? sprite->structNew.textureIds :
+                                                     (const int*) sprite->structOld.textureIds );
+
+      for ( int n = 0; ids && n < count; n++ )
+        SetOwner( textures, ids[n], TO_SPRITE, i, n );
+    }
+
+    PGMBACKGROUNDSTORAGE backgrounds = CGMAPI::BackgroundData();
+
+    for ( int i = 0; backgrounds->backgrounds && i < backgrounds->arraySize; i++ ) {
+      PGMBACKGROUND background = backgrounds->backgrounds[i];
+
+      if ( background )
+        SetOwner( textures, ( CGlobals::UseNewStructs() ? background->structNew.textureId :
+                                                          background->structOld.textureId ), TO_BACKGROUND, i, 0 );
+    }
+
+    PGMFONTSTORAGE fonts = CGMAPI::FontData();
+
+    for ( int i = 0; fonts->fonts && i < fonts->arraySize; i++ ) {
+      if ( fonts->fonts[i] )
+        SetOwner( textures, fonts->fonts[i]->textureId, TO_FONT, i, 0 );
+    }
+
+    GMSURFACE* surfaces = CGMAPI::GetSurfaceArray();
+
+    for ( int i = 0; surfaces && i < *CGMAPI::SurfaceArraySizePtr(); i++ ) {
+      if ( surfaces[i].exists )
+        SetOwner( textures, surfaces[i].textureId, TO_SURFACE, i, 0 );
+    }
+
+    m_textures.clear();
+
+    for ( int i = 0; i < (int) textures.size(); i++ ) {
+      TEXTURE& texture = textures[i];
+
+      texture.id = i;
+      texture.bytes = CMemoryReport::GetTextureSize( i );
+      texture.lastFrame = ( i < (int) m_lastFrames.size() ? m_lastFrames[i] : 0 );
+
+      // Priorities set before belong to a deleted texture
+      if ( texture.bytes <= 0.0 ) {
+        if ( i < (int) m_appliedPriorities.size() )
+          m_appliedPriorities[i] = -1;
+
+        continue;
+      }
+
+      result += texture.bytes;
+      m_textures.push_back( texture );
+    }
+
+    return result;
+  }
+
+  double CTextureTracker::GetTotal( int aOwner, int aRecentFrames ) {
+    double result = 0.0;
+
+    for ( size_t i = 0; i < m_textures.size(); i++ ) {
+      const TEXTURE& texture = m_textures[i];
+
+      if ( aOwner >= 0 && texture.owner != aOwner )
+        continue;
+
+      if ( aRecentFrames > 0 && ( !texture.lastFrame || m_frame - texture.lastFrame >= aRecentFrames ) )
+        continue;
+
+      result += texture.bytes;
+    }
+
+    return result;
+  }
+
+  int CTextureTracker::Suggest( int aRecentFrames, double aBudget ) {
+    std::vector<bool> present;
+    std::vector<int> candidates;
+    double used = 0.0;
+    int result = 0;
+
+    CGMAPI::Ptr()->EnumerateInstances( PresentEnumProc, &present );
+
+    for ( size_t i = 0; i < m_textures.size(); i++ ) {
+      TEXTURE& texture = m_textures[i];
+      texture.preload = false;
+
+      // Surfaces are render targets, which stay in video memory
+      if ( texture.owner == TO_SURFACE ) {
+        texture.priority = -1;
+        used += texture.bytes;
+      } else if ( texture.lastFrame && m_frame - texture.lastFrame < std::max( aRecentFrames, 1 ) ) {
+        texture.priority = TP_RECENT;
+        used += texture.bytes;
+      } else if ( texture.owner == TO_SPRITE && texture.ownerId < (int) present.size() && present[texture.ownerId] ) {
+        texture.priority = TP_PRESENT;
+        candidates.push_back( (int) i );
+      } else
+        texture.priority = TP_UNUSED;
+    }
+
+    RecentOrder order = { &m_textures };
+    std::stable_sort( candidates.begin(), candidates.end(), order );
+
+    for ( size_t i = 0; i < candidates.size(); i++ ) {
+      TEXTURE& texture = m_textures[candidates[i]];
+
+      if ( aBudget > 0.0 && used + texture.bytes > aBudget )
+        break;
+
+      used += texture.bytes;
+      texture.preload = true;
+      ++result;
+    }
+
+    return result;
+  }
+
+  int CTextureTracker::Apply() {
+    int result = 0;
+
+    for ( size_t i = 0; i < m_textures.size(); i++ ) {
+      TEXTURE& texture = m_textures[i];
+
+      if ( texture.priority >= 0 ) {
+        if ( texture.id >= (int) m_appliedPriorities.size() )
+          m_appliedPriorities.resize( texture.id + 1, -1 );
+
+        if ( m_appliedPriorities[texture.id] != texture.priority ) {
+          texture_set_priority( texture.id, texture.priority );
+          m_appliedPriorities[texture.id] = texture.priority;
+          ++result;
+        }
+      }
+
+      if ( texture.preload ) {
+        texture_preload( texture.id );
+        texture.preload = false;
+        ++result;
+      }
+    }
+
+    return result;
+  }
+
+  /************************************************************************/
+  /* GML functions                                                        */
+  /************************************************************************/
+
+#ifdef _MSC_VER
+
+  namespace {
+    bool functionsRegistered = false;
+
+    void MarkSpriteArgs( PGMINSTANCE aSelf, GMVALUE* aArgs ) {
+      int subimage = (int) floor( aArgs[1].real );
+
+      // Subimage -1 is the current image of the calling instance
+      if ( subimage < 0 && aSelf )
+        subimage = (int) floor( CGlobals::UseNewStructs() ? aSelf->structNew.image_index :
+                                                            aSelf->structOld.image_index );
+
+      CTextureTracker::MarkSprite( (int) aArgs[0].real, subimage );
+    }
+
+    void MarkBackgroundArgs( PGMINSTANCE aSelf, GMVALUE* aArgs ) {
+      CTextureTracker::MarkBackground( (int) aArgs[0].real );
+    }
+
+  #define GMAPI_TEXTURETRACKER_HANDLER( aFunction, aMark ) \
+    GMFUCTION runner##aFunction = NULL;\
+    \
+    void aFunction( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,\
+                    int aArgCount, PGMVALUE aResult ) {\
+      aMark( aSelf, aArgs );\
+      core::RunnerCallFunction( runner##aFunction, aArgs, aArgCount, aResult );\
+    }\
+    \
+    GMAPI_GMFUNCTION_GENERATEHANDLER( aFunction )
+
+    GMAPI_TEXTURETRACKER_HANDLER( DrawSprite, MarkSpriteArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawSpriteStretched, MarkSpriteArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawSpriteTiled, MarkSpriteArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawSpritePart, MarkSpriteArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawSpriteExt, MarkSpriteArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawSpriteStretchedExt, MarkSpriteArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawSpriteTiledExt, MarkSpriteArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawSpritePartExt, MarkSpriteArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawSpriteGeneral, MarkSpriteArgs )
+
+    GMAPI_TEXTURETRACKER_HANDLER( DrawBackground, MarkBackgroundArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawBackgroundStretched, MarkBackgroundArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawBackgroundTiled, MarkBackgroundArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawBackgroundPart, MarkBackgroundArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawBackgroundExt, MarkBackgroundArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawBackgroundStretchedExt, MarkBackgroundArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawBackgroundTiledExt, MarkBackgroundArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawBackgroundPartExt, MarkBackgroundArgs )
+    GMAPI_TEXTURETRACKER_HANDLER( DrawBackgroundGeneral, MarkBackgroundArgs )
+
+    void TextureTrackerFrame( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      CTextureTracker::Frame();
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( TextureTrackerFrame )
+
+    void TextureTrackerMark( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      CTextureTracker::MarkTexture( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( TextureTrackerMark )
+
+    void TextureTrackerMarkBackground( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                       int aArgCount, PGMVALUE aResult ) {
+      CTextureTracker::MarkBackground( (int) aArgs[0].real );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( TextureTrackerMarkBackground )
+
+    void TextureTrackerScan( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                             int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( CTextureTracker::Scan() );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( TextureTrackerScan )
+
+    void TextureTrackerTotal( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( CTextureTracker::GetTotal( (int) aArgs[0].real, (int) aArgs[1].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( TextureTrackerTotal )
+
+    void TextureTrackerSuggest( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                                int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CTextureTracker::Suggest( (int) aArgs[0].real, aArgs[1].real ) );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( TextureTrackerSuggest )
+
+    void TextureTrackerApply( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CTextureTracker::Apply() );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( TextureTrackerApply )
+
+    void TextureTrackerCount( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      aResult->Set( (double) CTextureTracker::GetTextures().size() );
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( TextureTrackerCount )
+
+    void TextureTrackerGet( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                            int aArgCount, PGMVALUE aResult ) {
+      const std::vector<CTextureTracker::TEXTURE>& textures = CTextureTracker::GetTextures();
+      int index = (int) aArgs[0].real;
+
+      aResult->Set( -1.0 );
+
+      if ( index < 0 || index >= (int) textures.size() )
+        return;
+
+      const CTextureTracker::TEXTURE& texture = textures[index];
+
+      switch ( (int) aArgs[1].real ) {
+        case CTextureTracker::TF_OWNER: aResult->Set( (double) texture.owner ); break;
+        case CTextureTracker::TF_OWNER_ID: aResult->Set( (double) texture.ownerId ); break;
+        case CTextureTracker::TF_SUBIMAGE: aResult->Set( (double) texture.subimage ); break;
+        case CTextureTracker::TF_BYTES: aResult->Set( texture.bytes ); break;
+        case CTextureTracker::TF_PRIORITY: aResult->Set( (double) texture.priority ); break;
+        case CTextureTracker::TF_PRELOAD: aResult->Set( texture.preload ? 1.0 : 0.0 ); break;
+        case CTextureTracker::TF_AGE:
+          if ( texture.lastFrame )
+            aResult->Set( (double) ( CTextureTracker::GetFrame() - texture.lastFrame ) );
+          break;
+      }
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( TextureTrackerGet )
+
+    void TextureTrackerReset( PGMINSTANCE aSelf, PGMINSTANCE aOther, GMVALUE* aArgs,
+                              int aArgCount, PGMVALUE aResult ) {
+      CTextureTracker::Reset();
+    }
+
+    GMAPI_GMFUNCTION_GENERATEHANDLER( TextureTrackerReset )
+  }
+
+  void CTextureTracker::RegisterGMFunctions() {
+    if ( functionsRegistered )
+      return;
+
+    functionsRegistered = true;
+
+    GMAPI_GMFUNCTION_REGISTER( "texture_tracker_frame", 0, TextureTrackerFrame );
+    GMAPI_GMFUNCTION_REGISTER( "texture_tracker_mark", 1, TextureTrackerMark );
+    GMAPI_GMFUNCTION_REGISTER( "texture_tracker_mark_background", 1, TextureTrackerMarkBackground );
+    GMAPI_GMFUNCTION_REGISTER( "texture_tracker_scan", 0, TextureTrackerScan );
+    GMAPI_GMFUNCTION_REGISTER( "texture_tracker_total", 2, TextureTrackerTotal );
+    GMAPI_GMFUNCTION_REGISTER( "texture_tracker_suggest", 2, TextureTrackerSuggest );
+    GMAPI_GMFUNCTION_REGISTER( "texture_tracker_apply", 0, TextureTrackerApply );
+    GMAPI_GMFUNCTION_REGISTER( "texture_tracker_count", 0, TextureTrackerCount );
+    GMAPI_GMFUNCTION_REGISTER( "texture_tracker_get", 2, TextureTrackerGet );
+    GMAPI_GMFUNCTION_REGISTER( "texture_tracker_reset", 0, TextureTrackerReset );
+
+    runnerDrawSprite = GMAPI_GMFUNCTION_OVERRIDE( id_draw_sprite, DrawSprite );
+    runnerDrawSpriteStretched = GMAPI_GMFUNCTION_OVERRIDE( id_draw_sprite_stretched, DrawSpriteStretched );
+    runnerDrawSpriteTiled = GMAPI_GMFUNCTION_OVERRIDE( id_draw_sprite_tiled, DrawSpriteTiled );
+    runnerDrawSpritePart = GMAPI_GMFUNCTION_OVERRIDE( id_draw_sprite_part, DrawSpritePart );
+    runnerDrawSpriteExt = GMAPI_GMFUNCTION_OVERRIDE( id_draw_sprite_ext, DrawSpriteExt );
+    runnerDrawSpriteStretchedExt = GMAPI_GMFUNCTION_OVERRIDE( id_draw_sprite_stretched_ext, DrawSpriteStretchedExt );
+    runnerDrawSpriteTiledExt = GMAPI_GMFUNCTION_OVERRIDE( id_draw_sprite_tiled_ext, DrawSpriteTiledExt );
+    runnerDrawSpritePartExt = GMAPI_GMFUNCTION_OVERRIDE( id_draw_sprite_part_ext, DrawSpritePartExt );
+    runnerDrawSpriteGeneral = GMAPI_GMFUNCTION_OVERRIDE( id_draw_sprite_general, DrawSpriteGeneral );
+
+    runnerDrawBackground = GMAPI_GMFUNCTION_OVERRIDE( id_draw_background, DrawBackground );
+    runnerDrawBackgroundStretched = GMAPI_GMFUNCTION_OVERRIDE( id_draw_background_stretched,
+                                                               DrawBackgroundStretched );
+    runnerDrawBackgroundTiled = GMAPI_GMFUNCTION_OVERRIDE( id_draw_background_tiled, DrawBackgroundTiled );
+    runnerDrawBackgroundPart = GMAPI_GMFUNCTION_OVERRIDE( id_draw_background_part, DrawBackgroundPart );
+    runnerDrawBackgroundExt = GMAPI_GMFUNCTION_OVERRIDE( id_draw_background_ext, DrawBackgroundExt );
+    runnerDrawBackgroundStretchedExt = GMAPI_GMFUNCTION_OVERRIDE( id_draw_background_stretched_ext,
+                                                                  DrawBackgroundStretchedExt );
+    runnerDrawBackgroundTiledExt = GMAPI_GMFUNCTION_OVERRIDE( id_draw_background_tiled_ext,
+                                                              DrawBackgroundTiledExt );
+    runnerDrawBackgroundPartExt = GMAPI_GMFUNCTION_OVERRIDE( id_draw_background_part_ext, DrawBackgroundPartExt );
+    runnerDrawBackgroundGeneral = GMAPI_GMFUNCTION_OVERRIDE( id_draw_background_general, DrawBackgroundGeneral );
+  }
+
+#endif
+
+}
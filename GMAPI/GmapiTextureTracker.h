@@ -0,0 +1,197 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiTextureTracker.h                                               */
+/*   - Usage of textures and hints for their eviction                   */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include <vector>
+
+namespace gm {
+
+  /// CTextureTracker
+  ///   Tracks which textures of the runner were drawn recently and
+  ///   suggests their priorities (texture_set_priority) and preloading
+  ///   (texture_preload), so that the textures needed now stay in video
+  ///   memory when it runs out.
+  ///
+  ///   Frame should be called once per step; it advances the frame
+  ///   counter and marks the current subimages of visible instances,
+  ///   which the runner draws by itself. Calls of the draw_sprite* and
+  ///   draw_background* functions mark their textures. Other drawing done
+  ///   by the runner (room backgrounds, tiles) and textures passed to the
+  ///   primitive functions are not seen; they can be marked by
+  ///   MarkBackground and MarkTexture.
+  ///
+  ///   Scan walks the texture array up to the largest texture ID used by
+  ///   a resource, like CMemoryReport, and finds the resource owning each
+  ///   texture.
+  ///
+  class CTextureTracker {
+    public:
+      /// Owners of textures
+      enum OwnerKind { TO_NONE, TO_SPRITE, TO_BACKGROUND, TO_FONT, TO_SURFACE, TO_COUNT };
+
+      /// Suggested priorities
+      enum Priority { TP_UNUSED, TP_PRESENT, TP_RECENT };
+
+      /// Fields of texture_tracker_get
+      enum TextureField { TF_OWNER, TF_OWNER_ID, TF_SUBIMAGE, TF_BYTES, TF_AGE, TF_PRIORITY, TF_PRELOAD };
+
+      /// Texture found by Scan
+      struct TEXTURE {
+        int id;
+        OwnerKind owner;
+        int ownerId;
+        int subimage;             // Subimage of the owning sprite, otherwise 0
+        double bytes;
+        int lastFrame;            // 0 if the texture has not been used
+        int priority;             // Priority value or -1, set by Suggest
+        bool preload;             // Set by Suggest
+      };
+
+      /************************************************************************/
+      /* Tracking                                                             */
+      /************************************************************************/
+
+      /// Frame()
+      ///   Starts a new frame and marks subimages of visible instances.
+      ///
+      static void Frame();
+
+      static int GetFrame() {
+        return m_frame;
+      }
+
+      /// MarkTexture( int aTexture )
+      ///   Marks the texture as used in the current frame.
+      ///
+      static void MarkTexture( int aTexture ) {
+        if ( aTexture >= 0 ) {
+          if ( aTexture >= (int) m_lastFrames.size() )
+            m_lastFrames.resize( aTexture + 1, 0 );
+
+          m_lastFrames[aTexture] = m_frame;
+        }
+      }
+
+      /// MarkSprite( int aSprite, int aSubimage )
+      ///   Marks texture of the subimage; subimages are wrapped like in
+      ///   draw_sprite, negative values mark all subimages.
+      ///
+      static void MarkSprite( int aSprite, int aSubimage );
+
+      /// MarkBackground( int aBackground )
+      ///   Marks texture of the background.
+      ///
+      static void MarkBackground( int aBackground );
+
+      /// Reset()
+      ///   Forgets usage of all textures.
+      ///
+      static void Reset();
+
+      /************************************************************************/
+      /* Textures                                                             */
+      /************************************************************************/
+
+      /// Scan()
+      ///   Finds all valid textures, their owners and sizes.
+      ///
+      /// Returns:
+      ///   Total number of bytes of the textures.
+      ///
+      static double Scan();
+
+      static const std::vector<TEXTURE>& GetTextures() {
+        return m_textures;
+      }
+
+      /// GetTotal( int aOwner, int aRecentFrames )
+      ///   Returns number of bytes of the scanned textures of the owner
+      ///   kind, or of all of them if aOwner is -1. If aRecentFrames is
+      ///   positive, only textures used in that many last frames are
+      ///   summed.
+      ///
+      static double GetTotal( int aOwner, int aRecentFrames );
+
+      /// Suggest( int aRecentFrames, double aBudget )
+      ///   Sets priority and preload hints of the scanned textures:
+      ///     TP_RECENT - used in aRecentFrames last frames
+      ///     TP_PRESENT - not used recently, but a sprite of an instance
+      ///       in the room; these are suggested for preloading
+      ///     TP_UNUSED - others; they can be evicted first
+      ///   If aBudget is positive, textures are preloaded only while all
+      ///   textures of higher priorities fit into aBudget bytes. Surfaces
+      ///   get no hints, the runner keeps them in video memory.
+      ///
+      /// Returns:
+      ///   Number of textures suggested for preloading.
+      ///
+      static int Suggest( int aRecentFrames, double aBudget );
+
+      /// Apply()
+      ///   Calls texture_set_priority for the textures whose suggested
+      ///   priority has not been set yet and texture_preload for the ones
+      ///   suggested for preloading.
+      ///
+      /// Returns:
+      ///   Number of calls.
+      ///
+      static int Apply();
+
+    #ifdef _MSC_VER
+      /// RegisterGMFunctions()
+      ///   Registers the following GML functions:
+      ///     texture_tracker_frame() - calls Frame
+      ///     texture_tracker_mark( tex ) - marks the texture
+      ///     texture_tracker_mark_background( back ) - marks texture of
+      ///       the background (for tiles and room backgrounds)
+      ///     texture_tracker_scan() - scans the textures; returns total
+      ///       number of bytes
+      ///     texture_tracker_total( owner, frames ) - returns GetTotal
+      ///       (owner is TO_* value)
+      ///     texture_tracker_suggest( frames, budget ) - returns Suggest
+      ///     texture_tracker_apply() - returns Apply
+      ///     texture_tracker_count() - returns number of scanned textures
+      ///     texture_tracker_get( index, field ) - returns field (TF_*
+      ///       value) of the scanned texture; TF_AGE is number of frames
+      ///       since its last use or -1
+      ///     texture_tracker_reset() - forgets usage of all textures
+      ///   It also overrides the draw_sprite* and draw_background*
+      ///   functions to mark the drawn textures.
+      ///
+      static void RegisterGMFunctions();
+    #endif
+
+    private:
+      static void SetOwner( std::vector<TEXTURE>& aTextures, int aTexture, OwnerKind aOwner,
+                            int aOwnerId, int aSubimage );
+
+      static std::vector<TEXTURE> m_textures;
+      static std::vector<int> m_lastFrames;      // Frames of last use by texture IDs
+      static std::vector<int> m_appliedPriorities;
+      static int m_frame;
+  };
+
+}
@@ -0,0 +1,293 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiUtilities.cpp                                                  */
+/*   - Helper classes used by the native GMAPI extensions               */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "GmapiUtilities.h"
+#include "GmapiResources.h"
+
+#include <emmintrin.h>
+#include <math.h>
+#include <algorithm>
+
+namespace gm {
+
+  /************************************************************************/
+  /* CCpuInfo class implementation                                        */
+  /************************************************************************/
+
+  int CCpuInfo::m_sse2 = -1;
+  int CCpuInfo::m_processorCount = 0;
+
+  bool CCpuInfo::HasSSE2() {
+    if ( m_sse2 < 0 )
+      m_sse2 = ( IsProcessorFeaturePresent( PF_XMMI64_INSTRUCTIONS_AVAILABLE ) ? 1 : 0 );
+
+    return ( m_sse2 != 0 );
+  }
+
+  void CCpuInfo::SetSSE2( bool aEnabled ) {
+    m_sse2 = ( aEnabled && IsProcessorFeaturePresent( PF_XMMI64_INSTRUCTIONS_AVAILABLE ) ? 1 : 0 );
+  }
+
+  int CCpuInfo::GetProcessorCount() {
+    if ( !m_processorCount ) {
+      SYSTEM_INFO info;
+      GetSystemInfo( &info );
+      m_processorCount = ( info.dwNumberOfProcessors > 0 ? (int) info.dwNumberOfProcessors : 1 );
+    }
+
+    return m_processorCount;
+  }
+
+  /************************************************************************/
+  /* CParallel class implementation                                       */
+  /************************************************************************/
+
+  // Upper limit of threads used by CParallel::For
+  static const int MAX_PARALLEL_PARTS = 32;
+
+  DWORD WINAPI CParallel::PartProc( LPVOID aParam ) {
+    PART* part = (PART*) aParam;
+    part->proc( part->context, part->begin, part->end );
+
+    return 0;
+  }
+
+  void CParallel::For( int aCount, int aMinimumCount, RANGEPROC aProc, void* aContext ) {
+    int parts = std::min( CCpuInfo::GetProcessorCount(), MAX_PARALLEL_PARTS );
+
+    if ( aMinimumCount > 0 )
+      parts = std::min( parts, aCount / aMinimumCount );
+
+    if ( parts <= 1 ) {
+      if ( aCount > 0 )
+        aProc( aContext, 0, aCount );
+
+      return;
+    }
+
+    PART part[MAX_PARALLEL_PARTS];
+    HANDLE threads[MAX_PARALLEL_PARTS];
+
+    for ( int i = 0; i < parts; i++ ) {
+      part[i].proc = aProc;
+      part[i].context = aContext;
+      part[i].begin = (int) ( (__int64) aCount * i / parts );
+      part[i].end = (int) ( (__int64) aCount * ( i + 1 ) / parts );
+    }
+
+    // The first part is left for the calling thread; parts whose thread
+    // could not be created are processed by it as well
+    for ( int i = 1; i < parts; i++ )
+      threads[i] = CreateThread( NULL, 0, PartProc, &part[i], 0, NULL );
+
+    PartProc( &part[0] );
+
+    for ( int i = 1; i < parts; i++ ) {
+      if ( threads[i] ) {
+        WaitForSingleObject( threads[i], INFINITE );
+        CloseHandle( threads[i] );
+      } else
+        PartProc( &part[i] );
+    }
+  }
+
+  /************************************************************************/
+  /* CRandom class implementation                                         */
+  /************************************************************************/
+
+  // 1 / 2^31 - lanes are shifted right by one bit before conversion,
+  // because SSE2 can convert only signed integers to doubles
+  static const double RANDOM_SCALE = 1.0 / 2147483648.0;
+
+  void CRandom::Seed( unsigned long aSeed ) {
+    DWORD state = ( aSeed ? aSeed : GetTickCount() );
+
+    for ( int i = 0; i < 4; i++ ) {
+      state = state * 1664525 + 1013904223;
+      m_x[i] = state ^ 0x6C078965;
+      state = state * 1664525 + 1013904223;
+      m_y[i] = state;
+      state = state * 1664525 + 1013904223;
+      m_z[i] = state;
+      state = state * 1664525 + 1013904223;
+      m_w[i] = ( state ? state : 0x9E3779B9 );
+    }
+
+    m_pendingCount = 0;
+  }
+
+  double CRandom::NextDouble() {
+    if ( !m_pendingCount ) {
+      FillScalar( m_pending, 4 );
+      m_pendingCount = 4;
+    }
+
+    return m_pending[4 - m_pendingCount--];
+  }
+
+  void CRandom::Fill( double* aBuffer, int aCount ) {
+    int i = 0;
+
+    while ( m_pendingCount && i < aCount )
+      aBuffer[i++] = m_pending[4 - m_pendingCount--];
+
+    int blockCount = ( aCount - i ) & ~3;
+
+    if ( blockCount ) {
+      if ( CCpuInfo::HasSSE2() )
+        FillSSE2( aBuffer + i, blockCount );
+      else
+        FillScalar( aBuffer + i, blockCount );
+
+      i += blockCount;
+    }
+
+    while ( i < aCount )
+      aBuffer[i++] = NextDouble();
+  }
+
+  void CRandom::FillScalar( double* aBuffer, int aCount ) {
+    for ( int i = 0; i < aCount; i += 4 ) {
+      for ( int lane = 0; lane < 4; lane++ ) {
+        DWORD t = m_x[lane] ^ ( m_x[lane] << 11 );
+
+        m_x[lane] = m_y[lane];
+        m_y[lane] = m_z[lane];
+        m_z[lane] = m_w[lane];
+        m_w[lane] = m_w[lane] ^ ( m_w[lane] >> 19 ) ^ ( t ^ ( t >> 8 ) );
+
+        aBuffer[i + lane] = (int) ( m_w[lane] >> 1 ) * RANDOM_SCALE;
+      }
+    }
+  }
+
+  void CRandom::FillSSE2( double* aBuffer, int aCount ) {
+    __m128i x = _mm_loadu_si128( (const __m128i*) m_x );
+    __m128i y = _mm_loadu_si128( (const __m128i*) m_y );
+    __m128i z = _mm_loadu_si128( (const __m128i*) m_z );
+    __m128i w = _mm_loadu_si128( (const __m128i*) m_w );
+    const __m128d scale = _mm_set1_pd( RANDOM_SCALE );
+
+    for ( int i = 0; i < aCount; i += 4 ) {
+      __m128i t = _mm_xor_si128( x, _mm_slli_epi32( x, 11 ) );
+
+      x = y;
+      y = z;
+      z = w;
+      w = _mm_xor_si128( _mm_xor_si128( w, _mm_srli_epi32( w, 19 ) ),
+                         _mm_xor_si128( t, _mm_srli_epi32( t, 8 ) ) );
+
+      __m128i value = _mm_srli_epi32( w, 1 );
+
+      _mm_storeu_pd( aBuffer + i, _mm_mul_pd( _mm_cvtepi32_pd( value ), scale ) );
+      _mm_storeu_pd( aBuffer + i + 2,
+                     _mm_mul_pd( _mm_cvtepi32_pd( _mm_shuffle_epi32( value, _MM_SHUFFLE( 3, 2, 3, 2 ) ) ),
+                                 scale ) );
+    }
+
+    _mm_storeu_si128( (__m128i*) m_x, x );
+    _mm_storeu_si128( (__m128i*) m_y, y );
+    _mm_storeu_si128( (__m128i*) m_z, z );
+    _mm_storeu_si128( (__m128i*) m_w, w );
+  }
+
+  /************************************************************************/
+  /* CRoomInstances class implementation                                  */
+  /************************************************************************/
+
+  PGMINSTANCE* CRoomInstances::GetArray( int& aCount ) {
+    BYTE* roomPtr = (BYTE*) CGMAPI::GetCurrentRoomPtr();
+
+    if ( !roomPtr ) {
+      aCount = 0;
+      return NULL;
+    }
+
+    aCount = *((int*) (roomPtr + 0x68));
+    return *((PGMINSTANCE**) (roomPtr + 0x6C));
+  }
+
+  PGMINSTANCE CRoomInstances::Find( int aId ) {
+    int count = 0;
+    PGMINSTANCE* instances = GetArray( count );
+
+    for ( int i = 0; instances && i < count; i++ ) {
+      if ( instances[i] && GetID( instances[i] ) == aId )
+        return instances[i];
+    }
+
+    return NULL;
+  }
+
+  void CRoomInstances::SetMotion( PGMINSTANCE aInstance, double aDirection, double aSpeed ) {
+    double angle = aDirection * ( 3.14159265358979323846 / 180.0 );
+    double hspeed = aSpeed * cos( angle );
+    double vspeed = -aSpeed * sin( angle );
+
+    if ( CGlobals::UseNewStructs() ) {
+      aInstance->structNew.direction = aDirection;
+      aInstance->structNew.speed = aSpeed;
+      aInstance->structNew.hspeed = hspeed;
+      aInstance->structNew.vspeed = vspeed;
+    } else {
+      aInstance->structOld.direction = aDirection;
+      aInstance->structOld.speed = aSpeed;
+      aInstance->structOld.hspeed = hspeed;
+      aInstance->structOld.vspeed = vspeed;
+    }
+  }
+
+  /************************************************************************/
+  /* CInstanceFilter class implementation                                 */
+  /************************************************************************/
+
+  bool CInstanceFilter::Matches( PGMINSTANCE aInstance ) {
+    if ( !aInstance || CRoomInstances::IsDeactivated( aInstance ) )
+      return false;
+
+    if ( m_object == gm::all )
+      return true;
+
+    if ( m_object >= 100000 )
+      return ( CRoomInstances::GetID( aInstance ) == m_object );
+
+    if ( m_object < 0 )
+      return false;
+
+    int objectId = CRoomInstances::GetObjectID( aInstance );
+
+    if ( objectId == m_object )
+      return true;
+
+    std::map<int, bool>::iterator it = m_ancestors.find( objectId );
+
+    if ( it == m_ancestors.end() )
+      it = m_ancestors.insert( std::make_pair( objectId, object_is_ancestor( objectId, m_object ) ) ).first;
+
+    return it->second;
+  }
+
+}
@@ -0,0 +1,325 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  GmapiUtilities.h                                                    */
+/*   - Helper classes used by the native GMAPI extensions               */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiInternal.h"
+
+#include <map>
+
+namespace gm {
+
+  /************************************************************************/
+  /* CCpuInfo                                                             */
+  /************************************************************************/
+
+  /// CCpuInfo
+  ///   Provides information about the processor the game runs on.
+  ///   Used by the native extensions to choose between SSE2 and
+  ///   plain C++ code paths at runtime.
+  ///
+  class CCpuInfo {
+    public:
+      /// HasSSE2()
+      ///   Checks whether the processor supports SSE2 instructions.
+      ///   The result is cached after the first call.
+      ///
+      /// Returns:
+      ///   True if SSE2 instructions are available.
+      ///
+      static bool HasSSE2();
+
+      /// SetSSE2( bool aEnabled )
+      ///   Overrides the detection; while SSE2 is disabled, the native
+      ///   extensions use their plain C++ code paths (e.g. to compare
+      ///   them in tests). SSE2 cannot be enabled if the processor does
+      ///   not support it.
+      ///
+      static void SetSSE2( bool aEnabled );
+
+      /// GetProcessorCount()
+      ///   Returns number of logical processors. The result is cached
+      ///   after the first call.
+      ///
+      static int GetProcessorCount();
+
+    private:
+      static int m_sse2;
+      static int m_processorCount;
+  };
+
+  /************************************************************************/
+  /* CCriticalSection                                                     */
+  /************************************************************************/
+
+  /// CCriticalSection
+  ///   Wrapper of the Win32 critical section, used by the native extensions
+  ///   that run work in background threads. Use CCriticalSectionLock to
+  ///   enter the section for the lifetime of a scope.
+  ///
+  class CCriticalSection {
+    public:
+      CCriticalSection() {
+        InitializeCriticalSection( &m_section );
+      }
+
+      ~CCriticalSection() {
+        DeleteCriticalSection( &m_section );
+      }
+
+      void Enter() {
+        EnterCriticalSection( &m_section );
+      }
+
+      void Leave() {
+        LeaveCriticalSection( &m_section );
+      }
+
+    private:
+      CCriticalSection( const CCriticalSection& );
+      CCriticalSection& operator=( const CCriticalSection& );
+
+      CRITICAL_SECTION m_section;
+  };
+
+  class CCriticalSectionLock {
+    public:
+      explicit CCriticalSectionLock( CCriticalSection& aSection ): m_section( aSection ) {
+        m_section.Enter();
+      }
+
+      ~CCriticalSectionLock() {
+        m_section.Leave();
+      }
+
+    private:
+      CCriticalSectionLock( const CCriticalSectionLock& );
+      CCriticalSectionLock& operator=( const CCriticalSectionLock& );
+
+      CCriticalSection& m_section;
+  };
+
+  /************************************************************************/
+  /* CParallel                                                            */
+  /************************************************************************/
+
+  /// CParallel
+  ///   Splits a range of items (e.g. rows of an image) into contiguous
+  ///   parts processed by all processors at once. Threads are created for
+  ///   each call, so only ranges worth at least a millisecond of work
+  ///   should be split; smaller ones are processed by the calling thread.
+  ///
+  class CParallel {
+    public:
+      typedef void (*RANGEPROC)( void* aContext, int aBegin, int aEnd );
+
+      /// For( int aCount, int aMinimumCount, RANGEPROC aProc, void* aContext )
+      ///   Calls aProc for parts of range [0, aCount) and waits until all
+      ///   of them are processed. The parts are disjoint and not smaller
+      ///   than aMinimumCount items; one of them is processed by the
+      ///   calling thread.
+      ///
+      static void For( int aCount, int aMinimumCount, RANGEPROC aProc, void* aContext );
+
+    private:
+      struct PART {
+        RANGEPROC proc;
+        void* context;
+        int begin;
+        int end;
+      };
+
+      static DWORD WINAPI PartProc( LPVOID aParam );
+  };
+
+  /************************************************************************/
+  /* CRandom                                                              */
+  /************************************************************************/
+
+  /// CRandom
+  ///   Fast pseudo-random number generator (four interleaved xorshift128
+  ///   generators). The four lanes are advanced together, so when SSE2
+  ///   is available the Fill method produces four numbers per iteration.
+  ///   Both code paths generate exactly the same sequence.
+  ///
+  class CRandom {
+    public:
+      /// Ctor( unsigned long aSeed )
+      ///   Initializes the generator with specified seed.
+      ///
+      /// Parameters:
+      ///   aSeed: [optional] Initial seed. If 0 is specified, the seed
+      ///          is taken from the system tick count.
+      ///
+      explicit CRandom( unsigned long aSeed = 0 ) {
+        Seed( aSeed );
+      }
+
+      /// Seed( unsigned long aSeed )
+      ///   Reinitializes the generator.
+      ///
+      /// Parameters:
+      ///   aSeed: New seed. If 0 is specified, the seed is taken from
+      ///          the system tick count.
+      ///
+      void Seed( unsigned long aSeed );
+
+      /// NextDouble()
+      ///   Returns a random number in range [0, 1).
+      ///
+      double NextDouble();
+
+      /// Fill( double* aBuffer, int aCount )
+      ///   Fills the buffer with random numbers in range [0, 1).
+      ///
+      /// Parameters:
+      ///   aBuffer: Pointer to the buffer.
+      ///   aCount: Number of elements to generate.
+      ///
+      void Fill( double* aBuffer, int aCount );
+
+    private:
+      void FillScalar( double* aBuffer, int aCount );
+      void FillSSE2( double* aBuffer, int aCount );
+
+      // Lane states, stored as structure of arrays so that each
+      // of the x/y/z/w rows can be loaded into a single SSE register
+      DWORD m_x[4];
+      DWORD m_y[4];
+      DWORD m_z[4];
+      DWORD m_w[4];
+
+      double m_pending[4];
+      int m_pendingCount;
+  };
+
+  /************************************************************************/
+  /* CRoomInstances                                                       */
+  /************************************************************************/
+
+  /// CRoomInstances
+  ///   Direct access to the instances of the current room and to the
+  ///   instance fields used by the native extensions. The accessors
+  ///   handle both GM6.1/7 and GM8 instance structures.
+  ///
+  class CRoomInstances {
+    public:
+      /// GetArray( int& aCount )
+      ///   Returns the runner's array of instances in the current room.
+      ///   The array may contain NULL entries.
+      ///
+      /// Parameters:
+      ///   aCount: Receives the size of the array.
+      ///
+      /// Returns:
+      ///   Pointer to the array or NULL when there is no room.
+      ///
+      static PGMINSTANCE* GetArray( int& aCount );
+
+      /// Find( int aId )
+      ///   Looks up the instance with the specified ID in the current room.
+      ///
+      /// Returns:
+      ///   Pointer to the instance or NULL if it does not exist.
+      ///
+      static PGMINSTANCE Find( int aId );
+
+      static int GetID( PGMINSTANCE aInstance ) {
+        return ( CGlobals::UseNewStructs() ? aInstance->structNew.id : aInstance->structOld.id );
+      }
+
+      static int GetObjectID( PGMINSTANCE aInstance ) {
+        return ( CGlobals::UseNewStructs() ? aInstance->structNew.object_index : aInstance->structOld.object_index );
+      }
+
+      static bool IsSolid( PGMINSTANCE aInstance ) {
+        return ( CGlobals::UseNewStructs() ? aInstance->structNew.solid : aInstance->structOld.solid );
+      }
+
+      static bool IsDeactivated( PGMINSTANCE aInstance ) {
+        return ( CGlobals::UseNewStructs() ? aInstance->structNew.deactivated : aInstance->structOld.deactivated );
+      }
+
+      static void GetPosition( PGMINSTANCE aInstance, double& aX, double& aY ) {
+        if ( CGlobals::UseNewStructs() ) {
+          aX = aInstance->structNew.x;
+          aY = aInstance->structNew.y;
+        } else {
+          aX = aInstance->structOld.x;
+          aY = aInstance->structOld.y;
+        }
+      }
+
+      /// SetMotion( PGMINSTANCE aInstance, double aDirection, double aSpeed )
+      ///   Sets direction and speed of the instance and updates hspeed and
+      ///   vspeed, like assignment to the variables in GML does.
+      ///
+      static void SetMotion( PGMINSTANCE aInstance, double aDirection, double aSpeed );
+
+      /// GetBoundingBox( PGMINSTANCE aInstance, int& aLeft, int& aTop, int& aRight, int& aBottom )
+      ///   Retrieves the instance's bounding box (bbox_* variables). Right
+      ///   and bottom edges are inclusive.
+      ///
+      static void GetBoundingBox( PGMINSTANCE aInstance, int& aLeft, int& aTop, int& aRight, int& aBottom ) {
+        if ( CGlobals::UseNewStructs() ) {
+          aLeft = aInstance->structNew.bbox_left;
+          aTop = aInstance->structNew.bbox_top;
+          aRight = aInstance->structNew.bbox_right;
+          aBottom = aInstance->structNew.bbox_bottom;
+        } else {
+          aLeft = aInstance->structOld.bbox_left;
+          aTop = aInstance->structOld.bbox_top;
+          aRight = aInstance->structOld.bbox_right;
+          aBottom = aInstance->structOld.bbox_bottom;
+        }
+      }
+  };
+
+  /************************************************************************/
+  /* CInstanceFilter                                                      */
+  /************************************************************************/
+
+  /// CInstanceFilter
+  ///   Matches instances the same way as GM functions taking an "obj"
+  ///   argument: object ID (including children of the object), instance
+  ///   ID or the "all" keyword. Deactivated instances never match.
+  ///   Results of object_is_ancestor are cached, so the runner is asked
+  ///   at most once per object during the filter's lifetime.
+  ///
+  class CInstanceFilter {
+    public:
+      explicit CInstanceFilter( int aObject ): m_object( aObject ) {}
+
+      /// Matches( PGMINSTANCE aInstance )
+      ///   Checks whether the instance matches the filter.
+      ///
+      bool Matches( PGMINSTANCE aInstance );
+
+    private:
+      int m_object;
+      std::map<int, bool> m_ancestors;
+  };
+
+}
@@ -0,0 +1,378 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestBitmapStore.cpp                                                 */
+/*   - Tests of CBitmapStore                                            */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "TestStubs.h"
+#include "GmapiBitmapStore.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace gm;
+
+namespace {
+  const int BITMAP_WIDTH = 64;
+  const int BITMAP_HEIGHT = 48;
+  const int BITMAP_SIZE = BITMAP_WIDTH * BITMAP_HEIGHT * 4;
+
+  // Sprite 0 with two subimages and background 0, stored in the runner's
+  // arrays; bitmaps are page aligned, like the large blocks of the
+  // runner's memory manager
+  class CRunnerResources {
+    public:
+      CRunnerResources() {
+        ZeroMemory( m_bitmaps, sizeof( m_bitmaps ) );
+        ZeroMemory( &m_sprite, sizeof( m_sprite ) );
+        ZeroMemory( &m_background, sizeof( m_background ) );
+        ZeroMemory( m_textures, sizeof( m_textures ) );
+
+        for ( int i = 0; i < 3; i++ ) {
+          m_bitmaps[i].structOld.width = BITMAP_WIDTH;
+          m_bitmaps[i].structOld.height = BITMAP_HEIGHT;
+          m_bitmaps[i].structOld.bits = Allocate( i );
+          m_bitmapPointers[i] = &m_bitmaps[i];
+
+          m_textureIds[i] = i;
+          m_textures[i].texture = (IDirect3DTexture8*) &m_textures[i];
+          m_textures[i].isValid = true;
+        }
+
+        m_sprite.structOld.subimageCount = 2;
+        m_sprite.structOld.bitmaps = m_bitmapPointers;
+        m_sprite.structOld.textureIds = m_textureIds;
+        m_background.structOld.bitmap = &m_bitmaps[2];
+        m_background.structOld.textureId = 2;
+        m_spritePointer = &m_sprite;
+        m_backgroundPointer = &m_background;
+
+        gmtest::runnerSprites.sprites = &m_spritePointer;
+        gmtest::runnerSprites.arraySize = 1;
+        gmtest::runnerBackgrounds.backgrounds = &m_backgroundPointer;
+        gmtest::runnerBackgrounds.arraySize = 1;
+        gmtest::runnerTextures = m_textures;
+      }
+
+      ~CRunnerResources() {
+        CBitmapStore::Forget( CBitmapStore::RK_SPRITE, 0 );
+        CBitmapStore::Forget( CBitmapStore::RK_BACKGROUND, 0 );
+
+        for ( int i = 0; i < 3; i++ )
+          VirtualFree( m_bitmaps[i].structOld.bits, 0, MEM_RELEASE );
+
+        gmtest::runnerSprites.sprites = NULL;
+        gmtest::runnerSprites.arraySize = 0;
+        gmtest::runnerBackgrounds.backgrounds = NULL;
+        gmtest::runnerBackgrounds.arraySize = 0;
+        gmtest::runnerTextures = gmtest::runnerSurfaceTextures;
+      }
+
+      // Fills new bitmap with a pattern, which compresses well
+      static BYTE* Allocate( int aPattern ) {
+        BYTE* bits = (BYTE*) VirtualAlloc( NULL, BITMAP_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+
+        for ( int i = 0; i < BITMAP_SIZE; i++ )
+          bits[i] = (BYTE) ( ( i / 4 + aPattern * 37 ) % 61 );
+
+        return bits;
+      }
+
+      static bool HasPattern( const BYTE* aBits, int aPattern ) {
+        for ( int i = 0; i < BITMAP_SIZE; i++ ) {
+          if ( aBits[i] != (BYTE) ( ( i / 4 + aPattern * 37 ) % 61 ) )
+            return false;
+        }
+
+        return true;
+      }
+
+      BYTE* Bits( int aIndex ) {
+        return m_bitmaps[aIndex].structOld.bits;
+      }
+
+      // Replaces the bitmap like sprite_replace, which frees the old one
+      void Replace( int aIndex, int aPattern ) {
+        VirtualFree( m_bitmaps[aIndex].structOld.bits, 0, MEM_RELEASE );
+        m_bitmaps[aIndex].structOld.bits = Allocate( aPattern );
+      }
+
+      // Replaces the bitmap by one allocated at the same address, like a
+      // runner function GMAPI does not intercept could do
+      void Reuse( int aIndex, int aPattern ) {
+        BYTE* bits = m_bitmaps[aIndex].structOld.bits;
+
+        VirtualAlloc( bits, BITMAP_SIZE, MEM_COMMIT, PAGE_READWRITE );
+
+        for ( int i = 0; i < BITMAP_SIZE; i++ )
+          bits[i] = (BYTE) ( ( i / 4 + aPattern * 37 ) % 61 );
+      }
+
+    private:
+      GMBITMAP m_bitmaps[3];
+      PGMBITMAP m_bitmapPointers[3];
+      DWORD m_textureIds[3];
+      GMSPRITE m_sprite;
+      GMBACKGROUND m_background;
+      PGMSPRITE m_spritePointer;
+      PGMBACKGROUND m_backgroundPointer;
+      GMTEXTURE m_textures[3];
+  };
+
+  // Kinds of bitmaps of SetOfSprites
+  enum BitmapKind { BK_CHARACTER, BK_TILES, BK_BACKGROUND };
+
+  // Fills the bitmap with content like that of game graphics
+  void FillBitmap( BYTE* aBits, int aWidth, int aHeight, BitmapKind aKind, int aFrame, unsigned int& aSeed ) {
+    for ( int y = 0; y < aHeight; y++ ) {
+      for ( int x = 0; x < aWidth; x++ ) {
+        BYTE* pixel = aBits + ( y * aWidth + x ) * 4;
+        int noise = gmtest::Random( aSeed ) % 8;
+
+        switch ( aKind ) {
+          case BK_CHARACTER: {
+            // Shaded ellipse moving with the frame on transparent pixels
+            int dx = x - aWidth / 2 - aFrame % 5, dy = y - aHeight / 2;
+            int distance = dx * dx * 4 / aWidth + dy * dy * 4 / aHeight;
+            int inside = ( distance < aWidth / 2 ? 1 : 0 );
+
+            pixel[0] = (BYTE) ( inside * ( 40 + y + noise ) );
+            pixel[1] = (BYTE) ( inside * ( 90 + x / 2 ) );
+            pixel[2] = (BYTE) ( inside * ( 160 - y / 2 + noise ) );
+            pixel[3] = (BYTE) ( inside * 255 );
+            break;
+          }
+
+          case BK_TILES:
+            // Opaque texture repeated every 32 pixels, with noise
+            pixel[0] = (BYTE) ( 60 + ( ( x ^ y ) & 31 ) + noise );
+            pixel[1] = (BYTE) ( 100 + ( ( x * y ) & 15 ) + noise );
+            pixel[2] = (BYTE) ( 50 + ( ( x + y ) & 31 ) );
+            pixel[3] = 255;
+            break;
+
+          default: {
+            // Vertical gradient with hills
+            int hill = aHeight * 2 / 3 + ( ( x * 7 + aFrame * 50 ) % 97 ) - 48;
+
+            pixel[0] = (BYTE) ( y < hill ? 255 - y / 4 : 40 + noise );
+            pixel[1] = (BYTE) ( y < hill ? 200 - y / 5 : 120 + noise );
+            pixel[2] = (BYTE) ( y < hill ? 120 : 60 );
+            pixel[3] = 255;
+          }
+        }
+      }
+    }
+  }
+
+  // Sprites of the runner for the benchmark, each with its own textures;
+  // bitmaps are page aligned like in CRunnerResources
+  class CRunnerSprites {
+    public:
+      struct SPRITESET {
+        BitmapKind kind;
+        int width;
+        int height;
+        int count;          // Subimages
+      };
+
+      CRunnerSprites( const SPRITESET* aSets, int aSetCount ): m_size( 0.0 ) {
+        unsigned int seed = 13;
+        int textures = 0;
+
+        for ( int i = 0; i < aSetCount; i++ )
+          textures += aSets[i].count;
+
+        m_sprites.resize( aSetCount );
+        m_spritePointers.resize( aSetCount );
+        m_bitmaps.resize( textures );
+        m_bitmapPointers.resize( textures );
+        m_textureIds.resize( textures );
+        m_textures.resize( textures );
+
+        for ( int i = 0, n = 0; i < aSetCount; i++ ) {
+          const SPRITESET& set = aSets[i];
+          GMSPRITE& sprite = m_sprites[i];
+
+          ZeroMemory( &sprite, sizeof( sprite ) );
+          sprite.structOld.subimageCount = set.count;
+          sprite.structOld.bitmaps = &m_bitmapPointers[n];
+          sprite.structOld.textureIds = &m_textureIds[n];
+          m_spritePointers[i] = &sprite;
+
+          for ( int j = 0; j < set.count; j++, n++ ) {
+            GMBITMAP& bitmap = m_bitmaps[n];
+            unsigned long size = set.width * set.height * 4;
+
+            ZeroMemory( &bitmap, sizeof( bitmap ) );
+            bitmap.structOld.width = set.width;
+            bitmap.structOld.height = set.height;
+            bitmap.structOld.bits = (BYTE*) VirtualAlloc( NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+            FillBitmap( bitmap.structOld.bits, set.width, set.height, set.kind, j, seed );
+
+            m_bitmapPointers[n] = &bitmap;
+            m_textureIds[n] = n;
+            m_textures[n].texture = (IDirect3DTexture8*) &m_textures[n];
+            m_textures[n].isValid = true;
+            m_size += size;
+          }
+        }
+
+        gmtest::runnerSprites.sprites = &m_spritePointers[0];
+        gmtest::runnerSprites.arraySize = aSetCount;
+        gmtest::runnerTextures = &m_textures[0];
+      }
+
+      ~CRunnerSprites() {
+        CBitmapStore::Restore( CBitmapStore::RK_SPRITE, -1 );
+
+        for ( size_t i = 0; i < m_bitmaps.size(); i++ )
+          VirtualFree( m_bitmaps[i].structOld.bits, 0, MEM_RELEASE );
+
+        gmtest::runnerSprites.sprites = NULL;
+        gmtest::runnerSprites.arraySize = 0;
+        gmtest::runnerTextures = gmtest::runnerSurfaceTextures;
+      }
+
+      int GetCount() const {
+        return (int) m_bitmaps.size();
+      }
+
+      // Bytes of all bitmaps
+      double GetSize() const {
+        return m_size;
+      }
+
+    private:
+      std::vector<GMSPRITE> m_sprites;
+      std::vector<PGMSPRITE> m_spritePointers;
+      std::vector<GMBITMAP> m_bitmaps;
+      std::vector<PGMBITMAP> m_bitmapPointers;
+      std::vector<DWORD> m_textureIds;
+      std::vector<GMTEXTURE> m_textures;
+      double m_size;
+  };
+}
+
+TEST( BitmapStoreRoundTrip ) {
+  CRunnerResources resources;
+  int loads = CBitmapStore::GetLoadCount();
+
+  CHECK_EQUAL( 2, CBitmapStore::Compress( CBitmapStore::RK_SPRITE, -1 ) );
+  CHECK_EQUAL( 1, CBitmapStore::Compress( CBitmapStore::RK_BACKGROUND, 0 ) );
+  CHECK_EQUAL( 0, CBitmapStore::Compress( CBitmapStore::RK_SPRITE, 0 ) );
+  CHECK( CBitmapStore::IsCold( CBitmapStore::RK_SPRITE, 0 ) );
+  CHECK( CBitmapStore::IsCold( CBitmapStore::RK_BACKGROUND, 0 ) );
+  CHECK_EQUAL( 3, CBitmapStore::GetColdCount() );
+  CHECK( CBitmapStore::GetStoredSize() < CBitmapStore::GetReleasedSize() );
+
+  // Read by the runner without GMAPI knowing; the exception handler
+  // brings the bitmap back
+  CHECK( CRunnerResources::HasPattern( resources.Bits( 1 ), 1 ) );
+  CHECK_EQUAL( 2, CBitmapStore::GetColdCount() );
+  CHECK_EQUAL( loads, CBitmapStore::GetLoadCount() );
+
+  CHECK( CBitmapStore::MakeResident( resources.Bits( 2 ) ) );
+  CHECK( !CBitmapStore::MakeResident( resources.Bits( 2 ) ) );
+  CHECK_EQUAL( loads + 1, CBitmapStore::GetLoadCount() );
+  CHECK( CRunnerResources::HasPattern( resources.Bits( 2 ), 2 ) );
+
+  CHECK_EQUAL( 1, CBitmapStore::Restore( CBitmapStore::RK_SPRITE, 0 ) );
+  CHECK( !CBitmapStore::IsCold( CBitmapStore::RK_SPRITE, 0 ) );
+  CHECK_EQUAL( 0, CBitmapStore::GetColdCount() );
+
+  for ( int i = 0; i < 3; i++ )
+    CHECK( CRunnerResources::HasPattern( resources.Bits( i ), i ) );
+}
+
+TEST( BitmapStoreReplaced ) {
+  CRunnerResources resources;
+
+  // Deleted or replaced through GML: forgotten before the runner frees
+  // the bitmap, whose pages must be accessible again
+  CHECK_EQUAL( 2, CBitmapStore::Compress( CBitmapStore::RK_SPRITE, 0 ) );
+  CBitmapStore::Forget( CBitmapStore::RK_SPRITE, 0 );
+  CHECK( !CBitmapStore::IsCold( CBitmapStore::RK_SPRITE, 0 ) );
+
+  resources.Bits( 0 )[BITMAP_SIZE / 2] = 1;
+  resources.Replace( 0, 5 );
+  CHECK_EQUAL( 0, CBitmapStore::Restore( CBitmapStore::RK_SPRITE, 0 ) );
+  CHECK( CRunnerResources::HasPattern( resources.Bits( 0 ), 5 ) );
+
+  // Bitmaps are kept by kind as well
+  CHECK_EQUAL( 2, CBitmapStore::Compress( CBitmapStore::RK_SPRITE, 0 ) );
+  CHECK_EQUAL( 1, CBitmapStore::Compress( CBitmapStore::RK_BACKGROUND, 0 ) );
+  CBitmapStore::Forget( CBitmapStore::RK_SPRITE, 0 );
+  CHECK( CBitmapStore::IsCold( CBitmapStore::RK_BACKGROUND, 0 ) );
+  CHECK_EQUAL( 1, CBitmapStore::Restore( CBitmapStore::RK_BACKGROUND, -1 ) );
+  CHECK( CRunnerResources::HasPattern( resources.Bits( 2 ), 2 ) );
+}
+
+TEST( BitmapStoreReused ) {
+  CRunnerResources resources;
+
+  // The new bitmaps have the same pointers and sizes, but are not written
+  // over by the old ones
+  CHECK_EQUAL( 2, CBitmapStore::Compress( CBitmapStore::RK_SPRITE, 0 ) );
+  CHECK_EQUAL( 1, CBitmapStore::Compress( CBitmapStore::RK_BACKGROUND, 0 ) );
+  resources.Reuse( 0, 5 );
+  resources.Reuse( 2, 6 );
+  CHECK_EQUAL( 1, CBitmapStore::Restore( CBitmapStore::RK_SPRITE, 0 ) );
+  CHECK_EQUAL( 0, CBitmapStore::Restore( CBitmapStore::RK_BACKGROUND, 0 ) );
+  CHECK_EQUAL( 0, CBitmapStore::GetColdCount() );
+  CHECK( CRunnerResources::HasPattern( resources.Bits( 0 ), 5 ) );
+  CHECK( CRunnerResources::HasPattern( resources.Bits( 1 ), 1 ) );
+  CHECK( CRunnerResources::HasPattern( resources.Bits( 2 ), 6 ) );
+}
+
+// Store of a set of sprites, tiles and backgrounds: how much memory goes
+// back to the system and how long the bitmaps take to come back
+BENCHMARK( BitmapStoreGameSet ) {
+  const CRunnerSprites::SPRITESET SETS[] = {
+    { BK_CHARACTER, 96, 96, 64 },
+    { BK_CHARACTER, 48, 64, 128 },
+    { BK_TILES, 512, 512, 8 },
+    { BK_BACKGROUND, 1024, 768, 4 }
+  };
+  CRunnerSprites sprites( SETS, sizeof( SETS ) / sizeof( SETS[0] ) );
+
+  gmtest::CTimer compressTimer;
+  int cold = CBitmapStore::Compress( CBitmapStore::RK_SPRITE, -1 );
+  double compressSeconds = compressTimer.GetSeconds();
+
+  double coldSize = CBitmapStore::GetColdSize();
+  double storedSize = CBitmapStore::GetStoredSize();
+  double releasedSize = CBitmapStore::GetReleasedSize();
+
+  gmtest::CTimer restoreTimer;
+  CHECK_EQUAL( cold, CBitmapStore::Restore( CBitmapStore::RK_SPRITE, -1 ) );
+  double restoreSeconds = restoreTimer.GetSeconds();
+
+  printf( "  %d of %d bitmaps cold, %.1f of %.1f MB\n", cold, sprites.GetCount(), coldSize / 1048576.0,
+          sprites.GetSize() / 1048576.0 );
+  printf( "  compressed %.2f MB (%.1f%%), decommitted %.2f MB\n", storedSize / 1048576.0,
+          storedSize * 100.0 / coldSize, releasedSize / 1048576.0 );
+  printf( "  compress %.1f ms, decompress %.1f ms (%.0f MB/s)\n", compressSeconds * 1000.0,
+          restoreSeconds * 1000.0, coldSize / 1048576.0 / restoreSeconds );
+}
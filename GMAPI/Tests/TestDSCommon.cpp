@@ -0,0 +1,426 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestDSCommon.cpp                                                    */
+/*   - Tests of the serializers of the data structures                  */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiDSCommon.h"
+#include "GmapiDSGrid.h"
+#include "GmapiDSList.h"
+#include "GmapiDSMap.h"
+#include "GmapiDSPriority.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace gm;
+
+namespace {
+  // Mixed reals and strings; strings repeat, so the stream compresses
+  CDSValue RandomValue( unsigned int& aSeed ) {
+    if ( gmtest::Random( aSeed ) % 3 == 0 ) {
+      char value[16];
+      sprintf( value, "item%d", gmtest::Random( aSeed ) % 100 );
+
+      return CDSValue( value );
+    }
+
+    return CDSValue( gmtest::Random( aSeed ) * 0.125 );
+  }
+
+  template<class T>
+  std::string WriteBinary( const T& aStructure, bool aCompress ) {
+    CDSBinaryWriter writer( aCompress );
+
+    aStructure.Write( writer );
+    writer.Close();
+
+    return writer.GetBuffer();
+  }
+
+  template<class T>
+  bool ReadBinary( T& aStructure, const std::string& aData ) {
+    CDSBinaryReader reader;
+
+    return ( reader.Open( aData.data(), aData.size() ) && aStructure.Read( reader ) );
+  }
+
+  // Writes the structure in the binary format, with and without LZ4, to
+  // a buffer and to a file, and checks the copy matches the hex form
+  template<class T>
+  bool BinaryRoundTrip( const T& aStructure, T& aCopy ) {
+    std::string text = aStructure.Write();
+
+    for ( int compress = 0; compress < 2; compress++ ) {
+      if ( !ReadBinary( aCopy, WriteBinary( aStructure, compress != 0 ) ) || aCopy.Write() != text )
+        return false;
+
+      const char* fileName = "TestDSCommon.bin";
+
+      if ( !SaveDSBinary( aStructure, fileName, compress != 0 ) )
+        return false;
+
+      bool loaded = LoadDSBinary( aCopy, fileName );
+      remove( fileName );
+
+      if ( !loaded || aCopy.Write() != text )
+        return false;
+    }
+
+    return true;
+  }
+
+  // Sizes of the blocks following the header of the binary stream;
+  // false if the blocks do not end exactly with the terminator
+  bool ParseBlocks( const std::string& aData, std::vector<int>& aOriginal, std::vector<int>& aStored ) {
+    size_t position = 8;
+
+    aOriginal.clear();
+    aStored.clear();
+
+    while ( position + 8 <= aData.size() ) {
+      int sizes[2];
+      memcpy( sizes, aData.data() + position, sizeof( sizes ) );
+      position += 8;
+
+      if ( !sizes[0] )
+        return ( position == aData.size() );
+
+      aOriginal.push_back( sizes[0] );
+      aStored.push_back( sizes[1] );
+      position += sizes[1];
+    }
+
+    return false;
+  }
+}
+
+TEST( DSHexRoundTrip ) {
+  CDSHexWriter writer;
+
+  writer.WriteInt( -5 );
+  writer.WriteReal( 0.25 );
+  writer.WriteValue( CDSValue( "text" ) );
+  writer.WriteValue( CDSValue( 3.0 ) );
+
+  CDSHexReader reader( writer.GetString().c_str() );
+  CDSValue string, real;
+  int integer = 0;
+  double value = 0.0;
+
+  CHECK( reader.ReadInt( integer ) && integer == -5 );
+  CHECK( reader.ReadReal( value ) && value == 0.25 );
+  CHECK( reader.ReadValue( string ) && string == CDSValue( "text" ) );
+  CHECK( reader.ReadValue( real ) && real == CDSValue( 3.0 ) );
+  CHECK( !reader.ReadInt( integer ) );
+}
+
+// IsAvailable counts only the digits before the terminator
+TEST( DSHexAvailable ) {
+  const char data[] = "0A0B0C\0" "0D0E0F0A0B0C";
+  CDSHexReader reader( data );
+  int value;
+
+  CHECK( reader.IsAvailable( 0 ) );
+  CHECK( reader.IsAvailable( 3 ) );
+  CHECK( !reader.IsAvailable( 4 ) );
+  CHECK( !reader.IsAvailable( -1 ) );
+  CHECK( !reader.IsAvailable( 0x7FFFFFFF ) );
+  CHECK( !reader.ReadInt( value ) );
+
+  CDSHexReader odd( "0A0" );
+  CHECK( odd.IsAvailable( 1 ) );
+  CHECK( !odd.IsAvailable( 2 ) );
+
+  CDSHexReader empty( NULL );
+  CHECK( empty.IsAvailable( 0 ) );
+  CHECK( !empty.IsAvailable( 1 ) );
+}
+
+// String lengths larger than the rest of the data are rejected before
+// the string is allocated
+TEST( DSHexStringLength ) {
+  CDSHexWriter writer;
+
+  writer.WriteInt( 1 );
+  writer.WriteInt( 0x10000000 );
+
+  std::string data = writer.GetString() + "41424344";
+  CDSHexReader reader( data.c_str() );
+  CDSValue value;
+
+  CHECK( !reader.ReadValue( value ) );
+}
+
+// Signature, format version, 64 KB blocks and the terminating block
+TEST( DSBinaryLayout ) {
+  CDSList list;
+  unsigned int seed = 3;
+
+  for ( int i = 0; i < 20000; i++ )
+    list.Add( CDSValue( gmtest::Random( seed ) * 0.5 ) );
+
+  std::string data = WriteBinary( list, false );
+  std::vector<int> original, stored;
+  int version = 0;
+
+  CHECK( data.compare( 0, 4, "GMDS" ) == 0 );
+  memcpy( &version, data.data() + 4, sizeof( version ) );
+  CHECK_EQUAL( 1, version );
+
+  // 2 ints of header, then a type and a double per value
+  int streamSize = 8 + 20000 * 12;
+
+  CHECK( ParseBlocks( data, original, stored ) );
+  CHECK_EQUAL( ( streamSize + 0xFFFF ) / 0x10000, (int) original.size() );
+
+  for ( size_t i = 0; i < original.size(); i++ ) {
+    CHECK_EQUAL( i + 1 < original.size() ? 0x10000 : streamSize % 0x10000, original[i] );
+    CHECK_EQUAL( original[i], stored[i] );
+  }
+
+  // Compressed blocks keep their original size
+  std::string compressed = WriteBinary( list, true );
+
+  CHECK( ParseBlocks( compressed, original, stored ) );
+  CHECK( compressed.size() < data.size() );
+
+  for ( size_t i = 0; i < original.size(); i++ ) {
+    CHECK_EQUAL( i + 1 < original.size() ? 0x10000 : streamSize % 0x10000, original[i] );
+    CHECK( stored[i] < original[i] );
+  }
+
+  // An empty stream still has the header and the terminator
+  CDSBinaryWriter empty;
+  empty.Close();
+  CHECK_EQUAL( 16, (int) empty.GetBuffer().size() );
+}
+
+// Blocks that do not compress are stored as they are
+TEST( DSBinaryIncompressible ) {
+  CDSBinaryWriter writer( true );
+  unsigned int seed = 17;
+
+  for ( int i = 0; i < 40000; i++ )
+    writer.WriteInt( gmtest::Random( seed ) | ( gmtest::Random( seed ) << 15 ) | ( gmtest::Random( seed ) << 30 ) );
+
+  writer.Close();
+
+  std::vector<int> original, stored;
+
+  CHECK( ParseBlocks( writer.GetBuffer(), original, stored ) );
+  CHECK_EQUAL( 3, (int) original.size() );
+
+  for ( size_t i = 0; i < original.size(); i++ )
+    CHECK_EQUAL( original[i], stored[i] );
+
+  CDSBinaryReader reader;
+  int value = 0;
+
+  seed = 17;
+  CHECK( reader.Open( writer.GetBuffer().data(), writer.GetBuffer().size() ) );
+
+  for ( int i = 0; i < 40000; i++ ) {
+    int expected = gmtest::Random( seed ) | ( gmtest::Random( seed ) << 15 ) | ( gmtest::Random( seed ) << 30 );
+
+    if ( !reader.ReadInt( value ) || value != expected ) {
+      CHECK_EQUAL( expected, value );
+      break;
+    }
+  }
+
+  CHECK( !reader.ReadInt( value ) );
+}
+
+TEST( DSBinaryLZ4 ) {
+  unsigned int seed = 21;
+
+  // Random lengths of runs and literals, including empty and tiny inputs
+  for ( int test = 0; test < 200; test++ ) {
+    std::string data;
+    int size = ( test < 20 ? test : gmtest::Random( seed ) % 70000 );
+
+    while ( (int) data.size() < size ) {
+      if ( gmtest::Random( seed ) % 2 && !data.empty() ) {
+        int offset = 1 + gmtest::Random( seed ) % (int) data.size();
+        int length = gmtest::Random( seed ) % 300;
+
+        for ( int i = 0; i < length; i++ )
+          data += data[data.size() - offset];
+      } else {
+        int length = gmtest::Random( seed ) % 40;
+
+        for ( int i = 0; i < length; i++ )
+          data += (char) gmtest::Random( seed );
+      }
+    }
+
+    data.resize( size );
+
+    std::string compressed;
+    CompressLZ4( data.data(), size, compressed );
+
+    std::vector<char> output( size + 1 );
+    CHECK( DecompressLZ4( compressed.data(), (int) compressed.size(), &output[0], size ) );
+    CHECK( std::string( &output[0], size ) == data );
+
+    // The output size must match exactly
+    if ( size > 0 )
+      CHECK( !DecompressLZ4( compressed.data(), (int) compressed.size(), &output[0], size - 1 ) );
+
+    CHECK( !DecompressLZ4( compressed.data(), (int) compressed.size(), &output[0], size + 1 ) );
+  }
+
+  // Offsets pointing before the output are rejected
+  const unsigned char invalid[] = { 0x10, 'a', 0x05, 0x00, 0x00 };
+  char output[32];
+
+  CHECK( !DecompressLZ4( invalid, sizeof( invalid ), output, 6 ) );
+}
+
+TEST( DSBinaryRoundTrip ) {
+  unsigned int seed = 5;
+
+  CDSList list, listCopy;
+  CDSMap map, mapCopy;
+  CDSGrid grid( 60, 45 ), gridCopy( 1, 1 );
+  CDSPriority queue, queueCopy;
+
+  for ( int i = 0; i < 5000; i++ ) {
+    list.Add( RandomValue( seed ) );
+    map.Set( RandomValue( seed ), RandomValue( seed ) );
+    queue.Add( RandomValue( seed ), gmtest::Random( seed ) * 0.25 );
+  }
+
+  for ( int x = 0; x < 60; x++ )
+    for ( int y = 0; y < 45; y++ )
+      grid.Set( x, y, RandomValue( seed ) );
+
+  CHECK( BinaryRoundTrip( list, listCopy ) );
+  CHECK( BinaryRoundTrip( map, mapCopy ) );
+  CHECK( BinaryRoundTrip( grid, gridCopy ) );
+  CHECK( BinaryRoundTrip( queue, queueCopy ) );
+
+  // Empty structures and a string longer than one block
+  CDSList empty;
+  CHECK( BinaryRoundTrip( empty, listCopy ) );
+
+  list.Clear();
+  list.Add( CDSValue( std::string( 200000, 'x' ).c_str() ) );
+  CHECK( BinaryRoundTrip( list, listCopy ) );
+  CHECK_EQUAL( 1, listCopy.GetSize() );
+}
+
+// Truncated data, wrong signature or version and damaged blocks are
+// rejected without reading past the buffer
+TEST( DSBinaryInvalid ) {
+  CDSList list, copy;
+  unsigned int seed = 11;
+
+  for ( int i = 0; i < 20000; i++ )
+    list.Add( RandomValue( seed ) );
+
+  for ( int compress = 0; compress < 2; compress++ ) {
+    std::string data = WriteBinary( list, compress != 0 );
+
+    // Only the terminator may be missing, the values are complete without it
+    for ( size_t size = 0; size + 8 < data.size(); size += ( size < 64 ? 1 : 97 ) ) {
+      std::vector<char> truncated( data.begin(), data.begin() + size );
+
+      if ( ReadBinary( copy, std::string( truncated.begin(), truncated.end() ) ) ) {
+        CHECK_EQUAL( (int) size, -1 );
+        break;
+      }
+    }
+
+    CHECK( ReadBinary( copy, data.substr( 0, data.size() - 8 ) ) );
+
+    std::string signature = data;
+    signature[0] = 'X';
+    CHECK( !ReadBinary( copy, signature ) );
+
+    std::string version = data;
+    version[4] = 2;
+    CHECK( !ReadBinary( copy, version ) );
+
+    // Block larger than 64 KB and stored size larger than the original
+    std::string blockSize = data;
+    int sizes[2] = { 0x10001, 0x10001 };
+    memcpy( &blockSize[8], sizes, sizeof( sizes ) );
+    CHECK( !ReadBinary( copy, blockSize ) );
+
+    std::string storedSize = data;
+    sizes[0] = 0x100;
+    sizes[1] = 0x101;
+    memcpy( &storedSize[8], sizes, sizeof( sizes ) );
+    CHECK( !ReadBinary( copy, storedSize ) );
+
+    // Random damage never crashes; damaged compressed blocks are usually detected
+    int detected = 0;
+
+    for ( int i = 0; i < 300; i++ ) {
+      std::string damaged = data;
+      size_t position = 16 + gmtest::Random( seed ) % ( data.size() - 24 );
+
+      damaged[position] = (char) ( damaged[position] ^ ( 1 + gmtest::Random( seed ) % 255 ) );
+
+      if ( !ReadBinary( copy, damaged ) || copy.Write() != list.Write() )
+        ++detected;
+    }
+
+    CHECK( detected > 200 );
+  }
+
+  CHECK( !ReadBinary( copy, "" ) );
+  CHECK( !LoadDSBinary( copy, "TestDSCommon.missing" ) );
+}
+
+BENCHMARK( DSBinaryAgainstHex ) {
+  const int COUNT = 1000000;
+  CDSList list, copy;
+  unsigned int seed = 13;
+
+  for ( int i = 0; i < COUNT; i++ )
+    list.Add( i % 8 ? CDSValue( gmtest::Random( seed ) * 0.5 ) : RandomValue( seed ) );
+
+  gmtest::CTimer timer;
+  std::string text = list.Write();
+  double written = timer.GetSeconds();
+  bool read = copy.Read( text.c_str() );
+  double parsed = timer.GetSeconds();
+
+  printf( "  hex: %d bytes, write %.0f ms, read %.0f ms%s\n", (int) text.size(),
+          written * 1000.0, ( parsed - written ) * 1000.0, read ? "" : " (failed)" );
+
+  for ( int compress = 0; compress < 2; compress++ ) {
+    gmtest::CTimer binaryTimer;
+    std::string data = WriteBinary( list, compress != 0 );
+    written = binaryTimer.GetSeconds();
+    read = ReadBinary( copy, data );
+    parsed = binaryTimer.GetSeconds();
+
+    printf( "  binary%s: %d bytes, write %.0f ms, read %.0f ms%s\n", compress ? " + LZ4" : "",
+            (int) data.size(), written * 1000.0, ( parsed - written ) * 1000.0, read ? "" : " (failed)" );
+  }
+}
@@ -0,0 +1,326 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestDSGrid.cpp                                                      */
+/*   - Tests of CDSGrid                                                 */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiDSGrid.h"
+#include "GmapiUtilities.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace gm;
+
+namespace {
+  enum Operation { OP_SET, OP_ADD, OP_MULTIPLY };
+
+  // Cell by cell implementation of the ds_grid semantics
+  class CReferenceGrid {
+    public:
+      CReferenceGrid( int aWidth, int aHeight ): width( aWidth ), height( aHeight ),
+        cells( aWidth * aHeight ) {}
+
+      CDSValue Get( int aX, int aY ) const {
+        return ( Contains( aX, aY ) ? cells[aY * width + aX] : CDSValue() );
+      }
+
+      bool Contains( int aX, int aY ) const {
+        return ( aX >= 0 && aY >= 0 && aX < width && aY < height );
+      }
+
+      // Strings can only be added to strings, other mixed operations are ignored
+      void Apply( int aX, int aY, Operation aOperation, const CDSValue& aValue ) {
+        if ( !Contains( aX, aY ) )
+          return;
+
+        CDSValue& cell = cells[aY * width + aX];
+
+        if ( aOperation == OP_SET )
+          cell = aValue;
+        else if ( cell.IsString() != aValue.IsString() )
+          return;
+        else if ( cell.IsString() ) {
+          if ( aOperation == OP_ADD )
+            cell = CDSValue( cell.GetString() + aValue.GetString() );
+        } else if ( aOperation == OP_ADD )
+          cell = CDSValue( cell.GetReal() + aValue.GetReal() );
+        else
+          cell = CDSValue( cell.GetReal() * aValue.GetReal() );
+      }
+
+      static bool InDisk( int aX, int aY, int aXm, int aYm, int aR ) {
+        double dx = aX - aXm, dy = aY - aYm;
+        return ( aR >= 0 && dx * dx + dy * dy <= (double) aR * aR );
+      }
+
+      int width;
+      int height;
+      std::vector<CDSValue> cells;
+  };
+
+  struct STATISTICS {
+    double sum, min, max, mean;
+  };
+
+  bool Close( double aValue1, double aValue2 ) {
+    return ( fabs( aValue1 - aValue2 ) <= 1e-6 * ( 1.0 + fabs( aValue1 ) + fabs( aValue2 ) ) );
+  }
+
+  // Statistics of the real cells in the region or in the disk with center
+  // aX1, aY1 and radius aR
+  STATISTICS Statistics( const CReferenceGrid& aGrid, int aX1, int aY1, int aX2, int aY2, bool aDisk, int aR ) {
+    STATISTICS result = { 0, 0, 0, 0 };
+    int count = 0;
+
+    for ( int y = 0; y < aGrid.height; y++ ) {
+      for ( int x = 0; x < aGrid.width; x++ ) {
+        bool inside = ( aDisk ? CReferenceGrid::InDisk( x, y, aX1, aY1, aR ) :
+                        x >= std::min( aX1, aX2 ) && x <= std::max( aX1, aX2 ) &&
+                        y >= std::min( aY1, aY2 ) && y <= std::max( aY1, aY2 ) );
+
+        if ( !inside || aGrid.Get( x, y ).IsString() )
+          continue;
+
+        double value = aGrid.Get( x, y ).GetReal();
+
+        if ( !count || value < result.min ) result.min = value;
+        if ( !count || value > result.max ) result.max = value;
+
+        result.sum += value;
+        ++count;
+      }
+    }
+
+    result.mean = ( count ? result.sum / count : 0.0 );
+    return result;
+  }
+
+  bool SameCells( const CDSGrid& aGrid, const CReferenceGrid& aReference ) {
+    if ( aGrid.GetWidth() != aReference.width || aGrid.GetHeight() != aReference.height )
+      return false;
+
+    for ( int y = 0; y < aReference.height; y++ ) {
+      for ( int x = 0; x < aReference.width; x++ ) {
+        if ( aGrid.GetValue( x, y ) != aReference.Get( x, y ) )
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+  // Random operations on a grid and the reference; aRound selects the
+  // summed-area table and string values
+  void RandomOperations( int aRound, unsigned int& aSeed ) {
+    int width = 1 + gmtest::Random( aSeed ) % 23, height = 1 + gmtest::Random( aSeed ) % 17;
+    CDSGrid grid( width, height );
+    CReferenceGrid reference( width, height );
+    bool strings = ( aRound % 4 >= 2 );
+
+    grid.SetSummedAreaTable( aRound % 2 != 0 );
+
+    for ( int i = 0; i < 2000; i++ ) {
+      Operation operation = (Operation) ( gmtest::Random( aSeed ) % 3 );
+      CDSValue value = ( strings && gmtest::Random( aSeed ) % 5 == 0 ? CDSValue( "s" ) :
+                         CDSValue( gmtest::Random( aSeed ) % 7 - 3 ) );
+
+      // Coordinates reach outside the grid
+      int x1 = gmtest::Random( aSeed ) % ( width + 6 ) - 3, y1 = gmtest::Random( aSeed ) % ( height + 6 ) - 3;
+      int x2 = gmtest::Random( aSeed ) % ( width + 6 ) - 3, y2 = gmtest::Random( aSeed ) % ( height + 6 ) - 3;
+      int r = gmtest::Random( aSeed ) % 8 - 1;
+      int left = std::min( x1, x2 ), right = std::max( x1, x2 );
+      int top = std::min( y1, y2 ), bottom = std::max( y1, y2 );
+
+      switch ( gmtest::Random( aSeed ) % 5 ) {
+        case 0:
+          if ( operation == OP_SET ) grid.SetRegion( x1, y1, x2, y2, value );
+          else if ( operation == OP_ADD ) grid.AddRegion( x1, y1, x2, y2, value );
+          else grid.MultiplyRegion( x1, y1, x2, y2, value );
+
+          for ( int y = top; y <= bottom; y++ )
+            for ( int x = left; x <= right; x++ )
+              reference.Apply( x, y, operation, value );
+
+          break;
+
+        case 1:
+          if ( operation == OP_SET ) grid.SetDisk( x1, y1, r, value );
+          else if ( operation == OP_ADD ) grid.AddDisk( x1, y1, r, value );
+          else grid.MultiplyDisk( x1, y1, r, value );
+
+          for ( int y = 0; y < height; y++ )
+            for ( int x = 0; x < width; x++ )
+              if ( CReferenceGrid::InDisk( x, y, x1, y1, r ) )
+                reference.Apply( x, y, operation, value );
+
+          break;
+
+        case 2: {
+          // The source may overlap the target, it is read before the change
+          int xPos = gmtest::Random( aSeed ) % ( width + 4 ) - 2, yPos = gmtest::Random( aSeed ) % ( height + 4 ) - 2;
+          CReferenceGrid source = reference;
+
+          if ( operation == OP_SET ) grid.SetGridRegion( grid, x1, y1, x2, y2, xPos, yPos );
+          else if ( operation == OP_ADD ) grid.AddGridRegion( grid, x1, y1, x2, y2, xPos, yPos );
+          else grid.MultiplyGridRegion( grid, x1, y1, x2, y2, xPos, yPos );
+
+          for ( int y = top; y <= bottom; y++ )
+            for ( int x = left; x <= right; x++ )
+              if ( source.Contains( x, y ) )
+                reference.Apply( x - left + xPos, y - top + yPos, operation, source.Get( x, y ) );
+
+          break;
+        }
+
+        case 3: {
+          STATISTICS region = Statistics( reference, x1, y1, x2, y2, false, 0 );
+
+          CHECK( Close( region.sum, grid.GetSum( x1, y1, x2, y2 ) ) );
+          CHECK( Close( region.min, grid.GetMin( x1, y1, x2, y2 ) ) );
+          CHECK( Close( region.max, grid.GetMax( x1, y1, x2, y2 ) ) );
+          CHECK( Close( region.mean, grid.GetMean( x1, y1, x2, y2 ) ) );
+
+          STATISTICS disk = Statistics( reference, x1, y1, 0, 0, true, r );
+
+          CHECK( Close( disk.sum, grid.GetDiskSum( x1, y1, r ) ) );
+          CHECK( Close( disk.min, grid.GetDiskMin( x1, y1, r ) ) );
+          CHECK( Close( disk.max, grid.GetDiskMax( x1, y1, r ) ) );
+          CHECK( Close( disk.mean, grid.GetDiskMean( x1, y1, r ) ) );
+
+          // The first match in row order
+          int foundX, foundY, expectedX = -1, expectedY = -1;
+          bool found = grid.FindValue( x1, y1, x2, y2, value, foundX, foundY );
+
+          for ( int y = std::max( top, 0 ); y <= std::min( bottom, height - 1 ) && expectedX < 0; y++ ) {
+            for ( int x = std::max( left, 0 ); x <= std::min( right, width - 1 ); x++ ) {
+              if ( reference.Get( x, y ) == value ) {
+                expectedX = x;
+                expectedY = y;
+                break;
+              }
+            }
+          }
+
+          CHECK_EQUAL( expectedX >= 0, found );
+          CHECK( !found || ( foundX == expectedX && foundY == expectedY ) );
+          break;
+        }
+
+        default:
+          if ( operation == OP_SET ) grid.Set( x1, y1, value );
+          else if ( operation == OP_ADD ) grid.Add( x1, y1, value );
+          else grid.Multiply( x1, y1, value );
+
+          reference.Apply( x1, y1, operation, value );
+      }
+
+      if ( !SameCells( grid, reference ) ) {
+        CHECK( SameCells( grid, reference ) );
+        return;
+      }
+    }
+
+    // ds_grid_write/ds_grid_read round trip; damaged strings leave the grid unchanged
+    CDSGrid copy( 1, 1 );
+    std::string text = grid.Write();
+
+    CHECK( copy.Read( text.c_str() ) );
+    CHECK( SameCells( copy, reference ) );
+    CHECK( !copy.Read( text.substr( 0, text.size() - 2 ).c_str() ) );
+    CHECK( SameCells( copy, reference ) );
+  }
+}
+
+TEST( DSGridAgainstReference ) {
+  unsigned int seed = 3;
+
+  for ( int round = 0; round < 24; round++ )
+    RandomOperations( round, seed );
+}
+
+// The plain C++ region kernels must give the same results
+TEST( DSGridWithoutSSE2 ) {
+  unsigned int seed = 3;
+
+  CCpuInfo::SetSSE2( false );
+
+  for ( int round = 0; round < 24; round++ )
+    RandomOperations( round, seed );
+
+  CCpuInfo::SetSSE2( true );
+}
+
+TEST( DSGridDiskRadii ) {
+  CDSGrid grid( 40, 30 );
+
+  grid.SetRegion( 0, 0, 39, 29, CDSValue( 1 ) );
+
+  // Whole grid covered by a huge disk far away from it
+  CHECK_EQUAL( 40.0 * 30.0, grid.GetDiskSum( -1000000000, 10, 2000000000 ) );
+  CHECK_EQUAL( 0.0, grid.GetDiskSum( -1000000000, 10, 5 ) );
+
+  // Many distinct radii
+  for ( int r = 0; r < 5000; r++ ) {
+    double expected = 0;
+
+    if ( r > 50 )
+      expected = 40.0 * 30.0;
+    else {
+      for ( int y = 0; y < 30; y++ )
+        for ( int x = 0; x < 40; x++ )
+          if ( CReferenceGrid::InDisk( x, y, 20, 15, r ) )
+            expected += 1.0;
+    }
+
+    if ( grid.GetDiskSum( 20, 15, r ) != expected ) {
+      CHECK_EQUAL( expected, grid.GetDiskSum( 20, 15, r ) );
+      break;
+    }
+  }
+
+  grid.SetDisk( 20, 15, 2000000000, CDSValue( 2 ) );
+  CHECK_EQUAL( 2.0 * 40.0 * 30.0, grid.GetSum( 0, 0, 39, 29 ) );
+}
+
+BENCHMARK( DSGridRegionSum ) {
+  CDSGrid grid( 1024, 1024 );
+  double sum = 0;
+
+  grid.SetRegion( 0, 0, 1023, 1023, CDSValue( 0.5 ) );
+
+  for ( int table = 0; table < 2; table++ ) {
+    grid.SetSummedAreaTable( table != 0 );
+
+    gmtest::CTimer timer;
+
+    for ( int i = 0; i < 1000; i++ )
+      sum += grid.GetSum( i % 512, i % 256, i % 512 + 511, i % 256 + 767 ) + grid.GetDiskSum( 512, 512, 100 + i % 50 );
+
+    printf( "  1000 region and disk sums %s the table: %.1f ms\n", ( table ? "with" : "without" ),
+            timer.GetSeconds() * 1000.0 );
+  }
+
+  printf( "  checksum %.0f\n", sum );
+}
@@ -0,0 +1,243 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestDSList.cpp                                                      */
+/*   - Tests of CDSList                                                 */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiDSList.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+using namespace gm;
+
+namespace {
+  // ds_list_sort descending: reals from the highest, then strings from
+  // the highest
+  bool Descending( const CDSValue& aValue1, const CDSValue& aValue2 ) {
+    if ( aValue1.IsString() != aValue2.IsString() )
+      return aValue2.IsString();
+
+    return ( aValue2 < aValue1 );
+  }
+
+  void SortReference( std::vector<CDSValue>& aValues, bool aAscending ) {
+    if ( aAscending )
+      std::sort( aValues.begin(), aValues.end() );
+    else
+      std::sort( aValues.begin(), aValues.end(), Descending );
+  }
+
+  bool Equal( const CDSList& aList, const std::vector<CDSValue>& aValues ) {
+    if ( aList.GetSize() != (int) aValues.size() )
+      return false;
+
+    for ( size_t i = 0; i < aValues.size(); i++ ) {
+      if ( aList.GetValue( (int) i ) != aValues[i] )
+        return false;
+    }
+
+    return true;
+  }
+
+  CDSValue RandomValue( unsigned int& aSeed, bool aStrings ) {
+    if ( aStrings && gmtest::Random( aSeed ) % 4 == 0 ) {
+      char value[16];
+      sprintf( value, "s%d", gmtest::Random( aSeed ) % 20 );
+
+      return CDSValue( value );
+    }
+
+    return CDSValue( gmtest::Random( aSeed ) % 50 - 25 );
+  }
+}
+
+// Random operations against std::vector, with and without strings
+TEST( DSListAgainstVector ) {
+  unsigned int seed = 7;
+
+  for ( int round = 0; round < 20; round++ ) {
+    int id = CDSList::Create();
+    CDSList& list = CDSList::Get( id );
+    std::vector<CDSValue> reference;
+
+    for ( int i = 0; i < 4000; i++ ) {
+      CDSValue value = RandomValue( seed, round % 2 != 0 );
+      int position = gmtest::Random( seed ) % ( reference.size() + 3 ) - 1;
+      bool inside = ( position >= 0 && position < (int) reference.size() );
+
+      switch ( gmtest::Random( seed ) % 7 ) {
+        case 0:
+        case 1:
+          list.Add( value );
+          reference.push_back( value );
+          break;
+
+        case 2:
+          CHECK_EQUAL( position >= 0 && position <= (int) reference.size(), list.Insert( position, value ) );
+
+          if ( position >= 0 && position <= (int) reference.size() )
+            reference.insert( reference.begin() + position, value );
+
+          break;
+
+        case 3:
+          CHECK_EQUAL( inside, list.Replace( position, value ) );
+
+          if ( inside )
+            reference[position] = value;
+
+          break;
+
+        case 4:
+          CHECK_EQUAL( inside, list.Delete( position ) );
+
+          if ( inside )
+            reference.erase( reference.begin() + position );
+
+          break;
+
+        case 5: {
+          std::vector<CDSValue>::iterator it = std::find( reference.begin(), reference.end(), value );
+          CHECK_EQUAL( it == reference.end() ? -1 : (int) ( it - reference.begin() ), list.FindIndex( value ) );
+          break;
+        }
+
+        default:
+          if ( i % 50 == 0 ) {
+            bool ascending = ( gmtest::Random( seed ) % 2 != 0 );
+
+            list.Sort( ascending );
+            SortReference( reference, ascending );
+            CHECK( Equal( list, reference ) );
+          }
+      }
+
+      if ( list.GetSize() != (int) reference.size() ) {
+        CHECK_EQUAL( (int) reference.size(), list.GetSize() );
+        break;
+      }
+    }
+
+    CHECK( Equal( list, reference ) );
+    CHECK( CDSList::Destroy( id ) );
+  }
+}
+
+TEST( DSListSortOrder ) {
+  CDSList list;
+  const char* strings[] = { "b", "a", "c" };
+  double reals[] = { 3.0, -1.0, 2.0 };
+
+  for ( int i = 0; i < 3; i++ ) {
+    list.Add( CDSValue( strings[i] ) );
+    list.Add( CDSValue( reals[i] ) );
+  }
+
+  list.Sort( true );
+  CHECK( list.GetValue( 0 ) == CDSValue( -1.0 ) );
+  CHECK( list.GetValue( 2 ) == CDSValue( 3.0 ) );
+  CHECK( list.GetValue( 3 ) == CDSValue( "a" ) );
+  CHECK( list.GetValue( 5 ) == CDSValue( "c" ) );
+
+  // Descending keeps reals first
+  list.Sort( false );
+  CHECK( list.GetValue( 0 ) == CDSValue( 3.0 ) );
+  CHECK( list.GetValue( 2 ) == CDSValue( -1.0 ) );
+  CHECK( list.GetValue( 3 ) == CDSValue( "c" ) );
+  CHECK( list.GetValue( 5 ) == CDSValue( "a" ) );
+}
+
+// Long lists of reals are sorted by radix sort
+TEST( DSListRadixSort ) {
+  std::vector<double> values( 20000 ), sorted;
+  unsigned int seed = 5;
+
+  for ( size_t i = 0; i < values.size(); i++ )
+    values[i] = ( gmtest::Random( seed ) - 0x4000 ) * 1.37 / ( 1 + gmtest::Random( seed ) % 100 );
+
+  values[5] = 1e300;
+  values[6] = -1e300;
+  values[7] = 0.0;
+
+  for ( int ascending = 0; ascending < 2; ascending++ ) {
+    CDSList list;
+
+    list.AppendRange( &values[0], (int) values.size() );
+    list.Sort( ascending != 0 );
+    list.CopyTo( sorted );
+
+    std::vector<double> reference( values );
+
+    if ( ascending )
+      std::sort( reference.begin(), reference.end() );
+    else
+      std::sort( reference.begin(), reference.end(), std::greater<double>() );
+
+    CHECK( sorted == reference );
+  }
+}
+
+TEST( DSListReadWrite ) {
+  CDSList list, copy;
+  unsigned int seed = 9;
+
+  for ( int i = 0; i < 1000; i++ )
+    list.Add( RandomValue( seed, true ) );
+
+  std::string text = list.Write();
+
+  CHECK( copy.Read( text.c_str() ) );
+  CHECK( copy.Write() == text );
+  CHECK( !copy.Read( text.substr( 0, text.size() / 2 ).c_str() ) );
+  CHECK( copy.IsEmpty() );
+}
+
+BENCHMARK( DSList1MReals ) {
+  const int COUNT = 1000000;
+  std::vector<double> values( COUNT );
+  unsigned int seed = 13;
+  int found = 0;
+
+  for ( int i = 0; i < COUNT; i++ )
+    values[i] = gmtest::Random( seed ) * 32768.0 + gmtest::Random( seed );
+
+  CDSList list;
+  list.AppendRange( &values[0], COUNT );
+
+  gmtest::CTimer timer;
+  list.Sort( true );
+  double ascending = timer.GetSeconds();
+  list.Sort( false );
+  double descending = timer.GetSeconds();
+
+  for ( int i = 0; i < 100; i++ )
+    found += list.FindIndex( CDSValue( -1.0 ) );
+
+  double searched = timer.GetSeconds();
+
+  printf( "  sort %.0f ms, sort descending %.0f ms, 100 searches %.0f ms (%d)\n", ascending * 1000.0,
+          ( descending - ascending ) * 1000.0, ( searched - descending ) * 1000.0, found );
+}
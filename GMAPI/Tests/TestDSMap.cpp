@@ -0,0 +1,217 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestDSMap.cpp                                                       */
+/*   - Tests of CDSMap                                                  */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiDSMap.h"
+
+#include <map>
+
+using namespace gm;
+
+namespace {
+  CDSValue RandomKey( unsigned int& aSeed ) {
+    if ( gmtest::Random( aSeed ) % 3 == 0 ) {
+      char key[16];
+      sprintf( key, "k%d", gmtest::Random( aSeed ) % 500 );
+
+      return CDSValue( key );
+    }
+
+    return CDSValue( gmtest::Random( aSeed ) % 3000 );
+  }
+}
+
+// Random operations with unique keys against std::map
+TEST( DSMapAgainstStdMap ) {
+  CDSMap& map = CDSMap::Get( CDSMap::Create() );
+  std::map<CDSValue, CDSValue> reference;
+  unsigned int seed = 1;
+
+  for ( int i = 0; i < 100000; i++ ) {
+    CDSValue key = RandomKey( seed );
+    std::map<CDSValue, CDSValue>::iterator it = reference.find( key );
+
+    switch ( gmtest::Random( seed ) % 4 ) {
+      case 0:
+        if ( it == reference.end() ) {
+          map.Add( key, CDSValue( i ) );
+          reference[key] = CDSValue( i );
+        } else {
+          CHECK( map.Replace( key, CDSValue( i ) ) );
+          it->second = CDSValue( i );
+        }
+
+        break;
+
+      case 1:
+        CHECK_EQUAL( it != reference.end(), map.Delete( key ) );
+
+        if ( it != reference.end() )
+          reference.erase( it );
+
+        break;
+
+      case 2: {
+        const CDSValue* value = map.FindValue( key );
+        CHECK_EQUAL( it != reference.end(), value != NULL );
+        CHECK( !value || *value == it->second );
+        break;
+      }
+
+      default: {
+        const CDSValue* next = map.FindNext( key );
+        const CDSValue* previous = map.FindPrevious( key );
+        std::map<CDSValue, CDSValue>::iterator upper = reference.upper_bound( key );
+        std::map<CDSValue, CDSValue>::iterator lower = reference.lower_bound( key );
+
+        CHECK_EQUAL( upper != reference.end(), next != NULL );
+        CHECK( !next || *next == upper->first );
+        CHECK_EQUAL( lower != reference.begin(), previous != NULL );
+        CHECK( !previous || *previous == ( --lower )->first );
+      }
+    }
+
+    if ( map.GetSize() != (int) reference.size() ) {
+      CHECK_EQUAL( (int) reference.size(), map.GetSize() );
+      break;
+    }
+  }
+
+  CHECK( !map.IsEmpty() );
+  CHECK( *map.FindFirst() == reference.begin()->first );
+  CHECK( *map.FindLast() == reference.rbegin()->first );
+
+  // Reals are ordered before strings
+  CHECK( !map.FindFirst()->IsString() );
+  CHECK( map.FindLast()->IsString() );
+}
+
+// ds_map_add keeps duplicate keys like GM
+TEST( DSMapDuplicateKeys ) {
+  CDSMap map;
+
+  map.Add( CDSValue( "a" ), CDSValue( 1 ) );
+  map.Add( CDSValue( "b" ), CDSValue( 2 ) );
+  map.Add( CDSValue( "a" ), CDSValue( 3 ) );
+  map.Add( CDSValue( 5 ), CDSValue( 4 ) );
+
+  CHECK_EQUAL( 4, map.GetSize() );
+  CHECK( map.Exists( CDSValue( "a" ) ) );
+
+  const CDSValue* value = map.FindValue( CDSValue( "a" ) );
+  CHECK( value && ( value->GetReal() == 1.0 || value->GetReal() == 3.0 ) );
+
+  // Traversal returns every distinct key once and ends
+  const CDSValue* key = map.FindFirst();
+  CHECK( key && *key == CDSValue( 5 ) );
+  key = map.FindNext( *key );
+  CHECK( key && *key == CDSValue( "a" ) );
+  key = map.FindNext( *key );
+  CHECK( key && *key == CDSValue( "b" ) );
+  CHECK( !map.FindNext( *key ) );
+  CHECK( map.FindPrevious( CDSValue( "b" ) ) && *map.FindPrevious( CDSValue( "b" ) ) == CDSValue( "a" ) );
+
+  // Both entries survive ds_map_write/ds_map_read
+  CDSMap copy;
+  CHECK( copy.Read( map.Write().c_str() ) );
+  CHECK_EQUAL( 4, copy.GetSize() );
+  CHECK( copy.Write() == map.Write() );
+
+  // Set replaces instead of adding
+  map.Set( CDSValue( "b" ), CDSValue( 6 ) );
+  CHECK_EQUAL( 4, map.GetSize() );
+
+  // Delete removes one entry at a time
+  CHECK( map.Delete( CDSValue( "a" ) ) );
+  CHECK_EQUAL( 3, map.GetSize() );
+  CHECK( map.Exists( CDSValue( "a" ) ) );
+  CHECK( map.Delete( CDSValue( "a" ) ) );
+  CHECK( !map.Exists( CDSValue( "a" ) ) );
+  CHECK( !map.Delete( CDSValue( "a" ) ) );
+  CHECK_EQUAL( 2, map.GetSize() );
+}
+
+TEST( DSMapReadWrite ) {
+  CDSMap map, copy;
+
+  for ( int i = 0; i < 1000; i++ ) {
+    char key[16];
+    sprintf( key, "key%d", i );
+
+    map.Set( CDSValue( key ), CDSValue( i * 0.5 ) );
+    map.Set( CDSValue( i ), CDSValue( key ) );
+  }
+
+  std::string text = map.Write();
+
+  CHECK( copy.Read( text.c_str() ) );
+  CHECK_EQUAL( map.GetSize(), copy.GetSize() );
+  CHECK( copy.Write() == text );
+  CHECK( copy.FindValue( CDSValue( "key10" ) ) && copy.FindValue( CDSValue( "key10" ) )->GetReal() == 5.0 );
+
+  // Truncated strings are rejected and leave the map empty
+  CHECK( !copy.Read( text.substr( 0, text.size() / 2 ).c_str() ) );
+  CHECK( copy.IsEmpty() );
+  CHECK( !copy.Read( "" ) );
+}
+
+TEST( DSMapIds ) {
+  int id1 = CDSMap::Create();
+  int id2 = CDSMap::Create();
+
+  CHECK( id1 != id2 );
+  CHECK( CDSMap::Find( id1 ) != NULL );
+  CHECK( CDSMap::Destroy( id1 ) );
+  CHECK( CDSMap::Find( id1 ) == NULL );
+  CHECK( !CDSMap::Destroy( id1 ) );
+  CHECK( CDSMap::Destroy( id2 ) );
+}
+
+BENCHMARK( DSMap1MKeys ) {
+  const int COUNT = 1000000;
+  CDSMap map;
+  double sum = 0.0;
+
+  gmtest::CTimer timer;
+
+  for ( int i = 0; i < COUNT; i++ )
+    map.Add( CDSValue( i * 7.0 ), CDSValue( i ) );
+
+  double added = timer.GetSeconds();
+
+  for ( int i = 0; i < COUNT; i++ )
+    sum += map.FindValue( CDSValue( i * 7.0 ) )->GetReal();
+
+  double found = timer.GetSeconds();
+
+  for ( int i = 0; i < COUNT; i += 2 )
+    map.Delete( CDSValue( i * 7.0 ) );
+
+  double deleted = timer.GetSeconds();
+
+  printf( "  add %.0f ms, find %.0f ms, delete half %.0f ms (checksum %.0f)\n",
+          added * 1000.0, ( found - added ) * 1000.0, ( deleted - found ) * 1000.0, sum );
+}
@@ -0,0 +1,226 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestDSPriority.cpp                                                  */
+/*   - Tests of CDSPriority                                             */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiDSPriority.h"
+
+#include <vector>
+
+using namespace gm;
+
+namespace {
+  struct REFENTRY {
+    CDSValue value;
+    double priority;
+  };
+
+  // Entries in the order of insertion, searched like GM does
+  typedef std::vector<REFENTRY> Reference;
+
+  int FindFirst( const Reference& aReference, const CDSValue& aValue ) {
+    for ( size_t i = 0; i < aReference.size(); i++ ) {
+      if ( aReference[i].value == aValue )
+        return (int) i;
+    }
+
+    return -1;
+  }
+
+  // Checks the removed value has the lowest/highest priority and removes
+  // its first entry with that priority from the reference
+  bool RemoveExtreme( Reference& aReference, const CDSValue& aValue, bool aMax ) {
+    double best = aReference[0].priority;
+    int index = -1;
+
+    for ( size_t i = 1; i < aReference.size(); i++ ) {
+      if ( aMax ? aReference[i].priority > best : aReference[i].priority < best )
+        best = aReference[i].priority;
+    }
+
+    for ( size_t i = 0; i < aReference.size() && index < 0; i++ ) {
+      if ( aReference[i].value == aValue && aReference[i].priority == best )
+        index = (int) i;
+    }
+
+    if ( index < 0 )
+      return false;
+
+    aReference.erase( aReference.begin() + index );
+    return true;
+  }
+
+  CDSValue RandomValue( unsigned int& aSeed, int aRange ) {
+    if ( gmtest::Random( aSeed ) % 4 == 0 ) {
+      char value[16];
+      sprintf( value, "v%d", gmtest::Random( aSeed ) % aRange );
+
+      return CDSValue( value );
+    }
+
+    return CDSValue( gmtest::Random( aSeed ) % aRange );
+  }
+}
+
+// Random operations with duplicate values against a list searched in the
+// order of insertion
+TEST( DSPriorityAgainstReference ) {
+  int id = CDSPriority::Create();
+  CDSPriority& queue = CDSPriority::Get( id );
+  Reference reference;
+  unsigned int seed = 3;
+
+  for ( int i = 0; i < 200000; i++ ) {
+    CDSValue value = RandomValue( seed, 150 );
+    double priority = gmtest::Random( seed ) % 50;
+    int first = FindFirst( reference, value );
+
+    switch ( gmtest::Random( seed ) % 7 ) {
+      case 0:
+      case 1: {
+        REFENTRY entry = { value, priority };
+
+        queue.Add( value, priority );
+        reference.push_back( entry );
+        break;
+      }
+
+      case 2:
+        CHECK_EQUAL( first >= 0, queue.ChangePriority( value, priority ) );
+
+        if ( first >= 0 )
+          reference[first].priority = priority;
+
+        break;
+
+      case 3:
+        CHECK_EQUAL( first >= 0, queue.DeleteValue( value ) );
+
+        if ( first >= 0 )
+          reference.erase( reference.begin() + first );
+
+        break;
+
+      case 4: {
+        double found = -1.0;
+
+        CHECK_EQUAL( first >= 0, queue.FindPriority( value, found ) );
+        CHECK( first < 0 || found == reference[first].priority );
+        break;
+      }
+
+      default: {
+        bool max = ( i % 2 != 0 );
+        const CDSValue* peek = ( max ? queue.FindMax() : queue.FindMin() );
+        CDSValue peeked = ( peek ? *peek : CDSValue() );
+        CDSValue removed;
+
+        CHECK_EQUAL( !reference.empty(), peek != NULL );
+        CHECK_EQUAL( !reference.empty(), max ? queue.DeleteMax( removed ) : queue.DeleteMin( removed ) );
+
+        if ( peek ) {
+          CHECK( removed == peeked );
+          CHECK( RemoveExtreme( reference, removed, max ) );
+        }
+      }
+    }
+
+    if ( queue.GetSize() != (int) reference.size() ) {
+      CHECK_EQUAL( (int) reference.size(), queue.GetSize() );
+      break;
+    }
+  }
+
+  CHECK( CDSPriority::Destroy( id ) );
+  CHECK( CDSPriority::Find( id ) == NULL );
+}
+
+// ds_priority_change_priority and ds_priority_delete_value act on the
+// value added first, also after the hash table has grown
+TEST( DSPriorityDuplicateValues ) {
+  CDSPriority queue;
+  double priority;
+
+  queue.Add( CDSValue( "a" ), 5.0 );
+  queue.Add( CDSValue( "a" ), 1.0 );
+  queue.Add( CDSValue( "a" ), 9.0 );
+
+  CHECK( queue.FindPriority( CDSValue( "a" ), priority ) && priority == 5.0 );
+  CHECK( queue.ChangePriority( CDSValue( "a" ), 0.0 ) );
+  CHECK( *queue.FindMin() == CDSValue( "a" ) );
+
+  for ( int i = 0; i < 1000; i++ )
+    queue.Add( CDSValue( i ), i );
+
+  CHECK( queue.DeleteValue( CDSValue( "a" ) ) );
+  CHECK( queue.FindPriority( CDSValue( "a" ), priority ) && priority == 1.0 );
+  CHECK( queue.DeleteValue( CDSValue( "a" ) ) );
+  CHECK( queue.FindPriority( CDSValue( "a" ), priority ) && priority == 9.0 );
+  CHECK( queue.DeleteValue( CDSValue( "a" ) ) );
+  CHECK( !queue.DeleteValue( CDSValue( "a" ) ) );
+  CHECK_EQUAL( 1000, queue.GetSize() );
+}
+
+TEST( DSPriorityReadWrite ) {
+  CDSPriority queue, copy;
+  unsigned int seed = 7;
+
+  for ( int i = 0; i < 2000; i++ )
+    queue.Add( RandomValue( seed, 500 ), gmtest::Random( seed ) * 0.25 );
+
+  std::string text = queue.Write();
+
+  CHECK( copy.Read( text.c_str() ) );
+  CHECK_EQUAL( queue.GetSize(), copy.GetSize() );
+  CHECK( copy.Write() == text );
+
+  // Truncated strings are rejected and leave the queue empty
+  CHECK( !copy.Read( text.substr( 0, text.size() / 2 ).c_str() ) );
+  CHECK( copy.IsEmpty() );
+}
+
+// Dijkstra-like workload: many adds and priority changes, few deletions
+BENCHMARK( DSPriorityOpenList ) {
+  const int COUNT = 200000;
+  CDSPriority queue;
+  unsigned int seed = 11;
+  double sum = 0.0;
+  CDSValue value;
+
+  gmtest::CTimer timer;
+
+  for ( int i = 0; i < COUNT; i++ ) {
+    queue.Add( CDSValue( i ), gmtest::Random( seed ) );
+    queue.ChangePriority( CDSValue( gmtest::Random( seed ) % ( i + 1 ) ), gmtest::Random( seed ) );
+
+    if ( i % 4 == 0 && queue.DeleteMin( value ) )
+      sum += value.GetReal();
+  }
+
+  while ( queue.DeleteMin( value ) )
+    sum += value.GetReal();
+
+  printf( "  %d adds and changes: %.0f ms (checksum %.0f)\n", COUNT, timer.GetSeconds() * 1000.0, sum );
+}
@@ -0,0 +1,196 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestFlowField.cpp                                                   */
+/*   - Tests of CFlowField                                              */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiFlowField.h"
+
+#include <math.h>
+#include <functional>
+#include <queue>
+#include <vector>
+
+using namespace gm;
+
+namespace {
+  const double SQRT2 = 1.4142135623730951;
+
+  // Offsets of the direction codes (0 - right, 2 - up)
+  const int DIRECTION_H[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+  const int DIRECTION_V[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+
+  bool CanMove( const CMotionGrid& aGrid, int aH, int aV, int aDirection, bool aDiagonal ) {
+    int h = aH + DIRECTION_H[aDirection], v = aV + DIRECTION_V[aDirection];
+
+    if ( aGrid.IsCellForbidden( h, v ) )
+      return false;
+    if ( !( aDirection & 1 ) )
+      return true;
+
+    return ( aDiagonal && !aGrid.IsCellForbidden( h, aV ) && !aGrid.IsCellForbidden( aH, v ) );
+  }
+
+  // Distances of all cells to the goal by Dijkstra's algorithm, -1 for
+  // unreachable cells
+  void Distances( const CMotionGrid& aGrid, int aGoalH, int aGoalV, bool aDiagonal, std::vector<double>& aCost ) {
+    typedef std::pair<double, int> NODE;
+
+    int width = aGrid.GetHorizontalCells(), height = aGrid.GetVerticalCells();
+    std::priority_queue<NODE, std::vector<NODE>, std::greater<NODE> > open;
+
+    aCost.assign( width * height, -1.0 );
+
+    if ( aGrid.IsCellForbidden( aGoalH, aGoalV ) )
+      return;
+
+    aCost[aGoalV * width + aGoalH] = 0.0;
+    open.push( NODE( 0.0, aGoalV * width + aGoalH ) );
+
+    while ( !open.empty() ) {
+      NODE node = open.top();
+      int h = node.second % width, v = node.second / width;
+
+      open.pop();
+
+      if ( node.first > aCost[node.second] )
+        continue;
+
+      // Moves are symmetric, so the search can start at the goal
+      for ( int d = 0; d < 8; d++ ) {
+        if ( !CanMove( aGrid, h, v, d, aDiagonal ) )
+          continue;
+
+        int cell = ( v + DIRECTION_V[d] ) * width + h + DIRECTION_H[d];
+        double next = node.first + ( d & 1 ? SQRT2 : 1.0 );
+
+        if ( aCost[cell] < 0.0 || next < aCost[cell] - 1e-9 ) {
+          aCost[cell] = next;
+          open.push( NODE( next, cell ) );
+        }
+      }
+    }
+  }
+
+  // Compares the whole field with Dijkstra's algorithm; directions have
+  // to lead to a neighbour on a shortest path
+  bool MatchesDijkstra( CFlowField& aField, const CMotionGrid& aGrid, int aGoalH, int aGoalV, bool aDiagonal ) {
+    int width = aGrid.GetHorizontalCells(), height = aGrid.GetVerticalCells();
+    std::vector<double> cost;
+
+    Distances( aGrid, aGoalH, aGoalV, aDiagonal, cost );
+
+    for ( int v = 0; v < height; v++ ) {
+      for ( int h = 0; h < width; h++ ) {
+        double expected = cost[v * width + h];
+        double distance = aField.GetCellDistance( h, v );
+        int direction = aField.GetCellDirection( h, v );
+
+        if ( fabs( distance - expected ) > 1e-3 * ( 1.0 + expected ) )
+          return false;
+
+        if ( aGrid.IsCellForbidden( h, v ) ) {
+          if ( direction != CFlowField::FD_FORBIDDEN )
+            return false;
+        } else if ( h == aGoalH && v == aGoalV ) {
+          if ( direction != CFlowField::FD_GOAL )
+            return false;
+        } else if ( expected < 0.0 ) {
+          if ( direction != CFlowField::FD_UNREACHABLE )
+            return false;
+        } else {
+          if ( direction < 0 || direction > 7 || !CanMove( aGrid, h, v, direction, aDiagonal ) )
+            return false;
+
+          double next = cost[( v + DIRECTION_V[direction] ) * width + h + DIRECTION_H[direction]];
+
+          if ( next < 0.0 || fabs( next + ( direction & 1 ? SQRT2 : 1.0 ) - expected ) > 1e-3 * ( 1.0 + expected ) )
+            return false;
+        }
+      }
+    }
+
+    return true;
+  }
+}
+
+// Incremental updates after small edits of the grid against Dijkstra's
+// algorithm on the edited grid
+TEST( FlowFieldIncremental ) {
+  unsigned int seed = 3;
+  int compared = 0, failed = 0;
+
+  for ( int i = 0; i < 200; i++ ) {
+    int width = 1 + gmtest::Random( seed ) % 48, height = 1 + gmtest::Random( seed ) % 36;
+    int density = gmtest::Random( seed ) % 40;
+    bool diagonal = ( i % 2 != 0 );
+    CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, width, height, 16.0, 16.0 );
+
+    for ( int v = 0; v < height; v++ )
+      for ( int h = 0; h < width; h++ )
+        if ( gmtest::Random( seed ) % 100 < density )
+          grid.SetCell( h, v, true );
+
+    int id = CFlowField::Create( 0, diagonal );
+    CFlowField& field = CFlowField::Get( id );
+    int goalH = gmtest::Random( seed ) % width, goalV = gmtest::Random( seed ) % height;
+
+    grid.SetCell( goalH, goalV, false );
+    CHECK( field.SetGoal( goalH * 16.0 + 8.0, goalV * 16.0 + 8.0 ) );
+
+    for ( int edit = 0; edit < 20; edit++ ) {
+      int h = gmtest::Random( seed ) % width, v = gmtest::Random( seed ) % height;
+
+      // Mostly single cells, sometimes small rectangles or the goal itself
+      switch ( gmtest::Random( seed ) % 8 ) {
+        case 0:
+          grid.SetRectangle( h * 16.0, v * 16.0, h * 16.0 + gmtest::Random( seed ) % 48,
+                             v * 16.0 + gmtest::Random( seed ) % 48, gmtest::Random( seed ) % 2 != 0 );
+          break;
+
+        case 1:
+          grid.SetCell( goalH, goalV, !grid.IsCellForbidden( goalH, goalV ) );
+          break;
+
+        default:
+          grid.SetCell( h, v, !grid.IsCellForbidden( h, v ) );
+      }
+
+      // Several edits are sometimes collected by one update
+      if ( gmtest::Random( seed ) % 3 == 0 )
+        continue;
+
+      ++compared;
+
+      if ( !MatchesDijkstra( field, grid, goalH, goalV, diagonal ) )
+        ++failed;
+    }
+
+    CFlowField::Destroy( id );
+    CMotionGrid::Destroy( 0 );
+  }
+
+  CHECK( compared > 2000 );
+  CHECK_EQUAL( 0, failed );
+}
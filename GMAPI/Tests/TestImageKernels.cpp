@@ -0,0 +1,330 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestImageKernels.cpp                                                */
+/*   - Tests of CImageKernels                                           */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiImageKernels.h"
+#include "GmapiUtilities.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+using namespace gm;
+
+namespace {
+  typedef std::vector<unsigned char> Bitmap;
+
+  // Arguments of Apply for every filter
+  struct FILTERCASE {
+    const char* name;
+    int filter;
+    double args[3];
+    int tolerance;     // Allowed difference of the SSE2 and plain results
+  };
+
+  const FILTERCASE FILTERS[] = {
+    { "premultiply", CImageKernels::IF_PREMULTIPLY, { 0.0, 0.0, 0.0 }, 0 },
+    { "unpremultiply", CImageKernels::IF_UNPREMULTIPLY, { 0.0, 0.0, 0.0 }, 0 },
+    { "colorkey", CImageKernels::IF_COLORKEY, { 0x30C020, 40.0, 0.0 }, 0 },
+    { "tint", CImageKernels::IF_TINT, { 0x80FF40, 0.0, 0.0 }, 0 },
+    { "blend", CImageKernels::IF_BLEND, { 0x2040FF, 0.3, 0.0 }, 0 },
+    { "grayscale", CImageKernels::IF_GRAYSCALE, { 0.75, 0.0, 0.0 }, 0 },
+    { "hsv", CImageKernels::IF_HSV, { 40.0, -30.0, 20.0 }, 0 },
+    { "boxblur", CImageKernels::IF_BOXBLUR, { 3.0, 0.0, 0.0 }, 1 },
+    { "gaussianblur", CImageKernels::IF_GAUSSIANBLUR, { 2.5, 0.0, 0.0 }, 1 }
+  };
+
+  const int FILTER_COUNT = sizeof( FILTERS ) / sizeof( FILTERS[0] );
+
+  void RandomBitmap( Bitmap& aBitmap, int aWidth, int aHeight, unsigned int& aSeed ) {
+    aBitmap.resize( aWidth * aHeight * 4 );
+
+    for ( size_t i = 0; i < aBitmap.size(); i++ )
+      aBitmap[i] = (unsigned char) gmtest::Random( aSeed );
+
+    // Some fully transparent and opaque pixels
+    for ( size_t i = 3; i < aBitmap.size(); i += 4 * 7 )
+      aBitmap[i] = ( i % 2 ? 0 : 255 );
+  }
+
+  int MaxDifference( const Bitmap& aFirst, const Bitmap& aSecond ) {
+    int result = 0;
+
+    for ( size_t i = 0; i < aFirst.size(); i++ )
+      result = std::max( result, abs( aFirst[i] - aSecond[i] ) );
+
+    return result;
+  }
+
+  void Apply( const FILTERCASE& aCase, Bitmap& aBitmap, int aWidth, int aHeight, bool aSSE2 ) {
+    CCpuInfo::SetSSE2( aSSE2 );
+    CImageKernels::Apply( &aBitmap[0], aWidth, aHeight, aCase.filter, aCase.args[0], aCase.args[1], aCase.args[2] );
+    CCpuInfo::SetSSE2( true );
+  }
+
+  // Pixels of a golden row: four go through the SSE2 loop, the rest
+  // through the plain tail
+  const int GOLDEN_PIXELS = 6;
+
+  // Filter applied to a row of pixels (0xAARRGGBB) with the expected
+  // result, worked out by hand from the definitions of the filters
+  struct GOLDENCASE {
+    const char* name;
+    int filter;
+    double args[3];
+    DWORD input[GOLDEN_PIXELS];
+    DWORD expected[GOLDEN_PIXELS];
+  };
+
+  const GOLDENCASE GOLDEN[] = {
+    // 255 * 128 / 255 = 128, 64 * 128 / 255 = 32.1, 32 * 128 / 255 = 16.1,
+    // 128 * 254 / 255 = 127.5
+    { "premultiply", CImageKernels::IF_PREMULTIPLY, { 0.0, 0.0, 0.0 },
+      { 0x80FF4020, 0xFF123456, 0x00FFFFFF, 0x40FF8000, 0x01FFFFFF, 0xFE808080 },
+      { 0x80802010, 0xFF123456, 0x00000000, 0x40402000, 0x01010101, 0xFE7F7F7F } },
+    // (128 * 255 + 64) / 128 = 255.5, (32 * 255 + 64) / 128 = 64.3,
+    // (16 * 255 + 64) / 128 = 32.4; channels above alpha are clamped
+    { "unpremultiply", CImageKernels::IF_UNPREMULTIPLY, { 0.0, 0.0, 0.0 },
+      { 0x80802010, 0xFF123456, 0x00123456, 0x40402000, 0x10204008, 0x01010101 },
+      { 0x80FF4020, 0xFF123456, 0x00123456, 0x40FF8000, 0x10FFFF80, 0x01FFFFFF } },
+    // Key 0x20C030 (RGB) with tolerance 16; 0x41 is 17 from 0x30
+    { "colorkey", CImageKernels::IF_COLORKEY, { 0x30C020, 16.0, 0.0 },
+      { 0xFF20C030, 0xFF28B838, 0xFF20C041, 0x8010D020, 0xFF20C040, 0xFF000000 },
+      { 0x0020C030, 0x0028B838, 0xFF20C041, 0x0010D020, 0x0020C040, 0xFF000000 } },
+    // Multiplies by 0x40FF80 (RGB): 128 * 255 / 255 = 128, 64 * 128 / 255 = 32.1
+    { "tint", CImageKernels::IF_TINT, { 0x80FF40, 0.0, 0.0 },
+      { 0xC0FF8040, 0xFFFFFFFF, 0xFF000000, 0x00FFFFFF, 0xFF804020, 0x7F010203 },
+      { 0xC0408020, 0xFF40FF80, 0xFF000000, 0x0040FF80, 0xFF204010, 0x7F000202 } },
+    // Half of red: weight 128, so 255 * 128 / 255 = 128 and 255 * 127 / 255 = 127
+    { "blend", CImageKernels::IF_BLEND, { 0x0000FF, 0.5, 0.0 },
+      { 0xFF0000FF, 0xFFFF0000, 0x80000000, 0xFFFFFFFF, 0x00FF00FF, 0xFF00FF00 },
+      { 0xFF80007F, 0xFFFF0000, 0x80800000, 0xFFFF7F7F, 0x00FF007F, 0xFF807F00 } },
+    // Luma weights 77, 150 and 29 of 256: red 77, green 149, blue 29
+    { "grayscale", CImageKernels::IF_GRAYSCALE, { 1.0, 0.0, 0.0 },
+      { 0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0x80FFFFFF, 0xFF000000, 0x10808080 },
+      { 0xFF4D4D4D, 0xFF959595, 0xFF1D1D1D, 0x80FFFFFF, 0xFF000000, 0x10808080 } },
+    // Hue +64 is 1.5 sectors: red turns to 0x80FF00, green to 0x0080FF,
+    // blue to 0xFF0080; grays keep no saturation
+    { "hsv hue", CImageKernels::IF_HSV, { 64.0, 0.0, 0.0 },
+      { 0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0x80808080, 0xFFFFFFFF, 0xFF000000 },
+      { 0xFF80FF00, 0xFF0080FF, 0xFFFF0080, 0x80808080, 0xFFFFFFFF, 0xFF000000 } },
+    // Hue +128 wraps red to cyan and blue to yellow; saturation 127 of
+    // 255 and value 200 give 200 * 128 / 255 = 100.4 for the low channels
+    { "hsv wrap", CImageKernels::IF_HSV, { 128.0, -128.0, -55.0 },
+      { 0xFFFF0000, 0xFF0000FF, 0xFFFFFFFF, 0xFF000000, 0x40FF0000, 0xFF0A0A0A },
+      { 0xFF64C8C8, 0xFFC8C864, 0xFFC8C8C8, 0xFF000000, 0x4064C8C8, 0xFF000000 } },
+    // Value and saturation are clamped
+    { "hsv clamp", CImageKernels::IF_HSV, { 0.0, -300.0, 300.0 },
+      { 0xFFFF0000, 0xFF808000, 0xFF000000, 0xFF102030, 0x00FF00FF, 0xFFFFFFFF },
+      { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0x00FFFFFF, 0xFFFFFFFF } }
+  };
+
+  const int GOLDEN_COUNT = sizeof( GOLDEN ) / sizeof( GOLDEN[0] );
+
+  // Opaque black bitmap with a white pixel
+  void Impulse( std::vector<DWORD>& aPixels, int aWidth, int aHeight, int aX, int aY ) {
+    aPixels.assign( aWidth * aHeight, 0xFF000000 );
+    aPixels[aY * aWidth + aX] = 0xFFFFFFFF;
+  }
+
+  // Opaque gray pixel
+  inline DWORD Gray( int aValue ) {
+    return 0xFF000000 | ( aValue << 16 ) | ( aValue << 8 ) | aValue;
+  }
+
+  int MaxDifference( const std::vector<DWORD>& aFirst, const std::vector<DWORD>& aSecond ) {
+    return MaxDifference( Bitmap( (const unsigned char*) &aFirst[0], (const unsigned char*) &aFirst[0] + aFirst.size() * 4 ),
+                          Bitmap( (const unsigned char*) &aSecond[0], (const unsigned char*) &aSecond[0] + aSecond.size() * 4 ) );
+  }
+}
+
+// SSE2 and plain code paths on sizes that are not multiples of the vector
+// width, and on bitmaps large enough to be split between threads
+TEST( ImageKernelsSSE2AgainstScalar ) {
+  const int SIZES[][2] = { { 1, 1 }, { 3, 5 }, { 37, 23 }, { 300, 257 } };
+  unsigned int seed = 9;
+
+  for ( int size = 0; size < 4; size++ ) {
+    int width = SIZES[size][0], height = SIZES[size][1];
+
+    for ( int i = 0; i < FILTER_COUNT; i++ ) {
+      Bitmap source, vector, scalar;
+
+      RandomBitmap( source, width, height, seed );
+      vector = scalar = source;
+
+      Apply( FILTERS[i], vector, width, height, true );
+      Apply( FILTERS[i], scalar, width, height, false );
+
+      if ( MaxDifference( vector, scalar ) > FILTERS[i].tolerance ) {
+        printf( "  %s, %dx%d: difference %d\n", FILTERS[i].name, width, height, MaxDifference( vector, scalar ) );
+        CHECK( MaxDifference( vector, scalar ) <= FILTERS[i].tolerance );
+      }
+    }
+  }
+}
+
+TEST( ImageKernelsIdentities ) {
+  Bitmap source, bitmap;
+  unsigned int seed = 2;
+
+  RandomBitmap( source, 41, 17, seed );
+
+  for ( int sse2 = 0; sse2 < 2; sse2++ ) {
+    CCpuInfo::SetSSE2( sse2 != 0 );
+
+    bitmap = source;
+    CImageKernels::BoxBlur( &bitmap[0], 41, 17, 0 );
+    CHECK( bitmap == source );
+
+    bitmap = source;
+    CImageKernels::Grayscale( &bitmap[0], 41, 17, 0.0 );
+    CHECK( bitmap == source );
+
+    bitmap = source;
+    CImageKernels::Blend( &bitmap[0], 41, 17, 0xFFFFFF, 0.0 );
+    CHECK( bitmap == source );
+
+    bitmap = source;
+    CImageKernels::Tint( &bitmap[0], 41, 17, 0xFFFFFF );
+    CHECK( bitmap == source );
+
+    bitmap = source;
+    CImageKernels::ShiftHSV( &bitmap[0], 41, 17, 0, 0, 0 );
+    CHECK( MaxDifference( bitmap, source ) <= 1 );
+  }
+
+  CCpuInfo::SetSSE2( true );
+}
+
+// Known inputs and outputs of the pixel filters on both code paths
+TEST( ImageKernelsGolden ) {
+  for ( int i = 0; i < GOLDEN_COUNT; i++ ) {
+    const GOLDENCASE& golden = GOLDEN[i];
+
+    for ( int sse2 = 0; sse2 < 2; sse2++ ) {
+      DWORD pixels[GOLDEN_PIXELS];
+      std::copy( golden.input, golden.input + GOLDEN_PIXELS, pixels );
+
+      CCpuInfo::SetSSE2( sse2 != 0 );
+      CImageKernels::Apply( (unsigned char*) pixels, GOLDEN_PIXELS, 1, golden.filter,
+                            golden.args[0], golden.args[1], golden.args[2] );
+
+      for ( int j = 0; j < GOLDEN_PIXELS; j++ ) {
+        if ( pixels[j] != golden.expected[j] ) {
+          printf( "  %s, %s, pixel %d: %08X instead of %08X\n", golden.name, ( sse2 ? "SSE2" : "plain" ),
+                  j, (unsigned int) pixels[j], (unsigned int) golden.expected[j] );
+          CHECK( pixels[j] == golden.expected[j] );
+        }
+      }
+    }
+  }
+
+  CCpuInfo::SetSSE2( true );
+}
+
+// Impulse responses of the blurs. Every pass rounds to 8 bits, so the
+// weights are those of the rounded passes, not of the exact kernels.
+TEST( ImageKernelsBlurGolden ) {
+  for ( int sse2 = 0; sse2 < 2; sse2++ ) {
+    CCpuInfo::SetSSE2( sse2 != 0 );
+
+    // Radius 1: 255 / 3 = 85 along the row, 85 / 3 = 28.3 along the
+    // columns
+    std::vector<DWORD> pixels, expected( 25, 0xFF000000 );
+    Impulse( pixels, 5, 5, 2, 2 );
+
+    for ( int y = 1; y <= 3; y++ ) {
+      for ( int x = 1; x <= 3; x++ )
+        expected[y * 5 + x] = Gray( 28 );
+    }
+
+    CImageKernels::BoxBlur( (unsigned char*) &pixels[0], 5, 5, 1 );
+    CHECK( MaxDifference( pixels, expected ) <= 1 );
+
+    // Sigma 2 is approximated by boxes of widths 3, 3 and 5: the first
+    // two give 28 57 85 57 28, the last one averages them by fives
+    const int WEIGHTS[] = { 6, 17, 34, 45, 51, 45, 34, 17, 6 };
+
+    Impulse( pixels, 13, 1, 6, 0 );
+    expected.assign( 13, 0xFF000000 );
+
+    for ( int x = 0; x < 9; x++ )
+      expected[x + 2] = Gray( WEIGHTS[x] );
+
+    CImageKernels::GaussianBlur( (unsigned char*) &pixels[0], 13, 1, 2.0 );
+    CHECK( MaxDifference( pixels, expected ) <= 1 );
+  }
+
+  CCpuInfo::SetSSE2( true );
+}
+
+// Premultiplied channels are rounded channel * alpha / 255; opaque pixels
+// survive the round trip exactly
+TEST( ImageKernelsPremultiply ) {
+  Bitmap bitmap;
+  unsigned int seed = 4;
+
+  RandomBitmap( bitmap, 64, 8, seed );
+
+  for ( size_t i = 0; i < bitmap.size(); i += 16 )
+    bitmap[i + 3] = 255;
+
+  Bitmap source = bitmap;
+  CImageKernels::Premultiply( &bitmap[0], 64, 8 );
+
+  for ( size_t i = 0; i < bitmap.size(); i += 4 ) {
+    for ( int c = 0; c < 3; c++ )
+      CHECK_EQUAL( ( source[i + c] * source[i + 3] + 127 ) / 255, (int) bitmap[i + c] );
+
+    CHECK_EQUAL( source[i + 3], bitmap[i + 3] );
+  }
+
+  CImageKernels::Unpremultiply( &bitmap[0], 64, 8 );
+
+  for ( size_t i = 0; i < bitmap.size(); i += 16 )
+    CHECK( bitmap[i] == source[i] && bitmap[i + 1] == source[i + 1] && bitmap[i + 2] == source[i + 2] );
+}
+
+BENCHMARK( ImageKernels2048 ) {
+  const int SIZE = 2048;
+  Bitmap bitmap;
+  unsigned int seed = 1;
+
+  RandomBitmap( bitmap, SIZE, SIZE, seed );
+
+  for ( int i = 0; i < FILTER_COUNT; i++ ) {
+    double speeds[2];
+
+    for ( int sse2 = 0; sse2 < 2; sse2++ ) {
+      gmtest::CTimer timer;
+      Apply( FILTERS[i], bitmap, SIZE, SIZE, sse2 != 0 );
+      speeds[sse2] = SIZE * SIZE / 1e6 / timer.GetSeconds();
+    }
+
+    printf( "  %s: %.0f MPix/s plain, %.0f MPix/s SSE2\n", FILTERS[i].name, speeds[0], speeds[1] );
+  }
+}
@@ -0,0 +1,108 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestMain.cpp                                                        */
+/*   - Entry point of the tests of the native extensions                */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+
+#include <windows.h>
+#include <string.h>
+
+namespace gmtest {
+
+  CTest* CTest::m_first = NULL;
+  CTest* CTest::m_last = NULL;
+  int CTest::m_failures = 0;
+
+  CTest::CTest( const char* aName, TESTPROC aProc, bool aBenchmark ):
+    m_name( aName ), m_proc( aProc ), m_benchmark( aBenchmark ), m_next( NULL ) {
+    // Tests run in the order of their registration
+    if ( m_last )
+      m_last->m_next = this;
+    else
+      m_first = this;
+
+    m_last = this;
+  }
+
+  int CTest::Run( bool aBenchmarks, const char* aFilter ) {
+    int count = 0;
+
+    for ( CTest* test = m_first; test; test = test->m_next ) {
+      if ( ( test->m_benchmark && !aBenchmarks ) || ( aFilter && !strstr( test->m_name, aFilter ) ) )
+        continue;
+
+      int failures = m_failures;
+
+      printf( "%s %s\n", ( test->m_benchmark ? "[bench]" : "[test] " ), test->m_name );
+      fflush( stdout );
+
+      test->m_proc();
+
+      if ( m_failures > failures )
+        printf( "  FAILED (%d)\n", m_failures - failures );
+
+      ++count;
+    }
+
+    printf( "%d run, %d failed checks\n", count, m_failures );
+    return m_failures;
+  }
+
+  void CTest::Fail( const char* aFile, int aLine, const char* aExpression ) {
+    printf( "  %s(%d): check failed: %s\n", aFile, aLine, aExpression );
+    ++m_failures;
+  }
+
+  CTimer::CTimer() {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter( &counter );
+
+    m_start = counter.QuadPart;
+  }
+
+  double CTimer::GetSeconds() const {
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter( &counter );
+    QueryPerformanceFrequency( &frequency );
+
+    return (double) ( counter.QuadPart - m_start ) / (double) frequency.QuadPart;
+  }
+
+}
+
+// Usage: GmapiTests [--bench] [filter]
+int main( int argc, char** argv ) {
+  bool benchmarks = false;
+  const char* filter = NULL;
+
+  for ( int i = 1; i < argc; i++ ) {
+    if ( !strcmp( argv[i], "--bench" ) )
+      benchmarks = true;
+    else
+      filter = argv[i];
+  }
+
+  return ( gmtest::CTest::Run( benchmarks, filter ) ? 1 : 0 );
+}
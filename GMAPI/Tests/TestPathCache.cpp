@@ -0,0 +1,220 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestPathCache.cpp                                                   */
+/*   - Tests of CPathCache                                              */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiPathCache.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+using namespace gm;
+
+namespace {
+  // Length of the path, -1 if it is not walkable on the grid
+  double WalkableLength( const CPathGrid& aGrid, const std::vector<GRIDCELL>& aCells ) {
+    double length = 0.0;
+
+    for ( size_t i = 0; i < aCells.size(); i++ ) {
+      if ( !aGrid.IsFree( aCells[i].h, aCells[i].v ) )
+        return -1.0;
+
+      if ( i > 0 ) {
+        int dh = aCells[i].h - aCells[i - 1].h, dv = aCells[i].v - aCells[i - 1].v;
+
+        if ( dh && dv ) {
+          if ( !aGrid.IsFree( aCells[i - 1].h + dh, aCells[i - 1].v ) || !aGrid.IsFree( aCells[i - 1].h, aCells[i - 1].v + dv ) )
+            return -1.0;
+
+          length += 1.4142135623730951;
+        } else
+          length += 1.0;
+      }
+    }
+
+    return length;
+  }
+
+  // Looks the query up like mp_grid_path does and searches it on a miss
+  bool FindCached( CPathFinder& aFinder, const CMotionGrid& aGrid, int aStartH, int aStartV, int aGoalH, int aGoalV,
+                   bool aDiagonal, std::vector<GRIDCELL>& aCells ) {
+    bool found;
+
+    if ( CPathCache::Find( aGrid.GetID(), aStartH, aStartV, aGoalH, aGoalV, aDiagonal, aCells, found ) )
+      return found;
+
+    found = aFinder.FindPath( CPathGrid::GetSnapshot( aGrid ), aStartH, aStartV, aGoalH, aGoalV, aDiagonal, aCells );
+    CPathCache::Store( aGrid.GetID(), aStartH, aStartV, aGoalH, aGoalV, aDiagonal, aCells, found );
+
+    return found;
+  }
+}
+
+// Forbidding a cell next to the corner of a diagonal step removes the path
+TEST( PathCacheDiagonalCorner ) {
+  CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, 4, 4, 16.0, 16.0 );
+  std::vector<GRIDCELL> cells;
+  CPathFinder finder;
+  bool found;
+
+  CPathCache::SetCapacity( 16 );
+  CPathCache::SetStrict( false );
+  CPathCache::Clear();
+
+  CHECK( FindCached( finder, grid, 0, 0, 1, 1, true, cells ) );
+  CHECK_EQUAL( 2, (int) cells.size() );
+  CHECK( CPathCache::Find( 0, 0, 0, 1, 1, true, cells, found ) );
+
+  grid.SetCell( 1, 0, true );
+  CHECK( !CPathCache::Find( 0, 0, 0, 1, 1, true, cells, found ) );
+
+  CHECK( FindCached( finder, grid, 0, 0, 1, 1, true, cells ) );
+  CHECK_EQUAL( 3, (int) cells.size() );
+
+  grid.SetCell( 0, 1, true );
+  CHECK( !CPathCache::Find( 0, 0, 0, 1, 1, true, cells, found ) );
+
+  CMotionGrid::Destroy( 0 );
+  CHECK_EQUAL( 0, CPathCache::GetSize() );
+  CPathCache::SetCapacity( 0 );
+}
+
+// Hits are walkable after random edits, and the shortest ones in strict
+// mode
+TEST( PathCacheRandomEdits ) {
+  CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, 60, 60, 16.0, 16.0 );
+  std::vector<GRIDCELL> cached, expected;
+  CPathFinder finder;
+  unsigned int seed = 5;
+
+  for ( int i = 0; i < 60 * 60 / 5; i++ )
+    grid.SetCell( gmtest::Random( seed ) % 60, gmtest::Random( seed ) % 60, true );
+
+  for ( int strict = 0; strict < 2; strict++ ) {
+    CPathCache::SetCapacity( 200 );
+    CPathCache::SetStrict( strict != 0 );
+    CPathCache::Clear();
+    CPathCache::ResetStatistics();
+
+    for ( int i = 0; i < 20000; i++ ) {
+      if ( gmtest::Random( seed ) % 50 == 0 )
+        grid.SetCell( gmtest::Random( seed ) % 60, gmtest::Random( seed ) % 60, gmtest::Random( seed ) % 2 != 0 );
+
+      int startH = gmtest::Random( seed ) % 10, startV = gmtest::Random( seed ) % 10;
+      int goalH = 50 + gmtest::Random( seed ) % 10, goalV = 50 + gmtest::Random( seed ) % 10;
+      bool diagonal = ( gmtest::Random( seed ) % 2 != 0 );
+      const CPathGrid& snapshot = CPathGrid::GetSnapshot( grid );
+      bool found = FindCached( finder, grid, startH, startV, goalH, goalV, diagonal, cached );
+      bool exists = finder.FindPath( snapshot, startH, startV, goalH, goalV, diagonal, expected );
+
+      CHECK_EQUAL( exists, found );
+
+      if ( found && exists ) {
+        double length = WalkableLength( snapshot, cached );
+
+        CHECK( length >= 0.0 );
+        CHECK( !strict || fabs( length - WalkableLength( snapshot, expected ) ) < 1e-6 );
+      }
+    }
+
+    CHECK( CPathCache::GetStatistics().hits > 0 );
+  }
+
+  CMotionGrid::Destroy( 0 );
+  CPathCache::SetCapacity( 0 );
+}
+
+// Synthetic RTS: workers shuttle between their base and resource fields,
+// soldiers are sent from where they stand to rally points and buildings
+// are placed from time to time
+BENCHMARK( PathCacheRTS ) {
+  const int SIZE = 256, UNITS = 300, STEPS = 400, BASES = 4, FIELDS = 12, RALLIES = 6;
+
+  for ( int capacity = 0; capacity <= 2048; capacity += 2048 ) {
+    CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, SIZE, SIZE, 16.0, 16.0 );
+    std::vector<GRIDCELL> places, cells;
+    CPathFinder finder;
+    unsigned int seed = 21;
+    int found = 0;
+
+    for ( int i = 0; i < SIZE * SIZE / 10; i++ )
+      grid.SetCell( gmtest::Random( seed ) % SIZE, gmtest::Random( seed ) % SIZE, true );
+
+    for ( int i = 0; i < BASES + FIELDS + RALLIES; i++ ) {
+      GRIDCELL place = { gmtest::Random( seed ) % SIZE, gmtest::Random( seed ) % SIZE };
+
+      grid.SetCell( place.h, place.v, false );
+      places.push_back( place );
+    }
+
+    CPathCache::SetCapacity( capacity );
+    CPathCache::SetStrict( false );
+    CPathCache::Clear();
+    CPathCache::ResetStatistics();
+
+    gmtest::CTimer timer;
+
+    for ( int step = 0; step < STEPS; step++ ) {
+      if ( step % 50 == 0 ) {
+        double x = ( gmtest::Random( seed ) % SIZE ) * 16.0, y = ( gmtest::Random( seed ) % SIZE ) * 16.0;
+        grid.SetRectangle( x, y, x + 47.0, y + 47.0, true );
+      }
+
+      // Every unit asks for a new path once in 10 steps
+      for ( int unit = step % 10; unit < UNITS; unit += 10 ) {
+        GRIDCELL start, goal;
+
+        if ( unit % 3 != 0 ) {
+          int base = unit % BASES, field = BASES + unit % FIELDS;
+          bool toField = ( ( step / 10 + unit ) % 2 == 0 );
+
+          start = places[toField ? base : field];
+          goal = places[toField ? field : base];
+        } else {
+          start.h = gmtest::Random( seed ) % SIZE;
+          start.v = gmtest::Random( seed ) % SIZE;
+          goal = places[BASES + FIELDS + unit % RALLIES];
+        }
+
+        if ( FindCached( finder, grid, start.h, start.v, goal.h, goal.v, true, cells ) )
+          ++found;
+      }
+    }
+
+    const PATHCACHESTATS& statistics = CPathCache::GetStatistics();
+    double seconds = timer.GetSeconds();
+
+    if ( capacity )
+      printf( "  cache %d: %.0f ms, %d hits, %d misses (%.0f%% hits), %d invalidations, %d found\n", capacity,
+              seconds * 1000.0, statistics.hits, statistics.misses,
+              100.0 * statistics.hits / ( statistics.hits + statistics.misses ), statistics.invalidations, found );
+    else
+      printf( "  no cache: %.0f ms, %d found\n", seconds * 1000.0, found );
+
+    CMotionGrid::Destroy( 0 );
+  }
+
+  CPathCache::SetCapacity( 0 );
+}
@@ -0,0 +1,473 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestPathFinder.cpp                                                  */
+/*   - Tests of CPathFinder                                             */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiPathFinder.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+using namespace gm;
+
+namespace {
+  const double SQRT2 = 1.4142135623730951;
+
+  // Length of the shortest path by Dijkstra's algorithm, -1 if there is
+  // no path; diagonal moves must not cut corners
+  double ShortestPath( const CMotionGrid& aGrid, int aStartH, int aStartV, int aGoalH, int aGoalV, bool aDiagonal ) {
+    typedef std::pair<double, int> NODE;
+
+    int width = aGrid.GetHorizontalCells(), height = aGrid.GetVerticalCells();
+    std::vector<double> cost( width * height, 1e300 );
+    std::priority_queue<NODE, std::vector<NODE>, std::greater<NODE> > open;
+
+    if ( aGrid.IsCellForbidden( aStartH, aStartV ) || aGrid.IsCellForbidden( aGoalH, aGoalV ) )
+      return -1.0;
+
+    cost[aStartV * width + aStartH] = 0.0;
+    open.push( NODE( 0.0, aStartV * width + aStartH ) );
+
+    while ( !open.empty() ) {
+      NODE node = open.top();
+      int h = node.second % width, v = node.second / width;
+
+      open.pop();
+
+      if ( node.first > cost[node.second] )
+        continue;
+
+      if ( h == aGoalH && v == aGoalV )
+        return node.first;
+
+      for ( int dv = -1; dv <= 1; dv++ ) {
+        for ( int dh = -1; dh <= 1; dh++ ) {
+          bool diagonal = ( dh != 0 && dv != 0 );
+
+          if ( ( !dh && !dv ) || aGrid.IsCellForbidden( h + dh, v + dv ) )
+            continue;
+
+          if ( diagonal && ( !aDiagonal || aGrid.IsCellForbidden( h + dh, v ) || aGrid.IsCellForbidden( h, v + dv ) ) )
+            continue;
+
+          double next = node.first + ( diagonal ? SQRT2 : 1.0 );
+          int cell = ( v + dv ) * width + h + dh;
+
+          if ( next < cost[cell] - 1e-9 ) {
+            cost[cell] = next;
+            open.push( NODE( next, cell ) );
+          }
+        }
+      }
+    }
+
+    return -1.0;
+  }
+
+  // Length of the path, -1 if it contains an invalid step
+  double PathLength( const CMotionGrid& aGrid, const std::vector<GRIDCELL>& aCells, bool aDiagonal ) {
+    double length = 0.0;
+
+    for ( size_t i = 1; i < aCells.size(); i++ ) {
+      int dh = aCells[i].h - aCells[i - 1].h, dv = aCells[i].v - aCells[i - 1].v;
+
+      if ( abs( dh ) > 1 || abs( dv ) > 1 || ( !dh && !dv ) || aGrid.IsCellForbidden( aCells[i].h, aCells[i].v ) )
+        return -1.0;
+
+      if ( dh && dv ) {
+        if ( !aDiagonal || aGrid.IsCellForbidden( aCells[i - 1].h + dh, aCells[i - 1].v ) ||
+             aGrid.IsCellForbidden( aCells[i - 1].h, aCells[i - 1].v + dv ) )
+          return -1.0;
+
+        length += SQRT2;
+      } else
+        length += 1.0;
+    }
+
+    return length;
+  }
+
+  void FillRandom( CMotionGrid& aGrid, unsigned int& aSeed, int aDensity ) {
+    for ( int v = 0; v < aGrid.GetVerticalCells(); v++ ) {
+      for ( int h = 0; h < aGrid.GetHorizontalCells(); h++ ) {
+        if ( gmtest::Random( aSeed ) % 100 < aDensity )
+          aGrid.SetCell( h, v, true );
+      }
+    }
+  }
+
+  // Grid of a path fixture: '#' is a forbidden cell, 'S' the start, 'G'
+  // the goal and 'o' the other cells of the expected path
+  struct PATHFIXTURE {
+    const char* name;
+    bool diagonal;
+    bool found;
+    const char* rows[8];
+  };
+
+  // Every fixture has exactly one shortest path (PathFixtures checks that
+  // by counting them), so mp_grid_path returns the same cells whatever
+  // order it expands them in. Paths recorded from GM8 can be added in the
+  // same form: with 1x1 cells at (0, 0), the points of the path made by
+  // mp_grid_path from the start to the goal cell are the cells in order.
+  const PATHFIXTURE PATH_FIXTURES[] = {
+    { "corridor", false, true, {
+      "Soooooo#",
+      "######o#",
+      "#oooooo#",
+      "#o######",
+      "#ooooooG",
+      NULL } },
+    { "corridor with diagonals", true, true, {
+      "Soooooo#",
+      "######o#",
+      "#oooooo#",
+      "#o######",
+      "#ooooooG",
+      NULL } },
+    { "open diagonal", true, true, {
+      "S......",
+      ".o.....",
+      "..o....",
+      "...o...",
+      "....G..",
+      NULL } },
+    { "gap without corner cutting", true, true, {
+      ".......",
+      ".......",
+      ".Soo...",
+      "###o###",
+      "...o...",
+      "....G..",
+      NULL } },
+    { "detour", false, true, {
+      "...##oooo",
+      "Sooooo##o",
+      "...#####o",
+      ".......#G",
+      NULL } },
+    { "enclosed goal", true, false, {
+      "S....",
+      "..###",
+      "..#G#",
+      "..###",
+      NULL } }
+  };
+
+  // Number of shortest paths between the cells (at most 1000), counted
+  // by Dijkstra's algorithm with the same moves as ShortestPath
+  int CountShortestPaths( const CMotionGrid& aGrid, int aStartH, int aStartV, int aGoalH, int aGoalV, bool aDiagonal ) {
+    typedef std::pair<double, int> NODE;
+
+    int width = aGrid.GetHorizontalCells(), height = aGrid.GetVerticalCells();
+    std::vector<double> cost( width * height, 1e300 );
+    std::vector<int> count( width * height, 0 );
+    std::priority_queue<NODE, std::vector<NODE>, std::greater<NODE> > open;
+
+    cost[aStartV * width + aStartH] = 0.0;
+    count[aStartV * width + aStartH] = 1;
+    open.push( NODE( 0.0, aStartV * width + aStartH ) );
+
+    while ( !open.empty() ) {
+      NODE node = open.top();
+      int h = node.second % width, v = node.second / width;
+
+      open.pop();
+
+      if ( node.first > cost[node.second] + 1e-9 )
+        continue;
+
+      for ( int dv = -1; dv <= 1; dv++ ) {
+        for ( int dh = -1; dh <= 1; dh++ ) {
+          bool diagonal = ( dh != 0 && dv != 0 );
+
+          if ( ( !dh && !dv ) || aGrid.IsCellForbidden( h + dh, v + dv ) )
+            continue;
+
+          if ( diagonal && ( !aDiagonal || aGrid.IsCellForbidden( h + dh, v ) || aGrid.IsCellForbidden( h, v + dv ) ) )
+            continue;
+
+          double next = node.first + ( diagonal ? SQRT2 : 1.0 );
+          int cell = ( v + dv ) * width + h + dh;
+
+          if ( next < cost[cell] - 1e-9 ) {
+            cost[cell] = next;
+            count[cell] = count[node.second];
+            open.push( NODE( next, cell ) );
+          } else if ( next < cost[cell] + 1e-9 ) {
+            count[cell] = std::min( 1000, count[cell] + count[node.second] );
+          }
+        }
+      }
+    }
+
+    return count[aGoalV * width + aGoalH];
+  }
+
+  // Creates mp_grid 0 from the fixture and reads the expected path by
+  // following the marked cells from the start, orthogonal steps first
+  CMotionGrid& LoadFixture( const PATHFIXTURE& aFixture, std::vector<GRIDCELL>& aCells ) {
+    int width = (int) strlen( aFixture.rows[0] ), height = 0;
+
+    while ( aFixture.rows[height] )
+      ++height;
+
+    CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, width, height, 1.0, 1.0 );
+    GRIDCELL cell = { 0, 0 };
+
+    for ( int v = 0; v < height; v++ ) {
+      for ( int h = 0; h < width; h++ ) {
+        grid.SetCell( h, v, aFixture.rows[v][h] == '#' );
+
+        if ( aFixture.rows[v][h] == 'S' ) {
+          cell.h = h;
+          cell.v = v;
+        }
+      }
+    }
+
+    std::vector<bool> visited( width * height, false );
+    const int steps[8][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 }, { 1, 1 }, { -1, 1 }, { -1, -1 }, { 1, -1 } };
+
+    aCells.assign( 1, cell );
+    visited[cell.v * width + cell.h] = true;
+
+    while ( aFixture.found && aFixture.rows[cell.v][cell.h] != 'G' ) {
+      int i;
+
+      for ( i = 0; i < 8; i++ ) {
+        int h = cell.h + steps[i][0], v = cell.v + steps[i][1];
+
+        if ( h >= 0 && v >= 0 && h < width && v < height && !visited[v * width + h] &&
+             ( aFixture.rows[v][h] == 'o' || aFixture.rows[v][h] == 'G' ) ) {
+          cell.h = h;
+          cell.v = v;
+          break;
+        }
+      }
+
+      if ( i == 8 )
+        break;
+
+      visited[cell.v * width + cell.h] = true;
+      aCells.push_back( cell );
+    }
+
+    return grid;
+  }
+}
+
+// A* and JPS against Dijkstra on random grids of odd sizes
+TEST( PathFinderAgainstDijkstra ) {
+  CPathFinder finder;
+  std::vector<GRIDCELL> cells;
+  unsigned int seed = 5;
+
+  for ( int i = 0; i < 400; i++ ) {
+    int width = 1 + gmtest::Random( seed ) % 80, height = 1 + gmtest::Random( seed ) % 60;
+    CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, width, height, 16.0, 16.0 );
+
+    FillRandom( grid, seed, gmtest::Random( seed ) % 45 );
+
+    const CPathGrid& snapshot = CPathGrid::GetSnapshot( grid );
+
+    for ( int v = 0; v < height; v++ ) {
+      for ( int h = 0; h < width; h++ )
+        CHECK( snapshot.IsFree( h, v ) != grid.IsCellForbidden( h, v ) );
+    }
+
+    for ( int query = 0; query < 10; query++ ) {
+      int startH = gmtest::Random( seed ) % width, startV = gmtest::Random( seed ) % height;
+      int goalH = gmtest::Random( seed ) % width, goalV = gmtest::Random( seed ) % height;
+      bool diagonal = ( query % 2 != 0 );
+      double shortest = ShortestPath( grid, startH, startV, goalH, goalV, diagonal );
+
+      for ( int algorithm = CPathFinder::PA_AUTO; algorithm <= CPathFinder::PA_JPS; algorithm++ ) {
+        bool found = finder.FindPath( snapshot, startH, startV, goalH, goalV, diagonal, cells,
+                                      (CPathFinder::PathAlgorithm) algorithm );
+
+        CHECK_EQUAL( shortest >= 0.0, found );
+        CHECK_EQUAL( found, !cells.empty() );
+
+        if ( found && shortest >= 0.0 ) {
+          CHECK( cells.front().h == startH && cells.front().v == startV );
+          CHECK( cells.back().h == goalH && cells.back().v == goalV );
+          CHECK_CLOSE( shortest, PathLength( grid, cells, diagonal ), 1e-6 );
+        }
+      }
+    }
+  }
+
+  CMotionGrid::Destroy( 0 );
+}
+
+// Diagonal moves never pass between two forbidden cells touching by corner
+TEST( PathFinderCorners ) {
+  CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, 3, 3, 16.0, 16.0 );
+  CPathFinder finder;
+  std::vector<GRIDCELL> cells;
+
+  grid.SetCell( 1, 0, true );
+  grid.SetCell( 0, 1, true );
+
+  CHECK( !finder.FindPath( CPathGrid::GetSnapshot( grid ), 0, 0, 1, 1, true, cells ) );
+  CHECK( cells.empty() );
+
+  grid.SetCell( 0, 1, false );
+  CHECK( finder.FindPath( CPathGrid::GetSnapshot( grid ), 0, 0, 1, 1, true, cells ) );
+  CHECK_EQUAL( 3, (int) cells.size() );
+
+  // Forbidden goal and start
+  CHECK( !finder.FindPath( CPathGrid::GetSnapshot( grid ), 0, 0, 1, 0, true, cells ) );
+  CHECK( !finder.FindPath( CPathGrid::GetSnapshot( grid ), 1, 0, 0, 0, false, cells ) );
+
+  CMotionGrid::Destroy( 0 );
+}
+
+// Cell sequences of both algorithms against the fixtures
+TEST( PathFixtures ) {
+  CPathFinder finder;
+  std::vector<GRIDCELL> expected, cells;
+
+  for ( size_t i = 0; i < sizeof( PATH_FIXTURES ) / sizeof( PATH_FIXTURES[0] ); i++ ) {
+    const PATHFIXTURE& fixture = PATH_FIXTURES[i];
+    CMotionGrid& grid = LoadFixture( fixture, expected );
+    const GRIDCELL& start = expected.front();
+    const GRIDCELL& goal = expected.back();
+
+    if ( fixture.found ) {
+      CHECK_EQUAL( 1, CountShortestPaths( grid, start.h, start.v, goal.h, goal.v, fixture.diagonal ) );
+      CHECK( PathLength( grid, expected, fixture.diagonal ) >= 0.0 );
+    }
+
+    for ( int algorithm = CPathFinder::PA_ASTAR; algorithm <= CPathFinder::PA_JPS; algorithm++ ) {
+      bool found = false;
+
+      if ( fixture.found ) {
+        found = finder.FindPath( CPathGrid::GetSnapshot( grid ), start.h, start.v, goal.h, goal.v,
+                                 fixture.diagonal, cells, (CPathFinder::PathAlgorithm) algorithm );
+      } else {
+        for ( int v = 0; fixture.rows[v]; v++ )
+          for ( int h = 0; fixture.rows[v][h]; h++ )
+            if ( fixture.rows[v][h] == 'G' )
+              found = finder.FindPath( CPathGrid::GetSnapshot( grid ), start.h, start.v, h, v,
+                                       fixture.diagonal, cells, (CPathFinder::PathAlgorithm) algorithm );
+      }
+
+      CHECK_EQUAL( fixture.found, found );
+      CHECK_EQUAL( fixture.found ? expected.size() : 0, cells.size() );
+
+      for ( size_t n = 0; n < cells.size() && n < expected.size(); n++ ) {
+        if ( cells[n].h != expected[n].h || cells[n].v != expected[n].v ) {
+          printf( "  %s: cell %d is [%d, %d] instead of [%d, %d]\n", fixture.name, (int) n,
+                  cells[n].h, cells[n].v, expected[n].h, expected[n].v );
+          CHECK( false );
+          break;
+        }
+      }
+    }
+
+    CMotionGrid::Destroy( 0 );
+  }
+}
+
+TEST( PathFinderBatch ) {
+  CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, 64, 64, 16.0, 16.0 );
+  std::vector<CPathFinder::PATHQUERY> queries;
+  std::vector< std::vector<GRIDCELL> > paths;
+  std::vector<GRIDCELL> cells;
+  CPathFinder finder;
+  unsigned int seed = 17;
+
+  FillRandom( grid, seed, 25 );
+
+  for ( int i = 0; i < 50; i++ ) {
+    CPathFinder::PATHQUERY query = { gmtest::Random( seed ) % 64, gmtest::Random( seed ) % 64,
+                                     gmtest::Random( seed ) % 64, gmtest::Random( seed ) % 64, i % 2 != 0 };
+    queries.push_back( query );
+  }
+
+  const CPathGrid& snapshot = CPathGrid::GetSnapshot( grid );
+  int found = finder.FindPaths( snapshot, queries, paths );
+  int expected = 0;
+
+  CHECK_EQUAL( queries.size(), paths.size() );
+
+  for ( size_t i = 0; i < queries.size() && i < paths.size(); i++ ) {
+    const CPathFinder::PATHQUERY& query = queries[i];
+
+    if ( finder.FindPath( snapshot, query.startH, query.startV, query.goalH, query.goalV, query.diagonal, cells ) )
+      ++expected;
+
+    CHECK_CLOSE( PathLength( grid, cells, query.diagonal ), PathLength( grid, paths[i], query.diagonal ), 1e-6 );
+  }
+
+  CHECK_EQUAL( expected, found );
+  CMotionGrid::Destroy( 0 );
+}
+
+// Long queries on a 1024x1024 grid with scattered cells and walls
+BENCHMARK( PathFinder1024 ) {
+  CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, 1024, 1024, 16.0, 16.0 );
+  std::vector<GRIDCELL> cells;
+  CPathFinder finder;
+  unsigned int seed = 1;
+
+  FillRandom( grid, seed, 12 );
+
+  for ( int i = 0; i < 60; i++ ) {
+    double x = ( gmtest::Random( seed ) % 1000 ) * 16.0, y = ( gmtest::Random( seed ) % 1000 ) * 16.0;
+    grid.SetRectangle( x, y, x + gmtest::Random( seed ) % 3000, y + gmtest::Random( seed ) % 200, true );
+  }
+
+  const CPathGrid& snapshot = CPathGrid::GetSnapshot( grid );
+
+  for ( int algorithm = CPathFinder::PA_ASTAR; algorithm <= CPathFinder::PA_JPS; algorithm++ ) {
+    unsigned int querySeed = 2;
+    int found = 0, expanded = 0;
+
+    gmtest::CTimer timer;
+
+    for ( int i = 0; i < 50; i++ ) {
+      int startH = gmtest::Random( querySeed ) % 1024, startV = gmtest::Random( querySeed ) % 1024;
+      int goalH = gmtest::Random( querySeed ) % 1024, goalV = gmtest::Random( querySeed ) % 1024;
+
+      if ( finder.FindPath( snapshot, startH, startV, goalH, goalV, true, cells, (CPathFinder::PathAlgorithm) algorithm ) )
+        ++found;
+
+      expanded += finder.GetExpandedNodes();
+    }
+
+    printf( "  %s: 50 queries %.0f ms, %d found, %d expanded\n", algorithm == CPathFinder::PA_JPS ? "JPS" : "A*",
+            timer.GetSeconds() * 1000.0, found, expanded );
+  }
+
+  CMotionGrid::Destroy( 0 );
+}
@@ -0,0 +1,249 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestPathHierarchy.cpp                                               */
+/*   - Tests of CPathHierarchy                                          */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiPathHierarchy.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <functional>
+#include <queue>
+
+using namespace gm;
+
+namespace {
+  const double SQRT2 = 1.4142135623730951;
+
+  // Length of the shortest path by Dijkstra's algorithm through the cells
+  // of the rectangle, -1 if there is no path
+  double ShortestPath( const CMotionGrid& aGrid, int aLeft, int aTop, int aRight, int aBottom,
+                       int aStartH, int aStartV, int aGoalH, int aGoalV, bool aDiagonal ) {
+    typedef std::pair<double, int> NODE;
+
+    int width = aGrid.GetHorizontalCells();
+    std::vector<double> cost( width * aGrid.GetVerticalCells(), 1e300 );
+    std::priority_queue<NODE, std::vector<NODE>, std::greater<NODE> > open;
+
+    cost[aStartV * width + aStartH] = 0.0;
+    open.push( NODE( 0.0, aStartV * width + aStartH ) );
+
+    while ( !open.empty() ) {
+      NODE node = open.top();
+      int h = node.second % width, v = node.second / width;
+
+      open.pop();
+
+      if ( node.first > cost[node.second] )
+        continue;
+
+      if ( h == aGoalH && v == aGoalV )
+        return node.first;
+
+      for ( int dv = -1; dv <= 1; dv++ ) {
+        for ( int dh = -1; dh <= 1; dh++ ) {
+          bool diagonal = ( dh != 0 && dv != 0 );
+
+          if ( ( !dh && !dv ) || h + dh < aLeft || v + dv < aTop || h + dh > aRight || v + dv > aBottom ||
+               aGrid.IsCellForbidden( h + dh, v + dv ) )
+            continue;
+
+          if ( diagonal && ( !aDiagonal || aGrid.IsCellForbidden( h + dh, v ) || aGrid.IsCellForbidden( h, v + dv ) ) )
+            continue;
+
+          double next = node.first + ( diagonal ? SQRT2 : 1.0 );
+          int cell = ( v + dv ) * width + h + dh;
+
+          if ( next < cost[cell] - 1e-9 ) {
+            cost[cell] = next;
+            open.push( NODE( next, cell ) );
+          }
+        }
+      }
+    }
+
+    return -1.0;
+  }
+
+  // Length of the path, -1 if it contains an invalid step
+  double PathLength( const CMotionGrid& aGrid, const std::vector<GRIDCELL>& aCells, bool aDiagonal ) {
+    double length = 0.0;
+
+    for ( size_t i = 1; i < aCells.size(); i++ ) {
+      int dh = aCells[i].h - aCells[i - 1].h, dv = aCells[i].v - aCells[i - 1].v;
+
+      if ( abs( dh ) > 1 || abs( dv ) > 1 || ( !dh && !dv ) || aGrid.IsCellForbidden( aCells[i].h, aCells[i].v ) )
+        return -1.0;
+
+      if ( dh && dv ) {
+        if ( !aDiagonal || aGrid.IsCellForbidden( aCells[i - 1].h + dh, aCells[i - 1].v ) ||
+             aGrid.IsCellForbidden( aCells[i - 1].h, aCells[i - 1].v + dv ) )
+          return -1.0;
+
+        length += SQRT2;
+      } else
+        length += 1.0;
+    }
+
+    return length;
+  }
+
+  // Random free cell, false if none has been found
+  bool RandomFreeCell( const CMotionGrid& aGrid, unsigned int& aSeed, int& aH, int& aV ) {
+    for ( int i = 0; i < 100; i++ ) {
+      aH = gmtest::Random( aSeed ) % aGrid.GetHorizontalCells();
+      aV = gmtest::Random( aSeed ) % aGrid.GetVerticalCells();
+
+      if ( !aGrid.IsCellForbidden( aH, aV ) )
+        return true;
+    }
+
+    return false;
+  }
+}
+
+// Free neighbours on both sides of a cluster border are one step apart
+TEST( PathHierarchyBorder ) {
+  CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, 16, 16, 16.0, 16.0 );
+  std::vector<GRIDCELL> cells;
+
+  // Entrance of the border between the two upper clusters is in its middle
+  for ( int v = 0; v < 8; v++ )
+    grid.SetCell( 8, v, v == 3 || v == 4 );
+
+  for ( int diagonal = 0; diagonal < 2; diagonal++ ) {
+    int id = CPathHierarchy::Create( 0, 8, diagonal != 0 );
+    CPathHierarchy& hierarchy = CPathHierarchy::Get( id );
+
+    CHECK( hierarchy.FindPath( 7, 0, 8, 0, cells ) );
+    CHECK_EQUAL( 2, (int) cells.size() );
+    CHECK( hierarchy.FindPath( 7, 7, 8, 8, cells ) );
+    CHECK_EQUAL( diagonal ? 2 : 3, (int) cells.size() );
+    CHECK( hierarchy.FindPath( 6, 1, 9, 1, cells ) );
+    CHECK_CLOSE( 3.0, PathLength( grid, cells, diagonal != 0 ), 1e-6 );
+
+    CPathHierarchy::Destroy( id );
+  }
+
+  CMotionGrid::Destroy( 0 );
+}
+
+// Paths on random grids after incremental edits against Dijkstra's
+// algorithm. Paths between the same or adjacent clusters are the shortest
+// ones whenever a shortest path stays inside these clusters.
+TEST( PathHierarchyAgainstDijkstra ) {
+  std::vector<GRIDCELL> cells;
+  unsigned int seed = 9;
+  int queries = 0, local = 0;
+  double worst = 1.0;
+
+  for ( int i = 0; i < 60; i++ ) {
+    int width = 8 + gmtest::Random( seed ) % 60, height = 8 + gmtest::Random( seed ) % 45;
+    int clusterSize = 4 + gmtest::Random( seed ) % 9;
+    bool diagonal = ( i % 2 != 0 );
+    CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, width, height, 16.0, 16.0 );
+    int density = gmtest::Random( seed ) % 35;
+
+    for ( int v = 0; v < height; v++ )
+      for ( int h = 0; h < width; h++ )
+        if ( gmtest::Random( seed ) % 100 < density )
+          grid.SetCell( h, v, true );
+
+    int id = CPathHierarchy::Create( 0, clusterSize, diagonal );
+    CPathHierarchy& hierarchy = CPathHierarchy::Get( id );
+    clusterSize = hierarchy.GetClusterSize();
+
+    for ( int edit = 0; edit < 8; edit++ ) {
+      for ( int n = 0; n < 3; n++ ) {
+        int h = gmtest::Random( seed ) % width, v = gmtest::Random( seed ) % height;
+
+        if ( gmtest::Random( seed ) % 4 == 0 )
+          grid.SetRectangle( h * 16.0, v * 16.0, h * 16.0 + gmtest::Random( seed ) % 64,
+                             v * 16.0 + gmtest::Random( seed ) % 64, gmtest::Random( seed ) % 2 != 0 );
+        else
+          grid.SetCell( h, v, !grid.IsCellForbidden( h, v ) );
+      }
+
+      for ( int query = 0; query < 25; query++ ) {
+        int startH, startV, goalH, goalV;
+
+        if ( !RandomFreeCell( grid, seed, startH, startV ) )
+          break;
+
+        // Every other goal is near the start, often across a border
+        if ( query % 2 ) {
+          goalH = std::min( std::max( startH + gmtest::Random( seed ) % 7 - 3, 0 ), width - 1 );
+          goalV = std::min( std::max( startV + gmtest::Random( seed ) % 7 - 3, 0 ), height - 1 );
+        } else if ( !RandomFreeCell( grid, seed, goalH, goalV ) )
+          break;
+
+        double shortest = ShortestPath( grid, 0, 0, width - 1, height - 1, startH, startV, goalH, goalV, diagonal );
+        bool found = hierarchy.FindPath( startH, startV, goalH, goalV, cells );
+
+        ++queries;
+        CHECK_EQUAL( shortest >= 0.0, found );
+
+        if ( !found || shortest < 0.0 )
+          continue;
+
+        double length = PathLength( grid, cells, diagonal );
+
+        CHECK( cells.front().h == startH && cells.front().v == startV );
+        CHECK( cells.back().h == goalH && cells.back().v == goalV );
+        CHECK( length >= shortest - 1e-6 );
+
+        if ( shortest > 0.0 && length / shortest > worst )
+          worst = length / shortest;
+
+        int startCH = startH / clusterSize, startCV = startV / clusterSize;
+        int goalCH = goalH / clusterSize, goalCV = goalV / clusterSize;
+
+        if ( abs( startCH - goalCH ) > 1 || abs( startCV - goalCV ) > 1 )
+          continue;
+
+        int left = std::min( startCH, goalCH ) * clusterSize, top = std::min( startCV, goalCV ) * clusterSize;
+        int right = ( std::max( startCH, goalCH ) + 1 ) * clusterSize - 1;
+        int bottom = ( std::max( startCV, goalCV ) + 1 ) * clusterSize - 1;
+
+        if ( fabs( ShortestPath( grid, left, top, right, bottom, startH, startV, goalH, goalV, diagonal ) -
+                   shortest ) < 1e-6 ) {
+          ++local;
+
+          if ( fabs( length - shortest ) > 1e-3 ) {
+            printf( "  [%d, %d] - [%d, %d]: %.3f instead of %.3f\n", startH, startV, goalH, goalV, length, shortest );
+            CHECK( false );
+          }
+        }
+      }
+    }
+
+    CPathHierarchy::Destroy( id );
+    CMotionGrid::Destroy( 0 );
+  }
+
+  CHECK( queries > 10000 && local > 3000 );
+  // Paths between distant clusters are not always the shortest ones
+  CHECK( worst < 2.5 );
+}
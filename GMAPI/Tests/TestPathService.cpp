@@ -0,0 +1,129 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestPathService.cpp                                                 */
+/*   - Tests of CPathService                                            */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiPathService.h"
+
+using namespace gm;
+
+namespace {
+  // Submits random queries with negative path index and checks the cells
+  // against CPathFinder on the same grid
+  void CheckRequests( CMotionGrid& aGrid, unsigned int& aSeed, int aCount ) {
+    const CPathGrid& snapshot = CPathGrid::GetSnapshot( aGrid );
+    int width = aGrid.GetHorizontalCells(), height = aGrid.GetVerticalCells();
+    std::vector<CPathFinder::PATHQUERY> queries;
+    std::vector<int> requests;
+    std::vector<GRIDCELL> expected, cells;
+    CPathFinder finder;
+
+    for ( int i = 0; i < aCount; i++ ) {
+      CPathFinder::PATHQUERY query = { gmtest::Random( aSeed ) % width, gmtest::Random( aSeed ) % height,
+                                       gmtest::Random( aSeed ) % width, gmtest::Random( aSeed ) % height, i % 2 != 0 };
+
+      queries.push_back( query );
+      requests.push_back( CPathService::Submit( aGrid.GetID(), -1, query.startH * 16.0 + 8.0, query.startV * 16.0 + 8.0,
+                                                query.goalH * 16.0 + 8.0, query.goalV * 16.0 + 8.0, query.diagonal,
+                                                gmtest::Random( aSeed ) % 3 ) );
+    }
+
+    for ( int i = 0; i < 10000 && CPathService::GetPendingCount() > 0; i++ ) {
+      if ( !CPathService::Sync() )
+        Sleep( 1 );
+    }
+
+    CHECK_EQUAL( 0, CPathService::GetPendingCount() );
+
+    for ( int i = 0; i < aCount; i++ ) {
+      const CPathFinder::PATHQUERY& query = queries[i];
+      bool found = finder.FindPath( snapshot, query.startH, query.startV, query.goalH, query.goalV, query.diagonal, expected );
+
+      CHECK_EQUAL( found ? CPathService::RS_FOUND : CPathService::RS_NOT_FOUND, CPathService::GetStatus( requests[i] ) );
+      CHECK_EQUAL( found, CPathService::GetCells( requests[i], cells ) );
+      CHECK( !found || ( cells.front().h == query.startH && cells.front().v == query.startV &&
+                         cells.back().h == query.goalH && cells.back().v == query.goalV ) );
+    }
+  }
+
+  void FillRandom( CMotionGrid& aGrid, unsigned int& aSeed, int aDensity ) {
+    for ( int v = 0; v < aGrid.GetVerticalCells(); v++ ) {
+      for ( int h = 0; h < aGrid.GetHorizontalCells(); h++ )
+        aGrid.SetCell( h, v, gmtest::Random( aSeed ) % 100 < aDensity );
+    }
+  }
+}
+
+TEST( PathServiceMainThread ) {
+  CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, 120, 90, 16.0, 16.0 );
+  unsigned int seed = 3;
+
+  FillRandom( grid, seed, 25 );
+  CheckRequests( grid, seed, 200 );
+  CMotionGrid::Destroy( 0 );
+}
+
+TEST( PathServiceThreads ) {
+  CMotionGrid& grid = CMotionGrid::Create( 0, 0.0, 0.0, 200, 200, 16.0, 16.0 );
+  unsigned int seed = 4;
+
+  FillRandom( grid, seed, 20 );
+  CHECK_EQUAL( 2, CPathService::Start( 2 ) );
+  CheckRequests( grid, seed, 300 );
+  CPathService::Stop();
+  CHECK_EQUAL( 0, CPathService::GetThreadCount() );
+  CMotionGrid::Destroy( 0 );
+}
+
+// Requests submitted before the grid is destroyed finish on their copy;
+// a new grid with the same ID gets a new copy
+TEST( PathServiceDestroyedGrid ) {
+  std::vector<GRIDCELL> cells;
+
+  CMotionGrid::Create( 0, 0.0, 0.0, 10, 10, 16.0, 16.0 );
+  int open = CPathService::Submit( 0, -1, 8.0, 8.0, 152.0, 8.0, false );
+
+  CMotionGrid::Destroy( 0 );
+  CPathService::Sync();
+  CHECK_EQUAL( CPathService::RS_FOUND, CPathService::GetStatus( open ) );
+
+  CMotionGrid& wall = CMotionGrid::Create( 0, 0.0, 0.0, 10, 10, 16.0, 16.0 );
+  wall.SetRectangle( 64.0, 0.0, 79.0, 159.0, true );
+
+  int blocked = CPathService::Submit( 0, -1, 8.0, 8.0, 152.0, 8.0, false );
+
+  CMotionGrid::Destroy( 0 );
+  CPathService::Sync();
+  CHECK_EQUAL( CPathService::RS_NOT_FOUND, CPathService::GetStatus( blocked ) );
+  CHECK( !CPathService::GetCells( blocked, cells ) );
+
+  // The copy is not kept for a grid that no longer exists
+  CMotionGrid::Create( 0, 0.0, 0.0, 10, 10, 16.0, 16.0 );
+  int reopened = CPathService::Submit( 0, -1, 8.0, 8.0, 152.0, 8.0, false );
+
+  CPathService::Sync();
+  CHECK_EQUAL( CPathService::RS_FOUND, CPathService::GetStatus( reopened ) );
+  CMotionGrid::Destroy( 0 );
+}
@@ -0,0 +1,188 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestPng.cpp                                                         */
+/*   - Tests of CPngFile                                                */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiPng.h"
+
+#include <stdio.h>
+
+using namespace gm;
+
+namespace {
+  void FillBitmap( std::vector<unsigned char>& aBitmap, int aWidth, int aHeight, int aKind, unsigned int& aSeed ) {
+    aBitmap.resize( aWidth * aHeight * 4 );
+
+    for ( int y = 0; y < aHeight; y++ ) {
+      for ( int x = 0; x < aWidth; x++ ) {
+        unsigned char* pixel = &aBitmap[( y * aWidth + x ) * 4];
+
+        switch ( aKind ) {
+          case 0:
+            for ( int c = 0; c < 4; c++ )
+              pixel[c] = (unsigned char) gmtest::Random( aSeed );
+            break;
+
+          case 1:
+            pixel[0] = (unsigned char) x;
+            pixel[1] = (unsigned char) y;
+            pixel[2] = (unsigned char) ( x + y );
+            pixel[3] = 255;
+            break;
+
+          case 2:
+            pixel[0] = pixel[1] = pixel[2] = ( ( x / 8 + y / 8 ) & 1 ) * 255;
+            pixel[3] = (unsigned char) ( x * y );
+            break;
+
+          default:
+            pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+        }
+      }
+    }
+  }
+
+  const char* const KIND_NAMES[] = { "noise", "gradient", "checker", "empty" };
+
+  // Replaces height in the IHDR chunk; the CRC is not checked by Decode
+  void SetHeight( std::string& aData, int aHeight ) {
+    aData[20] = (char) ( aHeight >> 24 );
+    aData[21] = (char) ( aHeight >> 16 );
+    aData[22] = (char) ( aHeight >> 8 );
+    aData[23] = (char) aHeight;
+  }
+}
+
+TEST( PngRoundTrip ) {
+  unsigned int seed = 3;
+
+  for ( int i = 0; i < 24; i++ ) {
+    int width = ( i == 0 ? 1 : 1 + gmtest::Random( seed ) % 200 );
+    int height = ( i == 0 ? 1 : 1 + gmtest::Random( seed ) % 120 );
+    std::vector<unsigned char> bitmap, decoded;
+    std::string data;
+    int decodedWidth = 0, decodedHeight = 0;
+
+    FillBitmap( bitmap, width, height, i % 4, seed );
+    CPngFile::Encode( &bitmap[0], width, height, data );
+
+    CHECK( CPngFile::Decode( (const unsigned char*) data.data(), data.size(), decoded, decodedWidth, decodedHeight ) );
+    CHECK_EQUAL( width, decodedWidth );
+    CHECK_EQUAL( height, decodedHeight );
+    CHECK( decoded == bitmap );
+  }
+}
+
+TEST( PngStreamSize ) {
+  unsigned int seed = 7;
+  std::vector<unsigned char> bitmap, decoded;
+  std::string data;
+  int width, height;
+
+  FillBitmap( bitmap, 16, 16, 0, seed );
+  CPngFile::Encode( &bitmap[0], 16, 16, data );
+
+  // Stream inflating to more than the rows of the header
+  std::string longer = data;
+  SetHeight( longer, 15 );
+  CHECK( !CPngFile::Decode( (const unsigned char*) longer.data(), longer.size(), decoded, width, height ) );
+
+  // Stream missing rows of the header
+  std::string shorter = data;
+  SetHeight( shorter, 17 );
+  CHECK( !CPngFile::Decode( (const unsigned char*) shorter.data(), shorter.size(), decoded, width, height ) );
+
+  // Truncated stream
+  std::string truncated = data.substr( 0, data.size() / 2 );
+  CHECK( !CPngFile::Decode( (const unsigned char*) truncated.data(), truncated.size(), decoded, width, height ) );
+
+  CHECK( CPngFile::Decode( (const unsigned char*) data.data(), data.size(), decoded, width, height ) );
+  CHECK( decoded == bitmap );
+}
+
+// Native encode and decode speed on the kinds of FillBitmap, and the
+// parallel SaveMany/LoadMany on a set of sprite sized files. How this
+// compares with the runner's export needs a live runner, so it is not
+// measured here.
+BENCHMARK( PngThroughput ) {
+  const int SIZE = 1024;
+  const int REPEATS = 4;
+  unsigned int seed = 5;
+
+  for ( int kind = 0; kind < 4; kind++ ) {
+    std::vector<unsigned char> bitmap, decoded;
+    std::string data;
+    int width, height;
+
+    FillBitmap( bitmap, SIZE, SIZE, kind, seed );
+
+    gmtest::CTimer encodeTimer;
+    for ( int i = 0; i < REPEATS; i++ )
+      CPngFile::Encode( &bitmap[0], SIZE, SIZE, data );
+    double encodeSeconds = encodeTimer.GetSeconds() / REPEATS;
+
+    gmtest::CTimer decodeTimer;
+    for ( int i = 0; i < REPEATS; i++ )
+      CPngFile::Decode( (const unsigned char*) data.data(), data.size(), decoded, width, height );
+    double decodeSeconds = decodeTimer.GetSeconds() / REPEATS;
+
+    CHECK( decoded == bitmap );
+    printf( "  %s %dx%d: %.1f%% of raw size, encode %.1f MPix/s, decode %.1f MPix/s\n",
+            KIND_NAMES[kind], SIZE, SIZE, data.size() * 100.0 / bitmap.size(),
+            SIZE * SIZE / 1e6 / encodeSeconds, SIZE * SIZE / 1e6 / decodeSeconds );
+  }
+
+  const int FILES = 64;
+  const int SPRITE = 128;
+  std::vector<std::vector<unsigned char> > bitmaps( FILES );
+  std::vector<CPngFile::SAVEJOB> saves( FILES );
+  std::vector<CPngFile::LOADJOB> loads( FILES );
+
+  for ( int i = 0; i < FILES; i++ ) {
+    char fileName[32];
+    sprintf( fileName, "TestPng%d.png", i );
+
+    FillBitmap( bitmaps[i], SPRITE, SPRITE, 1 + i % 3, seed );
+    saves[i].fileName = loads[i].fileName = fileName;
+    saves[i].bitmap = &bitmaps[i][0];
+    saves[i].width = saves[i].height = SPRITE;
+  }
+
+  gmtest::CTimer saveTimer;
+  CHECK_EQUAL( FILES, CPngFile::SaveMany( saves ) );
+  double saveSeconds = saveTimer.GetSeconds();
+
+  gmtest::CTimer loadTimer;
+  CHECK_EQUAL( FILES, CPngFile::LoadMany( loads ) );
+  double loadSeconds = loadTimer.GetSeconds();
+
+  for ( int i = 0; i < FILES; i++ ) {
+    CHECK( loads[i].bitmap == bitmaps[i] );
+    remove( loads[i].fileName.c_str() );
+  }
+
+  printf( "  %d files %dx%d: SaveMany %.1f ms, LoadMany %.1f ms\n", FILES, SPRITE, SPRITE,
+          saveSeconds * 1000.0, loadSeconds * 1000.0 );
+}
@@ -0,0 +1,173 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestRectPacker.cpp                                                  */
+/*   - Tests of CRectPacker                                             */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "GmapiRectPacker.h"
+
+using namespace gm;
+
+namespace {
+  void AddRects( std::vector<CRectPacker::RECTANGLE>& aRects, int aCount, int aMinimum, int aMaximum,
+                   unsigned int& aSeed ) {
+    for ( int i = 0; i < aCount; i++ ) {
+      CRectPacker::RECTANGLE rect = CRectPacker::RECTANGLE();
+
+      rect.width = aMinimum + gmtest::Random( aSeed ) % ( aMaximum - aMinimum + 1 );
+      rect.height = aMinimum + gmtest::Random( aSeed ) % ( aMaximum - aMinimum + 1 );
+      aRects.push_back( rect );
+    }
+  }
+
+  bool IsPowerOfTwo( int aValue ) {
+    return ( aValue > 0 && ( aValue & ( aValue - 1 ) ) == 0 );
+  }
+
+  // Whether the rects overlap, including their extrusion and padding
+  bool Overlap( const CRectPacker::RECTANGLE& aFirst, const CRectPacker::RECTANGLE& aSecond, int aPadding, int aExtrude ) {
+    int border = aExtrude + aPadding;
+
+    return ( aFirst.page == aSecond.page &&
+             aFirst.left - aExtrude < aSecond.left + aSecond.width + border &&
+             aSecond.left - aExtrude < aFirst.left + aFirst.width + border &&
+             aFirst.top - aExtrude < aSecond.top + aSecond.height + border &&
+             aSecond.top - aExtrude < aFirst.top + aFirst.height + border );
+  }
+
+  // Checks placement, page sizes and texture coordinates
+  void CheckLayout( const std::vector<CRectPacker::RECTANGLE>& aRects, int aPageSize, int aPadding,
+                    int aExtrude, const std::vector< std::pair<int, int> >& aPageSizes ) {
+    for ( size_t i = 0; i < aPageSizes.size(); i++ ) {
+      CHECK( IsPowerOfTwo( aPageSizes[i].first ) && IsPowerOfTwo( aPageSizes[i].second ) );
+      CHECK( aPageSizes[i].first <= aPageSize && aPageSizes[i].second <= aPageSize );
+    }
+
+    for ( size_t i = 0; i < aRects.size(); i++ ) {
+      const CRectPacker::RECTANGLE& rect = aRects[i];
+
+      if ( rect.page < 0 )
+        continue;
+
+      CHECK( rect.page < (int) aPageSizes.size() );
+
+      int width = aPageSizes[rect.page].first, height = aPageSizes[rect.page].second;
+
+      CHECK( rect.left - aExtrude >= 0 && rect.top - aExtrude >= 0 );
+      CHECK( rect.left + rect.width + aExtrude <= width );
+      CHECK( rect.top + rect.height + aExtrude <= height );
+
+      CHECK_CLOSE( (double) rect.left / width, rect.u0, 1e-12 );
+      CHECK_CLOSE( (double) rect.top / height, rect.v0, 1e-12 );
+      CHECK_CLOSE( (double) ( rect.left + rect.width ) / width, rect.u1, 1e-12 );
+      CHECK_CLOSE( (double) ( rect.top + rect.height ) / height, rect.v1, 1e-12 );
+
+      for ( size_t j = i + 1; j < aRects.size(); j++ )
+        CHECK( !Overlap( rect, aRects[j], aPadding, aExtrude ) );
+    }
+  }
+}
+
+TEST( RectPacker ) {
+  const int layouts[][3] = { { 256, 0, 0 }, { 256, 2, 1 }, { 128, 1, 2 } };
+
+  for ( int layout = 0; layout < 3; layout++ ) {
+    std::vector<CRectPacker::RECTANGLE> rects;
+    std::vector< std::pair<int, int> > pageSizes;
+    unsigned int seed = 5 + layout;
+
+    AddRects( rects, 150, 1, 40, seed );
+
+    CHECK( CRectPacker::Pack( rects, layouts[layout][0], layouts[layout][1], layouts[layout][2], pageSizes ) );
+    CHECK( !pageSizes.empty() );
+
+    for ( size_t i = 0; i < rects.size(); i++ )
+      CHECK( rects[i].page >= 0 );
+
+    CheckLayout( rects, layouts[layout][0], layouts[layout][1], layouts[layout][2], pageSizes );
+  }
+}
+
+TEST( RectPackerPages ) {
+  std::vector<CRectPacker::RECTANGLE> rects;
+  std::vector< std::pair<int, int> > pageSizes;
+  unsigned int seed = 9;
+
+  // A single rectangle is packed into the smallest power of two page
+  AddRects( rects, 1, 1, 1, seed );
+  rects[0].width = 20;
+  rects[0].height = 9;
+
+  CHECK( CRectPacker::Pack( rects, 256, 4, 1, pageSizes ) );
+  CHECK_EQUAL( (size_t) 1, pageSizes.size() );
+  CHECK_EQUAL( 32, pageSizes[0].first );
+  CHECK_EQUAL( 16, pageSizes[0].second );
+  CHECK_EQUAL( 1, rects[0].left );
+  CHECK_EQUAL( 1, rects[0].top );
+  CHECK_CLOSE( 21.0 / 32.0, rects[0].u1, 1e-12 );
+  CHECK_CLOSE( 10.0 / 16.0, rects[0].v1, 1e-12 );
+
+  // Four rects filling a page each, one too large and one without area
+  rects.clear();
+  AddRects( rects, 6, 64, 64, seed );
+  rects[4].width = 65;
+  rects[5].height = 0;
+
+  CHECK( !CRectPacker::Pack( rects, 64, 0, 0, pageSizes ) );
+  CHECK_EQUAL( (size_t) 4, pageSizes.size() );
+  CHECK_EQUAL( -1, rects[4].page );
+  CHECK_EQUAL( -1, rects[5].page );
+
+  for ( int i = 0; i < 4; i++ ) {
+    CHECK_EQUAL( 64, pageSizes[i].first );
+    CHECK_EQUAL( 0.0, rects[i].u0 );
+    CHECK_EQUAL( 1.0, rects[i].u1 );
+  }
+
+  CheckLayout( rects, 64, 0, 0, pageSizes );
+}
+
+BENCHMARK( RectPacker ) {
+  std::vector<CRectPacker::RECTANGLE> rects;
+  std::vector< std::pair<int, int> > pageSizes;
+  unsigned int seed = 17;
+  double used = 0.0, total = 0.0;
+
+  AddRects( rects, 2000, 8, 64, seed );
+
+  gmtest::CTimer timer;
+  bool packed = CRectPacker::Pack( rects, 1024, 2, 1, pageSizes );
+  double seconds = timer.GetSeconds();
+
+  CHECK( packed );
+
+  for ( size_t i = 0; i < pageSizes.size(); i++ )
+    total += (double) pageSizes[i].first * pageSizes[i].second;
+
+  for ( size_t i = 0; i < rects.size(); i++ )
+    used += (double) ( rects[i].width + 4 ) * ( rects[i].height + 4 );
+
+  printf( "  2000 rectangles: %.1f ms, %d pages, %.1f%% efficiency\n", seconds * 1000.0,
+          (int) pageSizes.size(), 100.0 * used / total );
+}
@@ -0,0 +1,167 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestStubs.cpp                                                       */
+/*   - Runner symbols used by the tested sources                        */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "TestStubs.h"
+#include "GmapiResources.h"
+#include "GmapiGameplay.h"
+#include "GmapiGameGraphics.h"
+#include "GmapiSurfacePool.h"
+
+namespace gmtest {
+
+  gm::GMSPRITESTORAGE runnerSprites = { NULL, NULL, 0 };
+  gm::GMBACKGROUNDSTORAGE runnerBackgrounds = { NULL, NULL, 0 };
+  gm::GMTEXTURE runnerSurfaceTextures[RUNNER_SURFACE_COUNT];
+  gm::PGMTEXTURE runnerTextures = runnerSurfaceTextures;
+  gm::GMSURFACE runnerSurfaces[RUNNER_SURFACE_COUNT];
+  int runnerSurfaceCount = RUNNER_SURFACE_COUNT;
+  int runnerTarget = -1;
+  int runnerClears = 0;
+  gm::GMPARTICLESTORAGE runnerParticles = { NULL, 0, NULL, 0 };
+  int runnerBlocks = 0;
+  void* runnerRoom = NULL;
+
+  gm::PGMSURFACE runnerSurfaceArray = runnerSurfaces;
+
+  // The tests have no fonts and sounds
+  gm::GMFONTSTORAGE runnerFonts = { NULL, NULL, 0 };
+  gm::GMSOUNDSTORAGE runnerSounds = { NULL, NULL, 0 };
+
+}
+
+namespace gm {
+
+  // Defined in GmapiInternal.cpp together with the code calling the runner
+  bool CGlobals::m_alternativeStructures = false;
+  void** CGMAPI::m_pCurrentRoom = &gmtest::runnerRoom;
+  PGMSPRITESTORAGE CGMAPI::m_pSpriteData = &gmtest::runnerSprites;
+  PGMBACKGROUNDSTORAGE CGMAPI::m_pBackgroundData = &gmtest::runnerBackgrounds;
+  PGMTEXTURE* CGMAPI::m_pTextures = &gmtest::runnerTextures;
+  PGMSURFACE* CGMAPI::m_pSurfaces = &gmtest::runnerSurfaceArray;
+  int* CGMAPI::m_pSurfaceArraySize = &gmtest::runnerSurfaceCount;
+  PGMPARTICLESTORAGE CGMAPI::m_pParticleData = &gmtest::runnerParticles;
+  PGMFONTSTORAGE CGMAPI::m_pFontData = &gmtest::runnerFonts;
+  PGMSOUNDSTORAGE CGMAPI::m_pSoundData = &gmtest::runnerSounds;
+  CGMAPI* CGMAPI::m_self = NULL;
+
+  unsigned long CGMAPI::GetBitmapSize( GMBITMAP* aBitmap ) {
+    return aBitmap->structOld.width * aBitmap->structOld.height * 4;
+  }
+
+  // Used by CMemoryReport::TakeSnapshot, which the tests do not call
+  void CGMAPI::EnumerateInstances( INSTANCEENUMPROC aInstanceEnumProc, void* aParam ) {}
+
+  void EGMAPIDataStructureNotExist::ShowError() const {}
+  void EGMAPIMotionGridNotExist::ShowError() const {}
+  void EGMAPIParticleSystemNotExist::ShowError() const {}
+  void EGMAPIEmitterNotExist::ShowError() const {}
+  void EGMAPIParticleTypeNotExist::ShowError() const {}
+
+  // Delphi strings of the runner keep the reference count and length
+  // before the characters; CParticleEngine allocates particle arrays as
+  // strings
+  namespace core {
+    extern "C" void __stdcall DelphiStringClear( const char** aPtrString ) {
+      if ( *aPtrString ) {
+        free( (DWORD*) *aPtrString - 2 );
+        *aPtrString = NULL;
+        --gmtest::runnerBlocks;
+      }
+    }
+
+    extern "C" void __stdcall DelphiStringSetFromPChar( const char* aString, const char** aPtrString ) {
+      size_t length = strlen( aString );
+      DWORD* block = (DWORD*) malloc( sizeof( DWORD ) * 2 + length + 1 );
+
+      block[0] = 1;
+      block[1] = (DWORD) length;
+      memcpy( block + 2, aString, length + 1 );
+
+      DelphiStringClear( aPtrString );
+      *aPtrString = (const char*) ( block + 2 );
+      ++gmtest::runnerBlocks;
+    }
+  }
+
+  // GML functions used by the room helpers of GmapiUtilities.cpp
+  bool object_is_ancestor( int ind1, int ind2 ) {
+    return false;
+  }
+
+  // Used by CMotionGrid::AddInstances and CPathFinder::WritePath, which
+  // the tests do not call
+  bool collision_rectangle( double x1, double y1, double x2, double y2, int obj, bool prec, bool notme ) {
+    return false;
+  }
+
+  void path_add_point( int ind, double x, double y, double speed ) {}
+  void path_clear_points( int ind ) {}
+
+  // GML functions used by CSurfacePool; surface_free and
+  // surface_set_target do the same as the overrides registered by it
+  int surface_create( int w, int h ) {
+    for ( int i = 0; i < gmtest::RUNNER_SURFACE_COUNT; i++ ) {
+      GMSURFACE& surface = gmtest::runnerSurfaces[i];
+
+      if ( !surface.exists ) {
+        GMTEXTURE& texture = gmtest::runnerSurfaceTextures[i];
+
+        texture.imageWidth = texture.textureWidth = w;
+        texture.imageHeight = texture.textureHeight = h;
+        texture.isValid = true;
+
+        surface.textureId = i;
+        surface.width = w;
+        surface.height = h;
+        surface.exists = true;
+        return i;
+      }
+    }
+
+    return -1;
+  }
+
+  void surface_free( int id ) {
+    CSurfacePool::Forget( id );
+    gmtest::runnerSurfaces[id].exists = false;
+    gmtest::runnerSurfaceTextures[id].isValid = false;
+  }
+
+  void surface_set_target( int id ) {
+    gmtest::runnerTarget = id;
+    CSurfacePool::SetTarget( id );
+  }
+
+  void surface_reset_target() {
+    gmtest::runnerTarget = -1;
+    CSurfacePool::SetTarget( -1 );
+  }
+
+  void draw_clear_alpha( int col, double alpha ) {
+    ++gmtest::runnerClears;
+  }
+
+}
@@ -0,0 +1,66 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestStubs.h                                                         */
+/*   - Stand-ins of the runner's resource arrays                        */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include "GmapiInternal.h"
+
+namespace gmtest {
+
+  /// Arrays read by CGMAPI::SpriteData, BackgroundData and
+  /// GetDirect3DTexture; tests fill them with their own resources and
+  /// empty them again when they finish. runnerTextures points to
+  /// runnerSurfaceTextures unless a test sets its own textures.
+  extern gm::GMSPRITESTORAGE runnerSprites;
+  extern gm::GMBACKGROUNDSTORAGE runnerBackgrounds;
+  extern gm::PGMTEXTURE runnerTextures;
+
+  /// Surface array read by CGMAPI::GetSurfaceArray; the stand-ins of
+  /// surface_create and surface_free use its first
+  /// RUNNER_SURFACE_COUNT items, and the texture of surface i is item i
+  /// of runnerSurfaceTextures
+  const int RUNNER_SURFACE_COUNT = 16;
+  extern gm::GMSURFACE runnerSurfaces[RUNNER_SURFACE_COUNT];
+  extern gm::GMTEXTURE runnerSurfaceTextures[RUNNER_SURFACE_COUNT];
+  extern int runnerSurfaceCount;
+
+  /// Drawing target of the stand-ins of surface_set_target and
+  /// surface_reset_target (-1 for the screen) and surfaces cleared by
+  /// draw_clear_alpha
+  extern int runnerTarget;
+  extern int runnerClears;
+
+  /// Particle types and systems read by CGMAPI::ParticleData
+  extern gm::GMPARTICLESTORAGE runnerParticles;
+
+  /// Blocks allocated by the stand-ins of the runner's Delphi string
+  /// functions and not freed yet
+  extern int runnerBlocks;
+
+  /// Current room read by CGMAPI::GetCurrentRoomPtr (NULL when there is
+  /// no room); see CRoomInstances::GetArray for its layout
+  extern void* runnerRoom;
+
+}
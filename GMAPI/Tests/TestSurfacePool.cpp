@@ -0,0 +1,140 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  TestSurfacePool.cpp                                                 */
+/*   - Tests of CSurfacePool                                            */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#include "Tests.h"
+#include "TestStubs.h"
+#include "GmapiSurfacePool.h"
+#include "GmapiGameGraphics.h"
+
+using namespace gm;
+
+namespace {
+  // Frees the pooled surfaces and the ones created by a test
+  void FreeSurfaces() {
+    CSurfacePool::Trim();
+    CSurfacePool::ResetStatistics();
+    CSurfacePool::SetIdleFrames( 60 );
+
+    for ( int i = 0; i < gmtest::RUNNER_SURFACE_COUNT; i++ ) {
+      if ( gmtest::runnerSurfaces[i].exists )
+        surface_free( i );
+    }
+  }
+}
+
+TEST( SurfacePoolReuse ) {
+  for ( int frame = 0; frame < 10; frame++ ) {
+    int a = CSurfacePool::Acquire( 256, 256, false );
+    int b = CSurfacePool::Acquire( 256, 256, false );
+    int c = CSurfacePool::Acquire( 128, 64, false );
+
+    CHECK( a >= 0 && b >= 0 && c >= 0 );
+    CHECK( a != b );
+    CHECK( gmtest::runnerSurfaces[c].width == 128 && gmtest::runnerSurfaces[c].height == 64 );
+    CHECK_EQUAL( 3, CSurfacePool::GetInUseCount() );
+
+    CHECK( CSurfacePool::Release( a ) );
+    CHECK( CSurfacePool::Release( b ) );
+    CHECK( CSurfacePool::Release( c ) );
+    CHECK( !CSurfacePool::Release( c ) );
+    CSurfacePool::Frame();
+  }
+
+  // Only the first frame created surfaces
+  CHECK_EQUAL( 3, CSurfacePool::GetMisses() );
+  CHECK_EQUAL( 27, CSurfacePool::GetHits() );
+  CHECK_CLOSE( 0.9, CSurfacePool::GetHitRate(), 1e-9 );
+  CHECK_EQUAL( 3, CSurfacePool::GetIdleCount() );
+  CHECK_CLOSE( 4.0 * ( 2 * 256 * 256 + 128 * 64 ), CSurfacePool::GetIdleSize(), 1e-9 );
+
+  // Sizes must match exactly
+  int wide = CSurfacePool::Acquire( 256, 128, false );
+  CHECK_EQUAL( 4, CSurfacePool::GetMisses() );
+  CHECK_EQUAL( 3, CSurfacePool::GetIdleCount() );
+  CHECK( CSurfacePool::Release( wide ) );
+
+  FreeSurfaces();
+}
+
+TEST( SurfacePoolFreed ) {
+  int a = CSurfacePool::Acquire( 64, 64, false );
+  int b = CSurfacePool::Acquire( 64, 64, false );
+
+  CSurfacePool::Release( a );
+  CSurfacePool::Release( b );
+
+  // Freed by the game and its ID taken by a surface of the same size,
+  // which must not be handed out
+  surface_free( b );
+  CHECK_EQUAL( 1, CSurfacePool::GetIdleCount() );
+  int own = surface_create( 64, 64 );
+  CHECK_EQUAL( b, own );
+  CHECK_EQUAL( a, CSurfacePool::Acquire( 64, 64, false ) );
+  CHECK( CSurfacePool::Acquire( 64, 64, false ) != own );
+
+  // Idle surfaces are freed after the idle frames
+  CSurfacePool::Trim();
+  CSurfacePool::Release( a );
+  CSurfacePool::SetIdleFrames( 2 );
+  CSurfacePool::Frame();
+  CSurfacePool::Frame();
+  CHECK_EQUAL( 1, CSurfacePool::GetIdleCount() );
+  CSurfacePool::Frame();
+  CHECK_EQUAL( 0, CSurfacePool::GetIdleCount() );
+  CHECK( !gmtest::runnerSurfaces[a].exists );
+  CHECK( gmtest::runnerSurfaces[own].exists );
+
+  FreeSurfaces();
+}
+
+TEST( SurfacePoolClear ) {
+  int clears = gmtest::runnerClears;
+  int target = CSurfacePool::Acquire( 32, 32, true );
+
+  CHECK_EQUAL( clears + 1, gmtest::runnerClears );
+  CHECK_EQUAL( -1, gmtest::runnerTarget );
+
+  // Acquired while drawing to another surface, which stays the target
+  surface_set_target( target );
+  int cleared = CSurfacePool::Acquire( 16, 16, true );
+  CHECK_EQUAL( clears + 2, gmtest::runnerClears );
+  CHECK_EQUAL( target, gmtest::runnerTarget );
+
+  CSurfacePool::Release( cleared );
+  CHECK_EQUAL( cleared, CSurfacePool::Acquire( 16, 16, true ) );
+  CHECK_EQUAL( clears + 3, gmtest::runnerClears );
+  CHECK_EQUAL( target, gmtest::runnerTarget );
+  surface_reset_target();
+
+  // The target is forgotten when it is freed
+  surface_set_target( target );
+  surface_free( target );
+  CHECK_EQUAL( -1, CSurfacePool::GetTarget() );
+  CSurfacePool::Acquire( 16, 16, true );
+  CHECK_EQUAL( -1, gmtest::runnerTarget );
+
+  FreeSurfaces();
+}
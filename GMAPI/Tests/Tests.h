@@ -0,0 +1,112 @@
+/************************************************************************/
+/* LICENSE:                                                             */
+/*                                                                      */
+/*  GMAPI is free software; you can redistribute it and/or              */
+/*  modify it under the terms of the GNU Lesser General Public          */
+/*  License as published by the Free Software Foundation; either        */
+/*  version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                      */
+/*  GMAPI is distributed in the hope that it will be useful,            */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*  Lesser General Public License for more details.                     */
+/*                                                                      */
+/*  You should have received a copy of the GNU Lesser General Public    */
+/*  License along with GMAPI; if not, write to the Free Software        */
+/*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA       */
+/*  02110-1301 USA                                                      */
+/************************************************************************/
+
+/************************************************************************/
+/*  Tests.h                                                             */
+/*   - Minimal framework of the tests of the native extensions          */
+/*                                                                      */
+/*  Copyright (C) 2009-2010, Snake (http://www.sgames.ovh.org)          */
+/************************************************************************/
+
+#pragma once
+#include <math.h>
+#include <stdio.h>
+
+namespace gmtest {
+
+  typedef void (*TESTPROC)();
+
+  /// CTest
+  ///   Test or benchmark registered by the TEST and BENCHMARK macros.
+  ///   Tests report failed checks and go on; benchmarks run only when
+  ///   the tests are started with --bench and print their results.
+  ///
+  class CTest {
+    public:
+      CTest( const char* aName, TESTPROC aProc, bool aBenchmark );
+
+      /// Run( bool aBenchmarks, const char* aFilter )
+      ///   Runs all tests (and benchmarks) whose names contain aFilter,
+      ///   or all of them if aFilter is NULL.
+      ///
+      /// Returns:
+      ///   Number of failed checks.
+      ///
+      static int Run( bool aBenchmarks, const char* aFilter );
+
+      static void Fail( const char* aFile, int aLine, const char* aExpression );
+
+    private:
+      const char* m_name;
+      TESTPROC m_proc;
+      bool m_benchmark;
+      CTest* m_next;
+
+      static CTest* m_first;
+      static CTest* m_last;
+      static int m_failures;
+  };
+
+  /// CTimer
+  ///   Measures wall time of benchmarks.
+  ///
+  class CTimer {
+    public:
+      CTimer();
+
+      /// GetSeconds()
+      ///   Returns number of seconds since the timer was created.
+      ///
+      double GetSeconds() const;
+
+    private:
+      long long m_start;
+  };
+
+  /// Random( unsigned int& aSeed )
+  ///   Returns pseudorandom number from 0 to 0x7FFF; the same seed always
+  ///   gives the same sequence on all compilers.
+  ///
+  inline int Random( unsigned int& aSeed ) {
+    aSeed = aSeed * 1103515245UL + 12345UL;
+    return (int) ( ( aSeed >> 16 ) & 0x7FFF );
+  }
+
+}
+
+#define TEST( aName ) \
+  static void Test##aName(); \
+  static gmtest::CTest test##aName( #aName, Test##aName, false ); \
+  static void Test##aName()
+
+#define BENCHMARK( aName ) \
+  static void Benchmark##aName(); \
+  static gmtest::CTest benchmark##aName( #aName, Benchmark##aName, true ); \
+  static void Benchmark##aName()
+
+#define CHECK( aCondition ) \
+  do { \
+    if ( !( aCondition ) ) \
+      gmtest::CTest::Fail( __FILE__, __LINE__, #aCondition ); \
+  } while ( 0 )
+
+#define CHECK_EQUAL( aExpected, aActual ) CHECK( ( aExpected ) == ( aActual ) )
+
+#define CHECK_CLOSE( aExpected, aActual, aTolerance ) \
+  CHECK( fabs( (double) ( aExpected ) - (double) ( aActual ) ) <= ( aTolerance ) )